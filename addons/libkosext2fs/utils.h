@@ -2,6 +2,7 @@
 
    utils.h
    Copyright (C) 2012 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #ifndef __EXT2_UTILS_H
@@ -12,6 +13,12 @@ __BEGIN_DECLS
 
 #include <stdint.h>
 
+/* Newlib provides this, but not every C library does when building outside of
+   KOS. */
+#ifndef __align_up
+#define __align_up(x, align) (((x) + (align) - 1) & ~((align) - 1))
+#endif
+
 uint32_t ext2_bit_find_nonzero(const uint32_t *btbl, uint32_t start,
                                uint32_t end);
 uint32_t ext2_bit_find_zero(const uint32_t *btbl, uint32_t start, uint32_t end);
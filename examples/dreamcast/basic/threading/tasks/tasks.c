@@ -0,0 +1,205 @@
+/*  KallistiOS ##version##
+
+    tasks.c
+
+    Copyright (C) 2026 KallistiOS Contributors
+
+    kthread Task Pool Example and Test
+
+    This program serves as an example of and test for KOS's task pool API. It
+    builds a small graph of dependent tasks mimicking an asset pipeline (load,
+    decompress, convert, per asset, plus a final task depending on all of
+    them), checks that every task ran after its dependencies and that their
+    return values are passed through, checks that dropping a task that was
+    never submitted doesn't leave the tasks depending on it waiting, and then
+    sums an array with a parallel-for loop. The watchdog timer is used to protect against any sort
+    of deadlock should the test fail.
+
+ */
+
+#include <kos/thread.h>
+#include <kos/task.h>
+#include <arch/wdt.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/* Configurable constants */
+#define WATCHDOG_TIMEOUT    (10 * 1000 * 1000) /* 10s */
+#define THREAD_COUNT        3       /* Number of worker threads */
+#define ASSET_COUNT         8       /* Number of fake assets to process */
+#define STAGE_COUNT         3       /* Load, decompress, convert */
+#define ARRAY_SIZE          10000   /* Number of items to sum */
+
+/* Sequence number given to each task as it runs */
+static atomic_uint sequence;
+
+/* When each stage of each asset ran */
+static unsigned int ran_at[ASSET_COUNT][STAGE_COUNT];
+
+static uint32_t array[ARRAY_SIZE];
+static atomic_uint array_sum;
+
+static void *stage_exec(void *user_data) {
+    uintptr_t id = (uintptr_t)user_data;
+
+    ran_at[id / STAGE_COUNT][id % STAGE_COUNT] = ++sequence;
+
+    /* Pretend to do some work, and give other tasks a chance to run. */
+    thd_pass();
+
+    return (void *)(id + 1);
+}
+
+static void *final_exec(void *user_data) {
+    (void)user_data;
+
+    return (void *)(uintptr_t)++sequence;
+}
+
+static void sum_exec(size_t start, size_t end, void *user_data) {
+    unsigned int sum = 0;
+
+    (void)user_data;
+
+    for(; start < end; start++)
+        sum += array[start];
+
+    array_sum += sum;
+}
+
+/* WDT callback for test timeout failure */
+static void watchdog_timeout(void *user_data) {
+    (void)user_data;
+
+    fprintf(stderr, "\n**** FAILURE: Watchdog timeout reached! ****\n\n");
+    exit(EXIT_FAILURE);
+}
+
+/* Program entry-point */
+int main(int argc, char* argv[]) {
+    kthread_task_t *tasks[ASSET_COUNT][STAGE_COUNT];
+    kthread_task_t *final, *dropped, *orphan;
+    kthread_pool_t *pool;
+    bool success = true;
+    unsigned int expected = 0;
+    void *rv;
+
+    printf("Initializing Watchdog timer...\n");
+    wdt_enable_timer(0, WATCHDOG_TIMEOUT, 0xf,
+                     watchdog_timeout, NULL);
+    atexit(wdt_disable);
+
+    printf("Creating a pool of %u threads...\n", THREAD_COUNT);
+    pool = thd_pool_create(NULL, THREAD_COUNT);
+    if(!pool) {
+        fprintf(stderr, "Failed to create the task pool!\n");
+        return EXIT_FAILURE;
+    }
+
+    final = thd_task_create(final_exec, NULL);
+    thd_task_set_prio(final, PRIO_DEFAULT + 1);
+
+    printf("Submitting %u tasks...\n", ASSET_COUNT * STAGE_COUNT + 1);
+    for(unsigned a = 0; a < ASSET_COUNT; ++a) {
+        for(unsigned s = 0; s < STAGE_COUNT; ++s) {
+            tasks[a][s] = thd_task_create(stage_exec,
+                                          (void *)(a * STAGE_COUNT + s));
+
+            if(s)
+                thd_task_depend(tasks[a][s], tasks[a][s - 1]);
+        }
+
+        thd_task_depend(final, tasks[a][STAGE_COUNT - 1]);
+    }
+
+    /* Submit everything in reverse order, to make sure the dependencies and
+       not the submission order decide the order of execution. */
+    thd_task_submit(pool, final);
+
+    for(unsigned a = ASSET_COUNT; a-- > 0;) {
+        for(unsigned s = STAGE_COUNT; s-- > 0;)
+            thd_task_submit(pool, tasks[a][s]);
+    }
+
+    printf("Waiting for the final task...\n");
+    if(thd_task_wait(final, &rv)) {
+        fprintf(stderr, "Failed to wait for the final task!\n");
+        success = false;
+    }
+    else if((uintptr_t)rv != ASSET_COUNT * STAGE_COUNT + 1) {
+        fprintf(stderr, "Final task ran at %u (%u expected)!\n",
+                (unsigned int)(uintptr_t)rv, ASSET_COUNT * STAGE_COUNT + 1);
+        success = false;
+    }
+
+    printf("Verifying the order of execution...\n");
+    for(unsigned a = 0; a < ASSET_COUNT; ++a) {
+        for(unsigned s = 0; s < STAGE_COUNT; ++s) {
+            if(!thd_task_done(tasks[a][s]) ||
+               thd_task_wait(tasks[a][s], &rv) ||
+               (uintptr_t)rv != a * STAGE_COUNT + s + 1) {
+                fprintf(stderr, "Task[%u][%u] has a wrong result!\n", a, s);
+                success = false;
+            }
+
+            if(s && ran_at[a][s] <= ran_at[a][s - 1]) {
+                fprintf(stderr, "Task[%u][%u] ran before its dependency!\n",
+                        a, s);
+                success = false;
+            }
+
+            thd_task_destroy(tasks[a][s]);
+        }
+    }
+
+    thd_task_destroy(final);
+
+    /* The task depending on one that is dropped before it was submitted
+       must still run, or destroying the pool would wait for it forever. */
+    printf("Dropping a dependency that was never submitted...\n");
+    dropped = thd_task_create(final_exec, NULL);
+    orphan = thd_task_create(final_exec, NULL);
+    thd_task_depend(orphan, dropped);
+    thd_task_submit(pool, orphan);
+    thd_task_destroy(dropped);
+
+    if(thd_task_wait_timed(orphan, NULL, 1000)) {
+        fprintf(stderr, "Task depending on a dropped task never ran!\n");
+        success = false;
+    }
+
+    thd_task_destroy(orphan);
+
+    printf("Summing %u items in parallel...\n", ARRAY_SIZE);
+    for(unsigned i = 0; i < ARRAY_SIZE; ++i) {
+        array[i] = i;
+        expected += i;
+    }
+
+    if(thd_pool_parallel_for(pool, ARRAY_SIZE, 0, sum_exec, NULL)) {
+        fprintf(stderr, "Parallel-for failed!\n");
+        success = false;
+    }
+
+    if(array_sum != expected) {
+        fprintf(stderr, "Incorrect sum - %u (%u expected)!\n",
+                (unsigned int)array_sum, expected);
+        success = false;
+    }
+
+    printf("Destroying the pool...\n");
+    thd_pool_destroy(pool);
+
+    if(success) {
+        printf("\n***** TEST COMPLETE: SUCCESS *****\n\n");
+        return EXIT_SUCCESS;
+    }
+    else {
+        fprintf(stderr, "\nXXXXX TEST COMPLETE: FAILURE XXXXX\n\n");
+        return EXIT_FAILURE;
+    }
+}
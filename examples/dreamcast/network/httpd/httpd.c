@@ -2,6 +2,7 @@
 
    httpd.c
    Copyright (C)2003 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <stdio.h>
@@ -14,6 +15,7 @@
 
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
 
 #include <kos/fs.h>
@@ -245,7 +247,7 @@ void *client_thread(void *p) {
     char * buf, * ext;
     const char * ct;
     file_t f = -1;
-    int r, o, cnt;
+    int r;
 
     printf("httpd: client thread started, sock %d\n", hs->socket);
 
@@ -296,18 +298,10 @@ void *client_thread(void *p) {
 
         send_ok(hs, ct);
 
-        while((cnt = fs_read(f, buf, BUFSIZE)) != 0) {
-            o = 0;
-
-            while(cnt > 0) {
-                r = write(hs->socket, buf + o, cnt);
-
-                if(r <= 0)
-                    goto out;
-
-                cnt -= r;
-                o += r;
-            }
+        /* Files on a romdisk go straight from there into the socket. */
+        while((r = sendfile(hs->socket, f, NULL, BUFSIZE)) != 0) {
+            if(r < 0)
+                goto out;
         }
     }
 
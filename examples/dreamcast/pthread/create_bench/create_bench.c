@@ -0,0 +1,103 @@
+/* KallistiOS ##version##
+
+   create_bench.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Thread creation benchmark
+
+   This program measures how long it takes to create and join short-lived
+   threads with pthreads, first with the default behaviour of allocating and
+   freeing a control block and a stack for every thread, then with the
+   thread recycling cache enabled (see thd_set_cache_limits()).
+
+   Two patterns are measured: creating and joining one thread at a time, as a
+   server handling requests one by one would, and creating a burst of threads
+   before joining them all.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <kos/thread.h>
+#include <arch/arch.h>
+#include <arch/timer.h>
+
+#define ITERATIONS  1000    /* Number of threads per measurement */
+#define BURST       8       /* Number of threads created at once */
+
+static void *thd_func(void *param) {
+    return param;
+}
+
+/* Create and join threads one at a time. Returns the average time per
+   thread, in nanoseconds. */
+static uint64_t bench_serial(void) {
+    pthread_t thd;
+    uint64_t start;
+    int i;
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ITERATIONS; i++) {
+        if(pthread_create(&thd, NULL, thd_func, NULL)) {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        pthread_join(thd, NULL);
+    }
+
+    return (timer_ns_gettime64() - start) / ITERATIONS;
+}
+
+/* Create threads in bursts, then join them. Returns the average time per
+   thread, in nanoseconds. */
+static uint64_t bench_burst(void) {
+    pthread_t thds[BURST];
+    uint64_t start;
+    int i, j;
+
+    start = timer_ns_gettime64();
+
+    for(i = 0; i < ITERATIONS; i += BURST) {
+        for(j = 0; j < BURST; j++) {
+            if(pthread_create(&thds[j], NULL, thd_func, NULL)) {
+                fprintf(stderr, "pthread_create failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        for(j = 0; j < BURST; j++)
+            pthread_join(thds[j], NULL);
+    }
+
+    return (timer_ns_gettime64() - start) / ITERATIONS;
+}
+
+static void run(const char *name) {
+    uint64_t serial, burst;
+
+    /* Warm up, so that the cache is populated if it is enabled */
+    bench_burst();
+
+    serial = bench_serial();
+    burst = bench_burst();
+
+    printf("%-10s serial: %6lu ns/thread, burst of %d: %6lu ns/thread\n",
+           name, (unsigned long)serial, BURST, (unsigned long)burst);
+}
+
+int main(int argc, char *argv[]) {
+    printf("Creating and joining %d threads, stack size %d bytes\n",
+           ITERATIONS, THD_STACK_SIZE);
+
+    run("No cache:");
+
+    thd_set_cache_limits(BURST, BURST * THD_STACK_SIZE);
+    run("Cache:");
+
+    thd_set_cache_limits(0, 0);
+
+    return 0;
+}
@@ -59,7 +59,10 @@ __BEGIN_DECLS
 #include <kos/string.h>
 #include <kos/init.h>
 #include <kos/oneshot_timer.h>
+#include <kos/task.h>
 #include <kos/regfield.h>
+#include <kos/trace.h>
+#include <kos/tlsf.h>
 
 #include <arch/arch.h>
 #include <arch/cache.h>
@@ -104,12 +107,15 @@ __BEGIN_DECLS
 #   include <dc/net/broadband_adapter.h>
 #   include <dc/net/lan_adapter.h>
 #   include <dc/perfctr.h>
+#   include <dc/profiler.h>
 #   include <dc/pvr.h>
+#   include <dc/pvr/pvr_xform.h>
 #   include <dc/scif.h>
 #   include <dc/sci.h>
 #   include <dc/sd.h>
 #   include <dc/sound/stream.h>
 #   include <dc/sound/sfxmgr.h>
+#   include <dc/sound/mixer.h>
 #   include <dc/spu.h>
 #   include <dc/sq.h>
 #   include <dc/ubc.h>
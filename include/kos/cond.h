@@ -2,6 +2,7 @@
 
    include/kos/cond.h
    Copyright (C) 2001, 2003 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -59,7 +60,7 @@ __BEGIN_DECLS
     \headerfile kos/cond.h
 */
 typedef struct condvar {
-    int dummy;
+    int waiters;
     int dynamic;
 } condvar_t;
 
@@ -2,6 +2,7 @@
 
    kos/include/dbgio.h
    Copyright (C)2000,2004 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -23,7 +24,9 @@
 #include <kos/cdefs.h>
 __BEGIN_DECLS
 
+#include <stdarg.h>
 #include <arch/types.h>
+#include <kos/thread.h>
 
 /** \brief   Debug I/O Interface.
     \ingroup logging
@@ -273,6 +276,76 @@ void dbgio_enable(void);
 */
 int dbgio_printf(const char *fmt, ...) __printflike(1, 2);
 
+/** \brief   Start writing debug output from a background thread.
+    \ingroup logging
+
+    Once this has been called, dbgio_printf() and dbglog() no longer write to
+    the console themselves. They format their message into a ring buffer and
+    return straight away, and a thread writes the messages out in the order
+    they were logged. This keeps a slow console, such as a serial port, from
+    holding up the thread that's logging. Logging this way never blocks, and
+    works from interrupts too.
+
+    If the ring buffer is full, the message is dropped and counted, and a note
+    of how many were dropped is written out when there's room again. Anything
+    still in the ring buffer is written out synchronously on a kernel panic.
+
+    Messages are limited to 1023 bytes, as before. The other dbgio functions
+    still write synchronously, so their output may come out ahead of messages
+    that are still queued.
+
+    \param  size            The size of the ring buffer in bytes, or 0 for
+                            DBGIO_ASYNC_SIZE. It is rounded up to a power of
+                            two, of at least 4096.
+    \param  attr            Attributes for the thread, or NULL for the defaults
+                            (a priority of PRIO_DEFAULT + 1).
+
+    \retval 0               On success, or if it had already been started
+    \retval -1              On error (errno should be set as appropriate)
+
+    \par    Error Conditions:
+    \em     ENOMEM - Out of memory for the ring buffer or the thread
+*/
+int dbgio_async_start(size_t size, const kthread_attr_t *attr);
+
+/** \brief   Go back to writing debug output synchronously.
+    \ingroup logging
+
+    This writes out everything that's still queued, then stops the thread
+    started by dbgio_async_start().
+*/
+void dbgio_async_stop(void);
+
+/** \brief   Wait for queued debug output to be written out.
+    \ingroup logging
+
+    This waits until everything logged before it was called has been written to
+    the console. It can't be called from an interrupt.
+
+    \retval 0               On success
+    \retval -1              If called from an interrupt (errno set to EPERM)
+*/
+int dbgio_async_flush(void);
+
+/** \brief   Get the number of messages dropped because the ring was full.
+    \ingroup logging
+
+    \return                 The number of messages dropped since
+                            dbgio_async_start() was called
+*/
+size_t dbgio_async_dropped(void);
+
+/** \cond */
+/* Queue a message from dbgio_printf() or dbglog(), if asynchronous output is
+   on. Returns -1 if it isn't, otherwise 0 with the vsnprintf() result in rv. */
+int __dbgio_async_vprintf(int to_stdout, const char *fmt, va_list args,
+                          int *rv);
+
+/* Called on a kernel panic to write out anything queued, and to make any later
+   output synchronous. */
+void __dbgio_async_panic(void);
+/** \endcond */
+
 __END_DECLS
 
 #endif  /* __KOS_DBGIO_H */
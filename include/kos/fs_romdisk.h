@@ -2,6 +2,7 @@
 
    kos/fs_romdisk.h
    (c)2001 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -39,6 +40,14 @@
     filesystem image. A rule to create the image is provided in the rules provided in Makefile.rules,
     the created object file must be linked with your binary file by adding romdisk.o to your 
     list of objects.
+
+    To save RAM, genromfs can pack the regular files of an image with the -z option (add it to
+    KOS_GENROMFS_FLAGS in your Makefile to use it with the rule above). Each packed file is split
+    into blocks, 4KB by default, which are compressed separately, and only the blocks that are
+    read get unpacked. The most recently used ones are kept in a small cache, whose size is set
+    by FS_ROMDISK_CACHE_BLOCKS. Reads that cover whole blocks unpack straight into the caller's
+    buffer. Files that don't get smaller are stored as they are. Packed files can't be mmap()ed,
+    so use genromfs's -Z option to leave out the files you want to mmap().
     
     \see INIT_FS_ROMDISK
     \see KOS_INIT_FLAGS()
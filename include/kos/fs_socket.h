@@ -2,6 +2,7 @@
 
    kos/fs_socket.h
    Copyright (C) 2006, 2009, 2010, 2012, 2013 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -378,6 +379,41 @@ typedef struct fs_socket_proto {
                             currently true in the socket. 0 if none are true.
     */
     short (*poll)(net_socket_t *s, short events);
+
+    /** \brief  Receive multiple messages on a socket created with the
+                protocol.
+
+        This function should implement the ::recvmmsg() system call for the
+        protocol, and is also used for ::recvmsg(). It is optional: if it is
+        NULL, fs_socket calls recvfrom once per message instead, and can't
+        honour the timeout.
+
+        \param  s           The socket to receive on
+        \param  msgvec      The message headers to fill in
+        \param  vlen        The number of message headers
+        \param  flags       Flags to the function
+        \param  timeout     How long to wait for messages (NULL for no limit)
+        \retval -1          On error (set errno appropriately)
+        \retval n           The number of messages received
+    */
+    int (*recvmmsg)(net_socket_t *s, struct mmsghdr *msgvec, unsigned int vlen,
+                    int flags, struct timespec *timeout);
+
+    /** \brief  Send multiple messages on a socket created with the protocol.
+
+        This function should implement the ::sendmmsg() system call for the
+        protocol, and is also used for ::sendmsg(). It is optional: if it is
+        NULL, fs_socket calls sendto once per message instead.
+
+        \param  s           The socket to send on
+        \param  msgvec      The message headers
+        \param  vlen        The number of message headers
+        \param  flags       Flags to the function
+        \retval -1          On error (set errno appropriately)
+        \retval n           The number of messages sent
+    */
+    int (*sendmmsg)(net_socket_t *s, struct mmsghdr *msgvec, unsigned int vlen,
+                    int flags);
 } fs_socket_proto_t;
 
 /** \brief   Initializer for the entry field in the fs_socket_proto_t struct. 
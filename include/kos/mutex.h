@@ -3,6 +3,7 @@
    include/kos/mutex.h
    Copyright (C) 2001, 2003 Megan Potter
    Copyright (C) 2012, 2015 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -45,6 +46,11 @@
     There is a fourth type of mutex defined (MUTEX_TYPE_DEFAULT), which maps to
     the MUTEX_TYPE_NORMAL type. This is simply for alignment with POSIX.
 
+    Locking a free mutex and unlocking a mutex nobody is waiting for are done
+    with a single atomic operation on the holder field, without disabling
+    interrupts. The scheduler is only involved when a thread has to wait,
+    which is also when priority inheritance kicks in.
+
     \author Lawrence Sebald
     \see    kos/sem.h
 */
@@ -70,6 +76,7 @@ typedef struct kos_mutex {
     int dynamic;
     kthread_t *holder;
     int count;
+    int waiters;
 } mutex_t;
 
 /** \name  Mutex types
@@ -90,13 +97,13 @@ typedef struct kos_mutex {
 /** @} */
 
 /** \brief  Initializer for a transient mutex. */
-#define MUTEX_INITIALIZER               { MUTEX_TYPE_NORMAL, 0, NULL, 0 }
+#define MUTEX_INITIALIZER               { MUTEX_TYPE_NORMAL, 0, NULL, 0, 0 }
 
 /** \brief  Initializer for a transient error-checking mutex. */
-#define ERRORCHECK_MUTEX_INITIALIZER    { MUTEX_TYPE_ERRORCHECK, 0, NULL, 0 }
+#define ERRORCHECK_MUTEX_INITIALIZER    { MUTEX_TYPE_ERRORCHECK, 0, NULL, 0, 0 }
 
 /** \brief  Initializer for a transient recursive mutex. */
-#define RECURSIVE_MUTEX_INITIALIZER     { MUTEX_TYPE_RECURSIVE, 0, NULL, 0 }
+#define RECURSIVE_MUTEX_INITIALIZER     { MUTEX_TYPE_RECURSIVE, 0, NULL, 0, 0 }
 
 /** \brief  Allocate a new mutex.
 
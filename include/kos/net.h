@@ -4,6 +4,7 @@
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2005, 2006, 2007, 2008, 2009, 2010, 2012, 2013,
                  2016 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -181,6 +182,27 @@ typedef struct knetif {
         \param  count       The number of addresses in list.
     */
     int (*if_set_mc)(struct knetif *self, const uint8 *list, int count);
+
+    /** \brief  Pass received frames up the stack, for devices that use
+                net_poll_schedule().
+
+        This is called from the network polling thread once the device has
+        called net_poll_schedule(). It should pass at most budget frames to
+        net_input(). If that leaves none waiting, it should call
+        net_poll_complete() and then unmask its receive interrupt. Otherwise
+        it is called again, in turn with any other scheduled devices.
+
+        \param  self        The network device in question.
+        \param  budget      The most frames to pass up.
+        \return             The number of frames passed up.
+    */
+    int (*if_poll)(struct knetif *self, int budget);
+
+    /** \cond */
+    /* Used by net_poll_schedule() */
+    struct knetif *poll_next;
+    int poll_state;
+    /** \endcond */
 } netif_t;
 
 /** \defgroup net_drivers_flags netif_t Flags
@@ -792,6 +814,7 @@ typedef struct net_udp_stats {
     uint32  pkt_recv_bad_size;      /**< \brief Packets of a bad size */
     uint32  pkt_recv_bad_chksum;    /**< \brief Packets with a bad checksum */
     uint32  pkt_recv_no_sock;       /**< \brief Packets with to a closed port */
+    uint32  pkt_recv_dropped;       /**< \brief Packets dropped with a full receive buffer */
 } net_udp_stats_t;
 
 /** \brief  Retrieve statistics from the UDP layer.
@@ -829,6 +852,74 @@ void net_tcp_shutdown(void);
 
 /** @} */
 
+/***** getaddrinfo.c ******************************************************/
+
+/** \defgroup networking_dns    DNS
+    \brief                      API for the DNS resolver behind getaddrinfo()
+    \ingroup                    networking
+
+    getaddrinfo() keeps the results of its DNS lookups cached for as long as
+    their TTLs allow (up to NET_DNS_CACHE_ENTRIES of them), including the names
+    that don't exist. Queries go first to the default device's DNS server, and
+    then to any others set with net_dns_set_servers(), when a server doesn't
+    answer.
+
+    @{
+*/
+
+/** \brief  The maximum number of DNS servers that can be set with
+            net_dns_set_servers(). */
+#define NET_DNS_MAX_SERVERS     4
+
+/** \brief  DNS resolver statistics structure.
+
+    This structure holds some basic statistics about the DNS resolver, and can
+    be retrieved with the appropriate function. Lookups are counted once for
+    each type of address asked for, so an AF_UNSPEC lookup counts twice.
+
+    \headerfile kos/net.h
+*/
+typedef struct net_dns_stats {
+    uint32  cache_hits;             /**< \brief Lookups answered by the cache */
+    uint32  cache_neg_hits;         /**< \brief Hits for names with no address */
+    uint32  cache_misses;           /**< \brief Lookups sent to a server */
+    uint32  queries_sent;           /**< \brief Query packets sent out */
+    uint32  timeouts;               /**< \brief Attempts that got no answer */
+    uint32  failovers;              /**< \brief Retries with the next server */
+    uint32  entries;                /**< \brief Unexpired entries in the cache */
+} net_dns_stats_t;
+
+/** \brief  Retrieve statistics from the DNS resolver.
+
+    \return                 The DNS resolver stats struct.
+*/
+net_dns_stats_t net_dns_get_stats(void);
+
+/** \brief  Throw away everything in the DNS cache.
+
+    This is useful when the network changes, or if a name is known to have
+    moved before its TTL runs out.
+*/
+void net_dns_flush(void);
+
+/** \brief  Set the DNS servers to fall back on.
+
+    These servers are asked, in order, when the default device's DNS server
+    doesn't answer (or if it doesn't have one). When a DHCP server hands out
+    more than one DNS server, the rest of them are set here. Addresses of all
+    zeroes are ignored.
+
+    \param  servers         The IPv4 addresses of the servers.
+    \param  count           The number of servers, at most
+                            NET_DNS_MAX_SERVERS. Pass 0 to clear the list.
+
+    \retval 0               On success.
+    \retval -1              On error, errno is set to EINVAL.
+*/
+int net_dns_set_servers(const uint8 servers[][4], int count);
+
+/** @} */
+
 /***** net_crc.c **********************************************************/
 
 /** \defgroup networking_crc    CRC
@@ -919,6 +1010,90 @@ void net_multicast_shutdown(void);
 
 /** @} */
 
+/***** net_vnic.c *********************************************************/
+
+/** \defgroup networking_vnic   Virtual Device
+    \brief                      A memory-backed network device for testing
+    \ingroup                    networking_drivers
+
+    A virtual network device receives the frames it's given, and keeps the
+    frames the stack transmits so that they can be looked at. This lets the
+    network stack be tested and benchmarked without any network hardware.
+
+    Give the device an address (and make it the default device, if it's to be
+    used with sockets) after creating it, and build frames to inject as they
+    would arrive from the wire, starting with the Ethernet header.
+*/
+
+/** \brief   Statistics for a virtual network device.
+    \ingroup networking_vnic
+    \headerfile kos/net.h
+*/
+typedef struct net_vnic_stats {
+    uint32 rx_frames;   /**< \brief Frames injected */
+    uint32 rx_dropped;  /**< \brief Frames dropped as the ring was full */
+    uint32 rx_irqs;     /**< \brief Receive interrupts raised */
+    uint32 tx_frames;   /**< \brief Frames transmitted */
+    uint32 tx_dropped;  /**< \brief Frames dropped as nobody captured them */
+} net_vnic_stats_t;
+
+/** \brief   Create and register a virtual network device.
+    \ingroup networking_vnic
+
+    The device is started straight away.
+
+    \param  mac             The MAC address to give the device.
+    \param  frames          How many frames each way the device can hold.
+
+    \return                 The new device, or NULL on error (errno set to
+                            EINVAL or ENOMEM).
+*/
+netif_t *net_vnic_create(const uint8 mac[6], int frames);
+
+/** \brief   Unregister and free a virtual network device.
+    \ingroup networking_vnic
+
+    \param  nif             The device, from net_vnic_create().
+*/
+void net_vnic_destroy(netif_t *nif);
+
+/** \brief   Receive a frame on a virtual network device.
+    \ingroup networking_vnic
+
+    The frame is copied, and passed up the stack later by the network polling
+    thread. This is safe to call from an interrupt handler.
+
+    \param  nif             The device, from net_vnic_create().
+    \param  frame           The frame, starting with the Ethernet header.
+    \param  len             The length of the frame, in bytes.
+
+    \retval 0               On success.
+    \retval -1              On error (errno set to EMSGSIZE if the frame is too
+                            short or too long, or ENOBUFS if the device is
+                            full or stopped).
+*/
+int net_vnic_inject(netif_t *nif, const uint8 *frame, int len);
+
+/** \brief   Take the oldest frame transmitted on a virtual network device.
+    \ingroup networking_vnic
+
+    \param  nif             The device, from net_vnic_create().
+    \param  buf             Where to copy the frame.
+    \param  len             The size of buf. Any more of the frame is lost.
+
+    \return                 The number of bytes copied, or -1 if no frames
+                            are waiting (errno set to EAGAIN).
+*/
+int net_vnic_capture(netif_t *nif, uint8 *buf, int len);
+
+/** \brief   Get the statistics of a virtual network device.
+    \ingroup networking_vnic
+
+    \param  nif             The device, from net_vnic_create().
+    \param  stats           Where to store the statistics.
+*/
+void net_vnic_get_stats(netif_t *nif, net_vnic_stats_t *stats);
+
 /***** net_core.c *********************************************************/
 
 /** \brief   Interface list; note: do not manipulate directly! 
@@ -968,6 +1143,34 @@ int net_reg_device(netif_t *device);
 */
 int net_unreg_device(netif_t *device);
 
+/** \brief   Schedule a network device to have its received frames polled.
+    \ingroup networking_drivers
+
+    Rather than pass each frame up from its interrupt handler, a driver can
+    mask its receive interrupt and call this. The network polling thread then
+    calls the device's if_poll() to pass up a budget of NET_POLL_BUDGET frames
+    at a time until the driver calls net_poll_complete(). Under heavy traffic,
+    this takes one interrupt per burst of frames instead of one per frame, and
+    the frames are handled in a thread that shares the CPU fairly with the
+    program.
+
+    This is safe to call from an interrupt handler. It does nothing if the
+    device is already scheduled or being polled.
+
+    \param  device          The device with frames waiting.
+*/
+void net_poll_schedule(netif_t *device);
+
+/** \brief   Stop polling a network device.
+    \ingroup networking_drivers
+
+    A device's if_poll() calls this when it has no more frames waiting, before
+    unmasking its receive interrupt.
+
+    \param  device          The device that has been polled.
+*/
+void net_poll_complete(netif_t *device);
+
 /** \brief   Init network support.
     \ingroup networking_drivers
     
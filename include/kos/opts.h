@@ -2,6 +2,7 @@
 
    kos/opts.h
    Copyright (C) 2014 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /** \file    kos/opts.h
@@ -124,6 +125,12 @@ __BEGIN_DECLS
 #define FS_ROMDISK_MAX_FILES 16
 #endif
 
+/** \brief  The number of unpacked blocks of packed romdisk files that are kept
+            cached. Each one takes up one block (4KB by default). */
+#ifndef FS_ROMDISK_CACHE_BLOCKS
+#define FS_ROMDISK_CACHE_BLOCKS 4
+#endif
+
 /** \brief  The maximum number of ramdisk files that can be open at a time. */
 #ifndef FS_RAMDISK_MAX_FILES
 #define FS_RAMDISK_MAX_FILES 8
@@ -136,6 +143,43 @@ __BEGIN_DECLS
 #define FD_SETSIZE 1024
 #endif
 
+/** \brief  The number of DNS results that getaddrinfo() keeps cached. Each
+            name takes up one entry for its IPv4 addresses and one for its IPv6
+            addresses. */
+#ifndef NET_DNS_CACHE_ENTRIES
+#define NET_DNS_CACHE_ENTRIES 16
+#endif
+
+/** \brief  The default size of a UDP socket's receive buffer, in bytes. This
+            is allocated when the socket is created, and can be changed per
+            socket with the SO_RCVBUF option. Datagrams that don't fit are
+            dropped, except that a socket still using the default has it
+            grown when a datagram arrives that is too large to ever fit. */
+#ifndef NET_UDP_RCVBUF
+#define NET_UDP_RCVBUF (8 * 1024)
+#endif
+
+/** \brief  The most received frames a network device passes up the stack each
+            time it's polled, before the other devices and threads get a turn.
+            This only applies to devices that use net_poll_schedule(). */
+#ifndef NET_POLL_BUDGET
+#define NET_POLL_BUDGET 32
+#endif
+
+/** \brief  The default size of the ring buffer that holds messages from
+            dbglog() and dbgio_printf() while dbgio_async_start() is in effect,
+            in bytes. */
+#ifndef DBGIO_ASYNC_SIZE
+#define DBGIO_ASYNC_SIZE 16384
+#endif
+
+/** \brief  The default number of framebuffer snapshots that vid_capture() can
+            have waiting to be encoded and written out. Each one takes as much
+            memory as the framebuffer. */
+#ifndef VID_CAPTURE_BUFFERS
+#define VID_CAPTURE_BUFFERS 2
+#endif
+
 /** @} */
 
 __END_DECLS
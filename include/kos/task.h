@@ -0,0 +1,311 @@
+/* KallistiOS ##version##
+
+   include/kos/task.h
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/** \file    kos/task.h
+    \brief   Task pools, with dependencies and futures.
+    \ingroup kthreads_tasks
+
+    This file contains a task system built on top of the threaded workers of
+    kos/worker_thread.h. A task pool runs a number of worker threads, that all
+    pick tasks from a common ready queue sorted by task priority. Tasks can
+    depend on other tasks, in which case they only become ready once all of
+    their dependencies have completed, and can be waited on like futures to
+    retrieve their return value.
+
+    Latches and a parallel-for helper are also provided, for the common case
+    of splitting a loop across the threads of a pool.
+
+    \see    kos/worker_thread.h
+*/
+
+#ifndef __KOS_TASK_H
+#define __KOS_TASK_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <kos/thread.h>
+
+/** \defgroup kthreads_tasks   Task Pools
+    \brief                    KOS task system for kernel threads
+    \ingroup                  kthreads
+
+    A task is a function call that is run asynchronously by one of the
+    threads of a task pool. Tasks are created with thd_task_create(), may be
+    given a priority and dependencies, and are then handed over to a pool with
+    thd_task_submit(). Their creator keeps a reference to them, which can be
+    used to wait for their completion and get their return value, and must be
+    dropped with thd_task_destroy() once the task is not needed anymore.
+
+    \warning
+    Waiting on a task or a latch from within a task blocks the worker thread.
+    If all the threads of a pool do so, the tasks they wait for never run.
+    Prefer dependencies to order tasks within a pool.
+
+    @{
+*/
+
+/** \brief  Opaque structure describing a pool of worker threads. */
+typedef struct kthread_pool kthread_pool_t;
+
+/** \brief  Opaque structure describing one task. */
+typedef struct kthread_task kthread_task_t;
+
+/** \brief  Latch type.
+
+    A latch is a counter that threads can wait on until it reaches zero. It
+    can't be reset once it did.
+
+    \headerfile kos/task.h
+*/
+typedef struct kthread_latch {
+    /** \cond Opaque structure */
+    int count;
+    /** \endcond */
+} kthread_latch_t;
+
+/** \brief  Initializer for a latch with the given count. */
+#define KTHREAD_LATCH_INITIALIZER(count) { (count) }
+
+/** \brief  Create a task pool.
+
+    This function creates the given number of worker threads, with the given
+    set of attributes. The label in the attributes is shared by all the
+    threads, and defaults to "[task pool]".
+
+    \param  attr            A set of thread attributes for the worker threads.
+                            Passing NULL will initialize all attributes to
+                            their default values.
+    \param  threads         The number of worker threads.
+
+    \return                 The new pool on success, NULL on failure (errno
+                            will be set to EINVAL or ENOMEM).
+
+    \sa thd_pool_destroy
+*/
+kthread_pool_t *thd_pool_create(const kthread_attr_t *attr, size_t threads);
+
+/** \brief  Destroy a task pool.
+
+    This function waits for all the tasks submitted to the pool to complete,
+    including those still waiting on their dependencies, then stops the
+    worker threads and frees the pool.
+
+    \param  pool            The pool to destroy.
+*/
+void thd_pool_destroy(kthread_pool_t *pool);
+
+/** \brief  Get the number of worker threads of a task pool.
+
+    \param  pool            The pool to query.
+    \return                 The number of worker threads.
+*/
+size_t thd_pool_get_threads(const kthread_pool_t *pool);
+
+/** \brief  Run a loop in parallel on a task pool.
+
+    This function splits the [0, count) range in chunks of \p grain items,
+    and calls \p routine on each chunk, from the worker threads of the pool
+    and from the calling thread, which also takes chunks until all of them
+    are processed. It returns once all chunks have been processed.
+
+    As the calling thread takes part in the work, it is safe to call this
+    function from within a task of the same pool.
+
+    \param  pool            The pool to run the loop on.
+    \param  count           The number of items to process.
+    \param  grain           The number of items per chunk, or 0 to pick one
+                            based on the number of threads of the pool.
+    \param  routine         The function to call on each chunk, with the
+                            start and end (excluded) of the chunk.
+    \param  data            A parameter to pass to the function called.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to ENOMEM). The whole
+                            range is still processed, but by the calling
+                            thread only.
+*/
+int thd_pool_parallel_for(kthread_pool_t *pool, size_t count, size_t grain,
+                          void (*routine)(size_t start, size_t end,
+                                          void *data),
+                          void *data);
+
+/** \brief  Create a task.
+
+    The task is not run until it is submitted to a pool with
+    thd_task_submit(). Its priority defaults to PRIO_DEFAULT.
+
+    \param  routine         The function to call in the task.
+    \param  data            A parameter to pass to the function called.
+
+    \return                 The new task on success, NULL on failure (errno
+                            will be set to ENOMEM).
+
+    \sa thd_task_submit, thd_task_destroy
+*/
+kthread_task_t *thd_task_create(void *(*routine)(void *), void *data);
+
+/** \brief  Release a task.
+
+    This function drops the reference to the task obtained with
+    thd_task_create(). The task is freed once it has completed, so this can
+    be called right after thd_task_submit() for fire-and-forget tasks.
+
+    A task that is released before it was submitted will never run. The
+    tasks that depend on it stop waiting for it, as if it had completed, so
+    they still run once their other dependencies are done.
+
+    \param  task            The task to release.
+*/
+void thd_task_destroy(kthread_task_t *task);
+
+/** \brief  Set the priority of a task.
+
+    Ready tasks are run in order of priority, and in submission order for
+    tasks of the same priority. As with threads, lower values mean higher
+    priorities. This does not change the priority of the worker threads.
+
+    \param  task            The task to modify. It must not be submitted yet.
+    \param  prio            The new priority.
+
+    \retval 0               On success.
+    \retval -1              If the task was already submitted (errno will be
+                            set to EBUSY).
+*/
+int thd_task_set_prio(kthread_task_t *task, prio_t prio);
+
+/** \brief  Add a dependency to a task.
+
+    The task will not run before \p dep has completed. If \p dep has already
+    completed, this does nothing.
+
+    \param  task            The task to modify. It must not be submitted yet.
+    \param  dep             The task it depends on.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EBUSY if \p task
+                            was already submitted, EINVAL if \p task and
+                            \p dep are the same task, or ENOMEM).
+*/
+int thd_task_depend(kthread_task_t *task, kthread_task_t *dep);
+
+/** \brief  Submit a task to a pool.
+
+    The task will be run by one of the threads of the pool, once all of its
+    dependencies have completed.
+
+    \param  pool            The pool to run the task on.
+    \param  task            The task to submit.
+
+    \retval 0               On success.
+    \retval -1              If the task was already submitted (errno will be
+                            set to EBUSY).
+*/
+int thd_task_submit(kthread_pool_t *pool, kthread_task_t *task);
+
+/** \brief  Create and submit a task in one go.
+
+    This is a shorthand for thd_task_create() and thd_task_submit().
+
+    \param  pool            The pool to run the task on.
+    \param  routine         The function to call in the task.
+    \param  data            A parameter to pass to the function called.
+
+    \return                 The new task on success, NULL on failure.
+*/
+kthread_task_t *thd_task_run(kthread_pool_t *pool,
+                             void *(*routine)(void *), void *data);
+
+/** \brief  Check whether a task has completed.
+
+    \param  task            The task to check.
+    \return                 true if the task has completed, false otherwise.
+*/
+bool thd_task_done(const kthread_task_t *task);
+
+/** \brief  Wait for a task to complete, with a timeout.
+
+    \param  task            The task to wait for.
+    \param  rv              If not NULL, where to store the return value of
+                            the task.
+    \param  timeout         The maximum time to wait, in milliseconds, or 0 to
+                            wait forever.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to ETIMEDOUT, or
+                            EPERM if called inside an interrupt).
+*/
+int thd_task_wait_timed(kthread_task_t *task, void **rv, int timeout);
+
+/** \brief  Wait for a task to complete.
+
+    \param  task            The task to wait for.
+    \param  rv              If not NULL, where to store the return value of
+                            the task.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EPERM if called
+                            inside an interrupt).
+*/
+static inline int thd_task_wait(kthread_task_t *task, void **rv) {
+    return thd_task_wait_timed(task, rv, 0);
+}
+
+/** \brief  Initialize a latch.
+
+    \param  latch           The latch to initialize.
+    \param  count           The initial value of the counter.
+*/
+void thd_latch_init(kthread_latch_t *latch, int count);
+
+/** \brief  Decrement the counter of a latch.
+
+    Threads waiting on the latch are woken up when the counter reaches zero.
+    This function is safe to call inside an interrupt.
+
+    \param  latch           The latch to count down.
+    \param  n               The value to subtract from the counter.
+*/
+void thd_latch_count_down(kthread_latch_t *latch, int n);
+
+/** \brief  Check whether the counter of a latch has reached zero.
+
+    \param  latch           The latch to check.
+    \return                 true if the counter has reached zero.
+*/
+bool thd_latch_done(const kthread_latch_t *latch);
+
+/** \brief  Wait for the counter of a latch to reach zero, with a timeout.
+
+    \param  latch           The latch to wait on.
+    \param  timeout         The maximum time to wait, in milliseconds, or 0 to
+                            wait forever.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to ETIMEDOUT, or
+                            EPERM if called inside an interrupt).
+*/
+int thd_latch_wait_timed(kthread_latch_t *latch, int timeout);
+
+/** \brief  Wait for the counter of a latch to reach zero.
+
+    \param  latch           The latch to wait on.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EPERM if called
+                            inside an interrupt).
+*/
+static inline int thd_latch_wait(kthread_latch_t *latch) {
+    return thd_latch_wait_timed(latch, 0);
+}
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __KOS_TASK_H */
@@ -5,6 +5,7 @@
    Copyright (C) 2009, 2010, 2016, 2023 Lawrence Sebald
    Copyright (C) 2023 Colton Pawielski
    Copyright (C) 2023, 2024 Falco Girgis
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -245,11 +246,14 @@ typedef __attribute__((aligned(32))) struct kthread {
     /** \brief  Our reent struct for newlib. */
     struct _reent thd_reent;
 
-    /** \brief  OS-level thread-local storage.
+    /** \brief  OS-level thread-local storage, indexed by key - 1.
 
         \see    kos/tls.h
     */
-    struct kthread_tls_kv_list tls_list;
+    void **tls_slots;
+
+    /** \brief  Number of entries in tls_slots. */
+    size_t tls_size;
 
     /** \brief Compiler-level thread-local storage. */
     void *tls_hnd;
@@ -700,6 +704,28 @@ int thd_set_hz(unsigned int hertz);
 */
 unsigned thd_get_hz(void);
 
+/** \brief   Set the limits of the thread recycling cache.
+
+    Creating a thread normally allocates its control block and its stack from
+    the heap, and destroying it frees both. When the recycling cache is
+    enabled, they are kept around when a thread is destroyed, and reused by
+    the next threads that are created, which makes creating short-lived
+    threads much faster and avoids fragmenting the heap.
+
+    Stacks are cached by size class, each class being a power of two between
+    1 KiB and 256 KiB. While the stack cache is enabled, the stacks allocated
+    by the kernel have their size rounded up to their size class. Stacks that
+    are provided by the caller are never cached.
+
+    The cache is disabled by default. Lowering the limits frees cached blocks
+    and stacks until the cache fits, so both limits can be set to 0 to empty
+    it.
+
+    \param threads          The maximum number of control blocks to cache.
+    \param stack_bytes      The maximum number of bytes of stacks to cache.
+*/
+void thd_set_cache_limits(size_t threads, size_t stack_bytes);
+
 /** \brief       Wait for a thread to exit.
     \relatesalso kthread_t
 
@@ -2,6 +2,7 @@
 
    include/kos/tls.h
    Copyright (C) 2009, 2010 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -22,36 +23,22 @@
 
 __BEGIN_DECLS
 
-#include <sys/queue.h>
+#include <stddef.h>
 
 /** \brief  Thread-local storage key type. */
 typedef int kthread_key_t;
 
-/** \brief  Thread-local storage key-value pair.
+/** \brief  Maximum number of rounds of TLS destructor calls.
 
-    This is the structure that is actually used to store the specific value for
-    a thread for a single TLS key.
-
-    You will not end up using these directly at all in programs, as they are
-    only used internally.
+    When a thread exits, the destructors of all the keys that still have a
+    non-NULL value in that thread are called. As destructors may set new
+    values, this is repeated until no value is left, but at most this many
+    times. Values that are still set after the last round are discarded.
 */
-typedef struct kthread_tls_kv {
-    /** \brief  List handle -- NOT a function. */
-    LIST_ENTRY(kthread_tls_kv) kv_list;
-
-    /** \brief  The key associated with this data. */
-    kthread_key_t key;
-
-    /** \brief  The value of the data. */
-    void *data;
-
-    /** \brief  Optional destructor for the value (set per key). */
-    void (*destructor)(void *);
-} kthread_tls_kv_t;
+#define KTHREAD_DESTRUCTOR_ITERATIONS   4
 
 /** \cond */
-/* TLS Key-Value pair list type. */
-LIST_HEAD(kthread_tls_kv_list, kthread_tls_kv);
+struct kthread;
 /** \endcond */
 
 /** \cond */
@@ -95,12 +82,16 @@ void *kthread_getspecific(kthread_key_t key);
 
     This function sets the thread-specific data associated with the given key.
 
+    The values of each thread are stored in an array indexed by key, which is
+    allocated on the first call in that thread, and only grows again if keys
+    are created afterwards.
+
     \param  key     The key to set data for.
     \param  value   The thread-specific value to use.
     \retval -1      On failure, and sets errno to one of the following: EINVAL
                     if the key is not valid, ENOMEM if out of memory, or EPERM
-                    if called inside an interrupt and another call is in
-                    progress.
+                    if called inside an interrupt and the array would need to
+                    grow while malloc is unsafe.
     \retval 0       On success.
 */
 int kthread_setspecific(kthread_key_t key, const void *value);
@@ -112,7 +103,7 @@ int kthread_setspecific(kthread_key_t key, const void *value);
 
     \param  key     The key to delete.
     \retval -1      On failure, and sets errno to one of the following: EINVAL
-                    if the key is invalid, EPERM if unsafe to call free.
+                    if the key is invalid.
     \retval 0       On success.
 */
 int kthread_key_delete(kthread_key_t key);
@@ -122,6 +113,12 @@ int kthread_key_delete(kthread_key_t key);
    only! */
 void kthread_key_delete_destructor(kthread_key_t key);
 
+/* Run the destructors of the current thread's values, at thread exit. */
+void kthread_tls_run_destructors(void);
+
+/* Free the TLS values of a thread being destroyed. */
+void kthread_tls_free(struct kthread *thd);
+
 /* Initialization and shutdown. Once again, internal use only. */
 int kthread_tls_init(void);
 void kthread_tls_shutdown(void);
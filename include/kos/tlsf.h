@@ -0,0 +1,185 @@
+/* KallistiOS ##version##
+
+   include/kos/tlsf.h
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/** \file    kos/tlsf.h
+    \brief   Two-Level Segregated Fit allocator for external memory pools.
+    \ingroup system_tlsf
+
+    This file contains a generic allocator for memory pools that the CPU
+    either cannot or should not use to hold bookkeeping data, like video RAM
+    or sound RAM. All the allocator metadata lives in main RAM, and the
+    managed pool is only ever described by addresses.
+*/
+
+#ifndef __KOS_TLSF_H
+#define __KOS_TLSF_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** \defgroup system_tlsf   TLSF Allocator
+    \brief                 Constant-time allocator for external memory pools
+    \ingroup               system
+
+    The TLSF (Two-Level Segregated Fit) allocator keeps free blocks in
+    size-segregated lists indexed by two levels of bitmaps, so that both
+    allocating and freeing run in constant time, regardless of how many blocks
+    the pool holds. Free blocks are merged with their neighbours immediately.
+
+    Block descriptors are allocated from the main heap with malloc(), and
+    allocated blocks are looked up by address through a hash table, so the
+    managed memory itself is never touched by the allocator. This allows it to
+    manage memory that is slow to access or not mapped at all.
+
+    This module has no dependencies on the rest of KOS, and can be built on
+    the host for testing and benchmarking.
+
+    \note
+    The allocator does no locking; concurrent users must provide their own.
+
+    @{
+*/
+
+/** \brief  Opaque TLSF pool type. */
+typedef struct tlsf_pool tlsf_pool_t;
+
+/** \brief  Usage statistics of a TLSF pool.
+    \see    tlsf_get_stats()
+*/
+typedef struct tlsf_stats {
+    size_t total;           /**< \brief Size of the pool, in bytes */
+    size_t used;            /**< \brief Bytes in allocated blocks */
+    size_t free;            /**< \brief Bytes in free blocks */
+    size_t largest_free;    /**< \brief Size of the largest free block */
+    size_t used_blocks;     /**< \brief Number of allocated blocks */
+    size_t free_blocks;     /**< \brief Number of free blocks */
+
+    /** \brief  External fragmentation, in percent.
+
+        This is the share of the free memory that is not part of the largest
+        free block: 0 means that all the free memory can be allocated in one
+        go, and values close to 100 mean that it is scattered in small holes.
+    */
+    unsigned int fragmentation;
+} tlsf_stats_t;
+
+/** \brief  An entry of the remap table produced by tlsf_compact(). */
+typedef struct tlsf_remap {
+    uintptr_t from;         /**< \brief Old address of the block */
+    uintptr_t to;           /**< \brief New address of the block */
+    size_t    size;         /**< \brief Size of the block, in bytes */
+} tlsf_remap_t;
+
+/** \brief  Block move callback for tlsf_compact().
+
+    This function must copy \p size bytes from \p src to \p dst. The new
+    location is always below the old one, but the two may overlap.
+
+    \param  dst             The address to copy the block to.
+    \param  src             The current address of the block.
+    \param  size            The size of the block, in bytes.
+    \param  data            The user data passed to tlsf_compact().
+    \retval 0               On success.
+    \retval -1              On failure, which stops the compaction.
+*/
+typedef int (*tlsf_move_t)(uintptr_t dst, uintptr_t src, size_t size,
+                           void *data);
+
+/** \brief  Create a TLSF pool.
+
+    \param  base            The base address of the pool. Must not be 0, and
+                            must be aligned to \p granule.
+    \param  size            The size of the pool, in bytes.
+    \param  granule         The allocation granularity, in bytes. Must be a
+                            power of two. All blocks are aligned to and sized
+                            in multiples of this value.
+    \return                 The new pool, or NULL on error (errno will be set
+                            to EINVAL or ENOMEM).
+*/
+tlsf_pool_t *tlsf_create(uintptr_t base, size_t size, size_t granule);
+
+/** \brief  Destroy a TLSF pool, and free all of its metadata.
+    \param  pool            The pool to destroy.
+*/
+void tlsf_destroy(tlsf_pool_t *pool);
+
+/** \brief  Free all the blocks of a TLSF pool at once.
+    \param  pool            The pool to reset.
+*/
+void tlsf_reset(tlsf_pool_t *pool);
+
+/** \brief  Allocate a block from a TLSF pool.
+
+    \param  pool            The pool to allocate from.
+    \param  size            The number of bytes to allocate. It will be
+                            rounded up to the pool's granule.
+    \param  align           The required alignment, which must be a power of
+                            two, or 0 for the pool's granule.
+    \return                 The address of the new block, or 0 on error (errno
+                            will be set to EINVAL or ENOMEM).
+*/
+uintptr_t tlsf_alloc(tlsf_pool_t *pool, size_t size, size_t align);
+
+/** \brief  Free a block of a TLSF pool.
+
+    \param  pool            The pool the block was allocated from.
+    \param  addr            The address of the block.
+    \retval 0               On success.
+    \retval -1              If \p addr is not an allocated block.
+*/
+int tlsf_free(tlsf_pool_t *pool, uintptr_t addr);
+
+/** \brief  Get the size of an allocated block.
+
+    \param  pool            The pool the block was allocated from.
+    \param  addr            The address of the block.
+    \return                 The size of the block in bytes, after rounding to
+                            the pool's granule, or 0 if \p addr is not an
+                            allocated block.
+*/
+size_t tlsf_block_size(const tlsf_pool_t *pool, uintptr_t addr);
+
+/** \brief  Get the usage statistics of a TLSF pool.
+
+    This walks all the blocks of the pool, so it runs in linear time.
+
+    \param  pool            The pool to inspect.
+    \param  stats           Where to store the statistics.
+*/
+void tlsf_get_stats(const tlsf_pool_t *pool, tlsf_stats_t *stats);
+
+/** \brief  Compact a TLSF pool.
+
+    This function slides allocated blocks down towards the base of the pool,
+    so that the free memory ends up in a single block at the top. Blocks keep
+    the alignment they were allocated with, so a block that needs more than
+    the pool's granule may leave a little free memory below it. The data of
+    each block is relocated through the \p move callback, and every relocation
+    is recorded in the \p remap table, so that the caller can patch up its own
+    references to the moved blocks.
+
+    Compaction stops early if the remap table is full or if a move fails; the
+    pool is consistent in either case, and the table describes all the moves
+    that were done.
+
+    \param  pool            The pool to compact.
+    \param  move            The callback used to move a block.
+    \param  data            User data passed to \p move.
+    \param  remap           The remap table to fill.
+    \param  max             The number of entries of \p remap.
+    \return                 The number of blocks that were moved.
+*/
+size_t tlsf_compact(tlsf_pool_t *pool, tlsf_move_t move, void *data,
+                    tlsf_remap_t *remap, size_t max);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __KOS_TLSF_H */
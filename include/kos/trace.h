@@ -0,0 +1,206 @@
+/* KallistiOS ##version##
+
+   include/kos/trace.h
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/** \file    kos/trace.h
+    \brief   Scheduler and IRQ event tracing.
+    \ingroup trace
+
+    This file contains the kernel event tracing API. When enabled, the kernel
+    records context switches, interrupts, waits, wake-ups and mutex contention
+    into a ring buffer, together with user-defined spans. The result can be
+    exported as JSON and loaded into chrome://tracing or Perfetto.
+*/
+
+#ifndef __KOS_TRACE_H
+#define __KOS_TRACE_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <kos/cdefs.h>
+#include <arch/types.h>
+
+/** \defgroup trace Event tracing
+    \brief      Timeline tracing of kernel and user events
+    \ingroup    debugging
+
+    The tracing system records timestamped events into a fixed-size ring
+    buffer allocated by trace_init(). Recording an event never blocks and never
+    allocates, so it can be done from thread or interrupt context. When the
+    ring buffer is full, the oldest events are overwritten.
+
+    While tracing is stopped, each kernel hook costs a single load and branch.
+
+    \warning
+    Event names are stored as pointers, and are only dereferenced when the
+    trace is exported. They must therefore point to strings that are still
+    valid at that point, typically string literals.
+
+    @{
+*/
+
+/** \brief  Types of trace events. */
+typedef enum trace_type {
+    TRACE_SWITCH,       /**< \brief Context switch, arg is the new thread ID */
+    TRACE_IRQ_ENTER,    /**< \brief Interrupt entry, arg is the event code */
+    TRACE_IRQ_EXIT,     /**< \brief Interrupt exit, arg is the event code */
+    TRACE_WAIT_BEGIN,   /**< \brief Thread starts blocking on an object */
+    TRACE_WAIT_END,     /**< \brief Thread stops blocking on an object */
+    TRACE_WAKE,         /**< \brief Thread woken up, arg is its thread ID */
+    TRACE_LOCK_BEGIN,   /**< \brief Contended lock, arg is the lock */
+    TRACE_LOCK_END,     /**< \brief Contended lock acquired or timed out */
+    TRACE_SPAN_BEGIN,   /**< \brief Beginning of a user span */
+    TRACE_SPAN_END,     /**< \brief End of a user span */
+    TRACE_INSTANT,      /**< \brief User instant event */
+    TRACE_COUNTER       /**< \brief User counter value, arg is the value */
+} trace_type_t;
+
+/** \brief  A single trace event. */
+typedef struct trace_event {
+    uint64_t     ts;    /**< \brief Timestamp, in nanoseconds */
+    const char  *name;  /**< \brief Event name (may be NULL) */
+    uintptr_t    arg;   /**< \brief Event-specific argument */
+    tid_t        tid;   /**< \brief Thread ID (0 for interrupts) */
+    trace_type_t type;  /**< \brief Event type */
+} trace_event_t;
+
+/** \cond */
+extern volatile bool __trace_active;
+
+void __trace_record(trace_type_t type, const char *name, uintptr_t arg);
+/** \endcond */
+
+/** \brief  Record a trace event.
+
+    This is the function used by the kernel hooks. It does nothing if tracing
+    is not currently running.
+
+    \param  type            The type of the event.
+    \param  name            The name of the event.
+    \param  arg             The type-specific argument.
+*/
+static __always_inline void trace_event(trace_type_t type, const char *name,
+                                        uintptr_t arg) {
+    if(__unlikely(__trace_active))
+        __trace_record(type, name, arg);
+}
+
+/** \brief  Begin a user span on the current thread.
+    \param  name            The name of the span.
+    \sa trace_end
+*/
+static inline void trace_begin(const char *name) {
+    trace_event(TRACE_SPAN_BEGIN, name, 0);
+}
+
+/** \brief  End the innermost user span on the current thread.
+    \param  name            The name of the span (should match trace_begin()).
+    \sa trace_begin
+*/
+static inline void trace_end(const char *name) {
+    trace_event(TRACE_SPAN_END, name, 0);
+}
+
+/** \brief  Record a user instant event on the current thread.
+    \param  name            The name of the event.
+*/
+static inline void trace_instant(const char *name) {
+    trace_event(TRACE_INSTANT, name, 0);
+}
+
+/** \brief  Record the value of a user counter.
+    \param  name            The name of the counter.
+    \param  value           The current value of the counter.
+*/
+static inline void trace_counter(const char *name, uint32_t value) {
+    trace_event(TRACE_COUNTER, name, value);
+}
+
+/** \cond */
+static inline void __trace_span_cleanup(const char **name) {
+    trace_end(*name);
+}
+
+#define __trace_scope(n, l) \
+    const char *__trace_scope_##l \
+        __attribute__((cleanup(__trace_span_cleanup))) = (trace_begin(n), (n))
+
+#define _trace_scope(n, l) __trace_scope(n, l)
+/** \endcond */
+
+/** \brief  Record a user span lasting until the end of the current block.
+    \param  name            The name of the span.
+*/
+#define trace_scope(name) _trace_scope(name, __LINE__)
+
+/** \brief  Initialize the tracing system.
+
+    This function allocates the event ring buffer. It does not start recording
+    events; use trace_start() for that.
+
+    \param  events          The number of events the ring buffer can hold. It
+                            will be rounded up to a power of two.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - events is 0 \n
+    \em     EBUSY - the tracing system is already initialized \n
+    \em     ENOMEM - out of memory
+*/
+int trace_init(size_t events);
+
+/** \brief  Shut down the tracing system and free the ring buffer. */
+void trace_shutdown(void);
+
+/** \brief  Start recording events.
+    \retval 0               On success.
+    \retval -1              If the tracing system is not initialized.
+*/
+int trace_start(void);
+
+/** \brief  Stop recording events. */
+void trace_stop(void);
+
+/** \brief  Discard all the recorded events. */
+void trace_clear(void);
+
+/** \brief  Get the number of events that were overwritten.
+    \return                 The number of events lost because the ring buffer
+                            wrapped around since the last trace_clear().
+*/
+uint32_t trace_overruns(void);
+
+/** \brief  Copy the recorded events.
+
+    This function copies the recorded events, oldest first. Tracing should be
+    stopped while doing so.
+
+    \param  out             Where to store the events.
+    \param  count           The maximum number of events to copy.
+    \return                 The number of events copied.
+*/
+size_t trace_get_events(trace_event_t *out, size_t count);
+
+/** \brief  Export the recorded events as Chrome trace event JSON.
+
+    Recording is paused while the file is written, and resumed afterwards if
+    it was running.
+
+    \param  fn              The path of the file to write.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+*/
+int trace_write_json(const char *fn);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __KOS_TRACE_H */
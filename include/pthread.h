@@ -2,6 +2,7 @@
 
    pthread.h
    Copyright (C) 2023, 2024 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -39,6 +40,8 @@
 #include <sched.h>
 #include <time.h>
 
+#include <kos/tls.h>
+
 __BEGIN_DECLS
 
 /* Process shared/private flag. Since we don't support multiple processes, these
@@ -63,6 +66,8 @@ __BEGIN_DECLS
 #define PTHREAD_STACK_MIN           256
 #define PTHREAD_STACK_MIN_ALIGNMENT 32
 
+#define PTHREAD_DESTRUCTOR_ITERATIONS   KTHREAD_DESTRUCTOR_ITERATIONS
+
 /* Threads */
 int pthread_create(pthread_t *__RESTRICT thread,
                    const pthread_attr_t *__RESTRICT attr,
@@ -0,0 +1,69 @@
+/* KallistiOS ##version##
+
+   sys/sendfile.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+*/
+
+/** \file    sys/sendfile.h
+    \brief   Copying data from a file to a socket.
+    \ingroup networking_sockets
+
+    This file contains the definition of sendfile(), which sends the contents
+    of a file out on a socket without the caller having to read it into a
+    buffer of its own first. It is not part of POSIX, but matches the function
+    of the same name found on Linux.
+
+    \author KallistiOS Contributors
+*/
+
+#ifndef __SYS_SENDFILE_H
+#define __SYS_SENDFILE_H
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS
+
+/** \addtogroup networking_sockets
+    @{
+*/
+
+/** \brief  Send data from a file on a socket (non-standard).
+
+    This function sends up to count bytes from in_fd out on out_sock. If the
+    filesystem that in_fd is on supports fs_mmap() (romdisks and ramdisks do),
+    the data is passed to the socket straight out of the mapping. Otherwise, it
+    is read through a small temporary buffer.
+
+    Like send(), this function may send less than count bytes if out_sock is in
+    non-blocking mode and its send buffer fills up. If an error happens after
+    some of the data has been sent, the amount sent so far is returned.
+
+    \param  out_sock        The socket to send on.
+    \param  in_fd           The file to read from.
+    \param  offset          If not NULL, the offset in the file to start from.
+                            It is updated to just past the last byte sent, and
+                            the file position of in_fd is left alone. If NULL,
+                            reading starts at the file position of in_fd, which
+                            is moved past the last byte sent.
+    \param  count           The maximum number of bytes to send.
+
+    \return                 The number of bytes sent (0 at the end of the file)
+                            on success, or -1 on error (setting errno as
+                            appropriate).
+
+    \par    Error Conditions:
+    \em     EBADF - out_sock or in_fd is not a valid file descriptor \n
+    \em     ENOTSOCK - out_sock is not a socket \n
+    \em     EINVAL - in_fd can't be seeked, and offset was given \n
+    \em     ENOMEM - no memory for the temporary buffer \n
+    \em     Any error from send() or fs_read()
+*/
+ssize_t sendfile(int out_sock, int in_fd, off_t *offset, size_t count);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __SYS_SENDFILE_H */
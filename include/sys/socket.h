@@ -2,6 +2,7 @@
 
    sys/socket.h
    Copyright (C) 2006, 2010, 2012, 2017 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -27,6 +28,8 @@
 
 __BEGIN_DECLS
 
+struct timespec;
+
 /** \defgroup networking_sockets    Sockets
     \brief                          POSIX Sockets Interface for IPv4 and IPv6
                                     Address Families
@@ -105,6 +108,30 @@ struct sockaddr_storage {
 */
 #define SOCK_STREAM 2
 
+/** \brief  Message header for sendmsg() and recvmsg().
+    \headerfile sys/socket.h
+
+    Ancillary data is not supported, so msg_control is ignored on sending and
+    msg_controllen is always set to 0 on receipt.
+*/
+struct msghdr {
+    void *msg_name;             /**< \brief Peer address (can be NULL) */
+    socklen_t msg_namelen;      /**< \brief Size of the peer address */
+    struct iovec *msg_iov;      /**< \brief Scatter/gather array */
+    int msg_iovlen;             /**< \brief Elements in msg_iov */
+    void *msg_control;          /**< \brief Ancillary data (unsupported) */
+    socklen_t msg_controllen;   /**< \brief Size of the ancillary data */
+    int msg_flags;              /**< \brief Flags on the received message */
+};
+
+/** \brief  Message header for sendmmsg() and recvmmsg() (non-standard).
+    \headerfile sys/socket.h
+*/
+struct mmsghdr {
+    struct msghdr msg_hdr;      /**< \brief The message */
+    unsigned int msg_len;       /**< \brief Bytes sent or received */
+};
+
 /** \brief  Socket-level option setting.
 
     This constant should be used with the setsockopt() or getsockopt() function
@@ -147,6 +174,7 @@ struct sockaddr_storage {
 #define SO_SNDLOWAT     14  /**< \brief Send low-water mark (get/set) */
 #define SO_SNDTIMEO     15  /**< \brief Send timeout value (get/set) */
 #define SO_TYPE         16  /**< \brief Socket type (get) */
+#define SO_RCVDROPS     17  /**< \brief Datagrams dropped with a full receive buffer (get, non-standard) */
 /** @} */
 
 /** \defgroup msg_flags                 Message Flags
@@ -168,9 +196,10 @@ struct sockaddr_storage {
 #define MSG_EOR         0x04    /**< \brief Terminate a record (U) */
 #define MSG_OOB         0x08    /**< \brief Out-of-band data (U) */
 #define MSG_PEEK        0x10    /**< \brief Leave received data in queue */
-#define MSG_TRUNC       0x20    /**< \brief Normal data truncated (U) */
+#define MSG_TRUNC       0x20    /**< \brief Normal data truncated */
 #define MSG_WAITALL     0x40    /**< \brief Attempt to fill read buffer */
 #define MSG_DONTWAIT    0x80    /**< \brief Make this call non-blocking (non-standard) */
+#define MSG_WAITFORONE  0x100   /**< \brief Only block for the first message of recvmmsg() (non-standard) */
 /** @} */
 
 /** \addtogroup networking_sockets
@@ -306,6 +335,44 @@ ssize_t recv(int socket, void *buffer, size_t length, int flags);
 ssize_t recvfrom(int socket, void *buffer, size_t length, int flags,
                  struct sockaddr *address, socklen_t *address_len);
 
+/** \brief  Receive a message on a socket, scattering it into buffers.
+
+    This function receives one message from a socket into the buffers in the
+    msg_iov array of the message header, and stores the peer's address in
+    msg_name if that is not NULL. On return, msg_flags has MSG_TRUNC set if
+    the message was a datagram that was too large for the buffers given.
+
+    \param  socket      The socket to receive on.
+    \param  message     The message header to fill in.
+    \param  flags       The type of message reception.
+
+    \return             On success, the length of the message in bytes. If no
+                        messages are available, and the socket has been shut
+                        down, 0. On error, -1, and sets errno as appropriate.
+*/
+ssize_t recvmsg(int socket, struct msghdr *message, int flags);
+
+/** \brief  Receive multiple messages on a socket (non-standard).
+
+    This function receives up to vlen messages with one call, which on a
+    datagram socket is much cheaper than calling recvmsg() for each of them.
+    With MSG_WAITFORONE in flags, it only waits for the first message and
+    returns as soon as there are no more queued. The msg_len field of each
+    message header is set to the number of bytes received.
+
+    \param  socket      The socket to receive on.
+    \param  msgvec      The array of message headers to fill in.
+    \param  vlen        The number of elements in msgvec.
+    \param  flags       The type of message reception.
+    \param  timeout     How long to wait for messages, or NULL to wait as long
+                        as needed. Only UDP sockets support this.
+
+    \return             The number of messages received, 0 if the socket has
+                        been shut down, or -1 on error (and sets errno).
+*/
+int recvmmsg(int socket, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout);
+
 /** \brief  Send a message on a connected socket.
 
     This function sends messages to the peer on a connected socket.
@@ -339,6 +406,37 @@ ssize_t send(int socket, const void *message, size_t length, int flags);
 ssize_t sendto(int socket, const void *message, size_t length, int flags,
                const struct sockaddr *dest_addr, socklen_t dest_len);
 
+/** \brief  Send a message on a socket, gathering it from buffers.
+
+    This function sends one message made up of the buffers in the msg_iov
+    array of the message header to the peer in msg_name, or to the connected
+    peer if that is NULL.
+
+    \param  socket      The socket to send on.
+    \param  message     The message header.
+    \param  flags       The type of message transmission. Set to 0 for now.
+
+    \return             On success, the number of bytes sent. On error, -1,
+                        and sets errno as appropriate.
+*/
+ssize_t sendmsg(int socket, const struct msghdr *message, int flags);
+
+/** \brief  Send multiple messages on a socket (non-standard).
+
+    This function sends up to vlen messages with one call. The msg_len field
+    of each message header sent is set to the number of bytes sent.
+
+    \param  socket      The socket to send on.
+    \param  msgvec      The array of message headers.
+    \param  vlen        The number of elements in msgvec.
+    \param  flags       The type of message transmission. Set to 0 for now.
+
+    \return             The number of messages sent, which may be less than
+                        vlen if one could not be. If none could be, -1 and
+                        errno is set as appropriate.
+*/
+int sendmmsg(int socket, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+
 /** \brief  Shutdown socket send and receive operations.
 
     This function closes a specific socket for the set of specified operations.
@@ -2,6 +2,7 @@
 
    threads.h
    Copyright (C) 2014 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /** \file   threads.h
@@ -440,7 +441,7 @@ extern void thrd_yield(void);
     over the destructors for thread-specific storage objects when a thread
     terminates.
 */
-#define TSS_DTOR_ITERATIONS     1
+#define TSS_DTOR_ITERATIONS     KTHREAD_DESTRUCTOR_ITERATIONS
 
 /** \brief  C11 thread-specific storage type.
 
@@ -2,6 +2,7 @@
 
    kernel/arch/dreamcast/fs/fs_dclsocket.c
    Copyright (C) 2007, 2008, 2012, 2013, 2015 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
    Based on fs_dclnative.c and related files
    Copyright (C) 2003 Megan Potter
@@ -18,6 +19,20 @@
    networked code with dcload-ip, rather than requiring a serial cable and
    dcload-serial. */
 
+/* Every read costs a few round trips to dc-tool, however little it asks
+   for, while the data itself comes back as a stream of PBIN packets that
+   aren't acknowledged one by one. So files opened read-only are read ahead
+   into a buffer of their own, with one large read each time it runs out.
+   The read-ahead starts at DCLS_WINDOW_MIN bytes, and doubles up to
+   DCLS_WINDOW_MAX for as long as the file is read in order. Reads that are
+   at least that large go straight into the caller's buffer. Seeking only
+   moves the position the program sees, and dc-tool's file is moved when
+   there's something to read from there.
+
+   Only one command can be in progress with dc-tool at a time, so the
+   socket has a mutex of its own. Reads served from a read-ahead buffer only
+   take the mutex of their file. */
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -40,6 +55,10 @@
 #define DCLOAD_PORT 31313
 #define NAME "dcload-ip over KOS sockets"
 
+#define DCLS_MAX_CACHED     8
+#define DCLS_WINDOW_MIN     8192
+#define DCLS_WINDOW_MAX     65536
+
 typedef struct {
     unsigned char id[4];
     unsigned int address;
@@ -75,6 +94,21 @@ static uint8 pktbuf[1024 + sizeof(command_t)];
 
 static int dcls_socket = -1;
 
+/* A file opened read-only */
+typedef struct {
+    uint32      hnd;        /* Our handle for the file, 0 if unused */
+    mutex_t     mutex;      /* Protects the rest of this */
+    uint32      pos;        /* Position the program sees */
+    uint32      hpos;       /* Position of the file in dc-tool */
+    uint32      start;      /* Position of the data in buf */
+    uint32      len;        /* Length of the data in buf */
+    uint32      window;     /* Length of the next read-ahead */
+    size_t      size;       /* Size of buf */
+    uint8       *buf;       /* Read-ahead buffer */
+} dcls_file_t;
+
+static dcls_file_t cached[DCLS_MAX_CACHED];
+
 static void dcls_handle_lbin(command_t *cmd) {
     bin_info.addr = ntohl(cmd->address);
     bin_info.size = ntohl(cmd->size);
@@ -105,8 +139,9 @@ static void dcls_handle_dbin(command_t *cmd) {
     else {
         cmd->address = htonl(bin_info.addr + i * 1024);
 
+        /* The last chunk is short, unless the size is a multiple of 1KB */
         if(i == (bin_info.size + 1023) / 1024 - 1) {
-            cmd->size = htonl(bin_info.size % 1024);
+            cmd->size = htonl((bin_info.size - 1) % 1024 + 1);
         }
         else {
             cmd->size = htonl(1024);
@@ -204,6 +239,211 @@ static void dcls_recv_loop(void) {
     escape = 0;
 }
 
+/* Return the read-ahead state of a handle, or NULL if it has none */
+static dcls_file_t *dcls_cached(uint32 hnd) {
+    int i;
+
+    for(i = 0; i < DCLS_MAX_CACHED; ++i) {
+        if(cached[i].hnd == hnd)
+            return &cached[i];
+    }
+
+    return NULL;
+}
+
+/* Set up read-ahead for a newly opened file. The mutex must be held: a slot
+   is only ever taken or given back with it held. */
+static void dcls_cache_open(uint32 hnd) {
+    dcls_file_t *f = dcls_cached(0);
+
+    if(!f)
+        return;
+
+    f->pos = f->hpos = 0;
+    f->start = f->len = 0;
+    f->window = DCLS_WINDOW_MIN;
+    f->hnd = hnd;
+}
+
+/* Send a read command for dc-tool's file fd; the mutex must be held */
+static int dcls_host_read(uint32 fd, void *buf, size_t cnt) {
+    command_3int_t *cmd = (command_3int_t *)pktbuf;
+
+    memcpy(cmd->id, "DC03", 4);
+    cmd->value0 = htonl(fd);
+    cmd->value1 = htonl((uint32) buf);
+    cmd->value2 = htonl((uint32) cnt);
+
+    send(dcls_socket, cmd, sizeof(command_3int_t), 0);
+    dcls_recv_loop();
+
+    return retval;
+}
+
+/* Send a seek command for dc-tool's file fd; the mutex must be held */
+static off_t dcls_host_seek(uint32 fd, off_t offset, int whence) {
+    command_3int_t *cmd = (command_3int_t *)pktbuf;
+
+    memcpy(cmd->id, "DC11", 4);
+    cmd->value0 = htonl(fd);
+    cmd->value1 = htonl((uint32)offset);
+    cmd->value2 = htonl((uint32)whence);
+
+    send(dcls_socket, cmd, sizeof(command_3int_t), 0);
+    dcls_recv_loop();
+
+    return retval;
+}
+
+/* Read from dc-tool's file at the position the program sees. The mutex of
+   the file must be held. */
+static int dcls_cache_fetch(dcls_file_t *f, void *buf, size_t cnt) {
+    int rv = -1;
+
+    if(mutex_lock_irqsafe(&mutex))
+        return -1;
+
+    if(f->hpos != f->pos) {
+        if(dcls_host_seek(f->hnd - 1, f->pos, SEEK_SET) != (off_t)f->pos)
+            goto out;
+
+        f->hpos = f->pos;
+    }
+
+    rv = dcls_host_read(f->hnd - 1, buf, cnt);
+
+    if(rv > 0)
+        f->hpos += rv;
+
+out:
+    mutex_unlock(&mutex);
+    return rv;
+}
+
+static ssize_t dcls_cache_read(dcls_file_t *f, uint8 *buf, size_t cnt) {
+    size_t done = 0, n;
+    uint8 *nbuf;
+    int rv = 0;
+
+    if(mutex_lock_irqsafe(&f->mutex))
+        return -1;
+
+    while(done < cnt) {
+        /* Copy what we already have */
+        if(f->pos >= f->start && f->pos < f->start + f->len) {
+            n = f->start + f->len - f->pos;
+
+            if(n > cnt - done)
+                n = cnt - done;
+
+            memcpy(buf + done, f->buf + (f->pos - f->start), n);
+            f->pos += n;
+            done += n;
+            continue;
+        }
+
+        /* Read further ahead while the file is read in order */
+        if(f->len && f->pos == f->start + f->len) {
+            if(f->window < DCLS_WINDOW_MAX)
+                f->window <<= 1;
+        }
+        else {
+            f->window = DCLS_WINDOW_MIN;
+        }
+
+        if(f->size < f->window) {
+            nbuf = (uint8 *)realloc(f->buf, f->window);
+
+            if(nbuf) {
+                f->buf = nbuf;
+                f->size = f->window;
+            }
+        }
+
+        /* Big reads, or any read if there's no buffer, go straight to the
+           caller's buffer */
+        if(cnt - done >= f->window || f->size < f->window) {
+            rv = dcls_cache_fetch(f, buf + done, cnt - done);
+
+            if(rv > 0) {
+                f->pos += rv;
+                done += rv;
+            }
+
+            break;
+        }
+
+        rv = dcls_cache_fetch(f, f->buf, f->window);
+
+        if(rv <= 0)
+            break;
+
+        f->start = f->pos;
+        f->len = rv;
+
+        n = (size_t)rv < cnt - done ? (size_t)rv : cnt - done;
+        memcpy(buf + done, f->buf, n);
+        f->pos += n;
+        done += n;
+
+        /* Stop at the end of the file, rather than asking again */
+        if((uint32)rv < f->window)
+            break;
+    }
+
+    mutex_unlock(&f->mutex);
+
+    if(!done && rv < 0)
+        return -1;
+
+    return done;
+}
+
+static off_t dcls_cache_seek(dcls_file_t *f, off_t offset, int whence) {
+    off_t pos;
+
+    if(mutex_lock_irqsafe(&f->mutex))
+        return -1;
+
+    switch(whence) {
+        case SEEK_SET:
+        case SEEK_CUR:
+            pos = offset + (whence == SEEK_CUR ? (off_t)f->pos : 0);
+
+            /* There's nothing before the start of the file */
+            if(pos < 0) {
+                errno = EINVAL;
+                pos = -1;
+            }
+
+            break;
+
+        case SEEK_END:
+            if(mutex_lock_irqsafe(&mutex)) {
+                pos = -1;
+                break;
+            }
+
+            pos = dcls_host_seek(f->hnd - 1, offset, SEEK_END);
+
+            if(pos >= 0)
+                f->hpos = pos;
+
+            mutex_unlock(&mutex);
+            break;
+
+        default:
+            errno = EINVAL;
+            pos = -1;
+    }
+
+    if(pos >= 0)
+        f->pos = pos;
+
+    mutex_unlock(&f->mutex);
+    return pos;
+}
+
 static void *dcls_open(struct vfs_handler *vfs, const char *fn, int mode) {
     int hnd, dcload_mode = 0;
     int mm = (mode & O_MODE_MASK);
@@ -269,6 +509,10 @@ static void *dcls_open(struct vfs_handler *vfs, const char *fn, int mode) {
         send(dcls_socket, pktbuf, sizeof(command_t) + strlen(fn) + 1, 0);
         dcls_recv_loop();
         hnd = retval + 1;
+
+        /* Read-only files are read ahead, if there's room for another */
+        if(hnd && mm == O_RDONLY)
+            dcls_cache_open(hnd);
     }
 
     mutex_unlock(&mutex);
@@ -279,10 +523,28 @@ static void *dcls_open(struct vfs_handler *vfs, const char *fn, int mode) {
 static int dcls_close(void *hnd) {
     int fd = (int) hnd;
     command_int_t *cmd = (command_int_t *)pktbuf;
+    dcls_file_t *f = fd ? dcls_cached(fd) : NULL;
 
-    if(mutex_lock_irqsafe(&mutex))
+    /* Give the read-ahead slot back with the socket mutex held too, as
+       dcls_cache_open() takes slots with only that one */
+    if(f && mutex_lock_irqsafe(&f->mutex))
         return -1;
 
+    if(mutex_lock_irqsafe(&mutex)) {
+        if(f)
+            mutex_unlock(&f->mutex);
+
+        return -1;
+    }
+
+    if(f) {
+        free(f->buf);
+        f->buf = NULL;
+        f->size = 0;
+        f->hnd = 0;
+        mutex_unlock(&f->mutex);
+    }
+
     if(fd > 100) {
         memcpy(cmd->id, "DC17", 4);
         cmd->value0 = htonl(fd);
@@ -306,27 +568,23 @@ static int dcls_close(void *hnd) {
 
 static ssize_t dcls_read(void *hnd, void *buf, size_t cnt) {
     uint32 fd = (uint32) hnd;
-    command_3int_t *cmd = (command_3int_t *)pktbuf;
+    dcls_file_t *f;
+    int rv;
 
     if(!fd)
         return -1;
 
+    if((f = dcls_cached(fd)))
+        return dcls_cache_read(f, (uint8 *)buf, cnt);
+
     if(mutex_lock_irqsafe(&mutex))
         return -1;
 
-    --fd;
-
-    memcpy(cmd->id, "DC03", 4);
-    cmd->value0 = htonl(fd);
-    cmd->value1 = htonl((uint32) buf);
-    cmd->value2 = htonl((uint32) cnt);
-
-    send(dcls_socket, cmd, sizeof(command_3int_t), 0);
-    dcls_recv_loop();
+    rv = dcls_host_read(fd - 1, buf, cnt);
 
     mutex_unlock(&mutex);
 
-    return retval;
+    return rv;
 }
 
 static ssize_t dcls_write(void *hnd, const void *buf, size_t cnt) {
@@ -356,27 +614,23 @@ static ssize_t dcls_write(void *hnd, const void *buf, size_t cnt) {
 
 static off_t dcls_seek(void *hnd, off_t offset, int whence) {
     uint32 fd = (uint32)hnd;
-    command_3int_t *command = (command_3int_t *)pktbuf;
+    dcls_file_t *f;
+    off_t rv;
 
     if(!hnd)
         return -1;
 
+    if((f = dcls_cached(fd)))
+        return dcls_cache_seek(f, offset, whence);
+
     if(mutex_lock_irqsafe(&mutex))
         return -1;
 
-    --fd;
-
-    memcpy(command->id, "DC11", 4);
-    command->value0 = htonl(fd);
-    command->value1 = htonl((uint32)offset);
-    command->value2 = htonl((uint32)whence);
-
-    send(dcls_socket, command, sizeof(command_3int_t), 0);
-    dcls_recv_loop();
+    rv = dcls_host_seek(fd - 1, offset, whence);
 
     mutex_unlock(&mutex);
 
-    return retval;
+    return rv;
 }
 
 static off_t dcls_tell(void *hnd) {
@@ -385,6 +639,26 @@ static off_t dcls_tell(void *hnd) {
 
 static size_t dcls_total(void *hnd) {
     size_t cur, ret;
+    dcls_file_t *f = hnd ? dcls_cached((uint32)hnd) : NULL;
+
+    /* Find the end, and put dc-tool's file back where it was */
+    if(f) {
+        if(mutex_lock_irqsafe(&f->mutex))
+            return -1;
+
+        if(mutex_lock_irqsafe(&mutex)) {
+            mutex_unlock(&f->mutex);
+            return -1;
+        }
+
+        ret = dcls_host_seek(f->hnd - 1, 0, SEEK_END);
+        dcls_host_seek(f->hnd - 1, f->hpos, SEEK_SET);
+
+        mutex_unlock(&mutex);
+        mutex_unlock(&f->mutex);
+
+        return ret;
+    }
 
     cur = dcls_tell(hnd);
     ret = dcls_seek(hnd, 0, SEEK_END);
@@ -694,7 +968,7 @@ uint32 _fs_dclsocket_get_ip(void) {
 
 int fs_dclsocket_init(void) {
     struct sockaddr_in addr;
-    int err;
+    int err, i;
     uint8 ipaddr[4], mac[6];
     uint32 ip, port;
 
@@ -750,6 +1024,11 @@ int fs_dclsocket_init(void) {
     if(mutex_init(&mutex, MUTEX_TYPE_NORMAL))
         goto error;
 
+    for(i = 0; i < DCLS_MAX_CACHED; ++i) {
+        memset(&cached[i], 0, sizeof(dcls_file_t));
+        mutex_init(&cached[i].mutex, MUTEX_TYPE_NORMAL);
+    }
+
     initted = 2;
 
     return nmmgr_handler_add(&vh.nmmgr);
@@ -760,7 +1039,7 @@ error:
 }
 
 void fs_dclsocket_shutdown(void) {
-    int old;
+    int old, i;
     command_t cmd;
 
     if(initted != 2)
@@ -780,10 +1059,22 @@ void fs_dclsocket_shutdown(void) {
 
     send(dcls_socket, &cmd, sizeof(command_t), 0);
 
+    /* Drop the read-ahead buffers */
+    for(i = 0; i < DCLS_MAX_CACHED; ++i) {
+        free(cached[i].buf);
+        cached[i].buf = NULL;
+        cached[i].size = 0;
+        cached[i].hnd = 0;
+    }
+
     old = irq_disable();
 
-    /* Destroy our mutex, and set us as uninitted */
+    /* Destroy our mutexes, and set us as uninitted */
     mutex_destroy(&mutex);
+
+    for(i = 0; i < DCLS_MAX_CACHED; ++i)
+        mutex_destroy(&cached[i].mutex);
+
     initted = 0;
 
     irq_restore(old);
@@ -5,12 +5,12 @@
    Copyright (C) 2001,2003,2005 Megan Potter
    Copyright (C) 2004 Vincent Penne
    Copyright (C) 2007, 2008, 2010 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
  */
 
 #include <stdio.h>
 #include <string.h>
-#include <assert.h>
 #include <dc/net/broadband_adapter.h>
 #include <dc/asic.h>
 #include <dc/g2bus.h>
@@ -46,6 +46,18 @@
 /* This was originally set as ASIC_IRQB */
 #define BBA_ASIC_IRQ ASIC_IRQ_DEFAULT
 
+/* The interrupts we use. The RT_INT_RX_ACK ones are masked while the receive
+   ring is being polled. */
+#define BBA_INT_MASK            (RT_INT_PCIERR | \
+                                RT_INT_TIMEOUT | \
+                                RT_INT_RXFIFO_OVERFLOW | \
+                                RT_INT_RXFIFO_UNDERRUN |    /* +link change */ \
+                                RT_INT_RXBUF_OVERFLOW | \
+                                RT_INT_TX_ERR | \
+                                RT_INT_TX_OK | \
+                                RT_INT_RX_ERR | \
+                                RT_INT_RX_OK)
+
 /* DMA transfer will be used only if the amount of bytes exceeds that threshold */
 #define DMA_THRESHOLD 128 // looks like a good value
 
@@ -370,15 +382,7 @@ static int bba_hw_init(void) {
     /* Enable receive interrupts */
     /* XXX need to handle more! */
     g2_write_16(NIC(RT_INTRSTATUS), 0xffff);
-    g2_write_16(NIC(RT_INTRMASK), RT_INT_PCIERR |
-                RT_INT_TIMEOUT |
-                RT_INT_RXFIFO_OVERFLOW |
-                RT_INT_RXFIFO_UNDERRUN |    // +link change
-                RT_INT_RXBUF_OVERFLOW |
-                RT_INT_TX_ERR |
-                RT_INT_TX_OK |
-                RT_INT_RX_ERR |
-                RT_INT_RX_OK);
+    g2_write_16(NIC(RT_INTRMASK), BBA_INT_MASK);
 
     /* Reset RXMISSED counter */
     g2_write_32(NIC(RT_RXMISSED), 0);
@@ -478,10 +482,11 @@ static int dma_used;
 
 static uint32 rx_size;
 
-static kthread_t * bba_rx_thread;
-static semaphore_t bba_rx_sema;
-static int bba_rx_exit_thread;
-static semaphore_t bba_rx_sema2;
+/* Set while bba_if_poll() is scheduled, with the receive interrupts masked */
+static volatile int rx_polling;
+
+/* The netcore device, further down */
+extern netif_t bba_if;
 
 static void bba_rx(void);
 
@@ -496,11 +501,8 @@ static void rx_finish_enq(int room) {
     rtl.cur_rx = (rtl.cur_rx + rx_size + 4 + 3) & ~3;
     g2_write_16(NIC(RT_RXBUFTAIL), (rtl.cur_rx - 16) & (RX_BUFFER_LEN - 1));
 
-    if(room > 0 && (((rxin + 1) % MAX_PKTS) != rxout)) {
+    if(room > 0 && (((rxin + 1) % MAX_PKTS) != rxout))
         rxin = (rxin + 1) % MAX_PKTS;
-        sem_signal(&bba_rx_sema);
-        thd_schedule(1, 0);
-    }
 }
 
 static void bba_dma_cb(void *p) {
@@ -699,35 +701,6 @@ void bba_unlock(void) {
     //sem_signal(&bba_rx_sema2);
 }
 
-static void *bba_rx_threadfunc(void *dummy) {
-    (void)dummy;
-
-    while(!bba_rx_exit_thread) {
-        //sem_wait_timed(&bba_rx_sema, 500);
-        sem_wait(&bba_rx_sema);
-
-        if(bba_rx_exit_thread)
-            break;
-
-        bba_lock();
-
-        if(rxout != rxin) {
-
-            /* Call the callback to process it */
-            eth_rx_callback(rx_pkt[rxout].rxbuff, rx_pkt[rxout].pkt_size);
-
-            rxout = (rxout + 1) % MAX_PKTS;
-        }
-
-        bba_unlock();
-    }
-
-    bba_rx_exit_thread = 0;
-
-    printf("bba_rx_thread exiting ...\n");
-    return NULL;
-}
-
 static void bba_rx(void) {
     uint32 rx_status;
     size_t pkt_size, ring_offset;
@@ -807,14 +780,14 @@ static void bba_irq_hnd(uint32 code, void *data) {
     hnd = 0;
 
     if(intr & RT_INT_RX_ACK) {
-
-        if(!dma_used) {
-            bba_rx();
+        /* Mask the receive interrupts, and leave the frames and the
+           acknowledging to bba_if_poll(). */
+        if(!rx_polling) {
+            rx_polling = 1;
+            g2_write_16(NIC(RT_INTRMASK), BBA_INT_MASK & ~RT_INT_RX_ACK);
+            net_poll_schedule(&bba_if);
         }
 
-        /* so that the irq is not called again and again */
-        g2_write_16(NIC(RT_INTRSTATUS), RT_INT_RX_ACK);
-
         hnd = 1;
     }
 
@@ -827,11 +800,7 @@ static void bba_irq_hnd(uint32 code, void *data) {
         hnd = 1;
     }
 
-    if(intr & RT_INT_RXBUF_OVERFLOW) {
-        dbglog(DBG_KDEBUG, "bba: RX overrun\n");
-        rx_reset();
-        hnd = 1;
-    }
+    /* An RX overrun is part of RT_INT_RX_ACK, so bba_if_poll() handles it */
 
     // DMA complete ? doesn't look like, then what ? anyway, ignore it for now ...
     if(intr == 0) {
@@ -915,13 +884,10 @@ static int bba_if_start(netif_t *self) {
     if(bba_if.flags & NETIF_RUNNING)
         return 0;
 
-    // Start the BBA RX thread.
-    assert(bba_rx_thread == NULL);
-    sem_init(&bba_rx_sema, 0);
-    sem_init(&bba_rx_sema2, 1);
-    bba_rx_thread = thd_create(0, bba_rx_threadfunc, 0);
-    bba_rx_thread->prio = 1;
-    thd_set_label(bba_rx_thread, "BBA-rx-thd");
+    /* Received frames are passed up by bba_if_poll(), once the receive
+       interrupt schedules it. */
+    rx_polling = 0;
+    g2_write_16(NIC(RT_INTRMASK), BBA_INT_MASK);
 
     /* We need something like this to get DHCP to work (since it doesn't
        know anything about an activated and yet not-yet-receiving network
@@ -949,16 +915,7 @@ static int bba_if_stop(netif_t *self) {
     if(!(bba_if.flags & NETIF_RUNNING))
         return 0;
 
-    /* VP : Shutdown rx thread */
-    assert(bba_rx_thread != NULL);
-    bba_rx_exit_thread = 1;
-    sem_signal(&bba_rx_sema);
-    sem_signal(&bba_rx_sema2);
-    thd_join(bba_rx_thread, NULL);
-    sem_destroy(&bba_rx_sema);
-    sem_destroy(&bba_rx_sema2);
-
-    bba_rx_thread = NULL;
+    net_poll_complete(&bba_if);
 
     bba_if.flags &= ~NETIF_RUNNING;
     return 0;
@@ -1006,6 +963,48 @@ static int bba_if_rx_poll(netif_t *self) {
     return 0;
 }
 
+static int bba_if_poll(netif_t *self, int budget) {
+    int intr, n = 0;
+
+    /* Acknowledge first, so that anything received from here on raises the
+       interrupt again once it's unmasked. */
+    intr = g2_read_16(NIC(RT_INTRSTATUS)) & RT_INT_RX_ACK;
+
+    if(intr)
+        g2_write_16(NIC(RT_INTRSTATUS), intr);
+
+    if(intr & RT_INT_RXBUF_OVERFLOW) {
+        dbglog(DBG_KDEBUG, "bba: RX overrun\n");
+        rx_reset();
+    }
+    else if(!dma_used) {
+        /* Copy out what the chip has. If a DMA is still going, it carries
+           on doing that itself when it's done. */
+        bba_rx();
+    }
+
+    while(n < budget && rxout != rxin) {
+        /* Call the callback to process it */
+        eth_rx_callback(rx_pkt[rxout].rxbuff, rx_pkt[rxout].pkt_size);
+
+        rxout = (rxout + 1) % MAX_PKTS;
+        n++;
+    }
+
+    if(n < budget) {
+        irq_disable_scoped();
+
+        /* Keep polling until any DMA in progress has finished */
+        if(!dma_used && rxout == rxin) {
+            net_poll_complete(self);
+            rx_polling = 0;
+            g2_write_16(NIC(RT_INTRMASK), BBA_INT_MASK);
+        }
+    }
+
+    return n;
+}
+
 /* Don't need to hook anything here yet */
 static int bba_if_set_flags(netif_t *self, uint32 flags_and, uint32 flags_or) {
     (void)self;
@@ -1098,12 +1097,6 @@ int bba_init(void) {
     if(__is_defined(TX_SEMA))
         sem_init(&tx_sema, 1);
 
-    /* VP : Initialize rx thread */
-    // Note: The thread itself is not created here, but when we actually
-    // activate the adapter. This way we don't have a spare thread
-    // laying around unless it's actually needed.
-    bba_rx_thread = NULL;
-
     /* Setup the structure */
     bba_if.name = "bba";
     bba_if.descr = "Broadband Adapter (HIT-0400)";
@@ -1139,6 +1132,7 @@ int bba_init(void) {
     bba_if.if_tx = bba_if_tx;
     bba_if.if_tx_commit = bba_if_tx_commit;
     bba_if.if_rx_poll = bba_if_rx_poll;
+    bba_if.if_poll = bba_if_poll;
     bba_if.if_set_flags = bba_if_set_flags;
     bba_if.if_set_mc = bba_if_set_mc;
 
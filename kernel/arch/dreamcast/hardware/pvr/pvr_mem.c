@@ -2,6 +2,7 @@
 
    pvr_mem.c
    Copyright (C) 2002 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 
  */
 
@@ -9,38 +10,29 @@
 #include <dc/pvr.h>
 #include "pvr_internal.h"
 #include <stdio.h>
-
-#include <malloc.h> /* For the struct mallinfo defs */
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
 
 #include <kos/opts.h>
 #include <kos/dbglog.h>
+#include <kos/tlsf.h>
 
 /*
 
-This module basically serves as a KOS-friendly front end and support routines
-for the pvr_mem_core module, which is a dlmalloc-derived malloc for use with
-the PVR memory pool.
-
-I was originally going to make a totally separate thing that could be used
-to generically manage any memory pool, but then I realized what a gruelling
-and thankless task that would be when starting with dlmalloc, so we have this
-instead. ^_^;
+This module serves as a KOS-friendly front end for a TLSF allocator managing
+the PVR memory pool (see kernel/mm/tlsf.c). TLSF allocates and frees in
+constant time, which matters when textures are streamed in and out at every
+level load, and keeps all of its bookkeeping in main RAM, away from VRAM.
 
 */
 
-/* Bring in some prototypes from pvr_mem_core.c */
-/* We can't directly include its header because of name clashes with
-   the real malloc header */
-extern void * pvr_int_malloc(size_t bytes);
-extern void pvr_int_free(void *ptr);
-extern struct mallinfo pvr_int_mallinfo();
-extern void pvr_int_mem_reset();
-extern void pvr_int_malloc_stats();
-
-
 #include <kos/thread.h>
 #include <arch/arch.h>
 
+/* Size of the bounce buffer used to move textures during defragmentation */
+#define DEFRAG_CHUNK    (32 * 1024)
+
 /* List of allocated memory blocks for leak checking */
 typedef struct memctl {
     uint32          size;
@@ -53,55 +45,31 @@ typedef struct memctl {
 static LIST_HEAD(memctl_list, memctl) block_list;
 
 
-/* PVR RAM base; NULL is considered invalid */
-static pvr_ptr_t pvr_mem_base = NULL;
+/* The PVR RAM pool; NULL until the PVR is initialized */
+static tlsf_pool_t *pvr_mem_pool = NULL;
 #define CHECK_MEM_BASE \
-    assert_msg(pvr_mem_base != NULL, \
+    assert_msg(pvr_mem_pool != NULL, \
                "pvr_mem_* used, but PVR hasn't been initialized yet")
 
-/* Used in pvr_mem_core.c */
-void * pvr_int_sbrk(size_t amt) {
-    uint32 old, n;
-
-    /* Are we valid? */
-    CHECK_MEM_BASE;
-
-    /* Try to increment it */
-    old = (uint32)pvr_mem_base;
-    n = old + amt;
-
-    /* Did we run over? */
-    if(n > PVR_RAM_INT_TOP)
-        return (void *) - 1;
-
-    /* Nope, everything's cool */
-    pvr_mem_base = (pvr_ptr_t)n;
-    return (pvr_ptr_t)old;
-}
-
-/* Allocate a chunk of memory from texture space; the returned value
-   will be relative to the base of texture memory (zero-based) */
-pvr_ptr_t pvr_mem_malloc(size_t size) {
+/* Allocate a chunk of memory from texture space, with the given alignment */
+static pvr_ptr_t pvr_mem_malloc_int(size_t size, size_t align, uint32 ra) {
     uint32 rv32;
     memctl_t    * ctl;
 
     CHECK_MEM_BASE;
 
-    rv32 = (uint32)pvr_int_malloc(size);
-    assert_msg((rv32 & 0x1f) == 0,
-               "dlmalloc's alignment is broken; "
-               "please make a bug report");
+    rv32 = (uint32)tlsf_alloc(pvr_mem_pool, size, align);
 
-    if(__is_defined(PVR_KM_DBG)) {
+    if(__is_defined(PVR_KM_DBG) && rv32) {
         ctl = malloc(sizeof(memctl_t));
         ctl->size = size;
         ctl->thread = thd_current->tid;
-        ctl->addr = arch_get_ret_addr();
+        ctl->addr = ra;
         ctl->block = (pvr_ptr_t)rv32;
         LIST_INSERT_HEAD(&block_list, ctl, list);
     }
 
-    if(__is_defined(PVR_KM_DBG_VERBOSE)) {
+    if(__is_defined(PVR_KM_DBG_VERBOSE) && rv32) {
         printf("Thread %d/%08lx allocated %lu bytes at %08lx\n",
                ctl->thread, ctl->addr, ctl->size, rv32);
     }
@@ -109,6 +77,14 @@ pvr_ptr_t pvr_mem_malloc(size_t size) {
     return (pvr_ptr_t)rv32;
 }
 
+pvr_ptr_t pvr_mem_malloc(size_t size) {
+    return pvr_mem_malloc_int(size, 0, arch_get_ret_addr());
+}
+
+pvr_ptr_t pvr_mem_malloc_aligned(size_t size, size_t align) {
+    return pvr_mem_malloc_int(size, align, arch_get_ret_addr());
+}
+
 /* Free a previously allocated chunk of memory */
 void pvr_mem_free(pvr_ptr_t chunk) {
     uint32      ra;
@@ -145,7 +121,9 @@ void pvr_mem_free(pvr_ptr_t chunk) {
         }
     }
 
-    pvr_int_free((void *)chunk);
+    if(chunk && tlsf_free(pvr_mem_pool, (uintptr_t)chunk))
+        dbglog(DBG_ERROR, "pvr_mem_free: invalid block %08lx\n",
+               (uint32)chunk);
 }
 
 /* Check the memory block list to see what's allocated */
@@ -159,44 +137,118 @@ void pvr_mem_print_list(void) {
     LIST_FOREACH(ctl, &block_list, list) {
         printf("  unfreed block at %08lx size %lu, "
                "allocated by thread %d/%08lx\n",
-               (unsigned long)ctl->block, ctl->size, 
+               (unsigned long)ctl->block, ctl->size,
                ctl->thread, (unsigned long)ctl->addr);
     }
     printf("pvr_mem_print_list end block list\n");
 }
 
 /* Return the number of bytes available still in the memory pool */
-static size_t pvr_mem_available_int(void) {
-    struct mallinfo mi = pvr_int_mallinfo();
+size_t pvr_mem_available(void) {
+    tlsf_stats_t st;
+
+    if(!pvr_mem_pool)
+        return 0;
 
-    /* This magic formula is modeled after mstats() */
-    return mi.arena - mi.uordblks;
+    tlsf_get_stats(pvr_mem_pool, &st);
+    return st.free;
 }
 
-size_t pvr_mem_available(void) {
-    if(!pvr_mem_base)
+int pvr_mem_get_stats(tlsf_stats_t *stats) {
+    if(!pvr_mem_pool)
+        return -1;
+
+    tlsf_get_stats(pvr_mem_pool, stats);
+    return 0;
+}
+
+/* Move a texture down in VRAM. DMA can only write to VRAM, so the data goes
+   through a bounce buffer in main RAM, one chunk at a time. Since the new
+   location is always below the old one, copying forward is safe even if the
+   two overlap. */
+static int pvr_mem_move(uintptr_t dst, uintptr_t src, size_t size,
+                        void *data) {
+    uint8 *bounce = data;
+    size_t n;
+
+    while(size) {
+        n = size < DEFRAG_CHUNK ? size : DEFRAG_CHUNK;
+
+        memcpy(bounce, (void *)src, n);
+
+        if(pvr_txr_load_dma(bounce, (pvr_ptr_t)dst, n, true, NULL, NULL))
+            return -1;
+
+        dst += n;
+        src += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+size_t pvr_mem_defrag(tlsf_remap_t *remap, size_t max) {
+    memctl_t *ctl;
+    void *bounce;
+    size_t i, count;
+
+    CHECK_MEM_BASE;
+
+    bounce = memalign(32, DEFRAG_CHUNK);
+    if(!bounce)
         return 0;
 
-    return pvr_mem_available_int() + 
-        (PVR_RAM_INT_TOP - (size_t)pvr_mem_base);
+    count = tlsf_compact(pvr_mem_pool, pvr_mem_move, bounce, remap, max);
+    free(bounce);
+
+    if(__is_defined(PVR_KM_DBG)) {
+        for(i = 0; i < count; i++) {
+            LIST_FOREACH(ctl, &block_list, list) {
+                if(ctl->block == (pvr_ptr_t)remap[i].from) {
+                    ctl->block = (pvr_ptr_t)remap[i].to;
+                    break;
+                }
+            }
+        }
+    }
+
+    return count;
 }
 
 /* Reset the memory pool, equivalent to freeing all textures currently
    residing in RAM. This _must_ be done on a mode change, configuration
    change, etc. */
 void pvr_mem_reset(void) {
-    if(!pvr_state.valid)
-        pvr_mem_base = NULL;
-    else {
-        pvr_mem_base = (pvr_ptr_t)(PVR_RAM_INT_BASE + pvr_state.texture_base);
-        pvr_int_mem_reset();
+    uint32 base;
+
+    tlsf_destroy(pvr_mem_pool);
+    pvr_mem_pool = NULL;
+
+    if(pvr_state.valid) {
+        base = PVR_RAM_INT_BASE + pvr_state.texture_base;
+        pvr_mem_pool = tlsf_create(base, PVR_RAM_INT_TOP - base, 32);
+
+        if(!pvr_mem_pool)
+            dbglog(DBG_ERROR, "pvr_mem_reset: can't create the VRAM pool\n");
     }
 }
 
 /* Print some statistics (like mallocstats) */
 void pvr_mem_stats(void) {
+    tlsf_stats_t st;
+
     printf("pvr_mem_stats():\n");
-    pvr_int_malloc_stats();
-    printf("max sbrk base: %08lx\n", (uint32)pvr_mem_base);
+
+    if(!pvr_mem_pool)
+        return;
+
+    tlsf_get_stats(pvr_mem_pool, &st);
+    printf("total bytes     = %10lu\n", (unsigned long)st.total);
+    printf("in use bytes    = %10lu in %lu blocks\n",
+           (unsigned long)st.used, (unsigned long)st.used_blocks);
+    printf("free bytes      = %10lu in %lu blocks\n",
+           (unsigned long)st.free, (unsigned long)st.free_blocks);
+    printf("largest free    = %10lu\n", (unsigned long)st.largest_free);
+    printf("fragmentation   = %9u%%\n", st.fragmentation);
     pvr_mem_print_list();
 }
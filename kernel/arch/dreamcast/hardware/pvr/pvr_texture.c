@@ -2,6 +2,7 @@
 
    pvr_texture.c
    Copyright (C) 2002, 2004 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 
  */
 
@@ -28,21 +29,13 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32 count) {
     pvr_sq_load((uint32 *)dst, (const uint32 *)src, count, PVR_DMA_VRAM64);
 }
 
-/* Linear/iterative twiddling algorithm from Marcus' tatest */
-#define TWIDTAB(x) ( (x&1)|((x&2)<<1)|((x&4)<<2)|((x&8)<<3)|((x&16)<<4)| \
-                     ((x&32)<<5)|((x&64)<<6)|((x&128)<<7)|((x&256)<<8)|((x&512)<<9) )
-#define TWIDOUT(x, y) ( TWIDTAB((y)) | (TWIDTAB((x)) << 1) )
-
-#define MIN(a, b) ( (a)<(b)? (a):(b) )
-
 /*
    Load texture data from an SH-4 buffer into PVR RAM, twiddling it
    in the process.
 
-   This is a modified version of Vincent Penne's general twiddling
-   function. The texture can be 16bpp, 8bpp, or 4bpp (i.e., paletted).
-   The rectangle does not need to be a square (not tested with h>w, but
-   this is just a matter of a rotation by PI/2 and UV swapping).
+   The texture can be 16bpp, 8bpp, or 4bpp (i.e., paletted), and
+   does not need to be a square. See pvr_twiddle.c for the actual
+   twiddling.
 
    - w and h must be a power of 2
    - flags must be a logical OR of the various texture loading
@@ -50,96 +43,29 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32 count) {
        PVR_TXRLOAD_4BPP, _8BPP, _16BPP, _32BPP (not supported yet)
        PVR_TXRLOAD_VQ (not supported yet)
        PVR_TXRLOAD_INVERT
+       PVR_TXRLOAD_DMA
 
 */
 void pvr_txr_load_ex(const void *src, pvr_ptr_t dst, uint32 w, uint32 h,
                      uint32 flags) {
-    uint32 x, y, yout, min, mask, bpp, invert;
+    int rv;
 
     /* Make sure we're attempting something we can do */
     switch(flags & PVR_TXRLOAD_FMT_MASK) {
         case PVR_TXRLOAD_4BPP:
-            bpp = 4;
-            break;
         case PVR_TXRLOAD_8BPP:
-            bpp = 8;
-            break;
         case PVR_TXRLOAD_16BPP:
-            bpp = 16;
             break;
         default:
             assert_msg(0, "Invalid format specifier in `flags'");
-            bpp = 8;
+            flags = (flags & ~PVR_TXRLOAD_FMT_MASK) | PVR_TXRLOAD_8BPP;
     }
 
     assert_msg(!(flags & PVR_TXRLOAD_VQ_LOAD), "VQ compression on the fly not supported yet");
-    invert = (flags & PVR_TXRLOAD_INVERT_Y) ? 1 : 0;
-
-    min = MIN(w, h);
-    mask = min - 1;
-
-    switch(bpp) {
-        case 4: {
-            uint8 * pixels;
-            uint16 * vtex;
-            pixels = (uint8 *) src;
-            vtex = (uint16*)dst;
-
-            for(y = 0; y < h; y += 2) {
-                if(!invert)
-                    yout = y;
-                else
-                    yout = ((h - 1) - y);
-
-                for(x = 0; x < w; x += 2) {
-                    vtex[TWIDOUT((x & mask) / 2, (yout & mask) / 2) +
-                         (x / min + yout / min)*min * min / 4] =
-                             (pixels[(x + y * w) >> 1] & 15) | ((pixels[(x + (y + 1) * w) >> 1] & 15) << 4) |
-                             ((pixels[(x + y * w) >> 1] >> 4) << 8) | ((pixels[(x + (y + 1) * w) >> 1] >> 4) << 12);
-                }
-            }
-        }
-        break;
-        case 8: {
-            uint8 * pixels;
-            uint16 * vtex;
-            pixels = (uint8 *) src;
-            vtex = (uint16*)dst;
-
-            for(y = 0; y < h; y += 2) {
-                if(!invert)
-                    yout = y;
-                else
-                    yout = ((h - 1) - y);
-
-                for(x = 0; x < w; x++) {
-                    vtex[TWIDOUT((yout & mask) / 2, x & mask) +
-                         (x / min + yout / min)*min * min / 2] =
-                             pixels[y * w + x] | (pixels[(y + 1) * w + x] << 8);
-                }
-            }
-        }
-        break;
-        case 16: {
-            uint16 * pixels;
-            uint16 * vtex;
-            pixels = (uint16 *) src;
-            vtex = (uint16*)dst;
-
-            for(y = 0; y < h; y++) {
-                if(!invert)
-                    yout = y;
-                else
-                    yout = ((h - 1) - y);
-
-                for(x = 0; x < w; x++) {
-                    vtex[TWIDOUT(x & mask, yout & mask) +
-                         (x / min + yout / min)*min * min] = pixels[y * w + x];
-                }
-            }
-        }
-        break;
-    }
+
+    rv = pvr_txr_load_twiddle(src, dst, w, h, 0, flags & ~PVR_TXRLOAD_VQ_LOAD);
+    assert_msg(rv == 0, "Invalid texture size or alignment");
+    (void)rv;
 }
 
 /* Load a KOS Platform Independent Image (subject to restraint checking) */
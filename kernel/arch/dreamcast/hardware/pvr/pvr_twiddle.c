@@ -0,0 +1,626 @@
+/* KallistiOS ##version##
+
+   pvr_twiddle.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Table-driven texture twiddling
+
+   Twiddled textures are stored in Morton order, with the y coordinate in the
+   low bit, one square the size of the shortest side after the other. Rather
+   than computing the address of each texel, the output is generated in
+   order, 32 bytes at a time. Such a block covers a tile of the square (4x4
+   texels at 16bpp, 4x8 at 8bpp and 8x8 at 4bpp), whose position is found
+   from the index of its first texel with a lookup table, and whose texels
+   are gathered with offsets computed once per call.
+
+   Blocks are written straight to the store queues or to memory, which is
+   also how the DMA output is done, through two bounce buffers so that one
+   can be filled while the other is being sent.
+
+   The Dreamcast specific parts are conditional on _arch_dreamcast, so that
+   the rest can be built and tested on the host (see utils/twiddletest).
+*/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dc/pvr.h>
+
+#ifdef _arch_dreamcast
+#include <dc/sq.h>
+#include <kos/mutex.h>
+#include <kos/thread.h>
+
+#include "pvr_internal.h"
+
+/* Size of each DMA bounce buffer */
+#define DMA_CHUNK       8192
+
+/* Number of blocks that can go through one store queue mapping */
+#define SQ_BLOCKS       0x8000
+#endif
+
+/* Gather the even bits of a byte into a nibble, to get the x or y
+   coordinate back from a Morton index. */
+#define CB(b)   (((b) & 1) | (((b) >> 1) & 2) | (((b) >> 2) & 4) | \
+                 (((b) >> 3) & 8))
+#define CB4(b)  CB(b), CB((b) + 1), CB((b) + 2), CB((b) + 3)
+#define CB16(b) CB4(b), CB4((b) + 4), CB4((b) + 8), CB4((b) + 12)
+#define CB64(b) CB16(b), CB16((b) + 16), CB16((b) + 32), CB16((b) + 48)
+
+static const uint8_t compact_tab[256] = {
+    CB64(0), CB64(64), CB64(128), CB64(192)
+};
+
+static inline uint32_t compact(uint32_t m) {
+    return compact_tab[m & 0xff] | (compact_tab[(m >> 8) & 0xff] << 4) |
+           (compact_tab[(m >> 16) & 0xff] << 8);
+}
+
+typedef enum out_type {
+    OUT_MEM,
+    OUT_SQ,
+    OUT_DMA
+} out_type_t;
+
+typedef struct twid_out {
+    out_type_t type;
+
+    /* Start of the output, in main RAM or VRAM, and bytes written so far */
+    uint8_t *dst;
+    size_t pos;
+
+    /* Block handed out by out_begin() */
+    uint32_t *cur;
+
+    /* Block used when the output can't be written in place */
+    uint32_t tmp[8];
+
+#ifdef _arch_dreamcast
+    /* Store queue address of the aligned block containing dst + pos, and
+       number of blocks left before it has to be mapped again */
+    uint32_t *sq;
+    size_t sq_left;
+
+    /* Partial block, for output that isn't aligned on 32 bytes, and offset
+       of its first valid byte */
+    uint32_t stage[8];
+    size_t stage_start;
+
+    /* DMA bounce buffers, the one being filled, how much of it is, and how
+       much of the output was sent */
+    uint8_t *bounce[2];
+    int bcur;
+    size_t used;
+    size_t sent;
+    int err;
+#endif
+} twid_out_t;
+
+#ifdef _arch_dreamcast
+static inline uintptr_t sq_addr(const twid_out_t *o) {
+    return (((uintptr_t)o->dst + o->pos) & 0xffffe0) | PVR_TA_TEX_MEM;
+}
+
+static inline void sq_next(twid_out_t *o) {
+    o->sq += 8;
+
+    if(!--o->sq_left) {
+        sq_unlock();
+        o->sq = sq_lock((void *)sq_addr(o));
+        o->sq_left = SQ_BLOCKS;
+    }
+}
+
+/* Write to VRAM without the store queues, 16 bits at a time. */
+static void vram_write(uint8_t *dst, const uint8_t *src, size_t n) {
+    volatile uint16_t *d = (volatile uint16_t *)dst;
+    size_t i;
+
+    for(i = 0; i < n; i += 2)
+        *d++ = src[i] | (src[i + 1] << 8);
+}
+
+/* Send the complete staging block. */
+static void sq_stage(twid_out_t *o) {
+    int i;
+
+    if(!o->stage_start) {
+        for(i = 0; i < 8; i++)
+            o->sq[i] = o->stage[i];
+
+        sq_flush(o->sq);
+    }
+    else {
+        vram_write(o->dst + o->pos - 32 + o->stage_start,
+                   (uint8_t *)o->stage + o->stage_start,
+                   32 - o->stage_start);
+        o->stage_start = 0;
+    }
+
+    sq_next(o);
+}
+
+static void dma_wait(void) {
+    while(!pvr_dma_ready())
+        thd_pass();
+}
+
+static void dma_kick(twid_out_t *o, size_t n) {
+    dma_wait();
+
+    if(pvr_txr_load_dma(o->bounce[o->bcur], o->dst + o->sent, n, false,
+                        NULL, NULL))
+        o->err = -1;
+
+    o->sent += n;
+    o->bcur ^= 1;
+    o->used = 0;
+}
+#endif
+
+/* Append bytes to the output, at any alignment. */
+static void out_bytes(twid_out_t *o, const void *data, size_t n) {
+#ifdef _arch_dreamcast
+    const uint8_t *p = data;
+    size_t off, k;
+
+    if(o->type == OUT_SQ) {
+        while(n) {
+            off = ((uintptr_t)o->dst + o->pos) & 31;
+            k = 32 - off < n ? 32 - off : n;
+
+            memcpy((uint8_t *)o->stage + off, p, k);
+            p += k;
+            n -= k;
+            o->pos += k;
+
+            if(off + k == 32)
+                sq_stage(o);
+        }
+
+        return;
+    }
+    else if(o->type == OUT_DMA) {
+        while(n) {
+            k = DMA_CHUNK - o->used < n ? DMA_CHUNK - o->used : n;
+
+            memcpy(o->bounce[o->bcur] + o->used, p, k);
+            p += k;
+            n -= k;
+            o->pos += k;
+            o->used += k;
+
+            if(o->used == DMA_CHUNK)
+                dma_kick(o, DMA_CHUNK);
+        }
+
+        return;
+    }
+#endif
+
+    memcpy(o->dst + o->pos, data, n);
+    o->pos += n;
+}
+
+/* Get where to write the next block of 32 bytes. */
+static inline uint32_t *out_begin(twid_out_t *o) {
+    switch(o->type) {
+        case OUT_MEM:
+            if(!(((uintptr_t)o->dst + o->pos) & 3))
+                return o->cur = (uint32_t *)(o->dst + o->pos);
+            break;
+
+#ifdef _arch_dreamcast
+        case OUT_SQ:
+            if(!(((uintptr_t)o->dst + o->pos) & 31))
+                return o->cur = o->sq;
+            break;
+
+        case OUT_DMA:
+            if(!(o->used & 3) && o->used + 32 <= DMA_CHUNK)
+                return o->cur = (uint32_t *)(o->bounce[o->bcur] + o->used);
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    return o->cur = o->tmp;
+}
+
+/* Submit the block returned by out_begin(). */
+static inline void out_end(twid_out_t *o) {
+    if(o->cur == o->tmp) {
+        out_bytes(o, o->tmp, 32);
+        return;
+    }
+
+    o->pos += 32;
+
+#ifdef _arch_dreamcast
+    if(o->type == OUT_SQ) {
+        sq_flush(o->sq);
+        sq_next(o);
+    }
+    else if(o->type == OUT_DMA) {
+        o->used += 32;
+
+        if(o->used == DMA_CHUNK)
+            dma_kick(o, DMA_CHUNK);
+    }
+#endif
+}
+
+/* Twiddle a square of n*n texels, n*n*bpp being a multiple of 256, with
+   off[] holding the offsets of the first texel of each output word within
+   a tile. */
+static inline __attribute__((always_inline))
+void twid_square(twid_out_t *o, const uint8_t *src, ptrdiff_t stride,
+                 uint32_t n, const unsigned int bpp, const ptrdiff_t *off) {
+    const uint32_t texels = 256 / bpp;
+    const uint8_t *p, *q;
+    uint32_t m, v0, v1, v2, v3, *d;
+    int i;
+
+    for(m = 0; m < n * n; m += texels) {
+        p = src + (ptrdiff_t)compact(m) * stride +
+            compact(m >> 1) * bpp / 8;
+        d = out_begin(o);
+
+        for(i = 0; i < 8; i++) {
+            q = p + off[i];
+
+            if(bpp == 16) {
+                d[i] = *(const uint16_t *)q |
+                       ((uint32_t)*(const uint16_t *)(q + stride) << 16);
+            }
+            else if(bpp == 8) {
+                d[i] = q[0] | (q[stride] << 8) | (q[1] << 16) |
+                       ((uint32_t)q[stride + 1] << 24);
+            }
+            else {
+                /* Both texels of a source byte are in the same word */
+                v0 = q[0];
+                v1 = q[stride];
+                v2 = q[stride * 2];
+                v3 = q[stride * 3];
+                d[i] = (v0 & 15) | ((v1 & 15) << 4) | ((v0 >> 4) << 8) |
+                       ((v1 >> 4) << 12) | ((v2 & 15) << 16) |
+                       ((v3 & 15) << 20) | ((v2 >> 4) << 24) |
+                       ((v3 >> 4) << 28);
+            }
+        }
+
+        out_end(o);
+    }
+}
+
+/* Twiddle a texture whose squares are smaller than a block, texel by texel,
+   in output order. Only used for the smallest textures and mipmaps. */
+static void twid_small(twid_out_t *o, const uint8_t *src, ptrdiff_t stride,
+                       uint32_t w, uint32_t h, unsigned int bpp) {
+    const uint32_t texels = 256 / bpp;
+    uint32_t buf[8] = { 0 };
+    uint8_t *b = (uint8_t *)buf;
+    uint32_t n = w < h ? w : h;
+    uint32_t i, k, m, x, y, v;
+    const uint8_t *row;
+
+    for(i = 0; i < w * h; i++) {
+        m = i & (n * n - 1);
+        x = compact(m >> 1);
+        y = compact(m);
+
+        if(w > h)
+            x += i / (n * n) * n;
+        else
+            y += i / (n * n) * n;
+
+        row = src + (ptrdiff_t)y * stride;
+        k = i & (texels - 1);
+
+        if(bpp == 16) {
+            b[k * 2] = row[x * 2];
+            b[k * 2 + 1] = row[x * 2 + 1];
+        }
+        else if(bpp == 8) {
+            b[k] = row[x];
+        }
+        else {
+            v = (row[x >> 1] >> ((x & 1) * 4)) & 15;
+            b[k >> 1] |= v << ((k & 1) * 4);
+        }
+
+        if(k == texels - 1) {
+            out_bytes(o, buf, 32);
+            memset(buf, 0, sizeof(buf));
+        }
+    }
+
+    k = (w * h) & (texels - 1);
+
+    if(k)
+        out_bytes(o, buf, (k * bpp + 7) / 8);
+}
+
+static void twid_texture(twid_out_t *o, const uint8_t *src, ptrdiff_t stride,
+                         uint32_t w, uint32_t h, unsigned int bpp) {
+    ptrdiff_t off[8];
+    uint32_t n = w < h ? w : h;
+    uint32_t s, count = (w < h ? h : w) / n, t;
+    const uint8_t *sq;
+    int i;
+
+    if(n * n * bpp < 256) {
+        twid_small(o, src, stride, w, h, bpp);
+        return;
+    }
+
+    for(i = 0; i < 8; i++) {
+        t = i * 32 / bpp;
+        off[i] = (ptrdiff_t)compact(t) * stride + compact(t >> 1) * bpp / 8;
+    }
+
+    for(s = 0; s < count; s++) {
+        sq = w > h ? src + s * n * bpp / 8 :
+             src + (ptrdiff_t)(s * n) * stride;
+
+        switch(bpp) {
+            case 16:
+                twid_square(o, sq, stride, n, 16, off);
+                break;
+            case 8:
+                twid_square(o, sq, stride, n, 8, off);
+                break;
+            default:
+                twid_square(o, sq, stride, n, 4, off);
+                break;
+        }
+    }
+}
+
+static unsigned int flags_bpp(uint32_t flags) {
+    if(flags & PVR_TXRLOAD_VQ_LOAD)
+        return 0;
+
+    switch(flags & PVR_TXRLOAD_FMT_MASK) {
+        case PVR_TXRLOAD_4BPP:
+            return 4;
+        case PVR_TXRLOAD_8BPP:
+            return 8;
+        case PVR_TXRLOAD_16BPP:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+static inline bool valid_size(uint32_t s) {
+    return s && s <= 1024 && !(s & (s - 1));
+}
+
+/* Check the parameters of a texture, and get where its first row starts
+   and the distance between rows. */
+static int check_texture(const void *src, uint32_t w, uint32_t h,
+                         size_t stride, uint32_t flags, unsigned int *bpp,
+                         const uint8_t **start, ptrdiff_t *step) {
+    size_t row;
+
+    *bpp = flags_bpp(flags);
+    row = (w * *bpp + 7) / 8;
+
+    if(!*bpp || !valid_size(w) || !valid_size(h) || !src) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(!stride)
+        stride = row;
+
+    if(stride < row || (*bpp == 16 && (((uintptr_t)src | stride) & 1))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *start = src;
+    *step = (ptrdiff_t)stride;
+
+    if(flags & PVR_TXRLOAD_INVERT_Y) {
+        *start += (h - 1) * stride;
+        *step = -*step;
+    }
+
+    return 0;
+}
+
+size_t pvr_txr_mipmap_offset(uint32_t size, uint32_t flags) {
+    unsigned int bpp = flags_bpp(flags);
+
+    if(!bpp || !valid_size(size))
+        return 0;
+
+    /* At 16bpp, the 1x1 level is at 6 bytes, and every level is followed
+       by the next one */
+    return (6 + 2 * (size * size - 1) / 3) * bpp / 16;
+}
+
+static void twid_mipmaps(twid_out_t *o, const void *const *levels,
+                         uint32_t size, unsigned int bpp, uint32_t flags) {
+    static const uint8_t zero[6] = { 0 };
+    const uint8_t *src;
+    ptrdiff_t stride;
+    uint32_t s;
+    int l;
+
+    out_bytes(o, zero, pvr_txr_mipmap_offset(1, flags));
+
+    for(s = 1, l = 0; s < size; s <<= 1)
+        l++;
+
+    for(s = 1; s <= size; s <<= 1, l--) {
+        src = levels[l];
+        stride = (s * bpp + 7) / 8;
+
+        if(flags & PVR_TXRLOAD_INVERT_Y) {
+            src += (s - 1) * stride;
+            stride = -stride;
+        }
+
+        twid_texture(o, src, stride, s, s, bpp);
+    }
+}
+
+static int check_mipmaps(const void *const *levels, uint32_t size,
+                         uint32_t flags, unsigned int *bpp) {
+    uint32_t s;
+
+    *bpp = flags_bpp(flags);
+
+    if(!*bpp || !valid_size(size) || !levels) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for(s = 0; (1u << s) <= size; s++) {
+        if(!levels[s] || (*bpp == 16 && ((uintptr_t)levels[s] & 1))) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int pvr_txr_twiddle(void *dst, const void *src, uint32_t w, uint32_t h,
+                    size_t stride, uint32_t flags) {
+    twid_out_t o = { .type = OUT_MEM, .dst = dst };
+    const uint8_t *start;
+    unsigned int bpp;
+    ptrdiff_t step;
+
+    if(!dst || check_texture(src, w, h, stride, flags, &bpp, &start, &step))
+        return -1;
+
+    twid_texture(&o, start, step, w, h, bpp);
+
+    return 0;
+}
+
+int pvr_txr_twiddle_mipmaps(void *dst, const void *const *levels,
+                            uint32_t size, uint32_t flags) {
+    twid_out_t o = { .type = OUT_MEM, .dst = dst };
+    unsigned int bpp;
+
+    if(!dst || check_mipmaps(levels, size, flags, &bpp))
+        return -1;
+
+    twid_mipmaps(&o, levels, size, bpp, flags);
+
+    return 0;
+}
+
+#ifdef _arch_dreamcast
+/* Set up the output to VRAM, with DMA if asked for and possible. */
+static void load_begin(twid_out_t *o, pvr_ptr_t dst, uint32_t flags) {
+    memset(o, 0, sizeof(*o));
+    o->dst = dst;
+
+    if((flags & PVR_TXRLOAD_DMA) && !((uintptr_t)dst & 31)) {
+        o->bounce[0] = aligned_alloc(32, DMA_CHUNK);
+        o->bounce[1] = aligned_alloc(32, DMA_CHUNK);
+
+        if(o->bounce[0] && o->bounce[1]) {
+            o->type = OUT_DMA;
+            mutex_lock((mutex_t *)&pvr_state.dma_lock);
+            return;
+        }
+
+        free(o->bounce[0]);
+        free(o->bounce[1]);
+    }
+
+    o->type = OUT_SQ;
+    o->stage_start = (uintptr_t)dst & 31;
+    o->sq = sq_lock((void *)sq_addr(o));
+    o->sq_left = SQ_BLOCKS;
+}
+
+/* Write what is left, and release everything. */
+static int load_end(twid_out_t *o) {
+    size_t n, tail;
+    uint8_t *last;
+
+    if(o->type == OUT_SQ) {
+        n = ((uintptr_t)o->dst + o->pos) & 31;
+
+        if(n > o->stage_start)
+            vram_write(o->dst + o->pos - (n - o->stage_start),
+                       (uint8_t *)o->stage + o->stage_start,
+                       n - o->stage_start);
+
+        sq_unlock();
+        return 0;
+    }
+
+    /* DMA needs whole blocks, so the tail of the last buffer is written
+       directly */
+    last = o->bounce[o->bcur];
+    n = o->used & ~31;
+    tail = o->used - n;
+
+    if(n)
+        dma_kick(o, n);
+
+    dma_wait();
+
+    if(tail)
+        vram_write(o->dst + o->pos - tail, last + n, tail);
+
+    mutex_unlock((mutex_t *)&pvr_state.dma_lock);
+
+    free(o->bounce[0]);
+    free(o->bounce[1]);
+
+    return o->err;
+}
+
+int pvr_txr_load_twiddle(const void *src, pvr_ptr_t dst, uint32_t w,
+                         uint32_t h, size_t stride, uint32_t flags) {
+    twid_out_t o;
+    const uint8_t *start;
+    unsigned int bpp;
+    ptrdiff_t step;
+
+    if(((uintptr_t)dst & 7) ||
+       check_texture(src, w, h, stride, flags, &bpp, &start, &step)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    load_begin(&o, dst, flags);
+    twid_texture(&o, start, step, w, h, bpp);
+
+    return load_end(&o);
+}
+
+int pvr_txr_load_mipmaps(const void *const *levels, pvr_ptr_t dst,
+                         uint32_t size, uint32_t flags) {
+    twid_out_t o;
+    unsigned int bpp;
+
+    if(((uintptr_t)dst & 7) || check_mipmaps(levels, size, flags, &bpp)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    load_begin(&o, dst, flags);
+    twid_mipmaps(&o, levels, size, bpp, flags);
+
+    return load_end(&o);
+}
+#endif
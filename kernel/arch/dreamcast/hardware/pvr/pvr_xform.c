@@ -0,0 +1,619 @@
+/* KallistiOS ##version##
+
+   pvr_xform.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Batched vertex transform, clip and submission
+
+   Draw calls work in two passes: all the vertices are first transformed into
+   a scratch array, then the triangles are assembled from it, rejected, culled
+   or clipped, and written out as strips.
+
+   The Dreamcast specific parts (FTRV, store queues and vertex DMA buffers)
+   are conditional on _arch_dreamcast, so that the rest can be built and
+   tested on the host (see utils/xformtest).
+*/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dc/pvr.h>
+#include <dc/pvr/pvr_xform.h>
+
+#ifdef _arch_dreamcast
+#include <dc/matrix.h>
+#include <dc/fmath.h>
+
+#include "pvr_internal.h"
+#endif
+
+/* Outcodes of transformed vertices */
+#define OUT_NEAR        0x01
+#define OUT_LEFT        0x02
+#define OUT_RIGHT       0x04
+#define OUT_TOP         0x08
+#define OUT_BOTTOM      0x10
+
+typedef enum target {
+    TARGET_NONE,
+    TARGET_DR,
+    TARGET_LIST,
+    TARGET_BUFFER
+} target_t;
+
+/* A transformed vertex. The screen coordinates are only valid if the vertex
+   is in front of the near plane. */
+typedef struct xvtx {
+    float x, y, w;
+    float sx, sy, iw;
+    uint32_t code;
+    uint32_t pad;
+} xvtx_t;
+
+/* Classification of triangles */
+typedef enum tri_class {
+    TRI_DRAW,
+    TRI_SKIP,
+    TRI_CLIP
+} tri_class_t;
+
+struct pvr_xform {
+    matrix_t mat __attribute__((aligned(32)));
+
+    pvr_xform_cull_t cull;
+    float near;
+
+    bool viewport;
+    float vx0, vy0, vx1, vy1;
+
+    target_t target;
+    pvr_dr_state_t *dr;
+    pvr_list_t list;
+
+    /* Buffer for the list and buffer targets */
+    pvr_vertex_t *buf;
+    size_t buf_size, buf_pos;
+    size_t strip_start;
+    bool full;
+
+    /* Vertex that was written but not submitted yet, as we don't know yet
+       whether it is the last one of its strip. With Direct Rendering, it
+       stays in its store queue while the next one is written in the other. */
+    pvr_vertex_t *pend;
+
+    /* Where vertices go once a buffer is full */
+    pvr_vertex_t dummy;
+
+    xvtx_t *scratch;
+    size_t scratch_size;
+
+    pvr_xform_stats_t stats;
+};
+
+pvr_xform_t *pvr_xform_create(void) {
+    pvr_xform_t *xf = aligned_alloc(32, sizeof(*xf));
+
+    if(!xf) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memset(xf, 0, sizeof(*xf));
+
+    xf->mat[0][0] = xf->mat[1][1] = xf->mat[2][2] = xf->mat[3][3] = 1.0f;
+    xf->near = PVR_XFORM_NEAR_DEFAULT;
+
+    return xf;
+}
+
+void pvr_xform_destroy(pvr_xform_t *xf) {
+    if(!xf)
+        return;
+
+    free(xf->scratch);
+    free(xf);
+}
+
+void pvr_xform_set_matrix(pvr_xform_t *xf, const matrix_t *mat) {
+    if(mat) {
+        memcpy(xf->mat, mat, sizeof(matrix_t));
+        return;
+    }
+
+#ifdef _arch_dreamcast
+    mat_store(&xf->mat);
+#endif
+}
+
+void pvr_xform_set_cull(pvr_xform_t *xf, pvr_xform_cull_t cull) {
+    xf->cull = cull;
+}
+
+void pvr_xform_set_near(pvr_xform_t *xf, float near) {
+    xf->near = near;
+}
+
+void pvr_xform_set_viewport(pvr_xform_t *xf, float x0, float y0,
+                            float x1, float y1) {
+    xf->viewport = x1 > x0 && y1 > y0;
+    xf->vx0 = x0;
+    xf->vy0 = y0;
+    xf->vx1 = x1;
+    xf->vy1 = y1;
+}
+
+void pvr_xform_target_dr(pvr_xform_t *xf, pvr_dr_state_t *state) {
+    xf->target = TARGET_DR;
+    xf->dr = state;
+}
+
+void pvr_xform_target_list(pvr_xform_t *xf, pvr_list_t list) {
+    xf->target = TARGET_LIST;
+    xf->list = list;
+}
+
+void pvr_xform_target_buffer(pvr_xform_t *xf, pvr_vertex_t *buf,
+                             size_t count) {
+    xf->target = TARGET_BUFFER;
+    xf->buf = buf;
+    xf->buf_size = count;
+    xf->buf_pos = 0;
+    xf->strip_start = 0;
+    xf->full = false;
+}
+
+size_t pvr_xform_buffer_used(const pvr_xform_t *xf) {
+    return xf->target == TARGET_BUFFER ? xf->buf_pos : 0;
+}
+
+void pvr_xform_get_stats(const pvr_xform_t *xf, pvr_xform_stats_t *stats) {
+    *stats = xf->stats;
+}
+
+void pvr_xform_reset_stats(pvr_xform_t *xf) {
+    memset(&xf->stats, 0, sizeof(xf->stats));
+}
+
+static inline float inv_w(float w) {
+#ifdef _arch_dreamcast
+    /* w is positive, so this is 1/w, at a fraction of the cost of FDIV */
+    return frsqrt(w * w);
+#else
+    return 1.0f / w;
+#endif
+}
+
+static inline void project(const pvr_xform_t *xf, xvtx_t *t) {
+    uint32_t code = 0;
+
+    t->iw = inv_w(t->w);
+    t->sx = t->x * t->iw;
+    t->sy = t->y * t->iw;
+
+    if(xf->viewport) {
+        if(t->sx < xf->vx0)
+            code |= OUT_LEFT;
+        else if(t->sx > xf->vx1)
+            code |= OUT_RIGHT;
+
+        if(t->sy < xf->vy0)
+            code |= OUT_TOP;
+        else if(t->sy > xf->vy1)
+            code |= OUT_BOTTOM;
+    }
+
+    t->code = code;
+}
+
+static int transform(pvr_xform_t *xf, const pvr_vertex_t *vtx, size_t count) {
+    xvtx_t *t;
+    float x, y, z, w;
+    size_t i;
+
+    if(count > xf->scratch_size) {
+        free(xf->scratch);
+        xf->scratch_size = 0;
+
+        xf->scratch = aligned_alloc(32, count * sizeof(xvtx_t));
+        if(!xf->scratch) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        xf->scratch_size = count;
+    }
+
+#ifdef _arch_dreamcast
+    mat_load(&xf->mat);
+#endif
+
+    for(i = 0, t = xf->scratch; i < count; i++, t++, vtx++) {
+        __builtin_prefetch(vtx + 1);
+
+        x = vtx->x;
+        y = vtx->y;
+        z = vtx->z;
+        w = 1.0f;
+
+#ifdef _arch_dreamcast
+        mat_trans_nodiv(x, y, z, w);
+        t->x = x;
+        t->y = y;
+        t->w = w;
+#else
+        t->x = xf->mat[0][0] * x + xf->mat[1][0] * y + xf->mat[2][0] * z +
+               xf->mat[3][0] * w;
+        t->y = xf->mat[0][1] * x + xf->mat[1][1] * y + xf->mat[2][1] * z +
+               xf->mat[3][1] * w;
+        t->w = xf->mat[0][3] * x + xf->mat[1][3] * y + xf->mat[2][3] * z +
+               xf->mat[3][3] * w;
+#endif
+
+        if(t->w < xf->near)
+            t->code = OUT_NEAR;
+        else
+            project(xf, t);
+    }
+
+    xf->stats.vertices_in += count;
+
+    return 0;
+}
+
+/* Prepare the list target for a draw call. */
+static void target_begin(pvr_xform_t *xf) {
+#ifdef _arch_dreamcast
+    const pvr_dma_buffers_t *b;
+
+    if(xf->target != TARGET_LIST)
+        return;
+
+    b = (const pvr_dma_buffers_t *)&pvr_state.dma_buffers[pvr_state.ram_target];
+
+    /* pvr_vertbuf_written() wants the tail to stay below the end */
+    xf->buf = pvr_vertbuf_tail(xf->list);
+    xf->buf_size = (b->size[xf->list] - b->ptr[xf->list] - 1) /
+                   sizeof(pvr_vertex_t);
+    xf->buf_pos = 0;
+    xf->strip_start = 0;
+    xf->full = false;
+#else
+    (void)xf;
+#endif
+}
+
+static void target_end(pvr_xform_t *xf) {
+#ifdef _arch_dreamcast
+    if(xf->target == TARGET_LIST && xf->buf_pos)
+        pvr_vertbuf_written(xf->list, xf->buf_pos * sizeof(pvr_vertex_t));
+#else
+    (void)xf;
+#endif
+}
+
+/* Get where to write the next vertex. */
+static inline pvr_vertex_t *out_alloc(pvr_xform_t *xf) {
+#ifdef _arch_dreamcast
+    if(xf->target == TARGET_DR) {
+        xf->stats.vertices_out++;
+        return pvr_dr_target(*xf->dr);
+    }
+#endif
+
+    if(!xf->full && xf->buf_pos == xf->buf_size) {
+        /* Out of room: discard the strip being written, and everything that
+           follows. */
+        xf->full = true;
+        xf->stats.vertices_out -= xf->buf_pos - xf->strip_start;
+        xf->stats.dropped += xf->buf_pos - xf->strip_start;
+        xf->buf_pos = xf->strip_start;
+    }
+
+    if(xf->full) {
+        xf->stats.dropped++;
+        return &xf->dummy;
+    }
+
+    xf->stats.vertices_out++;
+    return &xf->buf[xf->buf_pos++];
+}
+
+static inline void out_commit(pvr_xform_t *xf, uint32_t flags) {
+    xf->pend->flags = flags;
+
+#ifdef _arch_dreamcast
+    if(xf->target == TARGET_DR)
+        pvr_dr_commit(xf->pend);
+#endif
+
+    xf->pend = NULL;
+}
+
+/* Submit the pending vertex as part of the current strip, and get where to
+   write the next one. */
+static inline pvr_vertex_t *out_next(pvr_xform_t *xf) {
+    if(xf->pend)
+        out_commit(xf, PVR_CMD_VERTEX);
+
+    return xf->pend = out_alloc(xf);
+}
+
+/* End the current strip. */
+static inline void out_end(pvr_xform_t *xf) {
+    if(!xf->pend)
+        return;
+
+    out_commit(xf, PVR_CMD_VERTEX_EOL);
+
+    if(!xf->full) {
+        xf->stats.strips_out++;
+        xf->strip_start = xf->buf_pos;
+    }
+}
+
+static inline void emit(pvr_xform_t *xf, const xvtx_t *t,
+                        const pvr_vertex_t *src) {
+    pvr_vertex_t *d = out_next(xf);
+
+    d->x = t->sx;
+    d->y = t->sy;
+    d->z = t->iw;
+    d->u = src->u;
+    d->v = src->v;
+    d->argb = src->argb;
+    d->oargb = src->oargb;
+}
+
+static inline bool backfacing(const pvr_xform_t *xf, const xvtx_t *a,
+                              const xvtx_t *b, const xvtx_t *c) {
+    /* Positive when clockwise on screen, as y points down */
+    float area = (b->sx - a->sx) * (c->sy - a->sy) -
+                 (c->sx - a->sx) * (b->sy - a->sy);
+
+    if(xf->cull == PVR_XFORM_CULL_CW)
+        return area >= 0.0f;
+    else
+        return area <= 0.0f;
+}
+
+static inline tri_class_t classify(pvr_xform_t *xf, const xvtx_t *a,
+                                   const xvtx_t *b, const xvtx_t *c) {
+    xf->stats.triangles_in++;
+
+    if(a->code & b->code & c->code) {
+        xf->stats.rejected++;
+        return TRI_SKIP;
+    }
+
+    if((a->code | b->code | c->code) & OUT_NEAR)
+        return TRI_CLIP;
+
+    if(xf->cull != PVR_XFORM_CULL_NONE && backfacing(xf, a, b, c)) {
+        xf->stats.culled++;
+        return TRI_SKIP;
+    }
+
+    return TRI_DRAW;
+}
+
+static inline uint32_t lerp_color(uint32_t c0, uint32_t c1, float f) {
+    uint32_t rv = 0;
+    int shift, a, b;
+
+    for(shift = 0; shift < 32; shift += 8) {
+        a = (c0 >> shift) & 0xff;
+        b = (c1 >> shift) & 0xff;
+        rv |= (uint32_t)(a + (int)((b - a) * f + 0.5f)) << shift;
+    }
+
+    return rv;
+}
+
+/* Clip a triangle against the near plane, and submit what is left as its
+   own strip. */
+static void clip_tri(pvr_xform_t *xf, const xvtx_t *t[3],
+                     const pvr_vertex_t *s[3]) {
+    xvtx_t ct[4];
+    pvr_vertex_t cs[4];
+    const xvtx_t *t0, *t1;
+    const pvr_vertex_t *s0, *s1;
+    int i, n = 0;
+    float f;
+
+    for(i = 0; i < 3; i++) {
+        t0 = t[i];
+        s0 = s[i];
+        t1 = t[i == 2 ? 0 : i + 1];
+        s1 = s[i == 2 ? 0 : i + 1];
+
+        if(!(t0->code & OUT_NEAR)) {
+            ct[n] = *t0;
+            cs[n] = *s0;
+            n++;
+        }
+
+        if((t0->code ^ t1->code) & OUT_NEAR) {
+            f = (t0->w - xf->near) / (t0->w - t1->w);
+
+            ct[n].x = t0->x + (t1->x - t0->x) * f;
+            ct[n].y = t0->y + (t1->y - t0->y) * f;
+            ct[n].w = xf->near;
+            project(xf, &ct[n]);
+
+            cs[n].u = s0->u + (s1->u - s0->u) * f;
+            cs[n].v = s0->v + (s1->v - s0->v) * f;
+            cs[n].argb = lerp_color(s0->argb, s1->argb, f);
+            cs[n].oargb = lerp_color(s0->oargb, s1->oargb, f);
+            n++;
+        }
+    }
+
+    if(xf->cull != PVR_XFORM_CULL_NONE &&
+       backfacing(xf, &ct[0], &ct[1], &ct[2])) {
+        xf->stats.culled++;
+        return;
+    }
+
+    xf->stats.clipped++;
+
+    /* A quad is sent as a strip of two triangles: 0 1 3 2 */
+    emit(xf, &ct[0], &cs[0]);
+    emit(xf, &ct[1], &cs[1]);
+
+    if(n == 4)
+        emit(xf, &ct[3], &cs[3]);
+
+    emit(xf, &ct[2], &cs[2]);
+    out_end(xf);
+}
+
+#define INDEX(i)    (idx ? idx[i] : (i))
+
+static void draw_triangles(pvr_xform_t *xf, const pvr_vertex_t *vtx,
+                           const uint16_t *idx, size_t count) {
+    const xvtx_t *xv = xf->scratch;
+    const xvtx_t *t[3];
+    const pvr_vertex_t *s[3];
+    size_t i, j;
+
+    for(i = 0; i + 2 < count; i += 3) {
+        for(j = 0; j < 3; j++) {
+            t[j] = &xv[INDEX(i + j)];
+            s[j] = &vtx[INDEX(i + j)];
+        }
+
+        switch(classify(xf, t[0], t[1], t[2])) {
+            case TRI_DRAW:
+                emit(xf, t[0], s[0]);
+                emit(xf, t[1], s[1]);
+                emit(xf, t[2], s[2]);
+                out_end(xf);
+                break;
+
+            case TRI_CLIP:
+                clip_tri(xf, t, s);
+                break;
+
+            case TRI_SKIP:
+                break;
+        }
+    }
+}
+
+static void draw_strip(pvr_xform_t *xf, const pvr_vertex_t *vtx,
+                       const uint16_t *idx, size_t count) {
+    const xvtx_t *xv = xf->scratch;
+    const xvtx_t *t[3];
+    const pvr_vertex_t *s[3];
+    bool run = false;
+    size_t i, j, a, b, c;
+
+    for(i = 0; i + 2 < count; i++) {
+        a = INDEX(i);
+        b = INDEX(i + 1);
+        c = INDEX(i + 2);
+
+        /* Put odd triangles back in their actual orientation */
+        if(i & 1) {
+            j = a;
+            a = b;
+            b = j;
+        }
+
+        switch(classify(xf, &xv[a], &xv[b], &xv[c])) {
+            case TRI_DRAW:
+                if(run) {
+                    emit(xf, &xv[c], &vtx[c]);
+                    break;
+                }
+
+                /* Start a new strip. It has to start on an odd triangle if
+                   this one is, which a degenerate triangle takes care of. */
+                if(i & 1) {
+                    emit(xf, &xv[b], &vtx[b]);
+                    emit(xf, &xv[b], &vtx[b]);
+                    emit(xf, &xv[a], &vtx[a]);
+                }
+                else {
+                    emit(xf, &xv[a], &vtx[a]);
+                    emit(xf, &xv[b], &vtx[b]);
+                }
+
+                emit(xf, &xv[c], &vtx[c]);
+                run = true;
+                break;
+
+            case TRI_CLIP:
+                if(run) {
+                    out_end(xf);
+                    run = false;
+                }
+
+                t[0] = &xv[a];
+                t[1] = &xv[b];
+                t[2] = &xv[c];
+                s[0] = &vtx[a];
+                s[1] = &vtx[b];
+                s[2] = &vtx[c];
+                clip_tri(xf, t, s);
+                break;
+
+            case TRI_SKIP:
+                if(run) {
+                    out_end(xf);
+                    run = false;
+                }
+                break;
+        }
+    }
+
+    if(run)
+        out_end(xf);
+}
+
+static int draw(pvr_xform_t *xf, pvr_xform_prim_t prim,
+                const pvr_vertex_t *vtx, size_t vcount,
+                const uint16_t *idx, size_t icount) {
+    uint32_t out = xf->stats.vertices_out;
+
+    if(xf->target == TARGET_NONE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(transform(xf, vtx, vcount))
+        return -1;
+
+    target_begin(xf);
+
+    if(prim == PVR_XFORM_STRIP)
+        draw_strip(xf, vtx, idx, icount);
+    else
+        draw_triangles(xf, vtx, idx, icount);
+
+    target_end(xf);
+
+    return (int)(xf->stats.vertices_out - out);
+}
+
+int pvr_xform_draw(pvr_xform_t *xf, pvr_xform_prim_t prim,
+                   const pvr_vertex_t *vtx, size_t count) {
+    return draw(xf, prim, vtx, count, NULL, count);
+}
+
+int pvr_xform_draw_indexed(pvr_xform_t *xf, pvr_xform_prim_t prim,
+                           const pvr_vertex_t *vtx, size_t vcount,
+                           const uint16_t *idx, size_t icount) {
+    size_t i;
+
+    for(i = 0; i < icount; i++) {
+        if(idx[i] >= vcount) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return draw(xf, prim, vtx, vcount, idx, icount);
+}
@@ -83,7 +83,8 @@ __BEGIN_DECLS
 
     \warning
     This timer channel is used for the timer_spin_sleep() function, which also
-    backs the kthread, C, C++, and POSIX sleep functions.
+    backs the kthread, C, C++, and POSIX sleep functions. It is also used by
+    the sampling profiler (\ref profiler) while it is running.
 */
 #define TMU1    1
 
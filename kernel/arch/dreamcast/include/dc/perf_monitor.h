@@ -2,6 +2,7 @@
 
    arch/dreamcast/include/dc/perf_monitor.h
  * Copyright (C) 2024 Paul Cercueil
+ * Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -22,6 +23,7 @@
 __BEGIN_DECLS
 
 #include <dc/perfctr.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -37,26 +39,56 @@ __BEGIN_DECLS
     @{
 */
 
-/** /cond */
+/** \brief  Number of call tree nodes available to the performance monitor.
+
+    Each distinct (parent, monitor) pair seen at runtime uses one node. Once
+    all the nodes are in use, new call paths are still accounted for in the
+    flat statistics, but do not appear in the call tree.
+*/
+#define PERF_MONITOR_MAX_NODES  128
+
+/** \brief  Statistics of one probe point.
+
+    Times are in nanoseconds. The inclusive time (time_ns) counts everything
+    that happened between the start and the end of the monitored block,
+    whereas the self time (self_ns) excludes the time spent inside nested
+    monitored blocks.
+*/
 struct perf_monitor {
-    const char *fn;
-    unsigned int line;
-    uint64_t calls;
-    uint64_t time_ns, time_start;
-    uint64_t event0, event0_start;
-    uint64_t event1, event1_start;
+    const char *fn;             /**< \brief Function name of the probe */
+    unsigned int line;          /**< \brief Line number of the probe */
+    uint64_t calls;             /**< \brief Number of calls */
+    uint64_t time_ns;           /**< \brief Inclusive time */
+    uint64_t self_ns;           /**< \brief Exclusive (self) time */
+    uint64_t event0;            /**< \brief Count of the first event */
+    uint64_t event1;            /**< \brief Count of the second event */
 };
 
-void __stop_perf_monitor(struct perf_monitor **monitor);
+/** \cond */
+struct perf_monitor_node;
+
+/* Per-activation state, living on the stack of the monitored block. */
+struct perf_monitor_frame {
+    struct perf_monitor *monitor;
+    struct perf_monitor_frame *parent;
+    struct perf_monitor_node *node;
+    uint64_t time_start, child_ns;
+    uint64_t event0_start, event1_start;
+};
 
-struct perf_monitor *__start_perf_monitor(struct perf_monitor *monitor);
+void __stop_perf_monitor(struct perf_monitor_frame **frame);
+
+struct perf_monitor_frame *
+__start_perf_monitor(struct perf_monitor_frame *frame,
+                     struct perf_monitor *monitor);
 
 #define __perf_monitor(f, l) \
     static struct perf_monitor __perf_monitor_##l \
         __attribute__((section(".monitors"))) = { f, l, }; \
-    struct perf_monitor *___perf_monitor_##l \
+    struct perf_monitor_frame __perf_monitor_frame_##l; \
+    struct perf_monitor_frame *___perf_monitor_##l \
         __attribute__((cleanup(__stop_perf_monitor))) = \
-        __start_perf_monitor(&__perf_monitor_##l)
+        __start_perf_monitor(&__perf_monitor_frame_##l, &__perf_monitor_##l)
 
 #define _perf_monitor(f, l) __perf_monitor(f, l)
 
@@ -68,12 +100,17 @@ struct perf_monitor *__start_perf_monitor(struct perf_monitor *monitor);
 })
 
 #define _perf_monitor_if(f, l, tst) __perf_monitor_if(f, l, tst)
-/** /endcond */
+/** \endcond */
 
 /** \brief  Register a performance monitor in the current functional block
 
     The performance monitor will run from the moment this macro is used, till
     the end of the functional block.
+
+    The start state is kept on the stack of the calling thread, so the same
+    probe point can safely be used by several threads at once. Monitors that
+    are nested within each other (in the same thread) form a call tree, which
+    can be printed with perf_monitor_print_tree().
 */
 #define perf_monitor() _perf_monitor(__func__, __LINE__)
 
@@ -115,6 +152,41 @@ void perf_monitor_exit(void);
 */
 void perf_monitor_print(FILE *f);
 
+/** \brief  Print the call tree of the probe points to the given file descriptor
+
+    Each line shows a probe point within the context of its callers, with the
+    inclusive and self time spent there.
+
+    \param  f               A valid file descriptor to which the messages will
+                            be printed. Use "stdout" for the standard output.
+*/
+void perf_monitor_print_tree(FILE *f);
+
+/** \brief  Reset the statistics of all the probe points
+
+    This can be used to measure deltas, for instance once per frame. The shape
+    of the call tree is kept, only its counters are cleared. Monitored blocks
+    that are running while this function is called will still account their
+    full duration when they end.
+*/
+void perf_monitor_reset(void);
+
+/** \brief  Get the number of probe points
+
+    \return                 The number of probe points in the program.
+*/
+size_t perf_monitor_count(void);
+
+/** \brief  Take a snapshot of the statistics of all the probe points
+
+    \param  out             The array in which to copy the statistics.
+    \param  count           The number of elements in the array.
+    \return                 The number of probe points copied.
+
+    \sa perf_monitor_count()
+*/
+size_t perf_monitor_snapshot(struct perf_monitor *out, size_t count);
+
 /** @} */
 
 __END_DECLS
@@ -0,0 +1,157 @@
+/* KallistiOS ##version##
+
+   arch/dreamcast/include/dc/profiler.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+*/
+
+/** \file    dc/profiler.h
+    \brief   Statistical sampling profiler
+    \ingroup profiler
+
+    This file contains an API for a sampling profiler, which periodically
+    records where the CPU is executing code without requiring any source
+    annotation or special compiler instrumentation.
+*/
+
+#ifndef __DC_PROFILER_H
+#define __DC_PROFILER_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+#include <arch/types.h>
+
+/** \defgroup   profiler Sampling profiler
+    \brief      Timer-driven statistical profiler
+    \ingroup    debugging
+
+    The sampling profiler uses \ref TMU1 to periodically interrupt the CPU and
+    record the interrupted program counter (PC), procedure register (PR) and
+    the ID of the thread that was running into a preallocated ring buffer.
+    Once the ring buffer is full, the oldest samples are overwritten.
+
+    The collected samples can then be written out in one of two formats:
+        - gprof's gmon.out format, which contains a flat PC histogram and an
+          approximate call graph built from the (PR, PC) pairs. Run
+          `sh-elf-gprof program.elf gmon.out` on the host to get a report.
+        - A "folded stacks" text format (one `thread N;PR;PC count` line per
+          unique sample), suitable for flame graph tools once the addresses
+          are resolved with `sh-elf-addr2line -f -e program.elf`.
+
+    \warning
+    While the profiler is running, \ref TMU1 is in use. timer_spin_sleep()
+    detects this and busy-waits with timer_spin_delay_us() instead, which
+    reads the uptime timer rather than reprogramming \ref TMU1.
+
+    \note
+    Samples are only taken while interrupts are enabled, so code running with
+    interrupts masked is attributed to the point where they are re-enabled.
+
+    @{
+*/
+
+/** \brief  Default sampling rate, in Hz. */
+#define PROFILER_RATE_DEFAULT   1000
+
+/** \brief  Maximum sampling rate, in Hz. */
+#define PROFILER_RATE_MAX       100000
+
+/** \brief  A single profiler sample. */
+typedef struct prof_sample {
+    uint32_t pc;    /**< \brief Interrupted program counter */
+    uint32_t pr;    /**< \brief Procedure register (return address) */
+    tid_t    tid;   /**< \brief ID of the interrupted thread (0 if none) */
+} prof_sample_t;
+
+/** \brief  Initialize the sampling profiler.
+
+    This function allocates the sample ring buffer, and configures the sampling
+    rate. It does not start sampling; use profiler_start() for that.
+
+    \param  samples         The number of samples the ring buffer can hold.
+    \param  rate            The sampling rate in Hz, or 0 for
+                            \ref PROFILER_RATE_DEFAULT.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - samples is 0 or rate is above \ref PROFILER_RATE_MAX \n
+    \em     EBUSY - the profiler is already initialized \n
+    \em     ENOMEM - out of memory
+*/
+int profiler_init(size_t samples, unsigned int rate);
+
+/** \brief  Shut down the sampling profiler.
+
+    This function stops sampling if needed, and frees the ring buffer.
+*/
+void profiler_shutdown(void);
+
+/** \brief  Start taking samples.
+
+    \retval 0               On success.
+    \retval -1              If the profiler is not initialized.
+*/
+int profiler_start(void);
+
+/** \brief  Stop taking samples.
+
+    The collected samples are kept, and sampling can be resumed with
+    profiler_start().
+*/
+void profiler_stop(void);
+
+/** \brief  Discard all the collected samples. */
+void profiler_clear(void);
+
+/** \brief  Get the number of samples currently held in the ring buffer.
+    \return                 The number of samples available.
+*/
+size_t profiler_sample_count(void);
+
+/** \brief  Get the number of samples that were overwritten.
+
+    \return                 The number of samples lost because the ring buffer
+                            wrapped around since the last profiler_clear().
+*/
+uint32_t profiler_overruns(void);
+
+/** \brief  Copy the collected samples.
+
+    This function copies the samples currently held in the ring buffer, oldest
+    first, without removing them. If there are more samples than \p count,
+    only the most recent ones are copied.
+
+    \param  out             Where to store the samples.
+    \param  count           The maximum number of samples to copy.
+    \return                 The number of samples copied.
+*/
+size_t profiler_get_samples(prof_sample_t *out, size_t count);
+
+/** \brief  Write the collected samples in gprof's gmon.out format.
+
+    \param  fn              The path of the file to write.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+*/
+int profiler_write_gmon(const char *fn);
+
+/** \brief  Write the collected samples in folded stacks format.
+
+    Each line of the output has the form `thread N;PR;PC count`, where N is the
+    thread ID and PR and PC are hexadecimal addresses.
+
+    \param  fn              The path of the file to write.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+*/
+int profiler_write_folded(const char *fn);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __DC_PROFILER_H */
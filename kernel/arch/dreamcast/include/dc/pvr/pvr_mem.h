@@ -5,6 +5,7 @@
    Copyright (C) 2014 Lawrence Sebald
    Copyright (C) 2023 Ruslan Rostovtsev
    Copyright (C) 2024 Falco Girgis
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /** \file       dc/pvr/pvr_mem.h
@@ -24,7 +25,9 @@
 #ifndef __DC_PVR_PVR_MEM_H
 #define __DC_PVR_PVR_MEM_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <kos/tlsf.h>
 
 #include <sys/cdefs.h>
 __BEGIN_DECLS
@@ -48,8 +51,9 @@ typedef void *pvr_ptr_t;
     \brief                   Memory management API for VRAM
     \ingroup                 pvr_vram
 
-    PVR memory management in KOS uses a modified dlmalloc; see the
-    source file pvr_mem_core.c for more info. 
+    PVR memory management in KOS uses a TLSF allocator (see \ref system_tlsf),
+    so allocating and freeing textures takes constant time no matter how many
+    are resident. All of its bookkeeping is kept in main RAM.
 */
 
 /** \brief   Allocate a chunk of memory from texture space.
@@ -66,6 +70,20 @@ typedef void *pvr_ptr_t;
 */
 pvr_ptr_t pvr_mem_malloc(size_t size);
 
+/** \brief   Allocate an aligned chunk of memory from texture space.
+    \ingroup pvr_mem_mgmt
+
+    This function works like pvr_mem_malloc(), but allows a stricter alignment
+    than the default 32 bytes to be requested, for instance to place a texture
+    on a stride or page boundary.
+
+    \param  size            The amount of memory to allocate
+    \param  align           The required alignment, a power of two
+
+    \return                 A pointer to the memory on success, NULL on error
+*/
+pvr_ptr_t pvr_mem_malloc_aligned(size_t size, size_t align);
+
 /** \brief   Free a block of allocated memory in the PVR RAM pool.
     \ingroup pvr_mem_mgmt
 
@@ -82,6 +100,45 @@ void pvr_mem_free(pvr_ptr_t chunk);
 */
 size_t pvr_mem_available(void);
 
+/** \brief   Get usage and fragmentation statistics of the PVR RAM pool.
+    \ingroup pvr_mem_mgmt
+
+    The statistics include the size of the largest free block, which is the
+    largest texture that can currently be allocated, and an estimate of the
+    external fragmentation of the pool.
+
+    \param  stats           Where to store the statistics
+
+    \retval 0               On success
+    \retval -1              If the PVR hasn't been initialized
+*/
+int pvr_mem_get_stats(tlsf_stats_t *stats);
+
+/** \brief   Defragment the PVR RAM pool.
+    \ingroup pvr_mem_mgmt
+
+    This function moves allocated blocks down towards the start of texture
+    memory, so that the free memory ends up in one contiguous block. Blocks
+    from pvr_mem_malloc_aligned() keep their alignment. The data is moved
+    with PVR DMA, through a bounce buffer in main RAM.
+
+    Each moved block is recorded in the remap table, and all the pointers to
+    it (polygon headers, texture objects, etc.) must be updated by the caller.
+    If the table is too small, defragmentation stops early; it can be resumed
+    by calling this function again.
+
+    \warning
+    The PVR must not be using any of the textures while this runs, so call it
+    between frames, after pvr_wait_ready(). It also uses PVR DMA, so no other
+    PVR DMA transfer may be in progress.
+
+    \param  remap           The remap table to fill
+    \param  max             The number of entries of the table
+
+    \return                 The number of blocks that were moved
+*/
+size_t pvr_mem_defrag(tlsf_remap_t *remap, size_t max);
+
 /** \brief   Reset the PVR RAM pool.
     \ingroup pvr_mem_mgmt
 
@@ -100,7 +157,7 @@ void pvr_mem_print_list(void);
 /** \brief   Print statistics about the PVR RAM pool.
     \ingroup pvr_mem_mgmt
 
-    This prints out statistics like what malloc_stats() provides. Also, if
+    This prints out the same statistics as pvr_mem_get_stats(). Also, if
     KM_DBG is enabled in pvr_mem.c, it prints the list of allocated blocks.
 */
 void pvr_mem_stats(void);
@@ -5,6 +5,7 @@
    Copyright (C) 2014 Lawrence Sebald
    Copyright (C) 2023 Ruslan Rostovtsev
    Copyright (C) 2024 Falco Girgis
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /** \file       dc/pvr/pvr_txr.h
@@ -24,6 +25,7 @@
 #ifndef __DC_PVR_PVR_TEXTURE_H
 #define __DC_PVR_PVR_TEXTURE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <sys/cdefs.h>
@@ -82,8 +84,9 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32_t count);
     This function loads a texture to the PVR's RAM with the specified set of
     flags. It will currently always twiddle the data, whether you ask it to or
     not, and many of the parameters are just plain not supported at all...
-    Pretty much the only supported flag, other than the format ones is the
-    PVR_TXRLOAD_INVERT_Y one.
+    Other than the format ones, the supported flags are PVR_TXRLOAD_INVERT_Y
+    and PVR_TXRLOAD_DMA. This is the same as pvr_txr_load_twiddle(), without
+    a stride.
 
     This will be slower than using pvr_txr_load() in pretty much all cases, so
     unless you need to twiddle your texture, just use that instead.
@@ -99,6 +102,126 @@ void pvr_txr_load(const void *src, pvr_ptr_t dst, uint32_t count);
 void pvr_txr_load_ex(const void *src, pvr_ptr_t dst,
                      uint32_t w, uint32_t h, uint32_t flags);
 
+/** \brief   Twiddle texture data into a buffer in main RAM.
+    \ingroup pvr_txr_mgmt
+
+    This converts a texture stored row by row into the twiddled layout the PVR
+    uses, 32 bytes of output at a time. The source rows can be spaced out,
+    for instance to twiddle part of a larger image.
+
+    \param  dst             The buffer to write to, which must hold
+                            w * h * bpp / 8 bytes.
+    \param  src             The texture data.
+    \param  w               The width of the texture, a power of two up to
+                            1024.
+    \param  h               The height of the texture, a power of two up to
+                            1024.
+    \param  stride          The distance between the rows of src, in bytes, or
+                            0 if they are contiguous.
+    \param  flags           One of PVR_TXRLOAD_4BPP, PVR_TXRLOAD_8BPP and
+                            PVR_TXRLOAD_16BPP, optionally ORed with
+                            PVR_TXRLOAD_INVERT_Y.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EINVAL if a
+                            parameter is invalid).
+
+    \see    pvr_txrload_constants
+*/
+int pvr_txr_twiddle(void *dst, const void *src, uint32_t w, uint32_t h,
+                    size_t stride, uint32_t flags);
+
+/** \brief   Load texture data into PVR RAM, twiddling it in the process.
+    \ingroup pvr_txr_mgmt
+
+    This is pvr_txr_twiddle(), with its output sent to the PVR's RAM through
+    the store queues, or by DMA if PVR_TXRLOAD_DMA is in the flags. DMA goes
+    through bounce buffers, which are filled while the previous one is being
+    sent. It is only used if dst is aligned on 32 bytes, and if the buffers
+    can be allocated. Otherwise, the store queues are used.
+
+    \param  src             The texture data.
+    \param  dst             The location to copy to, aligned on 8 bytes.
+    \param  w               The width of the texture, a power of two up to
+                            1024.
+    \param  h               The height of the texture, a power of two up to
+                            1024.
+    \param  stride          The distance between the rows of src, in bytes, or
+                            0 if they are contiguous.
+    \param  flags           One of PVR_TXRLOAD_4BPP, PVR_TXRLOAD_8BPP and
+                            PVR_TXRLOAD_16BPP, optionally ORed with
+                            PVR_TXRLOAD_INVERT_Y and PVR_TXRLOAD_DMA.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EINVAL if a
+                            parameter is invalid).
+
+    \see    pvr_txrload_constants
+*/
+int pvr_txr_load_twiddle(const void *src, pvr_ptr_t dst, uint32_t w,
+                         uint32_t h, size_t stride, uint32_t flags);
+
+/** \brief   Get the offset of a level in a mipmapped texture.
+    \ingroup pvr_txr_mgmt
+
+    Mipmapped textures are square, and twiddled. They start with the 1x1
+    level, after a few bytes of padding, followed by each larger level, up to
+    the full size texture. The total size of a mipmapped texture is therefore
+    the offset of the next level, twice as large.
+
+    \param  size            The size of the level, a power of two up to 1024.
+    \param  flags           One of PVR_TXRLOAD_4BPP, PVR_TXRLOAD_8BPP and
+                            PVR_TXRLOAD_16BPP.
+
+    \return                 The offset of the level, in bytes, or 0 if a
+                            parameter is invalid.
+*/
+size_t pvr_txr_mipmap_offset(uint32_t size, uint32_t flags);
+
+/** \brief   Twiddle the levels of a mipmapped texture into a buffer in main
+             RAM.
+    \ingroup pvr_txr_mgmt
+
+    \param  dst             The buffer to write to, which must hold
+                            pvr_txr_mipmap_offset(size * 2, flags) bytes.
+    \param  levels          The data of each level, from the full size one to
+                            the 1x1 one, with contiguous rows.
+    \param  size            The size of the texture, a power of two up to
+                            1024.
+    \param  flags           One of PVR_TXRLOAD_4BPP, PVR_TXRLOAD_8BPP and
+                            PVR_TXRLOAD_16BPP, optionally ORed with
+                            PVR_TXRLOAD_INVERT_Y.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EINVAL if a
+                            parameter is invalid).
+*/
+int pvr_txr_twiddle_mipmaps(void *dst, const void *const *levels,
+                            uint32_t size, uint32_t flags);
+
+/** \brief   Load the levels of a mipmapped texture into PVR RAM, twiddling
+             them in the process.
+    \ingroup pvr_txr_mgmt
+
+    This is pvr_txr_twiddle_mipmaps(), with its output sent to the PVR's RAM
+    as with pvr_txr_load_twiddle().
+
+    \param  levels          The data of each level, from the full size one to
+                            the 1x1 one, with contiguous rows.
+    \param  dst             The location to copy to, aligned on 8 bytes.
+    \param  size            The size of the texture, a power of two up to
+                            1024.
+    \param  flags           One of PVR_TXRLOAD_4BPP, PVR_TXRLOAD_8BPP and
+                            PVR_TXRLOAD_16BPP, optionally ORed with
+                            PVR_TXRLOAD_INVERT_Y and PVR_TXRLOAD_DMA.
+
+    \retval 0               On success.
+    \retval -1              On error (errno will be set to EINVAL if a
+                            parameter is invalid).
+*/
+int pvr_txr_load_mipmaps(const void *const *levels, pvr_ptr_t dst,
+                         uint32_t size, uint32_t flags);
+
 /** \brief   Load a KOS Platform Independent Image (subject to constraint
              checking).
     \ingroup pvr_txr_mgmt
@@ -124,9 +247,9 @@ void pvr_txr_load_ex(const void *src, pvr_ptr_t dst,
                             \ref PVR_TXRLOAD_FMT_NOTWIDDLE (or equivalently
                             \ref PVR_TXRLOAD_FMT_TWIDDLED) and
                             \ref PVR_TXRLOAD_INVERT_Y in the flags.
-    \note                   DMA and Store Queue based loading is not available
-                            from this function if it twiddles the texture while
-                            loading.
+    \note                   If this function twiddles the texture while
+                            loading, it uses the Store Queues, or DMA if
+                            \ref PVR_TXRLOAD_DMA is set.
 */
 void pvr_txr_load_kimg(const kos_img_t *img, pvr_ptr_t dst, uint32_t flags);
 
@@ -0,0 +1,244 @@
+/* KallistiOS ##version##
+
+   dc/pvr/pvr_xform.h
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/** \file       dc/pvr/pvr_xform.h
+    \brief      Batched vertex transform, clip and submission.
+    \ingroup    pvr_xform
+
+    This file contains a geometry pipeline that takes arrays of vertices in
+    object space, transforms them with the SH4's matrix unit, culls and clips
+    the resulting triangles, and submits them to the PVR as triangle strips,
+    either through the store queues or into the vertex DMA buffers.
+
+    \see    dc/matrix.h
+    \see    dc/matrix3d.h
+*/
+
+#ifndef __DC_PVR_PVR_XFORM_H
+#define __DC_PVR_PVR_XFORM_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+#include <dc/pvr.h>
+#include <dc/vector.h>
+
+/** \defgroup   pvr_xform   Transform Pipeline
+    \brief                  Batched vertex transform, clip and submission
+    \ingroup                pvr_geometry
+
+    A pipeline holds a matrix, culling and clipping settings, and an output
+    target. Each draw call takes an array of pvr_vertex_t, whose x, y and z
+    fields are in object space and whose flags are ignored, and does the
+    following:
+
+    - All vertices are transformed with the matrix in one pass, using FTRV.
+      The transformed w must be the distance to the viewer, as with the
+      perspective matrices of dc/matrix3d.h. The vertices in front of the
+      near plane are projected, with x/w and y/w as screen coordinates and
+      1/w as depth.
+    - Triangles that are entirely behind the near plane, or entirely outside
+      of the viewport if one is set, are rejected.
+    - Triangles crossing the near plane are clipped, with their texture
+      coordinates and colors interpolated.
+    - Back-facing triangles are culled, if culling is enabled.
+    - The remaining triangles are sent to the target. Triangle strips are
+      kept as strips, and are only split where triangles were removed.
+
+    The polygon header must be submitted to the same target beforehand, as
+    usual. Statistics about the work done are kept until they are reset.
+
+    On other platforms, the transform is done in C, so that the pipeline can
+    be tested on the host.
+
+    @{
+*/
+
+/** \brief  Opaque pipeline type. */
+typedef struct pvr_xform pvr_xform_t;
+
+/** \brief  Primitive types. */
+typedef enum pvr_xform_prim {
+    PVR_XFORM_TRIANGLES,        /**< \brief Independent triangles */
+    PVR_XFORM_STRIP             /**< \brief One triangle strip */
+} pvr_xform_prim_t;
+
+/** \brief  Culling modes.
+
+    The orientation is the one on screen, with y pointing down. Within strips,
+    the orientation of every other triangle is reversed, as on the PVR.
+*/
+typedef enum pvr_xform_cull {
+    PVR_XFORM_CULL_NONE,        /**< \brief No culling */
+    PVR_XFORM_CULL_CW,          /**< \brief Cull clockwise triangles */
+    PVR_XFORM_CULL_CCW          /**< \brief Cull counter-clockwise triangles */
+} pvr_xform_cull_t;
+
+/** \brief  Default near plane, in transformed w. */
+#define PVR_XFORM_NEAR_DEFAULT  1.0f
+
+/** \brief  Pipeline statistics. */
+typedef struct pvr_xform_stats {
+    uint32_t vertices_in;       /**< \brief Vertices transformed */
+    uint32_t triangles_in;      /**< \brief Triangles processed */
+    uint32_t rejected;          /**< \brief Triangles off screen or behind */
+    uint32_t culled;            /**< \brief Back-facing triangles */
+    uint32_t clipped;           /**< \brief Triangles clipped by the near plane */
+    uint32_t vertices_out;      /**< \brief Vertices submitted */
+    uint32_t strips_out;        /**< \brief Strips submitted */
+    uint32_t dropped;           /**< \brief Vertices lost to a full buffer */
+} pvr_xform_stats_t;
+
+/** \brief  Create a pipeline.
+
+    The new pipeline has an identity matrix, no culling, no viewport, the
+    default near plane, and no target.
+
+    \return                 The new pipeline, or NULL on failure (errno will
+                            be set to ENOMEM).
+*/
+pvr_xform_t *pvr_xform_create(void);
+
+/** \brief  Destroy a pipeline.
+    \param  xf              The pipeline to destroy.
+*/
+void pvr_xform_destroy(pvr_xform_t *xf);
+
+/** \brief  Set the matrix of a pipeline.
+
+    \param  xf              The pipeline to modify.
+    \param  mat             The matrix to transform vertices with, from
+                            object space to screen space. If NULL, the
+                            current internal matrix is used, as set up with
+                            the functions of dc/matrix.h and dc/matrix3d.h.
+
+    \note                   Draw calls load the matrix of the pipeline into
+                            the internal matrix.
+*/
+void pvr_xform_set_matrix(pvr_xform_t *xf, const matrix_t *mat);
+
+/** \brief  Set the culling mode of a pipeline.
+    \param  xf              The pipeline to modify.
+    \param  cull            The culling mode.
+*/
+void pvr_xform_set_cull(pvr_xform_t *xf, pvr_xform_cull_t cull);
+
+/** \brief  Set the near plane of a pipeline.
+
+    Vertices whose transformed w is lower than this value are clipped. It
+    must be greater than zero.
+
+    \param  xf              The pipeline to modify.
+    \param  near            The near plane, in transformed w.
+*/
+void pvr_xform_set_near(pvr_xform_t *xf, float near);
+
+/** \brief  Set the viewport of a pipeline.
+
+    Triangles that are entirely outside of the given rectangle are rejected.
+    Others are left to the PVR to clip. An empty rectangle disables the
+    rejection, which is the default.
+
+    \param  xf              The pipeline to modify.
+    \param  x0              The left edge, in pixels.
+    \param  y0              The top edge, in pixels.
+    \param  x1              The right edge, in pixels.
+    \param  y1              The bottom edge, in pixels.
+*/
+void pvr_xform_set_viewport(pvr_xform_t *xf, float x0, float y0,
+                            float x1, float y1);
+
+/** \brief  Submit through the store queues (Direct Rendering).
+
+    \param  xf              The pipeline to modify.
+    \param  state           The Direct Rendering state, initialized with
+                            pvr_dr_init(), which is updated as vertices are
+                            submitted.
+*/
+void pvr_xform_target_dr(pvr_xform_t *xf, pvr_dr_state_t *state);
+
+/** \brief  Submit into the vertex DMA buffer of a list.
+
+    Vertex DMA must be enabled. Vertices are written at the tail of the
+    buffer, as returned by pvr_vertbuf_tail(), which is advanced at the end of
+    each draw call. If the buffer gets full, the strip being written is
+    discarded, and so is the rest of the draw call.
+
+    \param  xf              The pipeline to modify.
+    \param  list            The list to submit to.
+*/
+void pvr_xform_target_list(pvr_xform_t *xf, pvr_list_t list);
+
+/** \brief  Write into a buffer in memory.
+
+    Vertices are appended to the buffer by the draw calls. If the buffer gets
+    full, the strip being written is discarded, and so is everything after
+    it.
+
+    \param  xf              The pipeline to modify.
+    \param  buf             The buffer to write to.
+    \param  count           The capacity of the buffer, in vertices.
+*/
+void pvr_xform_target_buffer(pvr_xform_t *xf, pvr_vertex_t *buf,
+                             size_t count);
+
+/** \brief  Get the number of vertices written to the buffer target.
+    \param  xf              The pipeline to query.
+    \return                 The number of vertices in the buffer.
+*/
+size_t pvr_xform_buffer_used(const pvr_xform_t *xf);
+
+/** \brief  Transform and submit an array of vertices.
+
+    \param  xf              The pipeline to use.
+    \param  prim            How the vertices form triangles.
+    \param  vtx             The vertices.
+    \param  count           The number of vertices.
+
+    \return                 The number of vertices submitted, or -1 on error
+                            (errno will be set to EINVAL if no target is set,
+                            or ENOMEM).
+*/
+int pvr_xform_draw(pvr_xform_t *xf, pvr_xform_prim_t prim,
+                   const pvr_vertex_t *vtx, size_t count);
+
+/** \brief  Transform and submit an indexed array of vertices.
+
+    Each vertex is transformed once, however many times it is referenced.
+
+    \param  xf              The pipeline to use.
+    \param  prim            How the indexed vertices form triangles.
+    \param  vtx             The vertices.
+    \param  vcount          The number of vertices.
+    \param  idx             The indices of the vertices to use.
+    \param  icount          The number of indices.
+
+    \return                 The number of vertices submitted, or -1 on error
+                            (errno will be set to EINVAL if no target is set
+                            or an index is out of range, or ENOMEM).
+*/
+int pvr_xform_draw_indexed(pvr_xform_t *xf, pvr_xform_prim_t prim,
+                           const pvr_vertex_t *vtx, size_t vcount,
+                           const uint16_t *idx, size_t icount);
+
+/** \brief  Get the statistics of a pipeline.
+    \param  xf              The pipeline to query.
+    \param  stats           Where to store the statistics.
+*/
+void pvr_xform_get_stats(const pvr_xform_t *xf, pvr_xform_stats_t *stats);
+
+/** \brief  Reset the statistics of a pipeline.
+    \param  xf              The pipeline to modify.
+*/
+void pvr_xform_reset_stats(pvr_xform_t *xf);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __DC_PVR_PVR_XFORM_H */
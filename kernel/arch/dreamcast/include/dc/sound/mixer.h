@@ -0,0 +1,249 @@
+/* KallistiOS ##version##
+
+   dc/sound/mixer.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+*/
+
+/** \file    dc/sound/mixer.h
+    \brief   Software sound mixer.
+    \ingroup audio_mixer
+
+    This file contains a software mixer, which mixes any number of virtual
+    voices on the main CPU into a single stereo stream. Unlike the sound
+    effects of dc/sound/sfxmgr.h, which each take a hardware channel of the
+    AICA, the number of voices playing at once is only limited by the CPU
+    time available.
+
+    The mixing core is portable C with no dependencies on the rest of KOS, so
+    that it can be built and tested on the host; see utils/sndmixtest.
+
+    \see    dc/sound/stream.h
+*/
+
+#ifndef __DC_SOUND_MIXER_H
+#define __DC_SOUND_MIXER_H
+
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** \defgroup audio_mixer   Software Mixer
+    \brief                  Mixing of virtual voices on the main CPU
+    \ingroup                audio
+
+    A mixer is created with a number of voices and an output rate, and
+    renders interleaved signed 16-bit stereo frames. Each voice plays one
+    sample, with its own volume, panning and pitch, and is resampled to the
+    output rate with linear or polyphase (8-tap windowed sinc) interpolation.
+    All the mixing is done in fixed point.
+
+    Samples can be signed 8-bit or 16-bit PCM, mono or stereo interleaved,
+    or mono 4-bit Yamaha ADPCM, as produced by wav2adpcm. The sample data is
+    read in place and must stay valid while a voice plays it.
+
+    On the Dreamcast, snd_mixer_stream_start() plays the output of a mixer
+    through a stereo snd_stream. Voices can then be started and modified from
+    any thread.
+
+    @{
+*/
+
+/** \brief  Sample formats. */
+typedef enum snd_mixer_format {
+    SND_MIXER_PCM16,        /**< \brief Signed 16-bit PCM */
+    SND_MIXER_PCM8,         /**< \brief Signed 8-bit PCM */
+    SND_MIXER_ADPCM         /**< \brief 4-bit Yamaha ADPCM (mono only) */
+} snd_mixer_format_t;
+
+/** \brief  Interpolation modes. */
+typedef enum snd_mixer_interp {
+    SND_MIXER_LINEAR,       /**< \brief Linear interpolation */
+    SND_MIXER_POLYPHASE     /**< \brief 8-tap windowed sinc filter */
+} snd_mixer_interp_t;
+
+/** \brief  Description of a sample to play on a voice. */
+typedef struct snd_mixer_sample {
+    const void *data;           /**< \brief Sample data */
+    uint32_t length;            /**< \brief Length, in frames */
+    uint32_t rate;              /**< \brief Sampling rate, in Hz */
+    snd_mixer_format_t format;  /**< \brief Format of the data */
+    int channels;               /**< \brief 1 for mono, 2 for stereo */
+
+    /** \brief  Loop start, in frames. */
+    uint32_t loop_start;
+
+    /** \brief  Loop end (excluded), in frames, or 0 to play only once.
+
+        For ADPCM samples, the decoder state at the loop start is recorded the
+        first time it is reached, so that looping is seamless.
+    */
+    uint32_t loop_end;
+} snd_mixer_sample_t;
+
+/** \brief  Opaque mixer type. */
+typedef struct snd_mixer snd_mixer_t;
+
+/** \brief  Voice handle type.
+
+    Handles include a generation counter, so that a handle to a voice that
+    has finished playing becomes invalid, even if the voice slot is reused.
+*/
+typedef int snd_mixer_voice_t;
+
+/** \brief  Invalid voice handle. */
+#define SND_MIXER_INVALID   -1
+
+/** \brief  Maximum number of voices of a mixer. */
+#define SND_MIXER_MAX_VOICES    1024
+
+/** \brief  Pitch value for playback at the sample's own rate. */
+#define SND_MIXER_PITCH_NORMAL  0x10000
+
+/** \brief  Create a mixer.
+
+    \param  voices          The number of voices.
+    \param  rate            The output rate, in Hz.
+    \return                 The new mixer, or NULL on error.
+*/
+snd_mixer_t *snd_mixer_create(unsigned int voices, unsigned int rate);
+
+/** \brief  Destroy a mixer.
+
+    If the mixer is playing through a stream, snd_mixer_stream_stop() must be
+    called first.
+
+    \param  mixer           The mixer to destroy.
+*/
+void snd_mixer_destroy(snd_mixer_t *mixer);
+
+/** \brief  Set the locking functions of a mixer.
+
+    The mixer calls these around every operation, so that voices can be
+    controlled from a thread while another one renders. By default, no
+    locking is done. snd_mixer_stream_start() sets up locking on its own.
+
+    \param  mixer           The mixer to modify.
+    \param  lock            The function to lock the mixer, or NULL.
+    \param  unlock          The function to unlock the mixer, or NULL.
+    \param  data            A parameter to pass to both functions.
+*/
+void snd_mixer_set_lock(snd_mixer_t *mixer, void (*lock)(void *),
+                        void (*unlock)(void *), void *data);
+
+/** \brief  Set the interpolation mode of a mixer.
+
+    \param  mixer           The mixer to modify.
+    \param  interp          The new interpolation mode. The default is
+                            SND_MIXER_LINEAR.
+*/
+void snd_mixer_set_interp(snd_mixer_t *mixer, snd_mixer_interp_t interp);
+
+/** \brief  Set the master volume of a mixer.
+
+    \param  mixer           The mixer to modify.
+    \param  vol             The master volume, from 0 to 255 (the default).
+*/
+void snd_mixer_set_volume(snd_mixer_t *mixer, int vol);
+
+/** \brief  Render frames from a mixer.
+
+    This advances all the voices, and stops those that reached the end of
+    their sample.
+
+    \param  mixer           The mixer to render from.
+    \param  out             Where to store the interleaved stereo frames.
+    \param  frames          The number of frames to render.
+*/
+void snd_mixer_render(snd_mixer_t *mixer, int16_t *out, size_t frames);
+
+/** \brief  Start playing a sample on a free voice.
+
+    \param  mixer           The mixer to play on.
+    \param  sample          The sample to play. The structure is copied.
+    \param  vol             The volume, from 0 to 255.
+    \param  pan             The panning, from 0 (left) to 255 (right), 128
+                            being the center.
+    \param  pitch           The playback speed, in 16.16 fixed point, relative
+                            to the sample's rate (SND_MIXER_PITCH_NORMAL to
+                            play it at its own rate).
+    \return                 A handle to the voice, or SND_MIXER_INVALID if
+                            the sample is invalid or all voices are in use.
+*/
+snd_mixer_voice_t snd_mixer_play(snd_mixer_t *mixer,
+                                 const snd_mixer_sample_t *sample,
+                                 int vol, int pan, uint32_t pitch);
+
+/** \brief  Stop a voice.
+    \param  mixer           The mixer of the voice.
+    \param  voice           The voice to stop.
+*/
+void snd_mixer_stop(snd_mixer_t *mixer, snd_mixer_voice_t voice);
+
+/** \brief  Stop all voices.
+    \param  mixer           The mixer to stop.
+*/
+void snd_mixer_stop_all(snd_mixer_t *mixer);
+
+/** \brief  Check whether a voice is still playing.
+    \param  mixer           The mixer of the voice.
+    \param  voice           The voice to check.
+    \return                 1 if the voice is playing, 0 otherwise.
+*/
+int snd_mixer_playing(snd_mixer_t *mixer, snd_mixer_voice_t voice);
+
+/** \brief  Set the volume and panning of a voice.
+    \param  mixer           The mixer of the voice.
+    \param  voice           The voice to modify.
+    \param  vol             The volume, from 0 to 255.
+    \param  pan             The panning, from 0 (left) to 255 (right).
+*/
+void snd_mixer_set_voice_volume(snd_mixer_t *mixer, snd_mixer_voice_t voice,
+                                int vol, int pan);
+
+/** \brief  Set the pitch of a voice.
+    \param  mixer           The mixer of the voice.
+    \param  voice           The voice to modify.
+    \param  pitch           The playback speed, in 16.16 fixed point.
+*/
+void snd_mixer_set_voice_pitch(snd_mixer_t *mixer, snd_mixer_voice_t voice,
+                               uint32_t pitch);
+
+/** \brief  Get the number of voices playing.
+    \param  mixer           The mixer to query.
+    \return                 The number of voices playing.
+*/
+unsigned int snd_mixer_voices_playing(snd_mixer_t *mixer);
+
+/** \brief  Play the output of a mixer through a sound stream.
+
+    This allocates a stereo stream, and starts it at the output rate of the
+    mixer, with a callback that renders from the mixer. The stream system must
+    have been initialized with snd_stream_init(), and the stream must be
+    polled as any other, either with snd_stream_poll() or by the streaming
+    service thread. Locking is set up so that voices can be controlled from
+    any thread.
+
+    \param  mixer           The mixer to play.
+    \param  bufsize         The buffer size of the stream, per channel, in
+                            bytes. Smaller buffers reduce latency, but need
+                            to be polled more often.
+    \return                 The stream handle, or -1 on error.
+*/
+int snd_mixer_stream_start(snd_mixer_t *mixer, int bufsize);
+
+/** \brief  Stop playing the output of a mixer.
+
+    This stops and destroys the stream allocated by snd_mixer_stream_start().
+
+    \param  mixer           The mixer to stop playing.
+*/
+void snd_mixer_stream_stop(snd_mixer_t *mixer);
+
+/** @} */
+
+__END_DECLS
+
+#endif /* __DC_SOUND_MIXER_H */
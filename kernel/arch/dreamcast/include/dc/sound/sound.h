@@ -3,6 +3,7 @@
    dc/sound/sound.h
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2023, 2024 Ruslan Rostovtsev
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -28,6 +29,7 @@ __BEGIN_DECLS
 #include <arch/types.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <kos/tlsf.h>
 
 /** \defgroup audio_driver  Driver
     \brief                  Low-level driver for SPU and audio management
@@ -70,14 +72,40 @@ void snd_mem_free(uint32 addr);
 */
 uint32 snd_mem_available(void);
 
+/** \brief  Get usage and fragmentation statistics of the SPU RAM pool.
+
+    The SPU RAM pool is managed by a TLSF allocator (see \ref system_tlsf),
+    which keeps all of its bookkeeping in main RAM.
+
+    \param  stats           Where to store the statistics.
+    \retval 0               On success.
+    \retval -1              On error, errno will be set as appropriate.
+
+    \par    Error Conditions:
+    \em     EINVAL - the SPU RAM pool is not initialized \n
+    \em     EAGAIN - the pool is locked by another thread
+*/
+int snd_mem_get_stats(tlsf_stats_t *stats);
+
+/** \brief  Print statistics about the SPU RAM pool.
+
+    This prints the same statistics as snd_mem_get_stats() provides.
+*/
+void snd_mem_stats(void);
+
 /** \brief  Reinitialize the SPU RAM pool.
 
     This function reinitializes the SPU RAM pool with the given base offset
     within the memory space. There is generally not a good reason to do this in
     your own code, but the functionality is there if needed.
 
+    The base is rounded up to 32 bytes. Offset 0 is never handed out, since
+    snd_mem_malloc() returns 0 on failure, so a reserve of 0 still leaves the
+    first 32 bytes out of the pool.
+
     \param  reserve         The amount of memory to reserve as a base.
-    \retval 0               On success (no failure conditions defined).
+    \retval 0               On success.
+    \retval -1              On error (out of main RAM).
 */
 int snd_mem_init(uint32 reserve);
 
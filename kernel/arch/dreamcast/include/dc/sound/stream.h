@@ -4,6 +4,7 @@
    Copyright (C) 2002, 2004 Megan Potter
    Copyright (C) 2020 Lawrence Sebald
    Copyright (C) 2023, 2024 Ruslan Rostovtsev
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -29,6 +30,7 @@
 __BEGIN_DECLS
 
 #include <arch/types.h>
+#include <kos/thread.h>
 
 /** \defgroup audio_streaming   Streaming
     \brief                      Streaming audio playback and management
@@ -337,7 +339,9 @@ void snd_stream_stop(snd_stream_hnd_t hnd);
 
     This function polls the specified stream to load more data if necessary. If
     using the streaming support, you must call this function periodically (most
-    likely in a thread), or you won't get any sound output.
+    likely in a thread), or you won't get any sound output, unless the
+    streaming service thread is running (see snd_stream_service_start()), in
+    which case this function does nothing.
 
     \param  hnd             The stream to poll.
     \retval -3              If NULL was returned from the callback.
@@ -347,6 +351,38 @@ void snd_stream_stop(snd_stream_hnd_t hnd);
 */
 int snd_stream_poll(snd_stream_hnd_t hnd);
 
+/** \brief  Start the streaming service thread.
+
+    This function starts a thread that polls all the started streams on its
+    own, so that the application only has to provide the data callbacks. The
+    thread keeps track of the play position of each stream, and sleeps until
+    the earliest time at which one of them has enough room in its buffer to be
+    refilled, so that it wakes up just in time and services every stream
+    that is due at once.
+
+    The data callbacks are called from the service thread, which must have a
+    large enough stack for them, and a priority high enough that the streams
+    don't run out of data while other threads are busy.
+
+    \param  attr            A set of thread attributes for the service thread.
+                            Passing NULL will use the default attributes,
+                            with a priority of PRIO_DEFAULT - 1.
+    \retval 0               On success, or if the service was already running.
+    \retval -1              If the thread could not be created.
+
+    \sa snd_stream_service_stop
+*/
+int snd_stream_service_start(const kthread_attr_t *attr);
+
+/** \brief  Stop the streaming service thread.
+
+    After this function returns, streams must be polled with snd_stream_poll()
+    again. This is done automatically by snd_stream_shutdown().
+
+    \sa snd_stream_service_start
+*/
+void snd_stream_service_stop(void);
+
 /** \brief  Set the volume on the stream.
 
     This function sets the volume of the specified stream.
@@ -4,6 +4,7 @@
 
    Copyright (C) 2001 Anders Clerwall (scav)
    Copyright (C) 2023-2024 Donald Haase
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -24,9 +25,12 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/cdefs.h>
 __BEGIN_DECLS
 
+struct kthread_attr;
+
 /** \defgroup video_display Display
     \brief                  Display and framebuffer configuration
     \ingroup                video
@@ -433,6 +437,112 @@ int vid_screen_shot(const char *destfn);
 */
 size_t vid_screen_shot_data(uint8_t **buffer);
 
+/** \brief   Set up background frame capture.
+    \ingroup video_fb
+
+    This allocates the buffers that vid_capture() and vid_capture_record()
+    take snapshots of the framebuffer into, and starts the thread that encodes
+    them. Snapshots are taken by DMA where possible, so taking one costs the
+    caller very little, and are written out as QOI images
+    (https://qoiformat.org/), which are lossless, and much smaller and faster
+    to write than the PPM files of vid_screen_shot().
+
+    This is called by vid_capture() and vid_capture_record() with the defaults
+    if it hasn't been already. The buffers are sized for the current video
+    mode, and made bigger when needed if none of them is in use.
+
+    \param  buffers         The number of snapshots that can wait to be
+                            written out, or 0 for VID_CAPTURE_BUFFERS.
+    \param  attr            Attributes for the thread, or NULL for the defaults
+                            (a priority of PRIO_DEFAULT + 1).
+
+    \retval 0               On success, or if it had already been set up
+    \retval -1              On error (errno should be set as appropriate)
+
+    \par    Error Conditions:
+    \em     ENOMEM - Out of memory for the buffers or the thread
+*/
+int vid_capture_init(int buffers, const struct kthread_attr *attr);
+
+/** \brief   Shut down background frame capture.
+    \ingroup video_fb
+
+    This stops any recording, writes out the snapshots that are still waiting,
+    then frees the buffers and stops the thread. It is called on shutdown.
+*/
+void vid_capture_shutdown(void);
+
+/** \brief   Capture the current framebuffer to a QOI file.
+    \ingroup video_fb
+
+    This takes a snapshot of the current framebuffer (/vram_l), and returns
+    straight away. The snapshot is written out to the given file, which can
+    be on any writable filesystem, by a low priority thread.
+
+    \param  destfn          The filename to save to.
+
+    \retval 0               On success
+    \retval -1              On error (errno should be set as appropriate)
+
+    \par    Error Conditions:
+    \em     EAGAIN - All of the buffers are waiting to be written out \n
+    \em     EINVAL - The pixel mode isn't supported \n
+    \em     ENOMEM - Out of memory
+*/
+int vid_capture(const char *destfn);
+
+/** \brief   Start recording frames to numbered QOI files.
+    \ingroup video_fb
+
+    This captures the framebuffer every interval vertical blanks, as
+    vid_capture() does, writing each frame to a file named by fmt, which
+    should contain a single integer conversion for the frame number, such as
+    "/pc/capture/frame%05d.qoi". Frames are numbered from 0, and only the ones
+    that are captured are counted, so the files can be turned straight into a
+    video. If there's no buffer free when it's time to take a snapshot, the
+    frame is skipped, and counted by vid_capture_dropped().
+
+    \param  fmt             The format of the filenames.
+    \param  interval        The number of vertical blanks between frames, 1 or
+                            more.
+
+    \retval 0               On success
+    \retval -1              On error (errno should be set as appropriate)
+
+    \par    Error Conditions:
+    \em     EBUSY - Already recording \n
+    \em     EINVAL - The pixel mode or interval isn't supported \n
+    \em     ENOMEM - Out of memory
+*/
+int vid_capture_record(const char *fmt, int interval);
+
+/** \brief   Stop recording frames.
+    \ingroup video_fb
+
+    The frames that have already been captured are still written out.
+*/
+void vid_capture_record_stop(void);
+
+/** \brief   Wait for captured frames to be written out.
+    \ingroup video_fb
+
+    This waits until every frame captured so far has been written out. It can't
+    be called from an interrupt.
+
+    \retval 0               On success
+    \retval -1              If called from an interrupt (errno set to EPERM)
+*/
+int vid_capture_flush(void);
+
+/** \brief   Get the number of frames that weren't captured or written out.
+    \ingroup video_fb
+
+    \return                 The number of frames skipped while recording, or
+                            that couldn't be written out, since
+                            vid_capture_init() was called
+*/
+size_t vid_capture_dropped(void);
+
 __END_DECLS
 
 #endif  /* __DC_VIDEO_H */
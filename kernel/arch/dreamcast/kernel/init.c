@@ -3,6 +3,7 @@
    init.c
    Copyright (C) 2003 Megan Potter
    Copyright (C) 2015 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <stdio.h>
@@ -23,6 +24,7 @@
 #include <dc/perfctr.h>
 #include <dc/ubc.h>
 #include <dc/pvr.h>
+#include <dc/video.h>
 #include <dc/vmufs.h>
 #include <dc/syscalls.h>
 #include <dc/dmac.h>
@@ -332,6 +334,12 @@ void arch_shutdown(void) {
 
     dbglog(DBG_CRITICAL, "arch: shutting down kernel\n");
 
+    /* Finish writing out any frames still being captured */
+    vid_capture_shutdown();
+
+    /* Write out any queued debug output, and go back to doing it directly */
+    dbgio_async_stop();
+
     /* Disable the WDT, if active */
     wdt_disable();
 
@@ -408,6 +416,9 @@ void arch_menu(void) {
    and don't try to call the dtors */
 __used __noreturn
 void arch_abort(void) {
+    /* Write out any queued debug output, without relying on anything else */
+    __dbgio_async_panic();
+
     /* Disable the WDT, if active */
     wdt_disable();
 
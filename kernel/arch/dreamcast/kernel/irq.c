@@ -22,6 +22,7 @@
 #include <kos/thread.h>
 #include <kos/library.h>
 #include <kos/regfield.h>
+#include <kos/trace.h>
 
 /* Macros for accessing related registers. */
 #define TRA    ( *((volatile uint32_t *)(0xff000020)) ) /* TRAPA Exception Register */
@@ -238,6 +239,8 @@ void irq_handle_exception(int code) {
        diagnostics returns if we try to do something in the int. */
     inside_int = ((code&0xf)<<16) | (evt&0xffff);
 
+    trace_event(TRACE_IRQ_ENTER, NULL, evt);
+
     /* If there's a global handler, call it */
     if(global_irq_handler.hdl) {
         global_irq_handler.hdl(evt, irq_srt_addr, global_irq_handler.data);
@@ -263,6 +266,8 @@ void irq_handle_exception(int code) {
         arch_panic("unhandled IRQ/Exception");
     }
 
+    trace_event(TRACE_IRQ_EXIT, NULL, evt);
+
     irq_disable();
     inside_int = 0;
 }
@@ -2,15 +2,20 @@
 
    panic.c
    (c)2001 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <stdio.h>
 #include <arch/arch.h>
+#include <kos/dbgio.h>
 
 /* If something goes badly wrong in the kernel and you don't think you
    can recover, call this. This is a pretty standard tactic from *nixy
    kernels which ought to be avoided if at all possible. */
 void arch_panic(const char *msg) {
+    /* Get out whatever was logged before this first */
+    __dbgio_async_panic();
+
     printf("\nkernel panic: %s\r\n", msg);
     arch_abort();
 }
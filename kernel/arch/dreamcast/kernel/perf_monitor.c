@@ -2,28 +2,118 @@
 
    arch/dreamcast/kernel/perf_monitor.c
    Copyright (C) 2024 Paul Cercueil
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
+#include <string.h>
+
+#include <arch/irq.h>
 #include <arch/timer.h>
 #include <dc/perf_monitor.h>
 
 extern struct perf_monitor _monitors_start, _monitors_end;
 
-void __stop_perf_monitor(struct perf_monitor **monitor) {
-    struct perf_monitor *data = *monitor;
+/* One node of the call tree: a probe point, reached from a given parent. */
+struct perf_monitor_node {
+    struct perf_monitor *monitor;
+    struct perf_monitor_node *parent, *child, *sibling;
+    uint64_t calls, time_ns, self_ns;
+};
+
+static struct perf_monitor_node nodes[PERF_MONITOR_MAX_NODES];
+static unsigned int nodes_used;
+
+/* Top-level nodes of the call tree */
+static struct perf_monitor_node *roots;
+
+/* Innermost running monitor of the current thread */
+static __thread struct perf_monitor_frame *current_frame;
+
+/* Find or allocate the node for the given monitor under the given parent.
+   Must be called with interrupts disabled. */
+static struct perf_monitor_node *
+perf_monitor_node(struct perf_monitor_node *parent,
+                  struct perf_monitor *monitor) {
+    struct perf_monitor_node **list = parent ? &parent->child : &roots;
+    struct perf_monitor_node *node;
+
+    for(node = *list; node; node = node->sibling) {
+        if(node->monitor == monitor)
+            return node;
+    }
+
+    if(nodes_used == PERF_MONITOR_MAX_NODES)
+        return NULL;
+
+    node = &nodes[nodes_used++];
+    node->monitor = monitor;
+    node->parent = parent;
+    node->child = NULL;
+    node->sibling = *list;
+    *list = node;
+
+    return node;
+}
+
+void __stop_perf_monitor(struct perf_monitor_frame **pframe) {
+    struct perf_monitor_frame *frame = *pframe;
+    struct perf_monitor *data = frame->monitor;
+    uint64_t time_ns, event0, event1;
+
+    time_ns = timer_ns_gettime64() - frame->time_start;
+    event0 = perf_cntr_count(PRFC0) - frame->event0_start;
+    event1 = perf_cntr_count(PRFC1) - frame->event1_start;
+
+    irq_disable_scoped();
+
+    data->event0 += event0;
+    data->event1 += event1;
+    data->time_ns += time_ns;
+    data->self_ns += time_ns - frame->child_ns;
 
-    data->event0 += perf_cntr_count(PRFC0) - data->event0_start;
-    data->event1 += perf_cntr_count(PRFC1) - data->event1_start;
-    data->time_ns += timer_ns_gettime64() - data->time_start;
+    if(frame->node) {
+        frame->node->time_ns += time_ns;
+        frame->node->self_ns += time_ns - frame->child_ns;
+    }
+
+    if(frame->parent)
+        frame->parent->child_ns += time_ns;
+
+    current_frame = frame->parent;
 }
 
-struct perf_monitor *__start_perf_monitor(struct perf_monitor *data) {
-    data->calls++;
-    data->time_start = timer_ns_gettime64();
-    data->event0_start = perf_cntr_count(PRFC0);
-    data->event1_start = perf_cntr_count(PRFC1);
+struct perf_monitor_frame *
+__start_perf_monitor(struct perf_monitor_frame *frame,
+                     struct perf_monitor *data) {
+    struct perf_monitor_frame *parent = current_frame;
+
+    frame->monitor = data;
+    frame->parent = parent;
+    frame->child_ns = 0;
+
+    {
+        irq_disable_scoped();
+
+        data->calls++;
+
+        /* Don't track children of a block that didn't get a node either,
+           as they would wrongly show up at the top of the tree. */
+        if(parent && !parent->node)
+            frame->node = NULL;
+        else
+            frame->node = perf_monitor_node(parent ? parent->node : NULL, data);
+
+        if(frame->node)
+            frame->node->calls++;
+    }
+
+    current_frame = frame;
+
+    frame->time_start = timer_ns_gettime64();
+    frame->event0_start = perf_cntr_count(PRFC0);
+    frame->event1_start = perf_cntr_count(PRFC1);
 
-    return data;
+    return frame;
 }
 
 void perf_monitor_init(perf_cntr_event_t event1, perf_cntr_event_t event2) {
@@ -46,6 +136,38 @@ void perf_monitor_exit(void) {
     perf_cntr_timer_enable();
 }
 
+void perf_monitor_reset(void) {
+    struct perf_monitor *monitor;
+    unsigned int i;
+
+    irq_disable_scoped();
+
+    for(monitor = &_monitors_start; monitor < &_monitors_end; monitor++) {
+        monitor->calls = 0;
+        monitor->time_ns = monitor->self_ns = 0;
+        monitor->event0 = monitor->event1 = 0;
+    }
+
+    for(i = 0; i < nodes_used; i++)
+        nodes[i].calls = nodes[i].time_ns = nodes[i].self_ns = 0;
+}
+
+size_t perf_monitor_count(void) {
+    return &_monitors_end - &_monitors_start;
+}
+
+size_t perf_monitor_snapshot(struct perf_monitor *out, size_t count) {
+    size_t nb = perf_monitor_count();
+
+    if(count > nb)
+        count = nb;
+
+    irq_disable_scoped();
+    memcpy(out, &_monitors_start, count * sizeof(*out));
+
+    return count;
+}
+
 void perf_monitor_print(FILE *f) {
     struct perf_monitor *monitor;
 
@@ -53,12 +175,35 @@ void perf_monitor_print(FILE *f) {
         fprintf(f, "Performance monitors:\n");
 
     for(monitor = &_monitors_end - 1; monitor >= &_monitors_start; monitor--) {
-        fprintf(f, "\t%s L%u: %llu calls\n\t\t%llu ns (%f ns/call)\n\t\tevent 0: %llu (%f event/call)\n\t\tevent 1: %llu (%f event/call)\n",
+        fprintf(f, "\t%s L%u: %llu calls\n\t\t%llu ns (%f ns/call), %llu ns self\n\t\tevent 0: %llu (%f event/call)\n\t\tevent 1: %llu (%f event/call)\n",
                 monitor->fn, monitor->line, monitor->calls, monitor->time_ns,
                 monitor->calls ? (float)monitor->time_ns / (float)monitor->calls : 0.0f,
+                monitor->self_ns,
                 monitor->event0,
                 monitor->event0 ? (float)monitor->event0 / (float)monitor->calls : 0.0f,
                 monitor->event1,
                 monitor->event1 ? (float)monitor->event1 / (float)monitor->calls : 0.0f);
     }
 }
+
+static void perf_monitor_print_node(FILE *f, const struct perf_monitor_node *node,
+                                    unsigned int depth) {
+    for(; node; node = node->sibling) {
+        fprintf(f, "\t%*s%s L%u: %llu calls, %llu ns, %llu ns self\n",
+                (int)(depth * 2), "", node->monitor->fn,
+                node->monitor->line, node->calls, node->time_ns, node->self_ns);
+
+        perf_monitor_print_node(f, node->child, depth + 1);
+    }
+}
+
+void perf_monitor_print_tree(FILE *f) {
+    if(!roots)
+        return;
+
+    fprintf(f, "Performance monitors call tree:\n");
+    perf_monitor_print_node(f, roots, 0);
+
+    if(nodes_used == PERF_MONITOR_MAX_NODES)
+        fprintf(f, "\t(call tree truncated, out of nodes)\n");
+}
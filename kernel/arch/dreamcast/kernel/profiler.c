@@ -0,0 +1,332 @@
+/* KallistiOS ##version##
+
+   arch/dreamcast/kernel/profiler.c
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/* This file implements a statistical sampling profiler. TMU1 is used to
+   periodically interrupt the CPU; the interrupted PC, PR and thread ID are
+   recorded into a ring buffer that is allocated up front, so that the
+   interrupt handler never has to allocate memory. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arch/arch.h>
+#include <arch/irq.h>
+#include <arch/timer.h>
+#include <dc/profiler.h>
+#include <kos/thread.h>
+
+/* Number of bytes of code covered by each bucket of the gmon histogram. */
+#define HIST_GRANULE    4
+
+/* gmon.out record tags and version, see gprof's gmon_out.h */
+#define GMON_TAG_TIME_HIST  0
+#define GMON_TAG_CG_ARC     1
+#define GMON_VERSION        1
+
+static prof_sample_t *samples;
+static size_t sample_max;
+static unsigned int sample_rate;
+
+/* Total number of samples ever written since the last clear. The write
+   position in the ring is (sample_head % sample_max). */
+static volatile uint32_t sample_head;
+static bool running;
+
+static void profiler_isr(irq_t src, irq_context_t *cxt, void *data) {
+    prof_sample_t *s;
+
+    (void)src;
+    (void)data;
+
+    s = &samples[sample_head % sample_max];
+    s->pc = cxt->pc;
+    s->pr = cxt->pr;
+    s->tid = thd_current ? thd_current->tid : 0;
+    sample_head++;
+
+    timer_clear(TMU1);
+}
+
+int profiler_init(size_t count, unsigned int rate) {
+    if(samples) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if(!rate)
+        rate = PROFILER_RATE_DEFAULT;
+
+    if(!count || rate > PROFILER_RATE_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    samples = malloc(count * sizeof(prof_sample_t));
+    if(!samples) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    sample_max = count;
+    sample_rate = rate;
+    sample_head = 0;
+
+    return 0;
+}
+
+void profiler_shutdown(void) {
+    profiler_stop();
+
+    free(samples);
+    samples = NULL;
+    sample_max = 0;
+}
+
+int profiler_start(void) {
+    if(!samples)
+        return -1;
+
+    if(running)
+        return 0;
+
+    irq_set_handler(EXC_TMU1_TUNI1, profiler_isr, NULL);
+    timer_prime(TMU1, sample_rate, 1);
+    timer_clear(TMU1);
+    timer_start(TMU1);
+    running = true;
+
+    return 0;
+}
+
+void profiler_stop(void) {
+    if(!running)
+        return;
+
+    timer_stop(TMU1);
+    timer_clear(TMU1);
+    irq_set_handler(EXC_TMU1_TUNI1, NULL, NULL);
+    running = false;
+}
+
+void profiler_clear(void) {
+    irq_disable_scoped();
+    sample_head = 0;
+}
+
+size_t profiler_sample_count(void) {
+    uint32_t head = sample_head;
+
+    return head < sample_max ? head : sample_max;
+}
+
+uint32_t profiler_overruns(void) {
+    uint32_t head = sample_head;
+
+    return head > sample_max ? head - sample_max : 0;
+}
+
+size_t profiler_get_samples(prof_sample_t *out, size_t count) {
+    size_t avail, first, i;
+
+    irq_disable_scoped();
+
+    avail = profiler_sample_count();
+    if(count > avail)
+        count = avail;
+
+    /* Only keep the most recent samples if there is not enough room */
+    first = sample_head - count;
+
+    for(i = 0; i < count; i++)
+        out[i] = samples[(first + i) % sample_max];
+
+    return count;
+}
+
+/* Take a copy of the ring, so that sorting and writing it out does not race
+   with the interrupt handler. */
+static prof_sample_t *profiler_snapshot(size_t *count) {
+    prof_sample_t *copy;
+    size_t avail = profiler_sample_count();
+
+    copy = malloc((avail ? avail : 1) * sizeof(prof_sample_t));
+    if(!copy) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    *count = profiler_get_samples(copy, avail);
+
+    return copy;
+}
+
+static int sample_cmp_pc(const void *a, const void *b) {
+    const prof_sample_t *sa = a, *sb = b;
+
+    if(sa->pc != sb->pc)
+        return sa->pc < sb->pc ? -1 : 1;
+
+    return 0;
+}
+
+static int sample_cmp_arc(const void *a, const void *b) {
+    const prof_sample_t *sa = a, *sb = b;
+
+    if(sa->pr != sb->pr)
+        return sa->pr < sb->pr ? -1 : 1;
+
+    return sample_cmp_pc(a, b);
+}
+
+static int sample_cmp_stack(const void *a, const void *b) {
+    const prof_sample_t *sa = a, *sb = b;
+
+    if(sa->tid != sb->tid)
+        return sa->tid < sb->tid ? -1 : 1;
+
+    return sample_cmp_arc(a, b);
+}
+
+static int gmon_put32(FILE *f, uint32_t val) {
+    uint8_t buf[4] = { val, val >> 8, val >> 16, val >> 24 };
+
+    return fwrite(buf, sizeof(buf), 1, f) == 1 ? 0 : -1;
+}
+
+static int gmon_write_hist(FILE *f, const prof_sample_t *s, size_t cnt) {
+    uint32_t low = (uintptr_t)&_executable_start;
+    uint32_t high = (uintptr_t)&_etext;
+    uint32_t bins = (high - low + HIST_GRANULE - 1) / HIST_GRANULE;
+    uint16_t buf[256];
+    uint32_t bin;
+    size_t i = 0, j;
+    char dimen[16] = "seconds";
+
+    /* Skip samples that landed below the text section */
+    while(i < cnt && s[i].pc < low)
+        i++;
+
+    if(fputc(GMON_TAG_TIME_HIST, f) == EOF ||
+       gmon_put32(f, low) || gmon_put32(f, high) ||
+       gmon_put32(f, bins) || gmon_put32(f, sample_rate))
+        return -1;
+
+    /* 15 bytes of dimension name, followed by its one-letter abbreviation */
+    dimen[15] = 's';
+    if(fwrite(dimen, sizeof(dimen), 1, f) != 1)
+        return -1;
+
+    /* Samples are sorted by PC, so the histogram can be streamed out a chunk
+       at a time instead of being built in memory. */
+    for(bin = 0; bin < bins; bin += j) {
+        for(j = 0; j < 256 && bin + j < bins; j++) {
+            uint32_t end = low + (bin + j + 1) * HIST_GRANULE;
+            uint32_t hits = 0;
+
+            for(; i < cnt && s[i].pc < end; i++)
+                hits++;
+
+            buf[j] = hits > 0xffff ? 0xffff : hits;
+        }
+
+        if(fwrite(buf, sizeof(uint16_t), j, f) != j)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int gmon_write_arcs(FILE *f, const prof_sample_t *s, size_t cnt) {
+    size_t i, j;
+
+    for(i = 0; i < cnt; i = j) {
+        for(j = i + 1; j < cnt && !sample_cmp_arc(&s[i], &s[j]); j++)
+            ;
+
+        if(!arch_valid_text_address(s[i].pr) ||
+           !arch_valid_text_address(s[i].pc))
+            continue;
+
+        if(fputc(GMON_TAG_CG_ARC, f) == EOF ||
+           gmon_put32(f, s[i].pr) || gmon_put32(f, s[i].pc) ||
+           gmon_put32(f, j - i))
+            return -1;
+    }
+
+    return 0;
+}
+
+int profiler_write_gmon(const char *fn) {
+    static const char cookie[4] = { 'g', 'm', 'o', 'n' };
+    prof_sample_t *s;
+    size_t cnt;
+    FILE *f;
+    int rv = -1;
+
+    if(!(s = profiler_snapshot(&cnt)))
+        return -1;
+
+    if(!(f = fopen(fn, "wb"))) {
+        free(s);
+        return -1;
+    }
+
+    if(fwrite(cookie, sizeof(cookie), 1, f) != 1 ||
+       gmon_put32(f, GMON_VERSION) ||
+       gmon_put32(f, 0) || gmon_put32(f, 0) || gmon_put32(f, 0))
+        goto out;
+
+    qsort(s, cnt, sizeof(*s), sample_cmp_pc);
+    if(gmon_write_hist(f, s, cnt))
+        goto out;
+
+    qsort(s, cnt, sizeof(*s), sample_cmp_arc);
+    if(gmon_write_arcs(f, s, cnt))
+        goto out;
+
+    rv = 0;
+out:
+    if(fclose(f))
+        rv = -1;
+
+    free(s);
+    return rv;
+}
+
+int profiler_write_folded(const char *fn) {
+    prof_sample_t *s;
+    size_t cnt, i, j;
+    FILE *f;
+    int rv = 0;
+
+    if(!(s = profiler_snapshot(&cnt)))
+        return -1;
+
+    if(!(f = fopen(fn, "w"))) {
+        free(s);
+        return -1;
+    }
+
+    qsort(s, cnt, sizeof(*s), sample_cmp_stack);
+
+    for(i = 0; i < cnt && !rv; i = j) {
+        for(j = i + 1; j < cnt && !sample_cmp_stack(&s[i], &s[j]); j++)
+            ;
+
+        if(fprintf(f, "thread %d;0x%08lx;0x%08lx %u\n", s[i].tid,
+                   (unsigned long)s[i].pr, (unsigned long)s[i].pc,
+                   (unsigned int)(j - i)) < 0)
+            rv = -1;
+    }
+
+    if(fclose(f))
+        rv = -1;
+
+    free(s);
+    return rv;
+}
@@ -156,6 +156,15 @@ int timer_clear(int which) {
 /* Spin-loop kernel sleep func: uses the secondary timer in the
    SH-4 to very accurately delay even when interrupts are disabled */
 void timer_spin_sleep(int ms) {
+    /* If TMU1 is generating interrupts, someone else (e.g. the sampling
+       profiler) owns it; busy-wait on the uptime timer instead. */
+    if(timer_ints_enabled(TMU1)) {
+        while(ms-- > 0)
+            timer_spin_delay_us(1000);
+
+        return;
+    }
+
     timer_prime(TMU1, 1000, 0);
     timer_clear(TMU1);
     timer_start(TMU1);
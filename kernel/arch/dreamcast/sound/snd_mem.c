@@ -3,6 +3,7 @@
    snd_mem.c
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2023 Ruslan Rostovtsev
+   Copyright (C) 2026 KallistiOS Contributors
 
  */
 
@@ -11,66 +12,39 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <sys/queue.h>
 #include <dc/sound/sound.h>
 #include <arch/spinlock.h>
 #include <kos/dbglog.h>
+#include <kos/tlsf.h>
 
 /*
 
-This is a very simple allocator for SPU RAM. I decided not to go with dlmalloc
-because of the massive number of changes it would require in the thing to
-make it use the g2_* bus calls. This is just a lot more sane.
+This is the allocator for SPU RAM. SPU RAM can only be reached through the
+G2 bus, which is slow and has its own access rules, so the allocator must not
+store anything in it. It used to be a best-fit search over a list of blocks,
+based on the assumption that sound RAM would only hold a couple of very large
+chunks. Games that stream dozens of short effects and voice clips break that
+assumption: the list grows, and allocations get slower and fail more often.
 
-This still uses the same basic algorithm, though, it just doesn't bother
-trying to be super efficient. This is based on the assumption that the
-most common usage will be allocating or freeing a couple of very large
-chunks every once in a while, not a ton of tiny chunks constantly (like
-dlmalloc is optimized for).
-
-The malloc algorithm used here is a basic "best fit" algorithm. We store a
-linked list of available chunks of sound RAM in regular RAM and traverse it
-to find the chunk that is the smallest while still large enough to fit the
-block size we want. If there is any space left over, this chunk is broken
-into two chunks, the first one occupied and the second one unoccupied.
-
-The free algorithm is very lazy: it attempts to coalesce with neighbor
-blocks if any of them are free. Otherwise it simply tags the block as free
-in the hopes that a later free will coalesce with it.
-
-This system is a bit more simplistic than the standard "buckets" system, but
-I figure we don't need that sort of complexity in this code.
+It is now a thin wrapper around the TLSF allocator (see kernel/mm/tlsf.c),
+which keeps its metadata in main RAM, merges free blocks immediately and
+allocates and frees in constant time.
 
 */
 
 #define SNDMEMDEBUG 0
 
-/* A single block of SPU RAM */
-typedef struct snd_block_str {
-    /* Our queue entry */
-    TAILQ_ENTRY(snd_block_str)  qent;
-
-    /* The address of this block (offset from SPU RAM base) */
-    uint32  addr;
-
-    /* The size of this block */
-    size_t  size;
-
-    /* Is this block in use? */
-    int inuse;
-} snd_block_t;
+/* Size of SPU RAM */
+#define SND_MEM_SIZE    (2 * 1024 * 1024)
 
 /* Our SPU RAM pool */
-static int initted = 0;
-static TAILQ_HEAD(snd_block_q, snd_block_str) pool = {0};
+static tlsf_pool_t *pool;
 static spinlock_t snd_mem_mutex = SPINLOCK_INITIALIZER;
 
 
 /* Reinitialize the pool with the given RAM base offset */
 int snd_mem_init(uint32 reserve) {
-    snd_block_t *blk;
-
-    if(initted)
+    if(pool)
         snd_mem_shutdown();
 
     if(!spinlock_lock_irqsafe(&snd_mem_mutex)) {
@@ -78,30 +52,25 @@ int snd_mem_init(uint32 reserve) {
         return -1;
     }
 
-    // Make sure our base is 32-byte aligned
+    // Make sure our base is 32-byte aligned. Offset 0 can't be handed out,
+    // as snd_mem_malloc() returns it on failure, so skip to the next block.
     reserve = (reserve + 0x1f) & ~0x1f;
 
-    /* Make sure our tailq is initted */
-    TAILQ_INIT(&pool);
+    if(!reserve)
+        reserve = 0x20;
 
-    blk = (snd_block_t *)malloc(sizeof(snd_block_t));
+    pool = tlsf_create(reserve, SND_MEM_SIZE - reserve, 32);
 
-    if(!blk) {
+    if(!pool) {
         spinlock_unlock(&snd_mem_mutex);
-        errno = ENOMEM;
         return -1;
     }
 
-    memset(blk, 0, sizeof(snd_block_t));
-    blk->addr = reserve;
-    blk->size = 2 * 1024 * 1024 - reserve;
-    blk->inuse = 0;
-    TAILQ_INSERT_HEAD(&pool, blk, qent);
-
-    if(__is_defined(SNDMEMDEBUG))
-        dbglog(DBG_DEBUG, "snd_mem_init: %d bytes available\n", blk->size);
+    if(__is_defined(SNDMEMDEBUG)) {
+        dbglog(DBG_DEBUG, "snd_mem_init: %lu bytes available\n",
+               SND_MEM_SIZE - reserve);
+    }
 
-    initted = 1;
     spinlock_unlock(&snd_mem_mutex);
 
     return 0;
@@ -109,37 +78,30 @@ int snd_mem_init(uint32 reserve) {
 
 /* Shut down the SPU allocator */
 void snd_mem_shutdown(void) {
-    snd_block_t *e, *n;
+    tlsf_stats_t st;
 
-    if(!initted) return;
+    if(!pool) return;
 
     if(!spinlock_lock_irqsafe(&snd_mem_mutex))
         return;
 
-    e = TAILQ_FIRST(&pool);
-
-    while(e) {
-        n = TAILQ_NEXT(e, qent);
-
-        if(__is_defined(SNDMEMDEBUG)) {
-            dbglog(DBG_DEBUG, "snd_mem_shutdown: %s block at %08lx (size %d)\n",
-                   e->inuse ? "in-use" : "unused", e->addr, e->size);
-        }
-
-        free(e);
-        e = n;
+    if(__is_defined(SNDMEMDEBUG)) {
+        tlsf_get_stats(pool, &st);
+        dbglog(DBG_DEBUG, "snd_mem_shutdown: %zu blocks still in use "
+               "(%zu bytes)\n", st.used_blocks, st.used);
     }
 
-    initted = 0;
+    tlsf_destroy(pool);
+    pool = NULL;
+
     spinlock_unlock(&snd_mem_mutex);
 }
 
 /* Allocate a chunk of SPU RAM; we will return an offset into SPU RAM. */
 uint32 snd_mem_malloc(size_t size) {
-    snd_block_t *e, *best = NULL;
-    size_t best_size = 4 * 1024 * 1024;
+    uint32 addr;
 
-    assert_msg(initted, "Use of snd_mem_malloc before snd_mem_init");
+    assert_msg(pool, "Use of snd_mem_malloc before snd_mem_init");
 
     if(size == 0)
         return 0;
@@ -149,68 +111,29 @@ uint32 snd_mem_malloc(size_t size) {
         return 0;
     }
 
-    // Make sure the size is a multiple of 32 bytes to maintain alignment
-    size = (size + 0x1f) & ~0x1f;
+    addr = tlsf_alloc(pool, size, 0);
 
-    /* Look for a block */
-    TAILQ_FOREACH(e, &pool, qent) {
-        if(e->size >= size && e->size < best_size && !e->inuse) {
-            best_size = e->size;
-            best = e;
-        }
-    }
+    spinlock_unlock(&snd_mem_mutex);
 
-    if(best == NULL) {
+    if(!addr) {
         dbglog(DBG_ERROR, "snd_mem_malloc: no chunks big enough for alloc(%d)\n", size);
-        spinlock_unlock(&snd_mem_mutex);
-        return 0;
-    }
-
-    /* Is the block the exact size? */
-    if(best->size == size) {
-        if(__is_defined(SNDMEMDEBUG)) {
-            dbglog(DBG_DEBUG, "snd_mem_malloc: allocating perfect-fit at %08lx for size %d\n",
-                   best->addr, best->size);
-        }
-
-        best->inuse = 1;
-        spinlock_unlock(&snd_mem_mutex);
-        return best->addr;
-    }
-
-    /* Nope: break it up into two chunks */
-    e = (snd_block_t*)malloc(sizeof(snd_block_t));
-
-    if(e == NULL) {
-        dbglog(DBG_ERROR, "snd_mem_malloc: not enough main memory to alloc(%d)\n", size);
-        spinlock_unlock(&snd_mem_mutex);
         return 0;
     }
 
-    memset(e, 0, sizeof(snd_block_t));
-    e->addr = best->addr + size;
-    e->size = best->size - size;
-    e->inuse = 0;
-    TAILQ_INSERT_AFTER(&pool, best, e, qent);
-
     if(__is_defined(SNDMEMDEBUG)) {
-        dbglog(DBG_DEBUG, "snd_mem_malloc: allocating block %08lx for size %d, and leaving %d at %08lx\n",
-               best->addr, size, e->size, e->addr);
+        dbglog(DBG_DEBUG, "snd_mem_malloc: allocating block %08lx for size %d\n",
+               addr, size);
     }
 
-    best->size = size;
-    best->inuse = 1;
-
-    spinlock_unlock(&snd_mem_mutex);
-    return best->addr;
+    return addr;
 }
 
 /* Free a chunk of SPU RAM; pointer is expected to be an offset into
    SPU RAM. */
 void snd_mem_free(uint32 addr) {
-    snd_block_t *e, *o;
+    int rv;
 
-    assert_msg(initted, "Use of snd_mem_free before snd_mem_init");
+    assert_msg(pool, "Use of snd_mem_free before snd_mem_init");
 
     if(addr == 0)
         return;
@@ -218,68 +141,55 @@ void snd_mem_free(uint32 addr) {
     if(!spinlock_lock_irqsafe(&snd_mem_mutex))
         return;
 
-    /* Look for the block */
-    TAILQ_FOREACH(e, &pool, qent) {
-        if(e->addr == addr)
-            break;
-    }
-
-    if(!e) {
-        dbglog(DBG_ERROR, "snd_mem_free: attempt to free non-existent block at %08lx\n", (uint32)e);
-        spinlock_unlock(&snd_mem_mutex);
-        return;
-    }
-
-    /* Set this block as unused */
-    e->inuse = 0;
-
-    if(__is_defined(SNDMEMDEBUG))
-        dbglog(DBG_DEBUG, "snd_mem_free: freeing block at %08lx\n", e->addr);
+    rv = tlsf_free(pool, addr);
 
-    /* Can we coalesce with the block before us? */
-    o = TAILQ_PREV(e, snd_block_q, qent);
+    spinlock_unlock(&snd_mem_mutex);
 
-    if(o && !o->inuse) {
-        if(__is_defined(SNDMEMDEBUG))
-            dbglog(DBG_DEBUG, "   coalescing with block at %08lx\n", o->addr);
+    if(rv)
+        dbglog(DBG_ERROR, "snd_mem_free: attempt to free non-existent block at %08lx\n", addr);
+    else if(__is_defined(SNDMEMDEBUG))
+        dbglog(DBG_DEBUG, "snd_mem_free: freeing block at %08lx\n", addr);
+}
 
-        o->size += e->size;
-        TAILQ_REMOVE(&pool, e, qent);
-        free(e);
-        e = o;
+int snd_mem_get_stats(tlsf_stats_t *stats) {
+    if(!pool) {
+        errno = EINVAL;
+        return -1;
     }
 
-    /* Can we coalesce with the block in front of us? */
-    o = TAILQ_NEXT(e, qent);
+    if(!spinlock_lock_irqsafe(&snd_mem_mutex)) {
+        errno = EAGAIN;
+        return -1;
+    }
 
-    if(o && !o->inuse) {
-        if(__is_defined(SNDMEMDEBUG))
-            dbglog(DBG_DEBUG, "   coalescing with block at %08lx\n", o->addr);
+    tlsf_get_stats(pool, stats);
 
-        e->size += o->size;
-        TAILQ_REMOVE(&pool, o, qent);
-        free(o);
-    }
     spinlock_unlock(&snd_mem_mutex);
+    return 0;
 }
 
 uint32 snd_mem_available(void) {
-    snd_block_t *e;
-    size_t largest = 0;
+    tlsf_stats_t st;
 
-    if(!initted)
+    if(snd_mem_get_stats(&st))
         return 0;
 
-    if(!spinlock_lock_irqsafe(&snd_mem_mutex)) {
-        errno = EAGAIN;
-        return 0;
-    }
+    return (uint32)st.largest_free;
+}
 
-    TAILQ_FOREACH(e, &pool, qent) {
-        if(e->size > largest)
-            largest = e->size;
-    }
+void snd_mem_stats(void) {
+    tlsf_stats_t st;
 
-    spinlock_unlock(&snd_mem_mutex);
-    return (uint32)largest;
+    printf("snd_mem_stats():\n");
+
+    if(snd_mem_get_stats(&st))
+        return;
+
+    printf("total bytes     = %10lu\n", (unsigned long)st.total);
+    printf("in use bytes    = %10lu in %lu blocks\n",
+           (unsigned long)st.used, (unsigned long)st.used_blocks);
+    printf("free bytes      = %10lu in %lu blocks\n",
+           (unsigned long)st.free, (unsigned long)st.free_blocks);
+    printf("largest free    = %10lu\n", (unsigned long)st.largest_free);
+    printf("fragmentation   = %9u%%\n", st.fragmentation);
 }
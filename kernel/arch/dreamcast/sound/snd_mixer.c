@@ -0,0 +1,98 @@
+/* KallistiOS ##version##
+
+   snd_mixer.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Software mixer, sound stream output
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <kos/dbglog.h>
+#include <kos/mutex.h>
+#include <dc/sound/stream.h>
+#include <dc/sound/mixer.h>
+
+#include "snd_mixer_int.h"
+
+static void mixer_mutex_lock(void *data) {
+    mutex_lock((mutex_t *)data);
+}
+
+static void mixer_mutex_unlock(void *data) {
+    mutex_unlock((mutex_t *)data);
+}
+
+static void *mixer_stream_cb(snd_stream_hnd_t hnd, int smp_req,
+                             int *smp_recv) {
+    snd_mixer_t *mixer = snd_stream_get_userdata(hnd);
+    size_t frames = smp_req / (2 * sizeof(int16_t));
+
+    snd_mixer_render(mixer, mixer->stream_buf, frames);
+    *smp_recv = frames * 2 * sizeof(int16_t);
+
+    return mixer->stream_buf;
+}
+
+int snd_mixer_stream_start(snd_mixer_t *mixer, int bufsize) {
+    snd_stream_hnd_t hnd;
+    mutex_t *mutex;
+
+    if(mixer->stream != SND_STREAM_INVALID) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    /* The stream asks for at most half of its buffer at once, for both
+       channels, so a buffer of the same size as one channel is enough. The
+       stream can load it with the store queues if it is 32-byte aligned. */
+    mixer->stream_buf = aligned_alloc(32, bufsize);
+    mutex = malloc(sizeof(mutex_t));
+
+    if(!mixer->stream_buf || !mutex) {
+        free(mixer->stream_buf);
+        free(mutex);
+        mixer->stream_buf = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    hnd = snd_stream_alloc(mixer_stream_cb, bufsize);
+    if(hnd == SND_STREAM_INVALID) {
+        dbglog(DBG_ERROR, "snd_mixer_stream_start: can't allocate stream\n");
+        free(mixer->stream_buf);
+        free(mutex);
+        mixer->stream_buf = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    mutex_init(mutex, MUTEX_TYPE_NORMAL);
+    snd_mixer_set_lock(mixer, mixer_mutex_lock, mixer_mutex_unlock, mutex);
+
+    mixer->stream = hnd;
+    snd_stream_set_userdata(hnd, mixer);
+    snd_stream_start(hnd, mixer->rate, 1);
+
+    return hnd;
+}
+
+void snd_mixer_stream_stop(snd_mixer_t *mixer) {
+    mutex_t *mutex = mixer->lock_data;
+
+    if(mixer->stream == SND_STREAM_INVALID)
+        return;
+
+    /* Once the stream is destroyed, its callback can't run anymore. */
+    snd_stream_stop(mixer->stream);
+    snd_stream_destroy(mixer->stream);
+    mixer->stream = SND_STREAM_INVALID;
+
+    snd_mixer_set_lock(mixer, NULL, NULL, NULL);
+    mutex_destroy(mutex);
+    free(mutex);
+
+    free(mixer->stream_buf);
+    mixer->stream_buf = NULL;
+}
@@ -0,0 +1,501 @@
+/* KallistiOS ##version##
+
+   snd_mixer_core.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Software mixer, portable core
+
+   This file has no dependencies on the rest of KOS, so that it can be built
+   and tested on the host (see utils/sndmixtest). Everything specific to the
+   Dreamcast lives in snd_mixer.c.
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snd_mixer_int.h"
+
+/* Position of the current frame in the window of the last input frames. The
+   interpolated frame lies between this one and the next. */
+#define CENTER      (MIXER_TAPS / 2 - 1)
+
+/* Number of frames to fetch before the first one reaches the center of the
+   window. This is also the number of frames fetched past the end of a sample
+   before its last frame left the center, at which point the voice stops. */
+#define TAIL        (MIXER_TAPS - CENTER)
+
+/* Maximum step per output frame. Higher steps would need a low-pass filter
+   to be of any use anyway. */
+#define MAX_STEP    (16 << 16)
+
+#define FRAC_ONE    0x10000
+
+static inline int clamp(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/* Map a 0-255 volume to a Q8 gain, with 255 being unity. */
+static inline int vol_gain(int vol) {
+    vol = clamp(vol, 0, 255);
+
+    return vol + (vol >> 7);
+}
+
+static void voice_set_gains(mixer_voice_t *v, int vol, int pan) {
+    int g = vol_gain(vol);
+    int pl, pr;
+
+    /* Balance law: the center is at full volume on both sides, and panning
+       attenuates the opposite side only. */
+    pan = clamp(pan, 0, 255);
+    pl = pan <= 128 ? 256 : ((255 - pan) << 8) / 127;
+    pr = pan >= 128 ? 256 : (pan << 8) / 128;
+
+    v->gl = (g * pl) >> 8;
+    v->gr = (g * pr) >> 8;
+}
+
+static void voice_set_step(snd_mixer_t *m, mixer_voice_t *v, uint32_t pitch) {
+    uint64_t step = ((uint64_t)pitch * v->smp.rate) / m->rate;
+
+    v->pitch = pitch;
+    v->step = step > MAX_STEP ? MAX_STEP : (uint32_t)step;
+}
+
+/* Decode one Yamaha ADPCM nibble, the same way as wav2adpcm does. */
+static inline int adpcm_decode(mixer_voice_t *v, unsigned int nibble) {
+    static const int step_table[8] = {
+        230, 230, 230, 230, 307, 409, 512, 614
+    };
+    int delta = nibble & 7;
+    int diff = ((1 + (delta << 1)) * v->adpcm_step) >> 3;
+    int hist = v->adpcm_hist * 254 / 256;   /* High pass */
+
+    diff = clamp(diff, 0, 32767);
+
+    if(nibble & 8)
+        hist -= diff;
+    else
+        hist += diff;
+
+    v->adpcm_step = clamp((step_table[delta] * v->adpcm_step) >> 8,
+                          127, 24576);
+    v->adpcm_hist = clamp(hist, -32768, 32767);
+
+    return v->adpcm_hist;
+}
+
+/* Read the next input frame of a voice, handling loops and the end of the
+   sample. */
+static inline void voice_fetch(mixer_voice_t *v, int *l, int *r) {
+    const snd_mixer_sample_t *smp = &v->smp;
+    uint32_t pos = v->pos;
+
+    if(smp->loop_end && pos >= smp->loop_end) {
+        pos = smp->loop_start;
+
+        if(smp->format == SND_MIXER_ADPCM) {
+            v->adpcm_hist = v->loop_hist;
+            v->adpcm_step = v->loop_step;
+        }
+    }
+
+    if(pos >= smp->length) {
+        *l = *r = 0;
+        v->tail++;
+        return;
+    }
+
+    if(smp->format == SND_MIXER_ADPCM) {
+        const uint8_t *d = smp->data;
+
+        if(smp->loop_end && !v->loop_saved && pos == smp->loop_start) {
+            v->loop_hist = v->adpcm_hist;
+            v->loop_step = v->adpcm_step;
+            v->loop_saved = 1;
+        }
+
+        /* The first sample is in the low nibble */
+        *l = *r = adpcm_decode(v, d[pos >> 1] >> ((pos & 1) << 2));
+    }
+    else if(smp->format == SND_MIXER_PCM8) {
+        const int8_t *d = smp->data;
+
+        if(smp->channels == 2) {
+            *l = d[pos * 2] * 256;
+            *r = d[pos * 2 + 1] * 256;
+        }
+        else {
+            *l = *r = d[pos] * 256;
+        }
+    }
+    else {
+        const int16_t *d = smp->data;
+
+        if(smp->channels == 2) {
+            *l = d[pos * 2];
+            *r = d[pos * 2 + 1];
+        }
+        else {
+            *l = *r = d[pos];
+        }
+    }
+
+    v->pos = pos + 1;
+}
+
+static inline void voice_push(mixer_voice_t *v) {
+    unsigned int w;
+    int l, r;
+
+    voice_fetch(v, &l, &r);
+
+    w = v->wpos = (v->wpos + 1) & (MIXER_TAPS - 1);
+    v->ring[0][w] = v->ring[0][w + MIXER_TAPS] = l;
+    v->ring[1][w] = v->ring[1][w + MIXER_TAPS] = r;
+}
+
+static inline int interp_linear(const int16_t *win, uint32_t frac) {
+    int a = win[CENTER], b = win[CENTER + 1];
+
+    return a + (((b - a) * (int)(frac >> 2)) >> 14);
+}
+
+static inline int interp_poly(const int16_t *win, const int16_t *coefs) {
+    int acc = 1 << 13;
+    int i;
+
+    for(i = 0; i < MIXER_TAPS; i++)
+        acc += win[i] * coefs[i];
+
+    return acc >> 14;
+}
+
+/* Add the next frames of a voice to the accumulation buffer. */
+static void voice_mix(snd_mixer_t *m, mixer_voice_t *v, int32_t *mix,
+                      size_t frames) {
+    const int stereo = v->smp.channels == 2;
+    const int poly = m->interp == SND_MIXER_POLYPHASE;
+    const int gl = v->gl, gr = v->gr;
+    const int16_t *wl, *wr, *coefs = NULL;
+    int l, r;
+
+    while(frames--) {
+        while(v->frac >= FRAC_ONE) {
+            voice_push(v);
+            v->frac -= FRAC_ONE;
+        }
+
+        if(v->tail >= TAIL) {
+            v->active = 0;
+            return;
+        }
+
+        wl = &v->ring[0][v->wpos + 1];
+        wr = &v->ring[1][v->wpos + 1];
+
+        if(poly) {
+            coefs = m->coefs[(v->frac * MIXER_PHASES + 0x8000) >> 16];
+            l = interp_poly(wl, coefs);
+            r = stereo ? interp_poly(wr, coefs) : l;
+        }
+        else {
+            l = interp_linear(wl, v->frac);
+            r = stereo ? interp_linear(wr, v->frac) : l;
+        }
+
+        mix[0] += (l * gl) >> 8;
+        mix[1] += (r * gr) >> 8;
+        mix += 2;
+
+        v->frac += v->step;
+    }
+}
+
+/* Build the windowed sinc filter, one set of taps per phase. Each set is
+   normalized to a sum of exactly 1.0, so that DC goes through unchanged and
+   the first and last phases are identities. */
+static void build_coefs(snd_mixer_t *m) {
+    double h[MIXER_TAPS], sum, x;
+    int p, t, total, peak;
+
+    for(p = 0; p <= MIXER_PHASES; p++) {
+        sum = 0.0;
+
+        for(t = 0; t < MIXER_TAPS; t++) {
+            x = (t - CENTER) - (double)p / MIXER_PHASES;
+
+            if(fabs(x) < 1e-9) {
+                h[t] = 1.0;
+            }
+            else {
+                /* Blackman window over the span of the filter */
+                h[t] = sin(M_PI * x) / (M_PI * x) *
+                       (0.42 + 0.5 * cos(M_PI * x / (MIXER_TAPS / 2)) +
+                        0.08 * cos(2.0 * M_PI * x / (MIXER_TAPS / 2)));
+            }
+
+            sum += h[t];
+        }
+
+        total = 0;
+        peak = CENTER;
+
+        for(t = 0; t < MIXER_TAPS; t++) {
+            m->coefs[p][t] = (int16_t)floor(h[t] / sum * (1 << 14) + 0.5);
+            total += m->coefs[p][t];
+
+            if(h[t] > h[peak])
+                peak = t;
+        }
+
+        m->coefs[p][peak] += (1 << 14) - total;
+    }
+}
+
+static inline void mixer_lock(snd_mixer_t *m) {
+    if(m->lock)
+        m->lock(m->lock_data);
+}
+
+static inline void mixer_unlock(snd_mixer_t *m) {
+    if(m->unlock)
+        m->unlock(m->lock_data);
+}
+
+static mixer_voice_t *voice_get(snd_mixer_t *m, snd_mixer_voice_t voice) {
+    mixer_voice_t *v;
+
+    if(voice < 0 || (unsigned int)(voice & 0xffff) >= m->nvoices)
+        return NULL;
+
+    v = &m->voices[voice & 0xffff];
+
+    if(!v->active || v->gen != (voice >> 16))
+        return NULL;
+
+    return v;
+}
+
+snd_mixer_t *snd_mixer_create(unsigned int voices, unsigned int rate) {
+    snd_mixer_t *m;
+
+    if(!voices || voices > SND_MIXER_MAX_VOICES || !rate) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    m = calloc(1, sizeof(*m));
+    if(!m) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    m->voices = calloc(voices, sizeof(*m->voices));
+    if(!m->voices) {
+        free(m);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    m->nvoices = voices;
+    m->rate = rate;
+    m->interp = SND_MIXER_LINEAR;
+    m->master = vol_gain(255);
+    m->stream = -1;
+
+    build_coefs(m);
+
+    return m;
+}
+
+void snd_mixer_destroy(snd_mixer_t *mixer) {
+    if(!mixer)
+        return;
+
+    free(mixer->voices);
+    free(mixer);
+}
+
+void snd_mixer_set_lock(snd_mixer_t *mixer, void (*lock)(void *),
+                        void (*unlock)(void *), void *data) {
+    mixer->lock = lock;
+    mixer->unlock = unlock;
+    mixer->lock_data = data;
+}
+
+void snd_mixer_set_interp(snd_mixer_t *mixer, snd_mixer_interp_t interp) {
+    mixer_lock(mixer);
+    mixer->interp = interp;
+    mixer_unlock(mixer);
+}
+
+void snd_mixer_set_volume(snd_mixer_t *mixer, int vol) {
+    mixer_lock(mixer);
+    mixer->master = vol_gain(vol);
+    mixer_unlock(mixer);
+}
+
+void snd_mixer_render(snd_mixer_t *mixer, int16_t *out, size_t frames) {
+    int32_t *mix = mixer->mix;
+    unsigned int i;
+    size_t n, j;
+    int master, s;
+
+    mixer_lock(mixer);
+
+    master = mixer->master;
+
+    while(frames) {
+        n = frames < MIXER_CHUNK ? frames : MIXER_CHUNK;
+        memset(mix, 0, n * 2 * sizeof(*mix));
+
+        for(i = 0; i < mixer->nvoices; i++) {
+            if(mixer->voices[i].active)
+                voice_mix(mixer, &mixer->voices[i], mix, n);
+        }
+
+        for(j = 0; j < n * 2; j++) {
+            /* Clamp first, so that the master volume can't overflow */
+            s = clamp(mix[j], -(1 << 22), 1 << 22);
+            out[j] = (int16_t)clamp((s * master) >> 8, -32768, 32767);
+        }
+
+        out += n * 2;
+        frames -= n;
+    }
+
+    mixer_unlock(mixer);
+}
+
+snd_mixer_voice_t snd_mixer_play(snd_mixer_t *mixer,
+                                 const snd_mixer_sample_t *sample,
+                                 int vol, int pan, uint32_t pitch) {
+    mixer_voice_t *v = NULL;
+    snd_mixer_voice_t rv;
+    unsigned int i;
+
+    if(!sample->data || !sample->length || !sample->rate ||
+       sample->format > SND_MIXER_ADPCM ||
+       (sample->channels != 1 && sample->channels != 2) ||
+       (sample->format == SND_MIXER_ADPCM && sample->channels != 1) ||
+       (sample->loop_end && (sample->loop_end > sample->length ||
+                             sample->loop_start >= sample->loop_end)))
+        return SND_MIXER_INVALID;
+
+    mixer_lock(mixer);
+
+    for(i = 0; i < mixer->nvoices; i++) {
+        if(!mixer->voices[i].active) {
+            v = &mixer->voices[i];
+            break;
+        }
+    }
+
+    if(!v) {
+        mixer_unlock(mixer);
+        return SND_MIXER_INVALID;
+    }
+
+    v->gen = (v->gen + 1) & 0x7fff;
+    if(!v->gen)
+        v->gen = 1;
+
+    v->smp = *sample;
+    v->loop_saved = 0;
+    v->frac = 0;
+    v->pos = 0;
+    v->tail = 0;
+    v->adpcm_hist = 0;
+    v->adpcm_step = 127;
+    v->wpos = 0;
+    memset(v->ring, 0, sizeof(v->ring));
+
+    voice_set_gains(v, vol, pan);
+    voice_set_step(mixer, v, pitch);
+
+    /* Fill the window up to the first frame of the sample */
+    for(i = 0; i < TAIL; i++)
+        voice_push(v);
+
+    v->active = 1;
+    rv = (v->gen << 16) | (snd_mixer_voice_t)(v - mixer->voices);
+
+    mixer_unlock(mixer);
+
+    return rv;
+}
+
+void snd_mixer_stop(snd_mixer_t *mixer, snd_mixer_voice_t voice) {
+    mixer_voice_t *v;
+
+    mixer_lock(mixer);
+
+    v = voice_get(mixer, voice);
+    if(v)
+        v->active = 0;
+
+    mixer_unlock(mixer);
+}
+
+void snd_mixer_stop_all(snd_mixer_t *mixer) {
+    unsigned int i;
+
+    mixer_lock(mixer);
+
+    for(i = 0; i < mixer->nvoices; i++)
+        mixer->voices[i].active = 0;
+
+    mixer_unlock(mixer);
+}
+
+int snd_mixer_playing(snd_mixer_t *mixer, snd_mixer_voice_t voice) {
+    int rv;
+
+    mixer_lock(mixer);
+    rv = voice_get(mixer, voice) != NULL;
+    mixer_unlock(mixer);
+
+    return rv;
+}
+
+void snd_mixer_set_voice_volume(snd_mixer_t *mixer, snd_mixer_voice_t voice,
+                                int vol, int pan) {
+    mixer_voice_t *v;
+
+    mixer_lock(mixer);
+
+    v = voice_get(mixer, voice);
+    if(v)
+        voice_set_gains(v, vol, pan);
+
+    mixer_unlock(mixer);
+}
+
+void snd_mixer_set_voice_pitch(snd_mixer_t *mixer, snd_mixer_voice_t voice,
+                               uint32_t pitch) {
+    mixer_voice_t *v;
+
+    mixer_lock(mixer);
+
+    v = voice_get(mixer, voice);
+    if(v)
+        voice_set_step(mixer, v, pitch);
+
+    mixer_unlock(mixer);
+}
+
+unsigned int snd_mixer_voices_playing(snd_mixer_t *mixer) {
+    unsigned int i, rv = 0;
+
+    mixer_lock(mixer);
+
+    for(i = 0; i < mixer->nvoices; i++)
+        rv += mixer->voices[i].active;
+
+    mixer_unlock(mixer);
+
+    return rv;
+}
@@ -0,0 +1,85 @@
+/* KallistiOS ##version##
+
+   snd_mixer_int.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Internal definitions of the software mixer, shared between the portable
+   core and the sound stream glue.
+*/
+
+#ifndef __SND_MIXER_INT_H
+#define __SND_MIXER_INT_H
+
+#include <stdint.h>
+#include <dc/sound/mixer.h>
+
+/* Number of taps and phases of the polyphase filter */
+#define MIXER_TAPS      8
+#define MIXER_PHASES    256
+
+/* Number of frames mixed at once */
+#define MIXER_CHUNK     256
+
+typedef struct mixer_voice {
+    snd_mixer_sample_t smp;
+
+    /* Generation counter, bumped every time the voice is (re)started */
+    uint16_t gen;
+    uint8_t active;
+
+    /* Whether the ADPCM state at the loop start has been recorded */
+    uint8_t loop_saved;
+
+    /* Left and right gains, in Q8 */
+    int gl, gr;
+
+    /* Pitch, and step per output frame, in 16.16 fixed point */
+    uint32_t pitch;
+    uint32_t step;
+
+    /* Fractional position between window[MIXER_TAPS / 2 - 1] and the next
+       input frame, in 16.16 fixed point */
+    uint32_t frac;
+
+    /* Next input frame to fetch */
+    uint32_t pos;
+
+    /* Number of frames fetched past the end of a sample played once */
+    uint32_t tail;
+
+    /* ADPCM decoder state, and its copy at the loop start */
+    int adpcm_hist, adpcm_step;
+    int loop_hist, loop_step;
+
+    /* History of the last input frames, per channel. Each frame is stored
+       twice, so that the window of the last MIXER_TAPS frames is contiguous,
+       from &ring[ch][wpos + 1]. */
+    unsigned int wpos;
+    int16_t ring[2][MIXER_TAPS * 2];
+} mixer_voice_t;
+
+struct snd_mixer {
+    mixer_voice_t *voices;
+    unsigned int nvoices;
+    unsigned int rate;
+
+    snd_mixer_interp_t interp;
+    int master;
+
+    void (*lock)(void *);
+    void (*unlock)(void *);
+    void *lock_data;
+
+    /* Polyphase filter coefficients, in Q14. The position is rounded to the
+       nearest phase, hence the extra set for a whole frame. */
+    int16_t coefs[MIXER_PHASES + 1][MIXER_TAPS];
+
+    /* Accumulation buffer, interleaved stereo */
+    int32_t mix[MIXER_CHUNK * 2];
+
+    /* Output stream state, owned by snd_mixer.c */
+    int stream;
+    int16_t *stream_buf;
+};
+
+#endif /* __SND_MIXER_INT_H */
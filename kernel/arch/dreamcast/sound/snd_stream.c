@@ -6,6 +6,7 @@
    Copyright (C) 2020 Lawrence Sebald
    Copyright (C) 2023, 2024, 2025 Ruslan Rostovtsev
    Copyright (C) 2024 Stefanos Kornilios Mitsis Poiitidis
+   Copyright (C) 2026 KallistiOS Contributors
 
    SH-4 support routines for SPU streaming sound driver
 */
@@ -15,10 +16,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <sys/queue.h>
 
 #include <kos/dbglog.h>
+#include <kos/genwait.h>
 #include <kos/mutex.h>
+#include <kos/thread.h>
+#include <arch/irq.h>
 #include <arch/cache.h>
 #include <arch/timer.h>
 #include <dc/g2bus.h>
@@ -42,6 +47,12 @@ routine for more sound data and load it up. That's about it.
 This version is capable of playing back N streams at once, with the limit
 being available CPU time and channels.
 
+Optionally, a service thread can do the polling for all the streams. After
+each pass, it computes for every playing stream how long it will take for
+the play position to free up enough of the buffer for the next refill, and
+sleeps until the earliest of these deadlines, so that all the streams that
+are due are refilled in a single wakeup.
+
 */
 
 typedef struct filter {
@@ -94,6 +105,9 @@ typedef struct strchan {
     /* Have we been initialized yet? (and reserved a buffer, etc) */
     volatile int initted;
 
+    /* Has the stream been started? */
+    volatile int playing;
+
     /* User data. */
     void *user_data;
 
@@ -113,6 +127,22 @@ static mutex_t stream_mutex = MUTEX_INITIALIZER;
 static int max_channels = 0;
 static size_t max_buffer_size = 0;
 
+/* Service thread state. The service mutex is held while the service thread
+   polls a stream, and when a stream is stopped, so that a stream is never
+   stopped or destroyed in the middle of a poll. It is recursive, so that
+   stream callbacks can stop their own stream. When both are needed, it must
+   be locked before stream_mutex. */
+static kthread_t *service_thd = NULL;
+static volatile bool service_quit = false;
+static volatile bool service_kick = false;
+static mutex_t service_mutex = RECURSIVE_MUTEX_INITIALIZER;
+
+/* Longest time the service thread sleeps, in milliseconds */
+#define SERVICE_MAX_SLEEP   100
+
+/* Time after which a poll that failed is retried, in milliseconds */
+#define SERVICE_RETRY       5
+
 /* Check an incoming handle */
 #define CHECK_HND(x) do { \
         assert( (x) >= 0 && (x) < SND_STREAM_MAX ); \
@@ -120,6 +150,7 @@ static size_t max_buffer_size = 0;
     } while(0)
 
 static size_t snd_stream_fill(snd_stream_hnd_t hnd, uint32_t offset, size_t size);
+static void snd_stream_service_wake(void);
 
 static inline size_t samples_to_bytes(snd_stream_hnd_t hnd, size_t samples) {
     switch(streams[hnd].bitsize) {
@@ -440,6 +471,7 @@ void snd_stream_destroy(snd_stream_hnd_t hnd) {
         return;
     }
 
+    mutex_lock(&service_mutex);
     mutex_lock(&stream_mutex);
     snd_stream_stop(hnd);
     snd_sfx_chn_free(streams[hnd].ch[0]);
@@ -463,6 +495,7 @@ void snd_stream_destroy(snd_stream_hnd_t hnd) {
     memset(streams + hnd, 0, sizeof(streams[0]));
 
     mutex_unlock(&stream_mutex);
+    mutex_unlock(&service_mutex);
 }
 
 /* Shut everything down and free mem */
@@ -470,6 +503,8 @@ void snd_stream_shutdown(void) {
     /* Stop and destroy all active stream */
     int i;
 
+    snd_stream_service_stop();
+
     for(i = 0; i < SND_STREAM_MAX; i++) {
         if(streams[i].initted)
             snd_stream_destroy(i);
@@ -587,6 +622,10 @@ static void snd_stream_start_type(snd_stream_hnd_t hnd, uint32_t type, uint32_t
     /* Process the changes */
     if(!streams[hnd].queueing)
         snd_sh4_to_aica_start();
+
+    /* Let the service thread know about the new stream */
+    streams[hnd].playing = 1;
+    snd_stream_service_wake();
 }
 
 void snd_stream_start(snd_stream_hnd_t hnd, uint32_t freq, int st) {
@@ -618,6 +657,11 @@ void snd_stream_stop(snd_stream_hnd_t hnd) {
         return;
     }
 
+    /* Make sure the service thread is done with the stream */
+    mutex_lock(&service_mutex);
+    streams[hnd].playing = 0;
+    mutex_unlock(&service_mutex);
+
     if(streams[hnd].channels == 2) {
         snd_sh4_to_aica_stop();
     }
@@ -787,7 +831,7 @@ static size_t snd_stream_fill(snd_stream_hnd_t hnd, uint32_t offset, size_t size
 }
 
 /* Poll streamer to load more data if necessary */
-int snd_stream_poll(snd_stream_hnd_t hnd) {
+static int snd_stream_poll_int(snd_stream_hnd_t hnd) {
     uint32_t write_pos;
     uint16_t current_play_pos;
     int needed_samples = 0;
@@ -868,6 +912,151 @@ int snd_stream_poll(snd_stream_hnd_t hnd) {
     return 0;
 }
 
+int snd_stream_poll(snd_stream_hnd_t hnd) {
+    assert(hnd >= 0 && hnd < SND_STREAM_MAX);
+
+    /* Leave the stream to the service thread if it is running */
+    if(service_thd && thd_current != service_thd) {
+        if(!streams[hnd].initted ||
+           (!streams[hnd].get_data && !streams[hnd].req_data))
+            return -1;
+
+        return 0;
+    }
+
+    return snd_stream_poll_int(hnd);
+}
+
+/* Compute how long it will take, in milliseconds, for the play position of a
+   stream to free up enough of its buffer for snd_stream_poll() to refill it.
+   This mirrors the rounding done there. */
+static int snd_stream_deadline(snd_stream_hnd_t hnd) {
+    strchan_t *stream = &streams[hnd];
+    uint32_t play_pos, room, threshold, sector;
+
+    play_pos = g2_read_32(SPU_RAM_UNCACHED_BASE +
+                          AICA_CHANNEL(stream->ch[0]) +
+                          offsetof(aica_channel_t, pos)) & 0xffff;
+
+    /* The rest of the buffer, up to its end, can be filled right away */
+    if(stream->last_write_pos > play_pos)
+        return 0;
+
+    room = play_pos - stream->last_write_pos;
+
+    sector = bytes_to_samples(hnd, 2048 / stream->channels);
+    threshold = bytes_to_samples(hnd, stream->buffer_size / 2);
+    threshold = ((threshold + sector - 1) & ~(sector - 1)) + 1;
+    threshold += bytes_to_samples(hnd, 32);
+
+    if(room >= threshold)
+        return 0;
+
+    return (threshold - room) * 1000 / stream->frequency + 1;
+}
+
+static void snd_stream_service_wake(void) {
+    irq_disable_scoped();
+
+    if(service_thd) {
+        service_kick = true;
+        genwait_wake_one(&service_thd);
+    }
+}
+
+static void *snd_stream_service(void *param) {
+    int i, rv, ms, next;
+    uint32_t flags;
+
+    (void)param;
+
+    while(!service_quit) {
+        next = SERVICE_MAX_SLEEP;
+
+        for(i = 0; i < SND_STREAM_MAX; i++) {
+            mutex_lock(&service_mutex);
+
+            if(streams[i].initted && streams[i].playing) {
+                rv = snd_stream_poll_int(i);
+
+                /* The stream may have been stopped by its callback */
+                if(streams[i].playing) {
+                    ms = snd_stream_deadline(i);
+
+                    if(rv < 0 && ms < SERVICE_RETRY)
+                        ms = SERVICE_RETRY;
+
+                    if(ms < next)
+                        next = ms;
+                }
+            }
+
+            mutex_unlock(&service_mutex);
+        }
+
+        /* Some stream needs more data already */
+        if(!next) {
+            thd_pass();
+            continue;
+        }
+
+        flags = irq_disable();
+
+        if(!service_quit && !service_kick)
+            genwait_wait(&service_thd, "snd_stream_service", next, NULL);
+
+        service_kick = false;
+
+        irq_restore(flags);
+    }
+
+    return NULL;
+}
+
+int snd_stream_service_start(const kthread_attr_t *attr) {
+    kthread_attr_t real_attr = { false, 0, NULL, PRIO_DEFAULT - 1, NULL };
+
+    if(service_thd)
+        return 0;
+
+    if(attr)
+        real_attr = *attr;
+
+    /* The thread is joined when the service is stopped */
+    real_attr.create_detached = false;
+
+    if(!real_attr.label)
+        real_attr.label = "[snd_stream]";
+
+    service_quit = false;
+    service_kick = false;
+    service_thd = thd_create_ex(&real_attr, snd_stream_service, NULL);
+
+    if(!service_thd) {
+        dbglog(DBG_ERROR, "snd_stream_service_start: can't create thread\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void snd_stream_service_stop(void) {
+    kthread_t *thd = service_thd;
+
+    if(!thd)
+        return;
+
+    {
+        irq_disable_scoped();
+
+        service_quit = true;
+        genwait_wake_one(&service_thd);
+    }
+
+    thd_join(thd, NULL);
+    service_thd = NULL;
+}
+
 /* Set the volume on the streaming channels */
 void snd_stream_volume(snd_stream_hnd_t hnd, int vol) {
     AICA_CMDSTR_CHANNEL(tmp, cmd, chan);
@@ -0,0 +1,163 @@
+/* KallistiOS ##version##
+
+   util/qoi.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+*/
+
+/*  A streaming QOI encoder, following the specification at
+    https://qoiformat.org/qoi-specification.pdf. Every pixel is opaque, so
+    the image is written with 3 channels, and the alpha is never stored.
+
+    Pixels are converted from the framebuffer format as they're read, the
+    same way vid_screen_shot_data() does it, so that both give the same
+    colors. */
+
+#include <string.h>
+
+#include "qoi.h"
+
+#define QOI_OP_INDEX    0x00
+#define QOI_OP_DIFF     0x40
+#define QOI_OP_LUMA     0x80
+#define QOI_OP_RUN      0xc0
+#define QOI_OP_RGB      0xfe
+
+#define QOI_RUN_MAX     62
+
+/* The hash of an opaque pixel, which always has an alpha of 255. */
+#define QOI_HASH(px) \
+    ((((px) >> 16) * 3 + (((px) >> 8) & 0xff) * 5 + ((px) & 0xff) * 7 + \
+      255 * 11) & 63)
+
+size_t qoi_enc_start(qoi_enc_t *enc, uint8_t *out, uint32_t w, uint32_t h) {
+    memset(enc->index, 0, sizeof(enc->index));
+    enc->prev = 0;
+    enc->run = 0;
+
+    /* The first pixel can't be found in the index unless it's been put there,
+       but the zeroed index says black is there. Clear that. */
+    enc->index[QOI_HASH(0)] = 0xffffffff;
+
+    memcpy(out, "qoif", 4);
+    out[4] = w >> 24;
+    out[5] = w >> 16;
+    out[6] = w >> 8;
+    out[7] = w;
+    out[8] = h >> 24;
+    out[9] = h >> 16;
+    out[10] = h >> 8;
+    out[11] = h;
+    out[12] = 3;        /* RGB */
+    out[13] = 0;        /* sRGB with linear alpha */
+
+    return QOI_HEADER_SIZE;
+}
+
+static inline uint8_t *encode_px(qoi_enc_t *enc, uint8_t *out, uint32_t px) {
+    int h, dr, dg, db, dr_dg, db_dg;
+
+    if(px == enc->prev) {
+        if(++enc->run == QOI_RUN_MAX) {
+            *out++ = QOI_OP_RUN | (QOI_RUN_MAX - 1);
+            enc->run = 0;
+        }
+
+        return out;
+    }
+
+    if(enc->run) {
+        *out++ = QOI_OP_RUN | (enc->run - 1);
+        enc->run = 0;
+    }
+
+    h = QOI_HASH(px);
+
+    if(enc->index[h] == px) {
+        *out++ = QOI_OP_INDEX | h;
+    }
+    else {
+        enc->index[h] = px;
+
+        dr = (int8_t)((px >> 16) - (enc->prev >> 16));
+        dg = (int8_t)((px >> 8) - (enc->prev >> 8));
+        db = (int8_t)(px - enc->prev);
+        dr_dg = dr - dg;
+        db_dg = db - dg;
+
+        if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            *out++ = QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+        }
+        else if(dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                db_dg >= -8 && db_dg <= 7) {
+            *out++ = QOI_OP_LUMA | (dg + 32);
+            *out++ = (dr_dg + 8) << 4 | (db_dg + 8);
+        }
+        else {
+            *out++ = QOI_OP_RGB;
+            *out++ = px >> 16;
+            *out++ = px >> 8;
+            *out++ = px;
+        }
+    }
+
+    enc->prev = px;
+    return out;
+}
+
+ssize_t qoi_enc_row(qoi_enc_t *enc, uint8_t *out, const void *row, uint32_t w,
+                    vid_pixel_mode_t pm) {
+    const uint16_t *s16 = (const uint16_t *)row;
+    const uint8_t *s8 = (const uint8_t *)row;
+    const uint32_t *s32 = (const uint32_t *)row;
+    uint8_t *start = out;
+    uint32_t i, p;
+
+    switch(pm) {
+        case PM_RGB555:
+            for(i = 0; i < w; i++) {
+                p = s16[i];
+                out = encode_px(enc, out, ((p >> 10) & 0x1f) << 19 |
+                                ((p >> 5) & 0x1f) << 11 | (p & 0x1f) << 3);
+            }
+            break;
+
+        case PM_RGB565:
+            for(i = 0; i < w; i++) {
+                p = s16[i];
+                out = encode_px(enc, out, ((p >> 11) & 0x1f) << 19 |
+                                ((p >> 5) & 0x3f) << 10 | (p & 0x1f) << 3);
+            }
+            break;
+
+        case PM_RGB888P:
+            /* Stored as B, G, R */
+            for(i = 0; i < w; i++, s8 += 3)
+                out = encode_px(enc, out, s8[2] << 16 | s8[1] << 8 | s8[0]);
+            break;
+
+        case PM_RGB0888:
+            for(i = 0; i < w; i++)
+                out = encode_px(enc, out, s32[i] & 0xffffff);
+            break;
+
+        default:
+            return -1;
+    }
+
+    return out - start;
+}
+
+size_t qoi_enc_finish(qoi_enc_t *enc, uint8_t *out) {
+    static const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    size_t n = 0;
+
+    if(enc->run) {
+        out[n++] = QOI_OP_RUN | (enc->run - 1);
+        enc->run = 0;
+    }
+
+    memcpy(out + n, end, sizeof(end));
+
+    return n + sizeof(end);
+}
@@ -0,0 +1,52 @@
+/* KallistiOS ##version##
+
+   util/qoi.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+*/
+
+/*  This file declares a streaming encoder for the QOI image format
+    (https://qoiformat.org/), used by the frame capture in screenshot.c. It
+    takes framebuffer rows in any of the video pixel modes directly, and
+    doesn't depend on anything else in KOS, so it can be built on the host.
+
+    An image is written as qoi_enc_start(), then qoi_enc_row() for each row,
+    top to bottom, then qoi_enc_finish(), each appending to the output. */
+
+#ifndef __UTIL_QOI_H
+#define __UTIL_QOI_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <dc/video.h>
+
+/* Size of the header written by qoi_enc_start(). */
+#define QOI_HEADER_SIZE     14
+
+/* Most that qoi_enc_row() can write for a row w pixels wide. */
+#define QOI_ROW_MAX(w)      ((w) * 4 + 1)
+
+/* Most that qoi_enc_finish() can write. */
+#define QOI_FINISH_MAX      9
+
+typedef struct qoi_enc {
+    uint32_t index[64];     /* Pixels seen, by hash, as 0xRRGGBB */
+    uint32_t prev;
+    int run;
+} qoi_enc_t;
+
+/* Start an image of the given size, writing its header to out. Returns the
+   number of bytes written. */
+size_t qoi_enc_start(qoi_enc_t *enc, uint8_t *out, uint32_t w, uint32_t h);
+
+/* Encode a row of w pixels in the given pixel mode, writing what it can to
+   out. Returns the number of bytes written, which may well be 0, or -1 if the
+   pixel mode isn't supported. */
+ssize_t qoi_enc_row(qoi_enc_t *enc, uint8_t *out, const void *row, uint32_t w,
+                    vid_pixel_mode_t pm);
+
+/* Finish the image, writing the rest of it to out. Returns the number of
+   bytes written. */
+size_t qoi_enc_finish(qoi_enc_t *enc, uint8_t *out);
+
+#endif /* __UTIL_QOI_H */
@@ -5,19 +5,30 @@
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2008 Donald Haase
    Copyright (C) 2024 Andy Barajas
+   Copyright (C) 2026 KallistiOS Contributors
 
  */
 
+#include <errno.h>
+#include <malloc.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dc/video.h>
+#include <dc/vblank.h>
 #include <kos/dbglog.h>
 #include <kos/fs.h>
+#include <kos/genwait.h>
+#include <kos/limits.h>
+#include <kos/opts.h>
+#include <kos/thread.h>
+#include <arch/dmac.h>
 #include <arch/irq.h>
 
 #include <arch/timer.h>
 
+#include "qoi.h"
+
 /*
     Provides a very simple screen shot facility (dumps raw 24bpp RGB image 
     data from the currently viewed framebuffer).
@@ -169,3 +180,486 @@ int vid_screen_shot(const char *destfn) {
 
     return 0;
 }
+
+/*
+    Background frame capture. The framebuffer is copied into one of a few
+    preallocated buffers, by DMA if possible, and a low priority thread encodes
+    the copies as QOI images and writes them out, in the order they were
+    taken. Buffers go from free, to being copied into, to ready, to being
+    written out, and back to free; their state is protected by disabling
+    interrupts, as the copy finishes, and recording takes snapshots, in
+    interrupt context.
+*/
+
+#define SLOT_FREE       0
+#define SLOT_COPYING    1
+#define SLOT_READY      2
+#define SLOT_WRITING    3
+
+/* Rows encoded between writes to the file. */
+#define CAP_ROWS        16
+
+typedef struct cap_slot {
+    uint8_t *data;          /* 32-byte aligned, for the DMA */
+    size_t size;
+    int state;
+    uint32_t seq;           /* Order in which it was taken */
+    int w, h;
+    vid_pixel_mode_t pm;
+    char *fn;               /* For vid_capture() */
+    int frame;              /* For vid_capture_record(), or -1 */
+} cap_slot_t;
+
+static cap_slot_t *slots;
+static int slot_count;
+static uint32_t next_seq;
+
+static kthread_t *cap_thd;
+static volatile bool cap_quit;
+static size_t cap_dropped;
+
+static char *rec_fmt;
+static int rec_interval;
+static int rec_vbl;
+static int rec_frame;
+static int rec_handle = -1;
+
+static void cap_dma_done(void *data);
+
+/* Channel 3 is only ever used for memory to memory copies. */
+static const dma_config_t cap_dma_config = {
+    .channel = DMA_CHANNEL_3,
+    .request = DMA_REQUEST_AUTO_MEM_TO_MEM,
+    .unit_size = DMA_UNITSIZE_32BYTE,
+    .src_mode = DMA_ADDRMODE_INCREMENT,
+    .dst_mode = DMA_ADDRMODE_INCREMENT,
+    .transmit_mode = DMA_TRANSMITMODE_CYCLE_STEAL,
+    .callback = cap_dma_done,
+};
+
+static size_t cap_size(void) {
+    if(vid_mode->pm > PM_RGB0888)
+        return 0;
+
+    /* Rounded up to whole DMA transfer units */
+    return (vid_mode->width * vid_mode->height * vid_pmode_bpp[vid_mode->pm] +
+            31) & ~31;
+}
+
+static void cap_dma_done(void *data) {
+    cap_slot_t *slot = (cap_slot_t *)data;
+
+    slot->state = SLOT_READY;
+    genwait_wake_one(&slots);
+}
+
+/* Take a snapshot of the framebuffer into a free slot. Called with interrupts
+   disabled, and the slot already marked as being copied into. */
+static void cap_snapshot(cap_slot_t *slot) {
+    slot->seq = next_seq++;
+    slot->w = vid_mode->width;
+    slot->h = vid_mode->height;
+    slot->pm = vid_mode->pm;
+
+    if(!dma_is_running(DMA_CHANNEL_3) &&
+       !dma_transfer(&cap_dma_config, dma_map_dst(slot->data, slot->size),
+                     hw_to_dma_addr((uintptr_t)vram_l), slot->size, slot))
+        return;
+
+    /* Copy it by hand if the DMA couldn't be used, but not in an interrupt,
+       where it would take far too long. */
+    if(irq_inside_int()) {
+        slot->state = SLOT_FREE;
+        cap_dropped++;
+        return;
+    }
+
+    memcpy(slot->data, vram_l, slot->size);
+    cap_dma_done(slot);
+}
+
+static cap_slot_t *cap_get_slot(size_t size) {
+    int i;
+
+    for(i = 0; i < slot_count; i++) {
+        if(slots[i].state == SLOT_FREE && slots[i].size >= size) {
+            slots[i].state = SLOT_COPYING;
+            return &slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Make the buffers big enough for the current video mode, if none of them is
+   in use. */
+static int cap_resize(size_t size) {
+    uint8_t *data;
+    int i;
+
+    for(i = 0; i < slot_count; i++) {
+        if(slots[i].size >= size)
+            continue;
+
+        {
+            irq_disable_scoped();
+
+            if(slots[i].state != SLOT_FREE)
+                return 0;
+
+            slots[i].state = SLOT_COPYING;
+        }
+
+        if(!(data = memalign(32, size))) {
+            slots[i].state = SLOT_FREE;
+            errno = ENOMEM;
+            return -1;
+        }
+
+        free(slots[i].data);
+        slots[i].data = data;
+        slots[i].size = size;
+        slots[i].state = SLOT_FREE;
+    }
+
+    return 0;
+}
+
+static void cap_vblank(uint32 evt, void *data) {
+    cap_slot_t *slot;
+
+    (void)evt;
+    (void)data;
+
+    if(++rec_vbl < rec_interval)
+        return;
+
+    rec_vbl = 0;
+
+    if(!(slot = cap_get_slot(cap_size()))) {
+        cap_dropped++;
+        return;
+    }
+
+    slot->fn = NULL;
+    slot->frame = rec_frame++;
+    cap_snapshot(slot);
+
+    /* Don't leave gaps in the numbering */
+    if(slot->state == SLOT_FREE)
+        rec_frame--;
+}
+
+static int cap_write(cap_slot_t *slot, const char *fn) {
+    size_t rowsize = slot->w * vid_pmode_bpp[slot->pm];
+    size_t bufsize = QOI_HEADER_SIZE + QOI_ROW_MAX(slot->w) * CAP_ROWS +
+                     QOI_FINISH_MAX;
+    const uint8_t *row = slot->data;
+    uint8_t *buf;
+    qoi_enc_t enc;
+    size_t len;
+    file_t f;
+    int y;
+
+    if(!(buf = malloc(bufsize)))
+        return -1;
+
+    f = fs_open(fn, O_WRONLY | O_TRUNC | O_CREAT);
+    if(f < 0) {
+        dbglog(DBG_ERROR, "vid_capture: can't open output file '%s'\n", fn);
+        free(buf);
+        return -1;
+    }
+
+    len = qoi_enc_start(&enc, buf, slot->w, slot->h);
+
+    for(y = 0; y < slot->h; y++, row += rowsize) {
+        len += qoi_enc_row(&enc, buf + len, row, slot->w, slot->pm);
+
+        if(y == slot->h - 1)
+            len += qoi_enc_finish(&enc, buf + len);
+
+        /* Write it out once there mightn't be room for another row */
+        if(len > bufsize - QOI_ROW_MAX(slot->w) - QOI_FINISH_MAX ||
+           y == slot->h - 1) {
+            if(fs_write(f, buf, len) != (ssize_t)len) {
+                dbglog(DBG_ERROR, "vid_capture: can't write data to output "
+                       "file '%s'\n", fn);
+                fs_close(f);
+                free(buf);
+                return -1;
+            }
+
+            len = 0;
+        }
+    }
+
+    fs_close(f);
+    free(buf);
+    return 0;
+}
+
+static void *cap_thread(void *param) {
+    char fn[PATH_MAX];
+    cap_slot_t *slot;
+    int i;
+
+    (void)param;
+
+    for(;;) {
+        {
+            irq_disable_scoped();
+
+            for(;;) {
+                slot = NULL;
+
+                for(i = 0; i < slot_count; i++) {
+                    if(slots[i].state == SLOT_READY &&
+                       (!slot || (int32_t)(slots[i].seq - slot->seq) < 0))
+                        slot = &slots[i];
+                }
+
+                if(slot || cap_quit)
+                    break;
+
+                genwait_wait(&slots, "vid_capture", 0, NULL);
+            }
+
+            if(!slot)
+                break;
+
+            slot->state = SLOT_WRITING;
+        }
+
+        if(slot->fn)
+            strncpy(fn, slot->fn, sizeof(fn) - 1);
+        else
+            snprintf(fn, sizeof(fn), rec_fmt, slot->frame);
+
+        fn[sizeof(fn) - 1] = '\0';
+
+        i = cap_write(slot, fn);
+
+        free(slot->fn);
+        slot->fn = NULL;
+
+        {
+            irq_disable_scoped();
+
+            if(i)
+                cap_dropped++;
+
+            slot->state = SLOT_FREE;
+        }
+    }
+
+    return NULL;
+}
+
+int vid_capture_init(int buffers, const kthread_attr_t *attr) {
+    kthread_attr_t real_attr = { false, 0, NULL, PRIO_DEFAULT + 1, NULL };
+    size_t size = cap_size();
+    int i;
+
+    if(cap_thd)
+        return 0;
+
+    if(buffers <= 0)
+        buffers = VID_CAPTURE_BUFFERS;
+
+    if(!(slots = calloc(buffers, sizeof(cap_slot_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for(i = 0; i < buffers; i++) {
+        if(size && !(slots[i].data = memalign(32, size)))
+            goto fail;
+
+        slots[i].size = size;
+    }
+
+    slot_count = buffers;
+    cap_dropped = 0;
+
+    if(attr)
+        real_attr = *attr;
+
+    /* The thread is joined on shutdown */
+    real_attr.create_detached = false;
+
+    if(!real_attr.label)
+        real_attr.label = "[vid_capture]";
+
+    cap_quit = false;
+    cap_thd = thd_create_ex(&real_attr, cap_thread, NULL);
+
+    if(!cap_thd) {
+        dbglog(DBG_ERROR, "vid_capture_init: can't create thread\n");
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    for(i = 0; i < buffers; i++)
+        free(slots[i].data);
+
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+    errno = ENOMEM;
+    return -1;
+}
+
+void vid_capture_shutdown(void) {
+    int i;
+
+    if(!cap_thd)
+        return;
+
+    vid_capture_record_stop();
+    dma_wait_complete(DMA_CHANNEL_3);
+
+    /* The thread writes out everything that's ready before it quits */
+    {
+        irq_disable_scoped();
+
+        cap_quit = true;
+        genwait_wake_one(&slots);
+    }
+
+    thd_join(cap_thd, NULL);
+    cap_thd = NULL;
+
+    for(i = 0; i < slot_count; i++) {
+        free(slots[i].data);
+        free(slots[i].fn);
+    }
+
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+
+    free(rec_fmt);
+    rec_fmt = NULL;
+}
+
+int vid_capture(const char *destfn) {
+    size_t size = cap_size();
+    cap_slot_t *slot;
+    char *fn;
+
+    if(!size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(vid_capture_init(0, NULL) || cap_resize(size))
+        return -1;
+
+    if(!(fn = strdup(destfn))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    irq_disable_scoped();
+
+    if(!(slot = cap_get_slot(size))) {
+        free(fn);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    slot->fn = fn;
+    slot->frame = -1;
+    cap_snapshot(slot);
+
+    return 0;
+}
+
+int vid_capture_record(const char *fmt, int interval) {
+    size_t size = cap_size();
+    char *copy;
+
+    if(!size || interval < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(rec_handle >= 0) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if(vid_capture_init(0, NULL) || cap_resize(size))
+        return -1;
+
+    if(!(copy = strdup(fmt))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* Let the frames of an earlier recording be written out with the name
+       they were meant to have. */
+    vid_capture_flush();
+    free(rec_fmt);
+    rec_fmt = copy;
+
+    rec_interval = interval;
+    rec_vbl = 0;
+    rec_frame = 0;
+    rec_handle = vblank_handler_add(cap_vblank, NULL);
+
+    if(rec_handle < 0)
+        return -1;
+
+    return 0;
+}
+
+void vid_capture_record_stop(void) {
+    if(rec_handle < 0)
+        return;
+
+    vblank_handler_remove(rec_handle);
+    rec_handle = -1;
+}
+
+int vid_capture_flush(void) {
+    uint32_t seq;
+    bool busy;
+    int i;
+
+    if(irq_inside_int()) {
+        errno = EPERM;
+        return -1;
+    }
+
+    {
+        irq_disable_scoped();
+        seq = next_seq;
+    }
+
+    do {
+        busy = false;
+
+        {
+            irq_disable_scoped();
+
+            for(i = 0; i < slot_count; i++) {
+                if(slots[i].state != SLOT_FREE &&
+                   (int32_t)(slots[i].seq - seq) < 0)
+                    busy = true;
+            }
+        }
+
+        if(busy)
+            thd_sleep(1);
+    } while(busy);
+
+    return 0;
+}
+
+size_t vid_capture_dropped(void) {
+    return cap_dropped;
+}
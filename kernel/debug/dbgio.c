@@ -2,6 +2,7 @@
 
    kernel/debug/dbgio.c
    Copyright (C) 2004 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <string.h>
@@ -164,7 +165,15 @@ static spinlock_t lock = SPINLOCK_INITIALIZER;
 
 int dbgio_printf(const char *fmt, ...) {
     va_list args;
-    int i;
+    int i, queued;
+
+    /* Leave it to the drain thread, if dbgio_async_start() is in effect */
+    va_start(args, fmt);
+    queued = !__dbgio_async_vprintf(0, fmt, args, &i);
+    va_end(args);
+
+    if(queued)
+        return i;
 
     /* XXX This isn't correct. We could be inside an int with IRQs
       enabled, and we could be outside an int with IRQs disabled, which
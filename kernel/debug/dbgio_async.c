@@ -0,0 +1,366 @@
+/* KallistiOS ##version##
+
+   kernel/debug/dbgio_async.c
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/* This file implements asynchronous debug output for dbglog() and
+   dbgio_printf(). Messages are formatted into a power-of-two sized ring of
+   variable length records, and written out to the console by a low priority
+   thread.
+
+   Producers reserve space by advancing the head with a compare-and-swap, so
+   logging never takes a lock and is safe from interrupt context. A record
+   never wraps around the end of the ring; if it doesn't fit, a skip record
+   fills up the rest of the ring and the message goes at the start. Each record
+   begins with a header whose ready flag is set last, once the text is in
+   place. The drain thread writes out records in order up to the first one that
+   isn't ready yet, then zeroes them and advances the tail, so that stale text
+   can never look like a ready header. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arch/irq.h>
+#include <kos/dbgio.h>
+#include <kos/dbglog.h>
+#include <kos/fs.h>
+#include <kos/genwait.h>
+#include <kos/opts.h>
+#include <kos/thread.h>
+
+/* Longest message that's kept, as with the synchronous path. */
+#define MAX_LEN         1023
+
+/* Messages up to this long are formatted once, on the stack, and copied
+   into the ring. Longer ones are formatted again straight into the ring, as
+   interrupts run on the stack of whichever thread they interrupted. */
+#define SHORT_LEN       255
+
+/* Smallest ring, so that the longest message always fits. */
+#define MIN_SIZE        4096
+
+/* How long the drain thread sleeps when there's nothing to do, in ms. If a
+   wakeup from a producer is ever missed, this bounds the delay. */
+#define DRAIN_SLEEP     100
+
+#define REC_SKIP        0
+#define REC_DBGIO       1
+#define REC_STDOUT      2
+
+typedef struct rec_hdr {
+    uint16_t len;
+    uint8_t type;
+    uint8_t ready;
+} rec_hdr_t;
+
+/* Header, text and terminating NUL, rounded up to keep headers aligned. */
+#define REC_SIZE(len)   ((sizeof(rec_hdr_t) + (len) + 1 + 3) & ~3)
+
+static uint8_t *ring;
+static uint32_t ring_mask;
+
+/* Total bytes ever reserved and consumed. The positions in the ring are
+   (ring_head & ring_mask) and (ring_tail & ring_mask). */
+static uint32_t ring_head;
+static uint32_t ring_tail;
+
+static volatile bool active;
+static volatile bool panicking;
+static uint32_t writers;
+
+static size_t dropped;
+static size_t dropped_reported;
+
+static kthread_t *drain_thd;
+static volatile bool drain_quit;
+static volatile bool drain_sleeping;
+
+int __dbgio_async_vprintf(int to_stdout, const char *fmt, va_list args,
+                          int *rv) {
+    uint32_t head, tail, off, skip, need, size;
+    rec_hdr_t *hdr;
+    va_list copy;
+    char buf[SHORT_LEN + 1];
+    int len;
+
+    if(!active)
+        return -1;
+
+    /* Let dbgio_async_stop() know there's a message on the way, then make
+       sure it didn't already go by. */
+    __atomic_add_fetch(&writers, 1, __ATOMIC_SEQ_CST);
+
+    if(!active) {
+        __atomic_sub_fetch(&writers, 1, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    va_copy(copy, args);
+    len = vsnprintf(buf, sizeof(buf), fmt, copy);
+    va_end(copy);
+
+    *rv = len;
+
+    if(len <= 0)
+        goto out;
+
+    if(len > MAX_LEN)
+        len = MAX_LEN;
+
+    size = ring_mask + 1;
+    need = REC_SIZE(len);
+    head = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+
+    do {
+        off = head & ring_mask;
+        skip = (off + need > size) ? size - off : 0;
+        tail = __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+
+        if(head + skip + need - tail > size) {
+            __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+            goto out;
+        }
+    } while(!__atomic_compare_exchange_n(&ring_head, &head,
+                                         head + skip + need, true,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    if(skip) {
+        hdr = (rec_hdr_t *)(ring + off);
+        hdr->len = 0;
+        hdr->type = REC_SKIP;
+        __atomic_store_n(&hdr->ready, 1, __ATOMIC_RELEASE);
+        head += skip;
+    }
+
+    hdr = (rec_hdr_t *)(ring + (head & ring_mask));
+
+    if(len <= SHORT_LEN)
+        memcpy(hdr + 1, buf, len + 1);
+    else
+        vsnprintf((char *)(hdr + 1), len + 1, fmt, args);
+
+    hdr->len = len;
+    hdr->type = to_stdout ? REC_STDOUT : REC_DBGIO;
+    __atomic_store_n(&hdr->ready, 1, __ATOMIC_SEQ_CST);
+
+    if(drain_sleeping)
+        genwait_wake_one(&ring_head);
+
+out:
+    __atomic_sub_fetch(&writers, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void write_rec(int type, const char *text, size_t len) {
+    if(type == REC_STDOUT && !panicking) {
+        if(fs_write(STDOUT_FILENO, text, len) >= 0)
+            return;
+    }
+
+    dbgio_write_buffer_xlat((const uint8 *)text, len);
+}
+
+/* Write out the records that are ready. There's only ever one of these
+   running: the drain thread, or whoever stopped it or panicked. */
+static int drain(void) {
+    uint32_t head, tail, off, size;
+    rec_hdr_t *hdr;
+    size_t lost;
+    char msg[48];
+    int cnt = 0;
+
+    /* Anything dropped so far was logged after what's in the ring now, so
+       it's reported once that has been written out. */
+    lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    tail = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+    while(tail != head) {
+        off = tail & ring_mask;
+        hdr = (rec_hdr_t *)(ring + off);
+
+        if(!__atomic_load_n(&hdr->ready, __ATOMIC_ACQUIRE))
+            break;
+
+        if(hdr->type == REC_SKIP) {
+            size = ring_mask + 1 - off;
+        }
+        else {
+            size = REC_SIZE(hdr->len);
+            write_rec(hdr->type, (const char *)(hdr + 1), hdr->len);
+        }
+
+        memset(hdr, 0, size);
+        tail += size;
+        __atomic_store_n(&ring_tail, tail, __ATOMIC_RELEASE);
+        cnt++;
+    }
+
+    if(tail == head && lost != dropped_reported) {
+        snprintf(msg, sizeof(msg), "dbgio: %u messages dropped\n",
+                 (unsigned int)(lost - dropped_reported));
+        dropped_reported = lost;
+        write_rec(REC_STDOUT, msg, strlen(msg));
+    }
+
+    return cnt;
+}
+
+/* Whether drain() has anything to do. A record that isn't ready yet belongs
+   to a producer that was interrupted, and the drain thread mustn't spin on it,
+   as the producer may well have a lower priority. */
+static bool drain_pending(void) {
+    uint32_t tail = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    rec_hdr_t *hdr = (rec_hdr_t *)(ring + (tail & ring_mask));
+
+    if(__atomic_load_n(&hdr->ready, __ATOMIC_ACQUIRE))
+        return true;
+
+    return tail == __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) &&
+        __atomic_load_n(&dropped, __ATOMIC_RELAXED) != dropped_reported;
+}
+
+static void *drain_thread(void *param) {
+    (void)param;
+
+    while(!drain_quit) {
+        if(drain())
+            continue;
+
+        irq_disable_scoped();
+
+        drain_sleeping = true;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if(!drain_quit && !drain_pending())
+            genwait_wait(&ring_head, "dbgio_async", DRAIN_SLEEP, NULL);
+
+        drain_sleeping = false;
+    }
+
+    return NULL;
+}
+
+int dbgio_async_start(size_t size, const kthread_attr_t *attr) {
+    kthread_attr_t real_attr = { false, 0, NULL, PRIO_DEFAULT + 1, NULL };
+    size_t real_size = MIN_SIZE;
+
+    if(drain_thd)
+        return 0;
+
+    if(!size)
+        size = DBGIO_ASYNC_SIZE;
+
+    while(real_size < size)
+        real_size <<= 1;
+
+    ring = calloc(1, real_size);
+    if(!ring) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ring_mask = real_size - 1;
+    ring_head = ring_tail = 0;
+    dropped = dropped_reported = 0;
+
+    if(attr)
+        real_attr = *attr;
+
+    /* The thread is joined when asynchronous output is stopped */
+    real_attr.create_detached = false;
+
+    if(!real_attr.label)
+        real_attr.label = "[dbgio]";
+
+    drain_quit = false;
+    drain_thd = thd_create_ex(&real_attr, drain_thread, NULL);
+
+    if(!drain_thd) {
+        dbglog(DBG_ERROR, "dbgio_async_start: can't create thread\n");
+        free(ring);
+        ring = NULL;
+        return -1;
+    }
+
+    active = true;
+
+    return 0;
+}
+
+void dbgio_async_stop(void) {
+    kthread_t *thd = drain_thd;
+
+    if(!thd || panicking)
+        return;
+
+    /* Send new messages down the synchronous path, and let the ones that are
+       on their way into the ring get there. Sleep rather than pass, as a
+       writer with a lower priority would never get to run otherwise. */
+    active = false;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    while(__atomic_load_n(&writers, __ATOMIC_ACQUIRE))
+        thd_sleep(1);
+
+    {
+        irq_disable_scoped();
+
+        drain_quit = true;
+        genwait_wake_one(&ring_head);
+    }
+
+    thd_join(thd, NULL);
+    drain_thd = NULL;
+
+    drain();
+
+    free(ring);
+    ring = NULL;
+}
+
+int dbgio_async_flush(void) {
+    uint32_t head;
+
+    if(irq_inside_int()) {
+        errno = EPERM;
+        return -1;
+    }
+
+    if(!active)
+        return 0;
+
+    /* The drain thread can't wait on itself. */
+    if(thd_current == drain_thd) {
+        drain();
+        return 0;
+    }
+
+    head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+    while((int32_t)(__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) - head) < 0)
+        thd_sleep(1);
+
+    return 0;
+}
+
+size_t dbgio_async_dropped(void) {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+void __dbgio_async_panic(void) {
+    if(!ring || panicking)
+        return;
+
+    /* Nothing else gets to run from here on, and the rest goes straight to
+       the dbgio device, as the filesystem may be what's broken. */
+    active = false;
+    panicking = true;
+    irq_disable();
+
+    drain();
+}
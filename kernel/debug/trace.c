@@ -0,0 +1,319 @@
+/* KallistiOS ##version##
+
+   kernel/debug/trace.c
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/* This file implements the kernel event tracer. Events are recorded into a
+   power-of-two sized ring buffer. Each event is written with interrupts
+   disabled, so recording never takes a lock, is safe from interrupt context
+   and cannot race with trace_shutdown() freeing the ring. The ring is
+   converted into the Chrome trace event JSON format on export. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arch/irq.h>
+#include <arch/timer.h>
+#include <kos/thread.h>
+#include <kos/trace.h>
+
+/* Pseudo-thread ID used for the interrupt track of the exported trace. */
+#define TRACE_IRQ_TID   0
+
+volatile bool __trace_active;
+
+static trace_event_t *events;
+static uint32_t event_mask;
+
+/* Total number of events ever recorded since the last clear. The write
+   position in the ring is (event_head & event_mask). */
+static uint32_t event_head;
+
+void __trace_record(trace_type_t type, const char *name, uintptr_t arg) {
+    trace_event_t *evt;
+
+    irq_disable_scoped();
+
+    /* A thread preempted between the __trace_active check and here may find
+       that the ring has been freed in the meantime. */
+    if(!events)
+        return;
+
+    evt = &events[event_head++ & event_mask];
+
+    evt->ts = timer_ns_gettime64();
+    evt->name = name;
+    evt->arg = arg;
+    evt->tid = (irq_inside_int() || !thd_current) ?
+        TRACE_IRQ_TID : thd_current->tid;
+    evt->type = type;
+}
+
+int trace_init(size_t count) {
+    size_t size = 1;
+
+    if(events) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if(!count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while(size < count)
+        size <<= 1;
+
+    events = malloc(size * sizeof(trace_event_t));
+    if(!events) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    event_mask = size - 1;
+    event_head = 0;
+
+    return 0;
+}
+
+void trace_shutdown(void) {
+    trace_event_t *buf;
+
+    /* Detach the ring with interrupts disabled, so that no recorder can be
+       left holding a pointer into it once it is freed. */
+    {
+        irq_disable_scoped();
+        trace_stop();
+        buf = events;
+        events = NULL;
+    }
+
+    free(buf);
+}
+
+int trace_start(void) {
+    if(!events)
+        return -1;
+
+    __trace_active = true;
+    return 0;
+}
+
+void trace_stop(void) {
+    __trace_active = false;
+}
+
+void trace_clear(void) {
+    irq_disable_scoped();
+    event_head = 0;
+}
+
+static uint32_t trace_count(void) {
+    return event_head <= event_mask ? event_head : event_mask + 1;
+}
+
+uint32_t trace_overruns(void) {
+    return event_head - trace_count();
+}
+
+size_t trace_get_events(trace_event_t *out, size_t count) {
+    uint32_t avail, first;
+    size_t i;
+
+    irq_disable_scoped();
+
+    if(!events)
+        return 0;
+
+    avail = trace_count();
+    if(count > avail)
+        count = avail;
+
+    first = event_head - count;
+
+    for(i = 0; i < count; i++)
+        out[i] = events[(first + i) & event_mask];
+
+    return count;
+}
+
+static void json_string(FILE *f, const char *str) {
+    fputc('"', f);
+
+    for(; str && *str; str++) {
+        if(*str == '"' || *str == '\\')
+            fputc('\\', f);
+
+        if((unsigned char)*str < 0x20)
+            fprintf(f, "\\u%04x", *str);
+        else
+            fputc(*str, f);
+    }
+
+    fputc('"', f);
+}
+
+/* Start a new JSON event object with the fields common to all events. */
+static void json_event(FILE *f, bool *first, const char *name, char ph,
+                       uint64_t ts, tid_t tid) {
+    fprintf(f, "%s\n{\"name\":", *first ? "" : ",");
+    json_string(f, name);
+    fprintf(f, ",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u",
+            ph, KOS_PID, tid, (unsigned long long)(ts / 1000),
+            (unsigned int)(ts % 1000));
+    *first = false;
+}
+
+struct thread_names {
+    FILE *f;
+    bool *first;
+};
+
+static int json_thread_name(kthread_t *thd, void *data) {
+    struct thread_names *tn = data;
+
+    json_event(tn->f, tn->first, "thread_name", 'M', 0, thd->tid);
+    fprintf(tn->f, ",\"args\":{\"name\":");
+    json_string(tn->f, thd_get_label(thd));
+    fprintf(tn->f, "}}");
+
+    return 0;
+}
+
+static void trace_write_events(FILE *f, const trace_event_t *evts,
+                               size_t count) {
+    struct thread_names tn;
+    uint64_t run_start = 0;
+    tid_t running = -1;
+    bool first = true;
+    char irqname[16];
+    size_t i;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    json_event(f, &first, "thread_name", 'M', 0, TRACE_IRQ_TID);
+    fprintf(f, ",\"args\":{\"name\":\"interrupts\"}}");
+
+    tn.f = f;
+    tn.first = &first;
+    thd_each(json_thread_name, &tn);
+
+    for(i = 0; i < count; i++) {
+        const trace_event_t *evt = &evts[i];
+
+        switch(evt->type) {
+            case TRACE_SWITCH:
+                /* Turn consecutive switches into "running" slices */
+                if(running >= 0) {
+                    json_event(f, &first, "running", 'X', run_start, running);
+                    fprintf(f, ",\"dur\":%llu.%03u}",
+                            (unsigned long long)((evt->ts - run_start) / 1000),
+                            (unsigned int)((evt->ts - run_start) % 1000));
+                }
+
+                running = (tid_t)evt->arg;
+                run_start = evt->ts;
+                break;
+
+            case TRACE_IRQ_ENTER:
+            case TRACE_IRQ_EXIT:
+                snprintf(irqname, sizeof(irqname), "irq 0x%03x",
+                         (unsigned int)evt->arg);
+                json_event(f, &first, irqname,
+                           evt->type == TRACE_IRQ_ENTER ? 'B' : 'E',
+                           evt->ts, TRACE_IRQ_TID);
+                fprintf(f, "}");
+                break;
+
+            case TRACE_WAIT_BEGIN:
+            case TRACE_LOCK_BEGIN:
+                json_event(f, &first, evt->name ? evt->name : "wait", 'B',
+                           evt->ts, evt->tid);
+                fprintf(f, ",\"args\":{\"obj\":\"%p\"}}", (void *)evt->arg);
+                break;
+
+            case TRACE_WAIT_END:
+            case TRACE_LOCK_END:
+            case TRACE_SPAN_END:
+                json_event(f, &first, evt->name, 'E', evt->ts, evt->tid);
+                fprintf(f, "}");
+                break;
+
+            case TRACE_WAKE:
+                json_event(f, &first, "wake", 'i', evt->ts, evt->tid);
+                fprintf(f, ",\"s\":\"t\",\"args\":{\"thread\":%d,\"reason\":",
+                        (int)evt->arg);
+                json_string(f, evt->name);
+                fprintf(f, "}}");
+                break;
+
+            case TRACE_SPAN_BEGIN:
+                json_event(f, &first, evt->name, 'B', evt->ts, evt->tid);
+                fprintf(f, "}");
+                break;
+
+            case TRACE_INSTANT:
+                json_event(f, &first, evt->name, 'i', evt->ts, evt->tid);
+                fprintf(f, ",\"s\":\"t\"}");
+                break;
+
+            case TRACE_COUNTER:
+                json_event(f, &first, evt->name, 'C', evt->ts, evt->tid);
+                fprintf(f, ",\"args\":{\"value\":%lu}}",
+                        (unsigned long)evt->arg);
+                break;
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+}
+
+int trace_write_json(const char *fn) {
+    bool was_active = __trace_active;
+    trace_event_t *evts;
+    size_t count;
+    FILE *f;
+    int rv = 0;
+
+    if(!events) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    trace_stop();
+
+    count = trace_count();
+    evts = malloc((count ? count : 1) * sizeof(trace_event_t));
+    if(!evts) {
+        errno = ENOMEM;
+        rv = -1;
+        goto out;
+    }
+
+    count = trace_get_events(evts, count);
+
+    if(!(f = fopen(fn, "w"))) {
+        rv = -1;
+        goto out_free;
+    }
+
+    trace_write_events(f, evts, count);
+
+    if(ferror(f))
+        rv = -1;
+
+    if(fclose(f))
+        rv = -1;
+
+out_free:
+    free(evts);
+out:
+    if(was_active)
+        trace_start();
+
+    return rv;
+}
@@ -3,6 +3,7 @@
    fs_romdisk.c
    Copyright (C) 2001, 2002, 2003 Megan Potter
    Copyright (C) 2012, 2013, 2014, 2016 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -14,6 +15,11 @@ To create a romdisk image, you will need the program "genromfs". This program wa
 for Linux but ought to compile under Cygwin. The source for this utility can be found
 on sunsite.unc.edu in /pub/Linux/system/recovery/, or as a package under Debian "genromfs".
 
+The copy of genromfs in utils/ can also pack regular files (-z). A packed file
+is split into blocks which are compressed on their own, so reading from it only
+needs to unpack the blocks that are read. Recently used blocks are kept in a
+small cache shared by all mounts. Packed files can't be mmap()ed.
+
 */
 
 #include <arch/types.h>
@@ -73,6 +79,23 @@ static uint32 ntohl_32(const void *data) {
     return (d[0] << 24) | (d[1] << 16) | (d[2] << 8) | (d[3] << 0);
 }
 
+/* A packed regular file has this in its spec_info, and its data starts with
+   the header below. It is followed by the offset of each block from the
+   start of the data, and then by the offset of the end of the last block.
+   Each block is an LZ4 block, unless its packed size is the same as its
+   unpacked size, in which case it is stored as it is. */
+#define ROMFS_SPEC_PACKED 1
+
+typedef struct {
+    char    magic[4];               /* Should be "RDZ1" */
+    uint32  size;                   /* Unpacked size of the file */
+    uint32  shift;                  /* log2 of the block size */
+    uint32  blocks;                 /* Number of blocks */
+} romdisk_pack_t;
+
+#define RD_PACK_SHIFT_MIN 9
+#define RD_PACK_SHIFT_MAX 16
+
 /********************************************************************************/
 
 /* A list of the following */
@@ -104,6 +127,8 @@ static struct {
     bool        dir;        /* true if a directory */
     uint32      ptr;        /* Current read position in bytes */
     uint32      size;       /* Length of file in bytes */
+    bool        packed;     /* true if the file is packed */
+    uint8       shift;      /* log2 of its block size, if it is */
     dirent_t    dirent;     /* A static dirent to pass back to clients */
     rd_image_t  * mnt;      /* Which mount instance are we using? */
 } fh[FS_ROMDISK_MAX_FILES];
@@ -119,6 +144,279 @@ static struct {
 /* Mutex for file handles */
 static mutex_t fh_mutex;
 
+/* Unpacked blocks of packed files */
+typedef struct {
+    const rd_image_t * mnt; /* Image the block is from, NULL if unused */
+    uint32      index;      /* Offset of the file data in the image */
+    uint32      block;      /* Block number within the file */
+    uint32      len;        /* Unpacked length of the block */
+    uint32      used;       /* When the block was last used */
+    size_t      alloc;      /* Size of the buffer */
+    uint8       * data;     /* The unpacked block */
+} rd_block_t;
+
+static rd_block_t cache[FS_ROMDISK_CACHE_BLOCKS];
+static uint32 cache_clock;
+
+/* Mutex for the block cache */
+static mutex_t cache_mutex;
+
+/* Return the offset of the data of the object whose header is at filehdr */
+static uint32 romdisk_data(const rd_image_t *mnt, uint32 filehdr) {
+    const romdisk_file_t *fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
+
+    return filehdr + sizeof(romdisk_file_t) + (strlen(fhdr->filename) / RD_FN_MAX) * RD_FN_MAX;
+}
+
+/* Return the pack header of the object whose header is at filehdr, or NULL
+   if it is not a packed file. */
+static const romdisk_pack_t *romdisk_pack_hdr(const rd_image_t *mnt, uint32 filehdr) {
+    const romdisk_file_t *fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
+    const romdisk_pack_t *pk;
+    uint32 shift;
+
+    if((ntohl_32(&fhdr->next_header) & 7) != ROMFH_REG ||
+       ntohl_32(&fhdr->spec_info) != ROMFS_SPEC_PACKED)
+        return NULL;
+
+    pk = (const romdisk_pack_t *)(mnt->image + romdisk_data(mnt, filehdr));
+    shift = ntohl_32(&pk->shift);
+
+    if(memcmp(pk->magic, "RDZ1", 4) || shift < RD_PACK_SHIFT_MIN ||
+       shift > RD_PACK_SHIFT_MAX)
+        return NULL;
+
+    return pk;
+}
+
+/* Return the size of the contents of the file whose header is at filehdr */
+static uint32 romdisk_size(const rd_image_t *mnt, uint32 filehdr) {
+    const romdisk_file_t *fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
+    const romdisk_pack_t *pk = romdisk_pack_hdr(mnt, filehdr);
+
+    if(pk)
+        return ntohl_32(&pk->size);
+
+    return ntohl_32(&fhdr->size);
+}
+
+/* Check the block table of the packed file whose header is at filehdr: the
+   number of blocks must match the unpacked size, and each block must lie
+   within the packed data and be no bigger than it unpacks to. Returns 0 if
+   it is sound, or -1 if not. */
+static int romdisk_pack_check(const rd_image_t *mnt, uint32 filehdr,
+                              const romdisk_pack_t *pk) {
+    const romdisk_file_t *fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
+    const uint8 *offs = (const uint8 *)(pk + 1);
+    uint32 shift = ntohl_32(&pk->shift), size = ntohl_32(&pk->size);
+    uint32 blocks = ntohl_32(&pk->blocks), psize = ntohl_32(&fhdr->size);
+    uint32 b, start, end, len;
+
+    if(blocks != (size >> shift) + ((size & ((1U << shift) - 1)) != 0))
+        return -1;
+
+    /* The header and table must fit before the first block */
+    end = sizeof(romdisk_pack_t) + 4 * (blocks + 1);
+
+    if(end > psize || (blocks && ntohl_32(offs) < end))
+        return -1;
+
+    for(b = 0; b < blocks; b++) {
+        start = ntohl_32(offs + b * 4);
+        end = ntohl_32(offs + b * 4 + 4);
+        len = size - (b << shift);
+
+        if(len > (1U << shift))
+            len = 1U << shift;
+
+        if(end < start || end > psize || end - start > len)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Decode an LZ4 block of srclen bytes into dst, which has room for dstlen
+   bytes. Returns the number of bytes decoded, or -1 if the block is bad. */
+static int romdisk_lz4(const uint8 *src, size_t srclen, uint8 *dst, size_t dstlen) {
+    const uint8 *ip = src, *iend = src + srclen, *match;
+    uint8 *op = dst, *oend = dst + dstlen;
+    size_t len, off;
+    uint8 token, b;
+
+    while(ip < iend) {
+        token = *ip++;
+
+        /* Literals */
+        len = token >> 4;
+
+        if(len == 15) {
+            do {
+                if(ip >= iend)
+                    return -1;
+
+                b = *ip++;
+                len += b;
+            }
+            while(b == 255);
+        }
+
+        if(len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+            return -1;
+
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+
+        /* The last sequence has no match */
+        if(ip == iend)
+            break;
+
+        /* Match */
+        if(iend - ip < 2)
+            return -1;
+
+        off = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if(off == 0 || off > (size_t)(op - dst))
+            return -1;
+
+        len = token & 15;
+
+        if(len == 15) {
+            do {
+                if(ip >= iend)
+                    return -1;
+
+                b = *ip++;
+                len += b;
+            }
+            while(b == 255);
+        }
+
+        len += 4;
+
+        if(len > (size_t)(oend - op))
+            return -1;
+
+        match = op - off;
+
+        if(off >= len) {
+            memcpy(op, match, len);
+            op += len;
+        }
+        else {
+            /* Overlapping matches repeat the last off bytes */
+            while(len--)
+                *op++ = *match++;
+        }
+    }
+
+    return op - dst;
+}
+
+/* Unpack block b of the packed file whose data is at index into dst, which
+   must have room for the whole block. Returns the unpacked length of the
+   block, or -1 if it is bad. */
+static int romdisk_unpack(const rd_image_t *mnt, uint32 index, uint32 b, uint8 *dst) {
+    const romdisk_pack_t *pk = (const romdisk_pack_t *)(mnt->image + index);
+    const uint8 *offs = (const uint8 *)(pk + 1);
+    uint32 shift = ntohl_32(&pk->shift), size = ntohl_32(&pk->size);
+    uint32 start, end, len;
+
+    if(b >= ntohl_32(&pk->blocks))
+        return -1;
+
+    start = ntohl_32(offs + b * 4);
+    end = ntohl_32(offs + b * 4 + 4);
+    len = size - (b << shift);
+
+    if(len > (1U << shift))
+        len = 1U << shift;
+
+    if(end < start)
+        return -1;
+
+    /* Blocks that didn't compress are stored as they are */
+    if(end - start == len) {
+        memcpy(dst, mnt->image + index + start, len);
+        return len;
+    }
+
+    if(romdisk_lz4(mnt->image + index + start, end - start, dst, len) != (int)len)
+        return -1;
+
+    return len;
+}
+
+/* Find block b of the packed file whose data is at index in the cache,
+   unpacking it into the least recently used entry if it isn't there. The
+   cache mutex must be held. */
+static rd_block_t *romdisk_cache_block(const rd_image_t *mnt, uint32 index, uint32 b,
+                                       uint32 bsize) {
+    rd_block_t *blk, *lru = &cache[0];
+    uint8 *data;
+    int i, len;
+
+    for(i = 0; i < FS_ROMDISK_CACHE_BLOCKS; i++) {
+        blk = &cache[i];
+
+        if(blk->mnt == mnt && blk->index == index && blk->block == b) {
+            blk->used = ++cache_clock;
+            return blk;
+        }
+
+        if(blk->used < lru->used)
+            lru = blk;
+    }
+
+    if(lru->alloc < bsize) {
+        data = (uint8 *)realloc(lru->data, bsize);
+
+        if(data == NULL) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        lru->data = data;
+        lru->alloc = bsize;
+    }
+
+    lru->mnt = NULL;
+    lru->used = 0;
+    len = romdisk_unpack(mnt, index, b, lru->data);
+
+    if(len < 0) {
+        errno = EIO;
+        return NULL;
+    }
+
+    lru->mnt = mnt;
+    lru->index = index;
+    lru->block = b;
+    lru->len = len;
+    lru->used = ++cache_clock;
+
+    return lru;
+}
+
+/* Forget the cached blocks of an image that is going away */
+static void romdisk_cache_drop(const rd_image_t *mnt) {
+    int i;
+
+    mutex_lock(&cache_mutex);
+
+    for(i = 0; i < FS_ROMDISK_CACHE_BLOCKS; i++) {
+        if(cache[i].mnt == mnt) {
+            cache[i].mnt = NULL;
+            cache[i].used = 0;
+        }
+    }
+
+    mutex_unlock(&cache_mutex);
+}
+
 /* Given a filename and a starting romdisk directory listing (byte offset),
    search for the entry in the directory and return the byte offset to its
    entry. */
@@ -219,6 +517,7 @@ static void * romdisk_open(vfs_handler_t * vfs, const char *fn, int mode) {
     file_t          fd;
     uint32          filehdr;
     const romdisk_file_t    *fhdr;
+    const romdisk_pack_t    *pk;
     rd_image_t      *mnt = (rd_image_t *)vfs->privdata;
 
     /* Make sure they don't want to open things as writeable */
@@ -239,6 +538,15 @@ static void * romdisk_open(vfs_handler_t * vfs, const char *fn, int mode) {
         return NULL;
     }
 
+    /* Don't hand out a packed file whose block table would send reads
+       outside of it */
+    pk = (mode & O_DIR) ? NULL : romdisk_pack_hdr(mnt, filehdr);
+
+    if(pk && romdisk_pack_check(mnt, filehdr, pk) < 0) {
+        errno = EIO;
+        return NULL;
+    }
+
     /* Find a free file handle */
     mutex_lock(&fh_mutex);
 
@@ -257,12 +565,19 @@ static void * romdisk_open(vfs_handler_t * vfs, const char *fn, int mode) {
 
     /* Fill the fd structure */
     fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
-    fh[fd].index = filehdr + sizeof(romdisk_file_t) + (strlen(fhdr->filename) / RD_FN_MAX) * RD_FN_MAX;
+    fh[fd].index = romdisk_data(mnt, filehdr);
     fh[fd].dir = ((mode & O_DIR) != 0);
     fh[fd].ptr = 0;
     fh[fd].size = ntohl_32(&fhdr->size);
+    fh[fd].packed = false;
     fh[fd].mnt = mnt;
 
+    if(pk) {
+        fh[fd].size = ntohl_32(&pk->size);
+        fh[fd].packed = true;
+        fh[fd].shift = ntohl_32(&pk->shift);
+    }
+
     return (void *)fd;
 }
 
@@ -278,6 +593,58 @@ static int romdisk_close(void * h) {
     return 0;
 }
 
+/* Read from a packed file, a block at a time. Whole blocks are unpacked
+   straight into buf, and only partial ones go through the cache. */
+static ssize_t romdisk_read_packed(file_t fd, uint8 *buf, size_t bytes) {
+    const rd_image_t *mnt = fh[fd].mnt;
+    uint32 shift = fh[fd].shift, bsize = 1U << shift;
+    uint32 b, off, len, n;
+    rd_block_t *blk;
+    size_t done = 0;
+
+    while(done < bytes) {
+        b = fh[fd].ptr >> shift;
+        off = fh[fd].ptr & (bsize - 1);
+        len = fh[fd].size - (b << shift);
+
+        if(len > bsize)
+            len = bsize;
+
+        n = len - off;
+
+        if(n > bytes - done)
+            n = bytes - done;
+
+        if(n == len) {
+            if(romdisk_unpack(mnt, fh[fd].index, b, buf + done) != (int)len) {
+                errno = EIO;
+                break;
+            }
+        }
+        else {
+            mutex_lock(&cache_mutex);
+            blk = romdisk_cache_block(mnt, fh[fd].index, b, bsize);
+
+            if(blk != NULL)
+                memcpy(buf + done, blk->data + off, n);
+
+            mutex_unlock(&cache_mutex);
+
+            if(blk == NULL)
+                break;
+        }
+
+        fh[fd].ptr += n;
+        done += n;
+    }
+
+    /* Report an error only if nothing could be read */
+    if(done == 0 && bytes != 0)
+        return -1;
+
+    return done;
+}
+
 /* Read from a file */
 static ssize_t romdisk_read(void * h, void *buf, size_t bytes) {
     file_t fd = (file_t)h;
@@ -292,6 +659,9 @@ static ssize_t romdisk_read(void * h, void *buf, size_t bytes) {
     if((fh[fd].ptr + bytes) > fh[fd].size)
         bytes = fh[fd].size - fh[fd].ptr;
 
+    if(fh[fd].packed)
+        return romdisk_read_packed(fd, (uint8 *)buf, bytes);
+
     /* Copy out the requested amount */
     memcpy(buf, fh[fd].mnt->image + fh[fd].index + fh[fd].ptr, bytes);
     fh[fd].ptr += bytes;
@@ -386,6 +756,7 @@ static size_t romdisk_total(void * h) {
 /* Read a directory entry */
 static dirent_t *romdisk_readdir(void * h) {
     romdisk_file_t *fhdr;
+    uint32 filehdr;
     int type;
     file_t fd = (file_t)h;
 
@@ -400,7 +771,8 @@ static dirent_t *romdisk_readdir(void * h) {
         return NULL;
 
     /* Get the current file header */
-    fhdr = (romdisk_file_t *)(fh[fd].mnt->image + fh[fd].index + fh[fd].ptr);
+    filehdr = fh[fd].index + fh[fd].ptr;
+    fhdr = (romdisk_file_t *)(fh[fd].mnt->image + filehdr);
 
     /* Update the pointer */
     fh[fd].ptr = ntohl_32(&fhdr->next_header);
@@ -424,7 +796,7 @@ static dirent_t *romdisk_readdir(void * h) {
     }
     else {
         fh[fd].dirent.attr = 0;
-        fh[fd].dirent.size = ntohl_32(&fhdr->size);
+        fh[fd].dirent.size = romdisk_size(fh[fd].mnt, filehdr);
     }
 
     return &fh[fd].dirent;
@@ -447,6 +819,12 @@ static void *romdisk_mmap(void * h) {
         return NULL;
     }
 
+    /* Packed files only exist in pieces, one block at a time */
+    if(fh[fd].packed) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
     /* Can't really help the loss of "const" here */
     return (void *)(fh[fd].mnt->image + fh[fd].index);
 }
@@ -455,7 +833,6 @@ static int romdisk_stat(vfs_handler_t *vfs, const char *path, struct stat *st,
                         int flag) {
     mode_t md;
     uint32_t filehdr;
-    const romdisk_file_t *fhdr;
     rd_image_t *mnt = (rd_image_t *)vfs->privdata;
     size_t len = strlen(path);
 
@@ -497,8 +874,7 @@ static int romdisk_stat(vfs_handler_t *vfs, const char *path, struct stat *st,
     st->st_blksize = 1024;
 
     if(md == S_IFREG) {
-        fhdr = (const romdisk_file_t *)(mnt->image + filehdr);
-        st->st_size = ntohl_32(&fhdr->size);
+        st->st_size = romdisk_size(mnt, filehdr);
         st->st_nlink = 1;
         st->st_blocks = st->st_size >> 10;
 
@@ -637,8 +1013,13 @@ void fs_romdisk_init(void) {
     /* Mark the first as active so we can have an error FD of zero */
     fh[0].index = FH_INDEX_RESERVED;
 
+    /* Reset the block cache */
+    memset(cache, 0, sizeof(cache));
+    cache_clock = 0;
+
     /* Init thread mutexes */
     mutex_init(&fh_mutex, MUTEX_TYPE_NORMAL);
+    mutex_init(&cache_mutex, MUTEX_TYPE_NORMAL);
 
     initted = 1;
 }
@@ -646,6 +1027,7 @@ void fs_romdisk_init(void) {
 /* De-init the file system; also unmounts any mounted images. */
 void fs_romdisk_shutdown(void) {
     rd_image_t *n, *c;
+    int i;
 
     if(!initted)
         return;
@@ -674,8 +1056,15 @@ void fs_romdisk_shutdown(void) {
         c = n;
     }
 
-    /* Free mutex */
+    /* Free the block cache */
+    for(i = 0; i < FS_ROMDISK_CACHE_BLOCKS; i++)
+        free(cache[i].data);
+
+    memset(cache, 0, sizeof(cache));
+
+    /* Free mutexes */
     mutex_destroy(&fh_mutex);
+    mutex_destroy(&cache_mutex);
 
     initted = 0;
 }
@@ -769,6 +1158,7 @@ int fs_romdisk_unmount(const char * mountpoint) {
         /* Unmount it */
         assert((void *)&n->vfsh->nmmgr == (void *)n->vfsh);
         nmmgr_handler_remove(&n->vfsh->nmmgr);
+        romdisk_cache_drop(n);
 
         /* If we own the buffer, free it */
         if(n->own_buffer)
@@ -2,6 +2,7 @@
 
    fs_socket.c
    Copyright (C) 2006, 2009, 2012, 2013, 2016 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -16,9 +17,13 @@
 
 #include <sys/queue.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+/* How much of a file sendfile() reads at a time when it can't be mapped */
+#define SENDFILE_CHUNK  4096
+
 /* Define the protocol list type */
 TAILQ_HEAD(proto_list, fs_socket_proto);
 
@@ -505,6 +510,385 @@ ssize_t sendto(int sock, const void *message, size_t length, int flags,
                                  dest_len);
 }
 
+/* Protocols without recvmmsg/sendmmsg handlers move one message at a time
+   through recvfrom/sendto. Messages made up of more than one buffer go
+   through a temporary one. */
+static int sock_check_msg(const struct msghdr *msg) {
+    if(msg == NULL || (msg->msg_iovlen && msg->msg_iov == NULL)) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if(msg->msg_iovlen <= 0 || msg->msg_iovlen > IOV_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    return 0;
+}
+
+static size_t sock_msg_len(const struct msghdr *msg) {
+    size_t len = 0;
+    int i;
+
+    for(i = 0; i < msg->msg_iovlen; ++i)
+        len += msg->msg_iov[i].iov_len;
+
+    return len;
+}
+
+static ssize_t sock_recv_one(net_socket_t *hnd, struct msghdr *msg,
+                             int flags) {
+    size_t len, n;
+    ssize_t rv;
+    uint8_t *buf;
+    int i;
+
+    if(sock_check_msg(msg))
+        return -1;
+
+    msg->msg_flags = 0;
+    msg->msg_controllen = 0;
+
+    if(msg->msg_iovlen == 1)
+        return hnd->protocol->recvfrom(hnd, msg->msg_iov[0].iov_base,
+                                       msg->msg_iov[0].iov_len, flags,
+                                       msg->msg_name, msg->msg_name ?
+                                       &msg->msg_namelen : NULL);
+
+    len = sock_msg_len(msg);
+
+    if(!(buf = (uint8_t *)malloc(len ? len : 1))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    rv = hnd->protocol->recvfrom(hnd, buf, len, flags, msg->msg_name,
+                                 msg->msg_name ? &msg->msg_namelen : NULL);
+
+    for(i = 0, len = 0; rv > 0 && len < (size_t)rv; ++i) {
+        n = msg->msg_iov[i].iov_len;
+
+        if(n > (size_t)rv - len)
+            n = (size_t)rv - len;
+
+        memcpy(msg->msg_iov[i].iov_base, buf + len, n);
+        len += n;
+    }
+
+    free(buf);
+    return rv;
+}
+
+static ssize_t sock_send_one(net_socket_t *hnd, const struct msghdr *msg,
+                             int flags) {
+    size_t len;
+    ssize_t rv;
+    uint8_t *buf;
+    int i;
+
+    if(sock_check_msg(msg))
+        return -1;
+
+    if(msg->msg_iovlen == 1)
+        return hnd->protocol->sendto(hnd, msg->msg_iov[0].iov_base,
+                                     msg->msg_iov[0].iov_len, flags,
+                                     msg->msg_name, msg->msg_namelen);
+
+    len = sock_msg_len(msg);
+
+    if(!(buf = (uint8_t *)malloc(len ? len : 1))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for(i = 0, len = 0; i < msg->msg_iovlen; ++i) {
+        memcpy(buf + len, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        len += msg->msg_iov[i].iov_len;
+    }
+
+    rv = hnd->protocol->sendto(hnd, buf, len, flags, msg->msg_name,
+                               msg->msg_namelen);
+    free(buf);
+    return rv;
+}
+
+ssize_t recvmsg(int sock, struct msghdr *message, int flags) {
+    net_socket_t *hnd;
+    struct mmsghdr mmsg;
+    int rv;
+
+    hnd = (net_socket_t *)fs_get_handle(sock);
+
+    if(hnd == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Make sure this is actually a socket. */
+    if(fs_get_handler(sock) != &vh) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+
+    if(!hnd->protocol->recvmmsg)
+        return sock_recv_one(hnd, message, flags);
+
+    if(sock_check_msg(message))
+        return -1;
+
+    mmsg.msg_hdr = *message;
+    rv = hnd->protocol->recvmmsg(hnd, &mmsg, 1, flags, NULL);
+
+    if(rv <= 0)
+        return rv;
+
+    *message = mmsg.msg_hdr;
+    return mmsg.msg_len;
+}
+
+int recvmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout) {
+    net_socket_t *hnd;
+    unsigned int i;
+    ssize_t rv;
+
+    hnd = (net_socket_t *)fs_get_handle(sock);
+
+    if(hnd == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Make sure this is actually a socket. */
+    if(fs_get_handler(sock) != &vh) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+
+    if(msgvec == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if(hnd->protocol->recvmmsg)
+        return hnd->protocol->recvmmsg(hnd, msgvec, vlen, flags, timeout);
+
+    for(i = 0; i < vlen; ++i) {
+        if(i && (flags & MSG_WAITFORONE))
+            flags |= MSG_DONTWAIT;
+
+        rv = sock_recv_one(hnd, &msgvec[i].msg_hdr, flags & ~MSG_WAITFORONE);
+
+        if(rv <= 0)
+            return i ? (int)i : (int)rv;
+
+        msgvec[i].msg_len = rv;
+    }
+
+    return i;
+}
+
+ssize_t sendmsg(int sock, const struct msghdr *message, int flags) {
+    net_socket_t *hnd;
+    struct mmsghdr mmsg;
+    int rv;
+
+    hnd = (net_socket_t *)fs_get_handle(sock);
+
+    if(hnd == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Make sure this is actually a socket. */
+    if(fs_get_handler(sock) != &vh) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+
+    if(!hnd->protocol->sendmmsg)
+        return sock_send_one(hnd, message, flags);
+
+    if(sock_check_msg(message))
+        return -1;
+
+    mmsg.msg_hdr = *message;
+    rv = hnd->protocol->sendmmsg(hnd, &mmsg, 1, flags);
+
+    if(rv <= 0)
+        return -1;
+
+    return mmsg.msg_len;
+}
+
+int sendmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+    net_socket_t *hnd;
+    unsigned int i;
+    ssize_t rv;
+
+    hnd = (net_socket_t *)fs_get_handle(sock);
+
+    if(hnd == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Make sure this is actually a socket. */
+    if(fs_get_handler(sock) != &vh) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+
+    if(msgvec == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if(hnd->protocol->sendmmsg)
+        return hnd->protocol->sendmmsg(hnd, msgvec, vlen, flags);
+
+    for(i = 0; i < vlen; ++i) {
+        rv = sock_send_one(hnd, &msgvec[i].msg_hdr, flags);
+
+        if(rv < 0)
+            return i ? (int)i : -1;
+
+        msgvec[i].msg_len = rv;
+    }
+
+    return i;
+}
+
+/* Send len bytes, for as long as the socket takes them. */
+static ssize_t sock_send_all(net_socket_t *hnd, const uint8_t *buf,
+                             size_t len) {
+    size_t done = 0;
+    ssize_t rv;
+
+    while(done < len) {
+        rv = hnd->protocol->sendto(hnd, buf + done, len - done, 0, NULL, 0);
+
+        if(rv <= 0)
+            return done ? (ssize_t)done : rv;
+
+        done += rv;
+    }
+
+    return done;
+}
+
+ssize_t sendfile(int out_sock, int in_fd, off_t *offset, size_t count) {
+    net_socket_t *hnd;
+    const uint8_t *map;
+    uint8_t *buf;
+    off_t start, pos;
+    size_t total, len, sent = 0;
+    ssize_t rv = 0, wrote;
+
+    hnd = (net_socket_t *)fs_get_handle(out_sock);
+
+    if(hnd == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Make sure this is actually a socket. */
+    if(fs_get_handler(out_sock) != &vh) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+
+    if(fs_get_handler(in_fd) == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Work out where to start. A file that can't be seeked can still be sent
+       from wherever it is now. */
+    start = fs_tell(in_fd);
+
+    if(offset) {
+        if(start < 0 || *offset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        pos = *offset;
+    }
+    else {
+        pos = start;
+    }
+
+    if(!count)
+        return 0;
+
+    if((map = (const uint8_t *)fs_mmap(in_fd)) != NULL) {
+        /* The whole file is in memory already, so the socket can take it
+           straight from there. */
+        total = fs_total(in_fd);
+
+        if(pos >= 0 && (size_t)pos < total) {
+            len = total - pos;
+            rv = sock_send_all(hnd, map + pos, count < len ? count : len);
+
+            if(rv > 0)
+                sent = rv;
+        }
+    }
+    else {
+        /* Otherwise, go through a buffer. */
+        len = count < SENDFILE_CHUNK ? count : SENDFILE_CHUNK;
+
+        if(!(buf = (uint8_t *)malloc(len))) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        if(offset && fs_seek(in_fd, pos, SEEK_SET) < 0) {
+            free(buf);
+            return -1;
+        }
+
+        while(sent < count) {
+            len = count - sent < SENDFILE_CHUNK ? count - sent : SENDFILE_CHUNK;
+
+            if((rv = fs_read(in_fd, buf, len)) <= 0)
+                break;
+
+            wrote = sock_send_all(hnd, buf, rv);
+
+            if(wrote > 0)
+                sent += wrote;
+
+            /* Stop if the socket didn't take it all. The file position gets
+               moved back to what was actually sent below. */
+            if(wrote != rv) {
+                rv = wrote;
+                break;
+            }
+        }
+
+        free(buf);
+    }
+
+    /* Leave the file position (or the offset) just past what was sent. */
+    if(offset) {
+        *offset = pos + sent;
+
+        if(start >= 0)
+            fs_seek(in_fd, start, SEEK_SET);
+    }
+    else if(start >= 0) {
+        fs_seek(in_fd, pos + sent, SEEK_SET);
+    }
+
+    if(!sent && rv < 0)
+        return -1;
+
+    return sent;
+}
+
 int shutdown(int sock, int how) {
     net_socket_t *hnd;
 
@@ -3,6 +3,7 @@
    fs_utils.c
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2014 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -203,7 +204,7 @@ char *fs_normalize_path(const char *__restrict path, char *__restrict resolved)
 
     /* Handle absolute path. */
     if(path[0] == '/') {
-        strncpy(temp_path, path, len);
+        memcpy(temp_path, path, len);
         temp_path[len] = '\0';
     } 
     else {
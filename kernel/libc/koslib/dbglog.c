@@ -2,6 +2,7 @@
 
    dbglog.c
    Copyright (C)2000,2001,2004 Megan Potter
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <stdio.h>
@@ -32,12 +33,20 @@ void dbglog_set_level(int level) {
 /* Kernel debug logging facility */
 void dbglog(int level, const char *fmt, ...) {
     va_list args;
-    int i;
+    int i, queued;
 
     /* If this log level is blocked out, don't even bother */
     if(level > dbglog_level)
         return;
 
+    /* Leave it to the drain thread, if dbgio_async_start() is in effect */
+    va_start(args, fmt);
+    queued = !__dbgio_async_vprintf(!irq_inside_int(), fmt, args, &i);
+    va_end(args);
+
+    if(queued)
+        return;
+
     /* We only try to lock if the message isn't urgent */
     if(level >= DBG_ERROR && !irq_inside_int())
         spinlock_lock(&mutex);
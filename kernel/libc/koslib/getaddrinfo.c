@@ -3,6 +3,7 @@
    getaddrinfo.c
 
    Copyright (C) 2014 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
    Originally:
    lwip/dns.c
@@ -18,10 +19,13 @@
    The implementations of getaddrinfo() and freeaddrinfo() are new to this
    version of the code though.
 
-   Eventually, I'd like to add some sort of caching of results to this file so
-   that if you look something up more than once, it doesn't have to go back out
-   to the server to do so. But, for now, there is no local database of cached
-   addresses...
+   Results are kept in a small cache for as long as their TTLs allow, so that
+   looking the same name up again doesn't have to go back out to the server.
+   Names that don't exist (or that have no addresses of the type asked for) are
+   cached as well, for as long as the server's SOA record says to, as described
+   in RFC 2308, though not when the server leaves the SOA out. The A and AAAA queries for an AF_UNSPEC lookup are sent out
+   together, and each attempt that goes unanswered moves on to the next DNS
+   server, if more than one is configured.
 */
 
 #include <stdio.h>
@@ -29,6 +33,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <ctype.h>
 #include <poll.h>
 
 #include <netdb.h>
@@ -37,25 +42,34 @@
 #include <netinet/in.h>
 
 #include <kos/net.h>
-#include <kos/dbglog.h>
+#include <kos/mutex.h>
+#include <kos/opts.h>
 
-/* How many attempts to make at contacting the DNS server before giving up. */
+#include <arch/timer.h>
+
+/* How many attempts to make at contacting the DNS servers before giving up.
+   Each attempt goes to the next server in the list, and every server gets at
+   least one attempt. */
 #define DNS_ATTEMPTS    4
 
 /* How long to wait between attempts. */
 #define DNS_TIMEOUT     500
 
-/*
-   This performs a simple DNS A-record query. It hasn't been tested extensively
-   but so far it seems to work fine.
-
-   This relies on the really sketchy UDP support in the KOS lwIP port, so it
-   can be cleaned up later once that's improved.
+/* The longest name that can be looked up, leaving out any trailing dot. */
+#define DNS_NAME_MAX    253
 
-   We really need to be setting errno in here too...
- */
+/* The most addresses of each type that are kept for a name. */
+#define DNS_MAX_ADDRS   8
 
+/* The longest time (in seconds) to cache a name that doesn't exist for, and
+   the longest time to cache anything for. */
+#define DNS_MAX_NEG_TTL 300
+#define DNS_MAX_TTL     86400
 
+/* The largest query is the header, a name of DNS_NAME_MAX characters (which
+   takes two more bytes once split into labels) and the type and class. */
+#define DNS_QUERY_SIZE  (12 + DNS_NAME_MAX + 2 + 4)
+#define DNS_MSG_SIZE    512
 
 /* Basic query process:
 
@@ -71,9 +85,9 @@ typedef struct dnsmsg {
     uint8_t data[];      // Payload
 } dnsmsg_t;
 
-static uint16_t qnum = 0;
-
 #define QTYPE_A         1
+#define QTYPE_CNAME     5
+#define QTYPE_SOA       6
 #define QTYPE_AAAA      28
 
 /* Flags:
@@ -115,74 +129,52 @@ static uint16_t qnum = 0;
      AAAA   28
  */
 
-// Construct a DNS query for an A record by host name. "buf" should
-// be at least 1500 bytes, to make sure there's room.
-static size_t dns_make_query(const char *host, dnsmsg_t *buf, int ip4,
-                             int ip6) {
-    int i, o = 0, ls, t;
+/* Construct a DNS query for one type of record for a host name, which must
+   not have a trailing dot. "buf" should be at least DNS_QUERY_SIZE bytes.
+   Returns the size of the message, or -1 if the name isn't a valid one. */
+static int dns_make_query(const char *host, uint16_t id, uint16_t qtype,
+                          uint8_t *buf) {
+    dnsmsg_t *msg = (dnsmsg_t *)buf;
+    int i, o, ls, t;
 
     // Build up the header.
-    buf->id = htons(qnum++);
-    buf->flags = htons(0x0100);
-    buf->qdcount = htons(ip4 + ip6);
-    buf->ancount = htons(0);
-    buf->nscount = htons(0);
-    buf->arcount = htons(0);
-
-    /* Fill in the question section(s). */
+    msg->id = htons(id);
+    msg->flags = htons(0x0100);
+    msg->qdcount = htons(1);
+    msg->ancount = htons(0);
+    msg->nscount = htons(0);
+    msg->arcount = htons(0);
+
+    /* Fill in the question section. */
     ls = 0;
-
-    if(ip4) {
-        o = ls + 1;
-        t = strlen(host);
-
-        for(i = 0; i <= t; i++) {
-            if(host[i] == '.' || i == t) {
-                buf->data[ls] = (o - ls) - 1;
-                ls = o;
-                o++;
-            }
-            else {
-                buf->data[o++] = host[i];
-            }
+    o = 1;
+    t = strlen(host);
+
+    for(i = 0; i <= t; i++) {
+        if(host[i] == '.' || i == t) {
+            /* Labels can't be empty, or longer than 63 bytes. */
+            if(o - ls - 1 < 1 || o - ls - 1 > 63)
+                return -1;
+
+            msg->data[ls] = (o - ls) - 1;
+            ls = o;
+            o++;
         }
-
-        buf->data[ls] = 0;
-
-        // Might be unaligned now... so just build it by hand.
-        buf->data[o++] = (uint8_t)(QTYPE_A >> 8);
-        buf->data[o++] = (uint8_t)QTYPE_A;
-        buf->data[o++] = 0x00;
-        buf->data[o++] = 0x01;
-        ls = o;
-    }
-
-    if(ip6) {
-        o = ls + 1;
-        t = strlen(host);
-
-        for(i = 0; i <= t; i++) {
-            if(host[i] == '.' || i == t) {
-                buf->data[ls] = (o - ls) - 1;
-                ls = o;
-                o++;
-            }
-            else {
-                buf->data[o++] = host[i];
-            }
+        else {
+            msg->data[o++] = host[i];
         }
+    }
 
-        buf->data[ls] = 0;
+    msg->data[ls] = 0;
 
-        // Might be unaligned now... so just build it by hand.
-        buf->data[o++] = (uint8_t)(QTYPE_AAAA >> 8);
-        buf->data[o++] = (uint8_t)QTYPE_AAAA;
-        buf->data[o++] = 0x00;
-        buf->data[o++] = 0x01;
-    }
+    // Might be unaligned now... so just build it by hand.
+    msg->data[o++] = (uint8_t)(qtype >> 8);
+    msg->data[o++] = (uint8_t)qtype;
+    msg->data[o++] = 0x00;
+    msg->data[o++] = 0x01;
 
     // Return the full message size.
-    return (size_t)(o + sizeof(dnsmsg_t));
+    return (int)(o + sizeof(dnsmsg_t));
 }
 
 /* Resource records. A standard DNS response will have one query
@@ -212,96 +204,93 @@ static size_t dns_make_query(const char *host, dnsmsg_t *buf, int ip4,
    name, and the A answer contains the address.
  */
 
-// Scans through and skips a label in the data payload, starting
-// at the given offset. The new offset (after the label) will be
-// returned.
-static int dns_skip_label(dnsmsg_t *resp, int o) {
-    int cnt;
-
-    // End of the label?
-    while(resp->data[o] != 0) {
-        // Is it a pointer?
-        if((resp->data[o] & 0xc0) == 0xc0)
-            return o + 2;
-
-        // Skip this part.
-        cnt = resp->data[o++];
-        o += cnt;
-    }
-
-    // Skip the terminator
-    o++;
+/* The result of looking up one type of record for a name, as it is kept in the
+   cache. For A records, only the first four bytes of each address are used. */
+typedef struct dns_result {
+    int         status;     /* 0, or the EAI_* error for the lookup */
+    int         err;        /* errno value, when status is EAI_SYSTEM */
+    uint32_t    ttl;        /* How long the result can be cached, in seconds */
+    int         count;      /* Number of addresses */
+    uint8_t     addrs[DNS_MAX_ADDRS][16];
+} dns_result_t;
+
+typedef struct dns_entry {
+    char            name[DNS_NAME_MAX + 1];
+    uint16_t        qtype;
+    uint64          expires;    /* In milliseconds; 0 for a free entry */
+    uint32          used;       /* For picking the least recently used */
+    dns_result_t    res;
+} dns_entry_t;
+
+static dns_entry_t dns_cache[NET_DNS_CACHE_ENTRIES];
+static uint32 dns_used;
+static uint8 dns_servers[NET_DNS_MAX_SERVERS][4];
+static int dns_server_count;
+static net_dns_stats_t dns_stats;
+static uint16_t qnum = 0;
+static mutex_t dns_mutex = MUTEX_INITIALIZER;
 
-    return o;
+static inline uint16_t dns_get16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
 }
 
-// Scans through and copies out a label in the data payload,
-// starting at the given offset. The new offset (after the label)
-// will be returned as well as the label string.
-static int dns_copy_label(dnsmsg_t *resp, int o, char *outbuf) {
-    int cnt;
-    int rv = -1;
-
-    // Do each part.
-    outbuf[0] = 0;
-
-    for(;;) {
-        // Is it a pointer?
-        if((resp->data[o] & 0xc0) == 0xc0) {
-            int offs = ((resp->data[o] & ~0xc0) << 8) | resp->data[o + 1];
-
-            if(rv < 0)
-                rv = o + 2;
+static inline uint32_t dns_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
 
-            o = offs - sizeof(dnsmsg_t);
-        }
-        else {
-            cnt = resp->data[o++];
+/* Scans through and skips a name in the message, starting at the given offset
+   from the start of it. The new offset (after the name) will be returned, or
+   -1 if the name runs past the end of the message. */
+static int dns_skip_name(const uint8_t *msg, int size, int o) {
+    while(o < size) {
+        // End of the name?
+        if(msg[o] == 0)
+            return o + 1;
 
-            if(cnt) {
-                if(outbuf[0] != 0)
-                    strcat(outbuf, ".");
+        // Is it a pointer? That always ends the name.
+        if((msg[o] & 0xc0) == 0xc0)
+            return o + 2 <= size ? o + 2 : -1;
 
-                strncat(outbuf, (char *)(resp->data + o), cnt);
-                o += cnt;
-            }
-            else {
-                break;
-            }
-        }
+        // Skip this part.
+        o += msg[o] + 1;
     }
 
-    if(rv < 0)
-        return o;
-    else
-        return rv;
+    return -1;
 }
 
-/* Forward declaration... */
-static struct addrinfo *add_ipv4_ai(uint32_t ip, uint16_t port,
-                                    struct addrinfo *h, struct addrinfo *tail);
-static struct addrinfo *add_ipv6_ai(const struct in6_addr *ip, uint16_t port,
-                                    struct addrinfo *h, struct addrinfo *tail);
-
-// Parse a response packet from the DNS server. The IP address
-// will be filled in upon a successful return, otherwise the
-// return value will be <0.
-static int dns_parse_response(dnsmsg_t *resp, struct addrinfo *hints,
-                              uint16_t port, struct addrinfo **res) {
-    int i, o, arecs;
-    uint16_t flags;
-    char tmp[64];
-    uint16_t ancnt, len;
-    struct addrinfo *ptr = NULL;
-
-    /* Check the flags first to see if it was successful. */
-    flags = ntohs(resp->flags);
+/* TTLs with the top bit set are to be treated as zero (RFC 2181). */
+static uint32_t dns_ttl(uint32_t ttl) {
+    return (ttl & 0x80000000) ? 0 : ttl;
+}
 
-    if(!(flags & 0x8000)) {
-        /* Not our response! */
-        return EAI_AGAIN;
+/* Parse a response from the DNS server to the query in q (of qsize bytes),
+   which asked for records of the given type. Returns -1 if this isn't a
+   response to that query at all, or if it is broken. Otherwise, res is filled
+   in with the result (which might be an error) and 0 is returned. */
+static int dns_parse_response(const uint8_t *q, int qsize, uint16_t qtype,
+                              const uint8_t *resp, int size,
+                              dns_result_t *res) {
+    int i, o, m, ancnt, nscnt, len, alen, bad = 0;
+    uint16_t flags, type;
+    uint32_t ttl, negttl = 0;
+
+    /* Make sure it's actually the answer to our question. */
+    if(size < qsize || resp[0] != q[0] || resp[1] != q[1])
+        return -1;
+
+    flags = dns_get16(resp + 2);
+
+    if(!(flags & 0x8000) || dns_get16(resp + 4) != 1)
+        return -1;
+
+    for(i = sizeof(dnsmsg_t); i < qsize; i++) {
+        if(tolower(resp[i]) != tolower(q[i]))
+            return -1;
     }
 
+    memset(res, 0, sizeof(*res));
+    res->ttl = DNS_MAX_TTL;
+
     /* Did the server report an error? */
     switch(flags & 0x000f) {
         case 0:   /* No error */
@@ -311,211 +300,500 @@ static int dns_parse_response(dnsmsg_t *resp, struct addrinfo *hints,
         case 4:   /* Not implemented */
         case 5:   /* Refused */
         default:
-            return EAI_FAIL;
+            res->status = EAI_FAIL;
+            return 0;
 
         case 3:   /* Name error */
-            return EAI_NONAME;
+            res->status = EAI_NONAME;
+            break;
 
         case 2:   /* Server failure */
-            return EAI_AGAIN;
+            res->status = EAI_AGAIN;
+            return 0;
     }
 
-    /* Getting zero answers is also a failure. */
-    ancnt = ntohs(resp->ancount);
+    /* Go through the answers for the addresses, and the authority section for
+       the SOA record that says how long a negative answer is good for. Without
+       one, a negative answer isn't cached at all (RFC 2308, section 5). */
+    ancnt = dns_get16(resp + 6);
+    nscnt = dns_get16(resp + 8);
+    o = qsize;
+    alen = qtype == QTYPE_A ? 4 : 16;
+
+    for(i = 0; i < ancnt + nscnt; i++) {
+        if((o = dns_skip_name(resp, size, o)) < 0 || o + 10 > size) {
+            bad = 1;
+            break;
+        }
 
-    if(ancnt < 1)
-        return EAI_NONAME;
+        type = dns_get16(resp + o);
+        ttl = dns_ttl(dns_get32(resp + o + 4));
+        len = dns_get16(resp + o + 8);
+        o += 10;
 
-    /* If we have any query sections (should have at least one), skip 'em. */
-    o = 0;
-    len = ntohs(resp->qdcount);
+        if(o + len > size) {
+            bad = 1;
+            break;
+        }
 
-    for(i = 0; i < len; i++) {
-        /* Skip the label. */
-        o = dns_skip_label(resp, o);
+        if(i < ancnt) {
+            if(type == qtype && len == alen) {
+                if(res->count < DNS_MAX_ADDRS)
+                    memcpy(res->addrs[res->count++], resp + o, alen);
 
-        /* And the two type fields. */
-        o += 4;
-    }
+                if(ttl < res->ttl)
+                    res->ttl = ttl;
+            }
+            else if(type == QTYPE_CNAME && ttl < res->ttl) {
+                /* The addresses are only good for as long as the alias that
+                   led to them is. */
+                res->ttl = ttl;
+            }
+        }
+        else if(type == QTYPE_SOA) {
+            /* The SOA has two names, and then the serial, refresh, retry,
+               expire and minimum fields. The negative TTL is the smaller of
+               the minimum and the TTL of the SOA record itself. */
+            m = dns_skip_name(resp, o + len, o);
+            m = m < 0 ? -1 : dns_skip_name(resp, o + len, m);
+
+            if(m >= 0 && m + 20 <= o + len) {
+                negttl = dns_ttl(dns_get32(resp + m + 16));
+
+                if(ttl < negttl)
+                    negttl = ttl;
+            }
+        }
 
-    /* Ok, now the answer section (what we're interested in). */
-    arecs = 0;
+        o += len;
+    }
 
-    for(i = 0; i < ancnt; i++) {
-        /* Copy out the label, in case we need it. */
-        o = dns_copy_label(resp, o, tmp);
+    /* A response that runs off its end is broken, unless the server said that
+       it had to cut it short. */
+    if(bad && !(flags & 0x0200))
+        return -1;
 
-        /* Get the type code. If it's not A or AAAA, skip it. */
-        if(resp->data[o] == 0 && resp->data[o + 1] == 1 &&
-           (hints->ai_family == AF_INET || hints->ai_family == AF_UNSPEC)) {
-            uint32_t addr;
+    /* Getting no addresses of the type we asked for means there aren't any. */
+    if(!res->count)
+        res->status = EAI_NONAME;
 
-            o += 8;
-            len = (resp->data[o] << 8) | resp->data[o + 1];
-            o += 2;
+    if(res->status == EAI_NONAME)
+        res->ttl = negttl < DNS_MAX_NEG_TTL ? negttl : DNS_MAX_NEG_TTL;
 
-            /* Grab the address from the response. */
-            addr = htonl((resp->data[o] << 24) | (resp->data[o + 1] << 16) |
-                         (resp->data[o + 2] << 8) | resp->data[o + 3]);
+    return 0;
+}
 
-            /* Add this address to the chain. */
-            if(!(ptr = add_ipv4_ai(addr, port, hints, ptr)))
-                /* If something goes wrong in here, it's in calling malloc, so
-                   it is definitely a system error. */
-                return EAI_SYSTEM;
+/* Look for an unexpired result for the name in the cache. The caller must hold
+   dns_mutex. */
+static int dns_cache_find(const char *name, uint16_t qtype, uint64 now,
+                          dns_result_t *res) {
+    int i;
 
-            if(!*res)
-                *res = ptr;
+    for(i = 0; i < NET_DNS_CACHE_ENTRIES; i++) {
+        dns_entry_t *e = &dns_cache[i];
 
-            o += len;
-            arecs++;
+        if(e->expires > now && e->qtype == qtype && !strcasecmp(e->name, name)) {
+            e->used = ++dns_used;
+            *res = e->res;
+            return 1;
         }
-        else if(resp->data[o] == 0 && resp->data[o + 1] == 28 &&
-                (hints->ai_family == AF_INET6 || hints->ai_family == AF_UNSPEC)) {
-            struct in6_addr addr;
+    }
 
-            o += 8;
-            len = (resp->data[o] << 8) | resp->data[o + 1];
-            o += 2;
+    return 0;
+}
 
-            /* Grab the address from the response. */
-            memcpy(addr.s6_addr, &resp->data[o], 16);
+/* Add a result to the cache, replacing any older one for the same name, or
+   otherwise an expired entry or the least recently used one. The caller must
+   hold dns_mutex. */
+static void dns_cache_add(const char *name, uint16_t qtype, uint64 now,
+                          const dns_result_t *res) {
+    dns_entry_t *e, *victim = NULL;
+    int i;
 
-            /* Add this address to the chain. */
-            if(!(ptr = add_ipv6_ai(&addr, port, hints, ptr)))
-                /* If something goes wrong in here, it's in calling malloc, so
-                   it is definitely a system error. */
-                return EAI_SYSTEM;
+    /* Only cache answers, not errors talking to the server. */
+    if((res->status && res->status != EAI_NONAME) || !res->ttl)
+        return;
 
-            if(!*res)
-                *res = ptr;
+    for(i = 0; i < NET_DNS_CACHE_ENTRIES; i++) {
+        e = &dns_cache[i];
 
-            o += len;
-            arecs++;
+        if(e->expires && e->qtype == qtype && !strcasecmp(e->name, name)) {
+            victim = e;
+            break;
         }
-        else if(resp->data[o] == 0 && resp->data[o + 1] == 5) {
-            char tmp2[64];
 
-            o += 8;
-            len = (resp->data[o] << 8) | resp->data[o + 1];
-            o += 2;
-            o = dns_copy_label(resp, o, tmp2);
-        }
-        else {
-            o += 8;
-            len = (resp->data[o] << 8) | resp->data[o + 1];
-            o += 2 + len;
+        if(!victim || (victim->expires > now &&
+                       (e->expires <= now || e->used < victim->used)))
+            victim = e;
+    }
+
+    strcpy(victim->name, name);
+    victim->qtype = qtype;
+    victim->expires = now + res->ttl * 1000ULL;
+    victim->used = ++dns_used;
+    victim->res = *res;
+}
+
+/* Collect the list of servers to ask: the default device's one, and then any
+   that were set with net_dns_set_servers(). */
+static int dns_get_servers(uint8 servers[][4]) {
+    int i, j, cnt = 0;
+
+    if(net_default_dev && net_ipv4_address(net_default_dev->dns))
+        memcpy(servers[cnt++], net_default_dev->dns, 4);
+
+    for(i = 0; i < dns_server_count; i++) {
+        for(j = 0; j < cnt; j++) {
+            if(!memcmp(servers[j], dns_servers[i], 4))
+                break;
         }
+
+        if(j == cnt)
+            memcpy(servers[cnt++], dns_servers[i], 4);
     }
 
-    /* Did we find something? */
-    return arecs > 0 ? 0 : EAI_NONAME;
+    return cnt;
 }
 
-static int getaddrinfo_dns(const char *name, struct addrinfo *hints,
-                           uint16_t port, struct addrinfo **res) {
-    struct sockaddr_in toaddr;
-    uint8_t qb[512];
-    size_t size;
-    int sock, rv, tries;
-    in_addr_t raddr;
-    ssize_t rsize = 0;
+static void dns_fail(dns_result_t res[], int nq, int status, int err) {
+    int i;
+
+    for(i = 0; i < nq; i++) {
+        memset(&res[i], 0, sizeof(res[i]));
+        res[i].status = status;
+        res[i].err = err;
+    }
+}
+
+/* Ask the DNS servers for the given types of records for a name. All of the
+   queries are sent out at once, and wait for their answers together. */
+static void dns_query(const char *name, int nq, const uint16_t qtypes[],
+                      dns_result_t res[]) {
+    uint8_t qb[2][DNS_QUERY_SIZE];
+    uint8_t rb[DNS_MSG_SIZE];
+    uint8 servers[NET_DNS_MAX_SERVERS + 1][4];
+    int qsize[2], nsrv, pending, answered, tries, attempts, i, j;
+    struct sockaddr_in toaddr, fromaddr;
+    socklen_t fromlen;
     struct pollfd pfd;
+    dns_result_t tmp;
+    uint64 now, deadline;
+    ssize_t rsize;
+    int sock, sent = 0, timeouts = 0, failovers = 0;
 
     /* Make sure we have a network device to communicate on. */
     if(!net_default_dev) {
-        errno = ENETDOWN;
-        return EAI_SYSTEM;
+        dns_fail(res, nq, EAI_SYSTEM, ENETDOWN);
+        return;
     }
 
+    mutex_lock(&dns_mutex);
+
     /* Do we have a DNS server specified? */
-    if(net_default_dev->dns[0] == 0 && net_default_dev->dns[1] == 0 &&
-       net_default_dev->dns[2] == 0 && net_default_dev->dns[3] == 0) {
-        return EAI_FAIL;
-    }
-
-    /* Setup a query */
-    if(hints->ai_family == AF_UNSPEC)
-        /* Note: This should (in theory) work, but it seems that some resolvers
-           cannot handle multiple questions in one query. So... while the code
-           here supports multiple questions in one query, this branch will never
-           actually be taken -- getaddrinfo() will always make two separate
-           calls if we need to do both IPv4 and IPv6. */
-        size = dns_make_query(name, (dnsmsg_t *)qb, 1, 1);
-    else if(hints->ai_family == AF_INET)
-        size = dns_make_query(name, (dnsmsg_t *)qb, 1, 0);
-    else if(hints->ai_family == AF_INET6)
-        size = dns_make_query(name, (dnsmsg_t *)qb, 0, 1);
-    else {
-        errno = EAFNOSUPPORT;
-        return EAI_SYSTEM;
-    }
+    nsrv = dns_get_servers(servers);
 
-    /* Make a socket to talk to the DNS server. */
-    if((sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
-        return EAI_SYSTEM;
+    for(i = 0; i < nq; i++)
+        qsize[i] = dns_make_query(name, qnum++, qtypes[i], qb[i]);
 
-    /* "Connect" the socket to the DNS server's address. */
-    raddr = (net_default_dev->dns[0] << 24) | (net_default_dev->dns[1] << 16) |
-            (net_default_dev->dns[2] << 8) | net_default_dev->dns[3];
+    mutex_unlock(&dns_mutex);
 
-    memset(&toaddr, 0, sizeof(toaddr));
-    toaddr.sin_family = AF_INET;
-    toaddr.sin_port = htons(53);
-    toaddr.sin_addr.s_addr = htonl(raddr);
+    if(!nsrv) {
+        dns_fail(res, nq, EAI_FAIL, 0);
+        return;
+    }
 
-    if(connect(sock, (struct sockaddr *)&toaddr, sizeof(toaddr))) {
-        close(sock);
-        return EAI_SYSTEM;
+    if(qsize[0] < 0) {
+        dns_fail(res, nq, EAI_NONAME, 0);
+        return;
     }
 
+    /* Make a socket to talk to the DNS servers. */
+    if((sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+        dns_fail(res, nq, EAI_SYSTEM, errno);
+        return;
+    }
+
+    /* If we never actually get a response, then there's probably a problem
+       with the server on the other end. EAI_SYSTEM + ETIMEDOUT makes the most
+       sense, since that's really what happened... */
+    dns_fail(res, nq, EAI_SYSTEM, ETIMEDOUT);
+
     /* Set up the structure we'll use to feed to the poll function. */
     pfd.fd = sock;
     pfd.events = POLLIN;
     pfd.revents = 0;
 
-    for(tries = 0; tries < DNS_ATTEMPTS; ++tries) {
-        /* Send the query to the server. */
-        if(send(sock, qb, size, 0) < 0) {
-            return EAI_SYSTEM;
+    memset(&toaddr, 0, sizeof(toaddr));
+    toaddr.sin_family = AF_INET;
+    toaddr.sin_port = htons(53);
+
+    pending = (1 << nq) - 1;
+    attempts = nsrv > DNS_ATTEMPTS ? nsrv : DNS_ATTEMPTS;
+
+    for(tries = 0; tries < attempts && pending; ++tries) {
+        if(tries && nsrv > 1)
+            ++failovers;
+
+        /* Send the queries that haven't been answered yet to the server. */
+        toaddr.sin_addr.s_addr =
+            htonl(net_ipv4_address(servers[tries % nsrv]));
+
+        for(i = 0; i < nq; i++) {
+            if(!(pending & (1 << i)))
+                continue;
+
+            if(sendto(sock, qb[i], qsize[i], 0, (struct sockaddr *)&toaddr,
+                      sizeof(toaddr)) < 0) {
+                res[i].err = errno;
+                pending &= ~(1 << i);
+                continue;
+            }
+
+            ++sent;
         }
 
-        /* Wait for the timeout to expire or for us to get the response. */
-        if(poll(&pfd, 1, DNS_TIMEOUT) == 1) {
-            /* Get the response. */
-            if((rsize = recv(sock, qb, 512, 0)) < 0) {
-                return EAI_SYSTEM;
+        /* Wait for the timeout to expire or for each of them to get a
+           response. A late response from a server that was asked earlier is
+           just as good as one from the current server. */
+        answered = 0;
+        deadline = timer_ms_gettime64() + DNS_TIMEOUT;
+
+        while(pending & ~answered) {
+            now = timer_ms_gettime64();
+
+            if(now >= deadline)
+                break;
+
+            if(poll(&pfd, 1, (int)(deadline - now)) != 1)
+                continue;
+
+            fromlen = sizeof(fromaddr);
+
+            if((rsize = recvfrom(sock, rb, sizeof(rb), 0,
+                                 (struct sockaddr *)&fromaddr,
+                                 &fromlen)) < 0)
+                break;
+
+            if(fromaddr.sin_port != htons(53))
+                continue;
+
+            for(j = 0; j < nsrv; j++) {
+                if(fromaddr.sin_addr.s_addr == htonl(net_ipv4_address(servers[j])))
+                    break;
             }
 
-            break;
+            if(j == nsrv)
+                continue;
+
+            for(i = 0; i < nq; i++) {
+                if(!(pending & (1 << i)) ||
+                   dns_parse_response(qb[i], qsize[i], qtypes[i], rb, rsize,
+                                      &tmp) < 0)
+                    continue;
+
+                res[i] = tmp;
+                answered |= 1 << i;
+
+                /* If the server failed, the next one might not. */
+                if(tmp.status != EAI_AGAIN && tmp.status != EAI_FAIL)
+                    pending &= ~(1 << i);
+
+                break;
+            }
         }
+
+        if(pending & ~answered)
+            ++timeouts;
     }
 
     /* Close the socket */
     close(sock);
 
-    /* If we never actually got a response, then there's probably a problem with
-       the server on the other end. I'm not entirely sure what to return in that
-       case, to be perfectly honest. I suppose that EAI_SYSTEM + ETIMEDOUT would
-       make the most sense, since that's really what happened... */
-    if(!rsize) {
-        errno = ETIMEDOUT;
+    mutex_lock(&dns_mutex);
+    dns_stats.queries_sent += sent;
+    dns_stats.timeouts += timeouts;
+    dns_stats.failovers += failovers;
+    mutex_unlock(&dns_mutex);
+}
+
+/* Forward declaration... */
+static struct addrinfo *add_ipv4_ai(uint32_t ip, uint16_t port,
+                                    struct addrinfo *h, struct addrinfo *tail);
+static struct addrinfo *add_ipv6_ai(const struct in6_addr *ip, uint16_t port,
+                                    struct addrinfo *h, struct addrinfo *tail);
+
+static int getaddrinfo_dns(const char *name, struct addrinfo *hints,
+                           uint16_t port, struct addrinfo **res) {
+    char qname[DNS_NAME_MAX + 1];
+    uint16_t qtypes[2], missing[2];
+    dns_result_t results[2], fresh[2];
+    int nq = 0, nmiss = 0, idx[2], i, j, rv;
+    struct addrinfo *ptr = NULL;
+    uint32_t ip4;
+    struct in6_addr ip6;
+    size_t len;
+    uint64 now;
+
+    /* Names are always treated as fully qualified, so a trailing dot doesn't
+       change anything. */
+    len = strlen(name);
+
+    if(len && name[len - 1] == '.')
+        --len;
+
+    if(!len || len > DNS_NAME_MAX)
+        return EAI_NONAME;
+
+    memcpy(qname, name, len);
+    qname[len] = 0;
+
+    /* Which types of records do we need? */
+    if(hints->ai_family == AF_INET || hints->ai_family == AF_UNSPEC)
+        qtypes[nq++] = QTYPE_A;
+
+    if(hints->ai_family == AF_INET6 || hints->ai_family == AF_UNSPEC)
+        qtypes[nq++] = QTYPE_AAAA;
+
+    if(!nq) {
+        errno = EAFNOSUPPORT;
         return EAI_SYSTEM;
     }
 
-    /* Parse the response. */
-    rv = dns_parse_response((dnsmsg_t *)qb, hints, port, res);
+    /* Answer what we can out of the cache, and ask the servers for the rest.
+       It seems that some resolvers really don't like multi-part questions, so
+       the A and AAAA queries are sent as separate messages. */
+    mutex_lock(&dns_mutex);
+    now = timer_ms_gettime64();
+
+    for(i = 0; i < nq; i++) {
+        if(dns_cache_find(qname, qtypes[i], now, &results[i])) {
+            ++dns_stats.cache_hits;
+
+            if(results[i].status)
+                ++dns_stats.cache_neg_hits;
+        }
+        else {
+            ++dns_stats.cache_misses;
+            idx[nmiss] = i;
+            missing[nmiss++] = qtypes[i];
+        }
+    }
+
+    mutex_unlock(&dns_mutex);
+
+    if(nmiss) {
+        dns_query(qname, nmiss, missing, fresh);
+
+        mutex_lock(&dns_mutex);
+        now = timer_ms_gettime64();
 
-    /* If we got something in the result, but got an error value in the return,
-       free whatever we got. */
-    if(rv != 0 && *res) {
-        freeaddrinfo(*res);
-        *res = NULL;
+        for(i = 0; i < nmiss; i++) {
+            results[idx[i]] = fresh[i];
+            dns_cache_add(qname, missing[i], now, &fresh[i]);
+        }
+
+        mutex_unlock(&dns_mutex);
     }
 
+    /* Build up the list, with the IPv4 addresses first. */
+    for(i = 0; i < nq; i++) {
+        for(j = 0; j < results[i].count; j++) {
+            if(qtypes[i] == QTYPE_A) {
+                memcpy(&ip4, results[i].addrs[j], 4);
+                ptr = add_ipv4_ai(ip4, port, hints, ptr);
+            }
+            else {
+                memcpy(ip6.s6_addr, results[i].addrs[j], 16);
+                ptr = add_ipv6_ai(&ip6, port, hints, ptr);
+            }
+
+            /* If something goes wrong in here, it's in calling malloc, so it
+               is definitely a system error. */
+            if(!ptr) {
+                freeaddrinfo(*res);
+                *res = NULL;
+                return EAI_SYSTEM;
+            }
+
+            if(!*res)
+                *res = ptr;
+        }
+    }
+
+    if(*res)
+        return 0;
+
+    /* Nothing was found. Unless something went wrong along the way, that's
+       because the name doesn't exist. */
+    rv = EAI_NONAME;
+
+    for(i = 0; i < nq; i++) {
+        if(results[i].status && results[i].status != EAI_NONAME) {
+            rv = results[i].status;
+
+            if(rv == EAI_SYSTEM)
+                errno = results[i].err;
+
+            break;
+        }
+    }
+
+    return rv;
+}
+
+net_dns_stats_t net_dns_get_stats(void) {
+    net_dns_stats_t rv;
+    uint64 now;
+    int i;
+
+    mutex_lock(&dns_mutex);
+    now = timer_ms_gettime64();
+    rv = dns_stats;
+    rv.entries = 0;
+
+    for(i = 0; i < NET_DNS_CACHE_ENTRIES; i++) {
+        if(dns_cache[i].expires > now)
+            ++rv.entries;
+    }
+
+    mutex_unlock(&dns_mutex);
+
     return rv;
 }
 
+void net_dns_flush(void) {
+    int i;
+
+    mutex_lock(&dns_mutex);
+
+    for(i = 0; i < NET_DNS_CACHE_ENTRIES; i++)
+        dns_cache[i].expires = 0;
+
+    mutex_unlock(&dns_mutex);
+}
+
+int net_dns_set_servers(const uint8 servers[][4], int count) {
+    int i;
+
+    if(count < 0 || count > NET_DNS_MAX_SERVERS || (count && !servers)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mutex_lock(&dns_mutex);
+    dns_server_count = 0;
+
+    /* Skip over any unset addresses. */
+    for(i = 0; i < count; i++) {
+        if(net_ipv4_address(servers[i]))
+            memcpy(dns_servers[dns_server_count++], servers[i], 4);
+    }
+
+    mutex_unlock(&dns_mutex);
+
+    return 0;
+}
+
 /* New stuff below here... */
 
 static struct addrinfo *add_ipv4_ai(uint32_t ip, uint16_t port,
@@ -730,45 +1008,5 @@ int getaddrinfo(const char *nodename, const char *servname,
     }
 
     /* If we've gotten this far, do the lookup. */
-    if(ihints.ai_family == AF_UNSPEC) {
-        /* It seems that some resolvers really don't like multi-part questions.
-           So, make sure we only ever send one part at a time... */
-        struct addrinfo *res1 = NULL, *res2 = NULL;
-        int rv;
-
-        ihints.ai_family = AF_INET;
-        rv = getaddrinfo_dns(nodename, &ihints, port, &res1);
-
-        if(rv && rv != EAI_NONAME)
-            return rv;
-
-        ihints.ai_family = AF_INET6;
-        getaddrinfo_dns(nodename, &ihints, port, &res2);
-
-        /* Figure out what to do with the result(s). */
-        if(res1 && res2) {
-            *res = res1;
-
-            /* Go to the end of the chain. */
-            while(res1->ai_next) {
-                res1 = res1->ai_next;
-            }
-
-            res1->ai_next = res2;
-            return 0;
-        }
-        else if(res1) {
-            *res = res1;
-            return 0;
-        }
-        else if(res2) {
-            *res = res2;
-            return 0;
-        }
-        else {
-            return EAI_NONAME;
-        }
-    }
-
     return getaddrinfo_dns(nodename, &ihints, port, res);
 }
@@ -0,0 +1,577 @@
+/* KallistiOS ##version##
+
+   kernel/mm/tlsf.c
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/* This file implements a Two-Level Segregated Fit allocator, as described in
+   "TLSF: a New Dynamic Memory Allocator for Real-Time Systems" (Masmano et
+   al., 2004), for memory pools that are only described by their addresses.
+
+   Free blocks are kept in lists segregated by size: the first level splits
+   sizes by powers of two, and the second level splits each power of two into
+   SL_COUNT linear ranges. A bitmap per level tells which lists are non-empty,
+   so finding a free block large enough for a request is a couple of bit scans.
+
+   Unlike a regular heap, block headers can't be stored in front of the blocks
+   themselves, so each block is described by a separate descriptor in main
+   RAM. Descriptors are linked in address order to find neighbours when
+   merging, and allocated ones are hashed by address so that they can be found
+   again when they are freed.
+
+   This file must not depend on anything but the C library, so that it can be
+   built on the host. */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kos/tlsf.h>
+
+/* Number of second-level lists per first-level list, as a power of two */
+#define SL_BITS     4
+#define SL_COUNT    (1 << SL_BITS)
+
+/* Block sizes are handled in granules and stored on 32 bits */
+#define FL_COUNT    (32 - SL_BITS + 1)
+
+/* Number of block descriptors allocated at once */
+#define DESC_CHUNK  64
+
+/* Initial number of hash buckets, as a power of two */
+#define HASH_BITS   6
+
+typedef struct tlsf_block {
+    uintptr_t addr;
+    size_t size;
+    bool used;
+
+    /* Alignment the block was allocated with, kept when compacting */
+    size_t align;
+
+    /* Neighbours in address order */
+    struct tlsf_block *prev_phys, *next_phys;
+
+    /* Free list links for free blocks; for allocated blocks, next is the
+       hash chain link and prev is unused. */
+    struct tlsf_block *prev, *next;
+} tlsf_block_t;
+
+typedef struct desc_chunk {
+    struct desc_chunk *next;
+    tlsf_block_t blocks[DESC_CHUNK];
+} desc_chunk_t;
+
+struct tlsf_pool {
+    uintptr_t base;
+    size_t size;
+    unsigned int shift;
+
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[FL_COUNT];
+    tlsf_block_t *lists[FL_COUNT][SL_COUNT];
+
+    /* Allocated blocks, hashed by address */
+    tlsf_block_t **hash;
+    unsigned int hash_bits;
+    size_t used_blocks;
+
+    /* Lowest block of the pool, in address order */
+    tlsf_block_t *first;
+
+    /* Unused block descriptors, linked through next */
+    tlsf_block_t *spare;
+    size_t spare_count;
+    desc_chunk_t *chunks;
+};
+
+static inline unsigned int tlsf_fls(uint32_t x) {
+    return 31 - __builtin_clz(x);
+}
+
+static inline unsigned int tlsf_ffs(uint32_t x) {
+    return __builtin_ctz(x);
+}
+
+/* Get the list indices for a free block of the given size in granules. */
+static void tlsf_mapping(uint32_t units, unsigned int *fl, unsigned int *sl) {
+    unsigned int f;
+
+    if(units < SL_COUNT) {
+        *fl = 0;
+        *sl = units;
+    }
+    else {
+        f = tlsf_fls(units);
+        *sl = (units >> (f - SL_BITS)) ^ SL_COUNT;
+        *fl = f - SL_BITS + 1;
+    }
+}
+
+static tlsf_block_t *desc_get(tlsf_pool_t *pool) {
+    tlsf_block_t *b = pool->spare;
+
+    pool->spare = b->next;
+    pool->spare_count--;
+
+    return b;
+}
+
+static void desc_put(tlsf_pool_t *pool, tlsf_block_t *b) {
+    b->next = pool->spare;
+    pool->spare = b;
+    pool->spare_count++;
+}
+
+/* Make sure that at least count descriptors can be taken with desc_get(). */
+static int desc_reserve(tlsf_pool_t *pool, size_t count) {
+    desc_chunk_t *chunk;
+    size_t i;
+
+    if(pool->spare_count >= count)
+        return 0;
+
+    chunk = malloc(sizeof(desc_chunk_t));
+    if(!chunk)
+        return -1;
+
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+
+    for(i = 0; i < DESC_CHUNK; i++)
+        desc_put(pool, &chunk->blocks[i]);
+
+    return 0;
+}
+
+static inline size_t hash_index(const tlsf_pool_t *pool, uintptr_t addr) {
+    uint32_t key = (uint32_t)(addr >> pool->shift);
+
+    return (uint32_t)(key * 2654435761u) >> (32 - pool->hash_bits);
+}
+
+static tlsf_block_t **hash_lookup(const tlsf_pool_t *pool, uintptr_t addr) {
+    tlsf_block_t **link = &pool->hash[hash_index(pool, addr)];
+
+    while(*link && (*link)->addr != addr)
+        link = &(*link)->next;
+
+    return link;
+}
+
+/* Double the number of buckets. Failing to do so only makes lookups slower,
+   so errors are ignored. */
+static void hash_grow(tlsf_pool_t *pool) {
+    size_t i, old_size = (size_t)1 << pool->hash_bits;
+    tlsf_block_t **old = pool->hash, *b, *next;
+
+    if(pool->hash_bits == 24)
+        return;
+
+    pool->hash = calloc(old_size * 2, sizeof(tlsf_block_t *));
+    if(!pool->hash) {
+        pool->hash = old;
+        return;
+    }
+
+    pool->hash_bits++;
+
+    for(i = 0; i < old_size; i++) {
+        for(b = old[i]; b; b = next) {
+            next = b->next;
+            b->next = pool->hash[hash_index(pool, b->addr)];
+            pool->hash[hash_index(pool, b->addr)] = b;
+        }
+    }
+
+    free(old);
+}
+
+static void hash_insert(tlsf_pool_t *pool, tlsf_block_t *b) {
+    tlsf_block_t **head = &pool->hash[hash_index(pool, b->addr)];
+
+    b->next = *head;
+    *head = b;
+
+    if(++pool->used_blocks > ((size_t)2 << pool->hash_bits))
+        hash_grow(pool);
+}
+
+static void hash_remove(tlsf_pool_t *pool, tlsf_block_t *b) {
+    tlsf_block_t **link = hash_lookup(pool, b->addr);
+
+    *link = b->next;
+    pool->used_blocks--;
+}
+
+static void free_insert(tlsf_pool_t *pool, tlsf_block_t *b) {
+    unsigned int fl, sl;
+
+    tlsf_mapping(b->size >> pool->shift, &fl, &sl);
+
+    b->used = false;
+    b->prev = NULL;
+    b->next = pool->lists[fl][sl];
+
+    if(b->next)
+        b->next->prev = b;
+
+    pool->lists[fl][sl] = b;
+    pool->fl_bitmap |= 1U << fl;
+    pool->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void free_remove(tlsf_pool_t *pool, tlsf_block_t *b) {
+    unsigned int fl, sl;
+
+    tlsf_mapping(b->size >> pool->shift, &fl, &sl);
+
+    if(b->next)
+        b->next->prev = b->prev;
+
+    if(b->prev) {
+        b->prev->next = b->next;
+    }
+    else {
+        pool->lists[fl][sl] = b->next;
+
+        if(!b->next) {
+            pool->sl_bitmap[fl] &= ~(1U << sl);
+
+            if(!pool->sl_bitmap[fl])
+                pool->fl_bitmap &= ~(1U << fl);
+        }
+    }
+}
+
+/* Find a free block of at least the given size in granules. The size is
+   rounded up to the next list boundary, so that any block of the list that
+   is found is large enough. */
+static tlsf_block_t *free_find(tlsf_pool_t *pool, uint32_t units) {
+    unsigned int fl, sl;
+    uint32_t map;
+
+    if(units >= SL_COUNT)
+        units += (1U << (tlsf_fls(units) - SL_BITS)) - 1;
+
+    tlsf_mapping(units, &fl, &sl);
+
+    map = pool->sl_bitmap[fl] & (~0U << sl);
+
+    if(!map) {
+        map = pool->fl_bitmap & (~0U << (fl + 1));
+        if(!map)
+            return NULL;
+
+        fl = tlsf_ffs(map);
+        map = pool->sl_bitmap[fl];
+    }
+
+    return pool->lists[fl][tlsf_ffs(map)];
+}
+
+/* Split off the end of a block, starting at the given offset. The new block
+   is returned, and is not in any list. */
+static tlsf_block_t *block_split(tlsf_pool_t *pool, tlsf_block_t *b,
+                                 size_t offset) {
+    tlsf_block_t *n = desc_get(pool);
+
+    n->addr = b->addr + offset;
+    n->size = b->size - offset;
+    n->prev_phys = b;
+    n->next_phys = b->next_phys;
+
+    if(n->next_phys)
+        n->next_phys->prev_phys = n;
+
+    b->size = offset;
+    b->next_phys = n;
+
+    return n;
+}
+
+/* Merge a block into its lower neighbour, and release its descriptor. */
+static void block_merge(tlsf_pool_t *pool, tlsf_block_t *b, tlsf_block_t *n) {
+    b->size += n->size;
+    b->next_phys = n->next_phys;
+
+    if(n->next_phys)
+        n->next_phys->prev_phys = b;
+
+    desc_put(pool, n);
+}
+
+static void tlsf_init_blocks(tlsf_pool_t *pool) {
+    tlsf_block_t *b = desc_get(pool);
+
+    memset(pool->lists, 0, sizeof(pool->lists));
+    memset(pool->sl_bitmap, 0, sizeof(pool->sl_bitmap));
+    pool->fl_bitmap = 0;
+
+    b->addr = pool->base;
+    b->size = pool->size;
+    b->prev_phys = b->next_phys = NULL;
+
+    pool->first = b;
+    free_insert(pool, b);
+}
+
+tlsf_pool_t *tlsf_create(uintptr_t base, size_t size, size_t granule) {
+    tlsf_pool_t *pool;
+
+    if(!base || !granule || (granule & (granule - 1)) ||
+       (base & (granule - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size &= ~(granule - 1);
+
+    if(!size || (uint32_t)(size / granule) != size / granule) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pool = calloc(1, sizeof(tlsf_pool_t));
+    if(!pool)
+        goto out_nomem;
+
+    pool->base = base;
+    pool->size = size;
+    pool->shift = tlsf_fls(granule);
+    pool->hash_bits = HASH_BITS;
+
+    pool->hash = calloc((size_t)1 << HASH_BITS, sizeof(tlsf_block_t *));
+    if(!pool->hash || desc_reserve(pool, 1)) {
+        tlsf_destroy(pool);
+        goto out_nomem;
+    }
+
+    tlsf_init_blocks(pool);
+
+    return pool;
+
+out_nomem:
+    errno = ENOMEM;
+    return NULL;
+}
+
+void tlsf_destroy(tlsf_pool_t *pool) {
+    desc_chunk_t *chunk, *next;
+
+    if(!pool)
+        return;
+
+    for(chunk = pool->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+
+    free(pool->hash);
+    free(pool);
+}
+
+void tlsf_reset(tlsf_pool_t *pool) {
+    tlsf_block_t *b, *next;
+
+    for(b = pool->first; b; b = next) {
+        next = b->next_phys;
+        desc_put(pool, b);
+    }
+
+    memset(pool->hash, 0, sizeof(tlsf_block_t *) << pool->hash_bits);
+    pool->used_blocks = 0;
+
+    tlsf_init_blocks(pool);
+}
+
+uintptr_t tlsf_alloc(tlsf_pool_t *pool, size_t size, size_t align) {
+    size_t granule = (size_t)1 << pool->shift;
+    size_t need, gap;
+    tlsf_block_t *b;
+
+    if(!align)
+        align = granule;
+
+    if(!size || (align & (align - 1))) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    if(align < granule)
+        align = granule;
+
+    if(size > pool->size || align > pool->size)
+        goto out_nomem;
+
+    size = (size + granule - 1) & ~(granule - 1);
+
+    /* Over-allocate so that an aligned block fits anywhere in the free one */
+    need = size + align - granule;
+
+    /* Splitting needs up to two descriptors, get them now so that failing to
+       allocate them can't leave the pool in a weird state. */
+    if(need > pool->size || desc_reserve(pool, 2))
+        goto out_nomem;
+
+    b = free_find(pool, need >> pool->shift);
+    if(!b)
+        goto out_nomem;
+
+    free_remove(pool, b);
+
+    gap = ((b->addr + align - 1) & ~(align - 1)) - b->addr;
+    if(gap) {
+        tlsf_block_t *n = block_split(pool, b, gap);
+
+        free_insert(pool, b);
+        b = n;
+    }
+
+    if(b->size > size)
+        free_insert(pool, block_split(pool, b, size));
+
+    b->used = true;
+    b->align = align;
+    hash_insert(pool, b);
+
+    return b->addr;
+
+out_nomem:
+    errno = ENOMEM;
+    return 0;
+}
+
+int tlsf_free(tlsf_pool_t *pool, uintptr_t addr) {
+    tlsf_block_t **link = hash_lookup(pool, addr);
+    tlsf_block_t *b = *link, *n;
+
+    if(!b) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *link = b->next;
+    pool->used_blocks--;
+
+    /* Merge with the free neighbours right away */
+    n = b->prev_phys;
+    if(n && !n->used) {
+        free_remove(pool, n);
+        block_merge(pool, n, b);
+        b = n;
+    }
+
+    n = b->next_phys;
+    if(n && !n->used) {
+        free_remove(pool, n);
+        block_merge(pool, b, n);
+    }
+
+    free_insert(pool, b);
+
+    return 0;
+}
+
+size_t tlsf_block_size(const tlsf_pool_t *pool, uintptr_t addr) {
+    tlsf_block_t *b = *hash_lookup(pool, addr);
+
+    return b ? b->size : 0;
+}
+
+void tlsf_get_stats(const tlsf_pool_t *pool, tlsf_stats_t *stats) {
+    const tlsf_block_t *b;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->total = pool->size;
+
+    for(b = pool->first; b; b = b->next_phys) {
+        if(b->used) {
+            stats->used += b->size;
+            stats->used_blocks++;
+        }
+        else {
+            stats->free += b->size;
+            stats->free_blocks++;
+
+            if(b->size > stats->largest_free)
+                stats->largest_free = b->size;
+        }
+    }
+
+    if(stats->free)
+        stats->fragmentation = 100 - (unsigned int)
+            ((unsigned long long)stats->largest_free * 100 / stats->free);
+}
+
+size_t tlsf_compact(tlsf_pool_t *pool, tlsf_move_t move, void *data,
+                    tlsf_remap_t *remap, size_t max) {
+    tlsf_block_t *b, *f, *n;
+    uintptr_t to;
+    size_t count = 0;
+
+    for(b = pool->first; b && count < max; b = n) {
+        n = b->next_phys;
+        f = b->prev_phys;
+
+        if(!b->used || !f || f->used)
+            continue;
+
+        /* Move the block as far down the hole before it as its alignment
+           allows. If that isn't the start of the hole, what is left below
+           the block stays free, which takes a descriptor of its own. */
+        to = (f->addr + b->align - 1) & ~(b->align - 1);
+
+        if(to == b->addr)
+            continue;
+
+        if(to != f->addr && desc_reserve(pool, 1))
+            break;
+
+        if(move(to, b->addr, b->size, data))
+            break;
+
+        remap[count].from = b->addr;
+        remap[count].to = to;
+        remap[count].size = b->size;
+        count++;
+
+        free_remove(pool, f);
+        hash_remove(pool, b);
+
+        if(to != f->addr) {
+            f = block_split(pool, f, to - f->addr);
+            free_insert(pool, f->prev_phys);
+        }
+
+        b->addr = f->addr;
+        f->addr = b->addr + b->size;
+
+        /* Swap the two blocks in the address order list */
+        b->prev_phys = f->prev_phys;
+        if(b->prev_phys)
+            b->prev_phys->next_phys = b;
+        else
+            pool->first = b;
+
+        b->next_phys = f;
+        f->prev_phys = b;
+        f->next_phys = n;
+        if(n)
+            n->prev_phys = f;
+
+        hash_insert(pool, b);
+
+        /* The hole moved up, and may now touch another one */
+        if(n && !n->used) {
+            free_remove(pool, n);
+            block_merge(pool, f, n);
+        }
+
+        free_insert(pool, f);
+        n = f->next_phys;
+    }
+
+    return count;
+}
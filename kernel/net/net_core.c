@@ -4,6 +4,7 @@
 
    Copyright (C) 2002 Megan Potter
    Copyright (C) 2005, 2013 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <string.h>
@@ -13,6 +14,10 @@
 #include <kos/net.h>
 #include <kos/fs_socket.h>
 #include <kos/dbglog.h>
+#include <kos/genwait.h>
+#include <kos/opts.h>
+#include <kos/thread.h>
+#include <arch/irq.h>
 
 #include "net_dhcp.h"
 #include "net_thd.h"
@@ -43,6 +48,8 @@ static int net_initted = 0;
 /* Default net device */
 netif_t *net_default_dev = NULL;
 
+static void net_poll_cancel(netif_t *device);
+
 /**************************************************************************/
 /* Driver list management
    Note that this stuff might be used before net_core is actually
@@ -83,6 +90,9 @@ int net_unreg_device(netif_t *device) {
         return -1;
     }
 
+    /* Don't poll it any more */
+    net_poll_cancel(device);
+
     /* Remove it from the list */
     LIST_REMOVE(device, if_list);
 
@@ -97,6 +107,191 @@ struct netif_list * net_get_if_list(void) {
     return &net_if_list;
 }
 
+/*****************************************************************************/
+/* Receive polling
+
+   Devices that use this mask their receive interrupt and call
+   net_poll_schedule(), which queues them up for the polling thread. The thread
+   takes each queued device in turn and has it pass up to NET_POLL_BUDGET
+   frames up the stack. A device that still has frames waiting afterwards goes
+   back on the end of the queue, and the thread yields before carrying on, so
+   that one busy device can't hold up the others or the program. The device
+   leaves the queue by calling net_poll_complete(), and unmasks its interrupt
+   again.
+
+   The queue is only touched with interrupts disabled, as devices are
+   scheduled from their interrupt handlers. */
+
+#define POLL_IDLE       0   /* Not scheduled */
+#define POLL_QUEUED     1   /* Waiting in the queue */
+#define POLL_RUNNING    2   /* Taken off the queue, and being polled */
+
+static netif_t *poll_head, *poll_tail;
+static kthread_t *poll_thd;
+static bool poll_quit;
+
+static void poll_enqueue(netif_t *device) {
+    device->poll_state = POLL_QUEUED;
+    device->poll_next = NULL;
+
+    if(poll_tail)
+        poll_tail->poll_next = device;
+    else
+        poll_head = device;
+
+    poll_tail = device;
+}
+
+static void poll_remove(netif_t *device) {
+    netif_t *cur, *prev = NULL;
+
+    for(cur = poll_head; cur; prev = cur, cur = cur->poll_next) {
+        if(cur != device)
+            continue;
+
+        if(prev)
+            prev->poll_next = cur->poll_next;
+        else
+            poll_head = cur->poll_next;
+
+        if(poll_tail == cur)
+            poll_tail = prev;
+
+        break;
+    }
+}
+
+void net_poll_schedule(netif_t *device) {
+    irq_disable_scoped();
+
+    if(device->poll_state != POLL_IDLE)
+        return;
+
+    poll_enqueue(device);
+    genwait_wake_one(&poll_head);
+}
+
+void net_poll_complete(netif_t *device) {
+    irq_disable_scoped();
+
+    if(device->poll_state == POLL_QUEUED)
+        poll_remove(device);
+
+    device->poll_state = POLL_IDLE;
+}
+
+/* Take a device off the queue for good, waiting for the polling thread to be
+   done with it if it's being polled right now. */
+static void net_poll_cancel(netif_t *device) {
+    for(;;) {
+        {
+            irq_disable_scoped();
+
+            if(device->poll_state != POLL_RUNNING || thd_current == poll_thd) {
+                if(device->poll_state == POLL_QUEUED)
+                    poll_remove(device);
+
+                device->poll_state = POLL_IDLE;
+                return;
+            }
+        }
+
+        thd_sleep(1);
+    }
+}
+
+static void *net_poll_thd(void *data) {
+    netif_t *device;
+    bool again;
+
+    (void)data;
+
+    for(;;) {
+        {
+            irq_disable_scoped();
+
+            while(!poll_head && !poll_quit)
+                genwait_wait(&poll_head, "net_poll", 0, NULL);
+
+            if(poll_quit)
+                break;
+
+            device = poll_head;
+            poll_head = device->poll_next;
+
+            if(!poll_head)
+                poll_tail = NULL;
+
+            device->poll_state = POLL_RUNNING;
+        }
+
+        if(device->if_poll)
+            device->if_poll(device, NET_POLL_BUDGET);
+        else
+            net_poll_complete(device);
+
+        {
+            irq_disable_scoped();
+
+            again = device->poll_state == POLL_RUNNING;
+
+            if(again)
+                poll_enqueue(device);
+        }
+
+        /* Give anything else at our priority a turn before the next round */
+        if(again)
+            thd_pass();
+    }
+
+    return NULL;
+}
+
+static int net_poll_init(void) {
+    /* The default priority, so that a flood of frames gets a fair share of
+       the CPU alongside the program, and no more. */
+    kthread_attr_t attr = { false, 0, NULL, PRIO_DEFAULT, "[net_poll]" };
+
+    poll_quit = false;
+    poll_thd = thd_create_ex(&attr, net_poll_thd, NULL);
+
+    if(!poll_thd) {
+        dbglog(DBG_ERROR, "net_poll_init: can't create thread\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void net_poll_shutdown(void) {
+    netif_t *cur;
+
+    if(!poll_thd)
+        return;
+
+    {
+        irq_disable_scoped();
+
+        poll_quit = true;
+        genwait_wake_one(&poll_head);
+    }
+
+    thd_join(poll_thd, NULL);
+    poll_thd = NULL;
+
+    /* Forget about anything that was left scheduled */
+    {
+        irq_disable_scoped();
+
+        while((cur = poll_head)) {
+            poll_head = cur->poll_next;
+            cur->poll_state = POLL_IDLE;
+        }
+
+        poll_tail = NULL;
+    }
+}
+
 /*****************************************************************************/
 /* Init/shutdown */
 
@@ -149,9 +344,15 @@ int net_init(uint32 ip) {
     if(net_initted)
         return 0;
 
+    /* Start polling for received frames, before any devices start */
+    if(net_poll_init() < 0)
+        return -1;
+
     /* Detect and potentially initialize devices */
-    if(net_dev_init() < 0)
+    if(net_dev_init() < 0) {
+        net_poll_shutdown();
         return -1;
+    }
 
     /* Initialize the network thread. */
     net_thd_init();
@@ -247,6 +448,9 @@ void net_shutdown(void) {
     /* Shut down the network thread */
     net_thd_shutdown();
 
+    /* And stop polling devices for received frames */
+    net_poll_shutdown();
+
     /* Shut down all activated network devices */
     LIST_FOREACH(cur, &net_if_list, if_list) {
         if(cur->flags & NETIF_RUNNING && cur->if_stop)
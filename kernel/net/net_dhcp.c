@@ -2,6 +2,7 @@
 
    kernel/net/net_dhcp.c
    Copyright (C) 2008, 2009, 2013 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -203,6 +204,42 @@ static uint16 net_dhcp_get_16bit(dhcp_pkt_t *pkt, uint8 opt, int len) {
     return 0;
 }
 
+/* The first DNS server given to us goes on the device, but the option can hold
+   more than one. Give any others to the resolver to fall back on, replacing
+   any from an earlier lease, even if there aren't any this time. */
+static void net_dhcp_set_dns_servers(dhcp_pkt_t *pkt, int len) {
+    uint8 servers[NET_DNS_MAX_SERVERS][4];
+    int i, cnt;
+
+    len -= sizeof(dhcp_pkt_t);
+
+    for(i = 4; i < len;) {
+        if(pkt->options[i] == DHCP_OPTION_DOMAIN_NAME_SERVER) {
+            cnt = pkt->options[i + 1] / 4 - 1;
+
+            if(cnt > NET_DNS_MAX_SERVERS)
+                cnt = NET_DNS_MAX_SERVERS;
+
+            if(cnt < 1 || i + 6 + cnt * 4 > len)
+                break;
+
+            memcpy(servers, &pkt->options[i + 6], cnt * 4);
+            net_dns_set_servers((const uint8 (*)[4])servers, cnt);
+            return;
+        }
+        else if(pkt->options[i] == DHCP_OPTION_PAD) {
+            ++i;
+        }
+        else if(pkt->options[i] == DHCP_OPTION_END) {
+            break;
+        }
+        else {
+            i += pkt->options[i + 1] + 2;
+        }
+    }
+
+    net_dns_set_servers(NULL, 0);
+}
 
 int net_dhcp_request(uint32 required_address) {
     uint8 pkt[1500];
@@ -430,6 +467,7 @@ static void net_dhcp_bind(dhcp_pkt_t *pkt, int len) {
         net_default_dev->dns[1] = (tmp >> 16) & 0xFF;
         net_default_dev->dns[2] = (tmp >>  8) & 0xFF;
         net_default_dev->dns[3] = (tmp >>  0) & 0xFF;
+        net_dhcp_set_dns_servers(pkt, len);
     }
 
     /* Grab the broadcast address if it was sent to us, otherwise infer it from
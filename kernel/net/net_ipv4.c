@@ -4,6 +4,7 @@
 
    Copyright (C) 2005, 2006, 2007, 2008, 2009, 2010, 2012, 2013,
                  2016 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
    Portions adapted from KOS' old net_icmp.c file:
    Copyright (C) 2002 Megan Potter
@@ -30,11 +31,11 @@ uint16 net_ipv4_checksum(const uint8 *data, size_t bytes, uint16 start) {
     size_t i = bytes;
 
     /* Make sure we don't do any unaligned memory accesses */
-    if(((uint32)data) & 0x01) {
+    if(((uintptr_t)data) & 0x01) {
         const uint8 *ptr = data;
 
         while(i > 1) {
-            sum += *ptr | ((*ptr + 1) << 8);
+            sum += *ptr | (*(ptr + 1) << 8);
             ptr += 2;
             i -= 2;
 
@@ -65,6 +66,61 @@ uint16 net_ipv4_checksum(const uint8 *data, size_t bytes, uint16 start) {
     return sum ^ 0xFFFF;
 }
 
+/* Copy a block of data while doing an IP-style checksum on it */
+uint16 net_ipv4_checksum_copy(uint8 *dst, const uint8 *src, size_t bytes,
+                              uint16 start) {
+    uint32 sum = start;
+    size_t i = bytes;
+    union {
+        uint16 w;
+        uint8 b[2];
+    } u;
+
+    if(!(((uintptr_t)src | (uintptr_t)dst) & 0x01)) {
+        const uint16 *s = (const uint16 *)src;
+        uint16 *d = (uint16 *)dst;
+
+        while(i > 1) {
+            u.w = *s++;
+            *d++ = u.w;
+            sum += u.w;
+            i -= 2;
+
+            /* Fold the carries back in before the sum can overflow */
+            if(sum & 0x80000000)
+                sum = (sum >> 16) + (sum & 0xFFFF);
+        }
+
+        src = (const uint8 *)s;
+        dst = (uint8 *)d;
+    }
+    else {
+        while(i > 1) {
+            u.b[0] = dst[0] = src[0];
+            u.b[1] = dst[1] = src[1];
+            sum += u.w;
+            src += 2;
+            dst += 2;
+            i -= 2;
+
+            if(sum & 0x80000000)
+                sum = (sum >> 16) + (sum & 0xFFFF);
+        }
+    }
+
+    /* Handle the last byte, if we have an odd byte count */
+    if(i) {
+        u.b[0] = *dst = *src;
+        u.b[1] = 0;
+        sum += u.w;
+    }
+
+    while(sum >> 16)
+        sum = (sum >> 16) + (sum & 0xFFFF);
+
+    return (uint16)sum;
+}
+
 /* Determine if a given IP is in the current network */
 static int is_in_network(const uint8 src[4], const uint8 dest[4],
                          const uint8 netmask[4]) {
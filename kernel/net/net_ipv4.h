@@ -2,6 +2,7 @@
 
    kernel/net/net_ipv4.h
    Copyright (C) 2005, 2007, 2008, 2012, 2013 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -26,6 +27,12 @@ typedef struct {
 } __packed ipv4_pseudo_hdr_t;
 
 uint16 net_ipv4_checksum(const uint8 *data, size_t bytes, uint16 start);
+
+/* Copy bytes from src to dst, summing them on the way. This returns the sum
+   without complementing it, so it can be passed as the start value for the
+   rest of the packet. */
+uint16 net_ipv4_checksum_copy(uint8 *dst, const uint8 *src, size_t bytes,
+                              uint16 start);
 int net_ipv4_send_packet(netif_t *net, ip_hdr_t *hdr, const uint8 *data,
                          size_t size);
 int net_ipv4_send(netif_t *net, const uint8 *data, size_t size, int id, int ttl,
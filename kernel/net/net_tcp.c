@@ -2,6 +2,7 @@
 
    kernel/net/net_tcp.c
    Copyright (C) 2012, 2013 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -89,6 +90,17 @@
    65535. Some extensions may be implemented in the future, if I see fit to do
    so. That all said, everything in here works just fine over IPv4 or IPv6, and
    can be used just fine to communicate with "normal" TCP/IP implementations.
+
+   On reordering and ACKs:
+   Segments that arrive ahead of a hole are copied straight into their place in
+   the receive buffer, beyond its tail, and the ranges they cover are kept in a
+   small sorted list (TCP_OOO_MAX long). Once the hole is filled, the tail just
+   moves forward over them. ACKs for in-order data are delayed as RFC 1122
+   allows: every second segment is ACKed right away, and a lone one after
+   TCP_DELACK_TIME, unless data going the other way carries the ACK first.
+   Segments out of order, and those that fill a hole, are ACKed at once so the
+   other side can retransmit quickly. Sending uses Nagle's algorithm unless
+   TCP_NODELAY is set.
 */
 
 typedef struct tcp_hdr {
@@ -133,6 +145,15 @@ struct rcvrec {
     uint32_t irs;
 };
 
+/* A range of sequence space received out of order */
+struct tcp_ooo {
+    uint32_t seq;
+    uint32_t end;
+};
+
+/* Maximum number of separate ranges of out-of-order data kept per socket */
+#define TCP_OOO_MAX         8
+
 struct tcp_sock {
     LIST_ENTRY(tcp_sock) sock_list;
     struct sockaddr_in6 local_addr;
@@ -171,6 +192,9 @@ struct tcp_sock {
             uint32_t sndbuf_acked;
             uint32_t sndbuf_tail;
             uint64_t timer;
+            uint64_t ack_timer;
+            struct tcp_ooo ooo[TCP_OOO_MAX];
+            int ooo_count;
             condvar_t send_cv;
             condvar_t recv_cv;
         } data;
@@ -200,6 +224,10 @@ static int thd_cb_id = 0;
 /* Default hop limit (or ttl for IPv4) for new sockets */
 #define TCP_DEFAULT_HOPS    64
 
+/* Longest that an ACK for in-order data is held back (in milliseconds). RFC
+   1122 allows up to 500, but the net_thd callback only runs every 50 anyway. */
+#define TCP_DELACK_TIME     100
+
 /* Flags that can be set in the off_flags field of the above struct */
 #define TCP_FLAG_FIN    0x01
 #define TCP_FLAG_SYN    0x02
@@ -230,6 +258,8 @@ static int thd_cb_id = 0;
 #define TCP_IFLAG_CANBEDEL      0x00000001
 #define TCP_IFLAG_QUEUEDCLOSE   0x00000002
 #define TCP_IFLAG_ACCEPTWAIT    0x00000004
+#define TCP_IFLAG_NODELAY       0x00000008
+#define TCP_IFLAG_DELACK        0x00000010
 
 #define TCP_OPT_EOL             0
 #define TCP_OPT_NOP             1
@@ -449,7 +479,8 @@ ret_remove:
 
 ret_no_remove:
     if(sock->state != TCP_STATE_LISTEN)
-        sock->intflags = TCP_IFLAG_CANBEDEL;
+        sock->intflags = TCP_IFLAG_CANBEDEL |
+            (sock->intflags & (TCP_IFLAG_NODELAY | TCP_IFLAG_DELACK));
 
     if(sock->state == TCP_STATE_ESTABLISHED ||
             sock->state == TCP_STATE_CLOSE_WAIT)
@@ -610,6 +641,7 @@ static int net_tcp_accept(net_socket_t *hnd, struct sockaddr *addr,
     sock2->rcvbuf_sz = sock->rcvbuf_sz;
     sock2->sndbuf_sz = sock->sndbuf_sz;
     sock2->data.rcv.wnd = sock->rcvbuf_sz;
+    sock2->intflags = sock->intflags & TCP_IFLAG_NODELAY;
 
     /* Fill in the address, if they asked for it. */
     if(addr != NULL) {
@@ -1276,8 +1308,9 @@ static ssize_t net_tcp_recvfrom(net_socket_t *hnd, void *buffer, size_t length,
             sock->data.rcvbuf_head = size - tmp;
     }
 
-    /* If we've got nothing left, move the pointers back to the beginning */
-    if(!sock->data.rcvbuf_cur_sz) {
+    /* If we've got nothing left, move the pointers back to the beginning,
+       unless there's out-of-order data sitting past the tail. */
+    if(!sock->data.rcvbuf_cur_sz && !sock->data.ooo_count) {
         sock->data.rcvbuf_head = sock->data.rcvbuf_tail = 0;
     }
 
@@ -1539,7 +1572,7 @@ static int net_tcp_getsockopt(net_socket_t *hnd, int level, int option_name,
         case IPPROTO_TCP:
             switch(option_name) {
                 case TCP_NODELAY:
-                    tmp = 1;
+                    tmp = !!(sock->intflags & TCP_IFLAG_NODELAY);
                     goto copy_int;
             }
 
@@ -1612,6 +1645,9 @@ static int net_tcp_setsockopt(net_socket_t *hnd, int level, int option_name,
 
                     sock->data.rcvbuf = new_ptr;
                     sock->rcvbuf_sz = tmp;
+
+                    /* Anything out of order will just have to be resent. */
+                    sock->data.ooo_count = 0;
                     goto ret_success;
 
                 case SO_SNDBUF:
@@ -1704,8 +1740,19 @@ static int net_tcp_setsockopt(net_socket_t *hnd, int level, int option_name,
 
                     tmp = *((int *)option_value);
 
-                    if(tmp == 0)
-                        goto ret_inval;
+                    if(!tmp) {
+                        sock->intflags &= ~TCP_IFLAG_NODELAY;
+                        goto ret_success;
+                    }
+
+                    sock->intflags |= TCP_IFLAG_NODELAY;
+
+                    /* Push out anything that Nagle's algorithm was holding. */
+                    if((sock->state == TCP_STATE_ESTABLISHED ||
+                        sock->state == TCP_STATE_CLOSE_WAIT) &&
+                       sock->data.sndbuf_cur_sz !=
+                       sock->data.snd.nxt - sock->data.snd.una)
+                        tcp_send_data(sock, 0);
 
                     goto ret_success;
             }
@@ -2120,6 +2167,7 @@ static void tcp_send_fin_ack(struct tcp_sock *sock) {
                                   sizeof(tcp_hdr_t), IPPROTO_TCP);
     hdr->checksum = net_ipv4_checksum(rawpkt, sizeof(tcp_hdr_t), cs);
 
+    sock->intflags &= ~TCP_IFLAG_DELACK;
     net_ipv6_send(sock->data.net, rawpkt, sizeof(tcp_hdr_t), sock->hop_limit,
                   IPPROTO_TCP, &sock->local_addr.sin6_addr,
                   &sock->remote_addr.sin6_addr);
@@ -2145,6 +2193,7 @@ static void tcp_send_ack(struct tcp_sock *sock) {
                                  sizeof(tcp_hdr_t), IPPROTO_TCP);
     hdr.checksum = net_ipv4_checksum((const uint8 *)&hdr, sizeof(tcp_hdr_t), c);
 
+    sock->intflags &= ~TCP_IFLAG_DELACK;
     net_ipv6_send(sock->data.net, (const uint8 *)&hdr, sizeof(tcp_hdr_t),
                   sock->hop_limit, IPPROTO_TCP, &sock->local_addr.sin6_addr,
                   &sock->remote_addr.sin6_addr);
@@ -2155,14 +2204,16 @@ static void tcp_send_data(struct tcp_sock *sock, int resend) {
     int sz = sizeof(tcp_hdr_t);
     uint8_t rawpkt[1500];
     tcp_hdr_t *hdr = (tcp_hdr_t *)rawpkt;
-    uint16_t cs;
+    uint16_t cs, cs2;
     uint8_t *sb, *buf;
-    uint32_t seq, unacked, head;
+    uint32_t seq, unacked, head, part, tmp;
+    uint32_t seg = sock->data.snd.mss - sizeof(tcp_hdr_t);
+    int sent = 0;
 
     if(!resend) {
         seq = sock->data.snd.nxt;
         unacked = sock->data.snd.nxt - sock->data.snd.una;
-        wnd -= unacked;
+        wnd = wnd > unacked ? wnd - unacked : 0;
         head = sock->data.sndbuf_head;
     }
     else {
@@ -2190,44 +2241,67 @@ static void tcp_send_data(struct tcp_sock *sock, int resend) {
         sb = sock->data.sndbuf + head;
         snd = wnd;
 
-        if(snd > sock->data.snd.mss - sizeof(tcp_hdr_t))
-            snd = sock->data.snd.mss - sizeof(tcp_hdr_t);
+        if(snd > seg)
+            snd = seg;
 
         if(snd > sock->data.sndbuf_cur_sz - unacked)
             snd = sock->data.sndbuf_cur_sz - unacked;
 
-        /* Copy in the data */
+        /* Nagle's algorithm (RFC 896): while anything is still unacknowledged,
+           hold back a segment smaller than the MSS until an ACK comes in. */
+        if(!resend && snd < seg && unacked &&
+           !(sock->intflags & TCP_IFLAG_NODELAY))
+            break;
+
+        sz = snd + sizeof(tcp_hdr_t);
+        cs = net_ipv6_checksum_pseudo(&sock->local_addr.sin6_addr,
+                                      &sock->remote_addr.sin6_addr, sz,
+                                      IPPROTO_TCP);
+
+        /* Copy in the data, checksumming it as we go */
         if(head + snd <= sock->sndbuf_sz) {
-            memcpy(buf, sb, snd);
+            cs = net_ipv4_checksum_copy(buf, sb, snd, cs);
             head += snd;
 
             if(head == sock->sndbuf_sz)
                 head = 0;
         }
         else {
-            sz = sock->sndbuf_sz - head;
-            memcpy(buf, sb, sz);
-            memcpy(buf + sz, sock->data.sndbuf, snd - sz);
-            head = snd - sz;
+            part = sock->sndbuf_sz - head;
+            cs = net_ipv4_checksum_copy(buf, sb, part, cs);
+            cs2 = net_ipv4_checksum_copy(buf + part, sock->data.sndbuf,
+                                         snd - part, 0);
+
+            /* If the first part was an odd length, the second one's bytes
+               fall in the other half of each 16-bit word. */
+            if(part & 1)
+                cs2 = (cs2 << 8) | (cs2 >> 8);
+
+            tmp = cs + cs2;
+            cs = (tmp & 0xFFFF) + (tmp >> 16);
+            head = snd - part;
         }
 
-        sz = snd + sizeof(tcp_hdr_t);
         wnd -= snd;
         seq += snd;
         unacked += snd;
 
-        /* Calculate the checksum */
-        cs = net_ipv6_checksum_pseudo(&sock->local_addr.sin6_addr,
-                                      &sock->remote_addr.sin6_addr, sz,
-                                      IPPROTO_TCP);
-        hdr->checksum = net_ipv4_checksum(rawpkt, sz, cs);
+        /* Finish the checksum off with the header */
+        hdr->checksum = net_ipv4_checksum(rawpkt, sizeof(tcp_hdr_t), cs);
 
+        /* This carries the ACK for anything we were holding one back for. */
+        sock->intflags &= ~TCP_IFLAG_DELACK;
         net_ipv6_send(sock->data.net, rawpkt, sz, sock->hop_limit, IPPROTO_TCP,
                       &sock->local_addr.sin6_addr,
                       &sock->remote_addr.sin6_addr);
+        sent = 1;
     }
 
-    sock->data.timer = timer_ms_gettime64();
+    /* Only restart the retransmission timer if something actually went out,
+       otherwise holding back a small segment would keep pushing it back. */
+    if(sent)
+        sock->data.timer = timer_ms_gettime64();
+
     sock->data.sndbuf_head = head;
     sock->data.snd.nxt = seq;
 }
@@ -2483,16 +2557,97 @@ static int synsent_pkt(netif_t *src, const struct in6_addr *srca,
     return 0;
 }
 
+/* Copy received data into the ring buffer, off bytes past the tail. */
+static void tcp_rcvbuf_put(struct tcp_sock *s, uint32_t off,
+                           const uint8_t *buf, size_t sz) {
+    uint32_t pos = s->data.rcvbuf_tail + off;
+    size_t tmp;
+
+    if(pos >= s->rcvbuf_sz)
+        pos -= s->rcvbuf_sz;
+
+    if(pos + sz <= s->rcvbuf_sz) {
+        memcpy(s->data.rcvbuf + pos, buf, sz);
+    }
+    else {
+        tmp = s->rcvbuf_sz - pos;
+        memcpy(s->data.rcvbuf + pos, buf, tmp);
+        memcpy(s->data.rcvbuf, buf + tmp, sz - tmp);
+    }
+}
+
+/* Remember that [seq, end) has arrived ahead of RCV.NXT. The list is kept
+   sorted, and ranges that touch are merged. Returns -1 if there's no room to
+   remember it, in which case the data must be dropped. */
+static int tcp_ooo_add(struct tcp_sock *s, uint32_t seq, uint32_t end) {
+    struct tcp_ooo *o = s->data.ooo;
+    int i, j, cnt = s->data.ooo_count;
+
+    /* Find the first range that ends at or after this one starts... */
+    for(i = 0; i < cnt && SEQ_LT(o[i].end, seq); ++i);
+
+    /* ...and swallow every range that starts before this one ends. */
+    for(j = i; j < cnt && SEQ_LE(o[j].seq, end); ++j) {
+        if(SEQ_LT(o[j].seq, seq))
+            seq = o[j].seq;
+
+        if(SEQ_GT(o[j].end, end))
+            end = o[j].end;
+    }
+
+    if(j == i) {
+        if(cnt == TCP_OOO_MAX)
+            return -1;
+
+        memmove(o + i + 1, o + i, (cnt - i) * sizeof(struct tcp_ooo));
+        ++s->data.ooo_count;
+    }
+    else if(j > i + 1) {
+        memmove(o + i + 1, o + j, (cnt - j) * sizeof(struct tcp_ooo));
+        s->data.ooo_count -= j - i - 1;
+    }
+
+    o[i].seq = seq;
+    o[i].end = end;
+    return 0;
+}
+
+/* Pull any queued out-of-order data that now follows RCV.NXT into the readable
+   part of the buffer. Returns nonzero if a hole was filled. */
+static int tcp_ooo_merge(struct tcp_sock *s) {
+    struct tcp_ooo *o = s->data.ooo;
+    uint32_t n;
+    int filled = 0;
+
+    while(s->data.ooo_count && SEQ_LE(o[0].seq, s->data.rcv.nxt)) {
+        if(SEQ_GT(o[0].end, s->data.rcv.nxt)) {
+            n = o[0].end - s->data.rcv.nxt;
+            s->data.rcv.nxt += n;
+            s->data.rcv.wnd -= n;
+            s->data.rcvbuf_cur_sz += n;
+            s->data.rcvbuf_tail += n;
+
+            if(s->data.rcvbuf_tail >= s->rcvbuf_sz)
+                s->data.rcvbuf_tail -= s->rcvbuf_sz;
+        }
+
+        --s->data.ooo_count;
+        memmove(o, o + 1, s->data.ooo_count * sizeof(struct tcp_ooo));
+        filled = 1;
+    }
+
+    return filled;
+}
+
 /* This implements the processing described for the synchronized states, as
    described in pages 69-76 of the RFC. */
 static int process_pkt(netif_t *src, const struct in6_addr *srca,
                        const struct in6_addr *dsta, const tcp_hdr_t *tcp,
                        struct tcp_sock *s, uint16_t flags, size_t size) {
-    uint32_t seq, ack, up;
+    uint32_t seq, ack, up, dseq, off;
     size_t sz;
-    int bad_pkt = 0, tmp, acksyn = 0;
+    int bad_pkt = 0, acksyn = 0;
     const uint8_t *buf = (const uint8_t *)tcp;
-    uint8_t *rb;
 
     (void)src;
 
@@ -2515,7 +2670,9 @@ static int process_pkt(netif_t *src, const struct in6_addr *srca,
                 bad_pkt = 1;
         }
         else {
-            if(!(SEQ_GE(seq, s->data.rcv.nxt) &&
+            /* Any segment with some part inside the window is acceptable. The
+               part that we've already got gets trimmed off below. */
+            if(!(SEQ_GT(seq + sz, s->data.rcv.nxt) &&
                     SEQ_LT(seq, s->data.rcv.nxt + s->data.rcv.wnd)))
                 bad_pkt = 1;
         }
@@ -2657,38 +2814,62 @@ static int process_pkt(netif_t *src, const struct in6_addr *srca,
         }
     }
 
-    if(s->state == TCP_STATE_ESTABLISHED || s->state == TCP_STATE_FIN_WAIT_1 ||
-            s->state == TCP_STATE_FIN_WAIT_2) {
+    if((s->state == TCP_STATE_ESTABLISHED || s->state == TCP_STATE_FIN_WAIT_1 ||
+            s->state == TCP_STATE_FIN_WAIT_2) && sz) {
+        /* Trim off anything we've already received. */
+        dseq = seq;
+
+        if(SEQ_LT(dseq, s->data.rcv.nxt)) {
+            off = s->data.rcv.nxt - dseq;
+            buf += off;
+            sz -= off;
+            dseq = s->data.rcv.nxt;
+        }
+
         /* Next, check the data size versus our window. If its more than the
            window, truncate the data and copy out what we can. */
-        if(sz > s->data.rcv.wnd) {
-            sz = s->data.rcv.wnd;
+        off = dseq - s->data.rcv.nxt;
+
+        if(off + sz > s->data.rcv.wnd) {
+            sz = s->data.rcv.wnd - off;
             bad_pkt = 1;
         }
 
-        /* Copy the data out */
-        if(sz) {
-            rb = s->data.rcvbuf + s->data.rcvbuf_tail;
+        if(!off) {
+            /* In order, so copy the data out */
+            tcp_rcvbuf_put(s, 0, buf, sz);
             s->data.rcv.nxt += sz;
             s->data.rcv.wnd -= sz;
             s->data.rcvbuf_cur_sz += sz;
+            s->data.rcvbuf_tail += sz;
 
-            if(s->data.rcvbuf_tail + sz <= s->rcvbuf_sz) {
-                memcpy(rb, buf, sz);
-                s->data.rcvbuf_tail += sz;
+            if(s->data.rcvbuf_tail >= s->rcvbuf_sz)
+                s->data.rcvbuf_tail -= s->rcvbuf_sz;
+
+            /* Signal any waiting thread. If this filled a hole, or if we were
+               already holding back an ACK, ACK right away. Otherwise wait a bit
+               and see if there's another segment (or some data of our own) for
+               it to go with. */
+            __poll_event_trigger(s->sock, POLLRDNORM);
+            cond_signal(&s->data.recv_cv);
+
+            if(tcp_ooo_merge(s) || s->data.ooo_count ||
+                    (s->intflags & TCP_IFLAG_DELACK)) {
+                tcp_send_ack(s);
             }
             else {
-                tmp = s->rcvbuf_sz - s->data.rcvbuf_tail;
-                memcpy(rb, buf, tmp);
-                sz -= tmp;
-                buf += tmp;
-                memcpy(s->data.rcvbuf, buf, sz);
-                s->data.rcvbuf_tail = sz;
+                s->intflags |= TCP_IFLAG_DELACK;
+                s->data.ack_timer = timer_ms_gettime64();
             }
+        }
+        else {
+            /* Out of order. Keep the data where it will eventually go, and send
+               a duplicate ACK so the other side knows what's missing. Any FIN
+               on this segment will have to wait for it to be resent. */
+            if(!tcp_ooo_add(s, dseq, dseq + sz))
+                tcp_rcvbuf_put(s, off, buf, sz);
 
-            /* Signal any waiting thread and send an ack for what we read */
-            __poll_event_trigger(s->sock, POLLRDNORM);
-            cond_signal(&s->data.recv_cv);
+            bad_pkt = 1;
             tcp_send_ack(s);
         }
     }
@@ -2698,6 +2879,15 @@ static int process_pkt(netif_t *src, const struct in6_addr *srca,
         bad_pkt = 1;
     }
 
+    /* If that ACK opened up the window (or let Nagle's algorithm go), send
+       whatever is waiting. This will also carry any ACK we were holding. */
+    if((s->state == TCP_STATE_ESTABLISHED ||
+            s->state == TCP_STATE_CLOSE_WAIT) &&
+            s->data.sndbuf_cur_sz != s->data.snd.nxt - s->data.snd.una &&
+            SEQ_LT(s->data.snd.nxt, s->data.snd.una + s->data.snd.wnd)) {
+        tcp_send_data(s, 0);
+    }
+
     /* Finally, check the FIN bit. We don't try to ack it if the packet had too
        much data. */
     if(!bad_pkt && (flags & TCP_FLAG_FIN)) {
@@ -2850,6 +3040,15 @@ static void tcp_thd_cb(void *arg) {
         mutex_lock_scoped(&i->mutex);
         timer = timer_ms_gettime64();
 
+        /* Send any ACK that we've held back for long enough. */
+        if((i->intflags & TCP_IFLAG_DELACK) &&
+                i->data.ack_timer + TCP_DELACK_TIME <= timer) {
+            if(!(i->state & TCP_STATE_RESET))
+                tcp_send_ack(i);
+            else
+                i->intflags &= ~TCP_IFLAG_DELACK;
+        }
+
         switch(i->state) {
             case TCP_STATE_LISTEN:
                 break;
@@ -2960,7 +3159,9 @@ static fs_socket_proto_t proto = {
     net_tcp_getsockname,                /* getsockname */
     net_tcp_getpeername,                /* getpeername */
     net_tcp_fcntl,                      /* fcntl */
-    net_tcp_poll                        /* poll */
+    net_tcp_poll,                       /* poll */
+    NULL,                               /* recvmmsg */
+    NULL                                /* sendmmsg */
 };
 
 int net_tcp_init(void) {
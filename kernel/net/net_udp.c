@@ -2,6 +2,7 @@
 
    kernel/net/net_udp.c
    Copyright (C) 2005, 2006, 2007, 2008, 2009, 2012, 2013, 2014 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
@@ -11,13 +12,16 @@
 #include <errno.h>
 #include <poll.h>
 #include <stdint.h>
+#include <malloc.h>
 #include <arpa/inet.h>
 #include <kos/net.h>
 #include <kos/mutex.h>
 #include <kos/genwait.h>
+#include <kos/opts.h>
 #include <sys/queue.h>
 #include <kos/fs_socket.h>
 #include <arch/irq.h>
+#include <arch/timer.h>
 #include <sys/socket.h>
 #include <netinet/udp.h>
 #include <netinet/udplite.h>
@@ -40,17 +44,38 @@ typedef struct {
     uint16 checksum __packed;
 } udp_hdr_t;
 
-struct udp_pkt {
-    TAILQ_ENTRY(udp_pkt) pkt_queue;
+/* Limits on the size of a socket's receive buffer (SO_RCVBUF) */
+#define UDP_MIN_RCVBUF      2048
+#define UDP_MAX_RCVBUF      (1024 * 1024)
+
+/* Number of datagrams sendmmsg() sets up at a time with udp_mutex held */
+#define UDP_MMSG_BATCH      8
+
+/* Received datagrams are copied into a ring buffer that is allocated along
+   with the socket, so that nothing needs to be allocated as packets come in.
+   Each datagram starts with this header and is padded out to a multiple of
+   4 bytes. One that won't fit before the end of the buffer goes at the start
+   of it instead, and the space left at the end is skipped over. */
+typedef struct udp_rx_hdr {
     struct sockaddr_in6 from;
-    uint8 *data;
     uint16 datasize;
+} udp_rx_hdr_t;
+
+#define UDP_RX_ENTRY_SIZE(s) ((sizeof(udp_rx_hdr_t) + (s) + 3) & ~3)
+
+struct udp_rx_ring {
+    uint8 *buf;
+    uint32 size;                        /* SO_RCVBUF */
+    uint32 head;                        /* Oldest datagram */
+    uint32 tail;                        /* Where the next one goes */
+    uint32 end;                         /* End of the data before a wrap */
+    uint32 count;                       /* Datagrams in the ring */
+    uint32 drops;                       /* Dropped with the ring full */
 };
 
-TAILQ_HEAD(udp_pkt_queue, udp_pkt);
-
 #define UDPSOCK_NO_CHECKSUM 0x00000001
 #define UDPSOCK_LITE_RCVCOV 0x00000002
+#define UDPSOCK_RCVBUF_SET  0x00000004
 
 struct udp_sock {
     LIST_ENTRY(udp_sock) sock_list;
@@ -69,7 +94,7 @@ struct udp_sock {
         uint16_t recv_cscov;
     } udp_lite;
 
-    struct udp_pkt_queue packets;
+    struct udp_rx_ring rx;
 };
 
 LIST_HEAD(udp_sock_list, udp_sock);
@@ -78,10 +103,139 @@ static struct udp_sock_list net_udp_sockets = LIST_HEAD_INITIALIZER(0);
 static mutex_t udp_mutex = MUTEX_INITIALIZER;
 static net_udp_stats_t udp_stats = { 0 };
 
-static int net_udp_send_raw(netif_t *net, const struct sockaddr_in6 *src,
-                            const struct sockaddr_in6 *dst, const uint8 *data,
-                            size_t size, uint32_t flags, int hops,
-                            uint32_t iflags, int proto, uint16_t cscov);
+/* Everything needed to send a datagram from a socket, copied out of it so
+   that udp_mutex doesn't need to be held while sending. */
+typedef struct udp_send_args {
+    struct sockaddr_in6 src;
+    struct sockaddr_in6 dst;
+    uint32_t flags;
+    uint32_t iflags;
+    int hops;
+    int proto;
+    uint16_t cscov;
+} udp_send_args_t;
+
+static int net_udp_send_raw(netif_t *net, const udp_send_args_t *args,
+                            const struct iovec *iov, int iovcnt, size_t size);
+
+static int udp_rx_init(struct udp_rx_ring *ring, uint32 size) {
+    memset(ring, 0, sizeof(struct udp_rx_ring));
+
+    if(!(ring->buf = (uint8 *)malloc(size))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ring->size = size;
+    return 0;
+}
+
+/* Copy a datagram into the ring. Returns -1 if there's no room for it. */
+static int udp_rx_put(struct udp_rx_ring *ring, const struct sockaddr_in6 *from,
+                      const uint8 *data, size_t size) {
+    udp_rx_hdr_t *hdr;
+    uint32 len = UDP_RX_ENTRY_SIZE(size);
+    uint32 pos;
+
+    if(!ring->count)
+        ring->head = ring->tail = ring->end = 0;
+
+    if(ring->end) {
+        /* Already wrapped around, so the free space is up to the head. */
+        if(ring->tail + len > ring->head)
+            return -1;
+
+        pos = ring->tail;
+    }
+    else if(ring->tail + len <= ring->size) {
+        pos = ring->tail;
+    }
+    else if(len <= ring->head) {
+        /* Leave the end empty and wrap around to the start. */
+        ring->end = ring->tail;
+        pos = 0;
+    }
+    else {
+        return -1;
+    }
+
+    hdr = (udp_rx_hdr_t *)(ring->buf + pos);
+    hdr->from = *from;
+    hdr->datasize = (uint16)size;
+    memcpy(hdr + 1, data, size);
+
+    ring->tail = pos + len;
+    ++ring->count;
+    return 0;
+}
+
+static inline udp_rx_hdr_t *udp_rx_first(const struct udp_rx_ring *ring) {
+    return (udp_rx_hdr_t *)(ring->buf + ring->head);
+}
+
+static void udp_rx_pop(struct udp_rx_ring *ring) {
+    ring->head += UDP_RX_ENTRY_SIZE(udp_rx_first(ring)->datasize);
+
+    if(!--ring->count) {
+        ring->head = ring->tail = ring->end = 0;
+    }
+    else if(ring->end && ring->head == ring->end) {
+        ring->head = 0;
+        ring->end = 0;
+    }
+}
+
+/* Give the socket a receive ring of a new size, moving over as many of the
+   queued datagrams as will fit. Any others are counted as drops. */
+static int udp_rx_resize(struct udp_rx_ring *ring, uint32 size) {
+    struct udp_rx_ring nring;
+    udp_rx_hdr_t *hdr;
+
+    if(udp_rx_init(&nring, size))
+        return -1;
+
+    nring.drops = ring->drops;
+
+    while(ring->count) {
+        hdr = udp_rx_first(ring);
+
+        if(udp_rx_put(&nring, &hdr->from, (const uint8 *)(hdr + 1),
+                      hdr->datasize)) {
+            ++nring.drops;
+            ++udp_stats.pkt_recv_dropped;
+        }
+
+        udp_rx_pop(ring);
+    }
+
+    free(ring->buf);
+    *ring = nring;
+    return 0;
+}
+
+/* Queue a datagram on the socket. A socket that's still on the default
+   receive buffer has it grown when a datagram arrives that could never fit,
+   unless that would mean calling malloc() where it isn't safe to. */
+static int udp_rx_queue(struct udp_sock *sock, const struct sockaddr_in6 *from,
+                        const uint8 *data, size_t size) {
+    uint32 len = UDP_RX_ENTRY_SIZE(size);
+
+    if(len > sock->rx.size && !(sock->int_flags & UDPSOCK_RCVBUF_SET) &&
+       (!irq_inside_int() || malloc_irq_safe()))
+        udp_rx_resize(&sock->rx, sock->rx.size + len);
+
+    return udp_rx_put(&sock->rx, from, data, size);
+}
+
+static size_t udp_iov_len(const struct iovec *iov, int iovcnt) {
+    size_t len = 0;
+    int i;
+
+    for(i = 0; i < iovcnt; ++i)
+        len += iov[i].iov_len;
+
+    return len;
+}
 
 static int net_udp_accept(net_socket_t *hnd, struct sockaddr *addr,
                           socklen_t *addr_len) {
@@ -305,11 +459,125 @@ static int net_udp_listen(net_socket_t *hnd, int backlog) {
     return -1;
 }
 
+/* Copy a received address out in the form the socket's domain uses. */
+static void net_udp_copy_addr(const struct udp_sock *udpsock,
+                              const struct sockaddr_in6 *from,
+                              struct sockaddr *addr, socklen_t *addr_len) {
+    if(udpsock->domain == AF_INET) {
+        struct sockaddr_in realaddr;
+
+        memset(&realaddr, 0, sizeof(struct sockaddr_in));
+        realaddr.sin_family = AF_INET;
+        realaddr.sin_addr.s_addr = from->sin6_addr.__s6_addr.__s6_addr32[3];
+        realaddr.sin_port = from->sin6_port;
+
+        if(*addr_len < sizeof(struct sockaddr_in)) {
+            memcpy(addr, &realaddr, *addr_len);
+        }
+        else {
+            memcpy(addr, &realaddr, sizeof(struct sockaddr_in));
+            *addr_len = sizeof(struct sockaddr_in);
+        }
+    }
+    else if(udpsock->domain == AF_INET6) {
+        struct sockaddr_in6 realaddr6;
+
+        memset(&realaddr6, 0, sizeof(struct sockaddr_in6));
+        realaddr6.sin6_family = AF_INET6;
+        realaddr6.sin6_addr = from->sin6_addr;
+        realaddr6.sin6_port = from->sin6_port;
+
+        if(*addr_len < sizeof(struct sockaddr_in6)) {
+            memcpy(addr, &realaddr6, *addr_len);
+        }
+        else {
+            memcpy(addr, &realaddr6, sizeof(struct sockaddr_in6));
+            *addr_len = sizeof(struct sockaddr_in6);
+        }
+    }
+}
+
+/* Copy the oldest queued datagram out into the buffers given, along with the
+   address it came from. Returns how much of it was copied, and sets MSG_TRUNC
+   in *mflags (if not NULL) if that wasn't all of it. */
+static size_t net_udp_copy_out(struct udp_sock *udpsock,
+                               const struct iovec *iov, int iovcnt,
+                               struct sockaddr *addr, socklen_t *addr_len,
+                               int *mflags) {
+    udp_rx_hdr_t *hdr = udp_rx_first(&udpsock->rx);
+    const uint8 *data = (const uint8 *)(hdr + 1);
+    size_t left = hdr->datasize, len, done = 0;
+    int i;
+
+    for(i = 0; i < iovcnt && left; ++i) {
+        len = iov[i].iov_len < left ? iov[i].iov_len : left;
+        memcpy(iov[i].iov_base, data + done, len);
+        done += len;
+        left -= len;
+    }
+
+    if(mflags)
+        *mflags = left ? MSG_TRUNC : 0;
+
+    if(addr != NULL)
+        net_udp_copy_addr(udpsock, &hdr->from, addr, addr_len);
+
+    return done;
+}
+
+static int net_udp_check_msg(const struct msghdr *msg) {
+    if(msg->msg_iovlen && msg->msg_iov == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if(msg->msg_iovlen <= 0 || msg->msg_iovlen > IOV_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Wait for a datagram to be queued on the socket, with udp_mutex held. Fails
+   if the socket can't block, or if the deadline (if not 0) passes first. */
+static int net_udp_wait(struct udp_sock *udpsock, int flags, uint64 deadline) {
+    uint64 now;
+    int timeout;
+
+    if((udpsock->flags & FS_SOCKET_NONBLOCK) || (flags & MSG_DONTWAIT) ||
+       irq_inside_int()) {
+        errno = EWOULDBLOCK;
+        return -1;
+    }
+
+    while(!udpsock->rx.count) {
+        timeout = 0;
+
+        if(deadline) {
+            now = timer_ms_gettime64();
+
+            if(now >= deadline) {
+                errno = EAGAIN;
+                return -1;
+            }
+
+            timeout = (int)(deadline - now);
+        }
+
+        mutex_unlock(&udp_mutex);
+        genwait_wait(udpsock, "net_udp_recv", timeout, NULL);
+        mutex_lock(&udp_mutex);
+    }
+
+    return 0;
+}
+
 static ssize_t net_udp_recvfrom(net_socket_t *hnd, void *buffer, size_t length,
                                 int flags, struct sockaddr *addr,
                                 socklen_t *addr_len) {
     struct udp_sock *udpsock;
-    struct udp_pkt *pkt;
+    struct iovec iov;
 
     if(mutex_lock_irqsafe(&udp_mutex))
         return -1;
@@ -333,154 +601,152 @@ static ssize_t net_udp_recvfrom(net_socket_t *hnd, void *buffer, size_t length,
         return -1;
     }
 
-    if(TAILQ_EMPTY(&udpsock->packets) &&
-       ((udpsock->flags & FS_SOCKET_NONBLOCK) || (flags & MSG_DONTWAIT) ||
-        irq_inside_int())) {
+    if(!udpsock->rx.count && net_udp_wait(udpsock, flags, 0)) {
         mutex_unlock(&udp_mutex);
-        errno = EWOULDBLOCK;
         return -1;
     }
 
-    while(TAILQ_EMPTY(&udpsock->packets)) {
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+    length = net_udp_copy_out(udpsock, &iov, 1, addr, addr_len, NULL);
+
+    /* Remove the packet if we're pulling data out of the queue. */
+    if(!(flags & MSG_PEEK))
+        udp_rx_pop(&udpsock->rx);
+
+    mutex_unlock(&udp_mutex);
+
+    return length;
+}
+
+static int net_udp_recvmmsg(net_socket_t *hnd, struct mmsghdr *msgvec,
+                            unsigned int vlen, int flags,
+                            struct timespec *timeout) {
+    struct udp_sock *udpsock;
+    struct msghdr *msg;
+    uint64 deadline = 0;
+    unsigned int i;
+
+    if(timeout)
+        deadline = timer_ms_gettime64() + timeout->tv_sec * 1000ULL +
+                   timeout->tv_nsec / 1000000;
+
+    if(mutex_lock_irqsafe(&udp_mutex))
+        return -1;
+
+    udpsock = (struct udp_sock *)hnd->data;
+
+    if(udpsock == NULL) {
         mutex_unlock(&udp_mutex);
-        genwait_wait(udpsock, "net_udp_recvfrom", 0, NULL);
-        mutex_lock(&udp_mutex);
+        errno = EBADF;
+        return -1;
     }
 
-    pkt = TAILQ_FIRST(&udpsock->packets);
-
-    if(pkt->datasize > length) {
-        memcpy(buffer, pkt->data, length);
+    /* A socket that's shut down for reading receives nothing, and so does
+       an empty vector, which Linux doesn't treat as an error either. */
+    if((udpsock->flags & (SHUT_RD << 24)) || !vlen) {
+        mutex_unlock(&udp_mutex);
+        return 0;
     }
-    else {
-        memcpy(buffer, pkt->data, pkt->datasize);
-        length = pkt->datasize;
+
+    if(msgvec == NULL) {
+        mutex_unlock(&udp_mutex);
+        errno = EFAULT;
+        return -1;
     }
 
-    if(addr != NULL) {
-        if(udpsock->domain == AF_INET) {
-            struct sockaddr_in realaddr;
+    /* Everything that's queued is drained with the one lock, and only the
+       first datagram is waited for with MSG_WAITFORONE. */
+    for(i = 0; i < vlen; ++i) {
+        msg = &msgvec[i].msg_hdr;
 
-            memset(&realaddr, 0, sizeof(struct sockaddr_in));
-            realaddr.sin_family = AF_INET;
-            realaddr.sin_addr.s_addr =
-                pkt->from.sin6_addr.__s6_addr.__s6_addr32[3];
-            realaddr.sin_port = pkt->from.sin6_port;
+        if(net_udp_check_msg(msg))
+            break;
 
-            if(*addr_len < sizeof(struct sockaddr_in)) {
-                memcpy(addr, &realaddr, *addr_len);
-            }
-            else {
-                memcpy(addr, &realaddr, sizeof(struct sockaddr_in));
-                *addr_len = sizeof(struct sockaddr_in);
-            }
+        if(!udpsock->rx.count) {
+            if(i && (flags & MSG_WAITFORONE))
+                break;
+
+            if(net_udp_wait(udpsock, flags, deadline))
+                break;
         }
-        else if(udpsock->domain == AF_INET6) {
-            struct sockaddr_in6 realaddr6;
 
-            memset(&realaddr6, 0, sizeof(struct sockaddr_in6));
-            realaddr6.sin6_family = AF_INET6;
-            realaddr6.sin6_addr = pkt->from.sin6_addr;
-            realaddr6.sin6_port = pkt->from.sin6_port;
+        msgvec[i].msg_len = net_udp_copy_out(udpsock, msg->msg_iov,
+                                             msg->msg_iovlen, msg->msg_name,
+                                             &msg->msg_namelen,
+                                             &msg->msg_flags);
+        msg->msg_controllen = 0;
 
-            if(*addr_len < sizeof(struct sockaddr_in6)) {
-                memcpy(addr, &realaddr6, *addr_len);
-            }
-            else {
-                memcpy(addr, &realaddr6, sizeof(struct sockaddr_in6));
-                *addr_len = sizeof(struct sockaddr_in6);
-            }
+        /* Peeking can only ever see the one datagram. */
+        if(flags & MSG_PEEK) {
+            ++i;
+            break;
         }
-    }
 
-    /* Remove the packet if we're pulling data out of the queue. */
-    if(!(flags & MSG_PEEK)) {
-        TAILQ_REMOVE(&udpsock->packets, pkt, pkt_queue);
-        free(pkt->data);
-        free(pkt);
+        udp_rx_pop(&udpsock->rx);
     }
 
     mutex_unlock(&udp_mutex);
 
-    return length;
+    return i ? (int)i : -1;
 }
 
-static ssize_t net_udp_sendto(net_socket_t *hnd, const void *message,
-                              size_t length, int flags,
-                              const struct sockaddr *addr, socklen_t addr_len) {
-    struct udp_sock *udpsock;
+/* Work out where a datagram from the socket should go and copy out what's
+   needed to send it, assigning a local port if there isn't one yet. Must be
+   called with udp_mutex held. */
+static int net_udp_send_prep(struct udp_sock *udpsock,
+                             const struct sockaddr *addr, socklen_t addr_len,
+                             udp_send_args_t *args) {
     struct sockaddr_in *realaddr;
-    struct sockaddr_in6 realaddr6;
-    uint32_t sflags, iflags;
-    int hops, proto;
-    uint16_t cscov;
-    struct sockaddr_in6 local_addr;
-
-    (void)flags;
-
-    if(mutex_lock_irqsafe(&udp_mutex))
-        return -1;
-
-    udpsock = (struct udp_sock *)hnd->data;
-
-    if(udpsock == NULL) {
-        errno = EBADF;
-        goto err;
-    }
 
     if(udpsock->flags & (SHUT_WR << 24)) {
         errno = EPIPE;
-        goto err;
+        return -1;
     }
 
     if(!IN6_IS_ADDR_UNSPECIFIED(&udpsock->remote_addr.sin6_addr) &&
        udpsock->remote_addr.sin6_port != 0) {
         if(addr) {
             errno = EISCONN;
-            goto err;
+            return -1;
         }
 
-        realaddr6 = udpsock->remote_addr;
+        args->dst = udpsock->remote_addr;
     }
     else if(addr == NULL) {
         errno = EDESTADDRREQ;
-        goto err;
+        return -1;
     }
     else if(addr->sa_family != udpsock->domain) {
         errno = EAFNOSUPPORT;
-        goto err;
+        return -1;
     }
     else if(udpsock->domain == AF_INET6) {
         if(addr_len != sizeof(struct sockaddr_in6)) {
             errno = EINVAL;
-            goto err;
+            return -1;
         }
 
-        realaddr6 = *((struct sockaddr_in6 *)addr);
+        args->dst = *((struct sockaddr_in6 *)addr);
     }
     else if(udpsock->domain == AF_INET) {
         if(addr_len != sizeof(struct sockaddr_in)) {
             errno = EINVAL;
-            goto err;
+            return -1;
         }
 
         realaddr = (struct sockaddr_in *)addr;
-        memset(&realaddr6, 0, sizeof(struct sockaddr_in6));
-        realaddr6.sin6_family = AF_INET6;
-        realaddr6.sin6_addr.__s6_addr.__s6_addr16[5] = 0xFFFF;
-        realaddr6.sin6_addr.__s6_addr.__s6_addr32[3] =
+        memset(&args->dst, 0, sizeof(struct sockaddr_in6));
+        args->dst.sin6_family = AF_INET6;
+        args->dst.sin6_addr.__s6_addr.__s6_addr16[5] = 0xFFFF;
+        args->dst.sin6_addr.__s6_addr.__s6_addr32[3] =
             realaddr->sin_addr.s_addr;
-        realaddr6.sin6_port = realaddr->sin_port;
+        args->dst.sin6_port = realaddr->sin_port;
     }
     else {
         /* Shouldn't be able to get here... */
         errno = EBADF;
-        goto err;
-    }
-
-    if(message == NULL) {
-        errno = EFAULT;
-        goto err;
+        return -1;
     }
 
     if(udpsock->local_addr.sin6_port == 0) {
@@ -502,22 +768,125 @@ static ssize_t net_udp_sendto(net_socket_t *hnd, const void *message,
         udpsock->local_addr.sin6_port = htons(port);
     }
 
-    local_addr = udpsock->local_addr;
-    sflags = udpsock->flags;
-    iflags = udpsock->int_flags;
-    hops = udpsock->hop_limit;
-    proto = udpsock->proto;
-    cscov = udpsock->udp_lite.send_cscov;
+    args->src = udpsock->local_addr;
+    args->flags = udpsock->flags;
+    args->iflags = udpsock->int_flags;
+    args->hops = udpsock->hop_limit;
+    args->proto = udpsock->proto;
+    args->cscov = udpsock->udp_lite.send_cscov;
+
+    return 0;
+}
+
+static ssize_t net_udp_sendto(net_socket_t *hnd, const void *message,
+                              size_t length, int flags,
+                              const struct sockaddr *addr, socklen_t addr_len) {
+    struct udp_sock *udpsock;
+    udp_send_args_t args;
+    struct iovec iov;
+
+    (void)flags;
+
+    if(mutex_lock_irqsafe(&udp_mutex))
+        return -1;
+
+    udpsock = (struct udp_sock *)hnd->data;
+
+    if(udpsock == NULL) {
+        errno = EBADF;
+        goto err;
+    }
+
+    if(message == NULL) {
+        errno = EFAULT;
+        goto err;
+    }
+
+    if(net_udp_send_prep(udpsock, addr, addr_len, &args))
+        goto err;
+
     mutex_unlock(&udp_mutex);
 
-    return net_udp_send_raw(NULL, &local_addr, &realaddr6,
-                            (const uint8 *)message, length, sflags, hops,
-                            iflags, proto, cscov);
+    iov.iov_base = (void *)message;
+    iov.iov_len = length;
+
+    return net_udp_send_raw(NULL, &args, &iov, 1, length);
 err:
     mutex_unlock(&udp_mutex);
     return -1;
 }
 
+static int net_udp_sendmmsg(net_socket_t *hnd, struct mmsghdr *msgvec,
+                            unsigned int vlen, int flags) {
+    struct udp_sock *udpsock;
+    udp_send_args_t args[UDP_MMSG_BATCH];
+    struct msghdr *msg;
+    unsigned int i, n, sent = 0;
+    int rv, more;
+
+    (void)flags;
+
+    if(msgvec == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    /* The destinations are worked out a batch at a time with the lock held,
+       but the lock can't be held while sending, since a datagram sent over
+       the loopback comes right back in through net_udp_input(). */
+    while(sent < vlen) {
+        n = vlen - sent;
+
+        if(n > UDP_MMSG_BATCH)
+            n = UDP_MMSG_BATCH;
+
+        if(mutex_lock_irqsafe(&udp_mutex))
+            break;
+
+        udpsock = (struct udp_sock *)hnd->data;
+
+        if(udpsock == NULL) {
+            mutex_unlock(&udp_mutex);
+            errno = EBADF;
+            break;
+        }
+
+        for(i = 0; i < n; ++i) {
+            msg = &msgvec[sent + i].msg_hdr;
+
+            if(net_udp_check_msg(msg))
+                break;
+
+            if(net_udp_send_prep(udpsock, (const struct sockaddr *)msg->msg_name,
+                                 msg->msg_namelen, &args[i]))
+                break;
+        }
+
+        mutex_unlock(&udp_mutex);
+
+        /* Anything set up before a failure still goes out. */
+        more = (i == n);
+        n = i;
+
+        for(i = 0; i < n; ++i) {
+            msg = &msgvec[sent].msg_hdr;
+            rv = net_udp_send_raw(NULL, &args[i], msg->msg_iov,
+                                  msg->msg_iovlen,
+                                  udp_iov_len(msg->msg_iov, msg->msg_iovlen));
+
+            if(rv < 0)
+                return sent ? (int)sent : -1;
+
+            msgvec[sent++].msg_len = rv;
+        }
+
+        if(!more)
+            break;
+    }
+
+    return sent ? (int)sent : -1;
+}
+
 static int net_udp_shutdownsock(net_socket_t *hnd, int how) {
     struct udp_sock *udpsock;
 
@@ -568,12 +937,18 @@ static int net_udp_socket(net_socket_t *hnd, int domain, int type, int proto) {
     }
 
     memset(udpsock, 0, sizeof(struct udp_sock));
-    TAILQ_INIT(&udpsock->packets);
+
+    if(udp_rx_init(&udpsock->rx, NET_UDP_RCVBUF)) {
+        free(udpsock);
+        return -1;
+    }
+
     udpsock->domain = domain;
     udpsock->proto = proto;
     udpsock->hop_limit = UDP_DEFAULT_HOPS;
 
     if(mutex_lock_irqsafe(&udp_mutex)) {
+        free(udpsock->rx.buf);
         free(udpsock);
         return -1;
     }
@@ -587,8 +962,6 @@ static int net_udp_socket(net_socket_t *hnd, int domain, int type, int proto) {
 
 static void net_udp_close(net_socket_t *hnd) {
     struct udp_sock *udpsock;
-    struct udp_pkt *pkt;
-    struct udp_pkt *it;
 
     if(mutex_lock_irqsafe(&udp_mutex))
         return;
@@ -601,18 +974,9 @@ static void net_udp_close(net_socket_t *hnd) {
         return;
     }
 
-    it = udpsock->packets.tqh_first;
-    while(it) {
-        pkt = it;
-        it = it->pkt_queue.tqe_next;
-
-        free(pkt->data);
-        TAILQ_REMOVE(&udpsock->packets, pkt, pkt_queue);
-        free(pkt);
-    }
-
     LIST_REMOVE(udpsock, sock_list);
 
+    free(udpsock->rx.buf);
     free(udpsock);
     mutex_unlock(&udp_mutex);
 }
@@ -641,6 +1005,14 @@ static int net_udp_getsockopt(net_socket_t *hnd, int level, int option_name,
                 case SO_TYPE:
                     tmp = SOCK_DGRAM;
                     goto copy_int;
+
+                case SO_RCVBUF:
+                    tmp = (int)sock->rx.size;
+                    goto copy_int;
+
+                case SO_RCVDROPS:
+                    tmp = (int)sock->rx.drops;
+                    goto copy_int;
             }
 
             break;
@@ -751,7 +1123,28 @@ static int net_udp_setsockopt(net_socket_t *hnd, int level, int option_name,
                 case SO_ACCEPTCONN:
                 case SO_ERROR:
                 case SO_TYPE:
+                case SO_RCVDROPS:
                     goto ret_inval;
+
+                case SO_RCVBUF:
+                    if(option_len != sizeof(int))
+                        goto ret_inval;
+
+                    tmp = *((int *)option_value);
+
+                    if(tmp < UDP_MIN_RCVBUF)
+                        tmp = UDP_MIN_RCVBUF;
+                    else if(tmp > UDP_MAX_RCVBUF)
+                        tmp = UDP_MAX_RCVBUF;
+
+                    if(udp_rx_resize(&sock->rx, (uint32)tmp)) {
+                        mutex_unlock(&udp_mutex);
+                        return -1;
+                    }
+
+                    sock->int_flags |= UDPSOCK_RCVBUF_SET;
+
+                    goto ret_success;
             }
 
             break;
@@ -1091,7 +1484,7 @@ static short net_udp_poll(net_socket_t *hnd, short events) {
         return POLLNVAL;
     }
 
-    if(!TAILQ_EMPTY(&sock->packets))
+    if(sock->rx.count)
         rv |= POLLRDNORM;
 
     mutex_unlock(&udp_mutex);
@@ -1107,7 +1500,7 @@ static int net_udp_input4(netif_t *src, const ip_hdr_t *ip, const uint8 *data,
     uint16 cs, cscov = 0;
     int partial = 1;
     struct udp_sock *sock;
-    struct udp_pkt *pkt;
+    struct sockaddr_in6 from;
 
     (void)src;
 
@@ -1202,30 +1595,20 @@ static int net_udp_input4(netif_t *src, const ip_hdr_t *ip, const uint8 *data,
             return 0;
         }
 
-        if(!(pkt = (struct udp_pkt *)malloc(sizeof(struct udp_pkt)))) {
-            mutex_unlock(&udp_mutex);
-            return -1;
-        }
-
-        memset(pkt, 0, sizeof(struct udp_pkt));
-
-        pkt->datasize = size - sizeof(udp_hdr_t);
+        memset(&from, 0, sizeof(struct sockaddr_in6));
+        from.sin6_family = AF_INET6;
+        from.sin6_addr.__s6_addr.__s6_addr16[5] = 0xFFFF;
+        from.sin6_addr.__s6_addr.__s6_addr32[3] = ip->src;
+        from.sin6_port = hdr->src_port;
 
-        if(!(pkt->data = (uint8 *)malloc(pkt->datasize))) {
-            free(pkt);
+        if(udp_rx_queue(sock, &from, data + sizeof(udp_hdr_t),
+                        size - sizeof(udp_hdr_t))) {
+            ++sock->rx.drops;
+            ++udp_stats.pkt_recv_dropped;
             mutex_unlock(&udp_mutex);
             return -1;
         }
 
-        pkt->from.sin6_family = AF_INET6;
-        pkt->from.sin6_addr.__s6_addr.__s6_addr16[5] = 0xFFFF;
-        pkt->from.sin6_addr.__s6_addr.__s6_addr32[3] = ip->src;
-        pkt->from.sin6_port = hdr->src_port;
-
-        memcpy(pkt->data, data + sizeof(udp_hdr_t), pkt->datasize);
-
-        TAILQ_INSERT_TAIL(&sock->packets, pkt, pkt_queue);
-
         ++udp_stats.pkt_recv;
         __poll_event_trigger(sock->sock, POLLRDNORM);
         genwait_wake_one(sock);
@@ -1246,7 +1629,7 @@ static int net_udp_input6(netif_t *src, const ipv6_hdr_t *ip, const uint8 *data,
     uint16 cs, cscov = 0;
     int partial = 1;
     struct udp_sock *sock;
-    struct udp_pkt *pkt;
+    struct sockaddr_in6 from;
 
     (void)src;
 
@@ -1339,29 +1722,19 @@ static int net_udp_input6(netif_t *src, const ipv6_hdr_t *ip, const uint8 *data,
             return 0;
         }
 
-        if(!(pkt = (struct udp_pkt *)malloc(sizeof(struct udp_pkt)))) {
-            mutex_unlock(&udp_mutex);
-            return -1;
-        }
-
-        memset(pkt, 0, sizeof(struct udp_pkt));
-
-        pkt->datasize = size - sizeof(udp_hdr_t);
+        memset(&from, 0, sizeof(struct sockaddr_in6));
+        from.sin6_family = AF_INET6;
+        from.sin6_addr = ip->src_addr;
+        from.sin6_port = hdr->src_port;
 
-        if(!(pkt->data = (uint8 *)malloc(pkt->datasize))) {
-            free(pkt);
+        if(udp_rx_queue(sock, &from, data + sizeof(udp_hdr_t),
+                        size - sizeof(udp_hdr_t))) {
+            ++sock->rx.drops;
+            ++udp_stats.pkt_recv_dropped;
             mutex_unlock(&udp_mutex);
             return -1;
         }
 
-        pkt->from.sin6_family = AF_INET6;
-        pkt->from.sin6_addr = ip->src_addr;
-        pkt->from.sin6_port = hdr->src_port;
-
-        memcpy(pkt->data, data + sizeof(udp_hdr_t), pkt->datasize);
-
-        TAILQ_INSERT_TAIL(&sock->packets, pkt, pkt_queue);
-
         ++udp_stats.pkt_recv;
         __poll_event_trigger(sock->sock, POLLRDNORM);
         genwait_wake_one(sock);
@@ -1390,17 +1763,26 @@ static int net_udp_input(netif_t *src, int domain, const void *hdr,
 }
 
 /* XXX */
-static int net_udp_send_raw(netif_t *net, const struct sockaddr_in6 *src,
-                            const struct sockaddr_in6 *dst, const uint8 *data,
-                            size_t size, uint32_t flags, int hops,
-                            uint32_t iflags, int proto, uint16_t cscov) {
-    uint8 buf[size + sizeof(udp_hdr_t)];
-    udp_hdr_t *hdr = (udp_hdr_t *)buf;
+static int net_udp_send_raw(netif_t *net, const udp_send_args_t *args,
+                            const struct iovec *iov, int iovcnt, size_t size) {
     uint16 cs;
-    int err;
+    int err, i;
+    const struct sockaddr_in6 *src = &args->src;
+    const struct sockaddr_in6 *dst = &args->dst;
     struct in6_addr srcaddr = src->sin6_addr;
+    int proto = args->proto;
+    uint16_t cscov = args->cscov;
 
-    (void)flags;
+    /* Check this before the buffer goes on the stack. */
+    if(size > 0xFFFF - sizeof(udp_hdr_t)) {
+        errno = EMSGSIZE;
+        ++udp_stats.pkt_send_failed;
+        return -1;
+    }
+
+    uint8 buf[size + sizeof(udp_hdr_t)];
+    udp_hdr_t *hdr = (udp_hdr_t *)buf;
+    uint8 *pos = buf + sizeof(udp_hdr_t);
 
     if(!net) {
         net = net_default_dev;
@@ -1438,7 +1820,12 @@ static int net_udp_send_raw(netif_t *net, const struct sockaddr_in6 *src,
         }
     }
 
-    memcpy(buf + sizeof(udp_hdr_t), data, size);
+    /* Gather the data up behind the header. */
+    for(i = 0; i < iovcnt; ++i) {
+        memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+
     size += sizeof(udp_hdr_t);
 
     hdr->src_port = src->sin6_port;
@@ -1449,7 +1836,7 @@ static int net_udp_send_raw(netif_t *net, const struct sockaddr_in6 *src,
     if(proto == IPPROTO_UDP) {
         hdr->length = htons(size);
 
-        if(!(iflags & UDPSOCK_NO_CHECKSUM)) {
+        if(!(args->iflags & UDPSOCK_NO_CHECKSUM)) {
             cs = net_ipv6_checksum_pseudo(&srcaddr, &dst->sin6_addr, size,
                                           proto);
             hdr->checksum = net_ipv4_checksum(buf, size, cs);
@@ -1469,7 +1856,7 @@ static int net_udp_send_raw(netif_t *net, const struct sockaddr_in6 *src,
     }
 
     /* Pass everything off to the network layer to do the rest. */
-    err = net_ipv6_send(net, buf, size, hops, proto, &srcaddr,
+    err = net_ipv6_send(net, buf, size, args->hops, proto, &srcaddr,
                         &dst->sin6_addr);
 
     if(err < 0) {
@@ -1507,7 +1894,9 @@ static fs_socket_proto_t proto = {
     net_udp_getsockname,
     net_udp_getpeername,
     net_udp_fcntl,
-    net_udp_poll
+    net_udp_poll,
+    net_udp_recvmmsg,
+    net_udp_sendmmsg
 };
 
 static fs_socket_proto_t proto_lite = {
@@ -1530,7 +1919,9 @@ static fs_socket_proto_t proto_lite = {
     net_udp_getsockname,
     net_udp_getpeername,
     net_udp_fcntl,
-    net_udp_poll
+    net_udp_poll,
+    net_udp_recvmmsg,
+    net_udp_sendmmsg
 };
 
 int net_udp_init(void) {
@@ -0,0 +1,339 @@
+/* KallistiOS ##version##
+
+   kernel/net/net_vnic.c
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/* This file implements a virtual network device, backed by memory rather than
+   hardware. Frames given to net_vnic_inject() are received as if they'd come
+   off the wire, and frames the stack transmits are kept for
+   net_vnic_capture(). This makes it possible to test and benchmark the
+   network stack without any network hardware.
+
+   Receiving works the way a real driver using net_poll_schedule() would: the
+   device has a receive "interrupt" that's masked while it's being polled, so a
+   burst of frames only raises it once. Both directions use a ring of fixed
+   size slots, and are protected by disabling interrupts, so frames can be
+   injected from an interrupt handler. */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kos/net.h>
+#include <arch/irq.h>
+
+#include "net_ipv4.h"
+
+/* Room for an Ethernet frame with a VLAN tag, but no FCS. */
+#define SLOT_SIZE       1520
+
+typedef struct vnic_ring {
+    uint8 *slots;
+    int *lens;
+    int count;
+    int head;           /* Next slot to fill */
+    int tail;           /* Next slot to empty */
+    int used;
+} vnic_ring_t;
+
+typedef struct vnic {
+    /* This must come first, as the netif_t is what callers get */
+    netif_t nif;
+
+    char name[16];
+    vnic_ring_t rx;
+    vnic_ring_t tx;
+    bool rx_irq;
+    net_vnic_stats_t stats;
+} vnic_t;
+
+static int vnic_count;
+
+static int ring_init(vnic_ring_t *r, int count) {
+    r->slots = malloc(count * SLOT_SIZE);
+    r->lens = malloc(count * sizeof(int));
+
+    if(!r->slots || !r->lens) {
+        free(r->slots);
+        free(r->lens);
+        return -1;
+    }
+
+    r->count = count;
+    r->head = r->tail = r->used = 0;
+    return 0;
+}
+
+static void ring_put(vnic_ring_t *r, const uint8 *frame, int len) {
+    memcpy(r->slots + r->head * SLOT_SIZE, frame, len);
+    r->lens[r->head] = len;
+    r->head = (r->head + 1) % r->count;
+    r->used++;
+}
+
+/* Netcore interface */
+
+static int vnic_if_detect(netif_t *self) {
+    (void)self;
+    return 0;
+}
+
+static int vnic_if_init(netif_t *self) {
+    self->flags |= NETIF_INITIALIZED;
+    return 0;
+}
+
+static int vnic_if_shutdown(netif_t *self) {
+    self->flags &= ~(NETIF_INITIALIZED | NETIF_RUNNING);
+    return 0;
+}
+
+static int vnic_if_start(netif_t *self) {
+    self->flags |= NETIF_RUNNING;
+    return 0;
+}
+
+static int vnic_if_stop(netif_t *self) {
+    self->flags &= ~NETIF_RUNNING;
+    return 0;
+}
+
+static int vnic_if_tx(netif_t *self, const uint8 *data, int len,
+                      int blocking) {
+    vnic_t *v = (vnic_t *)self;
+
+    (void)blocking;
+
+    if(!(self->flags & NETIF_RUNNING) || len > SLOT_SIZE)
+        return NETIF_TX_ERROR;
+
+    irq_disable_scoped();
+
+    /* Like a real wire, nobody hears about frames that nobody picked up. */
+    if(v->tx.used == v->tx.count) {
+        v->stats.tx_dropped++;
+        return NETIF_TX_OK;
+    }
+
+    ring_put(&v->tx, data, len);
+    v->stats.tx_frames++;
+    return NETIF_TX_OK;
+}
+
+static int vnic_if_tx_commit(netif_t *self) {
+    (void)self;
+    return 0;
+}
+
+static int vnic_if_rx_poll(netif_t *self) {
+    vnic_t *v = (vnic_t *)self;
+    int n;
+
+    /* Pass up whatever is waiting, in case a poll isn't going to happen */
+    do {
+        n = self->if_poll(self, v->rx.count);
+    } while(n);
+
+    return 0;
+}
+
+static int vnic_if_poll(netif_t *self, int budget) {
+    vnic_t *v = (vnic_t *)self;
+    int n, tail, used;
+
+    for(n = 0; n < budget; n++) {
+        {
+            irq_disable_scoped();
+
+            used = v->rx.used;
+            tail = v->rx.tail;
+        }
+
+        if(!used)
+            break;
+
+        /* The slot can't be reused until the tail moves past it */
+        net_input(self, v->rx.slots + tail * SLOT_SIZE, v->rx.lens[tail]);
+
+        {
+            irq_disable_scoped();
+
+            v->rx.tail = (tail + 1) % v->rx.count;
+            v->rx.used--;
+        }
+    }
+
+    {
+        irq_disable_scoped();
+
+        /* Anything that comes in from now on raises the interrupt again */
+        if(!v->rx.used) {
+            net_poll_complete(self);
+            v->rx_irq = true;
+        }
+    }
+
+    return n;
+}
+
+static int vnic_if_set_flags(netif_t *self, uint32 flags_and,
+                             uint32 flags_or) {
+    self->flags = (self->flags & flags_and) | flags_or;
+    return 0;
+}
+
+static int vnic_if_set_mc(netif_t *self, const uint8 *list, int count) {
+    (void)self;
+    (void)list;
+    (void)count;
+    return 0;
+}
+
+netif_t *net_vnic_create(const uint8 mac[6], int frames) {
+    vnic_t *v;
+
+    if(frames <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if(!(v = calloc(1, sizeof(vnic_t)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if(ring_init(&v->rx, frames) < 0) {
+        free(v);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if(ring_init(&v->tx, frames) < 0) {
+        free(v->rx.slots);
+        free(v->rx.lens);
+        free(v);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    snprintf(v->name, sizeof(v->name), "vnic%d", vnic_count);
+    v->rx_irq = true;
+
+    v->nif.name = v->name;
+    v->nif.descr = "Virtual network device";
+    v->nif.index = vnic_count++;
+    v->nif.flags = NETIF_DETECTED;
+    memcpy(v->nif.mac_addr, mac, 6);
+    memset(v->nif.broadcast, 255, 4);
+    v->nif.mtu = 1500;
+
+    /* Set up the IPv6 link-local address from the MAC address, as for the
+       Ethernet devices (RFC 2464). */
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[0] = 0xFE;
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[1] = 0x80;
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[8] = mac[0] ^ 0x02;
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[9] = mac[1];
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[10] = mac[2];
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[11] = 0xFF;
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[12] = 0xFE;
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[13] = mac[3];
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[14] = mac[4];
+    v->nif.ip6_lladdr.__s6_addr.__s6_addr8[15] = mac[5];
+
+    v->nif.if_detect = vnic_if_detect;
+    v->nif.if_init = vnic_if_init;
+    v->nif.if_shutdown = vnic_if_shutdown;
+    v->nif.if_start = vnic_if_start;
+    v->nif.if_stop = vnic_if_stop;
+    v->nif.if_tx = vnic_if_tx;
+    v->nif.if_tx_commit = vnic_if_tx_commit;
+    v->nif.if_rx_poll = vnic_if_rx_poll;
+    v->nif.if_set_flags = vnic_if_set_flags;
+    v->nif.if_set_mc = vnic_if_set_mc;
+    v->nif.if_poll = vnic_if_poll;
+
+    /* It's ready to go straight away, even if net_init() already ran */
+    vnic_if_init(&v->nif);
+    vnic_if_start(&v->nif);
+    net_reg_device(&v->nif);
+
+    return &v->nif;
+}
+
+void net_vnic_destroy(netif_t *nif) {
+    vnic_t *v = (vnic_t *)nif;
+
+    vnic_if_stop(nif);
+    vnic_if_shutdown(nif);
+    net_unreg_device(nif);
+
+    if(net_default_dev == nif)
+        net_set_default(NULL);
+
+    free(v->rx.slots);
+    free(v->rx.lens);
+    free(v->tx.slots);
+    free(v->tx.lens);
+    free(v);
+}
+
+int net_vnic_inject(netif_t *nif, const uint8 *frame, int len) {
+    vnic_t *v = (vnic_t *)nif;
+
+    if(len < (int)sizeof(eth_hdr_t) || len > SLOT_SIZE) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    irq_disable_scoped();
+
+    if(!(nif->flags & NETIF_RUNNING) || v->rx.used == v->rx.count) {
+        v->stats.rx_dropped++;
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    ring_put(&v->rx, frame, len);
+    v->stats.rx_frames++;
+
+    if(v->rx_irq) {
+        v->rx_irq = false;
+        v->stats.rx_irqs++;
+        net_poll_schedule(nif);
+    }
+
+    return 0;
+}
+
+int net_vnic_capture(netif_t *nif, uint8 *buf, int len) {
+    vnic_t *v = (vnic_t *)nif;
+    int rv;
+
+    irq_disable_scoped();
+
+    if(!v->tx.used) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    rv = v->tx.lens[v->tx.tail];
+
+    if(rv > len)
+        rv = len;
+
+    memcpy(buf, v->tx.slots + v->tx.tail * SLOT_SIZE, rv);
+    v->tx.tail = (v->tx.tail + 1) % v->tx.count;
+    v->tx.used--;
+
+    return rv;
+}
+
+void net_vnic_get_stats(netif_t *nif, net_vnic_stats_t *stats) {
+    vnic_t *v = (vnic_t *)nif;
+
+    irq_disable_scoped();
+    *stats = v->stats;
+}
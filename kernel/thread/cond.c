@@ -3,10 +3,16 @@
    cond.c
    Copyright (C) 2001, 2003 Megan Potter
    Copyright (C) 2012 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /* Defines condition variables, which are like semaphores that automatically
-   signal all waiting processes when a signal() is called. */
+   signal all waiting processes when a signal() is called.
+
+   Waiting threads are counted, so that signalling a condvar nobody waits on
+   is a single load and doesn't need to disable interrupts. Waiters register
+   before they release the mutex, so a signal sent with the mutex held (or
+   after a predicate update made with the mutex held) can't miss them. */
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -40,7 +46,7 @@ condvar_t *cond_create(void) {
 }
 
 int cond_init(condvar_t *cv) {
-    cv->dummy = 0;
+    cv->waiters = 0;
     cv->dynamic = 0;
     return 0;
 }
@@ -75,11 +81,13 @@ int cond_wait_timed(condvar_t *cv, mutex_t *m, int timeout) {
     }
 
     /* First of all, release the associated mutex */
+    ++cv->waiters;
     mutex_unlock(m);
 
     /* Now block us until we're signaled */
     rv = genwait_wait(cv, timeout ? "cond_wait_timed" : "cond_wait", timeout,
                       NULL);
+    --cv->waiters;
 
     if(rv < 0 && errno == EAGAIN)
         errno = ETIMEDOUT;
@@ -95,6 +103,9 @@ int cond_wait(condvar_t *cv, mutex_t *m) {
 }
 
 int cond_signal(condvar_t *cv) {
+    if(!__atomic_load_n(&cv->waiters, __ATOMIC_ACQUIRE))
+        return 0;
+
     irq_disable_scoped();
 
     /* Wake one thread who's waiting, if any */
@@ -104,6 +115,9 @@ int cond_signal(condvar_t *cv) {
 }
 
 int cond_broadcast(condvar_t *cv) {
+    if(!__atomic_load_n(&cv->waiters, __ATOMIC_ACQUIRE))
+        return 0;
+
     irq_disable_scoped();
 
     /* Wake all threads who are waiting */
@@ -24,6 +24,7 @@
 #include <kos/dbglog.h>
 #include <kos/genwait.h>
 #include <kos/sem.h>
+#include <kos/trace.h>
 
 /* Our sleep queues table. This is also modeled after the BSD numbers. I
    figure if they've been using it as long as they have, they must be
@@ -70,6 +71,7 @@ static kthread_t * tq_next(void) {
 
 int genwait_wait(void * obj, const char * mesg, int timeout, void (*callback)(void *)) {
     kthread_t   * me;
+    int         rv;
 
     /* Twiddle interrupt state */
     if(irq_inside_int()) {
@@ -98,8 +100,14 @@ int genwait_wait(void * obj, const char * mesg, int timeout, void (*callback)(vo
     /* Insert us on the appropriate wait queue */
     TAILQ_INSERT_TAIL(&slpque[LOOKUP(obj)], me, thdq);
 
+    trace_event(TRACE_WAIT_BEGIN, mesg, (uintptr_t)obj);
+
     /* Block us until we're signaled */
-    return thd_block_now(&me->context);
+    rv = thd_block_now(&me->context);
+
+    trace_event(TRACE_WAIT_END, mesg, (uintptr_t)obj);
+
+    return rv;
 }
 
 /* Removes a thread from its wait queue; assumes ints are disabled. */
@@ -142,6 +150,8 @@ int genwait_wake_cnt(void * obj, int cntmax, int err) {
 
         /* Is this thread a match? */
         if(t->wait_obj == obj) {
+            trace_event(TRACE_WAKE, t->wait_msg, t->tid);
+
             /* Yes, remove it from the wait queue */
             genwait_unqueue(t);
 
@@ -200,6 +210,8 @@ int genwait_wake_thd(void *obj, kthread_t *thd, int err) {
 
         /* Is this thread a match? */
         if(t->wait_obj == obj && t == thd) {
+            trace_event(TRACE_WAKE, t->wait_msg, t->tid);
+
             /* Yes, remove it from the wait queue */
             genwait_unqueue(t);
 
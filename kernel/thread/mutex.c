@@ -3,9 +3,11 @@
    mutex.c
    Copyright (C) 2012, 2015 Lawrence Sebald
    Copyright (C) 2024 Paul Cercueil
+   Copyright (C) 2026 KallistiOS Contributors
 
 */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <limits.h>
@@ -13,6 +15,7 @@
 #include <kos/mutex.h>
 #include <kos/genwait.h>
 #include <kos/dbglog.h>
+#include <kos/trace.h>
 
 #include <arch/irq.h>
 #include <arch/timer.h>
@@ -20,6 +23,24 @@
 /* Thread pseudo-ptr representing an active IRQ context. */
 #define IRQ_THREAD  ((kthread_t *)0xFFFFFFFF)
 
+/* The holder field is the lock word of the mutex: a free mutex is taken with
+   a single compare-and-swap, and released with a single store. Interrupts are
+   only disabled on the slow paths, i.e. when a thread has to wait for the
+   mutex, or when an unlock has to wake up a waiter or drop a priority boost.
+
+   Waiters register themselves in the waiters count before they check the
+   holder one last time and go to sleep, and unlockers check that count only
+   after releasing the mutex. As the waiter does both with interrupts
+   disabled, either it sees the mutex released, or the unlocker sees it and
+   wakes it up. */
+
+static inline bool mutex_acquire(mutex_t *m, kthread_t *thd) {
+    kthread_t *expected = NULL;
+
+    return __atomic_compare_exchange_n(&m->holder, &expected, thd, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
 mutex_t *mutex_create(void) {
     mutex_t *rv;
 
@@ -35,6 +56,7 @@ mutex_t *mutex_create(void) {
     rv->dynamic = 1;
     rv->holder = NULL;
     rv->count = 0;
+    rv->waiters = 0;
 
     return rv;
 }
@@ -51,6 +73,7 @@ int mutex_init(mutex_t *m, int mtype) {
     m->dynamic = 0;
     m->holder = NULL;
     m->count = 0;
+    m->waiters = 0;
 
     return 0;
 }
@@ -63,7 +86,7 @@ int mutex_destroy(mutex_t *m) {
         return -1;
     }
 
-    if(m->count) {
+    if(m->holder) {
         /* Send an error if its busy */
         errno = EBUSY;
         return -1;
@@ -109,83 +132,96 @@ int mutex_lock_timed(mutex_t *m, int timeout) {
         return -1;
     }
 
-    irq_disable_scoped();
-
     if(m->type < MUTEX_TYPE_NORMAL || m->type > MUTEX_TYPE_RECURSIVE) {
         errno = EINVAL;
-        rv = -1;
+        return -1;
     }
-    else if(!m->count) {
+
+    /* Fast path: the mutex is free */
+    if(__likely(mutex_acquire(m, thd_current))) {
         m->count = 1;
-        m->holder = thd_current;
+        return 0;
     }
-    else if(m->type == MUTEX_TYPE_RECURSIVE && m->holder == thd_current) {
-        if(m->count == INT_MAX) {
-            errno = EAGAIN;
-            rv = -1;
-        }
-        else {
+
+    /* Only this thread can release a mutex it holds, so there's no need to
+       disable interrupts to check for that. */
+    if(m->holder == thd_current) {
+        if(m->type == MUTEX_TYPE_RECURSIVE) {
+            if(m->count == INT_MAX) {
+                errno = EAGAIN;
+                return -1;
+            }
+
             ++m->count;
+            return 0;
+        }
+        else if(m->type == MUTEX_TYPE_ERRORCHECK) {
+            errno = EDEADLK;
+            return -1;
         }
     }
-    else if(m->type == MUTEX_TYPE_ERRORCHECK && m->holder == thd_current) {
-        errno = EDEADLK;
-        rv = -1;
-    }
-    else {
-        if(timeout)
-            deadline = timer_ms_gettime64() + timeout;
-
-        for(;;) {
-            /* Check whether we should boost priority. */
-            if (m->holder->prio >= thd_current->prio) {
-                m->holder->prio = thd_current->prio;
-
-                /* Reschedule if currently scheduled. */
-                if(m->holder->state == STATE_READY) {
-                    /* Thread list is sorted by priority, update the position
-                     * of the thread holding the lock */
-                    thd_remove_from_runnable(m->holder);
-                    thd_add_to_runnable(m->holder, true);
-                }
-            }
 
-            rv = genwait_wait(m, timeout ? "mutex_lock_timed" : "mutex_lock",
-                              timeout, NULL);
-            if(rv < 0) {
-                errno = ETIMEDOUT;
-                break;
-            }
+    if(timeout)
+        deadline = timer_ms_gettime64() + timeout;
 
-            if(!m->holder) {
-                m->holder = thd_current;
-                m->count = 1;
-                break;
+    irq_disable_scoped();
+
+    trace_event(TRACE_LOCK_BEGIN, "mutex contention", (uintptr_t)m);
+
+    ++m->waiters;
+
+    for(;;) {
+        /* The holder may have released the mutex in the meantime. */
+        if(!m->holder) {
+            m->holder = thd_current;
+            m->count = 1;
+            break;
+        }
+
+        /* Check whether we should boost priority. */
+        if(m->holder != IRQ_THREAD && m->holder->prio >= thd_current->prio) {
+            m->holder->prio = thd_current->prio;
+
+            /* Reschedule if currently scheduled. */
+            if(m->holder->state == STATE_READY) {
+                /* Thread list is sorted by priority, update the position
+                 * of the thread holding the lock */
+                thd_remove_from_runnable(m->holder);
+                thd_add_to_runnable(m->holder, true);
             }
+        }
 
-            if(timeout) {
-                timeout = deadline - timer_ms_gettime64();
-                if(timeout <= 0) {
-                    errno = ETIMEDOUT;
-                    rv = -1;
-                    break;
-                }
+        rv = genwait_wait(m, timeout ? "mutex_lock_timed" : "mutex_lock",
+                          timeout, NULL);
+        if(rv < 0) {
+            errno = ETIMEDOUT;
+            break;
+        }
+
+        if(timeout) {
+            timeout = deadline - timer_ms_gettime64();
+            if(timeout <= 0) {
+                errno = ETIMEDOUT;
+                rv = -1;
+                break;
             }
         }
     }
 
+    --m->waiters;
+
+    trace_event(TRACE_LOCK_END, "mutex contention", (uintptr_t)m);
+
     return rv;
 }
 
 int mutex_is_locked(mutex_t *m) {
-    return !!m->count;
+    return !!m->holder;
 }
 
 int mutex_trylock(mutex_t *m) {
     kthread_t *thd = thd_current;
 
-    irq_disable_scoped();
-
     /* If we're inside of an interrupt, pick a special value for the thread that
        would otherwise be impossible... */
     if(irq_inside_int())
@@ -196,50 +232,36 @@ int mutex_trylock(mutex_t *m) {
         return -1;
     }
 
+    if(mutex_acquire(m, thd)) {
+        m->count = 1;
+        return 0;
+    }
+
     /* Check if the lock is held by some other thread already */
-    if(m->count && m->holder != thd) {
+    if(m->holder != thd) {
         errno = EBUSY;
         return -1;
     }
 
-    m->holder = thd;
-
-    switch(m->type) {
-        case MUTEX_TYPE_NORMAL:
-        case MUTEX_TYPE_OLDNORMAL:
-        case MUTEX_TYPE_ERRORCHECK:
-            if(m->count) {
-                errno = EDEADLK;
-                return -1;
-            }
-
-            m->count = 1;
-            break;
-
-        case MUTEX_TYPE_RECURSIVE:
-            if(m->count == INT_MAX) {
-                errno = EAGAIN;
-                return -1;
-            }
+    if(m->type != MUTEX_TYPE_RECURSIVE) {
+        errno = EDEADLK;
+        return -1;
+    }
 
-            ++m->count;
-            break;
+    if(m->count == INT_MAX) {
+        errno = EAGAIN;
+        return -1;
     }
 
+    ++m->count;
+
     return 0;
 }
 
 static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
-    int wakeup = 0;
-
-    irq_disable_scoped();
-
     switch(m->type) {
         case MUTEX_TYPE_NORMAL:
         case MUTEX_TYPE_OLDNORMAL:
-            m->count = 0;
-            m->holder = NULL;
-            wakeup = 1;
             break;
 
         case MUTEX_TYPE_ERRORCHECK:
@@ -247,10 +269,6 @@ static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
                 errno = EPERM;
                 return -1;
             }
-
-            m->count = 0;
-            m->holder = NULL;
-            wakeup = 1;
             break;
 
         case MUTEX_TYPE_RECURSIVE:
@@ -259,10 +277,8 @@ static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
                 return -1;
             }
 
-            if(!--m->count) {
-                m->holder = NULL;
-                wakeup = 1;
-            }
+            if(--m->count)
+                return 0;
             break;
 
         default:
@@ -270,13 +286,20 @@ static int mutex_unlock_common(mutex_t *m, kthread_t *thd) {
             return -1;
     }
 
-    /* If we need to wake up a thread, do so. */
-    if(wakeup) {
-        /* Restore real priority in case we were dynamically boosted. */
-        if (thd != IRQ_THREAD)
+    m->count = 0;
+    __atomic_store_n(&m->holder, NULL, __ATOMIC_SEQ_CST);
+
+    /* Slow path: wake up a waiter, and restore our real priority in case we
+       were dynamically boosted by one. */
+    if(__atomic_load_n(&m->waiters, __ATOMIC_SEQ_CST) ||
+       (thd != IRQ_THREAD && thd->prio != thd->real_prio)) {
+        irq_disable_scoped();
+
+        if(thd != IRQ_THREAD)
             thd->prio = thd->real_prio;
 
-        genwait_wake_one(m);
+        if(m->waiters)
+            genwait_wake_one(m);
     }
 
     return 0;
@@ -2,10 +2,22 @@
 
    rwsem.c
    Copyright (C) 2008, 2012 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /* Defines reader/writer semaphores */
 
+/* Readers take the lock by atomically incrementing the reader count, and
+   checking the write lock afterwards; writers check the reader count after
+   setting the write lock, with interrupts disabled. One of the two always
+   sees the other, and if a reader sees a writer, it backs off by releasing
+   its read lock and takes the slow path. Uncontended read locks and unlocks
+   therefore don't need to disable interrupts.
+
+   A backing off reader may wake up a writer when it shouldn't, so the slow
+   paths re-check their condition after waking up. */
+
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -14,6 +26,58 @@
 #include <kos/genwait.h>
 #include <kos/dbglog.h>
 
+#include <arch/timer.h>
+
+/* Take a read lock if the write lock isn't held. */
+static inline bool rwsem_read_acquire(rw_semaphore_t *s) {
+    __atomic_add_fetch(&s->read_count, 1, __ATOMIC_SEQ_CST);
+
+    return !__atomic_load_n(&s->write_lock, __ATOMIC_SEQ_CST);
+}
+
+/* Drop a read lock, and wake up a writer if this was the last reader. */
+static void rwsem_read_release(rw_semaphore_t *s) {
+    if(__atomic_sub_fetch(&s->read_count, 1, __ATOMIC_RELEASE))
+        return;
+
+    irq_disable_scoped();
+
+    /* A new reader may have come in before interrupts were disabled */
+    if(s->read_count)
+        return;
+
+    if(s->reader_waiting) {
+        genwait_wake_thd(&s->write_lock, s->reader_waiting, 0);
+        s->reader_waiting = NULL;
+    }
+    else {
+        genwait_wake_one(&s->write_lock);
+    }
+}
+
+/* Wait on the given object until woken up, updating the timeout. Must be
+   called with interrupts disabled. */
+static int rwsem_wait(void *obj, const char *mesg, int *timeout,
+                      uint64_t deadline) {
+    if(genwait_wait(obj, mesg, *timeout, NULL) < 0) {
+        if(errno == EAGAIN)
+            errno = ETIMEDOUT;
+
+        return -1;
+    }
+
+    if(*timeout) {
+        *timeout = deadline - timer_ms_gettime64();
+
+        if(*timeout <= 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /* Allocate a new reader/writer semaphore */
 rw_semaphore_t *rwsem_create(void) {
     rw_semaphore_t *s;
@@ -62,6 +126,7 @@ int rwsem_destroy(rw_semaphore_t *s) {
 
 /* Lock a reader/writer semaphore for reading */
 int rwsem_read_lock_timed(rw_semaphore_t *s, int timeout) {
+    uint64_t deadline = 0;
     int rv = 0;
 
     if((rv = irq_inside_int())) {
@@ -78,28 +143,27 @@ int rwsem_read_lock_timed(rw_semaphore_t *s, int timeout) {
         return -1;
     }
 
+    /* Fast path: the write lock is not held */
+    if(__likely(rwsem_read_acquire(s)))
+        return 0;
+
+    rwsem_read_release(s);
+
+    if(timeout)
+        deadline = timer_ms_gettime64() + timeout;
+
     irq_disable_scoped();
 
-    /* If the write lock is not held, let the thread proceed */
-    if(!s->write_lock) {
-        ++s->read_count;
+    /* Block until the write lock is not held any more */
+    while(s->write_lock) {
+        if(rwsem_wait(s, deadline ? "rwsem_read_lock_timed" :
+                      "rwsem_read_lock", &timeout, deadline))
+            return -1;
     }
-    else {
-        /* Block until the write lock is not held any more */
-        rv = genwait_wait(s, timeout ? "rwsem_read_lock_timed" :
-                          "rwsem_read_lock", timeout, NULL);
 
-        if(rv < 0) {
-            rv = -1;
-            if(errno == EAGAIN)
-                errno = ETIMEDOUT;
-        }
-        else {
-            ++s->read_count;
-        }
-    }
+    ++s->read_count;
 
-    return rv;
+    return 0;
 }
 
 int rwsem_read_lock(rw_semaphore_t *s) {
@@ -115,7 +179,7 @@ int rwsem_read_lock_irqsafe(rw_semaphore_t *s) {
 
 /* Lock a reader/writer semaphore for writing */
 int rwsem_write_lock_timed(rw_semaphore_t *s, int timeout) {
-    int rv = 0;
+    uint64_t deadline = 0;
 
     if(irq_inside_int()) {
         dbglog(DBG_WARNING, "rwsem_write_lock_timed: called inside "
@@ -129,30 +193,22 @@ int rwsem_write_lock_timed(rw_semaphore_t *s, int timeout) {
         return -1;
     }
 
+    if(timeout)
+        deadline = timer_ms_gettime64() + timeout;
+
     irq_disable_scoped();
 
-    /* If the write lock is not held and there are no readers in their critical
-       sections, let the thread proceed. */
-    if(!s->write_lock && !s->read_count) {
-        s->write_lock = thd_current;
+    /* Block until the write lock is not held and there are no readers
+       inside their critical sections */
+    while(s->write_lock || s->read_count) {
+        if(rwsem_wait(&s->write_lock, deadline ? "rwsem_write_lock_timed" :
+                      "rwsem_write_lock", &timeout, deadline))
+            return -1;
     }
-    else {
-        /* Block until the write lock is not held and there are no readers
-           inside their critical sections */
-        rv = genwait_wait(&s->write_lock, timeout ? "rwsem_write_lock_timed" :
-                          "rwsem_write_lock", timeout, NULL);
 
-        if(rv < 0) {
-            rv = -1;
-            if(errno == EAGAIN)
-                errno = ETIMEDOUT;
-        }
-        else {
-            s->write_lock = thd_current;
-        }
-    }
+    s->write_lock = thd_current;
 
-    return rv;
+    return 0;
 }
 
 int rwsem_write_lock(rw_semaphore_t *s) {
@@ -168,25 +224,12 @@ int rwsem_write_lock_irqsafe(rw_semaphore_t *s) {
 
 /* Unlock a reader/writer semaphore from a read lock. */
 int rwsem_read_unlock(rw_semaphore_t *s) {
-    irq_disable_scoped();
-
-    if(!s->read_count) {
+    if(__atomic_load_n(&s->read_count, __ATOMIC_RELAXED) <= 0) {
         errno = EPERM;
         return -1;
     }
 
-    --s->read_count;
-
-    /* If this was the last reader, attempt to wake any writers waiting. */
-    if(!s->read_count) {
-        if(s->reader_waiting) {
-            genwait_wake_thd(&s->write_lock, s->reader_waiting, 0);
-            s->reader_waiting = NULL;
-        }
-        else {
-            genwait_wake_one(&s->write_lock);
-        }
-    }
+    rwsem_read_release(s);
 
     return 0;
 }
@@ -233,15 +276,13 @@ int rwsem_unlock(rw_semaphore_t *s) {
 
 /* Attempt to lock a reader/writer semaphore for reading, but do not block. */
 int rwsem_read_trylock(rw_semaphore_t *s) {
-    irq_disable_scoped();
-
     /* Is the write lock held? */
-    if(s->write_lock) {
+    if(!rwsem_read_acquire(s)) {
+        rwsem_read_release(s);
         errno = EWOULDBLOCK;
         return -1;
     }
 
-    ++s->read_count;
     return 0;
 }
 
@@ -3,12 +3,20 @@
    sem.c
    Copyright (C) 2001, 2002, 2003 Megan Potter
    Copyright (C) 2012, 2020 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /* Defines semaphores */
 
+/* A positive count can be taken, and a non-negative one incremented, with a
+   single compare-and-swap and without disabling interrupts. Interrupts are
+   only disabled when a thread has to wait, or has to be woken up. A negative
+   count is the number of waiting threads, and is only changed with interrupts
+   disabled, so the compare-and-swap can't succeed behind their back. */
+
 /**************************************/
 
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -22,6 +30,23 @@
 
 /**************************************/
 
+/* Take one tick if the count is positive. */
+static inline bool sem_take(semaphore_t *sm) {
+    int count = __atomic_load_n(&sm->count, __ATOMIC_RELAXED);
+
+    while(count > 0) {
+        if(__atomic_compare_exchange_n(&sm->count, &count, count - 1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+
+    return false;
+}
+
+static inline bool sem_valid(const semaphore_t *sm) {
+    return sm->initialized == 1 || sm->initialized == 2;
+}
+
 /* Allocate a new semaphore; the semaphore will be assigned
    to the calling process and when that process dies, the semaphore
    will also die. */
@@ -100,15 +125,20 @@ int sem_wait_timed(semaphore_t *sem, int timeout) {
         return -1;
     }
 
+    if(!sem_valid(sem)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Fast path: there's enough count left */
+    if(__likely(sem_take(sem)))
+        return 0;
+
     /* Disable interrupts */
     irq_disable_scoped();
 
-    if(sem->initialized != 1 && sem->initialized != 2) {
-        errno = EINVAL;
-        rv = -1;
-    }
     /* If there's enough count left, then let the thread proceed */
-    else if(sem->count > 0) {
+    if(sem->count > 0) {
         sem->count--;
     }
     else {
@@ -137,49 +167,50 @@ int sem_wait(semaphore_t *sm) {
 /* Attempt to wait on a semaphore. If the semaphore would block,
    then return an error instead of actually blocking. */
 int sem_trywait(semaphore_t *sm) {
-    int rv = 0;
-
-    irq_disable_scoped();
-
-    if(sm->initialized != 1 && sm->initialized != 2) {
+    if(!sem_valid(sm)) {
         errno = EINVAL;
-        rv = -1;
+        return -1;
     }
+
     /* Is there enough count left? */
-    else if(sm->count > 0) {
-        sm->count--;
-    }
-    else {
-        rv = -1;
+    if(!sem_take(sm)) {
         errno = EWOULDBLOCK;
+        return -1;
     }
 
-    return rv;
+    return 0;
 }
 
 /* Signal a semaphore */
 int sem_signal(semaphore_t *sm) {
-    int woken, rv = 0;
-
-    irq_disable_scoped();
+    int woken, count;
 
-    if(sm->initialized != 1 && sm->initialized != 2) {
+    if(!sem_valid(sm)) {
         errno = EINVAL;
-        rv = -1;
+        return -1;
+    }
+
+    /* Fast path: no one is waiting, so just add another tick */
+    count = __atomic_load_n(&sm->count, __ATOMIC_RELAXED);
+
+    while(count >= 0) {
+        if(__atomic_compare_exchange_n(&sm->count, &count, count + 1, false,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return 0;
     }
+
+    irq_disable_scoped();
+
     /* Is there anyone waiting? If so, pass off to them */
-    else if(sm->count < 0) {
+    if(sm->count < 0) {
         woken = genwait_wake_cnt(sm, 1, 0);
         (void)woken;
         assert(woken == 1);
-        sm->count++;
-    }
-    else {
-        /* No one is waiting, so just add another tick */
-        sm->count++;
     }
 
-    return rv;
+    sm->count++;
+
+    return 0;
 }
 
 /* Return the semaphore count */
@@ -0,0 +1,598 @@
+/* KallistiOS ##version##
+
+   task.c
+   Copyright (C) 2026 KallistiOS Contributors
+*/
+
+/* Task pools, built on top of the threaded workers. All the threads of a pool
+   share a ready queue sorted by priority; a worker thread is woken up when a
+   task becomes ready while it is idle, and drains the queue before going back
+   to sleep.
+
+   Tasks are reference counted: the creator holds one reference, the pool holds
+   one from submission to completion, and each task holds one on every task
+   depending on it until it completes. As everything else in the threading
+   code, the state of tasks and pools is protected by disabling interrupts. */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+
+#include <kos/genwait.h>
+#include <kos/task.h>
+#include <kos/thread.h>
+#include <kos/worker_thread.h>
+
+#include <arch/irq.h>
+#include <arch/timer.h>
+
+typedef enum task_state {
+    TASK_NEW,           /* Created, not submitted yet */
+    TASK_WAITING,       /* Submitted, waiting on dependencies */
+    TASK_READY,         /* In the ready queue of its pool */
+    TASK_RUNNING,       /* Picked up by a worker thread */
+    TASK_DONE           /* Completed */
+} task_state_t;
+
+/* A link from a task to one of the tasks that depend on it */
+typedef struct task_link {
+    struct task_link *next;
+    kthread_task_t *task;
+} task_link_t;
+
+struct kthread_task {
+    TAILQ_ENTRY(kthread_task) entry;
+
+    void *(*routine)(void *);
+    void *data;
+    void *rv;
+
+    kthread_pool_t *pool;
+    prio_t prio;
+    task_state_t state;
+
+    /* Number of dependencies that haven't completed yet */
+    int deps;
+
+    int refs;
+
+    /* Tasks that depend on this one */
+    task_link_t *dependents;
+};
+
+typedef struct pool_worker {
+    kthread_worker_t *worker;
+    kthread_pool_t *pool;
+    bool idle;
+} pool_worker_t;
+
+struct kthread_pool {
+    TAILQ_HEAD(task_queue, kthread_task) ready;
+
+    /* Number of tasks submitted that haven't completed yet */
+    size_t pending;
+    bool draining;
+
+    size_t count;
+    pool_worker_t workers[];
+};
+
+/* State of a parallel-for loop */
+typedef struct pfor {
+    void (*routine)(size_t start, size_t end, void *data);
+    void *data;
+    size_t count;
+    size_t grain;
+    size_t next;
+} pfor_t;
+
+static void task_unref(kthread_task_t *task) {
+    if(__atomic_sub_fetch(&task->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    free(task);
+}
+
+/* Queue a task behind all the ready tasks of the same or higher priority, and
+   wake up an idle worker thread to run it. Must be called with interrupts
+   disabled. */
+static void task_enqueue(kthread_task_t *task) {
+    kthread_pool_t *pool = task->pool;
+    kthread_task_t *prev;
+    size_t i;
+
+    task->state = TASK_READY;
+
+    TAILQ_FOREACH_REVERSE(prev, &pool->ready, task_queue, entry) {
+        if(prev->prio <= task->prio)
+            break;
+    }
+
+    if(prev)
+        TAILQ_INSERT_AFTER(&pool->ready, prev, task, entry);
+    else
+        TAILQ_INSERT_HEAD(&pool->ready, task, entry);
+
+    for(i = 0; i < pool->count; i++) {
+        if(pool->workers[i].idle) {
+            pool->workers[i].idle = false;
+            thd_worker_wakeup(pool->workers[i].worker);
+            break;
+        }
+    }
+}
+
+/* Take the dependents of a task, and make the ones that were only waiting for
+   it ready. Must be called with interrupts disabled; the links that are
+   returned must then be passed to task_free_links(). */
+static task_link_t *task_release(kthread_task_t *task) {
+    task_link_t *link = task->dependents, *next;
+    kthread_task_t *dep;
+
+    task->dependents = NULL;
+
+    for(next = link; next; next = next->next) {
+        dep = next->task;
+
+        if(!--dep->deps && dep->state == TASK_WAITING)
+            task_enqueue(dep);
+    }
+
+    return link;
+}
+
+/* Free links taken by task_release(), along with their references */
+static void task_free_links(task_link_t *link) {
+    task_link_t *next;
+
+    while(link) {
+        next = link->next;
+        task_unref(link->task);
+        free(link);
+        link = next;
+    }
+}
+
+/* Mark a task as completed, and make the tasks that depend on it ready if this
+   was their last dependency. */
+static void task_complete(kthread_task_t *task, void *rv) {
+    kthread_pool_t *pool = task->pool;
+    task_link_t *link;
+    uint32_t flags;
+
+    flags = irq_disable();
+
+    task->rv = rv;
+    task->state = TASK_DONE;
+
+    link = task_release(task);
+
+    genwait_wake_all(task);
+
+    if(!--pool->pending && pool->draining)
+        genwait_wake_all(pool);
+
+    irq_restore(flags);
+
+    task_free_links(link);
+
+    /* Drop the reference of the pool */
+    task_unref(task);
+}
+
+/* Work function of the worker threads */
+static void thd_pool_worker(void *d) {
+    pool_worker_t *pw = d;
+    kthread_pool_t *pool = pw->pool;
+    kthread_task_t *task;
+    uint32_t flags;
+
+    for(;;) {
+        flags = irq_disable();
+
+        task = TAILQ_FIRST(&pool->ready);
+        if(!task) {
+            pw->idle = true;
+            irq_restore(flags);
+            break;
+        }
+
+        TAILQ_REMOVE(&pool->ready, task, entry);
+        task->state = TASK_RUNNING;
+
+        irq_restore(flags);
+
+        task_complete(task, task->routine(task->data));
+    }
+}
+
+kthread_pool_t *thd_pool_create(const kthread_attr_t *attr, size_t threads) {
+    kthread_attr_t real_attr = { false, 0, NULL, 0, NULL };
+    kthread_pool_t *pool;
+    size_t i;
+
+    if(!threads) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if(attr)
+        real_attr = *attr;
+
+    /* The workers are joined when the pool is destroyed */
+    real_attr.create_detached = false;
+
+    if(!real_attr.label)
+        real_attr.label = "[task pool]";
+
+    pool = malloc(sizeof(*pool) + threads * sizeof(pool_worker_t));
+    if(!pool) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    TAILQ_INIT(&pool->ready);
+    pool->pending = 0;
+    pool->draining = false;
+    pool->count = threads;
+
+    for(i = 0; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].idle = true;
+        pool->workers[i].worker = thd_worker_create_ex(&real_attr,
+                                                       thd_pool_worker,
+                                                       &pool->workers[i]);
+
+        if(!pool->workers[i].worker) {
+            while(i--)
+                thd_worker_destroy(pool->workers[i].worker);
+
+            free(pool);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void thd_pool_destroy(kthread_pool_t *pool) {
+    uint32_t flags;
+    size_t i;
+
+    assert(pool != NULL);
+
+    flags = irq_disable();
+
+    pool->draining = true;
+
+    while(pool->pending)
+        genwait_wait(pool, "thd_pool_destroy", 0, NULL);
+
+    irq_restore(flags);
+
+    for(i = 0; i < pool->count; i++)
+        thd_worker_destroy(pool->workers[i].worker);
+
+    free(pool);
+}
+
+size_t thd_pool_get_threads(const kthread_pool_t *pool) {
+    return pool->count;
+}
+
+kthread_task_t *thd_task_create(void *(*routine)(void *), void *data) {
+    kthread_task_t *task;
+
+    assert(routine != NULL);
+
+    task = malloc(sizeof(*task));
+    if(!task) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    task->routine = routine;
+    task->data = data;
+    task->rv = NULL;
+    task->pool = NULL;
+    task->prio = PRIO_DEFAULT;
+    task->state = TASK_NEW;
+    task->deps = 0;
+    task->refs = 1;
+    task->dependents = NULL;
+
+    return task;
+}
+
+void thd_task_destroy(kthread_task_t *task) {
+    task_link_t *link = NULL;
+    uint32_t flags;
+
+    if(!task)
+        return;
+
+    /* A task that was never submitted will never complete, so the tasks that
+       depend on it stop waiting for it. */
+    flags = irq_disable();
+
+    if(task->state == TASK_NEW)
+        link = task_release(task);
+
+    irq_restore(flags);
+
+    task_free_links(link);
+    task_unref(task);
+}
+
+int thd_task_set_prio(kthread_task_t *task, prio_t prio) {
+    if(task->state != TASK_NEW) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    task->prio = prio;
+
+    return 0;
+}
+
+int thd_task_depend(kthread_task_t *task, kthread_task_t *dep) {
+    task_link_t *link;
+    uint32_t flags;
+
+    if(task == dep) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    link = malloc(sizeof(*link));
+    if(!link) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    flags = irq_disable();
+
+    if(task->state != TASK_NEW) {
+        irq_restore(flags);
+        free(link);
+        errno = EBUSY;
+        return -1;
+    }
+
+    if(dep->state == TASK_DONE) {
+        irq_restore(flags);
+        free(link);
+        return 0;
+    }
+
+    link->task = task;
+    link->next = dep->dependents;
+    dep->dependents = link;
+
+    ++task->deps;
+    __atomic_add_fetch(&task->refs, 1, __ATOMIC_RELAXED);
+
+    irq_restore(flags);
+
+    return 0;
+}
+
+int thd_task_submit(kthread_pool_t *pool, kthread_task_t *task) {
+    irq_disable_scoped();
+
+    if(task->state != TASK_NEW) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    __atomic_add_fetch(&task->refs, 1, __ATOMIC_RELAXED);
+
+    task->pool = pool;
+    ++pool->pending;
+
+    if(task->deps)
+        task->state = TASK_WAITING;
+    else
+        task_enqueue(task);
+
+    return 0;
+}
+
+kthread_task_t *thd_task_run(kthread_pool_t *pool,
+                             void *(*routine)(void *), void *data) {
+    kthread_task_t *task;
+
+    task = thd_task_create(routine, data);
+    if(task)
+        thd_task_submit(pool, task);
+
+    return task;
+}
+
+bool thd_task_done(const kthread_task_t *task) {
+    return __atomic_load_n(&task->state, __ATOMIC_ACQUIRE) == TASK_DONE;
+}
+
+int thd_task_wait_timed(kthread_task_t *task, void **rv, int timeout) {
+    uint64_t deadline = 0;
+
+    if(irq_inside_int()) {
+        errno = EPERM;
+        return -1;
+    }
+
+    if(timeout)
+        deadline = timer_ms_gettime64() + timeout;
+
+    irq_disable_scoped();
+
+    while(task->state != TASK_DONE) {
+        if(genwait_wait(task, "thd_task_wait", timeout, NULL) < 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+
+        if(timeout) {
+            timeout = deadline - timer_ms_gettime64();
+
+            if(timeout <= 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+    }
+
+    if(rv)
+        *rv = task->rv;
+
+    return 0;
+}
+
+/* Take a ready task out of the queue of its pool, and complete it without
+   running it. Returns false if a worker thread already picked it up. */
+static bool task_cancel(kthread_task_t *task) {
+    uint32_t flags;
+
+    flags = irq_disable();
+
+    if(task->state != TASK_READY) {
+        irq_restore(flags);
+        return false;
+    }
+
+    TAILQ_REMOVE(&task->pool->ready, task, entry);
+    task->state = TASK_RUNNING;
+
+    irq_restore(flags);
+
+    task_complete(task, NULL);
+
+    return true;
+}
+
+static void pfor_run(pfor_t *p) {
+    size_t start, end;
+
+    for(;;) {
+        start = __atomic_fetch_add(&p->next, p->grain, __ATOMIC_RELAXED);
+        if(start >= p->count)
+            break;
+
+        end = p->count - start < p->grain ? p->count : start + p->grain;
+        p->routine(start, end, p->data);
+    }
+}
+
+static void *pfor_task(void *d) {
+    pfor_run(d);
+    return NULL;
+}
+
+int thd_pool_parallel_for(kthread_pool_t *pool, size_t count, size_t grain,
+                          void (*routine)(size_t start, size_t end,
+                                          void *data),
+                          void *data) {
+    pfor_t p = { routine, data, count, grain, 0 };
+    kthread_task_t **tasks;
+    size_t i, chunks, helpers;
+    int rv = 0;
+
+    if(!count)
+        return 0;
+
+    /* Aim for a few chunks per thread, to balance the load */
+    if(!p.grain)
+        p.grain = count / ((pool->count + 1) * 4) ?: 1;
+
+    chunks = (count - 1) / p.grain + 1;
+    helpers = chunks - 1 < pool->count ? chunks - 1 : pool->count;
+
+    tasks = helpers ? malloc(helpers * sizeof(*tasks)) : NULL;
+    if(helpers && !tasks) {
+        helpers = 0;
+        errno = ENOMEM;
+        rv = -1;
+    }
+
+    for(i = 0; i < helpers; i++) {
+        tasks[i] = thd_task_run(pool, pfor_task, &p);
+
+        if(!tasks[i]) {
+            helpers = i;
+            rv = -1;
+            break;
+        }
+    }
+
+    pfor_run(&p);
+
+    /* Helpers that didn't start yet have nothing left to do. Cancel them
+       rather than waiting for a worker thread to pick them up, as the worker
+       threads might all be busy waiting as well. */
+    for(i = 0; i < helpers; i++) {
+        if(!task_cancel(tasks[i]))
+            thd_task_wait(tasks[i], NULL);
+
+        thd_task_destroy(tasks[i]);
+    }
+
+    free(tasks);
+
+    return rv;
+}
+
+void thd_latch_init(kthread_latch_t *latch, int count) {
+    latch->count = count;
+}
+
+void thd_latch_count_down(kthread_latch_t *latch, int n) {
+    irq_disable_scoped();
+
+    if(latch->count <= 0)
+        return;
+
+    latch->count -= n;
+
+    if(latch->count <= 0) {
+        latch->count = 0;
+        genwait_wake_all(latch);
+    }
+}
+
+bool thd_latch_done(const kthread_latch_t *latch) {
+    return __atomic_load_n(&latch->count, __ATOMIC_ACQUIRE) <= 0;
+}
+
+int thd_latch_wait_timed(kthread_latch_t *latch, int timeout) {
+    uint64_t deadline = 0;
+
+    if(irq_inside_int()) {
+        errno = EPERM;
+        return -1;
+    }
+
+    if(timeout)
+        deadline = timer_ms_gettime64() + timeout;
+
+    irq_disable_scoped();
+
+    while(latch->count > 0) {
+        if(genwait_wait(latch, "thd_latch_wait", timeout, NULL) < 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+
+        if(timeout) {
+            timeout = deadline - timer_ms_gettime64();
+
+            if(timeout <= 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -5,6 +5,7 @@
    Copyright (C) 2010, 2016, 2023 Lawrence Sebald
    Copyright (C) 2023 Colton Pawielski
    Copyright (C) 2023, 2024 Falco Girgis
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <assert.h>
@@ -25,6 +26,7 @@
 #include <kos/rwsem.h>
 #include <kos/cond.h>
 #include <kos/genwait.h>
+#include <kos/trace.h>
 
 #include <arch/irq.h>
 #include <arch/timer.h>
@@ -81,6 +83,24 @@ static size_t thd_count = 0;
 /* The idle task */
 static kthread_t *thd_idle_thd = NULL;
 
+/*****************************************************************************/
+/* Thread recycling cache */
+
+/* Thread stacks are cached by size class, each class being a power of two
+   between 1 KiB and 256 KiB. Other sizes are never cached. */
+#define THD_CACHE_MIN_STACK     1024
+#define THD_CACHE_CLASSES       9
+
+/* Recycled control blocks, linked through their t_list entry. */
+static struct ktlist thd_cache_list;
+static size_t thd_cache_count = 0;
+static size_t thd_cache_max = 0;
+
+/* Recycled stacks, linked through their first word. */
+static void *thd_stack_cache[THD_CACHE_CLASSES];
+static size_t thd_stack_cache_size = 0;
+static size_t thd_stack_cache_max = 0;
+
 /*****************************************************************************/
 /* Debug */
 
@@ -271,6 +291,10 @@ static void thd_birth(void *(*routine)(void *param), void *param) {
 
 /* Terminate the current thread */
 void thd_exit(void *rv) {
+    /* Call the destructors of thread-local storage values. This has to happen
+       in the context of the exiting thread, as they may use TLS themselves. */
+    kthread_tls_run_destructors();
+
     /* The thread's never coming back so we don't need to bother saving the
        interrupt state at all. Disable interrupts just to make sure nothing
        changes underneath us while we're doing our thing here */
@@ -360,6 +384,113 @@ int thd_remove_from_runnable(kthread_t *thd) {
     return 0;
 }
 
+/* Get the size class of a stack, or -1 if it is too large to be cached. */
+static int thd_stack_class(size_t size) {
+    int c;
+
+    for(c = 0; c < THD_CACHE_CLASSES; c++) {
+        if(size <= ((size_t)THD_CACHE_MIN_STACK << c))
+            return c;
+    }
+
+    return -1;
+}
+
+/* Allocate a control block, from the cache if possible. Must be called with
+   interrupts disabled. */
+static kthread_t *thd_alloc(void) {
+    kthread_t *thd = LIST_FIRST(&thd_cache_list);
+
+    if(thd) {
+        LIST_REMOVE(thd, t_list);
+        --thd_cache_count;
+        return thd;
+    }
+
+    return aligned_alloc(32, sizeof(kthread_t));
+}
+
+/* Return a control block to the cache, or free it if the cache is full. Must
+   be called with interrupts disabled. */
+static void thd_free(kthread_t *thd) {
+    if(thd_cache_count < thd_cache_max) {
+        LIST_INSERT_HEAD(&thd_cache_list, thd, t_list);
+        ++thd_cache_count;
+    }
+    else {
+        free(thd);
+    }
+}
+
+/* Allocate a stack, from the cache if possible. When the stack cache is
+   enabled, the size is rounded up to its size class, so that the stack can be
+   recycled later. Must be called with interrupts disabled. */
+static void *thd_stack_alloc(size_t *size) {
+    void *stack;
+    int c;
+
+    if(thd_stack_cache_max && (c = thd_stack_class(*size)) >= 0) {
+        *size = (size_t)THD_CACHE_MIN_STACK << c;
+        stack = thd_stack_cache[c];
+
+        if(stack) {
+            thd_stack_cache[c] = *(void **)stack;
+            thd_stack_cache_size -= *size;
+            return stack;
+        }
+    }
+
+    return malloc(*size);
+}
+
+/* Return a stack to the cache, or free it if it doesn't fit. Must be called
+   with interrupts disabled. */
+static void thd_stack_free(void *stack, size_t size) {
+    int c = thd_stack_class(size);
+
+    if(c >= 0 && size == ((size_t)THD_CACHE_MIN_STACK << c) &&
+       thd_stack_cache_size + size <= thd_stack_cache_max) {
+        *(void **)stack = thd_stack_cache[c];
+        thd_stack_cache[c] = stack;
+        thd_stack_cache_size += size;
+    }
+    else {
+        free(stack);
+    }
+}
+
+/* Free cached control blocks and stacks until the cache fits its limits,
+   largest stacks first. Must be called with interrupts disabled. */
+static void thd_cache_trim(void) {
+    kthread_t *thd;
+    void *stack;
+    int c;
+
+    while(thd_cache_count > thd_cache_max) {
+        thd = LIST_FIRST(&thd_cache_list);
+        LIST_REMOVE(thd, t_list);
+        --thd_cache_count;
+        free(thd);
+    }
+
+    for(c = THD_CACHE_CLASSES - 1; c >= 0; c--) {
+        while(thd_stack_cache[c] && thd_stack_cache_size > thd_stack_cache_max) {
+            stack = thd_stack_cache[c];
+            thd_stack_cache[c] = *(void **)stack;
+            thd_stack_cache_size -= (size_t)THD_CACHE_MIN_STACK << c;
+            free(stack);
+        }
+    }
+}
+
+void thd_set_cache_limits(size_t threads, size_t stack_bytes) {
+    irq_disable_scoped();
+
+    thd_cache_max = threads;
+    thd_stack_cache_max = stack_bytes;
+    thd_cache_trim();
+}
+
 /* New thread function; given a routine address, it will create a
    new kernel thread with the given attributes. When the routine
    returns, the thread will exit. Returns the new thread struct. */
@@ -393,7 +524,7 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
 
     if(tid >= 0) {
         /* Create a new thread structure */
-        nt = aligned_alloc(32, sizeof(kthread_t));
+        nt = thd_alloc();
 
         if(nt != NULL) {
             /* Clear out potentially unused stuff */
@@ -404,10 +535,10 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
 
             /* Create a new thread stack */
             if(!real_attr.stack_ptr) {
-                nt->stack = (uint32_t*)malloc(real_attr.stack_size);
+                nt->stack = (uint32_t*)thd_stack_alloc(&real_attr.stack_size);
 
                 if(!nt->stack) {
-                    free(nt);
+                    thd_free(nt);
                     return NULL;
                 }
 
@@ -432,8 +563,8 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
             /* Create static TLS data */
             if(!arch_tls_setup_data(nt)) {
                 if(nt->flags & THD_OWNS_STACK)
-                    free(nt->stack);
-                free(nt);
+                    thd_stack_free(nt->stack, nt->stack_size);
+                thd_free(nt);
                 return NULL;
             }
 
@@ -461,9 +592,6 @@ kthread_t *thd_create_ex(const kthread_attr_t *restrict attr,
             if(real_attr.create_detached)
                 nt->flags |= THD_DETACHED;
 
-            /* Initialize thread-local storage. */
-            LIST_INIT(&nt->tls_list);
-
             /* Insert it into the thread list */
             LIST_INSERT_HEAD(&thd_list, nt, t_list);
 
@@ -486,8 +614,6 @@ kthread_t *thd_create(bool detach, void *(*routine)(void *), void *param) {
 /* Given a thread id, this function removes the thread from
    the execution chain. */
 int thd_destroy(kthread_t *thd) {
-    kthread_tls_kv_t *i, *i2;
-
     /* Make sure there are no ints */
     irq_disable_scoped();
 
@@ -506,30 +632,18 @@ int thd_destroy(kthread_t *thd) {
     /* Remove it from the thread list. */
     LIST_REMOVE(thd, t_list);
 
-    /* Call destructors on TLS entries.  */
-    LIST_FOREACH(i, &thd->tls_list, kv_list) {
-        if(i->destructor) {
-            i->destructor(i->data);
-        }
-    }
-
-    /* Free TLS entries. */
-    i = LIST_FIRST(&thd->tls_list);
-    while(i != NULL) {
-        i2 = LIST_NEXT(i, kv_list);
-        free(i);
-        i = i2;
-    }
+    /* Call destructors on TLS entries, and free them. */
+    kthread_tls_free(thd);
 
     /* Free its stack (if we're managing it). */
     if(thd->flags & THD_OWNS_STACK)
-        free(thd->stack);
+        thd_stack_free(thd->stack, thd->stack_size);
 
     /* Free static TLS segment */
     arch_tls_destroy_data(thd);
 
     /* Free the thread */
-    free(thd);
+    thd_free(thd);
 
     /* Remove it from the count */
     --thd_count;
@@ -586,6 +700,9 @@ static inline void thd_schedule_inner(kthread_t *thd) {
 
     thd_update_cpu_time(thd);
 
+    if(thd != thd_current)
+        trace_event(TRACE_SWITCH, NULL, thd->tid);
+
     thd_current = thd;
     _impure_ptr = &thd->thd_reent;
     thd->state = STATE_RUNNING;
@@ -964,7 +1081,6 @@ int thd_set_hz(unsigned int hertz) {
    through, so it ends up here instead. */
 int kthread_key_delete(kthread_key_t key) {
     kthread_t *cur;
-    kthread_tls_kv_t *i, *tmp;
 
     irq_disable_scoped();
 
@@ -974,21 +1090,10 @@ int kthread_key_delete(kthread_key_t key) {
         return -1;
     }
 
-    /* Make sure we can actually use free below. */
-    if(!malloc_irq_safe()) {
-        errno = EPERM;
-        return -1;
-    }
-
-    /* Go through each thread searching for (and removing) the data. */
+    /* Go through each thread clearing the data. */
     LIST_FOREACH(cur, &thd_list, t_list) {
-        LIST_FOREACH_SAFE(i, &cur->tls_list, kv_list, tmp) {
-            if(i->key == key) {
-                LIST_REMOVE(i, kv_list);
-                free(i);
-                break;
-            }
-        }
+        if((size_t)(key - 1) < cur->tls_size)
+            cur->tls_slots[key - 1] = NULL;
     }
 
     kthread_key_delete_destructor(key);
@@ -1099,6 +1204,9 @@ void thd_shutdown(void) {
 
     sem_destroy(&thd_reap_sem);
 
+    /* Empty the recycling cache */
+    thd_set_cache_limits(0, 0);
+
     /* Shutdown thread sync primitives */
     genwait_shutdown();
 
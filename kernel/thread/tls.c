@@ -2,12 +2,26 @@
 
    kernel/thread/tls.c
    Copyright (C) 2009 Lawrence Sebald
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 /* This file defines methods for accessing thread-local storage, added in KOS
    1.3.0. */
 
+/* Each thread stores its values in an array indexed by key - 1, so looking up
+   a value is a bounds check and a load. The array is allocated on the first
+   kthread_setspecific() call of a thread, large enough for all the keys that
+   exist at that point, so it only has to grow again if keys are created
+   afterwards. The destructors are stored in a global array indexed the same
+   way.
+
+   kthread_key_delete() clears the values of all threads with interrupts
+   disabled, so both arrays are only ever replaced with interrupts disabled,
+   and the old ones freed afterwards. */
+
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <errno.h>
 #include <malloc.h>
@@ -17,60 +31,45 @@
 #include <arch/irq.h>
 #include <arch/spinlock.h>
 
-static spinlock_t mutex = SPINLOCK_INITIALIZER;
-static kthread_key_t next_key = 1;
-
-typedef struct kthread_tls_dest {
-    /* List handle */
-    LIST_ENTRY(kthread_tls_dest) dest_list;
-
-    /* The key */
-    kthread_key_t key;
+/* Granularity of the value and destructor arrays, in keys */
+#define TLS_SLOTS_CHUNK     8
 
-    /* Destructor for the key */
-    void (*destructor)(void *);
-} kthread_tls_dest_t;
+typedef void (*tls_dest_t)(void *);
 
-LIST_HEAD(kthread_tls_dest_list, kthread_tls_dest);
+static spinlock_t mutex = SPINLOCK_INITIALIZER;
+static kthread_key_t next_key = 1;
 
-static struct kthread_tls_dest_list dest_list;
+/* Destructors of all the keys, indexed by key - 1 */
+static tls_dest_t *dest_table;
+static size_t dest_size;
 
 /* What is the next key that will be given out? */
 kthread_key_t kthread_key_next(void) {
     return next_key;
 }
 
-typedef void (*destructor)(void *);
-
 /* Get the destructor for a given key. */
-static destructor kthread_key_get_destructor(kthread_key_t key) {
-    kthread_tls_dest_t *i;
+static tls_dest_t kthread_key_get_destructor(kthread_key_t key) {
+    irq_disable_scoped();
 
-    LIST_FOREACH(i, &dest_list, dest_list) {
-        if(i->key == key) {
-            return i->destructor;
-        }
-    }
+    if((size_t)(key - 1) < dest_size)
+        return dest_table[key - 1];
 
     return NULL;
 }
 
 /* Delete the destructor for a given key. */
 void kthread_key_delete_destructor(kthread_key_t key) {
-    kthread_tls_dest_t *i, *tmp;
+    irq_disable_scoped();
 
-    LIST_FOREACH_SAFE(i, &dest_list, dest_list, tmp) {
-        if(i->key == key) {
-            LIST_REMOVE(i, dest_list);
-            free(i);
-            return;
-        }
-    }
+    if((size_t)(key - 1) < dest_size)
+        dest_table[key - 1] = NULL;
 }
 
 /* Create a new TLS key. */
 int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
-    kthread_tls_dest_t *dest;
+    tls_dest_t *table, *old;
+    size_t size;
 
     if(irq_inside_int() &&
        (spinlock_is_locked(&mutex) || !malloc_irq_safe())) {
@@ -80,20 +79,33 @@ int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
 
     spinlock_lock_scoped(&mutex);
 
-    /* Store the destructor if need be. */
-    if(destructor) {
-        dest = (kthread_tls_dest_t *)malloc(sizeof(kthread_tls_dest_t));
+    /* Grow the destructor table if need be. */
+    if((size_t)next_key > dest_size) {
+        size = (next_key + TLS_SLOTS_CHUNK - 1) & ~(TLS_SLOTS_CHUNK - 1);
+        table = (tls_dest_t *)malloc(size * sizeof(tls_dest_t));
 
-        if(!dest) {
+        if(!table) {
             errno = ENOMEM;
             return -1;
         }
 
-        dest->key = next_key;
-        dest->destructor = destructor;
-        LIST_INSERT_HEAD(&dest_list, dest, dest_list);
+        memset(table + dest_size, 0, (size - dest_size) * sizeof(tls_dest_t));
+
+        {
+            irq_disable_scoped();
+
+            if(dest_size)
+                memcpy(table, dest_table, dest_size * sizeof(tls_dest_t));
+
+            old = dest_table;
+            dest_table = table;
+            dest_size = size;
+        }
+
+        free(old);
     }
 
+    dest_table[next_key - 1] = destructor;
     *key = next_key++;
 
     return 0;
@@ -102,81 +114,142 @@ int kthread_key_create(kthread_key_t *key, void (*destructor)(void *)) {
 /* Get the value stored for a given TLS key. Returns NULL if the key is invalid
    or there is no data there for the current thread. */
 void *kthread_getspecific(kthread_key_t key) {
-    kthread_t *cur = thd_get_current();
-    kthread_tls_kv_t *i;
+    kthread_t *cur = thd_current;
 
-    LIST_FOREACH(i, &cur->tls_list, kv_list) {
-        if(i->key == key) {
-            return i->data;
-        }
-    }
+    if((size_t)(key - 1) < cur->tls_size)
+        return cur->tls_slots[key - 1];
 
     return NULL;
 }
 
 /* Set the value for a given TLS key. Returns -1 on failure. errno will be
    EINVAL if the key is not valid, ENOMEM if there is no memory available to
-   allocate for storage, or EPERM if run inside an interrupt and the a call is
-   in progress already. */
+   allocate for storage, or EPERM if run inside an interrupt and malloc can't
+   be used there. */
 int kthread_setspecific(kthread_key_t key, const void *value) {
-    kthread_t *cur = thd_get_current();
-    kthread_tls_kv_t *i;
+    kthread_t *cur = thd_current;
+    void **slots, **old;
+    size_t size;
 
-    if(irq_inside_int() && spinlock_is_locked(&mutex)) {
-        errno = EPERM;
+    /* Make sure the key is valid. */
+    if(key >= next_key || key < 1) {
+        errno = EINVAL;
         return -1;
     }
 
-    /* Make sure the key is valid. */
-    {
-        spinlock_lock_scoped(&mutex);
-
-        if(key >= next_key || key < 1) {
-            errno = EINVAL;
-            return -1;
-        }
+    /* Fast path: the slot already exists. */
+    if(__likely((size_t)(key - 1) < cur->tls_size)) {
+        cur->tls_slots[key - 1] = (void *)value;
+        return 0;
     }
 
-    /* Check if we already have an entry for this key. */
-    LIST_FOREACH(i, &cur->tls_list, kv_list) {
-        if(i->key == key) {
-            i->data = (void *)value;
-            return 0;
-        }
+    /* A missing slot is the same as a NULL value. */
+    if(!value)
+        return 0;
+
+    if(irq_inside_int() && !malloc_irq_safe()) {
+        errno = EPERM;
+        return -1;
     }
 
-    /* No entry, create a new one. */
-    i = (kthread_tls_kv_t *)malloc(sizeof(kthread_tls_kv_t));
+    /* Make room for all the keys that currently exist. */
+    size = (next_key - 1 + TLS_SLOTS_CHUNK - 1) & ~(TLS_SLOTS_CHUNK - 1);
+    slots = (void **)calloc(size, sizeof(void *));
 
-    if(!i) {
+    if(!slots) {
         errno = ENOMEM;
         return -1;
     }
 
-    i->key = key;
-    i->data = (void *)value;
-    i->destructor = kthread_key_get_destructor(key);
-    LIST_INSERT_HEAD(&cur->tls_list, i, kv_list);
+    {
+        irq_disable_scoped();
+
+        if(cur->tls_size)
+            memcpy(slots, cur->tls_slots, cur->tls_size * sizeof(void *));
+
+        old = cur->tls_slots;
+        cur->tls_slots = slots;
+        cur->tls_size = size;
+    }
+
+    free(old);
+
+    cur->tls_slots[key - 1] = (void *)value;
 
     return 0;
 }
 
-int kthread_tls_init(void) {
-    /* Initialize the destructor list. */
-    LIST_INIT(&dest_list);
+/* Call the destructors of the current thread's values, following POSIX: each
+   value is cleared before its destructor is called, and the whole thing is
+   repeated as long as destructors set new values, up to a limit. */
+void kthread_tls_run_destructors(void) {
+    kthread_t *cur = thd_current;
+    tls_dest_t dest;
+    void *value;
+    size_t i;
+    bool called;
+    int round;
 
-    return 0;
+    for(round = 0; round < KTHREAD_DESTRUCTOR_ITERATIONS; round++) {
+        called = false;
+
+        /* A destructor may grow the array, so reload it every time. */
+        for(i = 0; i < cur->tls_size; i++) {
+            value = cur->tls_slots[i];
+
+            if(!value)
+                continue;
+
+            dest = kthread_key_get_destructor(i + 1);
+
+            if(!dest)
+                continue;
+
+            cur->tls_slots[i] = NULL;
+            dest(value);
+            called = true;
+        }
+
+        if(!called)
+            break;
+    }
+
+    /* Discard whatever is left. */
+    if(cur->tls_size)
+        memset(cur->tls_slots, 0, cur->tls_size * sizeof(void *));
 }
 
-void kthread_tls_shutdown(void) {
-    kthread_tls_dest_t *n1, *n2;
+/* Free the values of a thread that is being destroyed. Threads that exited
+   normally have already run their destructors, but threads killed with
+   thd_destroy() still get one round. */
+void kthread_tls_free(kthread_t *thd) {
+    tls_dest_t dest;
+    size_t i;
 
-    /* Tear down the destructor list. */
-    n1 = LIST_FIRST(&dest_list);
+    for(i = 0; i < thd->tls_size; i++) {
+        if(thd->tls_slots[i]) {
+            dest = kthread_key_get_destructor(i + 1);
 
-    while(n1 != NULL) {
-        n2 = LIST_NEXT(n1, dest_list);
-        free(n1);
-        n1 = n2;
+            if(dest)
+                dest(thd->tls_slots[i]);
+        }
     }
+
+    free(thd->tls_slots);
+    thd->tls_slots = NULL;
+    thd->tls_size = 0;
+}
+
+int kthread_tls_init(void) {
+    dest_table = NULL;
+    dest_size = 0;
+
+    return 0;
+}
+
+void kthread_tls_shutdown(void) {
+    /* Tear down the destructor table. */
+    free(dest_table);
+    dest_table = NULL;
+    dest_size = 0;
 }
@@ -0,0 +1,614 @@
+/* KallistiOS ##version##
+
+   dbgiotest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the asynchronous debug output in
+   kernel/debug/dbgio_async.c, which is built as-is on the host along with
+   dbgio.c and dbglog.c. The dbgio device is a stand-in that collects what's
+   written to it, and can be made as slow as a serial console or held up
+   entirely to fill the ring. Threads are pthreads.
+
+   The tests check that messages come out whole and in the order they were
+   logged, from dbglog() and dbgio_printf() alike and from several threads at
+   once, that each goes to stdout or to the dbgio device as it would have
+   synchronously, that messages which don't fit are dropped, counted and
+   reported, that long messages are cut short as before, that stopping writes
+   out everything still queued, and that a panic writes it out without the
+   drain thread. The benchmark (-b) times logging a line against a console at
+   115200 baud, synchronously and asynchronously.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kos/dbgio.h>
+#include <kos/dbglog.h>
+#include <kos/fs.h>
+#include <kos/genwait.h>
+#include <kos/thread.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* What the debug output code needs from the rest of the kernel */
+
+int test_inside_int;
+
+static kthread_attr_t last_attr;
+static __thread kthread_t *cur_thd;
+
+struct thd_start {
+    kthread_t *thd;
+    void *(*routine)(void *);
+    void *param;
+};
+
+static void *thd_trampoline(void *p) {
+    struct thd_start st = *(struct thd_start *)p;
+
+    free(p);
+    cur_thd = st.thd;
+    return st.routine(st.param);
+}
+
+kthread_t *thd_create_ex(const kthread_attr_t *attr,
+                         void *(*routine)(void *), void *param) {
+    kthread_t *thd = malloc(sizeof(kthread_t));
+    struct thd_start *st = malloc(sizeof(struct thd_start));
+
+    last_attr = *attr;
+    st->thd = thd;
+    st->routine = routine;
+    st->param = param;
+
+    if(pthread_create(&thd->thd, NULL, thd_trampoline, st)) {
+        free(st);
+        free(thd);
+        return NULL;
+    }
+
+    return thd;
+}
+
+int thd_join(kthread_t *thd, void **value_ptr) {
+    int rv = pthread_join(thd->thd, value_ptr);
+
+    free(thd);
+    return rv;
+}
+
+void thd_pass(void) {
+    sched_yield();
+}
+
+void thd_sleep(unsigned int ms) {
+    usleep(ms * 1000);
+}
+
+kthread_t *thd_get_current(void) {
+    return cur_thd;
+}
+
+static pthread_mutex_t gw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gw_cond = PTHREAD_COND_INITIALIZER;
+
+int genwait_wait(void *obj, const char *mutex_name, int timeout,
+                 void (*callback)(void *)) {
+    struct timespec ts;
+
+    (void)obj;
+    (void)mutex_name;
+    (void)callback;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += timeout * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&gw_mutex);
+    pthread_cond_timedwait(&gw_cond, &gw_mutex, &ts);
+    pthread_mutex_unlock(&gw_mutex);
+
+    return 0;
+}
+
+int genwait_wake_one(void *obj) {
+    (void)obj;
+    pthread_mutex_lock(&gw_mutex);
+    pthread_cond_broadcast(&gw_cond);
+    pthread_mutex_unlock(&gw_mutex);
+    return 0;
+}
+
+/* Everything written to stdout or to the dbgio device goes into one buffer,
+   in the order it was written, and the bytes that went each way are counted.
+   Writes can be slowed down to a given number of microseconds per byte, and
+   writes from threads other than the main one can be held up at a gate. */
+
+#define OUT_MAX     (1 << 22)
+
+static char out_buf[OUT_MAX];
+static size_t out_len, out_stdout, out_dbgio;
+static int fs_broken;
+static int byte_delay;
+
+static pthread_t main_thd;
+static int gate_closed, gate_waiting;
+static pthread_mutex_t out_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+
+static void out_write(const void *data, size_t len, size_t *count) {
+    struct timespec ts;
+
+    pthread_mutex_lock(&out_mutex);
+
+    while(gate_closed && !pthread_equal(pthread_self(), main_thd)) {
+        gate_waiting++;
+        pthread_cond_broadcast(&gate_cond);
+        pthread_cond_wait(&gate_cond, &out_mutex);
+        gate_waiting--;
+    }
+
+    if(out_len + len <= OUT_MAX) {
+        memcpy(out_buf + out_len, data, len);
+        out_len += len;
+    }
+
+    *count += len;
+    pthread_mutex_unlock(&out_mutex);
+
+    if(byte_delay) {
+        ts.tv_sec = 0;
+        ts.tv_nsec = (long)len * byte_delay * 1000L;
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void gate(int closed) {
+    pthread_mutex_lock(&out_mutex);
+    gate_closed = closed;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&out_mutex);
+}
+
+static void gate_wait(void) {
+    pthread_mutex_lock(&out_mutex);
+
+    while(!gate_waiting)
+        pthread_cond_wait(&gate_cond, &out_mutex);
+
+    pthread_mutex_unlock(&out_mutex);
+}
+
+static void out_reset(void) {
+    pthread_mutex_lock(&out_mutex);
+    out_len = out_stdout = out_dbgio = 0;
+    pthread_mutex_unlock(&out_mutex);
+}
+
+ssize_t fs_write(file_t hnd, const void *buffer, size_t cnt) {
+    if(hnd != STDOUT_FILENO || fs_broken) {
+        errno = EBADF;
+        return -1;
+    }
+
+    out_write(buffer, cnt, &out_stdout);
+    return cnt;
+}
+
+static int test_detected(void) {
+    return 1;
+}
+
+static int test_init(void) {
+    return 0;
+}
+
+static int test_write_buffer(const uint8 *data, int len, int xlat) {
+    (void)xlat;
+    out_write(data, len, &out_dbgio);
+    return len;
+}
+
+static dbgio_handler_t test_handler = {
+    .name = "test",
+    .detected = test_detected,
+    .init = test_init,
+    .write_buffer = test_write_buffer
+};
+
+dbgio_handler_t *dbgio_handlers[] = { &test_handler };
+const size_t dbgio_handler_cnt = 1;
+
+/* Build what a run of log calls should come out as, alongside them */
+
+static char expect[OUT_MAX];
+static size_t expect_len;
+
+static void expect_reset(void) {
+    expect_len = 0;
+}
+
+static void log_line(int use_dbglog, const char *fmt, int a, int b) {
+    expect_len += sprintf(expect + expect_len, fmt, a, b);
+
+    if(use_dbglog)
+        dbglog(DBG_INFO, fmt, a, b);
+    else
+        dbgio_printf(fmt, a, b);
+}
+
+static int out_matches(void) {
+    return out_len == expect_len && !memcmp(out_buf, expect, out_len);
+}
+
+/* The tests */
+
+static void test_sync(void) {
+    out_reset();
+    expect_reset();
+
+    log_line(1, "dbglog %d %d\n", 1, 2);
+    CHECK(out_matches(), "dbglog() output wrong");
+    CHECK(out_stdout == expect_len, "dbglog() didn't go to stdout");
+
+    log_line(0, "dbgio_printf %d %d\n", 3, 4);
+    CHECK(out_matches(), "dbgio_printf() output wrong");
+    CHECK(out_dbgio == expect_len - out_stdout,
+          "dbgio_printf() didn't go to dbgio");
+}
+
+static void test_order(void) {
+    int i;
+
+    CHECK(!dbgio_async_start(0, NULL), "start failed");
+    CHECK(!last_attr.create_detached && last_attr.prio == PRIO_DEFAULT + 1 &&
+          !strcmp(last_attr.label, "[dbgio]"), "wrong default thread attrs");
+    CHECK(!dbgio_async_start(0, NULL), "second start failed");
+
+    out_reset();
+    expect_reset();
+    byte_delay = 1;
+
+    /* A batch at a time, so that the ring doesn't fill up */
+    for(i = 0; i < 2000; i++) {
+        log_line(i & 1, "line %d of %d\n", i, 2000);
+
+        if(i % 200 == 199)
+            CHECK(!dbgio_async_flush(), "flush failed");
+    }
+
+    CHECK(!dbgio_async_flush(), "flush failed");
+    CHECK(out_matches(), "output out of order or damaged (%zu of %zu bytes)",
+          out_len, expect_len);
+    CHECK(out_stdout + out_dbgio == expect_len && out_stdout && out_dbgio,
+          "wrong destinations (%zu to stdout, %zu to dbgio)",
+          out_stdout, out_dbgio);
+    CHECK(dbgio_async_dropped() == 0, "dropped %zu",
+          dbgio_async_dropped());
+
+    byte_delay = 0;
+}
+
+static void test_dest(void) {
+    size_t before;
+
+    out_reset();
+    expect_reset();
+
+    /* From an interrupt, dbglog() goes straight to dbgio */
+    test_inside_int = 1;
+    log_line(1, "irq %d %d\n", 5, 6);
+    test_inside_int = 0;
+
+    CHECK(!dbgio_async_flush(), "flush failed");
+    CHECK(out_matches(), "output wrong");
+    CHECK(out_dbgio == expect_len, "interrupt message went to stdout");
+
+    /* And it falls back to dbgio if stdout doesn't work */
+    before = out_dbgio;
+    fs_broken = 1;
+    log_line(1, "broken %d %d\n", 7, 8);
+    CHECK(!dbgio_async_flush(), "flush failed");
+    fs_broken = 0;
+
+    CHECK(out_matches(), "output wrong");
+    CHECK(out_dbgio - before == strlen("broken 7 8\n"), "no fallback");
+}
+
+static void test_long(void) {
+    char big[2001];
+    int rv;
+
+    memset(big, 'x', 2000);
+    big[2000] = '\0';
+
+    out_reset();
+    rv = dbgio_printf("%s", big);
+    CHECK(rv == 2000, "returned %d", rv);
+    CHECK(!dbgio_async_flush(), "flush failed");
+    CHECK(out_len == 1023, "wrote %zu bytes", out_len);
+    CHECK(!memcmp(out_buf, big, 1023), "contents wrong");
+
+    /* Sizes that land in every position in the ring, including wrapping */
+    out_reset();
+    expect_reset();
+
+    for(rv = 1; rv < 1020; rv += 7)
+        expect_len += sprintf(expect + expect_len, "%.*s\n", rv, big);
+
+    for(rv = 1; rv < 1020; rv += 7) {
+        dbglog(DBG_INFO, "%.*s\n", rv, big);
+
+        if(rv % 8 == 0)
+            CHECK(!dbgio_async_flush(), "flush failed");
+    }
+
+    CHECK(!dbgio_async_flush(), "flush failed");
+    CHECK(out_matches(), "output wrong");
+}
+
+static size_t count_dropped(void) {
+    const char *p = out_buf, *end = out_buf + out_len;
+    const char *msg = "dbgio: ";
+    size_t total = 0;
+    unsigned int n;
+
+    while(p < end) {
+        if(!strncmp(p, msg, strlen(msg)) &&
+           sscanf(p, "dbgio: %u messages dropped", &n) == 1)
+            total += n;
+
+        p = memchr(p, '\n', end - p);
+        if(!p)
+            break;
+
+        p++;
+    }
+
+    return total;
+}
+
+static void test_overflow(void) {
+    size_t dropped = dbgio_async_dropped();
+    int i;
+
+    out_reset();
+    expect_reset();
+
+    /* Hold up the drain thread, so the ring fills up */
+    gate(1);
+
+    for(i = 0; i < 1000; i++)
+        dbglog(DBG_INFO, "overflow %d\n", i);
+
+    dropped = dbgio_async_dropped() - dropped;
+    CHECK(dropped > 0, "nothing dropped");
+
+    gate(0);
+    CHECK(!dbgio_async_flush(), "flush failed");
+
+    for(i = 0; i < (int)(1000 - dropped); i++)
+        expect_len += sprintf(expect + expect_len, "overflow %d\n", i);
+
+    CHECK(out_len > expect_len && !memcmp(out_buf, expect, expect_len),
+          "kept messages wrong %zu %zu %zu [%.*s]", out_len, expect_len, dropped, (int)out_len, out_buf);
+    CHECK(count_dropped() == dropped, "reported %zu dropped, not %zu",
+          count_dropped(), dropped);
+
+    /* There's room again afterwards */
+    out_reset();
+    expect_reset();
+    log_line(0, "after %d %d\n", 1, 2);
+    CHECK(!dbgio_async_flush(), "flush failed");
+    CHECK(out_matches(), "output wrong");
+}
+
+#define THREADS     4
+#define PER_THREAD  20000
+
+static void *producer(void *p) {
+    int id = (int)(intptr_t)p, i;
+
+    for(i = 0; i < PER_THREAD; i++) {
+        if(i & 1)
+            dbglog(DBG_INFO, "T%d %d\n", id, i);
+        else
+            dbgio_printf("T%d %d\n", id, i);
+    }
+
+    return NULL;
+}
+
+static void test_threads(void) {
+    pthread_t thds[THREADS];
+    int next[THREADS] = { 0 };
+    size_t dropped = dbgio_async_dropped(), lines = 0;
+    const char *p, *end;
+    int i, id, seq;
+
+    out_reset();
+
+    for(i = 0; i < THREADS; i++)
+        pthread_create(&thds[i], NULL, producer, (void *)(intptr_t)i);
+
+    for(i = 0; i < THREADS; i++)
+        pthread_join(thds[i], NULL);
+
+    CHECK(!dbgio_async_flush(), "flush failed");
+    dropped = dbgio_async_dropped() - dropped;
+
+    /* Every line is whole, and each thread's come out in order */
+    p = out_buf;
+    end = out_buf + out_len;
+
+    while(p < end) {
+        if(!strncmp(p, "dbgio: ", 7)) {
+            p = memchr(p, '\n', end - p) + 1;
+            continue;
+        }
+
+        CHECK(sscanf(p, "T%d %d\n", &id, &seq) == 2 && id >= 0 &&
+              id < THREADS, "bad line at %td", p - out_buf);
+        CHECK(seq >= next[id], "thread %d went from %d to %d", id,
+              next[id], seq);
+
+        next[id] = seq + 1;
+        lines++;
+        p = memchr(p, '\n', end - p);
+        CHECK(p, "unterminated line");
+        p++;
+    }
+
+    CHECK(lines + dropped == THREADS * PER_THREAD,
+          "%zu lines and %zu dropped, of %d", lines, dropped,
+          THREADS * PER_THREAD);
+    CHECK(count_dropped() == dropped, "reported %zu dropped, not %zu",
+          count_dropped(), dropped);
+}
+
+static void test_stop(void) {
+    int i;
+
+    out_reset();
+    expect_reset();
+    gate(1);
+
+    for(i = 0; i < 20; i++)
+        log_line(i & 1, "stop %d %d\n", i, 0);
+
+    gate(0);
+    dbgio_async_stop();
+    CHECK(out_matches(), "queued output lost on stop");
+
+    /* And it's synchronous again */
+    log_line(1, "sync %d %d\n", 1, 1);
+    CHECK(out_matches(), "not synchronous after stop");
+
+    CHECK(!dbgio_async_start(4096, NULL), "restart failed");
+}
+
+static void test_panic(void) {
+    int i;
+
+    /* The drain thread gets stuck on the first message, and never comes
+       back, just as it wouldn't after a real panic. */
+    gate(1);
+    out_reset();
+    expect_reset();
+
+    for(i = 0; i < 50; i++)
+        log_line(i & 1, "panic %d %d\n", i, 0);
+
+    gate_wait();
+    __dbgio_async_panic();
+
+    CHECK(out_len == expect_len && !memcmp(out_buf, expect, out_len),
+          "queued output not written on panic");
+    CHECK(out_stdout == 0, "wrote to stdout while panicking");
+
+    /* Anything after that is synchronous */
+    log_line(0, "after %d %d\n", 0, 0);
+    CHECK(out_matches(), "not synchronous after panic");
+}
+
+/* The benchmark */
+
+static void bench_one(const char *name) {
+    double start, logged, done;
+    int i;
+
+    out_reset();
+    start = now();
+
+    for(i = 0; i < 200; i++)
+        dbglog(DBG_INFO, "bench: frame %d took %d us\n", i, i * 37);
+
+    logged = now();
+    dbgio_async_flush();
+    done = now();
+
+    printf("%-6s %8.2f us per line logged, %7.1f ms until written\n", name,
+           (logged - start) * 1e6 / 200, (done - start) * 1e3);
+}
+
+static void bench(void) {
+    /* Roughly 115200 baud */
+    byte_delay = 87;
+
+    bench_one("sync");
+
+    dbgio_async_start(0, NULL);
+    bench_one("async");
+    dbgio_async_stop();
+
+    byte_delay = 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-b]\n", prog);
+    fprintf(stderr, "  -b   Run the benchmark instead of the tests\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int c, do_bench = 0;
+
+    while((c = getopt(argc, argv, "b")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    main_thd = pthread_self();
+    dbgio_init();
+
+    if(do_bench) {
+        bench();
+        return 0;
+    }
+
+    test_sync();
+    test_order();
+    test_dest();
+    test_long();
+    test_overflow();
+    test_threads();
+    test_stop();
+    test_panic();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,23 @@
+/* KallistiOS ##version##
+
+   utils/dbgiotest/shim/arch/irq.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/irq.h. The test can pretend to be in an
+   interrupt by setting test_inside_int, which only changes which way
+   dbglog() sends its output. Disabling interrupts does nothing.
+*/
+
+#ifndef __ARCH_IRQ_H
+#define __ARCH_IRQ_H
+
+extern int test_inside_int;
+
+#define irq_inside_int() (test_inside_int)
+#define irq_disable_scoped() do { } while(0)
+
+static inline int irq_disable(void) {
+    return 0;
+}
+
+#endif /* __ARCH_IRQ_H */
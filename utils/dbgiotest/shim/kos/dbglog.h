@@ -0,0 +1,15 @@
+/* KallistiOS ##version##
+
+   utils/dbgiotest/shim/kos/dbglog.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   dbglog.c is under test here, so it gets the real kos/dbglog.h rather than
+   the shared stand-in.
+*/
+
+#ifndef __DBGIOTEST_KOS_DBGLOG_H
+#define __DBGIOTEST_KOS_DBGLOG_H
+
+#include "../../../../include/kos/dbglog.h"
+
+#endif /* __DBGIOTEST_KOS_DBGLOG_H */
@@ -0,0 +1,756 @@
+/* KallistiOS ##version##
+
+   dclstest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the dcload-ip file system client in
+   kernel/arch/dreamcast/fs/fs_dclsocket.c, which is built as-is on the host
+   and talks over real UDP sockets on the loopback interface to a stand-in
+   for dc-tool running in another thread.
+
+   The stand-in answers commands the way dc-tool does: read data is pushed
+   with LBIN, 1KB PBIN packets and DBIN, resending the chunks the client
+   reports missing, and every command ends with RETV. It can drop some of
+   the PBIN packets, and wait before it handles each packet from the
+   client and before sending each PBIN, to act like a real network.
+
+   The client sends the addresses of its buffers to the host as 32-bit
+   numbers, so it has to run with all of them below 4GB. The test is built
+   as a non-PIE executable, keeps malloc() on the main heap, and runs the
+   client in threads whose stacks come from malloc().
+
+   The tests read files from a temporary directory through the client, in
+   chunks of various sizes and at random offsets, also with lost packets
+   and from several threads at once, and compare what they get. The
+   benchmark (-b) reads a file with the read-ahead (opened read-only) and
+   without it (opened read-write, which is how every read used to go), and
+   reports the time taken and the number of read commands sent.
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kos/fs.h>
+#include <kos/net.h>
+#include <dc/fs_dclsocket.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static char tmpdir[] = "/tmp/dclstestXXXXXX";
+
+static uint32_t rng = 1;
+
+static uint32_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *low_malloc(size_t size) {
+    void *p = malloc(size);
+
+    if(!p || (uintptr_t)p + size > UINT32_MAX) {
+        fprintf(stderr, "can't allocate %zu bytes below 4GB\n", size);
+        exit(1);
+    }
+
+    return p;
+}
+
+/* The stand-in for dc-tool */
+
+typedef struct {
+    unsigned char id[4];
+    uint32_t address;
+    uint32_t size;
+    unsigned char data[];
+} command_t;
+
+typedef struct {
+    unsigned char id[4];
+    uint32_t value0;
+    uint32_t value1;
+    uint32_t value2;
+} command_3int_t;
+
+static int host_socket = -1;
+static uint32_t host_size;      /* size of the current transfer */
+static struct sockaddr_in client_addr;
+static pthread_t host_thread;
+
+/* Simulated network */
+static int host_drop;           /* drop one PBIN in this many */
+static int host_drop_last;      /* drop the last PBIN of every transfer */
+static int host_rtt_us;         /* added to every packet from the client */
+static int host_pkt_us;         /* added to every PBIN sent */
+
+/* Statistics */
+static int host_reads, host_seeks, host_pbins;
+
+static void host_send(const void *pkt, size_t len) {
+    sendto(host_socket, pkt, len, 0, (struct sockaddr *)&client_addr,
+           sizeof(client_addr));
+}
+
+/* Wait for a packet from the client; returns its length, or -1 on a
+   timeout if timeout_ms isn't 0 */
+static int host_recv(uint8_t *pkt, int timeout_ms) {
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    int len;
+
+    setsockopt(host_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    len = recv(host_socket, pkt, 1514, 0);
+
+    if(len >= 0 && host_rtt_us)
+        usleep(host_rtt_us);
+
+    return len;
+}
+
+/* Send a command, and wait for the client to echo it */
+static void host_send_cmd(const char *id, uint32_t address, uint32_t size,
+                          uint8_t *pkt) {
+    command_t cmd;
+
+    memcpy(cmd.id, id, 4);
+    cmd.address = htonl(address);
+    cmd.size = htonl(size);
+
+    do {
+        host_send(&cmd, sizeof(cmd));
+    } while(host_recv(pkt, 500) < 0 || memcmp(pkt, id, 4));
+}
+
+static void host_send_pbin(const uint8_t *data, uint32_t dcaddr, uint32_t off,
+                           uint32_t len, int first) {
+    static uint8_t buf[sizeof(command_t) + 1024];
+    command_t *cmd = (command_t *)buf;
+
+    memcpy(cmd->id, "PBIN", 4);
+    cmd->address = htonl(dcaddr + off);
+    cmd->size = htonl(len);
+    memcpy(cmd->data, data + off, len);
+    host_pbins++;
+
+    if(host_pkt_us)
+        usleep(host_pkt_us);
+
+    if(host_drop && rnd() % host_drop == 0)
+        return;
+
+    if(host_drop_last && first && off + len == host_size)
+        return;
+
+    host_send(buf, sizeof(command_t) + len);
+}
+
+/* Push data into the client's memory at dcaddr, like dc-tool's send_data() */
+static void host_send_data(const uint8_t *data, uint32_t dcaddr, uint32_t size) {
+    uint8_t pkt[1514];
+    command_t *resp = (command_t *)pkt;
+    uint32_t off;
+
+    host_size = size;
+    host_send_cmd("LBIN", dcaddr, size, pkt);
+
+    for(off = 0; off < size; off += 1024)
+        host_send_pbin(data, dcaddr, off, size - off < 1024 ? size - off : 1024, 1);
+
+    for(;;) {
+        host_send_cmd("DBIN", 0, 0, pkt);
+
+        if(!resp->address || !resp->size)
+            break;
+
+        /* The client wants this chunk again */
+        host_send_pbin(data, dcaddr, ntohl(resp->address) - dcaddr,
+                       ntohl(resp->size), 0);
+    }
+}
+
+static int host_open(command_t *cmd) {
+    uint32_t dcflags = ntohl(cmd->address);
+    char path[1024];
+    int flags;
+
+    switch(dcflags & 3) {
+        case 1:
+            flags = O_WRONLY;
+            break;
+        case 2:
+            flags = O_RDWR;
+            break;
+        default:
+            flags = O_RDONLY;
+    }
+
+    if(dcflags & 0x0008)
+        flags |= O_APPEND;
+
+    if(dcflags & 0x0200)
+        flags |= O_CREAT;
+
+    if(dcflags & 0x0400)
+        flags |= O_TRUNC;
+
+    snprintf(path, sizeof(path), "%s%s", tmpdir, (char *)cmd->data);
+    return open(path, flags, ntohl(cmd->size));
+}
+
+static int host_read(command_3int_t *cmd) {
+    uint32_t cnt = ntohl(cmd->value2);
+    uint8_t *data = malloc(cnt ? cnt : 1);
+    int rv;
+
+    host_reads++;
+    rv = read(ntohl(cmd->value0), data, cnt);
+
+    if(rv > 0)
+        host_send_data(data, ntohl(cmd->value1), rv);
+
+    free(data);
+    return rv;
+}
+
+static void *host_main(void *arg) {
+    uint8_t pkt[1514];
+    int len, rv;
+
+    (void)arg;
+
+    for(;;) {
+        if((len = host_recv(pkt, 0)) < 4)
+            continue;
+
+        if(!memcmp(pkt, "DC00", 4))
+            break;
+        else if(!memcmp(pkt, "DC03", 4))
+            rv = host_read((command_3int_t *)pkt);
+        else if(!memcmp(pkt, "DC04", 4))
+            rv = host_open((command_t *)pkt);
+        else if(!memcmp(pkt, "DC05", 4))
+            rv = close(ntohl(((command_3int_t *)pkt)->value0));
+        else if(!memcmp(pkt, "DC11", 4)) {
+            command_3int_t *cmd = (command_3int_t *)pkt;
+
+            host_seeks++;
+            rv = lseek(ntohl(cmd->value0), (int32_t)ntohl(cmd->value1),
+                       ntohl(cmd->value2));
+        }
+        else
+            rv = -1;
+
+        host_send_cmd("RETV", rv, rv, pkt);
+    }
+
+    return NULL;
+}
+
+static uint16_t host_start(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    host_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(host_socket < 0 || bind(host_socket, (struct sockaddr *)&addr, sizeof(addr)) ||
+       getsockname(host_socket, (struct sockaddr *)&addr, &len)) {
+        perror("host socket");
+        exit(1);
+    }
+
+    memset(&client_addr, 0, sizeof(client_addr));
+    client_addr.sin_family = AF_INET;
+    client_addr.sin_port = htons(31313);
+    client_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    pthread_create(&host_thread, NULL, host_main, NULL);
+    return ntohs(addr.sin_port);
+}
+
+/* What fs_dclsocket.c needs from the rest of KOS */
+
+int dcload_type = DCLOAD_TYPE_IP;
+dbgio_handler_t dbgio_null;
+static uint16_t host_port;
+static vfs_handler_t *vfs;
+
+static int fake_rx_poll(netif_t *self) {
+    (void)self;
+    return 0;
+}
+
+static netif_t fake_dev = { fake_rx_poll };
+netif_t *net_default_dev = &fake_dev;
+
+int dcloadsyscall(unsigned int syscall, ...) {
+    va_list ap;
+    uint32_t *ip, *port;
+
+    if(syscall != DCLOAD_GETHOSTINFO)
+        return -1;
+
+    va_start(ap, syscall);
+    ip = va_arg(ap, uint32_t *);
+    port = va_arg(ap, uint32_t *);
+    va_end(ap);
+
+    *ip = INADDR_LOOPBACK;
+    *port = host_port;
+    return 0;
+}
+
+void net_ipv4_parse_address(uint32 addr, uint8 out[4]) {
+    out[0] = addr >> 24;
+    out[1] = addr >> 16;
+    out[2] = addr >> 8;
+    out[3] = addr;
+}
+
+int net_arp_lookup(netif_t *nif, const uint8 ip_in[4], uint8 mac_out[6],
+                   const void *pkt, const uint8 *data, int data_size) {
+    (void)nif;
+    (void)ip_in;
+    (void)pkt;
+    (void)data;
+    (void)data_size;
+    memset(mac_out, 0, 6);
+    return 0;
+}
+
+int net_arp_insert(netif_t *nif, const uint8 mac[6], const uint8 ip[4],
+                   uint64 timestamp) {
+    (void)nif;
+    (void)mac;
+    (void)ip;
+    (void)timestamp;
+    return 0;
+}
+
+const char *dbgio_dev_get(void) {
+    return "null";
+}
+
+void dbgio_disable(void) {
+}
+
+int nmmgr_handler_add(nmmgr_handler_t *hnd) {
+    vfs = (vfs_handler_t *)hnd;
+    return 0;
+}
+
+int nmmgr_handler_remove(nmmgr_handler_t *hnd) {
+    (void)hnd;
+    vfs = NULL;
+    return 0;
+}
+
+/* Test files */
+
+typedef struct {
+    const char *name;
+    size_t size;
+    uint8_t *data;
+} tfile_t;
+
+static tfile_t files[] = {
+    { "/empty",     0,          NULL },
+    { "/one",       1,          NULL },
+    { "/small",     1000,       NULL },
+    { "/window",    8192,       NULL },
+    { "/medium",    100000,     NULL },
+    { "/large",     1234567,    NULL }
+};
+
+#define NFILES (sizeof(files) / sizeof(files[0]))
+
+static void make_files(void) {
+    char path[1024];
+    size_t i, j;
+    FILE *f;
+
+    for(i = 0; i < NFILES; i++) {
+        files[i].data = malloc(files[i].size + 1);
+
+        for(j = 0; j < files[i].size; j++)
+            files[i].data[j] = rnd();
+
+        snprintf(path, sizeof(path), "%s%s", tmpdir, files[i].name);
+
+        if(!(f = fopen(path, "wb")) ||
+           fwrite(files[i].data, 1, files[i].size, f) != files[i].size) {
+            fprintf(stderr, "can't write %s\n", path);
+            exit(1);
+        }
+
+        fclose(f);
+    }
+}
+
+static void test_sequential(const tfile_t *tf, int mode, size_t chunk) {
+    uint8_t *buf = low_malloc(tf->size + chunk);
+    void *h = vfs->open(vfs, tf->name, mode);
+    size_t pos = 0;
+    ssize_t rv;
+
+    CHECK(h != NULL, "can't open %s", tf->name);
+
+    while((rv = vfs->read(h, buf + pos, chunk)) > 0)
+        pos += rv;
+
+    vfs->close(h);
+
+    if(rv < 0 || pos != tf->size || memcmp(buf, tf->data, tf->size)) {
+        free(buf);
+        CHECK(0, "%s read in %zu byte chunks is wrong (got %zu of %zu bytes)",
+              tf->name, chunk, pos, tf->size);
+    }
+
+    free(buf);
+}
+
+static void test_random(const tfile_t *tf) {
+    uint8_t *buf = low_malloc(100000);
+    void *h = vfs->open(vfs, tf->name, O_RDONLY);
+    size_t pos, len, want;
+    off_t off;
+    ssize_t rv;
+    int i, whence;
+
+    CHECK(h != NULL, "can't open %s", tf->name);
+    CHECK(vfs->total(h) == tf->size, "total() of %s is %zu, not %zu", tf->name,
+          vfs->total(h), tf->size);
+
+    for(i = 0; i < 300; i++) {
+        pos = rnd() % (tf->size + 10);
+        whence = rnd() % 3;
+        off = whence == SEEK_SET ? (off_t)pos :
+              whence == SEEK_CUR ? (off_t)pos - vfs->tell(h) :
+              (off_t)pos - (off_t)tf->size;
+
+        if(vfs->seek(h, off, whence) != (off_t)pos) {
+            free(buf);
+            vfs->close(h);
+            CHECK(0, "seek to %zu (whence %d) in %s failed", pos, whence, tf->name);
+        }
+
+        len = rnd() % (i & 1 ? 200 : 100000);
+        want = pos >= tf->size ? 0 : tf->size - pos < len ? tf->size - pos : len;
+        rv = vfs->read(h, buf, len);
+
+        if(rv != (ssize_t)want || memcmp(buf, tf->data + pos, want) ||
+           vfs->tell(h) != (off_t)(pos + want)) {
+            free(buf);
+            vfs->close(h);
+            CHECK(0, "reading %zu bytes at %zu of %s is wrong (got %zd)", len,
+                  pos, tf->name, rv);
+        }
+    }
+
+    /* total() mustn't move the file */
+    vfs->seek(h, 1000, SEEK_SET);
+    vfs->total(h);
+    rv = vfs->read(h, buf, 100);
+
+    if(tf->size >= 1100)
+        CHECK(rv == 100 && !memcmp(buf, tf->data + 1000, 100),
+              "total() moved %s", tf->name);
+
+    /* Seeking before the start fails, and leaves the position alone */
+    errno = 0;
+    CHECK(vfs->seek(h, -1, SEEK_SET) == -1 && errno == EINVAL,
+          "seek to -1 in %s didn't fail with EINVAL", tf->name);
+    vfs->seek(h, 10, SEEK_SET);
+    errno = 0;
+    CHECK(vfs->seek(h, -11, SEEK_CUR) == -1 && errno == EINVAL,
+          "seek back past the start of %s didn't fail with EINVAL", tf->name);
+    CHECK(vfs->tell(h) == 10, "failed seek moved %s", tf->name);
+
+    vfs->close(h);
+    free(buf);
+}
+
+static void test_files(void) {
+    static const size_t chunks[] = { 1, 100, 1024, 5000, 8192, 70000, 2000000 };
+    size_t i, c;
+
+    for(i = 0; i < NFILES; i++) {
+        for(c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            if(chunks[c] == 1 && files[i].size > 100000)
+                continue;
+
+            test_sequential(&files[i], O_RDONLY, chunks[c]);
+        }
+
+        test_sequential(&files[i], O_RDWR, 4096);
+        test_random(&files[i]);
+    }
+}
+
+/* The read-ahead has to cut down the number of reads sent to the host */
+static void test_readahead(void) {
+    int reads = host_reads;
+
+    test_sequential(&files[5], O_RDONLY, 1024);
+    reads = host_reads - reads;
+    CHECK(reads <= 30, "reading %zu bytes 1KB at a time took %d reads",
+          files[5].size, reads);
+
+    /* but not for files that can be written to */
+    reads = host_reads;
+    test_sequential(&files[4], O_RDWR, 1024);
+    reads = host_reads - reads;
+    CHECK(reads == 99, "reading %zu bytes 1KB at a time read-write took %d reads",
+          files[4].size, reads);
+}
+
+/* More files open than there are read-ahead buffers */
+static void test_many(void) {
+    void *h[12];
+    uint8_t *buf = low_malloc(1000);
+    size_t pos;
+    int i;
+
+    for(i = 0; i < 12; i++) {
+        h[i] = vfs->open(vfs, files[4].name, O_RDONLY);
+        CHECK(h[i] != NULL, "can't open %s %d times", files[4].name, i + 1);
+    }
+
+    for(pos = 0; pos < files[4].size; pos += 1000) {
+        for(i = 0; i < 12; i++) {
+            if(vfs->read(h[i], buf, 1000) != 1000 ||
+               memcmp(buf, files[4].data + pos, 1000)) {
+                free(buf);
+                CHECK(0, "handle %d of %s is wrong at %zu", i, files[4].name, pos);
+            }
+        }
+    }
+
+    for(i = 0; i < 12; i++)
+        vfs->close(h[i]);
+
+    free(buf);
+}
+
+static void test_loss(void) {
+    host_drop = 7;
+    test_sequential(&files[5], O_RDONLY, 4096);
+    test_sequential(&files[5], O_RDWR, 100000);
+    host_drop = 0;
+
+    /* The last chunk of a transfer that's a multiple of 1KB used to be
+       asked for again with a size of 0, which ended the transfer */
+    host_drop_last = 1;
+    test_sequential(&files[5], O_RDONLY, 1024);
+    test_sequential(&files[4], O_RDWR, 3072);
+    test_sequential(&files[4], O_RDWR, 1000);
+    host_drop_last = 0;
+}
+
+/* Several threads reading at once, each with its own file */
+static void *reader_main(void *arg) {
+    const tfile_t *tf = arg;
+    int i;
+
+    for(i = 0; i < 3; i++)
+        test_sequential(tf, O_RDONLY, 1000 + i * 3000);
+
+    return NULL;
+}
+
+static pthread_t spawn_low(void *(*fn)(void *), void *arg) {
+    pthread_attr_t attr;
+    pthread_t t;
+    size_t size = 1024 * 1024;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, low_malloc(size), size);
+
+    if(pthread_create(&t, &attr, fn, arg)) {
+        fprintf(stderr, "can't create a thread\n");
+        exit(1);
+    }
+
+    pthread_attr_destroy(&attr);
+    return t;
+}
+
+static void test_threads(void) {
+    pthread_t t[4];
+    int i;
+
+    for(i = 0; i < 4; i++)
+        t[i] = spawn_low(reader_main, &files[2 + i]);
+
+    for(i = 0; i < 4; i++)
+        pthread_join(t[i], NULL);
+}
+
+/* Benchmark */
+
+static double bench_read(const tfile_t *tf, int mode, size_t chunk,
+                         int *reads) {
+    uint8_t *buf = low_malloc(chunk);
+    void *h = vfs->open(vfs, tf->name, mode);
+    double start = now();
+    size_t pos = 0;
+    ssize_t rv;
+
+    *reads = host_reads;
+
+    while((rv = vfs->read(h, buf, chunk)) > 0)
+        pos += rv;
+
+    *reads = host_reads - *reads;
+    vfs->close(h);
+    free(buf);
+
+    if(pos != tf->size)
+        fprintf(stderr, "short read of %s\n", tf->name);
+
+    return now() - start;
+}
+
+static void bench(void) {
+    static const size_t chunks[] = { 256, 1024, 4096, 32768, 262144 };
+    const tfile_t *tf = &files[5];
+    double t_old, t_new;
+    int r_old, r_new;
+    size_t c;
+
+    printf("%zu byte file, with %d us per round trip and %d us per 1KB packet\n",
+           tf->size, host_rtt_us, host_pkt_us);
+
+    for(c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        t_old = bench_read(tf, O_RDWR, chunks[c], &r_old);
+        t_new = bench_read(tf, O_RDONLY, chunks[c], &r_new);
+        printf("%6zu byte reads: %7.3f s, %5d reads before; %7.3f s, %5d reads "
+               "now; %.1fx faster\n", chunks[c], t_old, r_old, t_new, r_new,
+               t_old / t_new);
+    }
+}
+
+static int do_bench;
+
+static void *client_main(void *arg) {
+    (void)arg;
+
+    fs_dclsocket_init_console();
+
+    if(fs_dclsocket_init() || !vfs) {
+        fprintf(stderr, "fs_dclsocket_init() failed; is port 31313 in use?\n");
+        exit(1);
+    }
+
+    make_files();
+
+    if(do_bench) {
+        bench();
+    }
+    else {
+        test_files();
+        test_readahead();
+        test_many();
+        test_loss();
+        test_threads();
+    }
+
+    fs_dclsocket_shutdown();
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b] [-r us] [-p us]\n\n"
+            "  -b  run the benchmark instead of the tests\n"
+            "  -r  time added per round trip in the benchmark (default 300)\n"
+            "  -p  time added per 1KB packet in the benchmark (default 90)\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int c, rtt = 300, pkt = 90;
+    char cmd[600];
+
+    while((c = getopt(argc, argv, "br:p:")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            case 'r':
+                rtt = atoi(optarg);
+                break;
+            case 'p':
+                pkt = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    /* Keep every allocation on the main heap, below 4GB */
+    mallopt(M_MMAP_THRESHOLD, 256 * 1024 * 1024);
+    mallopt(M_ARENA_MAX, 1);
+
+    if(!mkdtemp(tmpdir)) {
+        perror(tmpdir);
+        return 1;
+    }
+
+    if(do_bench) {
+        host_rtt_us = rtt;
+        host_pkt_us = pkt;
+    }
+
+    host_port = host_start();
+    pthread_join(spawn_low(client_main, NULL), NULL);
+    pthread_join(host_thread, NULL);
+
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", tmpdir);
+
+    if(system(cmd))
+        fprintf(stderr, "can't remove %s\n", tmpdir);
+
+    if(do_bench)
+        return 0;
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
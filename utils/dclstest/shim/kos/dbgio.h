@@ -0,0 +1,33 @@
+/* KallistiOS ##version##
+
+   utils/dclstest/shim/kos/dbgio.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/dbgio.h. The handler has the same layout as the
+   real one, and the test provides the functions.
+*/
+
+#ifndef __KOS_DBGIO_H
+#define __KOS_DBGIO_H
+
+#include <arch/types.h>
+
+typedef struct dbgio_handler {
+    const char *name;
+    int (*detected)(void);
+    int (*init)(void);
+    int (*shutdown)(void);
+    int (*set_irq_usage)(int mode);
+    int (*read)(void);
+    int (*write)(int c);
+    int (*flush)(void);
+    int (*write_buffer)(const uint8 *data, int len, int xlat);
+    int (*read_buffer)(uint8 *data, int len);
+} dbgio_handler_t;
+
+extern dbgio_handler_t dbgio_null;
+
+const char *dbgio_dev_get(void);
+void dbgio_disable(void);
+
+#endif /* __KOS_DBGIO_H */
@@ -0,0 +1,28 @@
+/* KallistiOS ##version##
+
+   utils/dclstest/shim/kos/net.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/net.h, with just what fs_dclsocket.c needs. The
+   test provides the functions; the sockets are the host's.
+*/
+
+#ifndef __KOS_NET_H
+#define __KOS_NET_H
+
+#include <arch/types.h>
+#include <arch/irq.h>
+
+typedef struct knetif {
+    int (*if_rx_poll)(struct knetif *self);
+} netif_t;
+
+extern netif_t *net_default_dev;
+
+void net_ipv4_parse_address(uint32 addr, uint8 out[4]);
+int net_arp_lookup(netif_t *nif, const uint8 ip_in[4], uint8 mac_out[6],
+                   const void *pkt, const uint8 *data, int data_size);
+int net_arp_insert(netif_t *nif, const uint8 mac[6], const uint8 ip[4],
+                   uint64 timestamp);
+
+#endif /* __KOS_NET_H */
@@ -0,0 +1,922 @@
+/* KallistiOS ##version##
+
+   dnstest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the DNS resolver behind getaddrinfo() in
+   kernel/libc/koslib/getaddrinfo.c, which is built as-is on the host and
+   talks over real UDP sockets on the loopback interface to stand-in DNS
+   servers running in other threads, the same way one could be run on a
+   Dreamcast over the loopback path in net_ipv4.c.
+
+   Each stand-in server listens on its own 127.0.0.x address, and knows a
+   small zone of names under .test. It can wait before it answers, ignore
+   queries, answer them with SERVFAIL, or send some junk first. The test's
+   sendto() and recvfrom() move port 53 to the port the server is really
+   on, and the test provides the resolver's clock, so that it can move it
+   forward to make cached entries expire.
+
+   The tests check the answers, that they are cached for as long as their
+   TTLs allow and no longer, that names with no addresses are cached too,
+   that the A and AAAA queries go out together, that queries fail over to
+   the next server, and that the cache works from several threads at once.
+   The benchmark (-b) times lookups that go to the server, lookups that are
+   answered from the cache, and AF_UNSPEC lookups from a server that takes
+   a while to answer.
+*/
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kos/net.h>
+#include <arch/timer.h>
+
+/* The test calls the real ones; it's only getaddrinfo.c that gets the
+   wrappers below. */
+#undef sendto
+#undef recvfrom
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The resolver's clock, which the tests can move forward */
+
+static uint64_t clock_skew_ms;
+
+uint64 timer_ms_gettime64(void) {
+    return (uint64)(now() * 1000.0) + clock_skew_ms;
+}
+
+static void advance(int seconds) {
+    clock_skew_ms += seconds * 1000ULL;
+}
+
+/* The zone the servers know. Addresses are made from the index of the name:
+   10.0.i.k for A records and 2001:db8::i:k for AAAA ones. Names of the form
+   nN.test have one A record, 10.1.N/256.N%256, and any other name doesn't
+   exist. */
+
+typedef struct rec_t {
+    const char *name;
+    int n4, n6;             /* number of A and AAAA records */
+    uint32_t ttl;
+    uint32_t cname_ttl;     /* if not 0, answer through an alias */
+} rec_t;
+
+static const rec_t zone[] = {
+    { "host.test", 2, 1, 300, 0 },
+    { "v4only.test", 1, 0, 300, 0 },
+    { "alias.test", 1, 1, 300, 10 },
+    { "short.test", 1, 0, 5, 0 },
+    { "zero.test", 1, 0, 0, 0 },
+    { "many.test", 12, 0, 300, 0 },
+};
+
+#define NZONE       (int)(sizeof(zone) / sizeof(zone[0]))
+#define NEG_TTL     30      /* the SOA minimum */
+
+/* Stand-in DNS servers */
+
+#define NSERVERS    3
+#define MAX_QUEUED  64
+
+enum { SRV_ANSWER, SRV_DROP, SRV_SERVFAIL, SRV_JUNK };
+
+typedef struct reply_t {
+    double due;
+    struct sockaddr_in to;
+    int len;
+    uint8_t buf[512];
+} reply_t;
+
+typedef struct server_t {
+    int sock;
+    uint8_t addr[4];
+    uint16_t port;
+    int mode;
+    int delay_ms;
+    int queries[2];         /* A, AAAA */
+    reply_t queue[MAX_QUEUED];
+    int queued;
+    pthread_t thread;
+} server_t;
+
+static server_t servers[NSERVERS];
+static pthread_mutex_t srv_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int srv_stop;
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* Add a resource record naming the question, and return the new size */
+static int add_rr(uint8_t *m, int o, uint16_t type, uint32_t ttl,
+                  const uint8_t *data, int len) {
+    put16(m + o, 0xc00c);
+    put16(m + o + 2, type);
+    put16(m + o + 4, 1);
+    put32(m + o + 6, ttl);
+    put16(m + o + 10, len);
+    memcpy(m + o + 12, data, len);
+    return o + 12 + len;
+}
+
+static int add_soa(uint8_t *m, int o) {
+    static const uint8_t soa[] = {
+        2, 'n', 's', 4, 't', 'e', 's', 't', 0,
+        5, 'a', 'd', 'm', 'i', 'n', 0xc0, 12,
+        0, 0, 0, 1, 0, 0, 0x0e, 0x10, 0, 0, 0x02, 0x58, 0, 0x09, 0x3a, 0x80,
+        0, 0, 0, NEG_TTL
+    };
+
+    return add_rr(m, o, 6, 3600, soa, sizeof(soa));
+}
+
+/* Build the answer to a query in m, in place. Returns its size, or 0 if the
+   query doesn't make sense. */
+static int make_answer(server_t *s, uint8_t *m, int len) {
+    char name[256];
+    int o = 12, n = 0, i, k, num, idx = -1, an = 0, ns = 0, rcode = 0;
+    uint16_t qtype;
+    uint8_t a[16];
+    static const uint8_t target[] = { 6, 't', 'a', 'r', 'g', 'e', 't', 4,
+                                      't', 'e', 's', 't', 0 };
+
+    if(len < 17 || (m[2] & 0x80))
+        return 0;
+
+    while(o < len && m[o]) {
+        if(n)
+            name[n++] = '.';
+
+        memcpy(name + n, m + o + 1, m[o]);
+        n += m[o];
+        o += m[o] + 1;
+    }
+
+    name[n] = 0;
+
+    if(o + 5 > len)
+        return 0;
+
+    qtype = (m[o + 1] << 8) | m[o + 2];
+    o += 5;
+
+    pthread_mutex_lock(&srv_lock);
+    s->queries[qtype == 28]++;
+    pthread_mutex_unlock(&srv_lock);
+
+    for(i = 0; i < NZONE; i++) {
+        if(!strcasecmp(name, zone[i].name))
+            idx = i;
+    }
+
+    m[2] = 0x81;
+    m[3] = 0x80;
+
+    if(idx >= 0) {
+        const rec_t *r = &zone[idx];
+        uint32_t ttl = r->ttl;
+
+        if(r->cname_ttl) {
+            o = add_rr(m, o, 5, r->cname_ttl, target, sizeof(target));
+            an++;
+        }
+
+        for(k = 0; k < (qtype == 1 ? r->n4 : qtype == 28 ? r->n6 : 0); k++) {
+            memset(a, 0, sizeof(a));
+
+            if(qtype == 1) {
+                a[0] = 10;
+                a[2] = idx;
+                a[3] = k + 1;
+                o = add_rr(m, o, 1, ttl, a, 4);
+            }
+            else {
+                a[0] = 0x20;
+                a[1] = 0x01;
+                a[2] = 0x0d;
+                a[3] = 0xb8;
+                a[13] = idx;
+                a[15] = k + 1;
+                o = add_rr(m, o, 28, ttl, a, 16);
+            }
+
+            an++;
+        }
+    }
+    else if(sscanf(name, "n%d.tes%c", &num, (char *)a) == 2 && qtype == 1) {
+        a[0] = 10;
+        a[1] = 1;
+        a[2] = num >> 8;
+        a[3] = num;
+        o = add_rr(m, o, 1, 300, a, 4);
+        an++;
+    }
+    else if(strncmp(name, "n", 1) || qtype != 28) {
+        rcode = 3;
+    }
+
+    /* No answers (or no such name) comes with the zone's SOA, except for the
+       names that are there to test leaving it out */
+    if(!an && strncmp(name, "nosoa", 5)) {
+        o = add_soa(m, o);
+        ns++;
+    }
+
+    m[3] |= rcode;
+    put16(m + 6, an);
+    put16(m + 8, ns);
+    put16(m + 10, 0);
+    return o;
+}
+
+static void queue_reply(server_t *s, const uint8_t *buf, int len,
+                        const struct sockaddr_in *to, double due) {
+    reply_t *r;
+
+    if(s->queued == MAX_QUEUED)
+        return;
+
+    r = &s->queue[s->queued++];
+    r->due = due;
+    r->to = *to;
+    r->len = len;
+    memcpy(r->buf, buf, len);
+}
+
+static void handle_query(server_t *s, uint8_t *m, int len,
+                         const struct sockaddr_in *from) {
+    uint8_t junk[512];
+    double due;
+    int mode, rlen;
+
+    pthread_mutex_lock(&srv_lock);
+    mode = s->mode;
+    due = now() + s->delay_ms / 1000.0;
+    pthread_mutex_unlock(&srv_lock);
+
+    if(!(rlen = make_answer(s, m, len)))
+        return;
+
+    switch(mode) {
+        case SRV_DROP:
+            return;
+
+        case SRV_SERVFAIL:
+            m[3] = (m[3] & 0xf0) | 2;
+            put16(m + 6, 0);
+            put16(m + 8, 0);
+            break;
+
+        case SRV_JUNK:
+            /* Someone else's answer, with the wrong ID */
+            memcpy(junk, m, rlen);
+            junk[1] ^= 0x55;
+            junk[rlen - 1] = 66;
+            queue_reply(s, junk, rlen, from, due);
+
+            /* And an answer that runs off its end */
+            memcpy(junk, m, rlen);
+            queue_reply(s, junk, rlen - 3, from, due);
+            break;
+    }
+
+    queue_reply(s, m, rlen, from, due);
+}
+
+static void *server_main(void *arg) {
+    server_t *s = (server_t *)arg;
+    uint8_t buf[512];
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    struct pollfd pfd = { s->sock, POLLIN, 0 };
+    int i, timeout;
+    ssize_t len;
+    double t;
+
+    while(!srv_stop) {
+        /* Send whatever is due, in order */
+        t = now();
+        timeout = 20;
+
+        for(i = 0; i < s->queued;) {
+            if(s->queue[i].due <= t) {
+                sendto(s->sock, s->queue[i].buf, s->queue[i].len, 0,
+                       (struct sockaddr *)&s->queue[i].to,
+                       sizeof(s->queue[i].to));
+                memmove(&s->queue[i], &s->queue[i + 1],
+                        (s->queued - i - 1) * sizeof(reply_t));
+                s->queued--;
+            }
+            else {
+                if((s->queue[i].due - t) * 1000 + 1 < timeout)
+                    timeout = (int)((s->queue[i].due - t) * 1000) + 1;
+
+                i++;
+            }
+        }
+
+        if(poll(&pfd, 1, timeout) != 1)
+            continue;
+
+        fromlen = sizeof(from);
+        len = recvfrom(s->sock, buf, sizeof(buf), 0,
+                       (struct sockaddr *)&from, &fromlen);
+
+        if(len > 0)
+            handle_query(s, buf, (int)len, &from);
+    }
+
+    return NULL;
+}
+
+static void servers_start(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int i;
+
+    for(i = 0; i < NSERVERS; i++) {
+        server_t *s = &servers[i];
+
+        s->addr[0] = 127;
+        s->addr[3] = 2 + i;
+        s->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        memcpy(&addr.sin_addr, s->addr, 4);
+
+        if(s->sock < 0 || bind(s->sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+           getsockname(s->sock, (struct sockaddr *)&addr, &len)) {
+            perror("can't set up a stand-in DNS server");
+            exit(1);
+        }
+
+        s->port = ntohs(addr.sin_port);
+        pthread_create(&s->thread, NULL, server_main, s);
+    }
+}
+
+static void servers_stop(void) {
+    int i;
+
+    srv_stop = 1;
+
+    for(i = 0; i < NSERVERS; i++) {
+        pthread_join(servers[i].thread, NULL);
+        close(servers[i].sock);
+    }
+}
+
+static server_t *find_server(const struct sockaddr_in *sin) {
+    int i;
+
+    for(i = 0; i < NSERVERS; i++) {
+        if(!memcmp(&sin->sin_addr, servers[i].addr, 4))
+            return &servers[i];
+    }
+
+    return NULL;
+}
+
+/* What getaddrinfo.c calls instead of sendto() and recvfrom() */
+
+ssize_t dnstest_sendto(int fd, const void *buf, size_t len, int flags,
+                       const struct sockaddr *addr, socklen_t addrlen) {
+    struct sockaddr_in to;
+    server_t *s;
+
+    memcpy(&to, addr, sizeof(to));
+
+    if(addrlen == sizeof(to) && to.sin_family == AF_INET &&
+       to.sin_port == htons(53)) {
+        /* Nobody's there, but the packet is gone either way */
+        if(!(s = find_server(&to)))
+            return len;
+
+        to.sin_port = htons(s->port);
+    }
+
+    return sendto(fd, buf, len, flags, (struct sockaddr *)&to, sizeof(to));
+}
+
+ssize_t dnstest_recvfrom(int fd, void *buf, size_t len, int flags,
+                         struct sockaddr *addr, socklen_t *addrlen) {
+    ssize_t rv = recvfrom(fd, buf, len, flags, addr, addrlen);
+    struct sockaddr_in *from = (struct sockaddr_in *)addr;
+    server_t *s;
+
+    if(rv >= 0 && addr && (s = find_server(from)) &&
+       from->sin_port == htons(s->port))
+        from->sin_port = htons(53);
+
+    return rv;
+}
+
+/* What the resolver needs from the rest of KOS */
+
+static netif_t dev;
+netif_t *net_default_dev = &dev;
+
+uint32 net_ipv4_address(const uint8 addr[4]) {
+    return (addr[0] << 24) | (addr[1] << 16) | (addr[2] << 8) | addr[3];
+}
+
+/* Helpers */
+
+static void setup(int primary, int mode0, int delay0) {
+    int i;
+
+    pthread_mutex_lock(&srv_lock);
+
+    for(i = 0; i < NSERVERS; i++) {
+        servers[i].mode = SRV_ANSWER;
+        servers[i].delay_ms = 0;
+        servers[i].queries[0] = servers[i].queries[1] = 0;
+    }
+
+    servers[primary].mode = mode0;
+    servers[primary].delay_ms = delay0;
+    pthread_mutex_unlock(&srv_lock);
+
+    memcpy(dev.dns, servers[primary].addr, 4);
+    net_dns_set_servers(NULL, 0);
+    net_dns_flush();
+}
+
+static int queries(int srv, int type) {
+    int rv;
+
+    pthread_mutex_lock(&srv_lock);
+    rv = type == 28 ? servers[srv].queries[1] : servers[srv].queries[0];
+    pthread_mutex_unlock(&srv_lock);
+    return rv;
+}
+
+static int total_queries(void) {
+    int i, rv = 0;
+
+    for(i = 0; i < NSERVERS; i++)
+        rv += queries(i, 1) + queries(i, 28);
+
+    return rv;
+}
+
+static int lookup(const char *name, int family, struct addrinfo **res) {
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_STREAM;
+    *res = NULL;
+    return getaddrinfo(name, "80", &hints, res);
+}
+
+static int count_ai(const struct addrinfo *ai, int family) {
+    int rv = 0;
+
+    for(; ai; ai = ai->ai_next) {
+        if(!family || ai->ai_family == family)
+            rv++;
+    }
+
+    return rv;
+}
+
+/* Lookup that should succeed, returning how many addresses came back */
+static int lookup_ok(const char *name, int family) {
+    struct addrinfo *res;
+    int rv = lookup(name, family, &res);
+
+    if(rv) {
+        fprintf(stderr, "  lookup of %s (family %d) failed with %d\n", name,
+                family, rv);
+        return -1;
+    }
+
+    rv = count_ai(res, 0);
+    freeaddrinfo(res);
+    return rv;
+}
+
+/* Tests */
+
+static void test_basic(void) {
+    struct addrinfo *res, *ai;
+    struct sockaddr_in *sin;
+    net_dns_stats_t st;
+    int rv;
+
+    setup(0, SRV_ANSWER, 0);
+    rv = lookup("host.test", AF_INET, &res);
+    CHECK(rv == 0, "lookup failed with %d", rv);
+    CHECK(count_ai(res, AF_INET) == 2 && count_ai(res, 0) == 2,
+          "got %d addresses", count_ai(res, 0));
+
+    for(ai = res, rv = 1; ai; ai = ai->ai_next, rv++) {
+        sin = (struct sockaddr_in *)ai->ai_addr;
+        CHECK(ntohl(sin->sin_addr.s_addr) == (0x0a000000u | rv) &&
+              ntohs(sin->sin_port) == 80 && ai->ai_socktype == SOCK_STREAM,
+              "address %d is %s:%d", rv, inet_ntoa(sin->sin_addr),
+              ntohs(sin->sin_port));
+    }
+
+    freeaddrinfo(res);
+    CHECK(queries(0, 1) == 1 && queries(0, 28) == 0, "server got %d/%d queries",
+          queries(0, 1), queries(0, 28));
+
+    /* The second time comes out of the cache */
+    st = net_dns_get_stats();
+    CHECK(lookup_ok("host.test", AF_INET) == 2, "cached lookup failed");
+    CHECK(total_queries() == 1, "cached lookup went to the server");
+    CHECK(net_dns_get_stats().cache_hits == st.cache_hits + 1,
+          "hit wasn't counted");
+
+    /* Names are the same no matter the case, or a trailing dot */
+    CHECK(lookup_ok("HoSt.TEST.", AF_INET) == 2, "lookup with a dot failed");
+    CHECK(total_queries() == 1, "lookup with a dot went to the server");
+}
+
+static void test_unspec(void) {
+    struct addrinfo *res, *ai;
+    double t;
+    int rv;
+
+    /* With a slow server, asking one after the other would take twice as
+       long as asking both at once */
+    setup(0, SRV_ANSWER, 200);
+    t = now();
+    rv = lookup("host.test", AF_UNSPEC, &res);
+    t = now() - t;
+    CHECK(rv == 0, "lookup failed with %d", rv);
+    CHECK(count_ai(res, AF_INET) == 2 && count_ai(res, AF_INET6) == 1,
+          "got %d IPv4 and %d IPv6 addresses", count_ai(res, AF_INET),
+          count_ai(res, AF_INET6));
+    CHECK(res->ai_family == AF_INET && res->ai_next->ai_family == AF_INET &&
+          res->ai_next->ai_next->ai_family == AF_INET6,
+          "IPv4 addresses don't come first");
+
+    ai = res->ai_next->ai_next;
+    CHECK(((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr.s6_addr[15] == 1 &&
+          ((struct sockaddr_in6 *)ai->ai_addr)->sin6_port == htons(80),
+          "wrong IPv6 address");
+    freeaddrinfo(res);
+
+    CHECK(queries(0, 1) == 1 && queries(0, 28) == 1, "server got %d/%d queries",
+          queries(0, 1), queries(0, 28));
+    CHECK(t < 0.35, "lookup took %.3f s with 200 ms per answer", t);
+
+    /* Both halves are cached */
+    CHECK(lookup_ok("host.test", AF_INET6) == 1, "cached IPv6 lookup failed");
+    CHECK(lookup_ok("host.test", AF_UNSPEC) == 3, "cached lookup failed");
+    CHECK(total_queries() == 2, "cached lookups went to the server");
+}
+
+static void test_ttl(void) {
+    setup(0, SRV_ANSWER, 0);
+
+    CHECK(lookup_ok("short.test", AF_INET) == 1, "lookup failed");
+    advance(4);
+    CHECK(lookup_ok("short.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 1, "entry expired before its TTL");
+    advance(2);
+    CHECK(lookup_ok("short.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 2, "entry outlived its TTL");
+
+    /* The addresses behind an alias are good for as long as it is */
+    CHECK(lookup_ok("alias.test", AF_INET) == 1, "alias lookup failed");
+    advance(9);
+    CHECK(lookup_ok("alias.test", AF_INET) == 1, "alias lookup failed");
+    CHECK(total_queries() == 3, "alias expired too early");
+    advance(2);
+    CHECK(lookup_ok("alias.test", AF_INET) == 1, "alias lookup failed");
+    CHECK(total_queries() == 4, "alias outlived its TTL");
+
+    /* A TTL of zero means not to cache it at all */
+    CHECK(lookup_ok("zero.test", AF_INET) == 1, "lookup failed");
+    CHECK(lookup_ok("zero.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 6, "TTL of zero was cached");
+}
+
+static void test_negative(void) {
+    struct addrinfo *res;
+    net_dns_stats_t st;
+    int rv;
+
+    setup(0, SRV_ANSWER, 0);
+
+    rv = lookup("nothere.test", AF_INET, &res);
+    CHECK(rv == EAI_NONAME && !res, "lookup returned %d", rv);
+    st = net_dns_get_stats();
+    rv = lookup("nothere.test", AF_INET, &res);
+    CHECK(rv == EAI_NONAME && !res, "cached lookup returned %d", rv);
+    CHECK(total_queries() == 1, "missing name wasn't cached");
+    CHECK(net_dns_get_stats().cache_neg_hits == st.cache_neg_hits + 1,
+          "negative hit wasn't counted");
+
+    /* For as long as the SOA says */
+    advance(NEG_TTL - 1);
+    lookup("nothere.test", AF_INET, &res);
+    CHECK(total_queries() == 1, "missing name expired too early");
+    advance(2);
+    lookup("nothere.test", AF_INET, &res);
+    CHECK(total_queries() == 2, "missing name outlived the SOA minimum");
+
+    /* Without an SOA, it isn't cached at all */
+    rv = lookup("nosoa.test", AF_INET, &res);
+    CHECK(rv == EAI_NONAME && !res, "lookup returned %d", rv);
+    rv = lookup("nosoa.test", AF_INET, &res);
+    CHECK(rv == EAI_NONAME && !res, "lookup returned %d", rv);
+    CHECK(total_queries() == 4, "missing name without an SOA was cached");
+
+    /* A name with no addresses of one type */
+    rv = lookup("v4only.test", AF_INET6, &res);
+    CHECK(rv == EAI_NONAME && !res, "IPv6 lookup returned %d", rv);
+    CHECK(lookup_ok("v4only.test", AF_UNSPEC) == 1, "lookup failed");
+    CHECK(queries(0, 1) == 5 && queries(0, 28) == 1,
+          "server got %d/%d queries", queries(0, 1), queries(0, 28));
+    CHECK(lookup_ok("v4only.test", AF_UNSPEC) == 1, "lookup failed");
+    CHECK(total_queries() == 6, "cached lookup went to the server");
+
+    /* Names that can't be valid never get to the server */
+    rv = lookup("a..test", AF_INET, &res);
+    CHECK(rv == EAI_NONAME, "empty label returned %d", rv);
+    rv = lookup("a1234567890123456789012345678901234567890123456789012345678901234"
+                ".test", AF_INET, &res);
+    CHECK(rv == EAI_NONAME, "long label returned %d", rv);
+    CHECK(total_queries() == 6, "bad names went to the server");
+}
+
+static void test_failover(void) {
+    static const uint8 backup[2][4] = { { 0, 0, 0, 0 }, { 127, 0, 0, 3 } };
+    struct addrinfo *res;
+    net_dns_stats_t st;
+    double t;
+    int rv;
+
+    /* The device's server never answers, so the backup has to */
+    setup(0, SRV_DROP, 0);
+    CHECK(net_dns_set_servers(backup, 2) == 0, "can't set servers");
+    st = net_dns_get_stats();
+    t = now();
+    CHECK(lookup_ok("host.test", AF_UNSPEC) == 3, "lookup failed");
+    t = now() - t;
+    CHECK(queries(1, 1) == 1 && queries(1, 28) == 1,
+          "backup got %d/%d queries", queries(1, 1), queries(1, 28));
+    CHECK(t > 0.45 && t < 0.8, "failover took %.3f s", t);
+    CHECK(net_dns_get_stats().failovers == st.failovers + 1 &&
+          net_dns_get_stats().timeouts == st.timeouts + 1,
+          "failover wasn't counted");
+
+    /* A server failure moves on straight away */
+    setup(0, SRV_SERVFAIL, 0);
+    net_dns_set_servers(backup, 2);
+    t = now();
+    CHECK(lookup_ok("host.test", AF_UNSPEC) == 3, "lookup failed");
+    t = now() - t;
+    CHECK(t < 0.2, "failover after SERVFAIL took %.3f s", t);
+    CHECK(queries(1, 1) == 1 && queries(1, 28) == 1,
+          "backup got %d/%d queries", queries(1, 1), queries(1, 28));
+
+    /* With only the failing server, that's the answer */
+    setup(0, SRV_SERVFAIL, 0);
+    rv = lookup("host.test", AF_INET, &res);
+    CHECK(rv == EAI_AGAIN, "lookup returned %d", rv);
+
+    /* And with nobody answering, it times out and isn't cached */
+    setup(0, SRV_DROP, 0);
+    t = now();
+    errno = 0;
+    rv = lookup("host.test", AF_INET, &res);
+    t = now() - t;
+    CHECK(rv == EAI_SYSTEM && errno == ETIMEDOUT, "lookup returned %d (%s)",
+          rv, strerror(errno));
+    CHECK(t > 1.9 && t < 2.5, "timing out took %.3f s", t);
+    pthread_mutex_lock(&srv_lock);
+    servers[0].mode = SRV_ANSWER;
+    pthread_mutex_unlock(&srv_lock);
+    CHECK(lookup_ok("host.test", AF_INET) == 2, "lookup failed");
+
+    CHECK(net_dns_set_servers(backup, NET_DNS_MAX_SERVERS + 1) == -1 &&
+          errno == EINVAL, "too many servers were accepted");
+}
+
+static void test_junk(void) {
+    struct addrinfo *res;
+    int rv;
+
+    /* Answers with the wrong ID or that run off their end are ignored */
+    setup(0, SRV_JUNK, 0);
+    rv = lookup("host.test", AF_INET, &res);
+    CHECK(rv == 0 && count_ai(res, 0) == 2, "lookup returned %d", rv);
+    CHECK(((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr ==
+          htonl(0x0a000001), "took the wrong answer");
+    freeaddrinfo(res);
+    CHECK(total_queries() == 1, "server got %d queries", total_queries());
+
+    /* Only so many addresses are kept */
+    rv = lookup_ok("many.test", AF_INET);
+    CHECK(rv == 8, "got %d addresses", rv);
+}
+
+static void test_cache(void) {
+    char name[32];
+    net_dns_stats_t st;
+    int i;
+
+    setup(0, SRV_ANSWER, 0);
+
+    for(i = 0; i < 16; i++) {
+        sprintf(name, "n%d.test", i);
+        CHECK(lookup_ok(name, AF_INET) == 1, "lookup of %s failed", name);
+    }
+
+    st = net_dns_get_stats();
+    CHECK(st.entries == 16, "%d entries in the cache", (int)st.entries);
+
+    /* The least recently used one is replaced */
+    CHECK(lookup_ok("n0.test", AF_INET) == 1, "lookup failed");
+    CHECK(lookup_ok("n16.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 17, "server got %d queries", total_queries());
+    CHECK(lookup_ok("n0.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 17, "recently used entry was replaced");
+    CHECK(lookup_ok("n1.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 18, "least recently used entry wasn't replaced");
+
+    net_dns_flush();
+    CHECK(net_dns_get_stats().entries == 0, "flush left entries");
+    CHECK(lookup_ok("n0.test", AF_INET) == 1, "lookup failed");
+    CHECK(total_queries() == 19, "flushed entry was still used");
+}
+
+static volatile int thread_errors;
+
+static void *lookup_main(void *arg) {
+    char name[32];
+    struct addrinfo *res;
+    struct sockaddr_in *sin;
+    int i, n, id = (int)(intptr_t)arg;
+
+    for(i = 0; i < 300; i++) {
+        n = (id * 7 + i) % 24;
+        sprintf(name, "n%d.test", n);
+
+        if(lookup(name, AF_INET, &res)) {
+            thread_errors++;
+            continue;
+        }
+
+        sin = (struct sockaddr_in *)res->ai_addr;
+
+        if(count_ai(res, 0) != 1 || ntohl(sin->sin_addr.s_addr) != (0x0a010000u | n))
+            thread_errors++;
+
+        freeaddrinfo(res);
+
+        if(id == 0 && i % 50 == 0)
+            net_dns_flush();
+    }
+
+    return NULL;
+}
+
+static void test_threads(void) {
+    pthread_t t[8];
+    intptr_t i;
+
+    setup(0, SRV_ANSWER, 0);
+    thread_errors = 0;
+
+    for(i = 0; i < 8; i++)
+        pthread_create(&t[i], NULL, lookup_main, (void *)i);
+
+    for(i = 0; i < 8; i++)
+        pthread_join(t[i], NULL);
+
+    CHECK(!thread_errors, "%d lookups went wrong", thread_errors);
+}
+
+/* Benchmark */
+
+static double bench_lookups(const char *name, int family, int flush, int n) {
+    double t = now();
+    int i;
+
+    for(i = 0; i < n; i++) {
+        if(flush)
+            net_dns_flush();
+
+        if(lookup_ok(name, family) < 1)
+            fprintf(stderr, "lookup of %s failed\n", name);
+    }
+
+    return (now() - t) / n;
+}
+
+static void bench(int delay) {
+    double cold, warm;
+
+    setup(0, SRV_ANSWER, 0);
+    cold = bench_lookups("host.test", AF_INET, 1, 2000);
+    warm = bench_lookups("host.test", AF_INET, 0, 200000);
+    printf("AF_INET over loopback: %8.2f us from the server, %6.3f us cached; "
+           "%.0fx faster\n", cold * 1e6, warm * 1e6, cold / warm);
+
+    setup(0, SRV_ANSWER, delay);
+    cold = bench_lookups("host.test", AF_UNSPEC, 1, 10);
+    warm = bench_lookups("host.test", AF_UNSPEC, 0, 200000);
+    printf("AF_UNSPEC with %d ms per answer: %8.2f ms from the server "
+           "(%d ms if asked one at a time), %6.3f us cached\n", delay,
+           cold * 1e3, delay * 2, warm * 1e6);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b] [-d ms]\n\n"
+            "  -b  run the benchmark instead of the tests\n"
+            "  -d  time the server takes to answer in the benchmark "
+            "(default 50)\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int c, do_bench = 0, delay = 50;
+
+    while((c = getopt(argc, argv, "bd:")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            case 'd':
+                delay = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    servers_start();
+
+    if(do_bench) {
+        bench(delay);
+    }
+    else {
+        test_basic();
+        test_unspec();
+        test_ttl();
+        test_negative();
+        test_failover();
+        test_junk();
+        test_cache();
+        test_threads();
+    }
+
+    servers_stop();
+
+    if(do_bench)
+        return 0;
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
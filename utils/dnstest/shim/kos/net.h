@@ -0,0 +1,39 @@
+/* KallistiOS ##version##
+
+   utils/dnstest/shim/kos/net.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/net.h, with just what getaddrinfo.c needs. The
+   test provides the functions; the sockets are the host's.
+*/
+
+#ifndef __KOS_NET_H
+#define __KOS_NET_H
+
+#include <arch/types.h>
+
+typedef struct knetif {
+    uint8 dns[4];
+} netif_t;
+
+extern netif_t *net_default_dev;
+
+uint32 net_ipv4_address(const uint8 addr[4]);
+
+#define NET_DNS_MAX_SERVERS     4
+
+typedef struct net_dns_stats {
+    uint32  cache_hits;
+    uint32  cache_neg_hits;
+    uint32  cache_misses;
+    uint32  queries_sent;
+    uint32  timeouts;
+    uint32  failovers;
+    uint32  entries;
+} net_dns_stats_t;
+
+net_dns_stats_t net_dns_get_stats(void);
+void net_dns_flush(void);
+int net_dns_set_servers(const uint8 servers[][4], int count);
+
+#endif /* __KOS_NET_H */
@@ -0,0 +1,24 @@
+/* KallistiOS ##version##
+
+   utils/dnstest/shim/sys/socket.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The host's sys/socket.h, with sendto() and recvfrom() going through the
+   test. Queries to port 53 go to whichever port the stand-in server on that
+   address is really listening on, since that one needs root to bind.
+*/
+
+#ifndef __DNSTEST_SYS_SOCKET_H
+#define __DNSTEST_SYS_SOCKET_H
+
+#include_next <sys/socket.h>
+
+ssize_t dnstest_sendto(int fd, const void *buf, size_t len, int flags,
+                       const struct sockaddr *addr, socklen_t addrlen);
+ssize_t dnstest_recvfrom(int fd, void *buf, size_t len, int flags,
+                         struct sockaddr *addr, socklen_t *addrlen);
+
+#define sendto      dnstest_sendto
+#define recvfrom    dnstest_recvfrom
+
+#endif /* __DNSTEST_SYS_SOCKET_H */
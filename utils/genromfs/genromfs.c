@@ -20,6 +20,8 @@
  *                      (Florian Schulze, Brian Peek)
  *     13 Aug 2020              Mingw build fixes
  *                      (Hayden Kowalchuk)
+ *     19 Oct 2026              Packed (block compressed) regular files
+ *                      (KallistiOS Contributors)
  */
 
 /*
@@ -56,6 +58,10 @@
  * -A N,/name force named file(s) (shell globbing applied against the filenames)
  *       to be aligned on N bytes boundary
  * In both cases, N must be a power of two.
+ * -z    pack regular files into independently compressed blocks; only
+ *       the KallistiOS romdisk driver can read those
+ * -b N  use N byte blocks for packed files (512 to 65536, power of two)
+ * -Z /name never pack the named file(s), e.g. to keep them mmap()able
  */
 
 /*
@@ -110,6 +116,23 @@ struct romfh {
 #define ROMFH_FIF 7
 #define ROMFH_EXEC 8
 
+/* A packed regular file has this in the spec field of its header, and its
+   data starts with a big-endian block header:
+
+     char magic[4]          "RDZ1"
+     uint32 size            size of the unpacked file
+     uint32 shift           log2 of the block size
+     uint32 blocks          number of blocks
+     uint32 offset[blocks + 1]
+                            where each block starts, from the start of the
+                            data; the last one is where the last block ends
+
+   Each block is an LZ4 block on its own. A block whose packed size equals
+   its unpacked size is stored as it is. */
+#define ROMFS_SPEC_PACKED 1
+#define PACK_MAGIC "RDZ1"
+#define PACK_HDRSIZE 16
+
 struct filenode;
 
 struct filehdr {
@@ -138,6 +161,8 @@ struct filenode {
     unsigned int offset;
     unsigned int size;
     unsigned int pad;
+    unsigned char *packed;  /* packed data, if the file is packed */
+    unsigned int rawsize;   /* size of the file before packing */
 };
 
 struct aligns {
@@ -182,6 +207,9 @@ void shownode(int level, struct filenode *node, FILE *f) {
     if(node->orig_link)
         fprintf(f, " [link to 0x%-6x]", node->orig_link->offset);
 
+    if(node->packed)
+        fprintf(f, " [packed from %u]", node->rawsize);
+
     fprintf(f, "\n");
 
     p = node->dirlist.head;
@@ -200,7 +228,10 @@ static int atoffs = 0;
 static int align = 16;
 struct aligns *alignlist = NULL;
 struct excludes *excludelist = NULL;
+struct excludes *storelist = NULL;
 int realbase;
+static int pack = 0;
+static int packshift = 12;
 
 /* helper function to match an exclusion or align pattern */
 
@@ -377,6 +408,12 @@ int dumpnode(struct filenode *node, FILE *f) {
         dumpdataa(bigbuf, node->size, f);
     }
 #endif
+    else if(S_ISREG(node->modes) && node->packed) {
+        ri.nextfh |= htonl(ROMFH_REG);
+        ri.spec = htonl(ROMFS_SPEC_PACKED);
+        dumpri(&ri, node, f);
+        dumpdataa(node->packed, node->size, f);
+    }
     else if(S_ISREG(node->modes)) {
         int offset, len, fd, max, avail;
         ri.nextfh |= htonl(ROMFH_REG);
@@ -472,6 +509,201 @@ int dumpall(struct filenode *node, int lastoff, FILE *f) {
     return 0;
 }
 
+/* Packing functions */
+
+#define PACK_MINMATCH 4
+#define PACK_LASTLITERALS 5     /* the last bytes of a block are literals */
+#define PACK_MFLIMIT 12         /* and no match starts closer to the end */
+#define PACK_HASHBITS 14
+#define PACK_MAXCHAIN 64
+
+static int packhead[1 << PACK_HASHBITS];
+static int packchain[65536];
+
+static unsigned int packhash(const unsigned char *p) {
+    uint32_t v = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    return (v * 2654435761U) >> (32 - PACK_HASHBITS);
+}
+
+static unsigned char *packlen(unsigned char *op, unsigned int len) {
+    while(len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = len;
+    return op;
+}
+
+/* Write one sequence: the literals, then a match if mlen isn't zero. */
+static unsigned char *packseq(unsigned char *op, const unsigned char *lit,
+                              unsigned int litlen, unsigned int offset,
+                              unsigned int mlen) {
+    unsigned char *token = op++;
+
+    *token = (litlen < 15 ? litlen : 15) << 4;
+
+    if(litlen >= 15)
+        op = packlen(op, litlen - 15);
+
+    memcpy(op, lit, litlen);
+    op += litlen;
+
+    if(mlen) {
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        mlen -= PACK_MINMATCH;
+        *token |= mlen < 15 ? mlen : 15;
+
+        if(mlen >= 15)
+            op = packlen(op, mlen - 15);
+    }
+
+    return op;
+}
+
+static void packinsert(const unsigned char *src, int pos) {
+    unsigned int h = packhash(src + pos);
+
+    packchain[pos] = packhead[h];
+    packhead[h] = pos;
+}
+
+/* Compress one block as an LZ4 block. This takes the longest match out of a
+   few candidates, which is slow, but the image is only built once and the
+   blocks decompress just as fast. dst needs room for len + len / 255 + 16
+   bytes. */
+int packblock(const unsigned char *src, int len, unsigned char *dst) {
+    unsigned char *op = dst;
+    int ip = 0, anchor = 0, cand, depth, limit, best, bestoff, m, i;
+
+    for(i = 0; i < (1 << PACK_HASHBITS); i++)
+        packhead[i] = -1;
+
+    while(ip + PACK_MFLIMIT <= len) {
+        limit = len - PACK_LASTLITERALS - ip;
+        best = bestoff = 0;
+        depth = PACK_MAXCHAIN;
+
+        for(cand = packhead[packhash(src + ip)]; cand >= 0 && depth-- > 0 &&
+                ip - cand <= 65535; cand = packchain[cand]) {
+            if(memcmp(src + cand, src + ip, PACK_MINMATCH))
+                continue;
+
+            for(m = PACK_MINMATCH; m < limit && src[cand + m] == src[ip + m]; m++)
+                ;
+
+            if(m > best) {
+                best = m;
+                bestoff = ip - cand;
+
+                if(m == limit)
+                    break;
+            }
+        }
+
+        packinsert(src, ip);
+
+        if(best < PACK_MINMATCH) {
+            ip++;
+            continue;
+        }
+
+        op = packseq(op, src + anchor, ip - anchor, bestoff, best);
+
+        for(i = 1; i < best && ip + i + 4 <= len; i++)
+            packinsert(src, ip + i);
+
+        ip += best;
+        anchor = ip;
+    }
+
+    op = packseq(op, src + anchor, len - anchor, 0, 0);
+    return op - dst;
+}
+
+static void packput(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* Pack a regular file, if it's worth it. Files that don't get any smaller are
+   left as they are, so they can still be mmap()ed. */
+int packnode(struct filenode *node) {
+    struct excludes *pe;
+    unsigned char *raw, *out, *op;
+    unsigned int bsize = 1 << packshift, blocks, b, blen, plen, hdrlen;
+    FILE *fp;
+
+    if(!node->size)
+        return 0;
+
+    for(pe = storelist; pe; pe = pe->next) {
+        if(!nodematch(pe->pattern, node))
+            return 0;
+    }
+
+    blocks = (node->size + bsize - 1) >> packshift;
+    hdrlen = PACK_HDRSIZE + 4 * (blocks + 1);
+    raw = malloc(node->size);
+    out = malloc(hdrlen + node->size + node->size / 255 + 16 * blocks);
+
+    if(!raw || !out) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    fp = fopen(node->realname, "rb");
+
+    if(!fp || fread(raw, 1, node->size, fp) != node->size) {
+        fprintf(stderr, "can't read '%s'\n", node->realname);
+
+        if(fp)
+            fclose(fp);
+
+        free(raw);
+        free(out);
+        return 1;
+    }
+
+    fclose(fp);
+
+    memcpy(out, PACK_MAGIC, 4);
+    packput(out + 4, node->size);
+    packput(out + 8, packshift);
+    packput(out + 12, blocks);
+    op = out + hdrlen;
+
+    for(b = 0; b < blocks; b++) {
+        blen = node->size - b * bsize < bsize ? node->size - b * bsize : bsize;
+        packput(out + PACK_HDRSIZE + 4 * b, op - out);
+        plen = packblock(raw + b * bsize, blen, op);
+
+        /* Store blocks that don't compress */
+        if(plen >= blen) {
+            memcpy(op, raw + b * bsize, blen);
+            plen = blen;
+        }
+
+        op += plen;
+    }
+
+    packput(out + PACK_HDRSIZE + 4 * blocks, op - out);
+    free(raw);
+
+    if((unsigned int)(op - out) >= node->size) {
+        free(out);
+        return 0;
+    }
+
+    node->packed = out;
+    node->rawsize = node->size;
+    node->size = op - out;
+    return 0;
+}
+
 /* Node manipulating functions */
 
 void freenode(struct filenode *n) {
@@ -542,6 +774,8 @@ struct filenode *newnode(const char *base, const char *name, int curroffset) {
     node->orig_link = NULL;
     node->offset = curroffset;
     node->pad = 0;
+    node->packed = NULL;
+    node->rawsize = 0;
 
     return node;
 }
@@ -744,6 +978,9 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
         if(S_ISREG(sb->st_mode)) {
             curroffset = alignnode(n, curroffset, spaceneeded(n));
             n->size = sb->st_size;
+
+            if(pack && packnode(n))
+                return -1;
         }
         else
             curroffset = alignnode(n, curroffset, 0);
@@ -791,6 +1028,9 @@ void showhelp(const char *argv0) {
     printf("  -a ALIGN               Align regular file data to ALIGN bytes\n");
     printf("  -A ALIGN,PATTERN       Align all objects matching pattern to at least ALIGN bytes\n");
     printf("  -x PATTERN             Exclude all objects matching pattern\n");
+    printf("  -z                     Pack regular files into compressed blocks\n");
+    printf("  -b SIZE                Use SIZE byte blocks for packed files (default 4096)\n");
+    printf("  -Z PATTERN             Don't pack files matching pattern\n");
     printf("  -h                     Show this help\n");
     printf("\n");
     printf("Report bugs to chexum@shadow.banki.hu\n");
@@ -812,7 +1052,7 @@ int main(int argc, char *argv[]) {
     struct excludes *pe, *pe2;
     FILE *f;
 
-    while((c = getopt(argc, argv, "V:vd:f:ha:A:x:")) != EOF) {
+    while((c = getopt(argc, argv, "V:vd:f:ha:A:x:zb:Z:")) != EOF) {
         switch(c) {
             case 'd':
                 dir = optarg;
@@ -881,6 +1121,37 @@ int main(int argc, char *argv[]) {
                     pe2->next = pe;
                 }
 
+                break;
+            case 'z':
+                pack = 1;
+                break;
+            case 'b':
+                i = strtoul(optarg, NULL, 0);
+
+                for(packshift = 9; packshift < 16; packshift++)
+                    if((1 << packshift) >= i)
+                        break;
+
+                if(i != (1 << packshift)) {
+                    fprintf(stderr, "Block size has to be a power of two from 512 to 65536 bytes\n");
+                    exit(1);
+                }
+
+                break;
+            case 'Z':
+                pe = (struct excludes *)malloc(sizeof(*pe) + strlen(optarg) + 1);
+                pe->next = NULL;
+                strcpy(pe->pattern, optarg);
+
+                if(!storelist)
+                    storelist = pe;
+                else {
+                    for(pe2 = storelist; pe2->next; pe2 = pe2->next)
+                        ;
+
+                    pe2->next = pe;
+                }
+
                 break;
             default:
                 exit(1);
@@ -0,0 +1,1046 @@
+/* KallistiOS ##version##
+
+   hostbench.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based microbenchmarks for the parts of KOS that don't depend on the
+   hardware, built as-is on the host: the CRC and IP checksum routines of
+   kernel/net, the path handling of kernel/fs, the texture twiddler, the
+   dlmalloc of koslib (under other names, so it doesn't replace the host's),
+   and libkosext2fs, reading an image made by the host's mke2fs through a
+   memory-backed block device.
+
+   Each benchmark is calibrated to run for a minimum time, and then timed over
+   a few samples, of which the median is reported. The results can be written
+   out as JSON, and compared to an earlier run, to catch regressions on any
+   machine. A few checks are run on the results of the code under test first,
+   so that a benchmark never times something that's broken.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <kos/net.h>
+#include <kos/fs.h>
+#include <kos/fs_socket.h>
+#include <arch/timer.h>
+#include <dc/pvr.h>
+
+#include "../../kernel/net/net_ipv4.h"
+#include "../../kernel/net/net_icmp.h"
+
+#include "ext2fs.h"
+#include "inode.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return -1; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Keeps the compiler from throwing away the work being timed */
+static volatile uint32_t sink;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void fill_random(uint8_t *buf, size_t size) {
+    size_t i;
+
+    for(i = 0; i < size; i++)
+        buf[i] = rng();
+}
+
+/* What the code under test needs from the rest of KOS */
+
+netif_t *net_default_dev;
+
+uint64 timer_ms_gettime64(void) {
+    return (uint64)(now() * 1000.0);
+}
+
+uint64 timer_us_gettime64(void) {
+    return (uint64)(now() * 1000000.0);
+}
+
+int fs_socket_input(netif_t *src, int domain, int protocol, const void *hdr,
+                    const uint8 *data, size_t size) {
+    (void)src; (void)domain; (void)protocol; (void)hdr; (void)data;
+    (void)size;
+    return -1;
+}
+
+int net_arp_insert(netif_t *nif, const uint8 mac[6], const uint8 ip[4],
+                   uint64 timestamp) {
+    (void)nif; (void)mac; (void)ip; (void)timestamp;
+    return 0;
+}
+
+int net_arp_lookup(netif_t *nif, const uint8 ip_in[4], uint8 mac_out[6],
+                   const ip_hdr_t *pkt, const uint8 *data, int data_size) {
+    (void)nif; (void)ip_in; (void)mac_out; (void)pkt; (void)data;
+    (void)data_size;
+    return -1;
+}
+
+int net_icmp_input(netif_t *src, const ip_hdr_t *ih, const uint8 *data,
+                   size_t size) {
+    (void)src; (void)ih; (void)data; (void)size;
+    return 0;
+}
+
+int net_icmp_send_dest_unreach(netif_t *net, uint8 code, const uint8 *msg) {
+    (void)net; (void)code; (void)msg;
+    return 0;
+}
+
+int net_ipv4_frag_send(netif_t *net, ip_hdr_t *hdr, const uint8 *data,
+                       size_t size) {
+    (void)net; (void)hdr; (void)data; (void)size;
+    return 0;
+}
+
+int net_ipv4_reassemble(netif_t *net, const ip_hdr_t *hdr, const uint8 *data,
+                        size_t size) {
+    (void)net; (void)hdr; (void)data; (void)size;
+    return 0;
+}
+
+file_t fs_open(const char *fn, int mode) {
+    return open(fn, mode, 0644);
+}
+
+int fs_close(file_t hnd) {
+    return close(hnd);
+}
+
+ssize_t fs_read(file_t hnd, void *buffer, size_t cnt) {
+    return read(hnd, buffer, cnt);
+}
+
+ssize_t fs_write(file_t hnd, const void *buffer, size_t cnt) {
+    return write(hnd, buffer, cnt);
+}
+
+size_t fs_total(file_t hnd) {
+    struct stat st;
+
+    if(fstat(hnd, &st))
+        return (size_t)-1;
+
+    return st.st_size;
+}
+
+/* The KOS allocator, built from koslib/malloc.c with its names changed. Its
+   memory comes from an arena of its own, as it would on a Dreamcast. */
+
+void *kos_malloc(size_t size);
+void kos_free(void *ptr);
+void *kos_realloc(void *ptr, size_t size);
+
+#define ARENA_SIZE  (256 * 1024 * 1024)
+
+static uint8_t *arena;
+static size_t arena_used;
+
+void *hostbench_sbrk(ptrdiff_t incr) {
+    void *rv;
+
+    if(!arena && !(arena = malloc(ARENA_SIZE)))
+        return (void *)-1;
+
+    if(incr < 0 ? (size_t)-incr > arena_used :
+       (size_t)incr > ARENA_SIZE - arena_used) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+
+    rv = arena + arena_used;
+    arena_used += incr;
+    return rv;
+}
+
+/* The benchmarks. Each one has a setup function that can check the code
+   under test and returns 0 if all is well, and a function that runs the
+   operation being timed n times. */
+
+typedef struct bench {
+    const char *name;
+    size_t bytes;           /* Per operation, if throughput makes sense */
+    int (*setup)(void);
+    void (*run)(size_t n);
+    void (*cleanup)(void);
+} bench_t;
+
+#define FRAME_SIZE  1500
+
+static uint8_t *frame_src, *frame_dst;
+
+static int frames_setup(void) {
+    frame_src = malloc(FRAME_SIZE + 2);
+    frame_dst = malloc(FRAME_SIZE + 2);
+
+    if(!frame_src || !frame_dst)
+        return -1;
+
+    fill_random(frame_src, FRAME_SIZE + 2);
+    return 0;
+}
+
+static void frames_cleanup(void) {
+    free(frame_src);
+    free(frame_dst);
+}
+
+static int crc_setup(void) {
+    static const uint8_t check[] = "123456789";
+
+    /* The check values of CRC-32 and CRC-16/XMODEM */
+    CHECK(net_crc32le(check, 9) == 0xCBF43926, "crc32le is wrong");
+    CHECK(net_crc16ccitt(check, 9, 0) == 0x31C3, "crc16ccitt is wrong");
+
+    return frames_setup();
+}
+
+static void run_crc32le(size_t n) {
+    while(n--)
+        sink += net_crc32le(frame_src, FRAME_SIZE);
+}
+
+static void run_crc32be(size_t n) {
+    while(n--)
+        sink += net_crc32be(frame_src, FRAME_SIZE);
+}
+
+static void run_crc16ccitt(size_t n) {
+    while(n--)
+        sink += net_crc16ccitt(frame_src, FRAME_SIZE, 0);
+}
+
+/* The checksum of the data, done the obvious way */
+static uint16_t ref_checksum(const uint8_t *data, size_t bytes) {
+    uint32_t sum = 0;
+    size_t i;
+
+    for(i = 0; i + 1 < bytes; i += 2)
+        sum += data[i] | (data[i + 1] << 8);
+
+    if(i < bytes)
+        sum += data[i];
+
+    while(sum >> 16)
+        sum = (sum >> 16) + (sum & 0xFFFF);
+
+    return sum ^ 0xFFFF;
+}
+
+static int checksum_setup(void) {
+    uint16_t sum;
+    size_t len;
+    int off;
+
+    if(frames_setup())
+        return -1;
+
+    for(off = 0; off < 2; off++) {
+        for(len = FRAME_SIZE - 3; len <= FRAME_SIZE; len++) {
+            CHECK(net_ipv4_checksum(frame_src + off, len, 0) ==
+                  ref_checksum(frame_src + off, len),
+                  "checksum of %zu bytes at offset %d is wrong", len, off);
+            /* This one gives back the sum, rather than its complement */
+            sum = net_ipv4_checksum_copy(frame_dst, frame_src + off, len, 0);
+            CHECK(sum + ref_checksum(frame_src + off, len) == 0xFFFF,
+                  "copying checksum of %zu bytes at offset %d is wrong",
+                  len, off);
+            CHECK(!memcmp(frame_dst, frame_src + off, len),
+                  "copy of %zu bytes at offset %d is wrong", len, off);
+        }
+    }
+
+    return 0;
+}
+
+static void run_checksum(size_t n) {
+    while(n--)
+        sink += net_ipv4_checksum(frame_src, FRAME_SIZE, 0);
+}
+
+static void run_checksum_odd(size_t n) {
+    while(n--)
+        sink += net_ipv4_checksum(frame_src + 1, FRAME_SIZE, 0);
+}
+
+static void run_checksum_copy(size_t n) {
+    while(n--)
+        sink += net_ipv4_checksum_copy(frame_dst, frame_src, FRAME_SIZE, 0);
+}
+
+static const char *paths[] = {
+    "/rd/textures/level1/floor.pvr",
+    "/cd/data/../data/./music/track01.ogg",
+    "/pc/home/user/projects/game/build/../assets/./sprites/player.png",
+    "/vmu/a1/../b1/SAVEGAME",
+    "/rd//dir/./sub/../../file.bin",
+    "/ext2/a/b/c/d/e/f/g/h/../../../../x/y/z/file.txt"
+};
+
+#define PATH_COUNT  (sizeof(paths) / sizeof(paths[0]))
+
+static int path_setup(void) {
+    char buf[PATH_MAX];
+
+    CHECK(fs_normalize_path(paths[1], buf) &&
+          !strcmp(buf, "/cd/data/music/track01.ogg"), "normalized to %s", buf);
+    CHECK(fs_normalize_path(paths[4], buf) && !strcmp(buf, "/rd/file.bin"),
+          "normalized to %s", buf);
+
+    strcpy(buf, "/rd");
+    CHECK(fs_path_append(buf, "/file.bin", sizeof(buf)) == 13 &&
+          !strcmp(buf, "/rd/file.bin"), "appended to %s", buf);
+
+    return 0;
+}
+
+static void run_normalize_path(size_t n) {
+    char buf[PATH_MAX];
+
+    while(n--)
+        sink += fs_normalize_path(paths[n % PATH_COUNT], buf)[1];
+}
+
+static void run_path_append(size_t n) {
+    char buf[PATH_MAX];
+
+    while(n--) {
+        strcpy(buf, "/pc/home/user");
+        fs_path_append(buf, "/projects", sizeof(buf));
+        fs_path_append(buf, "/game/assets", sizeof(buf));
+        sink += fs_path_append(buf, "/sprites/player.png", sizeof(buf));
+    }
+}
+
+#define TEX_W       512
+#define TEX_H       256
+
+static uint8_t *tex_src, *tex_dst;
+
+static int twiddle_setup(void) {
+    uint16_t *src, *dst;
+    uint32_t x, y, t;
+    int i;
+
+    tex_src = malloc(TEX_W * TEX_H * 2);
+    tex_dst = malloc(TEX_W * TEX_H * 2);
+
+    if(!tex_src || !tex_dst)
+        return -1;
+
+    fill_random(tex_src, TEX_W * TEX_H * 2);
+
+    /* A 16bpp texel at (x, y) goes where the bits of x and y interleave, y
+       in the low bit */
+    CHECK(!pvr_txr_twiddle(tex_dst, tex_src, TEX_W, TEX_H, 0,
+                           PVR_TXRLOAD_16BPP), "twiddling failed");
+
+    src = (uint16_t *)tex_src;
+    dst = (uint16_t *)tex_dst;
+
+    for(y = 0; y < TEX_H; y += 37) {
+        for(x = 0; x < TEX_W; x += 29) {
+            for(i = 0, t = 0; i < 8; i++)
+                t |= ((y >> i) & 1) << (2 * i) | ((x >> i) & 1) << (2 * i + 1);
+
+            /* The rest of the wider dimension goes on top */
+            t |= (x >> 8) << 16;
+
+            CHECK(dst[t] == src[y * TEX_W + x], "texel %u, %u is misplaced",
+                  x, y);
+        }
+    }
+
+    return 0;
+}
+
+static void twiddle_cleanup(void) {
+    free(tex_src);
+    free(tex_dst);
+}
+
+static void run_twiddle_4bpp(size_t n) {
+    while(n--)
+        pvr_txr_twiddle(tex_dst, tex_src, TEX_W, TEX_H, 0, PVR_TXRLOAD_4BPP);
+
+    sink += tex_dst[0];
+}
+
+static void run_twiddle_8bpp(size_t n) {
+    while(n--)
+        pvr_txr_twiddle(tex_dst, tex_src, TEX_W, TEX_H, 0, PVR_TXRLOAD_8BPP);
+
+    sink += tex_dst[0];
+}
+
+static void run_twiddle_16bpp(size_t n) {
+    while(n--)
+        pvr_txr_twiddle(tex_dst, tex_src, TEX_W, TEX_H, 0, PVR_TXRLOAD_16BPP);
+
+    sink += tex_dst[0];
+}
+
+/* The allocator benchmarks work on a table of blocks, each operation freeing
+   a random one if it's in use, or allocating it if not. */
+
+#define SLOTS       1024
+
+static void *slots[SLOTS];
+static size_t slot_sizes[SLOTS];
+
+static int malloc_setup(void) {
+    uint8_t *p, *q;
+    int i;
+
+    for(i = 0; i < SLOTS; i++) {
+        slots[i] = NULL;
+        slot_sizes[i] = 0;
+    }
+
+    p = kos_malloc(100);
+    q = kos_malloc(100);
+    CHECK(p && q && p != q, "allocation failed");
+    memset(p, 0xAA, 100);
+    memset(q, 0x55, 100);
+
+    p = kos_realloc(p, 10000);
+    CHECK(p && p[99] == 0xAA && q[0] == 0x55, "realloc lost the contents");
+
+    kos_free(p);
+    kos_free(q);
+    return 0;
+}
+
+static void malloc_cleanup(void) {
+    int i;
+
+    for(i = 0; i < SLOTS; i++) {
+        kos_free(slots[i]);
+        slots[i] = NULL;
+    }
+}
+
+static void run_malloc(size_t n, size_t max) {
+    uint32_t r;
+    int i;
+
+    while(n--) {
+        r = rng();
+        i = r % SLOTS;
+
+        if(slots[i]) {
+            kos_free(slots[i]);
+            slots[i] = NULL;
+        }
+        else {
+            slots[i] = kos_malloc(16 + (r >> 10) % max);
+        }
+    }
+}
+
+static void run_malloc_small(size_t n) {
+    run_malloc(n, 256);
+}
+
+static void run_malloc_mixed(size_t n) {
+    run_malloc(n, 16384);
+}
+
+static void run_realloc(size_t n) {
+    uint32_t r;
+    int i;
+
+    while(n--) {
+        r = rng();
+        i = r % SLOTS;
+
+        if(slot_sizes[i] >= 65536) {
+            kos_free(slots[i]);
+            slots[i] = NULL;
+            slot_sizes[i] = 0;
+        }
+        else {
+            slot_sizes[i] += 64 + (r >> 10) % 1024;
+            slots[i] = kos_realloc(slots[i], slot_sizes[i]);
+        }
+    }
+}
+
+/* libkosext2fs, on an image made by mke2fs from a tree written out here */
+
+#define EXT2_BIG_SIZE   (1024 * 1024)
+#define EXT2_DIRS       8
+#define EXT2_FILES      64
+
+static uint8_t *img;
+static size_t img_size;
+static ext2_fs_t *ext2;
+static char ext2_dir[] = "/tmp/hostbench.XXXXXX";
+static char ext2_deep[] = "/a/b/c/d/e/f/g/h/file";
+
+static int mem_init(kos_blockdev_t *d) {
+    (void)d;
+    return 0;
+}
+
+static int mem_shutdown(kos_blockdev_t *d) {
+    (void)d;
+    return 0;
+}
+
+static int mem_read_blocks(kos_blockdev_t *d, uint32_t block, size_t count,
+                           void *buf) {
+    if((block + count) << d->l_block_size > img_size)
+        return -EIO;
+
+    memcpy(buf, img + (block << d->l_block_size), count << d->l_block_size);
+    return 0;
+}
+
+static int mem_write_blocks(kos_blockdev_t *d, uint32_t block, size_t count,
+                            const void *buf) {
+    if((block + count) << d->l_block_size > img_size)
+        return -EIO;
+
+    memcpy(img + (block << d->l_block_size), buf, count << d->l_block_size);
+    return 0;
+}
+
+static uint32_t mem_count_blocks(kos_blockdev_t *d) {
+    return img_size >> d->l_block_size;
+}
+
+static kos_blockdev_t mem_dev = {
+    NULL, 9, mem_init, mem_shutdown, mem_read_blocks, mem_write_blocks,
+    mem_count_blocks
+};
+
+static int write_file(const char *dir, const char *name, size_t size) {
+    char fn[PATH_MAX];
+    uint8_t buf[4096];
+    size_t len;
+    FILE *fp;
+
+    snprintf(fn, sizeof(fn), "%s%s", dir, name);
+
+    if(!(fp = fopen(fn, "wb")))
+        return -1;
+
+    while(size) {
+        len = size < sizeof(buf) ? size : sizeof(buf);
+        fill_random(buf, len);
+        fwrite(buf, 1, len, fp);
+        size -= len;
+    }
+
+    return fclose(fp);
+}
+
+static int make_image(void) {
+    char path[PATH_MAX], cmd[PATH_MAX * 2];
+    char *slash;
+    FILE *fp;
+    long len;
+    int i, j;
+
+    if(!mkdtemp(ext2_dir))
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/root", ext2_dir);
+    mkdir(path, 0755);
+
+    for(i = 0; i < EXT2_DIRS; i++) {
+        snprintf(cmd, sizeof(cmd), "/dir%d", i);
+        strcat(path, cmd);
+        mkdir(path, 0755);
+
+        for(j = 0; j < EXT2_FILES; j++) {
+            snprintf(cmd, sizeof(cmd), "/file%d", j);
+            write_file(path, cmd, 100 + j * 10);
+        }
+
+        *strrchr(path, '/') = '\0';
+    }
+
+    /* A deep path to look up */
+    strcat(path, ext2_deep);
+    slash = path + strlen(ext2_dir) + 5;
+
+    while((slash = strchr(slash + 1, '/'))) {
+        *slash = '\0';
+        mkdir(path, 0755);
+        *slash = '/';
+    }
+
+    *strrchr(path, '/') = '\0';
+    write_file(path, "/file", 100);
+    *strstr(path, "/a/b") = '\0';
+    write_file(path, "/big", EXT2_BIG_SIZE);
+
+    snprintf(cmd, sizeof(cmd), "PATH=\"$PATH:/sbin:/usr/sbin\" mke2fs -q -F "
+             "-t ext2 -b 1024 -d %s/root %s/img 8M >/dev/null 2>&1",
+             ext2_dir, ext2_dir);
+
+    if(system(cmd))
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/img", ext2_dir);
+
+    if(!(fp = fopen(path, "rb")))
+        return -1;
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if(len <= 0 || !(img = malloc(len)) ||
+       fread(img, 1, len, fp) != (size_t)len) {
+        fclose(fp);
+        return -1;
+    }
+
+    img_size = len;
+    fclose(fp);
+    return 0;
+}
+
+static void remove_image(void) {
+    char cmd[PATH_MAX];
+
+    if(ext2_dir[strlen(ext2_dir) - 1] != 'X') {
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", ext2_dir);
+
+        if(system(cmd))
+            fprintf(stderr, "Can't remove %s\n", ext2_dir);
+    }
+}
+
+/* Read a whole file, a block at a time, returning its size */
+static int64_t ext2_read_file(const char *fn) {
+    ext2_inode_t *inode;
+    uint32_t num, bs, blk, i, n;
+    uint64_t size;
+    uint8_t *data;
+    int err;
+
+    if(ext2_inode_by_path(ext2, fn, &inode, &num, 1, NULL))
+        return -1;
+
+    bs = ext2_block_size(ext2);
+    size = ext2_inode_size(inode);
+    n = (size + bs - 1) / bs;
+
+    for(i = 0; i < n; i++) {
+        if(!(data = ext2_inode_read_block(ext2, inode, i, &blk, &err))) {
+            ext2_inode_put(inode);
+            return -1;
+        }
+
+        sink += data[0];
+    }
+
+    ext2_inode_put(inode);
+    return size;
+}
+
+static int ext2_setup(void) {
+    ext2_inode_t *inode;
+    uint32_t num;
+
+    if(!img && make_image()) {
+        fprintf(stderr, "Can't make an ext2 image (is mke2fs installed?)\n");
+        return 1;
+    }
+
+    CHECK((ext2 = ext2_fs_init(&mem_dev, EXT2FS_MNT_FLAG_RO)),
+          "can't mount the image");
+    CHECK(!ext2_inode_by_path(ext2, ext2_deep, &inode, &num, 1, NULL),
+          "can't find %s", ext2_deep);
+    CHECK(ext2_inode_size(inode) == 100, "%s is the wrong size", ext2_deep);
+    ext2_inode_put(inode);
+    CHECK(ext2_read_file("/dir7/file63") == 730, "can't read a small file");
+    CHECK(ext2_read_file("/big") == EXT2_BIG_SIZE, "can't read a big file");
+
+    return 0;
+}
+
+static void ext2_cleanup(void) {
+    ext2_fs_shutdown(ext2);
+}
+
+static void run_ext2_mount(size_t n) {
+    ext2_fs_t *fs;
+
+    while(n--) {
+        if((fs = ext2_fs_init(&mem_dev, EXT2FS_MNT_FLAG_RO)))
+            ext2_fs_shutdown(fs);
+    }
+}
+
+static void run_ext2_lookup(size_t n) {
+    ext2_inode_t *inode;
+    char fn[32];
+    uint32_t num;
+
+    while(n--) {
+        snprintf(fn, sizeof(fn), "/dir%d/file%d", (int)(n % EXT2_DIRS),
+                 (int)(n % EXT2_FILES));
+
+        if(!ext2_inode_by_path(ext2, fn, &inode, &num, 1, NULL))
+            ext2_inode_put(inode);
+
+        if(!ext2_inode_by_path(ext2, ext2_deep, &inode, &num, 1, NULL))
+            ext2_inode_put(inode);
+    }
+}
+
+static void run_ext2_read(size_t n) {
+    while(n--)
+        ext2_read_file("/big");
+}
+
+static const bench_t benches[] = {
+    { "net/crc32le", FRAME_SIZE, crc_setup, run_crc32le, frames_cleanup },
+    { "net/crc32be", FRAME_SIZE, crc_setup, run_crc32be, frames_cleanup },
+    { "net/crc16ccitt", FRAME_SIZE, crc_setup, run_crc16ccitt,
+      frames_cleanup },
+    { "net/ipv4_checksum", FRAME_SIZE, checksum_setup, run_checksum,
+      frames_cleanup },
+    { "net/ipv4_checksum_odd", FRAME_SIZE, checksum_setup, run_checksum_odd,
+      frames_cleanup },
+    { "net/ipv4_checksum_copy", FRAME_SIZE, checksum_setup,
+      run_checksum_copy, frames_cleanup },
+    { "fs/normalize_path", 0, path_setup, run_normalize_path, NULL },
+    { "fs/path_append", 0, path_setup, run_path_append, NULL },
+    { "pvr/twiddle_4bpp", TEX_W * TEX_H / 2, twiddle_setup, run_twiddle_4bpp,
+      twiddle_cleanup },
+    { "pvr/twiddle_8bpp", TEX_W * TEX_H, twiddle_setup, run_twiddle_8bpp,
+      twiddle_cleanup },
+    { "pvr/twiddle_16bpp", TEX_W * TEX_H * 2, twiddle_setup,
+      run_twiddle_16bpp, twiddle_cleanup },
+    { "malloc/small", 0, malloc_setup, run_malloc_small, malloc_cleanup },
+    { "malloc/mixed", 0, malloc_setup, run_malloc_mixed, malloc_cleanup },
+    { "malloc/realloc", 0, malloc_setup, run_realloc, malloc_cleanup },
+    { "ext2/mount", 0, ext2_setup, run_ext2_mount, ext2_cleanup },
+    { "ext2/lookup", 0, ext2_setup, run_ext2_lookup, ext2_cleanup },
+    { "ext2/read", EXT2_BIG_SIZE, ext2_setup, run_ext2_read, ext2_cleanup }
+};
+
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+typedef struct result {
+    const bench_t *b;
+    size_t iters;
+    double ns;              /* Median time per operation */
+    double ns_min;
+} result_t;
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+#define MAX_SAMPLES 32
+
+static void measure(const bench_t *b, double min_time, int samples,
+                    result_t *r) {
+    double t[MAX_SAMPLES], start;
+    size_t n = 1;
+    int i;
+
+    /* Find out how many runs take long enough to time */
+    for(;;) {
+        start = now();
+        b->run(n);
+
+        if(now() - start >= min_time || n >= ((size_t)1 << 40))
+            break;
+
+        n *= 2;
+    }
+
+    for(i = 0; i < samples; i++) {
+        start = now();
+        b->run(n);
+        t[i] = (now() - start) / n * 1e9;
+    }
+
+    qsort(t, samples, sizeof(double), cmp_double);
+
+    r->b = b;
+    r->iters = n;
+    r->ns = t[samples / 2];
+    r->ns_min = t[0];
+}
+
+static double mb_per_s(const result_t *r) {
+    return r->b->bytes / r->ns * 1e9 / (1024.0 * 1024.0);
+}
+
+static int write_json(const char *fn, const result_t *res, int count,
+                      double min_time, int samples) {
+    FILE *fp = strcmp(fn, "-") ? fopen(fn, "w") : stdout;
+    int i;
+
+    if(!fp) {
+        perror(fn);
+        return -1;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"suite\": \"hostbench\",\n");
+    fprintf(fp, "  \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(fp, "  \"min_time\": %g,\n", min_time);
+    fprintf(fp, "  \"samples\": %d,\n", samples);
+    fprintf(fp, "  \"results\": [");
+
+    for(i = 0; i < count; i++) {
+        fprintf(fp, "%s\n    { \"name\": \"%s\", \"iterations\": %zu, "
+                "\"ns_per_op\": %.3f, \"ns_per_op_min\": %.3f",
+                i ? "," : "", res[i].b->name, res[i].iters, res[i].ns,
+                res[i].ns_min);
+
+        if(res[i].b->bytes)
+            fprintf(fp, ", \"bytes_per_op\": %zu, \"mb_per_s\": %.3f",
+                    res[i].b->bytes, mb_per_s(&res[i]));
+
+        fprintf(fp, " }");
+    }
+
+    fprintf(fp, "\n  ]\n}\n");
+
+    if(fp != stdout)
+        fclose(fp);
+
+    return 0;
+}
+
+/* Find the time per operation of the named benchmark in a file written by
+   write_json(). This only needs to understand what that writes. */
+static double baseline_ns(const char *json, const char *name) {
+    char key[128];
+    const char *p;
+
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+
+    if(!(p = strstr(json, key)) || !(p = strstr(p, "\"ns_per_op\": ")))
+        return -1.0;
+
+    return strtod(p + 13, NULL);
+}
+
+static int compare(const char *fn, const result_t *res, int count,
+                   double threshold) {
+    char *json;
+    double base, change;
+    int i, regressions = 0;
+    FILE *fp;
+    long len;
+
+    if(!(fp = fopen(fn, "rb"))) {
+        perror(fn);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    json = calloc(1, len + 1);
+
+    if(!json || fread(json, 1, len, fp) != (size_t)len) {
+        fprintf(stderr, "Can't read %s\n", fn);
+        fclose(fp);
+        free(json);
+        return -1;
+    }
+
+    fclose(fp);
+
+    printf("\nCompared to %s (regression threshold %g%%):\n", fn, threshold);
+
+    for(i = 0; i < count; i++) {
+        if((base = baseline_ns(json, res[i].b->name)) <= 0.0) {
+            printf("  %-24s %12s\n", res[i].b->name, "new");
+            continue;
+        }
+
+        change = (res[i].ns - base) / base * 100.0;
+        printf("  %-24s %12.1f ns -> %12.1f ns  %+7.1f%%%s\n",
+               res[i].b->name, base, res[i].ns, change,
+               change > threshold ? "  REGRESSION" : "");
+
+        if(change > threshold)
+            regressions++;
+    }
+
+    free(json);
+    return regressions;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-l] [-s] [-f filter] [-t seconds] "
+            "[-n samples] [-j file] [-c file [-r percent]]\n", prog);
+    fprintf(stderr, "  -l   List the benchmarks\n");
+    fprintf(stderr, "  -s   Only check the code under test, and run each "
+            "benchmark once\n");
+    fprintf(stderr, "  -f   Only run the benchmarks whose names contain "
+            "filter\n");
+    fprintf(stderr, "  -t   Minimum time of each sample (default 0.05)\n");
+    fprintf(stderr, "  -n   Number of samples (default 5)\n");
+    fprintf(stderr, "  -j   Write the results as JSON to file (- for "
+            "stdout)\n");
+    fprintf(stderr, "  -c   Compare the results to a file written by -j\n");
+    fprintf(stderr, "  -r   Slowdown that counts as a regression (default "
+            "10)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = NULL, *json = NULL, *baseline = NULL;
+    double min_time = 0.05, threshold = 10.0;
+    int c, samples = 5, smoke = 0, count = 0, skipped = 0, rv;
+    result_t res[BENCH_COUNT];
+    size_t i;
+
+    while((c = getopt(argc, argv, "lsf:t:n:j:c:r:")) != -1) {
+        switch(c) {
+            case 'l':
+                for(i = 0; i < BENCH_COUNT; i++)
+                    printf("%s\n", benches[i].name);
+
+                return 0;
+            case 's':
+                smoke = 1;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 't':
+                min_time = atof(optarg);
+                break;
+            case 'n':
+                samples = atoi(optarg);
+
+                if(samples < 1 || samples > MAX_SAMPLES)
+                    usage(argv[0]);
+
+                break;
+            case 'j':
+                json = optarg;
+                break;
+            case 'c':
+                baseline = optarg;
+                break;
+            case 'r':
+                threshold = atof(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(optind < argc)
+        usage(argv[0]);
+
+    if(!smoke)
+        printf("%-24s %12s %12s %10s\n", "benchmark", "ns/op", "min ns/op",
+               "MiB/s");
+
+    for(i = 0; i < BENCH_COUNT; i++) {
+        const bench_t *b = &benches[i];
+
+        if(filter && !strstr(b->name, filter))
+            continue;
+
+        /* 1 means it can't run here, rather than that it's broken */
+        if((rv = b->setup())) {
+            if(rv > 0) {
+                fprintf(stderr, "%s: skipped\n", b->name);
+                skipped++;
+            }
+
+            continue;
+        }
+
+        if(smoke) {
+            b->run(1);
+        }
+        else {
+            measure(b, min_time, samples, &res[count]);
+
+            printf("%-24s %12.1f %12.1f", b->name, res[count].ns,
+                   res[count].ns_min);
+
+            if(b->bytes)
+                printf(" %10.1f", mb_per_s(&res[count]));
+
+            printf("\n");
+            fflush(stdout);
+            count++;
+        }
+
+        if(b->cleanup)
+            b->cleanup();
+    }
+
+    remove_image();
+
+    if(failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    if(smoke) {
+        printf("All checks passed%s\n", skipped ? ", some skipped" : "");
+        return 0;
+    }
+
+    if(json && write_json(json, res, count, min_time, samples))
+        return 1;
+
+    if(baseline) {
+        if((rv = compare(baseline, res, count, threshold)) < 0)
+            return 1;
+
+        if(rv) {
+            printf("%d regression(s)\n", rv);
+            return 2;
+        }
+    }
+
+    return 0;
+}
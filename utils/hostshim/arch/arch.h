@@ -0,0 +1,19 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/arch/arch.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/arch.h, with just what the allocator needs.
+*/
+
+#ifndef __ARCH_ARCH_H
+#define __ARCH_ARCH_H
+
+#include <arch/types.h>
+
+#define PAGESIZE        4096
+
+#define arch_get_ret_addr() \
+    ((uint32)(uintptr_t)__builtin_return_address(0))
+
+#endif /* __ARCH_ARCH_H */
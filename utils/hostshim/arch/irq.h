@@ -0,0 +1,19 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/arch/irq.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/irq.h. Nothing runs in an interrupt, and
+   disabling interrupts does nothing. Tests that need more than that have an
+   arch/irq.h of their own.
+*/
+
+#ifndef __ARCH_IRQ_H
+#define __ARCH_IRQ_H
+
+#define irq_inside_int()        0
+#define irq_disable()           0
+#define irq_restore(old)        ((void)(old))
+#define irq_disable_scoped()    do { } while(0)
+
+#endif /* __ARCH_IRQ_H */
@@ -0,0 +1,29 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/arch/spinlock.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/spinlock.h, on top of pthreads.
+*/
+
+#ifndef __ARCH_SPINLOCK_H
+#define __ARCH_SPINLOCK_H
+
+#include <pthread.h>
+
+typedef pthread_mutex_t spinlock_t;
+
+#define SPINLOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+
+#define spinlock_lock(l)        pthread_mutex_lock(l)
+#define spinlock_unlock(l)      pthread_mutex_unlock(l)
+
+static inline int spinlock_is_locked(spinlock_t *l) {
+    if(pthread_mutex_trylock(l))
+        return 1;
+
+    pthread_mutex_unlock(l);
+    return 0;
+}
+
+#endif /* __ARCH_SPINLOCK_H */
@@ -0,0 +1,18 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/arch/timer.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/timer.h. Each test provides the clock, either
+   on top of the host's or run by the test itself.
+*/
+
+#ifndef __ARCH_TIMER_H
+#define __ARCH_TIMER_H
+
+#include <arch/types.h>
+
+uint64 timer_ms_gettime64(void);
+uint64 timer_us_gettime64(void);
+
+#endif /* __ARCH_TIMER_H */
@@ -0,0 +1,29 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/arch/types.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/types.h, which can't be built on the host.
+*/
+
+#ifndef __ARCH_TYPES_H
+#define __ARCH_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+
+typedef int prio_t;
+
+#define __packed __attribute__((packed))
+
+#endif /* __ARCH_TYPES_H */
@@ -0,0 +1,37 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/dc/pvr.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real dc/pvr.h, which can't be built on the host, with
+   just what pvr_twiddle.c and pvr_xform.c need.
+*/
+
+#ifndef __DC_PVR_H
+#define __DC_PVR_H
+
+#include <stdalign.h>
+#include <stdint.h>
+
+typedef void *pvr_ptr_t;
+typedef uint32_t pvr_list_t;
+typedef uint32_t pvr_dr_state_t;
+
+#define PVR_CMD_VERTEX      0xe0000000
+#define PVR_CMD_VERTEX_EOL  0xf0000000
+
+typedef struct pvr_vertex {
+    alignas(32)
+    uint32_t flags;
+    float   x;
+    float   y;
+    float   z;
+    float   u;
+    float   v;
+    uint32_t argb;
+    uint32_t oargb;
+} pvr_vertex_t;
+
+#include <dc/pvr/pvr_txr.h>
+
+#endif /* __DC_PVR_H */
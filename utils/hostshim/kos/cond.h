@@ -0,0 +1,26 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/cond.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/cond.h, on top of pthreads.
+*/
+
+#ifndef __KOS_COND_H
+#define __KOS_COND_H
+
+#include <pthread.h>
+#include <kos/thread.h>
+#include <kos/mutex.h>
+
+typedef pthread_cond_t condvar_t;
+
+#define cond_init(cv)           pthread_cond_init((cv), NULL)
+#define cond_destroy(cv)        pthread_cond_destroy(cv)
+#define cond_wait(cv, m)        pthread_cond_wait((cv), (m))
+#define cond_signal(cv)         pthread_cond_signal(cv)
+#define cond_broadcast(cv)      pthread_cond_broadcast(cv)
+
+int cond_wait_timed(condvar_t *cv, mutex_t *m, int timeout);
+
+#endif /* __KOS_COND_H */
@@ -0,0 +1,30 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/dbglog.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/dbglog.h, with the same levels. Errors and
+   anything worse go to stderr, and everything else is dropped.
+*/
+
+#ifndef __KOS_DBGLOG_H
+#define __KOS_DBGLOG_H
+
+#include <stdio.h>
+#include <kos/cdefs.h>
+
+#define DBG_DEAD        0
+#define DBG_CRITICAL    1
+#define DBG_ERROR       2
+#define DBG_WARNING     3
+#define DBG_NOTICE      4
+#define DBG_INFO        5
+#define DBG_DEBUG       6
+#define DBG_KDEBUG      7
+
+#define dbglog(level, ...) do { \
+        if((level) <= DBG_ERROR) \
+            fprintf(stderr, __VA_ARGS__); \
+    } while(0)
+
+#endif /* __KOS_DBGLOG_H */
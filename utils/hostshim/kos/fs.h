@@ -0,0 +1,107 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/fs.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/fs.h and kos/nmmgr.h. The VFS handler has the
+   same layout as the real one, for the filesystems under test. Each test
+   provides whichever of the functions it uses, on top of the host's files or
+   of its own.
+*/
+
+#ifndef __KOS_FS_H
+#define __KOS_FS_H
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/queue.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <kos/opts.h>
+#include <arch/types.h>
+
+#define NAME_MAX_KOS 256
+
+/* Handles are small integers cast to pointers */
+typedef intptr_t file_t;
+
+#define FILEHND_INVALID ((file_t)-1)
+
+file_t fs_open(const char *fn, int mode);
+int fs_close(file_t hnd);
+ssize_t fs_read(file_t hnd, void *buffer, size_t cnt);
+ssize_t fs_write(file_t hnd, const void *buffer, size_t cnt);
+size_t fs_total(file_t hnd);
+
+ssize_t fs_copy(const char *src, const char *dst);
+ssize_t fs_load(const char *src, void **out_ptr);
+ssize_t fs_path_append(char *dst, const char *src, size_t len);
+char *fs_normalize_path(const char *__restrict path,
+                        char *__restrict resolved);
+
+typedef struct kos_dirent {
+    int size;
+    char name[NAME_MAX_KOS];
+    time_t time;
+    uint32 attr;
+} dirent_t;
+
+typedef struct nmmgr_handler {
+    char pathname[NAME_MAX_KOS];
+    int pid;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t type;
+    LIST_ENTRY(nmmgr_handler) list_ent;
+} nmmgr_handler_t;
+
+#define NMMGR_LIST_INIT         { NULL }
+#define NMMGR_FLAGS_NEEDSFREE   0x00000001
+#define NMMGR_TYPE_VFS          0x0010
+
+int nmmgr_handler_add(nmmgr_handler_t *hnd);
+int nmmgr_handler_remove(nmmgr_handler_t *hnd);
+
+#define O_MODE_MASK 0x0f
+#define O_DIR       0x1000
+
+typedef struct vfs_handler {
+    nmmgr_handler_t nmmgr;
+    int cache;
+    void *privdata;
+    void *(*open)(struct vfs_handler *vfs, const char *fn, int mode);
+    int (*close)(void *hnd);
+    ssize_t (*read)(void *hnd, void *buffer, size_t cnt);
+    ssize_t (*write)(void *hnd, const void *buffer, size_t cnt);
+    off_t (*seek)(void *hnd, off_t offset, int whence);
+    off_t (*tell)(void *hnd);
+    size_t (*total)(void *hnd);
+    dirent_t *(*readdir)(void *hnd);
+    int (*ioctl)(void *hnd, int cmd, va_list ap);
+    int (*rename)(struct vfs_handler *vfs, const char *fn1, const char *fn2);
+    int (*unlink)(struct vfs_handler *vfs, const char *fn);
+    void *(*mmap)(void *fd);
+    int (*complete)(void *fd, ssize_t *rv);
+    int (*stat)(struct vfs_handler *vfs, const char *path, struct stat *buf,
+                int flag);
+    int (*mkdir)(struct vfs_handler *vfs, const char *fn);
+    int (*rmdir)(struct vfs_handler *vfs, const char *fn);
+    int (*fcntl)(void *fd, int cmd, va_list ap);
+    short (*poll)(void *fd, short events);
+    int (*link)(struct vfs_handler *vfs, const char *path1, const char *path2);
+    int (*symlink)(struct vfs_handler *vfs, const char *path1,
+                   const char *path2);
+    int64_t (*seek64)(void *hnd, int64_t offset, int whence);
+    int64_t (*tell64)(void *hnd);
+    uint64 (*total64)(void *hnd);
+    ssize_t (*readlink)(struct vfs_handler *vfs, const char *path, char *buf,
+                        size_t bufsize);
+    int (*rewinddir)(void *hnd);
+    int (*fstat)(void *hnd, struct stat *st);
+} vfs_handler_t;
+
+#endif /* __KOS_FS_H */
@@ -0,0 +1,17 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/genwait.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/genwait.h. Each test provides the functions.
+*/
+
+#ifndef __KOS_GENWAIT_H
+#define __KOS_GENWAIT_H
+
+int genwait_wait(void *obj, const char *mutex_name, int timeout,
+                 void (*callback)(void *));
+int genwait_wake_one(void *obj);
+int genwait_wake_all(void *obj);
+
+#endif /* __KOS_GENWAIT_H */
@@ -0,0 +1,38 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/mutex.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/mutex.h, on top of pthreads.
+*/
+
+#ifndef __KOS_MUTEX_H
+#define __KOS_MUTEX_H
+
+#include <pthread.h>
+
+typedef pthread_mutex_t mutex_t;
+
+#define MUTEX_TYPE_NORMAL 0
+#define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+
+#define mutex_init(m, type)     pthread_mutex_init((m), NULL)
+#define mutex_destroy(m)        pthread_mutex_destroy(m)
+#define mutex_lock(m)           pthread_mutex_lock(m)
+#define mutex_lock_irqsafe(m)   pthread_mutex_lock(m)
+#define mutex_trylock(m)        pthread_mutex_trylock(m)
+#define mutex_unlock(m)         pthread_mutex_unlock(m)
+
+static inline void __mutex_scoped_cleanup(mutex_t **m) {
+    pthread_mutex_unlock(*m);
+}
+
+#define __mutex_lock_scoped(m, l) \
+    mutex_t *__scoped_mutex_##l \
+        __attribute__((cleanup(__mutex_scoped_cleanup))) = \
+        (pthread_mutex_lock(m), (m))
+
+#define _mutex_lock_scoped(m, l) __mutex_lock_scoped(m, l)
+#define mutex_lock_scoped(m) _mutex_lock_scoped((m), __LINE__)
+
+#endif /* __KOS_MUTEX_H */
@@ -0,0 +1,27 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/rwsem.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/rwsem.h, on top of pthreads.
+*/
+
+#ifndef __KOS_RWSEM_H
+#define __KOS_RWSEM_H
+
+#include <pthread.h>
+
+typedef pthread_rwlock_t rw_semaphore_t;
+
+#define RWSEM_INITIALIZER PTHREAD_RWLOCK_INITIALIZER
+
+#define rwsem_read_lock(s)          pthread_rwlock_rdlock(s)
+#define rwsem_read_lock_irqsafe(s)  pthread_rwlock_rdlock(s)
+#define rwsem_read_trylock(s)       pthread_rwlock_tryrdlock(s)
+#define rwsem_read_unlock(s)        pthread_rwlock_unlock(s)
+#define rwsem_write_lock(s)         pthread_rwlock_wrlock(s)
+#define rwsem_write_lock_irqsafe(s) pthread_rwlock_wrlock(s)
+#define rwsem_write_trylock(s)      pthread_rwlock_trywrlock(s)
+#define rwsem_write_unlock(s)       pthread_rwlock_unlock(s)
+
+#endif /* __KOS_RWSEM_H */
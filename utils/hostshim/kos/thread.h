@@ -0,0 +1,43 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/kos/thread.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real kos/thread.h. Threads are pthreads, and priorities
+   are recorded but otherwise ignored. Each test provides the functions it
+   uses.
+*/
+
+#ifndef __KOS_THREAD_H
+#define __KOS_THREAD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <kos/cdefs.h>
+#include <arch/irq.h>
+#include <arch/types.h>
+
+#define PRIO_DEFAULT 10
+
+typedef struct kthread {
+    pthread_t thd;
+} kthread_t;
+
+typedef struct kthread_attr {
+    bool create_detached;
+    size_t stack_size;
+    void *stack_ptr;
+    prio_t prio;
+    const char *label;
+} kthread_attr_t;
+
+kthread_t *thd_create_ex(const kthread_attr_t *attr,
+                         void *(*routine)(void *), void *param);
+int thd_join(kthread_t *thd, void **value_ptr);
+void thd_pass(void);
+void thd_sleep(unsigned int ms);
+kthread_t *thd_get_current(void);
+
+#define thd_current (thd_get_current())
+
+#endif /* __KOS_THREAD_H */
@@ -0,0 +1,17 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/malloc.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the KOS malloc.h. The host's malloc.h, plus what the KOS one
+   adds that the code under test uses. Each test provides the functions.
+*/
+
+#ifndef __HOSTSHIM_MALLOC_H
+#define __HOSTSHIM_MALLOC_H
+
+#include_next <malloc.h>
+
+int malloc_irq_safe(void);
+
+#endif /* __HOSTSHIM_MALLOC_H */
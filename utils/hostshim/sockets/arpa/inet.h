@@ -0,0 +1,15 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/sockets/arpa/inet.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The KOS arpa/inet.h has to take precedence over the host's, in the tests
+   of the network stack.
+*/
+
+#ifndef __HOSTSHIM_ARPA_INET_H
+#define __HOSTSHIM_ARPA_INET_H
+
+#include "../../../../include/arpa/inet.h"
+
+#endif /* __HOSTSHIM_ARPA_INET_H */
@@ -0,0 +1,15 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/sockets/netinet/in.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The KOS netinet/in.h has to take precedence over the host's, in the tests
+   of the network stack.
+*/
+
+#ifndef __HOSTSHIM_NETINET_IN_H
+#define __HOSTSHIM_NETINET_IN_H
+
+#include "../../../../include/netinet/in.h"
+
+#endif /* __HOSTSHIM_NETINET_IN_H */
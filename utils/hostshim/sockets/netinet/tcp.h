@@ -0,0 +1,15 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/sockets/netinet/tcp.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The KOS netinet/tcp.h has to take precedence over the host's, in the tests
+   of the network stack.
+*/
+
+#ifndef __HOSTSHIM_NETINET_TCP_H
+#define __HOSTSHIM_NETINET_TCP_H
+
+#include "../../../../include/netinet/tcp.h"
+
+#endif /* __HOSTSHIM_NETINET_TCP_H */
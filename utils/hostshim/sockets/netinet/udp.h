@@ -0,0 +1,15 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/sockets/netinet/udp.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The KOS netinet/udp.h has to take precedence over the host's, in the tests
+   of the network stack.
+*/
+
+#ifndef __HOSTSHIM_NETINET_UDP_H
+#define __HOSTSHIM_NETINET_UDP_H
+
+#include "../../../../include/netinet/udp.h"
+
+#endif /* __HOSTSHIM_NETINET_UDP_H */
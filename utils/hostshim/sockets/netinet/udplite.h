@@ -0,0 +1,15 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/sockets/netinet/udplite.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The KOS netinet/udplite.h has to take precedence over the host's, in the
+   tests of the network stack.
+*/
+
+#ifndef __HOSTSHIM_NETINET_UDPLITE_H
+#define __HOSTSHIM_NETINET_UDPLITE_H
+
+#include "../../../../include/netinet/udplite.h"
+
+#endif /* __HOSTSHIM_NETINET_UDPLITE_H */
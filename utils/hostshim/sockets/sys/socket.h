@@ -0,0 +1,24 @@
+/* KallistiOS ##version##
+
+   utils/hostshim/sockets/sys/socket.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   The KOS sys/socket.h has to take precedence over the host's, in the tests
+   of the network stack. It also needs __RESTRICT from the KOS sys/cdefs.h and
+   IOV_MAX from the KOS sys/_types.h, which the host's headers don't provide.
+*/
+
+#ifndef __HOSTSHIM_SYS_SOCKET_H
+#define __HOSTSHIM_SYS_SOCKET_H
+
+#ifndef __RESTRICT
+#define __RESTRICT __restrict
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#include "../../../../include/sys/socket.h"
+
+#endif /* __HOSTSHIM_SYS_SOCKET_H */
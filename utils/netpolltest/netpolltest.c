@@ -0,0 +1,713 @@
+/* KallistiOS ##version##
+
+   netpolltest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the receive polling in kernel/net/net_core.c
+   and the virtual network device in kernel/net/net_vnic.c, which are built
+   as-is on the host. The rest of the network stack is left out: the test
+   stands in for net_input(), and keeps track of every frame passed up. Threads
+   are pthreads, and disabling interrupts takes a lock that keeps out the
+   threads that inject frames, which stand in for interrupt handlers.
+
+   The tests check that frames come out in the order they went in, that no
+   poll passes up more than NET_POLL_BUDGET frames and the polling thread
+   yields in between, that a burst of frames raises the receive interrupt once
+   rather than once per frame, that busy devices take turns, that frames are
+   dropped and counted when a device is full, that transmitted frames can be
+   captured, that a device isn't freed while it's being polled, and that no
+   frame is ever left behind when the interrupt is re-enabled. The benchmark
+   (-b) measures throughput, interrupts per frame and latency through a
+   virtual device.
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kos/net.h>
+#include <kos/dbglog.h>
+#include <kos/fs_socket.h>
+#include <kos/genwait.h>
+#include <kos/opts.h>
+#include <kos/thread.h>
+
+#include "../../kernel/net/net_dhcp.h"
+#include "../../kernel/net/net_thd.h"
+#include "../../kernel/net/net_ipv4.h"
+#include "../../kernel/net/net_ipv6.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* What net_core.c needs from the rest of the network stack, which isn't
+   built here */
+
+int fs_socket_init(void) { return 0; }
+int fs_socket_shutdown(void) { return 0; }
+int net_thd_init(void) { return 0; }
+void net_thd_kill(void) { }
+void net_thd_shutdown(void) { }
+int net_arp_init(void) { return 0; }
+void net_arp_shutdown(void) { }
+int net_ndp_init(void) { return 0; }
+void net_ndp_shutdown(void) { }
+int net_ipv4_frag_init(void) { return 0; }
+void net_ipv4_frag_shutdown(void) { }
+int net_multicast_init(void) { return 0; }
+void net_multicast_shutdown(void) { }
+int net_ipv6_init(void) { return 0; }
+void net_ipv6_shutdown(void) { }
+int net_udp_init(void) { return 0; }
+void net_udp_shutdown(void) { }
+int net_tcp_init(void) { return 0; }
+void net_tcp_shutdown(void) { }
+int net_dhcp_init(void) { return 0; }
+void net_dhcp_shutdown(void) { }
+int net_dhcp_request(uint32 required_address) {
+    (void)required_address;
+    return 0;
+}
+
+void net_ipv4_parse_address(uint32 addr, uint8 out[4]) {
+    (void)addr;
+    memset(out, 0, 4);
+}
+
+/* "Disabling interrupts" is a lock that the current holder can take again,
+   and that genwait_wait() gives up while it waits, as on a Dreamcast. */
+
+static pthread_mutex_t irq_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gw_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t irq_owner;
+static int irq_depth;
+
+void test_irq_lock(void) {
+    if(irq_depth && pthread_equal(irq_owner, pthread_self())) {
+        irq_depth++;
+        return;
+    }
+
+    pthread_mutex_lock(&irq_mutex);
+    irq_owner = pthread_self();
+    irq_depth = 1;
+}
+
+void test_irq_unlock(int *dummy) {
+    (void)dummy;
+
+    if(--irq_depth == 0)
+        pthread_mutex_unlock(&irq_mutex);
+}
+
+int genwait_wait(void *obj, const char *mutex_name, int timeout,
+                 void (*callback)(void *)) {
+    int depth = irq_depth;
+    struct timespec ts;
+
+    (void)obj;
+    (void)mutex_name;
+    (void)callback;
+
+    /* Only ever called with "interrupts disabled" */
+    irq_depth = 0;
+
+    if(timeout) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += timeout * 1000000L;
+        ts.tv_sec += ts.tv_nsec / 1000000000L;
+        ts.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&gw_cond, &irq_mutex, &ts);
+    }
+    else {
+        pthread_cond_wait(&gw_cond, &irq_mutex);
+    }
+
+    irq_owner = pthread_self();
+    irq_depth = depth;
+    return 0;
+}
+
+int genwait_wake_one(void *obj) {
+    (void)obj;
+    pthread_cond_broadcast(&gw_cond);
+    return 0;
+}
+
+static __thread kthread_t *cur_thd;
+static int yields;
+
+struct thd_start {
+    kthread_t *thd;
+    void *(*routine)(void *);
+    void *param;
+};
+
+static void *thd_trampoline(void *p) {
+    struct thd_start st = *(struct thd_start *)p;
+
+    free(p);
+    cur_thd = st.thd;
+    return st.routine(st.param);
+}
+
+kthread_t *thd_create_ex(const kthread_attr_t *attr,
+                         void *(*routine)(void *), void *param) {
+    kthread_t *thd = malloc(sizeof(kthread_t));
+    struct thd_start *st = malloc(sizeof(struct thd_start));
+
+    (void)attr;
+    st->thd = thd;
+    st->routine = routine;
+    st->param = param;
+
+    if(pthread_create(&thd->thd, NULL, thd_trampoline, st)) {
+        free(st);
+        free(thd);
+        return NULL;
+    }
+
+    return thd;
+}
+
+int thd_join(kthread_t *thd, void **value_ptr) {
+    int rv = pthread_join(thd->thd, value_ptr);
+
+    free(thd);
+    return rv;
+}
+
+void thd_pass(void) {
+    __atomic_add_fetch(&yields, 1, __ATOMIC_RELAXED);
+    sched_yield();
+}
+
+void thd_sleep(unsigned int ms) {
+    usleep(ms * 1000);
+}
+
+kthread_t *thd_get_current(void) {
+    return cur_thd;
+}
+
+/* Every frame passed up is logged with the device it came from and the
+   sequence number in its payload. Passing frames up can be held at a gate,
+   or slowed down. */
+
+#define LOG_MAX     (1 << 20)
+
+struct delivery {
+    netif_t *nif;
+    uint32_t seq;
+};
+
+static struct delivery dlog[LOG_MAX];
+static volatile int dlog_len;
+static double lat_total, lat_max;
+static int input_delay;
+
+static pthread_mutex_t gate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static int gate_closed, gate_waiting;
+
+static void gate(int closed) {
+    pthread_mutex_lock(&gate_mutex);
+    gate_closed = closed;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&gate_mutex);
+}
+
+static void gate_wait(void) {
+    pthread_mutex_lock(&gate_mutex);
+
+    while(!gate_waiting)
+        pthread_cond_wait(&gate_cond, &gate_mutex);
+
+    pthread_mutex_unlock(&gate_mutex);
+}
+
+/* A frame: an Ethernet header, then a sequence number and a timestamp */
+#define FRAME_LEN   64
+
+struct payload {
+    uint32_t seq;
+    double sent;
+};
+
+int net_input(netif_t *device, const uint8 *data, int len) {
+    struct payload pl;
+    double lat;
+
+    pthread_mutex_lock(&gate_mutex);
+
+    while(gate_closed) {
+        gate_waiting++;
+        pthread_cond_broadcast(&gate_cond);
+        pthread_cond_wait(&gate_cond, &gate_mutex);
+        gate_waiting--;
+    }
+
+    pthread_mutex_unlock(&gate_mutex);
+
+    if(len != FRAME_LEN)
+        return -1;
+
+    memcpy(&pl, data + sizeof(eth_hdr_t), sizeof(pl));
+    lat = now() - pl.sent;
+    lat_total += lat;
+
+    if(lat > lat_max)
+        lat_max = lat;
+
+    if(dlog_len < LOG_MAX) {
+        dlog[dlog_len].nif = device;
+        dlog[dlog_len].seq = pl.seq;
+        __atomic_store_n(&dlog_len, dlog_len + 1, __ATOMIC_RELEASE);
+    }
+
+    if(input_delay)
+        usleep(input_delay);
+
+    return 0;
+}
+
+static void log_reset(void) {
+    dlog_len = 0;
+    lat_total = lat_max = 0.0;
+}
+
+static int inject(netif_t *nif, uint32_t seq) {
+    uint8 frame[FRAME_LEN];
+    struct payload pl = { seq, now() };
+
+    memset(frame, 0, sizeof(frame));
+    memset(frame, 0xff, 6);
+    frame[12] = 0x08;
+    memcpy(frame + sizeof(eth_hdr_t), &pl, sizeof(pl));
+
+    return net_vnic_inject(nif, frame, sizeof(frame));
+}
+
+/* Wait for count frames to have been passed up, for up to a few seconds */
+static int wait_for(int count) {
+    double end = now() + 5.0;
+
+    while(__atomic_load_n(&dlog_len, __ATOMIC_ACQUIRE) < count) {
+        if(now() > end)
+            return 0;
+
+        usleep(100);
+    }
+
+    /* And give it a moment to pass up anything extra it shouldn't have */
+    usleep(1000);
+    return dlog_len == count;
+}
+
+/* Each poll of a device is recorded, by wrapping its if_poll() */
+
+#define POLLS_MAX   65536
+
+static int (*real_poll)(netif_t *self, int budget);
+static int polls, poll_max, poll_over;
+
+static int wrap_poll(netif_t *self, int budget) {
+    int n = real_poll(self, budget);
+
+    polls++;
+
+    if(n > poll_max)
+        poll_max = n;
+
+    if(n > budget)
+        poll_over++;
+
+    return n;
+}
+
+static const uint8 mac_a[6] = { 0x02, 0, 0, 0, 0, 1 };
+static const uint8 mac_b[6] = { 0x02, 0, 0, 0, 0, 2 };
+
+/* The tests */
+
+static void test_basic(void) {
+    netif_t *nif = net_vnic_create(mac_a, 256);
+    net_vnic_stats_t st;
+    int i;
+
+    CHECK(nif, "create failed");
+    CHECK((nif->flags & NETIF_RUNNING) && (nif->flags & NETIF_REGISTERED),
+          "not started and registered");
+
+    log_reset();
+
+    for(i = 0; i < 100; i++)
+        CHECK(!inject(nif, i), "inject %d failed", i);
+
+    CHECK(wait_for(100), "passed up %d of 100", dlog_len);
+
+    for(i = 0; i < 100; i++)
+        CHECK(dlog[i].nif == nif && dlog[i].seq == (uint32_t)i,
+              "frame %d out of order", i);
+
+    net_vnic_get_stats(nif, &st);
+    CHECK(st.rx_frames == 100 && st.rx_dropped == 0, "wrong stats");
+    CHECK(st.rx_irqs >= 1 && st.rx_irqs <= 100, "%u interrupts",
+          (unsigned)st.rx_irqs);
+
+    /* And again, after it's gone quiet */
+    log_reset();
+    CHECK(!inject(nif, 1000), "inject failed");
+    CHECK(wait_for(1), "not passed up");
+
+    net_vnic_destroy(nif);
+}
+
+static void test_budget(void) {
+    netif_t *nif = net_vnic_create(mac_a, 4096);
+    net_vnic_stats_t st;
+    int i, y;
+
+    CHECK(nif, "create failed");
+
+    real_poll = nif->if_poll;
+    nif->if_poll = wrap_poll;
+    polls = poll_max = poll_over = 0;
+
+    /* Everything is injected before anything is passed up */
+    log_reset();
+    gate(1);
+    CHECK(!inject(nif, 0), "inject failed");
+    gate_wait();
+
+    for(i = 1; i < 4000; i++)
+        CHECK(!inject(nif, i), "inject %d failed", i);
+
+    y = yields;
+    gate(0);
+    CHECK(wait_for(4000), "passed up %d of 4000", dlog_len);
+
+    for(i = 0; i < 4000; i++)
+        CHECK(dlog[i].seq == (uint32_t)i, "frame %d out of order", i);
+
+    CHECK(poll_over == 0 && poll_max == NET_POLL_BUDGET,
+          "polls passed up as many as %d frames", poll_max);
+    CHECK(polls >= 4000 / NET_POLL_BUDGET, "only %d polls", polls);
+    CHECK(yields - y >= 4000 / NET_POLL_BUDGET - 1,
+          "only yielded %d times in %d polls", yields - y, polls);
+
+    /* One interrupt for the whole burst */
+    net_vnic_get_stats(nif, &st);
+    CHECK(st.rx_irqs == 1, "%u interrupts", (unsigned)st.rx_irqs);
+
+    net_vnic_destroy(nif);
+}
+
+static void test_fair(void) {
+    netif_t *a = net_vnic_create(mac_a, 1024);
+    netif_t *b = net_vnic_create(mac_b, 1024);
+    int i, first_b = -1, last_a = -1;
+
+    CHECK(a && b, "create failed");
+
+    log_reset();
+    gate(1);
+    CHECK(!inject(a, 0), "inject failed");
+    gate_wait();
+
+    for(i = 1; i < 1000; i++)
+        CHECK(!inject(a, i), "inject a %d failed", i);
+
+    for(i = 0; i < 1000; i++)
+        CHECK(!inject(b, i), "inject b %d failed", i);
+
+    gate(0);
+    CHECK(wait_for(2000), "passed up %d of 2000", dlog_len);
+
+    for(i = 0; i < 2000; i++) {
+        if(dlog[i].nif == b && first_b < 0)
+            first_b = i;
+
+        if(dlog[i].nif == a)
+            last_a = i;
+    }
+
+    /* b gets its turn after a's first budget, not after all of a */
+    CHECK(first_b >= 0 && first_b <= NET_POLL_BUDGET + 1,
+          "b's first frame came %dth", first_b);
+    CHECK(last_a >= 1000, "a finished first, at %d", last_a);
+
+    net_vnic_destroy(a);
+    net_vnic_destroy(b);
+}
+
+static void test_overflow(void) {
+    netif_t *nif = net_vnic_create(mac_a, 16);
+    net_vnic_stats_t st;
+    int i, ok = 0;
+
+    CHECK(nif, "create failed");
+
+    log_reset();
+    gate(1);
+    CHECK(!inject(nif, 0), "inject failed");
+    gate_wait();
+
+    /* The frame being passed up still has its slot */
+    for(i = 1; i < 40; i++) {
+        if(!inject(nif, i))
+            ok++;
+        else
+            CHECK(errno == ENOBUFS, "errno %d", errno);
+    }
+
+    CHECK(ok == 15, "%d fit", ok);
+
+    net_vnic_get_stats(nif, &st);
+    CHECK(st.rx_frames == 16 && st.rx_dropped == 24, "wrong stats");
+
+    gate(0);
+    CHECK(wait_for(16), "passed up %d of 16", dlog_len);
+
+    for(i = 0; i < 16; i++)
+        CHECK(dlog[i].seq == (uint32_t)i, "frame %d out of order", i);
+
+    CHECK(net_vnic_inject(nif, (const uint8 *)"short", 5) < 0 &&
+          errno == EMSGSIZE, "short frame accepted");
+
+    net_vnic_destroy(nif);
+}
+
+static void test_capture(void) {
+    netif_t *nif = net_vnic_create(mac_a, 4);
+    net_vnic_stats_t st;
+    uint8 frame[100], buf[100];
+    int i;
+
+    CHECK(nif, "create failed");
+    CHECK(net_vnic_capture(nif, buf, sizeof(buf)) < 0 && errno == EAGAIN,
+          "captured from nothing");
+
+    for(i = 0; i < 6; i++) {
+        memset(frame, i, sizeof(frame));
+        CHECK(nif->if_tx(nif, frame, 60 + i, NETIF_BLOCK) == NETIF_TX_OK,
+              "tx failed");
+    }
+
+    for(i = 0; i < 4; i++) {
+        CHECK(net_vnic_capture(nif, buf, sizeof(buf)) == 60 + i,
+              "wrong length");
+        CHECK(buf[0] == i && buf[59 + i] == i, "wrong frame");
+    }
+
+    CHECK(net_vnic_capture(nif, buf, sizeof(buf)) < 0, "captured too many");
+
+    net_vnic_get_stats(nif, &st);
+    CHECK(st.tx_frames == 4 && st.tx_dropped == 2, "wrong stats");
+
+    /* Truncated to fit */
+    CHECK(nif->if_tx(nif, frame, 80, NETIF_BLOCK) == NETIF_TX_OK, "tx failed");
+    CHECK(net_vnic_capture(nif, buf, 10) == 10, "not truncated");
+
+    net_vnic_destroy(nif);
+}
+
+static netif_t *destroy_nif;
+static volatile int destroyed;
+
+static void *destroyer(void *p) {
+    (void)p;
+    net_vnic_destroy(destroy_nif);
+    destroyed = 1;
+    return NULL;
+}
+
+static void test_destroy(void) {
+    pthread_t thd;
+
+    destroy_nif = net_vnic_create(mac_a, 16);
+    CHECK(destroy_nif, "create failed");
+
+    log_reset();
+    destroyed = 0;
+    gate(1);
+    CHECK(!inject(destroy_nif, 0), "inject failed");
+    CHECK(!inject(destroy_nif, 1), "inject failed");
+    gate_wait();
+
+    /* It's being polled, so destroying it has to wait */
+    pthread_create(&thd, NULL, destroyer, NULL);
+    usleep(20000);
+    CHECK(!destroyed, "destroyed while being polled");
+
+    gate(0);
+    pthread_join(thd, NULL);
+    CHECK(destroyed, "never destroyed");
+    CHECK(dlog_len >= 1 && dlog_len <= 2, "passed up %d", dlog_len);
+}
+
+#define RACE_FRAMES 200000
+
+static void *racer(void *p) {
+    netif_t *nif = p;
+    int i;
+
+    for(i = 0; i < RACE_FRAMES; i++) {
+        while(inject(nif, i) < 0)
+            sched_yield();
+
+        if(!(i & 255))
+            usleep(10);
+    }
+
+    return NULL;
+}
+
+static void test_race(void) {
+    netif_t *a = net_vnic_create(mac_a, 64);
+    netif_t *b = net_vnic_create(mac_b, 64);
+    net_vnic_stats_t st;
+    pthread_t ta, tb;
+    uint32_t next_a = 0, next_b = 0;
+    int i;
+
+    CHECK(a && b, "create failed");
+
+    /* Injecting while it's being polled and re-enabling the interrupt never
+       leaves a frame behind */
+    log_reset();
+    pthread_create(&ta, NULL, racer, a);
+    pthread_create(&tb, NULL, racer, b);
+    pthread_join(ta, NULL);
+    pthread_join(tb, NULL);
+
+    CHECK(wait_for(2 * RACE_FRAMES), "passed up %d of %d", dlog_len,
+          2 * RACE_FRAMES);
+
+    for(i = 0; i < dlog_len; i++) {
+        uint32_t *next = dlog[i].nif == a ? &next_a : &next_b;
+
+        CHECK(dlog[i].seq == *next, "frame %u out of order", dlog[i].seq);
+        (*next)++;
+    }
+
+    net_vnic_get_stats(a, &st);
+    CHECK(st.rx_frames == RACE_FRAMES, "wrong stats");
+
+    net_vnic_destroy(a);
+    net_vnic_destroy(b);
+}
+
+/* The benchmark */
+
+static void bench_rate(netif_t *nif, int frames, int gap_us) {
+    net_vnic_stats_t before, after;
+    double start, end;
+    int i, lost = 0;
+
+    net_vnic_get_stats(nif, &before);
+    log_reset();
+    start = now();
+
+    for(i = 0; i < frames; i++) {
+        while(inject(nif, i) < 0) {
+            lost++;
+            sched_yield();
+        }
+
+        if(gap_us)
+            usleep(gap_us);
+    }
+
+    wait_for(frames);
+    end = now();
+    net_vnic_get_stats(nif, &after);
+
+    printf("%6d frames, %4d us apart: %9.0f frames/s, %6.3f interrupts "
+           "per frame, latency %7.1f us avg %8.1f us max, ring full %d "
+           "times\n",
+           frames, gap_us, frames / (end - start),
+           (double)(after.rx_irqs - before.rx_irqs) / frames,
+           lat_total / frames * 1e6, lat_max * 1e6, lost);
+}
+
+static void bench(void) {
+    netif_t *nif = net_vnic_create(mac_a, 1024);
+
+    bench_rate(nif, 200000, 0);
+    bench_rate(nif, 2000, 100);
+
+    /* As though passing each frame up the stack took some real work */
+    input_delay = 20;
+    bench_rate(nif, 20000, 0);
+    input_delay = 0;
+
+    net_vnic_destroy(nif);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-b]\n", prog);
+    fprintf(stderr, "  -b   Run the benchmark instead of the tests\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int c, do_bench = 0;
+
+    while((c = getopt(argc, argv, "b")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    net_init(0);
+
+    if(do_bench) {
+        bench();
+        net_shutdown();
+        return 0;
+    }
+
+    test_basic();
+    test_budget();
+    test_fair();
+    test_overflow();
+    test_capture();
+    test_destroy();
+    test_race();
+
+    net_shutdown();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,25 @@
+/* KallistiOS ##version##
+
+   utils/netpolltest/shim/arch/irq.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Stand-in for the real arch/irq.h. Disabling interrupts takes a recursive
+   lock instead, which keeps out the other threads standing in for interrupt
+   handlers, until the end of the scope.
+*/
+
+#ifndef __ARCH_IRQ_H
+#define __ARCH_IRQ_H
+
+void test_irq_lock(void);
+void test_irq_unlock(int *dummy);
+
+#define irq_inside_int() 0
+
+#define __irq_scoped_cat(a, b) a ## b
+#define __irq_scoped_name(l) __irq_scoped_cat(__irq_scoped_, l)
+#define irq_disable_scoped() \
+    int __irq_scoped_name(__LINE__) __attribute__((cleanup(test_irq_unlock))) \
+        = (test_irq_lock(), 0)
+
+#endif /* __ARCH_IRQ_H */
@@ -24,6 +24,15 @@
  */
 
 #include <string.h>
+#include <pthread.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_ELBG_SSE2 1
+#if defined(__GNUC__)
+#define HAVE_ELBG_AVX2 1
+#endif
+#endif
 
 #include "libavutil/avassert.h"
 #include "libavutil/common.h"
@@ -32,6 +41,12 @@
 
 #define DELTA_ERR_MAX 0.1  ///< Precision of the ELBG algorithm (as percentage error)
 
+#define MAX_THREADS      64
+#define FAST_MAX_DIM     256   ///< Largest dimension handled by the int16 kernels
+#define FAST_MAX_VALUE   1023  ///< Largest magnitude of a point coordinate for them
+#define CB_BLOCK         8     ///< Codebook entries per kernel block
+#define THREAD_MIN_WORK  (1 << 18) ///< Distance evaluations that justify a thread
+
 /**
  * In the ELBG jargon, a cell is the set of points that are closest to a
  * codebook entry. Not to be confused with a RoQ Video cell. */
@@ -43,6 +58,28 @@ typedef struct cell_s {
 /**
  * ELBG internal data
  */
+struct ELBGContext;
+
+typedef struct ELBGThread {
+    struct ELBGContext *elbg;
+    pthread_t thread;
+    int idx;
+} ELBGThread;
+
+/**
+ * Find the codebook entry nearest to a point.
+ *
+ * @param p        Point, as npairs packed pairs of int16 coordinates
+ * @param cb       Codebook in the blocked layout built by pack_codebook()
+ * @param num_cb   Number of entries in cb
+ * @param npairs   Number of coordinate pairs per point
+ * @param exclude  Entry to skip, or -1
+ * @param dist     Returns the exact squared distance to the entry
+ * @return the lowest index among the entries at the minimum distance
+ */
+typedef int (*nearest_fn)(const uint32_t *p, const int16_t *cb, int num_cb,
+                          int npairs, int exclude, int *dist);
+
 typedef struct ELBGContext {
     int error;
     int dim;
@@ -69,6 +106,31 @@ typedef struct ELBGContext {
     unsigned scratchbuf_allocated;
     unsigned cell_buffer_allocated;
     unsigned temp_points_allocated;
+
+    /* Fast path: int16 copies of the points and the codebook, used when
+     * all coordinates are small enough for the kernels to be exact. */
+    int fast;
+    int npairs;
+    int nb_blocks;
+    nearest_fn nearest;
+    uint32_t *points16;
+    int16_t *codebook16;
+    int *best_dist;
+    unsigned points16_allocated;
+    unsigned codebook16_allocated;
+    unsigned best_dist_allocated;
+
+    /* Worker threads for the Voronoi partition */
+    int nb_threads;
+    ELBGThread *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    unsigned generation;
+    int pending;
+    int quit;
+    int job_points;
+    int job_slices;
 } ELBGContext;
 
 static inline int distance_limited(int *a, int *b, int dim, int limit)
@@ -86,6 +148,315 @@ static inline int distance_limited(int *a, int *b, int dim, int limit)
     return dist;
 }
 
+static av_unused int nearest_c(const uint32_t *p, const int16_t *cb, int num_cb,
+                     int npairs, int exclude, int *dist)
+{
+    int best_dist = INT_MAX, best = 0;
+
+    for (int b = 0; b * CB_BLOCK < num_cb; b++, cb += npairs * 2 * CB_BLOCK) {
+        for (int e = 0; e < CB_BLOCK; e++) {
+            int k = b * CB_BLOCK + e, d = 0;
+            if (k == exclude || k >= num_cb)
+                continue;
+            for (int j = 0; j < npairs; j++) {
+                int d0 = (int16_t)p[j]         - cb[j * 2 * CB_BLOCK + e * 2];
+                int d1 = (int16_t)(p[j] >> 16) - cb[j * 2 * CB_BLOCK + e * 2 + 1];
+                d += d0 * d0 + d1 * d1;
+            }
+            if (d < best_dist) {
+                best_dist = d;
+                best = k;
+            }
+        }
+    }
+
+    *dist = best_dist;
+    return best;
+}
+
+/* The vector kernels keep a running minimum per lane. Each lane only sees
+ * the entries congruent to it modulo CB_BLOCK, in increasing order, so the
+ * lowest index at the overall minimum is found by the final reduction. */
+static av_always_inline int reduce_lanes(const int *d, const int *idx, int *dist)
+{
+    int best_dist = d[0], best = idx[0];
+
+    for (int l = 1; l < CB_BLOCK; l++)
+        if (d[l] < best_dist || (d[l] == best_dist && idx[l] < best)) {
+            best_dist = d[l];
+            best = idx[l];
+        }
+
+    *dist = best_dist;
+    return best;
+}
+
+#if HAVE_ELBG_SSE2
+static int nearest_sse2(const uint32_t *p, const int16_t *cb, int num_cb,
+                        int npairs, int exclude, int *dist)
+{
+    const __m128i last = _mm_set1_epi32(num_cb - 1), ex = _mm_set1_epi32(exclude);
+    const __m128i max = _mm_set1_epi32(INT_MAX);
+    __m128i best[2] = { _mm_set1_epi32(INT_MAX), _mm_set1_epi32(INT_MAX) };
+    __m128i best_idx[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+    __m128i idx[2] = { _mm_setr_epi32(0, 1, 2, 3), _mm_setr_epi32(4, 5, 6, 7) };
+    const __m128i step = _mm_set1_epi32(CB_BLOCK);
+    int d[CB_BLOCK], id[CB_BLOCK];
+
+    for (int b = 0; b * CB_BLOCK < num_cb; b++) {
+        __m128i acc[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+        for (int j = 0; j < npairs; j++, cb += 2 * CB_BLOCK) {
+            __m128i pp = _mm_set1_epi32(p[j]);
+            __m128i d0 = _mm_sub_epi16(pp, _mm_loadu_si128((const __m128i *)cb));
+            __m128i d1 = _mm_sub_epi16(pp, _mm_loadu_si128((const __m128i *)(cb + 8)));
+            acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(d0, d0));
+            acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(d1, d1));
+        }
+        for (int h = 0; h < 2; h++) {
+            __m128i skip = _mm_or_si128(_mm_cmpeq_epi32(idx[h], ex),
+                                        _mm_cmpgt_epi32(idx[h], last));
+            __m128i lt;
+            acc[h] = _mm_or_si128(_mm_andnot_si128(skip, acc[h]), _mm_and_si128(skip, max));
+            lt = _mm_cmpgt_epi32(best[h], acc[h]);
+            best[h]     = _mm_or_si128(_mm_andnot_si128(lt, best[h]), _mm_and_si128(lt, acc[h]));
+            best_idx[h] = _mm_or_si128(_mm_andnot_si128(lt, best_idx[h]), _mm_and_si128(lt, idx[h]));
+            idx[h]      = _mm_add_epi32(idx[h], step);
+        }
+    }
+
+    _mm_storeu_si128((__m128i *)d,       best[0]);
+    _mm_storeu_si128((__m128i *)(d + 4), best[1]);
+    _mm_storeu_si128((__m128i *)id,       best_idx[0]);
+    _mm_storeu_si128((__m128i *)(id + 4), best_idx[1]);
+    return reduce_lanes(d, id, dist);
+}
+#endif
+
+#if HAVE_ELBG_AVX2
+__attribute__((target("avx2")))
+static int nearest_avx2(const uint32_t *p, const int16_t *cb, int num_cb,
+                        int npairs, int exclude, int *dist)
+{
+    const __m256i last = _mm256_set1_epi32(num_cb - 1), ex = _mm256_set1_epi32(exclude);
+    __m256i best = _mm256_set1_epi32(INT_MAX);
+    __m256i best_idx = _mm256_setzero_si256();
+    __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(CB_BLOCK);
+    int d[CB_BLOCK], id[CB_BLOCK];
+
+    for (int b = 0; b * CB_BLOCK < num_cb; b++) {
+        __m256i acc = _mm256_setzero_si256(), skip, lt;
+        for (int j = 0; j < npairs; j++, cb += 2 * CB_BLOCK) {
+            __m256i df = _mm256_sub_epi16(_mm256_set1_epi32(p[j]),
+                                          _mm256_loadu_si256((const __m256i *)cb));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(df, df));
+        }
+        skip     = _mm256_or_si256(_mm256_cmpeq_epi32(idx, ex), _mm256_cmpgt_epi32(idx, last));
+        acc      = _mm256_blendv_epi8(acc, _mm256_set1_epi32(INT_MAX), skip);
+        lt       = _mm256_cmpgt_epi32(best, acc);
+        best     = _mm256_blendv_epi8(best, acc, lt);
+        best_idx = _mm256_blendv_epi8(best_idx, idx, lt);
+        idx      = _mm256_add_epi32(idx, step);
+    }
+
+    _mm256_storeu_si256((__m256i *)d,  best);
+    _mm256_storeu_si256((__m256i *)id, best_idx);
+    return reduce_lanes(d, id, dist);
+}
+#endif
+
+static nearest_fn select_nearest(void)
+{
+#if HAVE_ELBG_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return nearest_avx2;
+#endif
+#if HAVE_ELBG_SSE2
+    return nearest_sse2;
+#else
+    return nearest_c;
+#endif
+}
+
+/**
+ * Pack a vector into pairs of int16 coordinates, padding odd dimensions
+ * with a zero.
+ */
+static void pack_point(uint32_t *dst, const int *src, int dim)
+{
+    for (int i = 0; i < dim; i += 2) {
+        int hi = i + 1 < dim ? src[i + 1] : 0;
+        dst[i >> 1] = (uint16_t)src[i] | (uint32_t)(uint16_t)hi << 16;
+    }
+}
+
+/**
+ * Convert the codebook to blocks of CB_BLOCK entries, with the coordinate
+ * pairs of all the entries in a block interleaved so that a kernel can
+ * compute the distances to a whole block at once. The kernels ignore the
+ * entries padding the last block.
+ */
+static void pack_codebook(ELBGContext *elbg)
+{
+    int16_t *dst = elbg->codebook16;
+
+    for (int b = 0; b < elbg->nb_blocks; b++)
+        for (int j = 0; j < elbg->npairs; j++)
+            for (int e = 0; e < CB_BLOCK; e++) {
+                int k = b * CB_BLOCK + e;
+                const int *src;
+                if (k >= elbg->num_cb) {
+                    *dst++ = 0;
+                    *dst++ = 0;
+                    continue;
+                }
+                src = elbg->codebook + k * elbg->dim;
+                *dst++ = src[2 * j];
+                *dst++ = 2 * j + 1 < elbg->dim ? src[2 * j + 1] : 0;
+            }
+}
+
+static int distance16(const ELBGContext *elbg, int i, int k)
+{
+    const uint32_t *p = elbg->points16 + i * elbg->npairs;
+    const int16_t *c = elbg->codebook16 + (k / CB_BLOCK) * elbg->npairs * 2 * CB_BLOCK +
+                       (k % CB_BLOCK) * 2;
+    int dist = 0;
+
+    for (int j = 0; j < elbg->npairs; j++, c += 2 * CB_BLOCK) {
+        int d0 = (int16_t)p[j]         - c[0];
+        int d1 = (int16_t)(p[j] >> 16) - c[1];
+        dist += d0 * d0 + d1 * d1;
+    }
+
+    return dist;
+}
+
+/**
+ * Find the nearest codebook entry and its distance for the points of one
+ * slice of the partition.
+ */
+static void partition_slice(ELBGContext *elbg, int slice)
+{
+    int start = (int)((int64_t)elbg->job_points *  slice      / elbg->job_slices);
+    int end   = (int)((int64_t)elbg->job_points * (slice + 1) / elbg->job_slices);
+
+    for (int i = start; i < end; i++)
+        elbg->nearest_cb[i] = elbg->nearest(elbg->points16 + i * elbg->npairs,
+                                            elbg->codebook16, elbg->num_cb,
+                                            elbg->npairs, -1, &elbg->best_dist[i]);
+}
+
+static void *partition_worker(void *arg)
+{
+    ELBGThread *t = arg;
+    ELBGContext *elbg = t->elbg;
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&elbg->lock);
+    for (;;) {
+        while (elbg->generation == generation && !elbg->quit)
+            pthread_cond_wait(&elbg->work_cond, &elbg->lock);
+        if (elbg->quit)
+            break;
+        generation = elbg->generation;
+        pthread_mutex_unlock(&elbg->lock);
+
+        if (t->idx < elbg->job_slices)
+            partition_slice(elbg, t->idx);
+
+        pthread_mutex_lock(&elbg->lock);
+        if (!--elbg->pending)
+            pthread_cond_signal(&elbg->done_cond);
+    }
+    pthread_mutex_unlock(&elbg->lock);
+
+    return NULL;
+}
+
+static void stop_threads(ELBGContext *elbg)
+{
+    if (!elbg->threads)
+        return;
+
+    pthread_mutex_lock(&elbg->lock);
+    elbg->quit = 1;
+    pthread_cond_broadcast(&elbg->work_cond);
+    pthread_mutex_unlock(&elbg->lock);
+
+    /* Thread 0 is the caller */
+    for (int i = 1; i < elbg->nb_threads; i++)
+        pthread_join(elbg->threads[i].thread, NULL);
+
+    pthread_cond_destroy(&elbg->done_cond);
+    pthread_cond_destroy(&elbg->work_cond);
+    pthread_mutex_destroy(&elbg->lock);
+    av_freep(&elbg->threads);
+    elbg->nb_threads = 1;
+    elbg->quit = 0;
+}
+
+/**
+ * Start nb_threads - 1 workers; the calling thread handles the first slice.
+ * If not all of them can be created, continue with the ones that were.
+ */
+static void start_threads(ELBGContext *elbg, int nb_threads)
+{
+    elbg->nb_threads = 1;
+    if (nb_threads <= 1)
+        return;
+
+    elbg->threads = av_calloc(nb_threads, sizeof(*elbg->threads));
+    if (!elbg->threads)
+        return;
+
+    pthread_mutex_init(&elbg->lock, NULL);
+    pthread_cond_init(&elbg->work_cond, NULL);
+    pthread_cond_init(&elbg->done_cond, NULL);
+    elbg->generation = 0;
+    elbg->quit = 0;
+
+    for (int i = 1; i < nb_threads; i++) {
+        elbg->threads[i].elbg = elbg;
+        elbg->threads[i].idx  = i;
+        if (pthread_create(&elbg->threads[i].thread, NULL, partition_worker,
+                           &elbg->threads[i]))
+            break;
+        elbg->nb_threads++;
+    }
+}
+
+/**
+ * Compute the nearest entry of every point, splitting the points between
+ * the worker threads when there is enough work to go around.
+ */
+static void run_partition(ELBGContext *elbg, int numpoints)
+{
+    int64_t work = (int64_t)numpoints * elbg->num_cb * elbg->npairs;
+    int slices = (int)FFMIN(elbg->nb_threads, work / THREAD_MIN_WORK);
+
+    elbg->job_points = numpoints;
+    elbg->job_slices = FFMAX(slices, 1);
+
+    if (elbg->job_slices == 1) {
+        partition_slice(elbg, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&elbg->lock);
+    elbg->pending = elbg->nb_threads - 1;
+    elbg->generation++;
+    pthread_cond_broadcast(&elbg->work_cond);
+    pthread_mutex_unlock(&elbg->lock);
+
+    partition_slice(elbg, 0);
+
+    pthread_mutex_lock(&elbg->lock);
+    while (elbg->pending)
+        pthread_cond_wait(&elbg->done_cond, &elbg->lock);
+    pthread_mutex_unlock(&elbg->lock);
+}
+
 static inline void vect_division(int *res, int *vect, int div, int dim)
 {
     int i;
@@ -113,6 +484,15 @@ static int eval_error_cell(ELBGContext *elbg, int *centroid, cell *cells)
 static int get_closest_codebook(ELBGContext *elbg, int index)
 {
     int pick = 0;
+
+    if (elbg->fast) {
+        uint32_t p[FAST_MAX_DIM / 2];
+        int dist;
+        pack_point(p, elbg->codebook + index*elbg->dim, elbg->dim);
+        return elbg->nearest(p, elbg->codebook16, elbg->num_cb, elbg->npairs,
+                             index, &dist);
+    }
+
     for (int i = 0, diff_min = INT_MAX; i < elbg->num_cb; i++)
         if (i != index) {
             int diff;
@@ -372,6 +752,10 @@ static void do_elbg(ELBGContext *av_restrict elbg, int *points, int numpoints,
     elbg->error = INT_MAX;
     elbg->points = points;
 
+    if (elbg->fast)
+        for (i=0; i < numpoints; i++)
+            pack_point(elbg->points16 + i * elbg->npairs, points + i * elbg->dim, elbg->dim);
+
     do {
         cell *free_cells = elbg->cell_buffer;
         last_error = elbg->error;
@@ -383,20 +767,37 @@ static void do_elbg(ELBGContext *av_restrict elbg, int *points, int numpoints,
 
         /* This loop evaluate the actual Voronoi partition. It is the most
            costly part of the algorithm. */
+        if (elbg->fast) {
+            pack_codebook(elbg);
+            run_partition(elbg, numpoints);
+        }
+
         for (i=0; i < numpoints; i++) {
-            int best_dist = distance_limited(elbg->points   + i * elbg->dim,
+            int best_dist;
+
+            if (elbg->fast) {
+                /* The threads found the lowest index at the minimum distance;
+                 * the sequential search keeps the previous point's entry on
+                 * a tie, so do the same to get the same partition. */
+                best_dist = elbg->best_dist[i];
+                if (elbg->nearest_cb[i] != best_idx && distance16(elbg, i, best_idx) == best_dist)
+                    elbg->nearest_cb[i] = best_idx;
+                best_idx = elbg->nearest_cb[i];
+            } else {
+                best_dist = distance_limited(elbg->points   + i * elbg->dim,
                                              elbg->codebook + best_idx * elbg->dim,
                                              elbg->dim, INT_MAX);
-            for (int k = 0; k < elbg->num_cb; k++) {
-                int dist = distance_limited(elbg->points   + i * elbg->dim,
-                                            elbg->codebook + k * elbg->dim,
-                                            elbg->dim, best_dist);
-                if (dist < best_dist) {
-                    best_dist = dist;
-                    best_idx = k;
+                for (int k = 0; k < elbg->num_cb; k++) {
+                    int dist = distance_limited(elbg->points   + i * elbg->dim,
+                                                elbg->codebook + k * elbg->dim,
+                                                elbg->dim, best_dist);
+                    if (dist < best_dist) {
+                        best_dist = dist;
+                        best_idx = k;
+                    }
                 }
+                elbg->nearest_cb[i] = best_idx;
             }
-            elbg->nearest_cb[i] = best_idx;
             elbg->error = (elbg->error >= INT_MAX - best_dist) ? INT_MAX : elbg->error + best_dist;
             elbg->utility[elbg->nearest_cb[i]] = (elbg->utility[elbg->nearest_cb[i]] >= INT_MAX - best_dist) ?
                                                   INT_MAX : elbg->utility[elbg->nearest_cb[i]] + best_dist;
@@ -461,12 +862,15 @@ static void init_elbg(ELBGContext *av_restrict elbg, int *points, int *temp_poin
 
 int avpriv_elbg_do(ELBGContext **elbgp, int *points, int dim, int numpoints,
                    int *codebook, int num_cb, int max_steps,
-                   int *closest_cb, AVLFG *rand_state, uintptr_t flags)
+                   int *closest_cb, AVLFG *rand_state, int nb_threads,
+                   uintptr_t flags)
 {
     ELBGContext *const av_restrict elbg = *elbgp ? *elbgp : av_mallocz(sizeof(*elbg));
 
     if (!elbg)
         return AVERROR(ENOMEM);
+    if (!*elbgp)
+        elbg->nb_threads = 1;
     *elbgp = elbg;
 
     elbg->nearest_cb = closest_cb;
@@ -507,6 +911,26 @@ int avpriv_elbg_do(ELBGContext **elbgp, int *points, int dim, int numpoints,
         ALLOCATE_IF_NECESSARY(temp_points, prod, 1)
     }
 
+    /* The int16 kernels are exact as long as no difference or sum of
+     * squares can overflow; otherwise use the generic code. */
+    elbg->fast = dim <= FAST_MAX_DIM;
+    for (int64_t i = 0; i < (int64_t)numpoints * dim && elbg->fast; i++)
+        elbg->fast = FFABS(points[i]) <= FAST_MAX_VALUE;
+    if (elbg->fast) {
+        elbg->npairs    = (dim + 1) / 2;
+        elbg->nb_blocks = (num_cb + CB_BLOCK - 1) / CB_BLOCK;
+        elbg->nearest   = select_nearest();
+        ALLOCATE_IF_NECESSARY(points16,   numpoints * elbg->npairs, 1)
+        ALLOCATE_IF_NECESSARY(best_dist,  numpoints, 1)
+        ALLOCATE_IF_NECESSARY(codebook16, elbg->nb_blocks * elbg->npairs * 2 * CB_BLOCK, 1)
+
+        nb_threads = av_clip(nb_threads, 1, MAX_THREADS);
+        if (nb_threads != elbg->nb_threads) {
+            stop_threads(elbg);
+            start_threads(elbg, nb_threads);
+        }
+    }
+
     init_elbg(elbg, points, elbg->temp_points, numpoints, max_steps);
     do_elbg (elbg, points, numpoints, max_steps);
     return 0;
@@ -525,6 +949,10 @@ av_cold void avpriv_elbg_free(ELBGContext **elbgp)
     av_freep(&elbg->utility_inc);
     av_freep(&elbg->scratchbuf);
     av_freep(&elbg->temp_points);
+    av_freep(&elbg->points16);
+    av_freep(&elbg->best_dist);
+    av_freep(&elbg->codebook16);
+    stop_threads(elbg);
 
     av_freep(elbgp);
 }
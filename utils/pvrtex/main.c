@@ -175,6 +175,7 @@ int main(int argc, char **argv) {
 		{"mip-resize", 'R', OPTPARSE_OPTIONAL},
 		{"stride", 's', OPTPARSE_NONE},
 		{"edge", 'e', OPTPARSE_REQUIRED},
+		{"threads", 't', OPTPARSE_REQUIRED},
 		{0}
 	};
 
@@ -242,6 +243,11 @@ int main(int argc, char **argv) {
 		case 'e':
 			pte.edge_method = GetOptMap(edge_options, ARR_SIZE(edge_options), options.optarg, -0, "invalid edge handling method\n");
 			break;
+		case 't':
+			if ((sscanf(options.optarg, "%u", &pte.threads) != 1) || (pte.threads < 1) || (pte.threads > 64)) {
+				ErrorExit("invalid thread count, should be in the range [1, 64]\n");
+			}
+			break;
 		case 'H':
 			if (sscanf(options.optarg, "%u", &pte.high_weight_mips) != 1) {
 				ErrorExit("invalid high weight parameter, must be an integer between 1 and the number of mipmap levels\n");
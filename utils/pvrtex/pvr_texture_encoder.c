@@ -298,6 +298,7 @@ void pteGeneratePalette(PvrTexEncoder *pte) {
 
 	VQCompressor vqc;
 	vqcInit(&vqc, VQC_UINT8, 4, 1, pte->palette_size);
+	vqcSetThreads(&vqc, pte->threads);
 	vqcSetRGBAGamma(&vqc, pte->rgb_gamma, pte->alpha_gamma);
 
 	//Add mipmaps to compressor input
@@ -421,6 +422,7 @@ void pteCompress(PvrTexEncoder *pte) {
 	assert(cbsize > 0);
 	VQCompressor vqc;
 	vqcInit(&vqc, VQC_UINT8, 4, vectorarea, cbsize);
+	vqcSetThreads(&vqc, pte->threads);
 	vqcSetRGBAGamma(&vqc, pte->rgb_gamma, pte->alpha_gamma);
 
 	//Add uncompressed data
@@ -122,6 +122,10 @@ typedef struct PvrTexEncoder {
 	float rgb_gamma;
 	float alpha_gamma;
 
+	//Number of threads to use for compression, 0 means one per CPU core
+	//The output does not depend on this
+	unsigned threads;
+
 //
 //	Below here is used internally by encoder. User should avoid messing with most of these.
 //
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 #include "vqcompress.h"
 #include "elbg.h"
 #include "mycommon.h"
@@ -95,6 +100,22 @@ void vqcSetARGBGamma(VQCompressor *c, float rgb, float alpha) {
 	}
 }
 
+void vqcSetThreads(VQCompressor *c, unsigned threads) {
+	assert(c);
+	c->threads = threads;
+}
+
+static unsigned CPUCount(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long cnt = sysconf(_SC_NPROCESSORS_ONLN);
+	return cnt > 0 ? cnt : 1;
+#endif
+}
+
 vqcResults vqcCompress(VQCompressor *c, int quality) {
 	assert(c);
 	assert(c->cb_size);
@@ -114,7 +135,8 @@ vqcResults vqcCompress(VQCompressor *c, int quality) {
 	struct ELBGContext *elbgcxt = 0;
 	struct AVLFG randcxt;
 	av_lfg_init(&randcxt, 1);
-	int errval = avpriv_elbg_do(&elbgcxt, c->data, c->dimensions, c->point_cnt, int_codebook, c->cb_size, quality, result.indices, &randcxt, 0);
+	unsigned threads = c->threads ? c->threads : CPUCount();
+	int errval = avpriv_elbg_do(&elbgcxt, c->data, c->dimensions, c->point_cnt, int_codebook, c->cb_size, quality, result.indices, &randcxt, threads, 0);
 	assert(errval == 0);
 	avpriv_elbg_free(&elbgcxt);
 
@@ -15,6 +15,10 @@ typedef struct {
 
 	unsigned dimensions;	//pix_per_cb * channels
 
+	//number of threads to compress with, 0 uses every CPU core
+	//the result is the same whatever the number of threads
+	unsigned threads;
+
 	//channels can have different gammas (alpha could be 1.0, while RGB could be 2.2)
 	float gamma[VQC_MAX_CHANNELS];
 
@@ -33,6 +37,7 @@ void vqcAddPoints(VQCompressor *c, const void *src, size_t pixel_cnt);
 void vqcSetChannelGamma(VQCompressor *c, unsigned channel, float val);
 void vqcSetRGBAGamma(VQCompressor *c, float rgb, float alpha);
 void vqcSetARGBGamma(VQCompressor *c, float rgb, float alpha);
+void vqcSetThreads(VQCompressor *c, unsigned threads);
 vqcResults vqcCompress(VQCompressor *c, int quality);
 
 
@@ -0,0 +1,522 @@
+/* KallistiOS ##version##
+
+   qoitest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the QOI encoder in
+   kernel/arch/dreamcast/util/qoi.c, which is built as-is on the host. Images
+   are encoded a row at a time, the way the background capture does it, and
+   decoded again with a separate decoder written from the specification.
+
+   The tests check that images in every pixel mode decode to the same colors
+   vid_screen_shot_data() gives, that no row takes more than QOI_ROW_MAX()
+   bytes, that runs are split and carried across rows correctly, that the
+   smallest images come out byte for byte as the specification says, and that
+   unsupported pixel modes are refused. The benchmark (-b) measures encoding
+   speed and the size of the output against a PPM, for a full screen.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qoi.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const int pmode_bpp[4] = { 2, 2, 3, 4 };
+
+static const char *pmode_name[4] = {
+    "RGB555", "RGB565", "RGB888P", "RGB0888"
+};
+
+/* A framebuffer, laid out the way it is in VRAM */
+typedef struct {
+    uint8_t *data;
+    int w, h;
+    vid_pixel_mode_t pm;
+} fb_t;
+
+static fb_t *fb_new(int w, int h, vid_pixel_mode_t pm) {
+    fb_t *fb = malloc(sizeof(fb_t));
+
+    fb->data = calloc(w * h, pmode_bpp[pm]);
+    fb->w = w;
+    fb->h = h;
+    fb->pm = pm;
+    return fb;
+}
+
+static void fb_free(fb_t *fb) {
+    free(fb->data);
+    free(fb);
+}
+
+static uint8_t *fb_row(fb_t *fb, int y) {
+    return fb->data + y * fb->w * pmode_bpp[fb->pm];
+}
+
+/* Store a raw pixel value, in the framebuffer's own format */
+static void fb_set(fb_t *fb, int x, int y, uint32_t v) {
+    uint8_t *p = fb_row(fb, y) + x * pmode_bpp[fb->pm];
+
+    switch(fb->pm) {
+        case PM_RGB555:
+        case PM_RGB565:
+            memcpy(p, &(uint16_t){ v }, 2);
+            break;
+        case PM_RGB888P:
+            p[0] = v;
+            p[1] = v >> 8;
+            p[2] = v >> 16;
+            break;
+        default:
+            memcpy(p, &v, 4);
+            break;
+    }
+}
+
+/* The color vid_screen_shot_data() gives a pixel, as 0xRRGGBB */
+static uint32_t fb_rgb(fb_t *fb, int x, int y) {
+    uint8_t *p = fb_row(fb, y) + x * pmode_bpp[fb->pm];
+    uint32_t v;
+
+    switch(fb->pm) {
+        case PM_RGB555:
+            v = p[0] | p[1] << 8;
+            return ((v >> 10) & 0x1f) << 19 | ((v >> 5) & 0x1f) << 11 |
+                   (v & 0x1f) << 3;
+        case PM_RGB565:
+            v = p[0] | p[1] << 8;
+            return ((v >> 11) & 0x1f) << 19 | ((v >> 5) & 0x3f) << 10 |
+                   (v & 0x1f) << 3;
+        case PM_RGB888P:
+            return p[2] << 16 | p[1] << 8 | p[0];
+        default:
+            memcpy(&v, p, 4);
+            return v & 0xffffff;
+    }
+}
+
+/* Encode a whole framebuffer, a row at a time. Returns the size of the image,
+   or 0 if a row took more room than it's allowed. */
+static size_t encode(fb_t *fb, uint8_t *out) {
+    qoi_enc_t enc;
+    size_t len;
+    ssize_t n;
+    int y;
+
+    len = qoi_enc_start(&enc, out, fb->w, fb->h);
+
+    for(y = 0; y < fb->h; y++) {
+        n = qoi_enc_row(&enc, out + len, fb_row(fb, y), fb->w, fb->pm);
+
+        if(n < 0 || n > QOI_ROW_MAX(fb->w))
+            return 0;
+
+        len += n;
+    }
+
+    return len + qoi_enc_finish(&enc, out + len);
+}
+
+static size_t encode_max(fb_t *fb) {
+    return QOI_HEADER_SIZE + QOI_ROW_MAX(fb->w) * fb->h + QOI_FINISH_MAX;
+}
+
+/* A decoder following the specification to the letter, alpha and all. Writes
+   the pixels to px as 0xRRGGBB, and returns a description of what's wrong, or
+   NULL if the image is good. */
+static const char *decode(const uint8_t *in, size_t len, int w, int h,
+                          uint32_t *px) {
+    static const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    uint8_t index[64][4], cur[4] = { 0, 0, 0, 255 };
+    size_t pos = QOI_HEADER_SIZE, n = 0, count = (size_t)w * h;
+    int b, run, dg, i;
+
+    memset(index, 0, sizeof(index));
+
+    if(len < QOI_HEADER_SIZE + sizeof(end))
+        return "too short";
+
+    if(memcmp(in, "qoif", 4))
+        return "bad magic";
+
+    if((uint32_t)(in[4] << 24 | in[5] << 16 | in[6] << 8 | in[7]) !=
+       (uint32_t)w ||
+       (uint32_t)(in[8] << 24 | in[9] << 16 | in[10] << 8 | in[11]) !=
+       (uint32_t)h)
+        return "bad size";
+
+    if(in[12] != 3 || in[13] != 0)
+        return "bad channels or colorspace";
+
+    while(n < count) {
+        if(pos >= len - sizeof(end))
+            return "ran out of data";
+
+        b = in[pos++];
+        run = 1;
+
+        if(b == 0xfe) {
+            memcpy(cur, in + pos, 3);
+            pos += 3;
+        }
+        else if(b == 0xff) {
+            memcpy(cur, in + pos, 4);
+            pos += 4;
+        }
+        else if((b & 0xc0) == 0x00) {
+            memcpy(cur, index[b], 4);
+        }
+        else if((b & 0xc0) == 0x40) {
+            cur[0] += ((b >> 4) & 3) - 2;
+            cur[1] += ((b >> 2) & 3) - 2;
+            cur[2] += (b & 3) - 2;
+        }
+        else if((b & 0xc0) == 0x80) {
+            dg = (b & 0x3f) - 32;
+            b = in[pos++];
+            cur[0] += dg - 8 + ((b >> 4) & 0xf);
+            cur[1] += dg;
+            cur[2] += dg - 8 + (b & 0xf);
+        }
+        else {
+            run = (b & 0x3f) + 1;
+        }
+
+        if(n + run > count)
+            return "run past the end of the image";
+
+        for(i = 0; i < run; i++)
+            px[n++] = cur[0] << 16 | cur[1] << 8 | cur[2];
+
+        i = (cur[0] * 3 + cur[1] * 5 + cur[2] * 7 + cur[3] * 11) % 64;
+        memcpy(index[i], cur, 4);
+    }
+
+    if(pos != len - sizeof(end))
+        return "data after the last pixel";
+
+    if(memcmp(in + pos, end, sizeof(end)))
+        return "bad end marker";
+
+    if(cur[3] != 255)
+        return "not opaque";
+
+    return NULL;
+}
+
+/* Encode the framebuffer, decode it again, and compare */
+static const char *round_trip(fb_t *fb, size_t *size) {
+    uint8_t *out = malloc(encode_max(fb));
+    uint32_t *px = malloc(fb->w * fb->h * sizeof(uint32_t));
+    const char *err = NULL;
+    size_t len;
+    int x, y;
+
+    if(!(len = encode(fb, out)))
+        err = "row too big, or pixel mode refused";
+    else
+        err = decode(out, len, fb->w, fb->h, px);
+
+    for(y = 0; !err && y < fb->h; y++) {
+        for(x = 0; x < fb->w; x++) {
+            if(px[y * fb->w + x] != fb_rgb(fb, x, y)) {
+                err = "pixels differ";
+                break;
+            }
+        }
+    }
+
+    if(size)
+        *size = len;
+
+    free(px);
+    free(out);
+    return err;
+}
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Something like a game screen: flat areas, gradients, small and large
+   changes between neighbors, and repeats of earlier colors. */
+static void fill_mixed(fb_t *fb) {
+    uint32_t v = 0, recent[8] = { 0 };
+    int x, y;
+
+    for(y = 0; y < fb->h; y++) {
+        for(x = 0; x < fb->w; x++) {
+            switch(rng() % 8) {
+                case 0:
+                case 1:
+                    break;
+                case 2:
+                    v += rng() % 3;
+                    break;
+                case 3:
+                    v += (rng() % 0x20) << (rng() % 3 * 5);
+                    break;
+                case 4:
+                    v = recent[rng() % 8];
+                    break;
+                case 5:
+                    v ^= 1 << (rng() % 32);
+                    break;
+                default:
+                    v = rng();
+                    break;
+            }
+
+            recent[rng() % 8] = v;
+            fb_set(fb, x, y, v);
+        }
+    }
+}
+
+static void fill_gradient(fb_t *fb) {
+    int x, y;
+
+    for(y = 0; y < fb->h; y++) {
+        for(x = 0; x < fb->w; x++)
+            fb_set(fb, x, y, (x * 255 / fb->w) << 16 | (y * 255 / fb->h) << 8 |
+                   ((x + y) & 0xff));
+    }
+}
+
+static void test_modes(void) {
+    static const int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 64, 64 },
+                                    { 123, 45 }, { 320, 240 } };
+    const char *err;
+    unsigned int i;
+    fb_t *fb;
+    int pm;
+
+    for(pm = PM_RGB555; pm <= PM_RGB0888; pm++) {
+        for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            fb = fb_new(sizes[i][0], sizes[i][1], pm);
+            fill_mixed(fb);
+            err = round_trip(fb, NULL);
+            fb_free(fb);
+            CHECK(!err, "%s %dx%d mixed: %s", pmode_name[pm], sizes[i][0],
+                  sizes[i][1], err);
+
+            fb = fb_new(sizes[i][0], sizes[i][1], pm);
+            fill_gradient(fb);
+            err = round_trip(fb, NULL);
+            fb_free(fb);
+            CHECK(!err, "%s %dx%d gradient: %s", pmode_name[pm], sizes[i][0],
+                  sizes[i][1], err);
+        }
+    }
+}
+
+/* Every pixel different from the one before, and not in the index: each
+   row must still fit in QOI_ROW_MAX(). */
+static void test_worst(void) {
+    const char *err;
+    size_t len;
+    fb_t *fb;
+    int x, y;
+
+    fb = fb_new(640, 4, PM_RGB0888);
+
+    for(y = 0; y < fb->h; y++) {
+        for(x = 0; x < fb->w; x++)
+            fb_set(fb, x, y, rng() | 0x808080);
+    }
+
+    err = round_trip(fb, &len);
+    fb_free(fb);
+    CHECK(!err, "%s", err);
+    CHECK(len > 640 * 4 * 3, "random pixels only took %zu bytes", len);
+}
+
+/* The first pixel is compared with black, like the specification says, so a
+   black image is nothing but runs. */
+static void test_black(void) {
+    static const uint8_t expect[] = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 1, 0, 0, 0, 1, 3, 0,
+        0xc0,
+        0, 0, 0, 0, 0, 0, 0, 1
+    };
+    uint8_t out[64];
+    size_t len;
+    fb_t *fb;
+
+    fb = fb_new(1, 1, PM_RGB565);
+    len = encode(fb, out);
+    fb_free(fb);
+
+    CHECK(len == sizeof(expect), "1x1 black took %zu bytes", len);
+    CHECK(!memcmp(out, expect, len), "1x1 black encoded wrongly");
+}
+
+/* Black must not be found in the index before it's been seen, as the index
+   starts out all zeroes, with an alpha of 0. */
+static void test_black_index(void) {
+    static const uint8_t expect[] = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 1, 3, 0,
+        0xfe, 0x10, 0x20, 0x30,
+        0xfe, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 1
+    };
+    uint8_t out[64];
+    size_t len;
+    fb_t *fb;
+
+    fb = fb_new(2, 1, PM_RGB0888);
+    fb_set(fb, 0, 0, 0x102030);
+    fb_set(fb, 1, 0, 0);
+    len = encode(fb, out);
+    fb_free(fb);
+
+    CHECK(len == sizeof(expect), "blue then black took %zu bytes", len);
+    CHECK(!memcmp(out, expect, len), "blue then black encoded wrongly");
+}
+
+/* Runs are at most 62 pixels, and carry on from one row to the next. */
+static void test_runs(void) {
+    static const int widths[] = { 61, 62, 63, 124, 125, 200 };
+    uint8_t out[64];
+    const char *err;
+    unsigned int i;
+    size_t len, ops;
+    fb_t *fb;
+    int x, y;
+
+    for(i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+        fb = fb_new(widths[i], 1, PM_RGB555);
+        len = encode(fb, out);
+        fb_free(fb);
+
+        ops = (widths[i] + 61) / 62;
+        CHECK(len == QOI_HEADER_SIZE + ops + 8, "run of %d took %zu bytes",
+              widths[i], len);
+        CHECK(out[QOI_HEADER_SIZE + ops - 1] ==
+              (0xc0 | ((widths[i] - 1) % 62)),
+              "run of %d ends with 0x%02x", widths[i],
+              out[QOI_HEADER_SIZE + ops - 1]);
+    }
+
+    /* One color over 20 rows of 10 is a pixel, then 199 pixels of runs */
+    fb = fb_new(10, 20, PM_RGB565);
+
+    for(y = 0; y < fb->h; y++) {
+        for(x = 0; x < fb->w; x++)
+            fb_set(fb, x, y, 0x1234);
+    }
+
+    err = round_trip(fb, &len);
+    fb_free(fb);
+    CHECK(!err, "uniform image: %s", err);
+    CHECK(len == QOI_HEADER_SIZE + 4 + 4 + 8, "uniform image took %zu bytes",
+          len);
+}
+
+static void test_unsupported(void) {
+    uint8_t out[64], row[16] = { 0 };
+    qoi_enc_t enc;
+
+    qoi_enc_start(&enc, out, 4, 1);
+    CHECK(qoi_enc_row(&enc, out, row, 4, (vid_pixel_mode_t)4) == -1,
+          "pixel mode 4 wasn't refused");
+}
+
+static void bench(void) {
+    int pm, i, iters = 50;
+    size_t len = 0, ppm;
+    double t;
+    uint8_t *out;
+    fb_t *fb;
+
+    printf("%-8s %12s %12s %10s\n", "mode", "MB/s in", "frames/s", "vs PPM");
+
+    for(pm = PM_RGB555; pm <= PM_RGB0888; pm++) {
+        fb = fb_new(640, 480, pm);
+        fill_mixed(fb);
+        out = malloc(encode_max(fb));
+
+        t = now();
+
+        for(i = 0; i < iters; i++)
+            len = encode(fb, out);
+
+        t = now() - t;
+        ppm = 15 + 640 * 480 * 3;
+
+        printf("%-8s %12.1f %12.1f %9.1f%%\n", pmode_name[pm],
+               640.0 * 480 * pmode_bpp[pm] * iters / t / 1e6, iters / t,
+               100.0 * len / ppm);
+
+        free(out);
+        fb_free(fb);
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-b]\n", argv0);
+    fprintf(stderr, "  -b  run the benchmark instead of the tests\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int c, do_bench = 0;
+
+    while((c = getopt(argc, argv, "b")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(do_bench) {
+        bench();
+        return 0;
+    }
+
+    test_modes();
+    test_worst();
+    test_black();
+    test_black_index();
+    test_runs();
+    test_unsupported();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,714 @@
+/* KallistiOS ##version##
+
+   romdisktest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for packed romdisk images. The romdisk driver
+   in kernel/fs/fs_romdisk.c is built as-is on the host, and the images are
+   made with utils/genromfs.
+
+   A directory of test files is written to a temporary directory, and made
+   into a plain image and packed ones with several block sizes. Every file
+   is then read back through the driver in chunks of various sizes and at
+   random offsets, and compared to what was written. The sizes reported by
+   total(), stat() and readdir(), mmap(), a damaged block and a corrupt
+   block table are checked too.
+
+   The benchmark (-b) reads a few megabytes of files sequentially and at
+   random offsets from the plain and the packed images, and reports the
+   throughput of each.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <kos/fs_romdisk.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static const char *genromfs = "../genromfs/genromfs";
+static char tmpdir[] = "/tmp/romdisktestXXXXXX";
+
+/* Test files: their contents are generated, written to the source directory,
+   and kept to compare against. */
+typedef enum {
+    DATA_TEXT,                  /* words, compresses well */
+    DATA_RANDOM,                /* doesn't compress at all */
+    DATA_RUNS,                  /* long runs of the same bytes */
+    DATA_RAMP,                  /* 16-bit samples with a little noise */
+    DATA_MIXED                  /* text and random, by the kilobyte */
+} data_t;
+
+typedef struct {
+    const char *name;
+    data_t type;
+    size_t size;
+    uint8_t *data;
+} tfile_t;
+
+static tfile_t files[] = {
+    { "empty",              DATA_TEXT,    0, NULL },
+    { "tiny.txt",           DATA_TEXT,    13, NULL },
+    { "text.txt",           DATA_TEXT,    100000, NULL },
+    { "random.bin",         DATA_RANDOM,  50000, NULL },
+    { "runs.bin",           DATA_RUNS,    70000, NULL },
+    { "ramp.raw",           DATA_RAMP,    65536, NULL },
+    { "block.txt",          DATA_TEXT,    4096, NULL },
+    { "block1.txt",         DATA_TEXT,    4097, NULL },
+    { "sub/nested.txt",     DATA_TEXT,    20000, NULL },
+    { "sub/deeper/mix.bin", DATA_MIXED,   300000, NULL },
+    { "keep.txt",           DATA_TEXT,    30000, NULL }
+};
+
+#define NFILES (sizeof(files) / sizeof(files[0]))
+
+static const char *words[] = {
+    "the", "romdisk", "of", "a", "file", "block", "to", "and", "is", "Dreamcast",
+    "texture", "in", "sound", "for", "with", "it", "that", "KallistiOS", "data",
+    "on", "mount", "read", "cache", "image", "level", "player", "sprite", "\n"
+};
+
+static uint32_t rng = 1;
+
+static uint32_t rnd(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void fill(uint8_t *p, size_t size, data_t type) {
+    size_t i = 0, n;
+    const char *w;
+
+    switch(type) {
+        case DATA_TEXT:
+            while(i < size) {
+                w = words[rnd() % (sizeof(words) / sizeof(words[0]))];
+
+                for(; *w && i < size; w++)
+                    p[i++] = *w;
+
+                if(i < size)
+                    p[i++] = ' ';
+            }
+
+            break;
+
+        case DATA_RANDOM:
+            for(; i < size; i++)
+                p[i] = rnd();
+
+            break;
+
+        case DATA_RUNS:
+            while(i < size) {
+                uint8_t c = rnd();
+
+                for(n = rnd() % 3000 + 1; n && i < size; n--)
+                    p[i++] = c;
+            }
+
+            break;
+
+        case DATA_RAMP:
+            for(; i + 1 < size; i += 2) {
+                uint16_t s = (uint16_t)(i * 3 + (rnd() & 7));
+
+                p[i] = s;
+                p[i + 1] = s >> 8;
+            }
+
+            break;
+
+        case DATA_MIXED:
+            for(; i < size; i += 1024) {
+                n = size - i < 1024 ? size - i : 1024;
+                fill(p + i, n, (i / 1024) % 3 ? DATA_TEXT : DATA_RANDOM);
+            }
+
+            break;
+    }
+}
+
+static void write_file(const char *dir, const char *name, const uint8_t *data,
+                       size_t size) {
+    char path[512], cmd[600], *slash;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    if((slash = strrchr(path, '/')) != NULL) {
+        *slash = 0;
+        snprintf(cmd, sizeof(cmd), "mkdir -p '%s'", path);
+
+        if(system(cmd)) {
+            fprintf(stderr, "can't create %s\n", path);
+            exit(1);
+        }
+
+        *slash = '/';
+    }
+
+    if(!(f = fopen(path, "wb")) || fwrite(data, 1, size, f) != size) {
+        fprintf(stderr, "can't write %s\n", path);
+        exit(1);
+    }
+
+    fclose(f);
+}
+
+/* Run genromfs on dir with the given extra options, and load the image */
+static uint8_t *make_image(const char *dir, const char *opts, size_t *size) {
+    char img[512], cmd[1024];
+    uint8_t *data;
+    FILE *f;
+    long len;
+
+    snprintf(img, sizeof(img), "%s/image.rom", tmpdir);
+    snprintf(cmd, sizeof(cmd), "'%s' -f '%s' -d '%s' -V test %s", genromfs,
+             img, dir, opts);
+
+    if(system(cmd)) {
+        fprintf(stderr, "%s failed\n", cmd);
+        exit(1);
+    }
+
+    if(!(f = fopen(img, "rb"))) {
+        perror(img);
+        exit(1);
+    }
+
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(len);
+
+    if(!data || fread(data, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "can't read %s\n", img);
+        exit(1);
+    }
+
+    fclose(f);
+    unlink(img);
+    *size = len;
+    return data;
+}
+
+/* The name manager, which only needs to find mounted romdisks */
+#define MAX_MOUNTS 8
+
+static nmmgr_handler_t *mounts[MAX_MOUNTS];
+
+int nmmgr_handler_add(nmmgr_handler_t *hnd) {
+    int i;
+
+    for(i = 0; i < MAX_MOUNTS; i++) {
+        if(!mounts[i]) {
+            mounts[i] = hnd;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int nmmgr_handler_remove(nmmgr_handler_t *hnd) {
+    int i;
+
+    for(i = 0; i < MAX_MOUNTS; i++) {
+        if(mounts[i] == hnd) {
+            mounts[i] = NULL;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static vfs_handler_t *find_mount(const char *mountpoint) {
+    int i;
+
+    for(i = 0; i < MAX_MOUNTS; i++) {
+        if(mounts[i] && !strcmp(mounts[i]->pathname, mountpoint))
+            return (vfs_handler_t *)mounts[i];
+    }
+
+    return NULL;
+}
+
+static vfs_handler_t *mount_image(const char *dir, const char *opts,
+                                  const char *mountpoint, size_t *size) {
+    uint8_t *img = make_image(dir, opts, size);
+
+    if(fs_romdisk_mount(mountpoint, img, 1)) {
+        fprintf(stderr, "can't mount the image made with '%s'\n", opts);
+        exit(1);
+    }
+
+    return find_mount(mountpoint);
+}
+
+static void *open_file(vfs_handler_t *vfs, const char *name) {
+    char path[512];
+
+    snprintf(path, sizeof(path), "/%s", name);
+    return vfs->open(vfs, path, O_RDONLY);
+}
+
+/* Read the whole file chunk bytes at a time */
+static void test_sequential(vfs_handler_t *vfs, const tfile_t *tf, size_t chunk,
+                            const char *what) {
+    uint8_t *buf = malloc(tf->size + chunk);
+    void *h = open_file(vfs, tf->name);
+    size_t pos = 0;
+    ssize_t rv;
+
+    CHECK(h != NULL, "%s: can't open %s", what, tf->name);
+
+    while((rv = vfs->read(h, buf + pos, chunk)) > 0)
+        pos += rv;
+
+    vfs->close(h);
+
+    if(rv < 0 || pos != tf->size || memcmp(buf, tf->data, tf->size)) {
+        free(buf);
+        CHECK(0, "%s: %s read in %zu byte chunks is wrong (got %zu of %zu bytes)",
+              what, tf->name, chunk, pos, tf->size);
+    }
+
+    free(buf);
+}
+
+/* Seek around and read bits of the file */
+static void test_random(vfs_handler_t *vfs, const tfile_t *tf, const char *what) {
+    uint8_t buf[10000];
+    void *h = open_file(vfs, tf->name);
+    size_t pos, len, want;
+    ssize_t rv;
+    int i;
+
+    CHECK(h != NULL, "%s: can't open %s", what, tf->name);
+
+    for(i = 0; i < 200; i++) {
+        pos = tf->size ? rnd() % (tf->size + 10) : 0;
+        len = rnd() % (i & 1 ? 100 : sizeof(buf));
+
+        if(pos > tf->size)
+            pos = tf->size;
+
+        want = tf->size - pos < len ? tf->size - pos : len;
+
+        if(vfs->seek(h, pos, SEEK_SET) != (off_t)pos) {
+            vfs->close(h);
+            CHECK(0, "%s: can't seek to %zu in %s", what, pos, tf->name);
+        }
+
+        rv = vfs->read(h, buf, len);
+
+        if(rv != (ssize_t)want || memcmp(buf, tf->data + pos, want) ||
+           vfs->tell(h) != (off_t)(pos + want)) {
+            vfs->close(h);
+            CHECK(0, "%s: reading %zu bytes at %zu of %s is wrong", what, len,
+                  pos, tf->name);
+        }
+    }
+
+    vfs->close(h);
+}
+
+static void test_sizes(vfs_handler_t *vfs, const tfile_t *tf, const char *what) {
+    char path[512];
+    struct stat st;
+    void *h = open_file(vfs, tf->name);
+    size_t total;
+
+    CHECK(h != NULL, "%s: can't open %s", what, tf->name);
+    total = vfs->total(h);
+    vfs->close(h);
+    CHECK(total == tf->size, "%s: total() of %s is %zu, not %zu", what,
+          tf->name, total, tf->size);
+
+    snprintf(path, sizeof(path), "/%s", tf->name);
+    CHECK(vfs->stat(vfs, path, &st, 0) == 0, "%s: can't stat %s", what, tf->name);
+    CHECK(st.st_size == (off_t)tf->size, "%s: stat() size of %s is %lld, not %zu",
+          what, tf->name, (long long)st.st_size, tf->size);
+}
+
+static void test_readdir(vfs_handler_t *vfs, const char *what) {
+    void *h = vfs->open(vfs, "/", O_RDONLY | O_DIR);
+    dirent_t *d;
+    size_t i;
+    int seen = 0, want = 0;
+
+    for(i = 0; i < NFILES; i++) {
+        if(!strchr(files[i].name, '/'))
+            want++;
+    }
+
+    CHECK(h != NULL, "%s: can't open the root directory", what);
+
+    while((d = vfs->readdir(h)) != NULL) {
+        for(i = 0; i < NFILES; i++) {
+            if(strcmp(d->name, files[i].name))
+                continue;
+
+            seen++;
+
+            if(d->size != (int)files[i].size) {
+                vfs->close(h);
+                CHECK(0, "%s: readdir() size of %s is %d, not %zu", what,
+                      d->name, d->size, files[i].size);
+            }
+        }
+    }
+
+    vfs->close(h);
+    CHECK(seen == want, "%s: readdir() found %d of the %d files in /", what,
+          seen, want);
+}
+
+/* Only files that were packed can't be mmap()ed */
+static void test_mmap(vfs_handler_t *vfs, const tfile_t *tf, int packed,
+                      const char *what) {
+    void *h = open_file(vfs, tf->name);
+    void *p;
+
+    CHECK(h != NULL, "%s: can't open %s", what, tf->name);
+    errno = 0;
+    p = vfs->mmap(h);
+    vfs->close(h);
+
+    if(packed) {
+        CHECK(p == NULL && errno == ENOTSUP, "%s: mmap() of packed %s worked",
+              what, tf->name);
+    }
+    else {
+        CHECK(p != NULL && !memcmp(p, tf->data, tf->size),
+              "%s: mmap() of %s is wrong", what, tf->name);
+    }
+}
+
+static void test_image(const char *dir, const char *opts, const char *what) {
+    vfs_handler_t *vfs;
+    size_t i, img_size;
+    static const size_t chunks[] = { 1, 7, 100, 512, 4096, 5000, 65536 };
+    size_t c;
+
+    vfs = mount_image(dir, opts, "/rd", &img_size);
+
+    for(i = 0; i < NFILES; i++) {
+        for(c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+            test_sequential(vfs, &files[i], chunks[c], what);
+
+        test_sequential(vfs, &files[i], files[i].size + 1, what);
+        test_random(vfs, &files[i], what);
+        test_sizes(vfs, &files[i], what);
+    }
+
+    test_readdir(vfs, what);
+
+    /* Text always shrinks, random data never does, and keep.txt is left as it
+       is when packing, by -Z */
+    test_mmap(vfs, &files[2], *opts != 0, what);
+    test_mmap(vfs, &files[3], 0, what);
+    test_mmap(vfs, &files[10], 0, what);
+
+    fs_romdisk_unmount("/rd");
+}
+
+/* A broken block must give an error rather than bad data */
+static void test_damaged(const char *dir) {
+    vfs_handler_t *vfs;
+    uint8_t buf[4096], *img;
+    size_t img_size, i, n;
+    void *h;
+    ssize_t rv;
+
+    img = make_image(dir, "-z", &img_size);
+    CHECK(fs_romdisk_mount("/rd", img, 1) == 0, "can't mount the packed image");
+    vfs = find_mount("/rd");
+    h = open_file(vfs, "text.txt");
+    CHECK(h != NULL, "can't open text.txt");
+    rv = vfs->read(h, buf, sizeof(buf));
+    CHECK(rv == sizeof(buf) && !memcmp(buf, files[2].data, sizeof(buf)),
+          "text.txt is wrong before damaging it");
+
+    /* Find the pack header of text.txt, and scribble over the start of its
+       first block */
+    for(i = 0; i + 8 < img_size; i++) {
+        if(!memcmp(img + i, "RDZ1", 4) &&
+           !memcmp(img + i + 4, "\0\x01\x86\xa0", 4))
+            break;
+    }
+
+    CHECK(i + 8 < img_size, "can't find the pack header of text.txt");
+    n = (img[i + 16] << 24 | img[i + 17] << 16 | img[i + 18] << 8 | img[i + 19]);
+    memset(img + i + n, 0xf0, 64);
+
+    vfs->seek(h, 0, SEEK_SET);
+    errno = 0;
+    rv = vfs->read(h, buf, sizeof(buf));
+    CHECK(rv == -1 && errno == EIO, "damaged whole block read gave %zd", rv);
+
+    /* Through the cache too */
+    vfs->seek(h, 10, SEEK_SET);
+    errno = 0;
+    rv = vfs->read(h, buf, 100);
+    CHECK(rv == -1 && errno == EIO, "damaged partial block read gave %zd", rv);
+
+    /* The next block is still fine, and a read that runs into the damage
+       stops short */
+    vfs->seek(h, 4096, SEEK_SET);
+    rv = vfs->read(h, buf, sizeof(buf));
+    CHECK(rv == sizeof(buf) && !memcmp(buf, files[2].data + 4096, sizeof(buf)),
+          "the block after the damaged one is wrong");
+
+    vfs->close(h);
+    fs_romdisk_unmount("/rd");
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* A block table that points outside of the file must be refused on open */
+static void test_corrupt_table(const char *dir) {
+    vfs_handler_t *vfs;
+    uint8_t *img, save[4];
+    size_t img_size, i;
+    void *h;
+
+    img = make_image(dir, "-z", &img_size);
+    CHECK(fs_romdisk_mount("/rd", img, 1) == 0, "can't mount the packed image");
+    vfs = find_mount("/rd");
+
+    /* Find the pack header of text.txt */
+    for(i = 0; i + 8 < img_size; i++) {
+        if(!memcmp(img + i, "RDZ1", 4) &&
+           !memcmp(img + i + 4, "\0\x01\x86\xa0", 4))
+            break;
+    }
+
+    CHECK(i + 8 < img_size, "can't find the pack header of text.txt");
+
+    /* The end of the first block, far past the end of the file */
+    memcpy(save, img + i + 20, 4);
+    put32(img + i + 20, 0x7ffffff0);
+    errno = 0;
+    h = open_file(vfs, "text.txt");
+    CHECK(h == NULL && errno == EIO, "out of range block offset wasn't refused");
+    memcpy(img + i + 20, save, 4);
+
+    /* A block count that doesn't match the unpacked size */
+    memcpy(save, img + i + 12, 4);
+    put32(img + i + 12, 0x40000000);
+    errno = 0;
+    h = open_file(vfs, "text.txt");
+    CHECK(h == NULL && errno == EIO, "wrong block count wasn't refused");
+    memcpy(img + i + 12, save, 4);
+
+    /* Put back, it opens again, and the other files were never affected */
+    h = open_file(vfs, "text.txt");
+    CHECK(h != NULL, "can't open text.txt after repairing it");
+    vfs->close(h);
+
+    h = open_file(vfs, "runs.bin");
+    CHECK(h != NULL, "can't open runs.bin");
+    vfs->close(h);
+
+    fs_romdisk_unmount("/rd");
+}
+
+static void make_files(const char *dir) {
+    size_t i;
+
+    for(i = 0; i < NFILES; i++) {
+        files[i].data = malloc(files[i].size + 1);
+        fill(files[i].data, files[i].size, files[i].type);
+        write_file(dir, files[i].name, files[i].data, files[i].size);
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH_FILES 4
+#define BENCH_SIZE  (1024 * 1024)
+
+/* Read every benchmark file through in chunk byte reads, or make random
+   reads of chunk bytes, for about the given time. Returns MB/s. */
+static double bench_read(vfs_handler_t *vfs, size_t chunk, int seq,
+                         double seconds) {
+    static uint8_t buf[65536];
+    char name[32];
+    double start = now(), t;
+    size_t bytes = 0;
+    void *h;
+    ssize_t rv;
+    int i, n;
+
+    do {
+        for(i = 0; i < BENCH_FILES; i++) {
+            snprintf(name, sizeof(name), "bench%d.dat", i);
+            h = open_file(vfs, name);
+
+            if(seq) {
+                while((rv = vfs->read(h, buf, chunk)) > 0)
+                    bytes += rv;
+            }
+            else {
+                for(n = 0; n < 256; n++) {
+                    vfs->seek(h, rnd() % (BENCH_SIZE - chunk), SEEK_SET);
+                    bytes += vfs->read(h, buf, chunk);
+                }
+            }
+
+            vfs->close(h);
+        }
+    } while((t = now() - start) < seconds);
+
+    return bytes / t / (1024 * 1024);
+}
+
+static void bench(double seconds) {
+    static const struct {
+        const char *what, *opts;
+    } images[] = {
+        { "plain",           "" },
+        { "packed, 4KB",     "-z" },
+        { "packed, 16KB",    "-z -b 16384" }
+    };
+    static const struct {
+        size_t chunk;
+        int seq;
+    } reads[] = {
+        { 65536, 1 }, { 4096, 1 }, { 256, 1 }, { 4096, 0 }, { 256, 0 }
+    };
+    char dir[512], name[32];
+    vfs_handler_t *vfs;
+    size_t i, r, img_size;
+    uint8_t *data = malloc(BENCH_SIZE);
+    int f;
+
+    snprintf(dir, sizeof(dir), "%s/bench", tmpdir);
+
+    for(f = 0; f < BENCH_FILES; f++) {
+        snprintf(name, sizeof(name), "bench%d.dat", f);
+        fill(data, BENCH_SIZE, f & 1 ? DATA_MIXED : DATA_TEXT);
+        write_file(dir, name, data, BENCH_SIZE);
+    }
+
+    free(data);
+
+    printf("%d files of %d KB, text and text mixed with random data\n",
+           BENCH_FILES, BENCH_SIZE / 1024);
+
+    for(i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+        vfs = mount_image(dir, images[i].opts, "/bench", &img_size);
+        printf("%-13s image of %7zu KB:", images[i].what, img_size / 1024);
+
+        for(r = 0; r < sizeof(reads) / sizeof(reads[0]); r++) {
+            printf("  %s %5zu %7.1f MB/s", reads[r].seq ? "seq" : "rnd",
+                   reads[r].chunk, bench_read(vfs, reads[r].chunk, reads[r].seq,
+                                              seconds / 5));
+        }
+
+        printf("\n");
+        fs_romdisk_unmount("/bench");
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b] [-t seconds] [-g genromfs]\n\n"
+            "  -b  run the benchmark instead of the tests\n"
+            "  -t  duration of the benchmark, per image (default 1)\n"
+            "  -g  genromfs to make the images with (default %s)\n",
+            prog, genromfs);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    char dir[512], cmd[600];
+    int c, do_bench = 0;
+
+    while((c = getopt(argc, argv, "bt:g:")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            case 't':
+                seconds = strtod(optarg, NULL);
+                break;
+            case 'g':
+                genromfs = optarg;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(!mkdtemp(tmpdir)) {
+        perror(tmpdir);
+        return 1;
+    }
+
+    fs_romdisk_init();
+
+    if(do_bench) {
+        bench(seconds);
+    }
+    else {
+        snprintf(dir, sizeof(dir), "%s/files", tmpdir);
+        make_files(dir);
+
+        test_image(dir, "", "plain");
+        test_image(dir, "-z -Z keep.txt", "packed 4KB");
+        test_image(dir, "-z -b 512 -Z keep.txt", "packed 512B");
+        test_image(dir, "-z -b 65536 -Z keep.txt", "packed 64KB");
+        test_damaged(dir);
+        test_corrupt_table(dir);
+    }
+
+    fs_romdisk_shutdown();
+
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", tmpdir);
+
+    if(system(cmd))
+        fprintf(stderr, "can't remove %s\n", tmpdir);
+
+    if(do_bench)
+        return 0;
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,435 @@
+/* KallistiOS ##version##
+
+   sndmixtest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the software mixer, whose portable core in
+   kernel/arch/dreamcast/sound/snd_mixer_core.c is built as-is on the host.
+
+   The tests check that a voice played at its own rate with full volume is
+   passed through bit-exactly, that ADPCM samples decode the same way as with
+   wav2adpcm (including across loops), that resampled sines stay close to the
+   ideal signal, and that panning, master volume and voice handles behave.
+
+   The benchmark (-b) mixes a number of voices at a slightly off pitch, with
+   both interpolation modes, and reports the time per voice and output frame.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dc/sound/mixer.h>
+
+#define RATE    44100
+#define LEN     4096
+
+#define BENCH_FRAMES    1024
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill_noise(int16_t *buf, size_t count) {
+    size_t i;
+
+    for(i = 0; i < count; i++)
+        buf[i] = (int16_t)(rand() - RAND_MAX / 2);
+}
+
+static snd_mixer_sample_t make_sample(const void *data, uint32_t length,
+                                      uint32_t rate, snd_mixer_format_t fmt,
+                                      int channels) {
+    snd_mixer_sample_t smp = {
+        .data = data,
+        .length = length,
+        .rate = rate,
+        .format = fmt,
+        .channels = channels
+    };
+
+    return smp;
+}
+
+/* Reference decoder, from utils/wav2adpcm */
+#define CLAMP(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+static int16_t ymz_step(uint8_t step, int16_t *history, int16_t *step_size) {
+    static const int step_table[8] = {
+        230, 230, 230, 230, 307, 409, 512, 614
+    };
+
+    int sign = step & 8;
+    int delta = step & 7;
+    int diff = ((1 + (delta << 1)) * *step_size) >> 3;
+    int newval = *history;
+    int nstep = (step_table[delta] * *step_size) >> 8;
+
+    diff = CLAMP(diff, 0, 32767);
+    if(sign > 0)
+        newval -= diff;
+    else
+        newval += diff;
+
+    *step_size = CLAMP(nstep, 127, 24576);
+    *history = newval = CLAMP(newval, -32768, 32767);
+    return newval;
+}
+
+static int16_t ymz_decode(const uint8_t *data, size_t i, int16_t *history,
+                          int16_t *step_size) {
+    *history = *history * 254 / 256;
+    return ymz_step((data[i >> 1] >> ((i & 1) * 4)) & 15, history, step_size);
+}
+
+static void test_unity(snd_mixer_interp_t interp) {
+    static int16_t in[LEN], out[(LEN + 1) * 2];
+    snd_mixer_sample_t smp = make_sample(in, LEN, RATE, SND_MIXER_PCM16, 1);
+    snd_mixer_t *m = snd_mixer_create(4, RATE);
+    snd_mixer_voice_t v;
+    size_t i;
+
+    fill_noise(in, LEN);
+    snd_mixer_set_interp(m, interp);
+
+    v = snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    CHECK(v != SND_MIXER_INVALID, "play failed");
+
+    snd_mixer_render(m, out, LEN);
+    CHECK(snd_mixer_playing(m, v), "voice stopped early");
+
+    snd_mixer_render(m, out + LEN * 2, 1);
+    CHECK(!snd_mixer_playing(m, v), "voice didn't stop");
+    CHECK(!snd_mixer_voices_playing(m), "voices still playing");
+
+    for(i = 0; i < LEN; i++) {
+        CHECK(out[i * 2] == in[i] && out[i * 2 + 1] == in[i],
+              "frame %zu: %d/%d instead of %d (interp %d)",
+              i, out[i * 2], out[i * 2 + 1], in[i], interp);
+    }
+
+    CHECK(!out[LEN * 2] && !out[LEN * 2 + 1], "output after the end");
+
+    snd_mixer_destroy(m);
+}
+
+static void test_pcm8_stereo(void) {
+    static int8_t in[LEN * 2];
+    static int16_t out[LEN * 2];
+    snd_mixer_sample_t smp = make_sample(in, LEN, RATE, SND_MIXER_PCM8, 2);
+    snd_mixer_t *m = snd_mixer_create(4, RATE);
+    size_t i;
+
+    for(i = 0; i < LEN * 2; i++)
+        in[i] = (int8_t)rand();
+
+    snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    snd_mixer_render(m, out, LEN);
+
+    for(i = 0; i < LEN * 2; i++)
+        CHECK(out[i] == in[i] * 256, "sample %zu: %d instead of %d",
+              i, out[i], in[i] * 256);
+
+    snd_mixer_destroy(m);
+}
+
+static void test_adpcm(void) {
+    static uint8_t in[LEN / 2];
+    static int16_t out[LEN * 3 * 2];
+    const size_t loop_start = 1000;
+    snd_mixer_sample_t smp = make_sample(in, LEN, RATE, SND_MIXER_ADPCM, 1);
+    snd_mixer_t *m = snd_mixer_create(4, RATE);
+    int16_t hist = 0, step = 127, loop_hist = 0, loop_step = 0, ref;
+    size_t i, pos = 0;
+
+    for(i = 0; i < LEN / 2; i++)
+        in[i] = (uint8_t)rand();
+
+    smp.loop_start = loop_start;
+    smp.loop_end = LEN;
+
+    snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    snd_mixer_render(m, out, LEN * 3);
+
+    for(i = 0; i < LEN * 3; i++) {
+        if(pos == LEN) {
+            pos = loop_start;
+            hist = loop_hist;
+            step = loop_step;
+        }
+
+        if(i == loop_start) {
+            loop_hist = hist;
+            loop_step = step;
+        }
+
+        ref = ymz_decode(in, pos++, &hist, &step);
+
+        CHECK(out[i * 2] == ref, "frame %zu: %d instead of %d",
+              i, out[i * 2], ref);
+    }
+
+    snd_mixer_destroy(m);
+}
+
+static void test_loop(void) {
+    static int16_t in[LEN], out[LEN * 4 * 2];
+    snd_mixer_sample_t smp = make_sample(in, LEN, RATE, SND_MIXER_PCM16, 1);
+    snd_mixer_t *m = snd_mixer_create(4, RATE);
+    size_t i;
+
+    fill_noise(in, LEN);
+    smp.loop_start = 100;
+    smp.loop_end = LEN - 100;
+
+    snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    snd_mixer_render(m, out, LEN * 4);
+    CHECK(snd_mixer_voices_playing(m) == 1, "looping voice stopped");
+
+    for(i = smp.loop_end; i < LEN * 4; i++) {
+        CHECK(out[i * 2] == in[smp.loop_start + (i - smp.loop_end) %
+                               (smp.loop_end - smp.loop_start)],
+              "frame %zu doesn't follow the loop", i);
+    }
+
+    snd_mixer_destroy(m);
+}
+
+/* Play a sine at one rate, mix it at another, and return the SNR of the
+   output against the ideal sine, in dB. */
+static double sine_snr(snd_mixer_interp_t interp, unsigned int in_rate,
+                       unsigned int out_rate, double freq) {
+    static int16_t in[LEN * 4], out[LEN * 2];
+    snd_mixer_sample_t smp = make_sample(in, LEN * 4, in_rate,
+                                         SND_MIXER_PCM16, 1);
+    snd_mixer_t *m = snd_mixer_create(1, out_rate);
+    /* The step between output frames is truncated to 16.16 fixed point, so
+       the reference has to use the same one to stay in phase. */
+    double step = floor(65536.0 * in_rate / out_rate) / 65536.0;
+    double sig = 0.0, err = 0.0, ref;
+    size_t i;
+
+    for(i = 0; i < LEN * 4; i++)
+        in[i] = (int16_t)lrint(16000.0 * sin(2 * M_PI * freq * i / in_rate));
+
+    snd_mixer_set_interp(m, interp);
+    snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    snd_mixer_render(m, out, LEN);
+
+    /* Skip the start, where the filter sees the zeros before the sample */
+    for(i = 16; i < LEN; i++) {
+        ref = 16000.0 * sin(2 * M_PI * freq * i * step / in_rate);
+        sig += ref * ref;
+        err += (out[i * 2] - ref) * (out[i * 2] - ref);
+    }
+
+    snd_mixer_destroy(m);
+
+    return 10.0 * log10(sig / err);
+}
+
+static void test_resample(void) {
+    static const struct {
+        unsigned int in_rate, out_rate;
+        double freq;
+    } cases[] = {
+        { 22050, 44100, 1000.0 },
+        { 22050, 44100, 5000.0 },
+        { 44100, 32000, 3000.0 },
+        { 11025, 44100, 2000.0 },
+    };
+    double lin, poly;
+    size_t i;
+
+    for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        lin = sine_snr(SND_MIXER_LINEAR, cases[i].in_rate,
+                       cases[i].out_rate, cases[i].freq);
+        poly = sine_snr(SND_MIXER_POLYPHASE, cases[i].in_rate,
+                        cases[i].out_rate, cases[i].freq);
+
+        printf("%5u -> %5u Hz, %4.0f Hz sine: linear %5.1f dB, "
+               "polyphase %5.1f dB\n", cases[i].in_rate, cases[i].out_rate,
+               cases[i].freq, lin, poly);
+
+        CHECK(lin > 10.0, "linear SNR too low");
+        CHECK(poly > lin + 10.0, "polyphase not better than linear");
+    }
+}
+
+static void test_volume(void) {
+    static int16_t in[LEN], out[LEN * 2];
+    snd_mixer_sample_t smp = make_sample(in, LEN, RATE, SND_MIXER_PCM16, 1);
+    snd_mixer_t *m = snd_mixer_create(2, RATE);
+    snd_mixer_voice_t v;
+    size_t i;
+
+    for(i = 0; i < LEN; i++)
+        in[i] = 30000;
+
+    /* Hard left, then hard right */
+    v = snd_mixer_play(m, &smp, 255, 0, SND_MIXER_PITCH_NORMAL);
+    snd_mixer_render(m, out, 1);
+    CHECK(out[0] == 30000 && out[1] == 0, "pan left: %d/%d", out[0], out[1]);
+
+    snd_mixer_set_voice_volume(m, v, 255, 255);
+    snd_mixer_render(m, out, 1);
+    CHECK(out[0] == 0 && out[1] == 30000, "pan right: %d/%d", out[0], out[1]);
+
+    /* Two voices clip, and the master volume scales the sum */
+    snd_mixer_set_voice_volume(m, v, 255, 128);
+    snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    snd_mixer_render(m, out, 1);
+    CHECK(out[0] == 32767, "no clipping: %d", out[0]);
+
+    snd_mixer_set_volume(m, 127);
+    snd_mixer_render(m, out, 1);
+    CHECK(out[0] == (60000 * 127) >> 8, "master volume: %d", out[0]);
+
+    snd_mixer_set_volume(m, 0);
+    snd_mixer_render(m, out, 1);
+    CHECK(out[0] == 0 && out[1] == 0, "master volume 0: %d", out[0]);
+
+    snd_mixer_destroy(m);
+}
+
+static void test_handles(void) {
+    static int16_t in[LEN];
+    snd_mixer_sample_t smp = make_sample(in, LEN, RATE, SND_MIXER_PCM16, 1);
+    snd_mixer_t *m = snd_mixer_create(2, RATE);
+    snd_mixer_voice_t a, b, c;
+
+    a = snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    b = snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    c = snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    CHECK(a >= 0 && b >= 0 && a != b, "play failed");
+    CHECK(c == SND_MIXER_INVALID, "more voices than allocated");
+
+    snd_mixer_stop(m, a);
+    CHECK(!snd_mixer_playing(m, a), "stopped voice still playing");
+
+    c = snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL);
+    CHECK(c >= 0 && c != a, "slot reused with the same handle");
+
+    /* The stale handle must not touch the new voice */
+    snd_mixer_stop(m, a);
+    CHECK(snd_mixer_playing(m, c), "stale handle stopped a new voice");
+
+    smp.format = SND_MIXER_ADPCM;
+    smp.channels = 2;
+    snd_mixer_stop_all(m);
+    CHECK(snd_mixer_play(m, &smp, 255, 128, SND_MIXER_PITCH_NORMAL) ==
+          SND_MIXER_INVALID, "stereo ADPCM accepted");
+
+    snd_mixer_destroy(m);
+}
+
+static void bench(unsigned int voices, double seconds) {
+    static const char *names[] = { "linear", "polyphase" };
+    static int16_t in[RATE], out[BENCH_FRAMES * 2];
+    snd_mixer_sample_t smp = make_sample(in, RATE, RATE, SND_MIXER_PCM16, 1);
+    snd_mixer_t *m;
+    size_t frames;
+    double start, elapsed;
+    unsigned int i;
+    int interp;
+
+    fill_noise(in, RATE);
+    smp.loop_end = RATE;
+
+    for(interp = SND_MIXER_LINEAR; interp <= SND_MIXER_POLYPHASE; interp++) {
+        m = snd_mixer_create(voices, RATE);
+        snd_mixer_set_interp(m, interp);
+
+        for(i = 0; i < voices; i++)
+            snd_mixer_play(m, &smp, 200, i * 255 / voices,
+                           SND_MIXER_PITCH_NORMAL + 1000 * i);
+
+        frames = 0;
+        start = now();
+
+        do {
+            snd_mixer_render(m, out, BENCH_FRAMES);
+            frames += BENCH_FRAMES;
+            elapsed = now() - start;
+        } while(elapsed < seconds);
+
+        printf("%-9s %u voices: %6.2f ns per voice-frame, "
+               "%.1f%% of real time\n", names[interp], voices,
+               elapsed * 1e9 / frames / voices,
+               elapsed * 100.0 * RATE / frames);
+
+        snd_mixer_destroy(m);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b] [-v voices] [-t seconds]\n\n"
+            "  -b  run the benchmark instead of the tests\n"
+            "  -v  number of voices of the benchmark (default 32)\n"
+            "  -t  duration of each benchmark run (default 1)\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    unsigned int voices = 32;
+    double seconds = 1.0;
+    int c, do_bench = 0;
+
+    while((c = getopt(argc, argv, "bv:t:")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            case 'v':
+                voices = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                seconds = strtod(optarg, NULL);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(do_bench) {
+        bench(voices, seconds);
+        return 0;
+    }
+
+    srand(1);
+
+    test_unity(SND_MIXER_LINEAR);
+    test_unity(SND_MIXER_POLYPHASE);
+    test_pcm8_stereo();
+    test_adpcm();
+    test_loop();
+    test_resample();
+    test_volume();
+    test_handles();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
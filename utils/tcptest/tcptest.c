@@ -0,0 +1,831 @@
+/* KallistiOS ##version##
+
+   tcptest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the receive and send paths in
+   kernel/net/net_tcp.c, which is built as-is on the host. The IP layer
+   underneath it is replaced by a queue of the segments the socket sends, and
+   the other end of the connection is played by the test, which builds its
+   own segments and feeds them to the TCP input path. The clock is the test's
+   too, so the delayed ACK and retransmission timers go off exactly when it
+   says.
+
+   The tests check that segments arriving out of order, duplicated, partly
+   old, or lost and resent, come out of the socket as the stream that was
+   sent, that only every second in-order segment is ACKed straight away and
+   a lone one is ACKed when the delayed ACK timer goes off, that anything out
+   of order gets an immediate duplicate ACK, and that small writes wait for
+   an ACK unless TCP_NODELAY is set. They also check the data and checksums
+   of segments sent from a send buffer that keeps wrapping around at odd
+   offsets. The benchmark (-b) counts the ACKs sent for a bulk transfer and
+   the segments sent for a run of small writes.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <kos/net.h>
+#include <kos/cond.h>
+#include <kos/fs_socket.h>
+#include <arch/timer.h>
+
+#include "../../kernel/net/net_ipv4.h"
+#include "../../kernel/net/net_ipv6.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* These match net_tcp.c */
+#define FLAG_SYN    0x02
+#define FLAG_RST    0x04
+#define FLAG_ACK    0x10
+#define DELACK_MS   100
+#define RTTO_MS     2000
+#define WINDOW      8192
+
+#define MSS         1460
+#define SEG         (MSS - 20)
+#define PEER_PORT   4000
+
+/* What net_tcp.c needs from the rest of the kernel */
+
+const struct in6_addr in6addr_any = IN6ADDR_ANY_INIT;
+const struct in6_addr in6addr_loopback = IN6ADDR_LOOPBACK_INIT;
+
+static netif_t loop_if = { .name = "lo", .ip_addr = { 127, 0, 0, 1 } };
+netif_t *net_default_dev = &loop_if;
+
+static fs_socket_proto_t *tcp_proto;
+static void (*tcp_tick)(void *);
+static uint64 clock_ms = 1000;
+
+uint64 timer_ms_gettime64(void) {
+    return clock_ms;
+}
+
+uint64 timer_us_gettime64(void) {
+    return clock_ms * 1000;
+}
+
+void thd_pass(void) {
+    sched_yield();
+}
+
+int fs_close(file_t hnd) {
+    (void)hnd;
+    return 0;
+}
+
+uint32_t htonl(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+uint32_t ntohl(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+uint16_t htons(uint16_t value) {
+    return __builtin_bswap16(value);
+}
+
+uint16_t ntohs(uint16_t value) {
+    return __builtin_bswap16(value);
+}
+
+uint32 net_ipv4_address(const uint8 addr[4]) {
+    return (addr[0] << 24) | (addr[1] << 16) | (addr[2] << 8) | addr[3];
+}
+
+/* A plain RFC 1071 checksum, summing 16-bit words in memory order like the
+   real one does. The pseudo-header just depends on the length, which is
+   enough to catch a segment's checksum covering the wrong bytes. */
+static uint32_t sum_words(const uint8_t *data, size_t bytes, uint32_t sum) {
+    uint16_t w;
+    size_t i;
+
+    for(i = 0; i + 1 < bytes; i += 2) {
+        memcpy(&w, data + i, 2);
+        sum += w;
+    }
+
+    if(i < bytes) {
+        w = 0;
+        memcpy(&w, data + i, 1);
+        sum += w;
+    }
+
+    while(sum >> 16)
+        sum = (sum >> 16) + (sum & 0xFFFF);
+
+    return sum;
+}
+
+uint16 net_ipv4_checksum(const uint8 *data, size_t bytes, uint16 start) {
+    return sum_words(data, bytes, start) ^ 0xFFFF;
+}
+
+uint16 net_ipv4_checksum_copy(uint8 *dst, const uint8 *src, size_t bytes,
+                              uint16 start) {
+    memcpy(dst, src, bytes);
+    return sum_words(dst, bytes, start);
+}
+
+uint16 net_ipv6_checksum_pseudo(const struct in6_addr *src,
+                                const struct in6_addr *dst,
+                                uint32 upper_len, uint8 next_hdr) {
+    (void)src;
+    (void)dst;
+    return sum_words((const uint8_t *)&upper_len, 4, next_hdr);
+}
+
+/* Everything the socket sends ends up in here, for the test to look at. */
+typedef struct seg {
+    uint32_t seq, ack;
+    uint16_t flags, wnd;
+    size_t len;
+    uint8_t data[MSS];
+} seg_t;
+
+#define MAX_SEGS 256
+
+static seg_t segs[MAX_SEGS];
+static int nsegs;
+static long total_acks, total_data_segs, bad_checksums;
+static struct in6_addr sock_addr;
+
+int net_ipv6_send(netif_t *net, const uint8 *data, size_t data_size,
+                  int hop_limit, int proto, const struct in6_addr *src,
+                  const struct in6_addr *dst) {
+    const uint8_t *hdr = data;
+    size_t off = (hdr[12] >> 4) * 4;
+    seg_t *s;
+
+    (void)net;
+    (void)hop_limit;
+
+    sock_addr = *src;
+
+    if(net_ipv4_checksum(data, data_size,
+                         net_ipv6_checksum_pseudo(src, dst, data_size, proto)))
+        ++bad_checksums;
+
+    if(data_size > off)
+        ++total_data_segs;
+    else
+        ++total_acks;
+
+    if(nsegs == MAX_SEGS)
+        return 0;
+
+    s = &segs[nsegs++];
+    s->seq = (hdr[4] << 24) | (hdr[5] << 16) | (hdr[6] << 8) | hdr[7];
+    s->ack = (hdr[8] << 24) | (hdr[9] << 16) | (hdr[10] << 8) | hdr[11];
+    s->flags = hdr[13];
+    s->wnd = (hdr[14] << 8) | hdr[15];
+    s->len = data_size - off;
+    memcpy(s->data, data + off, s->len);
+    return 0;
+}
+
+int fs_socket_proto_add(fs_socket_proto_t *proto) {
+    if(proto->protocol == IPPROTO_TCP)
+        tcp_proto = proto;
+
+    return 0;
+}
+
+int fs_socket_proto_remove(fs_socket_proto_t *proto) {
+    (void)proto;
+    return 0;
+}
+
+net_socket_t *fs_socket_open_sock(fs_socket_proto_t *proto) {
+    (void)proto;
+    errno = ENFILE;
+    return NULL;
+}
+
+void __poll_event_trigger(int fd, short event) {
+    (void)fd;
+    (void)event;
+}
+
+int cond_wait_timed(condvar_t *cv, mutex_t *m, int timeout) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout / 1000;
+    ts.tv_nsec += (timeout % 1000) * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+
+    return pthread_cond_timedwait(cv, m, &ts) ? -1 : 0;
+}
+
+int net_thd_add_callback(void (*cb)(void *), void *data, uint64 timeout) {
+    (void)data;
+    (void)timeout;
+    tcp_tick = cb;
+    return 1;
+}
+
+int net_thd_del_callback(int cbid) {
+    (void)cbid;
+    tcp_tick = NULL;
+    return 0;
+}
+
+/* Move the clock along, running the TCP timer every 50ms like net_thd. */
+static void advance(int ms) {
+    for(; ms > 0; ms -= 50) {
+        clock_ms += ms < 50 ? ms : 50;
+        tcp_tick(NULL);
+    }
+}
+
+/* The other end of the connection */
+typedef struct peer {
+    net_socket_t s;
+    uint16_t port;          /* The socket's port, in network order */
+    uint32_t snd_nxt;       /* Next sequence number the peer sends */
+    uint32_t rcv_nxt;       /* Next sequence number the peer expects */
+    uint32_t base;          /* Sequence number of the first byte of data */
+} peer_t;
+
+static uint8_t pattern(uint32_t off) {
+    return (uint8_t)(off * 7 + (off >> 9));
+}
+
+/* Hand the socket a segment from the peer, ACKing whatever it has sent. */
+static void peer_input(peer_t *p, uint16_t flags, uint32_t seq,
+                       const uint8_t *data, size_t len) {
+    uint8_t pkt[24 + MSS];
+    ip_hdr_t ip;
+    size_t off = (flags & FLAG_SYN) ? 24 : 20;
+    uint16_t port = ntohs(p->port), cs;
+
+    memset(pkt, 0, off);
+    pkt[0] = PEER_PORT >> 8;
+    pkt[1] = PEER_PORT & 0xFF;
+    pkt[2] = port >> 8;
+    pkt[3] = port & 0xFF;
+    pkt[4] = seq >> 24;
+    pkt[5] = seq >> 16;
+    pkt[6] = seq >> 8;
+    pkt[7] = seq;
+    pkt[8] = p->rcv_nxt >> 24;
+    pkt[9] = p->rcv_nxt >> 16;
+    pkt[10] = p->rcv_nxt >> 8;
+    pkt[11] = p->rcv_nxt;
+    pkt[12] = (off / 4) << 4;
+    pkt[13] = flags;
+    pkt[14] = 0xFF;
+    pkt[15] = 0xFF;
+
+    /* Offer an MSS on the SYN */
+    if(flags & FLAG_SYN) {
+        pkt[20] = 2;
+        pkt[21] = 4;
+        pkt[22] = MSS >> 8;
+        pkt[23] = MSS & 0xFF;
+    }
+
+    if(len)
+        memcpy(pkt + off, data, len);
+
+    cs = net_ipv4_checksum(pkt, off + len,
+                           net_ipv6_checksum_pseudo(NULL, NULL, off + len,
+                                                    IPPROTO_TCP));
+    memcpy(pkt + 16, &cs, 2);
+
+    memset(&ip, 0, sizeof(ip));
+    ip.protocol = IPPROTO_TCP;
+    ip.src = htonl(0x7F000001);
+    ip.dest = sock_addr.__s6_addr.__s6_addr32[3];
+    tcp_proto->input(&loop_if, AF_INET, &ip, pkt, off + len);
+}
+
+/* Send stream bytes [off, off + len) from the peer. */
+static void peer_data(peer_t *p, uint32_t off, size_t len) {
+    uint8_t buf[MSS];
+    size_t i;
+
+    for(i = 0; i < len; ++i)
+        buf[i] = pattern(off + i);
+
+    peer_input(p, FLAG_ACK, p->base + off, buf, len);
+}
+
+static int sock_fcntl(net_socket_t *s, int cmd, ...) {
+    va_list ap;
+    int rv;
+
+    va_start(ap, cmd);
+    rv = tcp_proto->fcntl(s, cmd, ap);
+    va_end(ap);
+    return rv;
+}
+
+static int set_nodelay(peer_t *p, int val) {
+    return tcp_proto->setsockopt(&p->s, IPPROTO_TCP, TCP_NODELAY, &val,
+                                 sizeof(val));
+}
+
+/* Open a non-blocking socket and connect it to the peer. */
+static int peer_open(peer_t *p) {
+    struct sockaddr_in addr;
+    struct sockaddr_in6 name;
+    socklen_t len = sizeof(name);
+
+    memset(p, 0, sizeof(*p));
+    nsegs = 0;
+
+    if(tcp_proto->socket(&p->s, AF_INET, SOCK_STREAM, IPPROTO_TCP) ||
+       sock_fcntl(&p->s, F_SETFL, (long)O_NONBLOCK))
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PEER_PORT);
+    addr.sin_addr.s_addr = htonl(0x7F000001);
+
+    if(tcp_proto->connect(&p->s, (struct sockaddr *)&addr, sizeof(addr)) !=
+       -1 || errno != EINPROGRESS)
+        return -1;
+
+    if(nsegs != 1 || segs[0].flags != FLAG_SYN)
+        return -1;
+
+    if(tcp_proto->getsockname(&p->s, (struct sockaddr *)&name, &len))
+        return -1;
+
+    p->port = name.sin6_port;
+    p->rcv_nxt = segs[0].seq + 1;
+    p->snd_nxt = 0x10000000;
+    p->base = p->snd_nxt + 1;
+
+    /* <SYN,ACK>, and the socket should ACK that */
+    nsegs = 0;
+    peer_input(p, FLAG_SYN | FLAG_ACK, p->snd_nxt, NULL, 0);
+
+    if(nsegs != 1 || segs[0].flags != FLAG_ACK || segs[0].ack != p->base)
+        return -1;
+
+    nsegs = 0;
+    return 0;
+}
+
+/* Drop the connection without the closing handshake. */
+static void peer_close(peer_t *p) {
+    peer_input(p, FLAG_RST, p->base + 0x100000, NULL, 0);
+    tcp_proto->close(&p->s);
+    nsegs = 0;
+}
+
+/* The highest ACK the socket has sent, and how many pure ACKs there were. */
+static int count_acks(uint32_t *ack) {
+    int i, n = 0;
+
+    for(i = 0; i < nsegs; ++i) {
+        if(!segs[i].len) {
+            ++n;
+            *ack = segs[i].ack;
+        }
+    }
+
+    return n;
+}
+
+/* Read everything the socket has, checking it against the pattern. */
+static ssize_t drain(peer_t *p, uint32_t *off, size_t max) {
+    uint8_t buf[WINDOW];
+    ssize_t rv, i;
+
+    if(max > sizeof(buf))
+        max = sizeof(buf);
+
+    rv = tcp_proto->recvfrom(&p->s, buf, max, 0, NULL, NULL);
+
+    if(rv < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+    for(i = 0; i < rv; ++i) {
+        if(buf[i] != pattern(*off + i))
+            return -2;
+    }
+
+    *off += rv;
+    return rv;
+}
+
+static void test_delack(void) {
+    peer_t p;
+    uint32_t ack = 0, off = 0;
+    int i;
+
+    CHECK(!peer_open(&p), "connection setup");
+
+    /* Every second full segment is ACKed straight away. */
+    for(i = 0; i < 4; ++i)
+        peer_data(&p, i * SEG, SEG);
+
+    CHECK(count_acks(&ack) == 2, "%d ACKs for 4 segments", count_acks(&ack));
+    CHECK(ack == p.base + 4 * SEG, "ACK %u, wanted %u", ack - p.base, 4 * SEG);
+
+    /* A lone one waits for the timer. */
+    nsegs = 0;
+    peer_data(&p, 4 * SEG, 100);
+    CHECK(nsegs == 0, "lone segment ACKed at once");
+    advance(DELACK_MS - 50);
+    CHECK(nsegs == 0, "lone segment ACKed early");
+    advance(50);
+    CHECK(count_acks(&ack) == 1 && ack == p.base + 4 * SEG + 100,
+          "lone segment not ACKed after the timer");
+
+    /* And nothing more after that. */
+    nsegs = 0;
+    advance(500);
+    CHECK(nsegs == 0, "ACKed twice");
+
+    CHECK(drain(&p, &off, ~0U) == WINDOW - (WINDOW - 4 * SEG - 100),
+          "wrong data read");
+    peer_close(&p);
+}
+
+static void test_reorder(void) {
+    peer_t p;
+    uint32_t ack = 0, off = 0;
+
+    CHECK(!peer_open(&p), "connection setup");
+
+    /* Segment 1 is lost: 2 and 3 each get a duplicate ACK for 1... */
+    peer_data(&p, 0, SEG);
+    peer_data(&p, 2 * SEG, SEG);
+    CHECK(count_acks(&ack) == 1 && ack == p.base + SEG,
+          "no duplicate ACK for segment 2");
+    peer_data(&p, 3 * SEG, 300);
+    CHECK(count_acks(&ack) == 2 && ack == p.base + SEG,
+          "no duplicate ACK for segment 3");
+    CHECK(drain(&p, &off, ~0U) == SEG, "data past a hole was readable");
+
+    /* ...and filling the hole ACKs everything at once. */
+    nsegs = 0;
+    peer_data(&p, SEG, SEG);
+    CHECK(count_acks(&ack) == 1 && ack == p.base + 3 * SEG + 300,
+          "filling the hole didn't ACK everything");
+    CHECK(drain(&p, &off, ~0U) == 2 * SEG + 300, "wrong data read");
+
+    /* A resend that's partly old still gets its new part taken. */
+    nsegs = 0;
+    peer_data(&p, 3 * SEG, SEG);
+    CHECK(drain(&p, &off, ~0U) == SEG - 300, "overlapping segment lost");
+    advance(DELACK_MS);
+    CHECK(count_acks(&ack) == 1 && ack == p.base + 4 * SEG,
+          "overlapping segment not ACKed");
+
+    /* Something entirely old gets an ACK straight back. */
+    nsegs = 0;
+    peer_data(&p, SEG, SEG);
+    CHECK(count_acks(&ack) == 1 && ack == p.base + 4 * SEG,
+          "old segment not ACKed");
+    peer_close(&p);
+}
+
+/* Throw segments at the socket in a random order, with some lost, some
+   repeated, and some resent in different sizes, while the reads wrap the
+   buffer around many times. */
+static void test_random(void) {
+    peer_t p;
+    uint32_t acked = 0, off = 0, sent, start, len, wnd;
+    int round, i, n, order[16];
+    uint32_t seg_off[16], seg_len[16];
+    ssize_t rv;
+
+    CHECK(!peer_open(&p), "connection setup");
+    srand(1234);
+
+    for(round = 0; round < 2000; ++round) {
+        /* What the socket last told us about its window */
+        wnd = WINDOW;
+
+        for(i = 0; i < nsegs; ++i) {
+            if(!segs[i].len) {
+                acked = segs[i].ack - p.base;
+                wnd = segs[i].wnd;
+            }
+        }
+
+        nsegs = 0;
+
+        /* Cut up some of what fits in the window... */
+        start = acked;
+        n = 0;
+
+        if(rand() % 4 == 0 && start >= 100)
+            start -= rand() % 100;
+
+        for(sent = start; n < 16 && sent < acked + wnd; ++n) {
+            len = 1 + rand() % SEG;
+
+            if(sent + len > acked + wnd)
+                len = acked + wnd - sent;
+
+            seg_off[n] = sent;
+            seg_len[n] = len;
+            order[n] = n;
+            sent += len;
+        }
+
+        /* ...shuffle it... */
+        for(i = n - 1; i > 0; --i) {
+            int j = rand() % (i + 1), t = order[i];
+
+            order[i] = order[j];
+            order[j] = t;
+        }
+
+        /* ...and send most of it. */
+        for(i = 0; i < n; ++i) {
+            if(rand() % 8 == 0)
+                continue;
+
+            peer_data(&p, seg_off[order[i]], seg_len[order[i]]);
+
+            if(rand() % 16 == 0)
+                peer_data(&p, seg_off[order[i]], seg_len[order[i]]);
+        }
+
+        if(rand() % 4 == 0)
+            advance(DELACK_MS);
+
+        rv = drain(&p, &off, rand() % (WINDOW + 1));
+        CHECK(rv >= 0, "%s at offset %u",
+              rv == -2 ? "bad data" : "read failed", off);
+
+        /* Resent data always has to start at the ACK the socket gave, so
+           make sure one has gone out. */
+        if(!count_acks(&len))
+            advance(DELACK_MS);
+    }
+
+    CHECK(off > 100 * WINDOW, "only %u bytes got through", off);
+    peer_close(&p);
+}
+
+static void test_nagle(void) {
+    peer_t p;
+    uint8_t buf[100];
+    int val;
+    socklen_t len = sizeof(val);
+
+    CHECK(!peer_open(&p), "connection setup");
+    memset(buf, 'x', sizeof(buf));
+
+    CHECK(!tcp_proto->getsockopt(&p.s, IPPROTO_TCP, TCP_NODELAY, &val, &len) &&
+          val == 0, "TCP_NODELAY on by default");
+
+    /* The first small write goes out, the rest wait for its ACK. */
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(nsegs == 1 && segs[0].len == 10, "first write not sent");
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(nsegs == 1, "small write not held back");
+
+    /* Holding them back mustn't hold back the retransmission either. */
+    advance(RTTO_MS);
+    CHECK(nsegs == 2 && segs[1].seq == segs[0].seq && segs[1].len == 30,
+          "no retransmission");
+
+    /* Once that's ACKed, nothing's left. */
+    nsegs = 0;
+    p.rcv_nxt += 30;
+    peer_input(&p, FLAG_ACK, p.base, NULL, 0);
+    CHECK(nsegs == 0, "sent more than was written");
+
+    /* Now an ACK for the first write releases what's waiting, in one go. */
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(tcp_proto->sendto(&p.s, buf, 20, 0, NULL, 0) == 20, "send failed");
+    CHECK(tcp_proto->sendto(&p.s, buf, 30, 0, NULL, 0) == 30, "send failed");
+    CHECK(nsegs == 1 && segs[0].len == 10, "small writes not held back");
+    p.rcv_nxt += 10;
+    peer_input(&p, FLAG_ACK, p.base, NULL, 0);
+    CHECK(nsegs == 2 && segs[1].len == 50, "ACK didn't release held data");
+
+    /* With TCP_NODELAY, everything goes straight out. */
+    nsegs = 0;
+    CHECK(!set_nodelay(&p, 1), "setting TCP_NODELAY failed");
+    CHECK(!tcp_proto->getsockopt(&p.s, IPPROTO_TCP, TCP_NODELAY, &val, &len) &&
+          val == 1, "TCP_NODELAY not set");
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(nsegs == 2 && segs[1].len == 10, "TCP_NODELAY write held back");
+
+    /* And turning it on sends anything that was being held. */
+    CHECK(!set_nodelay(&p, 0), "clearing TCP_NODELAY failed");
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(nsegs == 2, "small write not held back");
+    CHECK(!set_nodelay(&p, 1), "setting TCP_NODELAY failed");
+    CHECK(nsegs == 3 && segs[2].len == 10, "held data not sent");
+
+    /* Data going back carries any ACK that was waiting. */
+    nsegs = 0;
+    p.rcv_nxt += 80;
+    peer_data(&p, 0, 100);
+    CHECK(nsegs == 0, "lone segment ACKed at once");
+    CHECK(tcp_proto->sendto(&p.s, buf, 10, 0, NULL, 0) == 10, "send failed");
+    CHECK(nsegs == 1 && segs[0].len == 10 && segs[0].ack == p.base + 100,
+          "data didn't carry the ACK");
+    advance(DELACK_MS);
+    CHECK(nsegs == 1, "ACK sent again");
+    peer_close(&p);
+}
+
+/* Send odd-sized writes through a small send buffer, with the peer holding
+   back some of its ACKs, so segments keep straddling the end of the buffer
+   at odd offsets. Check the data and the checksums that go out. */
+static void test_send(void) {
+    peer_t p;
+    uint8_t buf[3000];
+    uint32_t off = 0, got = 0, seen, i;
+    int val = 1001, round, j;
+
+    CHECK(!peer_open(&p), "connection setup");
+    CHECK(!tcp_proto->setsockopt(&p.s, SOL_SOCKET, SO_SNDBUF, &val,
+                                 sizeof(val)), "setting SO_SNDBUF failed");
+    CHECK(!set_nodelay(&p, 1), "setting TCP_NODELAY failed");
+    srand(5678);
+    bad_checksums = 0;
+    seen = p.rcv_nxt;
+
+    for(round = 0; round < 5000; ++round) {
+        val = 1 + rand() % sizeof(buf);
+
+        for(i = 0; i < (uint32_t)val; ++i)
+            buf[i] = pattern(off + i);
+
+        /* The buffer fills up when the peer is slow to ACK */
+        val = tcp_proto->sendto(&p.s, buf, val, 0, NULL, 0);
+        CHECK(val >= 0 || errno == EWOULDBLOCK, "send failed");
+
+        if(val > 0)
+            off += val;
+
+        for(j = 0; j < nsegs; ++j) {
+            CHECK(segs[j].seq == seen, "segment out of sequence at %u", got);
+
+            for(i = 0; i < segs[j].len; ++i) {
+                CHECK(segs[j].data[i] == pattern(got + i),
+                      "bad data at offset %u", got + i);
+            }
+
+            got += segs[j].len;
+            seen += segs[j].len;
+        }
+
+        /* ACK some of what's outstanding */
+        nsegs = 0;
+        p.rcv_nxt += rand() % (seen - p.rcv_nxt + 1);
+        peer_input(&p, FLAG_ACK, p.base, NULL, 0);
+    }
+
+    CHECK(got == off, "sent %u bytes, %u went out", off, got);
+    CHECK(!bad_checksums, "%ld segments with a bad checksum", bad_checksums);
+    peer_close(&p);
+}
+
+static void bench(void) {
+    peer_t p;
+    uint32_t off = 0, acked = 0, sent = 0, ack;
+    uint8_t buf[10];
+    long segments = 0, acks, data;
+    double t;
+    int i;
+
+    if(peer_open(&p)) {
+        printf("connection setup failed\n");
+        return;
+    }
+
+    /* Bulk data into the socket, as fast as the window allows */
+    total_acks = 0;
+    t = now();
+
+    while(off < 64 * 1024 * 1024) {
+        while(sent < acked + WINDOW - SEG && sent < off + WINDOW - SEG) {
+            peer_data(&p, sent, SEG);
+            sent += SEG;
+            ++segments;
+        }
+
+        drain(&p, &off, WINDOW);
+
+        if(count_acks(&ack))
+            acked = ack - p.base;
+        else
+            advance(DELACK_MS);
+
+        nsegs = 0;
+    }
+
+    t = now() - t;
+    printf("%ld segments received in %.3f s, %.2f us each, "
+           "%.2f ACKs per segment\n", segments, t, t * 1e6 / segments,
+           (double)total_acks / segments);
+    peer_close(&p);
+
+    /* Lots of small writes, with the peer ACKing straight away */
+    for(i = 0; i < 2; ++i) {
+        if(peer_open(&p)) {
+            printf("connection setup failed\n");
+            return;
+        }
+
+        set_nodelay(&p, i);
+        total_data_segs = 0;
+        memset(buf, 'x', sizeof(buf));
+
+        for(data = 0; data < 100000; ++data) {
+            tcp_proto->sendto(&p.s, buf, sizeof(buf), 0, NULL, 0);
+
+            /* The peer ACKs every other write */
+            if(data & 1) {
+                for(acks = 0; acks < nsegs; ++acks)
+                    p.rcv_nxt = segs[acks].seq + segs[acks].len;
+
+                nsegs = 0;
+                peer_input(&p, FLAG_ACK, p.base, NULL, 0);
+            }
+        }
+
+        printf("%ld segments for %ld %zu-byte writes with TCP_NODELAY %s\n",
+               total_data_segs, data, sizeof(buf), i ? "on" : "off");
+        peer_close(&p);
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-b]\n", name);
+    fprintf(stderr, "  -b  run the benchmark instead of the tests\n");
+}
+
+int main(int argc, char **argv) {
+    net_tcp_init();
+
+    if(!tcp_proto || !tcp_tick) {
+        fprintf(stderr, "net_tcp_init() didn't register the protocol\n");
+        return 1;
+    }
+
+    if(argc > 1) {
+        if(!strcmp(argv[1], "-b")) {
+            bench();
+            return 0;
+        }
+
+        usage(argv[0]);
+        return 1;
+    }
+
+    test_delack();
+    test_reorder();
+    test_random();
+    test_nagle();
+    test_send();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
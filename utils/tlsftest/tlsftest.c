@@ -0,0 +1,553 @@
+/* KallistiOS ##version##
+
+   tlsftest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the TLSF allocator in kernel/mm/tlsf.c,
+   which is built as-is on the host.
+
+   In stress mode (-s), random blocks are allocated and freed, and every
+   result is checked against a shadow map of the pool, to catch overlapping or
+   misaligned blocks and inconsistent statistics. Before that, compacting a
+   pool must keep the alignment of the blocks that were allocated with more
+   than the granule's. The default block sizes are
+   those of short sound effects and voice clips, so
+   "tlsftest -p 0x1f0000 -s 1000000" gives an idea of how sound RAM behaves.
+
+   Allocation traces are replayed against a pool of the configured size, and
+   the time taken and the fragmentation of the pool are reported. Two trace
+   formats are understood, and can be mixed:
+
+   - The output of pvr_mem.c built with PVR_KM_DBG_VERBOSE, i.e. lines like
+     "Thread 1/8c012345 allocated 65536 bytes at a4200000" and
+     "Thread 1/8c012345 freeing block @ a4200000". Any other lines of the log
+     are ignored, so a whole dc-tool session can be fed in directly.
+   - Lines of the form "a <tag> <size> [align]" and "f <tag>", where the tag
+     is any number identifying the block.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <kos/tlsf.h>
+
+#define POOL_BASE   0x10000000
+
+typedef struct op {
+    enum { OP_ALLOC, OP_FREE } type;
+    size_t slot;
+    size_t size;
+    size_t align;
+} op_t;
+
+static op_t *ops;
+static size_t nops, ops_max, nslots;
+
+/* Maps trace tags to the slot of their most recent allocation */
+typedef struct tag_ent {
+    unsigned long tag;
+    size_t slot;
+    int valid;
+} tag_ent_t;
+
+static tag_ent_t *tags;
+static size_t tags_mask;
+
+static tag_ent_t *tag_lookup(unsigned long tag) {
+    size_t i = (tag * 2654435761u) & tags_mask;
+
+    while(tags[i].valid && tags[i].tag != tag)
+        i = (i + 1) & tags_mask;
+
+    return &tags[i];
+}
+
+static void tags_grow(void) {
+    tag_ent_t *old = tags;
+    size_t i, old_size = tags ? tags_mask + 1 : 0;
+
+    tags_mask = old_size ? old_size * 2 - 1 : 1023;
+    tags = calloc(tags_mask + 1, sizeof(tag_ent_t));
+    if(!tags) {
+        perror("calloc");
+        exit(1);
+    }
+
+    for(i = 0; i < old_size; i++) {
+        if(old[i].valid)
+            *tag_lookup(old[i].tag) = old[i];
+    }
+
+    free(old);
+}
+
+static void add_op(int type, unsigned long tag, size_t size, size_t align) {
+    static size_t ntags;
+    tag_ent_t *t;
+
+    if(nops == ops_max) {
+        ops_max = ops_max ? ops_max * 2 : 1024;
+        ops = realloc(ops, ops_max * sizeof(op_t));
+        if(!ops) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    if(!tags || ntags * 2 > tags_mask)
+        tags_grow();
+
+    t = tag_lookup(tag);
+
+    if(type == OP_ALLOC) {
+        if(!t->valid)
+            ntags++;
+
+        t->tag = tag;
+        t->slot = nslots++;
+        t->valid = 1;
+
+        ops[nops].slot = t->slot;
+        ops[nops].size = size;
+        ops[nops].align = align;
+    }
+    else {
+        /* Frees of blocks allocated before the trace started are dropped */
+        if(!t->valid)
+            return;
+
+        ops[nops].slot = t->slot;
+    }
+
+    ops[nops++].type = type;
+}
+
+static int load_trace(const char *fn) {
+    unsigned long tag, size, align;
+    char line[512];
+    const char *p;
+    FILE *f;
+
+    if(!(f = fopen(fn, "r"))) {
+        perror(fn);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), f)) {
+        if((p = strstr(line, " allocated ")) &&
+           sscanf(p, " allocated %lu bytes at %lx", &size, &tag) == 2) {
+            add_op(OP_ALLOC, tag, size, 0);
+        }
+        else if((p = strstr(line, " freeing block @ ")) &&
+                sscanf(p, " freeing block @ %lx", &tag) == 1) {
+            add_op(OP_FREE, tag, 0, 0);
+        }
+        else if(line[0] == 'a' &&
+                sscanf(line, "a %lu %lu", &tag, &size) == 2) {
+            if(sscanf(line, "a %*u %*u %lu", &align) != 1)
+                align = 0;
+
+            add_op(OP_ALLOC, tag, size, align);
+        }
+        else if(line[0] == 'f' && sscanf(line, "f %lu", &tag) == 1) {
+            add_op(OP_FREE, tag, 0, 0);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int count_move(uintptr_t dst, uintptr_t src, size_t size, void *data) {
+    (void)dst;
+    (void)src;
+
+    *(size_t *)data += size;
+    return 0;
+}
+
+static int shadow_move(uintptr_t dst, uintptr_t src, size_t size, void *data) {
+    uint8_t *shadow = data;
+
+    memmove(shadow + dst - POOL_BASE, shadow + src - POOL_BASE, size);
+    return 0;
+}
+
+/* Allocate 1 KiB aligned blocks with small ones in between, free the small
+   ones and compact: every block must still be aligned, and hold its data. */
+static int compact_aligned(void) {
+    size_t pool_size = 64 * 1024, granule = 32, nblocks = 16, i, j, count;
+    uintptr_t small[16], big[16];
+    tlsf_remap_t remap[16];
+    uint8_t *shadow = calloc(pool_size, 1);
+    tlsf_pool_t *pool = tlsf_create(POOL_BASE, pool_size, granule);
+
+    if(!pool || !shadow) {
+        perror("tlsf_create");
+        return 1;
+    }
+
+    for(i = 0; i < nblocks; i++) {
+        small[i] = tlsf_alloc(pool, 3 * granule, 0);
+        big[i] = tlsf_alloc(pool, 512, 1024);
+
+        if(!small[i] || !big[i]) {
+            fprintf(stderr, "can't allocate the blocks to compact\n");
+            return 1;
+        }
+
+        memset(shadow + big[i] - POOL_BASE, i + 1, 512);
+    }
+
+    for(i = 0; i < nblocks; i++)
+        tlsf_free(pool, small[i]);
+
+    count = tlsf_compact(pool, shadow_move, shadow, remap, nblocks);
+
+    if(!count) {
+        fprintf(stderr, "compaction didn't move any block\n");
+        return 1;
+    }
+
+    for(i = 0; i < count; i++) {
+        for(j = 0; j < nblocks; j++) {
+            if(big[j] == remap[i].from) {
+                big[j] = remap[i].to;
+                break;
+            }
+        }
+    }
+
+    for(i = 0; i < nblocks; i++) {
+        if(big[i] & 1023) {
+            fprintf(stderr, "compacted block %lx lost its 1024 byte "
+                    "alignment\n", (unsigned long)big[i]);
+            return 1;
+        }
+
+        if(tlsf_block_size(pool, big[i]) != 512) {
+            fprintf(stderr, "compacted block %lx is missing\n",
+                    (unsigned long)big[i]);
+            return 1;
+        }
+
+        for(j = 0; j < 512; j++) {
+            if(shadow[big[i] - POOL_BASE + j] != i + 1) {
+                fprintf(stderr, "compacted block %lx has the wrong data\n",
+                        (unsigned long)big[i]);
+                return 1;
+            }
+        }
+    }
+
+    tlsf_destroy(pool);
+    free(shadow);
+
+    return 0;
+}
+
+static void print_stats(const char *what, const tlsf_stats_t *st) {
+    printf("%s: %zu/%zu bytes used in %zu blocks, %zu bytes free in %zu "
+           "blocks, largest free %zu, fragmentation %u%%\n", what,
+           st->used, st->total, st->used_blocks, st->free, st->free_blocks,
+           st->largest_free, st->fragmentation);
+}
+
+/* Random block size of up to 64 KiB, biased towards small ones */
+static size_t stress_size(void) {
+    size_t max = 1024 << (rand() % 7);
+
+    return 1 + rand() % max;
+}
+
+static int stress(tlsf_pool_t *pool, size_t pool_size, size_t granule,
+                  size_t count) {
+    size_t nslots = 256, i, j, n, slot, first, failed = 0;
+    size_t granules = pool_size / granule;
+    uintptr_t *addr = calloc(nslots, sizeof(uintptr_t));
+    size_t *size = calloc(nslots, sizeof(size_t));
+    uint32_t *owner = calloc(granules, sizeof(uint32_t));
+    unsigned int worst_frag = 0;
+    tlsf_stats_t st, worst = { 0 };
+    size_t used = 0, used_blocks = 0, align;
+    double start, elapsed = 0;
+
+    if(!addr || !size || !owner) {
+        perror("calloc");
+        return 1;
+    }
+
+    for(i = 0; i < count; i++) {
+        slot = rand() % nslots;
+
+        if(addr[slot]) {
+            start = now();
+            n = tlsf_free(pool, addr[slot]);
+            elapsed += now() - start;
+
+            if(n) {
+                fprintf(stderr, "free of %lx failed\n",
+                        (unsigned long)addr[slot]);
+                return 1;
+            }
+
+            first = (addr[slot] - POOL_BASE) / granule;
+            n = (size[slot] + granule - 1) / granule;
+
+            for(j = first; j < first + n; j++)
+                owner[j] = 0;
+
+            used -= n * granule;
+            used_blocks--;
+            addr[slot] = 0;
+        }
+        else {
+            size[slot] = stress_size();
+            align = rand() % 8 ? 0 : granule << (rand() % 6);
+
+            start = now();
+            addr[slot] = tlsf_alloc(pool, size[slot], align);
+            elapsed += now() - start;
+
+            if(!addr[slot]) {
+                failed++;
+                continue;
+            }
+
+            if(addr[slot] < POOL_BASE ||
+               addr[slot] + size[slot] > POOL_BASE + pool_size ||
+               (addr[slot] & (granule - 1)) ||
+               (align && (addr[slot] & (align - 1)))) {
+                fprintf(stderr, "bad block %lx for size %zu alignment %zu\n",
+                        (unsigned long)addr[slot], size[slot], align);
+                return 1;
+            }
+
+            first = (addr[slot] - POOL_BASE) / granule;
+            n = (size[slot] + granule - 1) / granule;
+
+            for(j = first; j < first + n; j++) {
+                if(owner[j]) {
+                    fprintf(stderr, "block %lx overlaps another block\n",
+                            (unsigned long)addr[slot]);
+                    return 1;
+                }
+
+                owner[j] = slot + 1;
+            }
+
+            used += n * granule;
+            used_blocks++;
+        }
+
+        if(i % 1024 == 0) {
+            tlsf_get_stats(pool, &st);
+
+            if(st.used != used || st.used_blocks != used_blocks ||
+               st.used + st.free != st.total) {
+                fprintf(stderr, "inconsistent statistics after %zu "
+                        "operations\n", i);
+                return 1;
+            }
+
+            if(st.fragmentation > worst_frag) {
+                worst_frag = st.fragmentation;
+                worst = st;
+            }
+        }
+    }
+
+    if(worst_frag)
+        print_stats("worst", &worst);
+
+    tlsf_get_stats(pool, &st);
+    print_stats("end", &st);
+    printf("%zu operations, %zu failed allocations, %.1f ns/operation\n",
+           count, failed, elapsed * 1e9 / count);
+
+    free(owner);
+    free(size);
+    free(addr);
+
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p pool_size] [-g granule] [-n iterations] "
+            "[-c] trace...\n"
+            "       %s [-p pool_size] [-g granule] [-r seed] -s count\n\n"
+            "  -p  size of the pool in bytes (default 8 MiB)\n"
+            "  -g  allocation granule in bytes (default 32)\n"
+            "  -n  number of times the traces are replayed (default 100)\n"
+            "  -c  compact the pool at the end of the replay\n"
+            "  -s  run a random stress test of the given number of operations\n"
+            "  -r  seed of the stress test (default 1)\n", prog, prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    size_t pool_size = 8 * 1024 * 1024, granule = 32, iters = 100, count = 0;
+    size_t i, it, failed = 0, bad_frees = 0, moved = 0, nremap;
+    unsigned int worst_frag = 0;
+    tlsf_stats_t st, worst = { 0 };
+    tlsf_remap_t *remap;
+    uintptr_t *slots;
+    tlsf_pool_t *pool;
+    double start, elapsed;
+    int c, compact = 0, rv;
+
+    while((c = getopt(argc, argv, "p:g:n:cs:r:")) != -1) {
+        switch(c) {
+            case 'p':
+                pool_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                granule = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                iters = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                compact = 1;
+                break;
+            case 's':
+                count = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                srand(strtoul(optarg, NULL, 0));
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(count) {
+        if(!(pool = tlsf_create(POOL_BASE, pool_size, granule))) {
+            perror("tlsf_create");
+            return 1;
+        }
+
+        rv = compact_aligned() ||
+             stress(pool, pool_size & ~(granule - 1), granule, count);
+        tlsf_destroy(pool);
+
+        return rv;
+    }
+
+    if(optind == argc || !iters)
+        usage(argv[0]);
+
+    for(i = optind; i < (size_t)argc; i++) {
+        if(load_trace(argv[i]))
+            return 1;
+    }
+
+    pool = tlsf_create(POOL_BASE, pool_size, granule);
+    slots = calloc(nslots ? nslots : 1, sizeof(uintptr_t));
+
+    if(!pool || !slots) {
+        perror("tlsf_create");
+        return 1;
+    }
+
+    printf("%zu operations, %zu allocations\n", nops, nslots);
+
+    /* First pass: check the results and track the worst fragmentation */
+    for(i = 0; i < nops; i++) {
+        op_t *op = &ops[i];
+
+        if(op->type == OP_ALLOC) {
+            slots[op->slot] = tlsf_alloc(pool, op->size, op->align);
+
+            if(!slots[op->slot]) {
+                failed++;
+            }
+            else if(op->align && (slots[op->slot] & (op->align - 1))) {
+                fprintf(stderr, "misaligned block %lx for alignment %zu\n",
+                        (unsigned long)slots[op->slot], op->align);
+                return 1;
+            }
+        }
+        else if(slots[op->slot]) {
+            if(tlsf_free(pool, slots[op->slot]))
+                bad_frees++;
+
+            slots[op->slot] = 0;
+        }
+
+        if(op->type == OP_FREE) {
+            tlsf_get_stats(pool, &st);
+
+            if(st.fragmentation > worst_frag) {
+                worst_frag = st.fragmentation;
+                worst = st;
+            }
+        }
+    }
+
+    if(worst_frag)
+        print_stats("worst", &worst);
+
+    tlsf_get_stats(pool, &st);
+    print_stats("end", &st);
+    printf("%zu failed allocations, %zu invalid frees\n", failed, bad_frees);
+
+    if(compact) {
+        remap = malloc((st.used_blocks ? st.used_blocks : 1) *
+                       sizeof(tlsf_remap_t));
+        if(!remap) {
+            perror("malloc");
+            return 1;
+        }
+
+        start = now();
+        nremap = tlsf_compact(pool, count_move, &moved, remap,
+                              st.used_blocks);
+        elapsed = now() - start;
+
+        tlsf_get_stats(pool, &st);
+        printf("compaction: %zu blocks, %zu bytes moved in %.3f ms\n",
+               nremap, moved, elapsed * 1e3);
+        print_stats("compacted", &st);
+        free(remap);
+    }
+
+    /* Timed passes */
+    start = now();
+
+    for(it = 0; it < iters; it++) {
+        tlsf_reset(pool);
+
+        for(i = 0; i < nops; i++) {
+            op_t *op = &ops[i];
+
+            if(op->type == OP_ALLOC)
+                slots[op->slot] = tlsf_alloc(pool, op->size, op->align);
+            else if(slots[op->slot])
+                tlsf_free(pool, slots[op->slot]);
+        }
+    }
+
+    elapsed = now() - start;
+    printf("%zu replays in %.3f ms, %.1f ns/operation\n", iters,
+           elapsed * 1e3, nops ? elapsed * 1e9 / ((double)nops * iters) : 0.0);
+
+    tlsf_destroy(pool);
+    free(slots);
+    free(ops);
+    free(tags);
+
+    return failed || bad_frees ? 2 : 0;
+}
@@ -0,0 +1,450 @@
+/* KallistiOS ##version##
+
+   twiddletest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the texture twiddler, whose code in
+   kernel/arch/dreamcast/hardware/pvr/pvr_twiddle.c is built as-is on the
+   host, with its output to memory.
+
+   The output is compared to the loops pvr_txr_load_ex() used before, which
+   are kept here, and to a texel by texel reference for what they didn't
+   handle: inverted 4bpp and 8bpp textures (which they got wrong, swapping
+   every pair of rows), strides and mipmaps. The mipmap offsets are checked
+   against the table of utils/pvrtex.
+
+   The benchmark (-b) twiddles textures of every format with both, and
+   reports the time per texture.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dc/pvr.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static const uint32_t fmts[3] = {
+    PVR_TXRLOAD_4BPP, PVR_TXRLOAD_8BPP, PVR_TXRLOAD_16BPP
+};
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int fmt_bpp(uint32_t flags) {
+    switch(flags & PVR_TXRLOAD_FMT_MASK) {
+        case PVR_TXRLOAD_4BPP:
+            return 4;
+        case PVR_TXRLOAD_8BPP:
+            return 8;
+        default:
+            return 16;
+    }
+}
+
+static void fill_random(void *buf, size_t size) {
+    uint8_t *p = buf;
+
+    while(size--)
+        *p++ = rand();
+}
+
+/* The loops of pvr_txr_load_ex() up to now, writing to memory. */
+#define TWIDTAB(x) ( (x&1)|((x&2)<<1)|((x&4)<<2)|((x&8)<<3)|((x&16)<<4)| \
+                     ((x&32)<<5)|((x&64)<<6)|((x&128)<<7)|((x&256)<<8)|((x&512)<<9) )
+#define TWIDOUT(x, y) ( TWIDTAB((y)) | (TWIDTAB((x)) << 1) )
+
+#define MIN(a, b) ( (a)<(b)? (a):(b) )
+
+static void old_load_ex(const void *src, void *dst, uint32_t w, uint32_t h,
+                        uint32_t flags) {
+    uint32_t x, y, yout, min, mask, bpp, invert;
+
+    bpp = fmt_bpp(flags);
+    invert = (flags & PVR_TXRLOAD_INVERT_Y) ? 1 : 0;
+
+    min = MIN(w, h);
+    mask = min - 1;
+
+    switch(bpp) {
+        case 4: {
+            uint8_t * pixels;
+            uint16_t * vtex;
+            pixels = (uint8_t *) src;
+            vtex = (uint16_t*)dst;
+
+            for(y = 0; y < h; y += 2) {
+                if(!invert)
+                    yout = y;
+                else
+                    yout = ((h - 1) - y);
+
+                for(x = 0; x < w; x += 2) {
+                    vtex[TWIDOUT((x & mask) / 2, (yout & mask) / 2) +
+                         (x / min + yout / min)*min * min / 4] =
+                             (pixels[(x + y * w) >> 1] & 15) | ((pixels[(x + (y + 1) * w) >> 1] & 15) << 4) |
+                             ((pixels[(x + y * w) >> 1] >> 4) << 8) | ((pixels[(x + (y + 1) * w) >> 1] >> 4) << 12);
+                }
+            }
+        }
+        break;
+        case 8: {
+            uint8_t * pixels;
+            uint16_t * vtex;
+            pixels = (uint8_t *) src;
+            vtex = (uint16_t*)dst;
+
+            for(y = 0; y < h; y += 2) {
+                if(!invert)
+                    yout = y;
+                else
+                    yout = ((h - 1) - y);
+
+                for(x = 0; x < w; x++) {
+                    vtex[TWIDOUT((yout & mask) / 2, x & mask) +
+                         (x / min + yout / min)*min * min / 2] =
+                             pixels[y * w + x] | (pixels[(y + 1) * w + x] << 8);
+                }
+            }
+        }
+        break;
+        case 16: {
+            uint16_t * pixels;
+            uint16_t * vtex;
+            pixels = (uint16_t *) src;
+            vtex = (uint16_t*)dst;
+
+            for(y = 0; y < h; y++) {
+                if(!invert)
+                    yout = y;
+                else
+                    yout = ((h - 1) - y);
+
+                for(x = 0; x < w; x++) {
+                    vtex[TWIDOUT(x & mask, yout & mask) +
+                         (x / min + yout / min)*min * min] = pixels[y * w + x];
+                }
+            }
+        }
+        break;
+    }
+}
+
+/* Texel by texel reference. */
+static uint32_t get_texel(const uint8_t *src, size_t stride, uint32_t x,
+                          uint32_t y, unsigned int bpp) {
+    const uint8_t *row = src + y * stride;
+
+    if(bpp == 16)
+        return row[x * 2] | (row[x * 2 + 1] << 8);
+    else if(bpp == 8)
+        return row[x];
+    else
+        return (row[x / 2] >> ((x & 1) * 4)) & 15;
+}
+
+static void put_texel(uint8_t *dst, size_t idx, uint32_t v, unsigned int bpp) {
+    if(bpp == 16) {
+        dst[idx * 2] = v;
+        dst[idx * 2 + 1] = v >> 8;
+    }
+    else if(bpp == 8) {
+        dst[idx] = v;
+    }
+    else {
+        dst[idx / 2] &= ~(15 << ((idx & 1) * 4));
+        dst[idx / 2] |= v << ((idx & 1) * 4);
+    }
+}
+
+static void ref_twiddle(uint8_t *dst, const uint8_t *src, uint32_t w,
+                        uint32_t h, size_t stride, uint32_t flags) {
+    unsigned int bpp = fmt_bpp(flags);
+    uint32_t x, y, sy, n = MIN(w, h), mask = n - 1;
+    size_t idx;
+
+    if(!stride)
+        stride = (w * bpp + 7) / 8;
+
+    for(y = 0; y < h; y++) {
+        sy = (flags & PVR_TXRLOAD_INVERT_Y) ? h - 1 - y : y;
+
+        for(x = 0; x < w; x++) {
+            idx = TWIDOUT(x & mask, y & mask) + (x / n + y / n) * n * n;
+            put_texel(dst, idx, get_texel(src, stride, x, sy, bpp), bpp);
+        }
+    }
+}
+
+/* Offsets of the mipmap levels at 16bpp, from utils/pvrtex */
+static const size_t mip_ofs[11] = {
+    0x00006, 0x00008, 0x00010, 0x00030, 0x000B0, 0x002B0, 0x00AB0, 0x02AB0,
+    0x0AAB0, 0x2AAB0, 0xAAAB0
+};
+
+static size_t tex_size(uint32_t w, uint32_t h, unsigned int bpp) {
+    return ((size_t)w * h * bpp + 7) / 8;
+}
+
+static void test_old_load_ex(void) {
+    uint32_t w, h, invert;
+    unsigned int bpp;
+    uint8_t *src, *a, *b;
+    size_t size;
+    int f;
+
+    for(f = 0; f < 3; f++) {
+        bpp = fmt_bpp(fmts[f]);
+
+        for(w = 8; w <= 1024; w <<= 1) {
+            for(h = 8; h <= 1024; h <<= 1) {
+                size = tex_size(w, h, bpp);
+                src = malloc(size);
+                a = calloc(1, size);
+                b = calloc(1, size);
+                fill_random(src, size);
+
+                /* The old loops swap rows when inverting 4bpp and 8bpp */
+                for(invert = 0; invert <= (bpp == 16); invert++) {
+                    uint32_t flags = fmts[f] |
+                                     (invert ? PVR_TXRLOAD_INVERT_Y : 0);
+
+                    old_load_ex(src, a, w, h, flags);
+                    CHECK(pvr_txr_twiddle(b, src, w, h, 0, flags) == 0,
+                          "%ux%u %ubpp failed", w, h, bpp);
+                    CHECK(!memcmp(a, b, size), "%ux%u %ubpp%s differs",
+                          w, h, bpp, invert ? " inverted" : "");
+                }
+
+                free(src);
+                free(a);
+                free(b);
+            }
+        }
+    }
+}
+
+static void test_reference(void) {
+    static const uint32_t sizes[][2] = {
+        { 1, 1 }, { 2, 1 }, { 1, 4 }, { 2, 2 }, { 4, 4 }, { 8, 8 },
+        { 64, 8 }, { 8, 32 }, { 32, 32 }, { 128, 16 }, { 16, 256 }
+    };
+    uint32_t w, h, flags;
+    unsigned int bpp, i, invert, pad;
+    uint8_t *src, *a, *b;
+    size_t size, stride;
+    int f;
+
+    for(f = 0; f < 3; f++) {
+        bpp = fmt_bpp(fmts[f]);
+
+        for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            w = sizes[i][0];
+            h = sizes[i][1];
+
+            for(invert = 0; invert < 2; invert++) {
+                for(pad = 0; pad < 2; pad++) {
+                    /* Twiddle part of a larger image, into an unaligned
+                       buffer */
+                    stride = (w * bpp + 7) / 8 + pad * 6;
+                    size = tex_size(w, h, bpp);
+                    src = malloc(stride * h);
+                    a = calloc(1, size);
+                    b = calloc(1, size + 1);
+                    fill_random(src, stride * h);
+
+                    flags = fmts[f] | (invert ? PVR_TXRLOAD_INVERT_Y : 0);
+                    ref_twiddle(a, src, w, h, stride, flags);
+                    CHECK(pvr_txr_twiddle(b + pad, src, w, h, pad ? stride : 0,
+                                          flags) == 0,
+                          "%ux%u %ubpp failed", w, h, bpp);
+                    CHECK(!memcmp(a, b + pad, size),
+                          "%ux%u %ubpp, inverted %u, stride %zu differs",
+                          w, h, bpp, invert, stride);
+
+                    free(src);
+                    free(a);
+                    free(b);
+                }
+            }
+        }
+    }
+}
+
+static void test_mipmaps(void) {
+    const void *levels[11];
+    uint8_t *data[11], *a, *b;
+    uint32_t size, s, flags;
+    unsigned int bpp, l, invert;
+    size_t total;
+    int f;
+
+    for(f = 0; f < 3; f++) {
+        bpp = fmt_bpp(fmts[f]);
+
+        for(l = 0; l <= 10; l++)
+            CHECK(pvr_txr_mipmap_offset(1 << l, fmts[f]) ==
+                  mip_ofs[l] * bpp / 16,
+                  "offset of level %u at %ubpp", l, bpp);
+
+        for(size = 8; size <= 256; size <<= 1) {
+            for(invert = 0; invert < 2; invert++) {
+                flags = fmts[f] | (invert ? PVR_TXRLOAD_INVERT_Y : 0);
+                total = pvr_txr_mipmap_offset(size * 2, fmts[f]);
+                a = calloc(1, total);
+                b = malloc(total);
+                memset(b, 0xaa, total);
+
+                for(s = size, l = 0; s; s >>= 1, l++) {
+                    data[l] = malloc(tex_size(s, s, bpp));
+                    fill_random(data[l], tex_size(s, s, bpp));
+                    levels[l] = data[l];
+                    ref_twiddle(a + pvr_txr_mipmap_offset(s, fmts[f]), data[l],
+                                s, s, 0, flags);
+                }
+
+                CHECK(pvr_txr_twiddle_mipmaps(b, levels, size, flags) == 0,
+                      "%u %ubpp failed", size, bpp);
+                CHECK(!memcmp(a, b, total), "%u %ubpp, inverted %u differs",
+                      size, bpp, invert);
+
+                for(l = 0; (1u << l) <= size; l++)
+                    free(data[l]);
+
+                free(a);
+                free(b);
+            }
+        }
+    }
+}
+
+static void test_invalid(void) {
+    uint8_t buf[64];
+    const void *levels[4] = { buf, buf, buf, NULL };
+
+    errno = 0;
+    CHECK(pvr_txr_twiddle(buf, buf, 8, 12, 0, PVR_TXRLOAD_8BPP) == -1 &&
+          errno == EINVAL, "non power of two accepted");
+    CHECK(pvr_txr_twiddle(buf, buf, 2048, 8, 0, PVR_TXRLOAD_8BPP) == -1,
+          "oversized texture accepted");
+    CHECK(pvr_txr_twiddle(buf, buf, 8, 8, 4, PVR_TXRLOAD_8BPP) == -1,
+          "short stride accepted");
+    CHECK(pvr_txr_twiddle(buf, buf + 1, 4, 4, 0, PVR_TXRLOAD_16BPP) == -1,
+          "unaligned 16bpp source accepted");
+    CHECK(pvr_txr_twiddle(buf, buf, 8, 8, 0, 0) == -1,
+          "no format accepted");
+    CHECK(pvr_txr_twiddle(buf, buf, 8, 8, 0,
+                          PVR_TXRLOAD_8BPP | PVR_TXRLOAD_VQ_LOAD) == -1,
+          "VQ accepted");
+    CHECK(pvr_txr_twiddle_mipmaps(buf, levels, 8, PVR_TXRLOAD_4BPP) == -1,
+          "missing level accepted");
+    CHECK(pvr_txr_mipmap_offset(12, PVR_TXRLOAD_8BPP) == 0,
+          "offset of invalid level");
+}
+
+static void bench(double seconds) {
+    static const char *names[3] = { "4bpp", "8bpp", "16bpp" };
+    uint32_t w = 512, h = 256;
+    unsigned int bpp;
+    uint8_t *src, *dst;
+    size_t size, n;
+    double start, t_old, t_new;
+    int f;
+
+    for(f = 0; f < 3; f++) {
+        bpp = fmt_bpp(fmts[f]);
+        size = tex_size(w, h, bpp);
+        src = malloc(size);
+        dst = malloc(size);
+        fill_random(src, size);
+
+        start = now();
+        n = 0;
+
+        do {
+            old_load_ex(src, dst, w, h, fmts[f]);
+            n++;
+        } while((t_old = now() - start) < seconds / 2);
+
+        t_old /= n;
+        start = now();
+        n = 0;
+
+        do {
+            pvr_txr_twiddle(dst, src, w, h, 0, fmts[f]);
+            n++;
+        } while((t_new = now() - start) < seconds / 2);
+
+        t_new /= n;
+
+        printf("%ux%u %-5s: %8.1f us before, %8.1f us now, %.1fx faster\n",
+               w, h, names[f], t_old * 1e6, t_new * 1e6, t_old / t_new);
+
+        free(src);
+        free(dst);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b] [-t seconds]\n\n"
+            "  -b  run the benchmark instead of the tests\n"
+            "  -t  duration of the benchmark, per format (default 1)\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    int c, do_bench = 0;
+
+    srand(1);
+
+    while((c = getopt(argc, argv, "bt:")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            case 't':
+                seconds = strtod(optarg, NULL);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(do_bench) {
+        bench(seconds);
+        return 0;
+    }
+
+    test_old_load_ex();
+    test_reference();
+    test_mipmaps();
+    test_invalid();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
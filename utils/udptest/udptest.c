@@ -0,0 +1,830 @@
+/* KallistiOS ##version##
+
+   udptest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the UDP layer in kernel/net/net_udp.c,
+   which is built as-is on the host. The IP layer underneath it is replaced
+   by a loopback that hands every datagram sent straight back to the UDP
+   input path, the same way net_ipv4.c does for 127.0.0.1 on a Dreamcast.
+
+   The tests check that datagrams come out of each socket's receive ring in
+   the order they went in and unchanged, including when the ring wraps
+   around, that datagrams that don't fit are dropped and counted, that
+   SO_RCVBUF resizes the ring without losing what's queued, and that
+   recvmmsg() and sendmmsg() behave like the calls they batch up. The
+   benchmark (-b) times sending and receiving a datagram at a time against
+   doing it in batches.
+*/
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <kos/net.h>
+#include <kos/fs_socket.h>
+#include <kos/genwait.h>
+#include <arch/timer.h>
+
+#include "../../kernel/net/net_ipv4.h"
+#include "../../kernel/net/net_ipv6.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* What net_udp.c needs from the rest of the kernel */
+
+const struct in6_addr in6addr_any = IN6ADDR_ANY_INIT;
+const struct in6_addr in6addr_loopback = IN6ADDR_LOOPBACK_INIT;
+
+static netif_t loop_if = { .name = "lo", .ip_addr = { 127, 0, 0, 1 } };
+netif_t *net_default_dev = &loop_if;
+
+static fs_socket_proto_t *udp_proto;
+
+uint64 timer_ms_gettime64(void) {
+    return (uint64)(now() * 1000.0);
+}
+
+uint32_t htonl(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+uint32_t ntohl(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+uint16_t htons(uint16_t value) {
+    return __builtin_bswap16(value);
+}
+
+uint16_t ntohs(uint16_t value) {
+    return __builtin_bswap16(value);
+}
+
+uint32 net_ipv4_address(const uint8 addr[4]) {
+    return (addr[0] << 24) | (addr[1] << 16) | (addr[2] << 8) | addr[3];
+}
+
+/* Checksums aren't what's being tested, so they always come out right. */
+uint16 net_ipv4_checksum(const uint8 *data, size_t bytes, uint16 start) {
+    (void)data;
+    (void)bytes;
+    (void)start;
+    return 0;
+}
+
+uint16 net_ipv4_checksum_pseudo(in_addr_t src, in_addr_t dst, uint8 proto,
+                                uint16 len) {
+    (void)src;
+    (void)dst;
+    (void)proto;
+    (void)len;
+    return 0;
+}
+
+uint16 net_ipv6_checksum_pseudo(const struct in6_addr *src,
+                                const struct in6_addr *dst,
+                                uint32 upper_len, uint8 next_hdr) {
+    (void)src;
+    (void)dst;
+    (void)upper_len;
+    (void)next_hdr;
+    return 0;
+}
+
+/* The loopback: every datagram goes straight back in. */
+int net_ipv6_send(netif_t *net, const uint8 *data, size_t data_size,
+                  int hop_limit, int proto, const struct in6_addr *src,
+                  const struct in6_addr *dst) {
+    ip_hdr_t ip;
+    ipv6_hdr_t ip6;
+
+    (void)hop_limit;
+
+    if(IN6_IS_ADDR_V4MAPPED(dst)) {
+        memset(&ip, 0, sizeof(ip));
+        ip.protocol = proto;
+        ip.src = src->__s6_addr.__s6_addr32[3];
+        ip.dest = dst->__s6_addr.__s6_addr32[3];
+        udp_proto->input(net, AF_INET, &ip, data, data_size);
+    }
+    else {
+        memset(&ip6, 0, sizeof(ip6));
+        ip6.next_header = proto;
+        ip6.src_addr = *src;
+        ip6.dst_addr = *dst;
+        udp_proto->input(net, AF_INET6, &ip6, data, data_size);
+    }
+
+    return 0;
+}
+
+int fs_socket_proto_add(fs_socket_proto_t *proto) {
+    if(proto->protocol == IPPROTO_UDP)
+        udp_proto = proto;
+
+    return 0;
+}
+
+int fs_socket_proto_remove(fs_socket_proto_t *proto) {
+    (void)proto;
+    return 0;
+}
+
+void __poll_event_trigger(int fd, short event) {
+    (void)fd;
+    (void)event;
+}
+
+/* Nothing runs in an interrupt, so malloc() can always be called. */
+int malloc_irq_safe(void) {
+    return 1;
+}
+
+/* A wake can come in between net_udp.c dropping its lock and waiting here,
+   so waits are kept short, and the caller checks again. */
+static pthread_mutex_t gw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gw_cond = PTHREAD_COND_INITIALIZER;
+
+int genwait_wait(void *obj, const char *mutex_name, int timeout,
+                 void (*callback)(void *)) {
+    struct timespec ts;
+
+    (void)obj;
+    (void)mutex_name;
+    (void)callback;
+
+    if(!timeout || timeout > 10)
+        timeout = 10;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += timeout * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&gw_mutex);
+    pthread_cond_timedwait(&gw_cond, &gw_mutex, &ts);
+    pthread_mutex_unlock(&gw_mutex);
+
+    return 0;
+}
+
+int genwait_wake_one(void *obj) {
+    (void)obj;
+    pthread_mutex_lock(&gw_mutex);
+    pthread_cond_broadcast(&gw_cond);
+    pthread_mutex_unlock(&gw_mutex);
+    return 1;
+}
+
+int genwait_wake_all(void *obj) {
+    return genwait_wake_one(obj);
+}
+
+/* Helpers */
+
+#define PORT_A  5000
+#define PORT_B  5001
+
+static struct sockaddr_in addr_of(int port) {
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(0x7F000001);
+    return addr;
+}
+
+static int sock_open(net_socket_t *s, int port) {
+    struct sockaddr_in addr = addr_of(port);
+
+    memset(s, 0, sizeof(*s));
+    s->protocol = udp_proto;
+
+    if(udp_proto->socket(s, AF_INET, SOCK_DGRAM, IPPROTO_UDP))
+        return -1;
+
+    return udp_proto->bind(s, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void sock_close(net_socket_t *s) {
+    udp_proto->close(s);
+}
+
+static int set_int(net_socket_t *s, int opt, int val) {
+    return udp_proto->setsockopt(s, SOL_SOCKET, opt, &val, sizeof(val));
+}
+
+static int get_int(net_socket_t *s, int opt) {
+    int val = -1;
+    socklen_t len = sizeof(val);
+
+    udp_proto->getsockopt(s, SOL_SOCKET, opt, &val, &len);
+    return val;
+}
+
+static ssize_t send_to(net_socket_t *s, const void *buf, size_t len,
+                       int port) {
+    struct sockaddr_in addr = addr_of(port);
+
+    return udp_proto->sendto(s, buf, len, 0, (struct sockaddr *)&addr,
+                             sizeof(addr));
+}
+
+/* Datagrams carry their sequence number, then bytes derived from it. */
+static size_t make_dgram(uint8_t *buf, uint32_t seq, size_t len) {
+    size_t i;
+
+    memcpy(buf, &seq, sizeof(seq));
+
+    for(i = sizeof(seq); i < len; i++)
+        buf[i] = (uint8_t)(seq * 31 + i);
+
+    return len;
+}
+
+static int check_dgram(const uint8_t *buf, uint32_t seq, size_t len) {
+    uint8_t want[2048];
+
+    make_dgram(want, seq, len);
+    return !memcmp(buf, want, len);
+}
+
+/* Tests */
+
+static void test_basic(void) {
+    net_socket_t a, b;
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    char buf[64];
+    ssize_t rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+    CHECK(!(udp_proto->poll(&a, POLLRDNORM) & POLLRDNORM),
+          "readable with nothing queued");
+
+    CHECK(send_to(&b, "hello", 5, PORT_A) == 5, "sendto failed");
+    CHECK(udp_proto->poll(&a, POLLRDNORM) & POLLRDNORM, "not readable");
+
+    rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_PEEK, NULL, NULL);
+    CHECK(rv == 5, "peek returned %zd", rv);
+
+    rv = udp_proto->recvfrom(&a, buf, sizeof(buf), 0,
+                             (struct sockaddr *)&from, &fromlen);
+    CHECK(rv == 5 && !memcmp(buf, "hello", 5), "recvfrom returned %zd", rv);
+    CHECK(fromlen == sizeof(from) && from.sin_family == AF_INET &&
+          ntohs(from.sin_port) == PORT_B &&
+          from.sin_addr.s_addr == htonl(0x7F000001), "wrong source address");
+
+    /* A short buffer gets the start of the datagram, and the rest is gone. */
+    send_to(&b, "truncated", 9, PORT_A);
+    send_to(&b, "next", 4, PORT_A);
+    rv = udp_proto->recvfrom(&a, buf, 5, 0, NULL, NULL);
+    CHECK(rv == 5 && !memcmp(buf, "trunc", 5), "short read returned %zd", rv);
+    rv = udp_proto->recvfrom(&a, buf, sizeof(buf), 0, NULL, NULL);
+    CHECK(rv == 4 && !memcmp(buf, "next", 4), "next read returned %zd", rv);
+
+    rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL, NULL);
+    CHECK(rv == -1 && errno == EWOULDBLOCK, "empty read returned %zd", rv);
+
+    CHECK(get_int(&a, SO_RCVBUF) == NET_UDP_RCVBUF, "default SO_RCVBUF is %d",
+          get_int(&a, SO_RCVBUF));
+    CHECK(get_int(&a, SO_RCVDROPS) == 0, "drops on a new socket");
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static void test_drops(void) {
+    net_socket_t a, b;
+    uint8_t buf[2048];
+    net_udp_stats_t before, after;
+    int sent = 64, recvd = 0, drops;
+    ssize_t rv;
+    uint32_t seq;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+    CHECK(!set_int(&a, SO_RCVBUF, 2048), "SO_RCVBUF failed");
+    CHECK(get_int(&a, SO_RCVBUF) == 2048, "SO_RCVBUF is %d",
+          get_int(&a, SO_RCVBUF));
+
+    before = net_udp_get_stats();
+
+    for(seq = 0; seq < (uint32_t)sent; seq++) {
+        make_dgram(buf, seq, 100);
+        CHECK(send_to(&b, buf, 100, PORT_A) == 100, "sendto failed");
+    }
+
+    after = net_udp_get_stats();
+    drops = get_int(&a, SO_RCVDROPS);
+    CHECK(drops > 0 && drops < sent, "%d drops", drops);
+    CHECK(after.pkt_recv_dropped - before.pkt_recv_dropped == (uint32)drops,
+          "stats count %u drops, the socket %d",
+          after.pkt_recv_dropped - before.pkt_recv_dropped, drops);
+
+    /* The ones that made it are the first ones, in order. */
+    while((rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                                    NULL)) > 0) {
+        CHECK(rv == 100 && check_dgram(buf, recvd, 100),
+              "datagram %d is wrong", recvd);
+        recvd++;
+    }
+
+    CHECK(recvd + drops == sent, "%d received, %d dropped of %d", recvd,
+          drops, sent);
+
+    /* With SO_RCVBUF set, anything bigger than the whole ring can never
+       fit, and the ring isn't grown for it. */
+    make_dgram(buf, 0, 2040);
+    send_to(&b, buf, 2040, PORT_A);
+    CHECK(get_int(&a, SO_RCVDROPS) == drops + 1, "oversize not dropped");
+    CHECK(get_int(&a, SO_RCVBUF) == 2048, "SO_RCVBUF grew to %d",
+          get_int(&a, SO_RCVBUF));
+    CHECK(udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                              NULL) == -1, "oversize queued");
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+/* Random sends and receives, checked against a simple queue of what should
+   be in the ring, so that it wraps around at every sort of place. */
+static void test_wrap(void) {
+    net_socket_t a, b;
+    uint8_t buf[2048];
+    uint32_t q_seq[64], q_len[64];
+    int q_head = 0, q_count = 0, drops = 0, i, n;
+    uint32_t seq = 0, len;
+    ssize_t rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+    CHECK(!set_int(&a, SO_RCVBUF, 2048), "SO_RCVBUF failed");
+    srand(1234);
+
+    for(i = 0; i < 50000; i++) {
+        if(rand() % 2) {
+            len = 4 + rand() % (rand() % 8 ? 200 : 900);
+            make_dgram(buf, seq, len);
+            CHECK(send_to(&b, buf, len, PORT_A) == (ssize_t)len,
+                  "sendto failed");
+            n = get_int(&a, SO_RCVDROPS);
+
+            if(n == drops) {
+                CHECK(q_count < 64, "too many queued");
+                q_seq[(q_head + q_count) % 64] = seq;
+                q_len[(q_head + q_count) % 64] = len;
+                q_count++;
+            }
+            else {
+                /* Only drop when it really is too full. */
+                CHECK(q_count > 0, "dropped with the ring empty");
+                drops = n;
+            }
+
+            seq++;
+        }
+        else {
+            rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                                     NULL);
+
+            if(!q_count) {
+                CHECK(rv == -1, "got a datagram that should not be there");
+                continue;
+            }
+
+            CHECK(rv == (ssize_t)q_len[q_head] &&
+                  check_dgram(buf, q_seq[q_head], rv),
+                  "datagram %u is wrong (%zd bytes)", q_seq[q_head], rv);
+            q_head = (q_head + 1) % 64;
+            q_count--;
+        }
+    }
+
+    CHECK(drops > 0, "never dropped anything");
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static void test_resize(void) {
+    net_socket_t a, b;
+    uint8_t buf[2048];
+    uint32_t seq;
+    int drops;
+    ssize_t rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+
+    for(seq = 0; seq < 30; seq++) {
+        make_dgram(buf, seq, 200);
+        send_to(&b, buf, 200, PORT_A);
+    }
+
+    CHECK(get_int(&a, SO_RCVDROPS) == 0, "dropped with the default size");
+
+    /* Growing keeps everything. */
+    CHECK(!set_int(&a, SO_RCVBUF, 131072), "SO_RCVBUF failed");
+    CHECK(get_int(&a, SO_RCVBUF) == 131072, "SO_RCVBUF is %d",
+          get_int(&a, SO_RCVBUF));
+    CHECK(get_int(&a, SO_RCVDROPS) == 0, "dropped growing the ring");
+
+    rv = udp_proto->recvfrom(&a, buf, sizeof(buf), 0, NULL, NULL);
+    CHECK(rv == 200 && check_dgram(buf, 0, 200), "first datagram is wrong");
+
+    /* Shrinking keeps the oldest, and counts the rest as drops. Sizes below
+       the minimum are rounded up to it. */
+    CHECK(!set_int(&a, SO_RCVBUF, 1), "SO_RCVBUF failed");
+    CHECK(get_int(&a, SO_RCVBUF) == 2048, "SO_RCVBUF is %d",
+          get_int(&a, SO_RCVBUF));
+    drops = get_int(&a, SO_RCVDROPS);
+    CHECK(drops > 0 && drops < 29, "%d dropped shrinking the ring", drops);
+
+    for(seq = 1; seq < (uint32_t)(30 - drops); seq++) {
+        rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                                 NULL);
+        CHECK(rv == 200 && check_dgram(buf, seq, 200),
+              "datagram %u is wrong", seq);
+    }
+
+    CHECK(udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                              NULL) == -1, "too many datagrams kept");
+
+    CHECK(set_int(&a, SO_RCVDROPS, 0) == -1 && errno == EINVAL,
+          "SO_RCVDROPS can be set");
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static void test_recvmmsg(void) {
+    net_socket_t a, b;
+    struct mmsghdr msgs[8];
+    struct iovec iov[8][2];
+    struct sockaddr_in from[8];
+    uint8_t bufs[8][2][64];
+    uint8_t whole[128];
+    struct timespec ts = { 0, 50 * 1000000 };
+    uint32_t seq;
+    double t;
+    int i, rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+
+    memset(msgs, 0, sizeof(msgs));
+
+    for(i = 0; i < 8; i++) {
+        iov[i][0].iov_base = bufs[i][0];
+        iov[i][0].iov_len = 10;
+        iov[i][1].iov_base = bufs[i][1];
+        iov[i][1].iov_len = 64;
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+    }
+
+    for(seq = 0; seq < 5; seq++) {
+        make_dgram(whole, seq, 50 + seq);
+        send_to(&b, whole, 50 + seq, PORT_A);
+    }
+
+    /* Everything queued comes out at once, scattered over both buffers. */
+    rv = udp_proto->recvmmsg(&a, msgs, 8, MSG_WAITFORONE, NULL);
+    CHECK(rv == 5, "recvmmsg returned %d", rv);
+
+    for(i = 0; i < 5; i++) {
+        memcpy(whole, bufs[i][0], 10);
+        memcpy(whole + 10, bufs[i][1], 64);
+        CHECK(msgs[i].msg_len == 50u + i && check_dgram(whole, i, 50 + i),
+              "message %d is wrong", i);
+        CHECK(ntohs(from[i].sin_port) == PORT_B &&
+              msgs[i].msg_hdr.msg_namelen == sizeof(from[i]),
+              "message %d has the wrong address", i);
+        CHECK(!(msgs[i].msg_hdr.msg_flags & MSG_TRUNC),
+              "message %d truncated", i);
+    }
+
+    /* Too big for the buffers. */
+    make_dgram(whole, 9, 100);
+    send_to(&b, whole, 100, PORT_A);
+    rv = udp_proto->recvmmsg(&a, msgs, 1, 0, NULL);
+    CHECK(rv == 1 && msgs[0].msg_len == 74 &&
+          (msgs[0].msg_hdr.msg_flags & MSG_TRUNC), "no MSG_TRUNC");
+
+    /* Peeking only sees the first. */
+    send_to(&b, "one", 3, PORT_A);
+    send_to(&b, "two", 3, PORT_A);
+    rv = udp_proto->recvmmsg(&a, msgs, 8, MSG_PEEK, NULL);
+    CHECK(rv == 1 && msgs[0].msg_len == 3, "peek returned %d", rv);
+    rv = udp_proto->recvmmsg(&a, msgs, 8, MSG_DONTWAIT, NULL);
+    CHECK(rv == 2 && !memcmp(bufs[0][0], "one", 3) &&
+          !memcmp(bufs[1][0], "two", 3), "peeked message went missing");
+
+    rv = udp_proto->recvmmsg(&a, msgs, 8, MSG_DONTWAIT, NULL);
+    CHECK(rv == -1 && errno == EWOULDBLOCK, "empty recvmmsg returned %d", rv);
+
+    /* An empty vector isn't an error. */
+    errno = 0;
+    rv = udp_proto->recvmmsg(&a, msgs, 0, MSG_DONTWAIT, NULL);
+    CHECK(rv == 0 && errno == 0, "recvmmsg of nothing returned %d", rv);
+
+    /* Nothing arrives before the timeout. */
+    t = now();
+    rv = udp_proto->recvmmsg(&a, msgs, 8, 0, &ts);
+    t = now() - t;
+    CHECK(rv == -1 && errno == EAGAIN, "timed out recvmmsg returned %d", rv);
+    CHECK(t > 0.04 && t < 1.0, "timed out after %.3fs", t);
+
+    /* Without MSG_WAITFORONE, it waits out the timeout for the rest. */
+    send_to(&b, "x", 1, PORT_A);
+    send_to(&b, "y", 1, PORT_A);
+    t = now();
+    rv = udp_proto->recvmmsg(&a, msgs, 8, 0, &ts);
+    t = now() - t;
+    CHECK(rv == 2, "recvmmsg returned %d", rv);
+    CHECK(t > 0.04, "returned after %.3fs", t);
+
+    msgs[0].msg_hdr.msg_iovlen = 0;
+    rv = udp_proto->recvmmsg(&a, msgs, 8, MSG_DONTWAIT, NULL);
+    CHECK(rv == -1 && errno == EMSGSIZE, "no buffers returned %d", rv);
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static net_socket_t *late_sock;
+
+static void *late_sender(void *arg) {
+    (void)arg;
+    usleep(30000);
+    send_to(late_sock, "late", 4, PORT_A);
+    return NULL;
+}
+
+static void test_wait(void) {
+    net_socket_t a, b;
+    struct mmsghdr msg;
+    struct iovec iov;
+    char buf[16];
+    pthread_t thd;
+    int rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = sizeof(buf);
+    msg.msg_hdr.msg_iov = &iov;
+    msg.msg_hdr.msg_iovlen = 1;
+
+    late_sock = &b;
+    pthread_create(&thd, NULL, late_sender, NULL);
+    rv = udp_proto->recvmmsg(&a, &msg, 1, MSG_WAITFORONE, NULL);
+    pthread_join(thd, NULL);
+    CHECK(rv == 1 && msg.msg_len == 4 && !memcmp(buf, "late", 4),
+          "blocking recvmmsg returned %d", rv);
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static void test_sendmmsg(void) {
+    net_socket_t a, b;
+    struct mmsghdr msgs[20];
+    struct iovec iov[20][2];
+    struct sockaddr_in to = addr_of(PORT_A);
+    uint8_t data[20][64], buf[128];
+    int i, rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+    CHECK(!set_int(&a, SO_RCVBUF, 65536), "SO_RCVBUF failed");
+
+    memset(msgs, 0, sizeof(msgs));
+
+    /* Enough to take more than one batch, each gathered from two buffers. */
+    for(i = 0; i < 20; i++) {
+        make_dgram(data[i], i, 40 + i);
+        iov[i][0].iov_base = data[i];
+        iov[i][0].iov_len = 7;
+        iov[i][1].iov_base = data[i] + 7;
+        iov[i][1].iov_len = 33 + i;
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+        msgs[i].msg_hdr.msg_name = &to;
+        msgs[i].msg_hdr.msg_namelen = sizeof(to);
+    }
+
+    rv = udp_proto->sendmmsg(&b, msgs, 20, 0);
+    CHECK(rv == 20, "sendmmsg returned %d", rv);
+
+    for(i = 0; i < 20; i++) {
+        CHECK(msgs[i].msg_len == 40u + i, "message %d has length %u", i,
+              msgs[i].msg_len);
+        rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                                 NULL);
+        CHECK(rv == 40 + i && check_dgram(buf, i, 40 + i),
+              "datagram %d is wrong", i);
+    }
+
+    /* The messages before a bad one still go, and the count says where it
+       stopped. */
+    msgs[11].msg_hdr.msg_namelen = 3;
+    rv = udp_proto->sendmmsg(&b, msgs, 20, 0);
+    CHECK(rv == 11, "sendmmsg returned %d", rv);
+
+    for(i = 0; i < 11; i++) {
+        rv = udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                                 NULL);
+        CHECK(rv == 40 + i, "datagram %d missing", i);
+    }
+
+    CHECK(udp_proto->recvfrom(&a, buf, sizeof(buf), MSG_DONTWAIT, NULL,
+                              NULL) == -1, "sent past the bad message");
+
+    rv = udp_proto->sendmmsg(&b, msgs + 11, 1, 0);
+    CHECK(rv == -1 && errno == EINVAL, "bad message returned %d", rv);
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static void test_sizes(void) {
+    net_socket_t a, b;
+    static uint8_t big[65536];
+    ssize_t rv;
+
+    CHECK(!sock_open(&a, PORT_A) && !sock_open(&b, PORT_B), "socket setup");
+
+    /* The default receive buffer grows to fit the largest datagram, without
+       losing what's already queued */
+    send_to(&b, "queued", 6, PORT_A);
+    make_dgram(big, 3, 65527);
+    rv = send_to(&b, big, 65527, PORT_A);
+    CHECK(rv == 65527, "largest datagram returned %zd", rv);
+    CHECK(get_int(&a, SO_RCVDROPS) == 0,
+          "largest datagram dropped with the default SO_RCVBUF");
+    CHECK(get_int(&a, SO_RCVBUF) > 65527, "SO_RCVBUF is %d",
+          get_int(&a, SO_RCVBUF));
+    rv = udp_proto->recvfrom(&a, big, sizeof(big), MSG_DONTWAIT, NULL, NULL);
+    CHECK(rv == 6 && !memcmp(big, "queued", 6),
+          "queued datagram came back as %zd", rv);
+    memset(big, 0, sizeof(big));
+    rv = udp_proto->recvfrom(&a, big, sizeof(big), MSG_DONTWAIT, NULL, NULL);
+    CHECK(rv == 65527 && big[65526] == (uint8_t)(3 * 31 + 65526),
+          "largest datagram came back as %zd", rv);
+
+    CHECK(!set_int(&a, SO_RCVBUF, 1 << 30), "SO_RCVBUF failed");
+    CHECK(get_int(&a, SO_RCVBUF) == 1024 * 1024, "SO_RCVBUF is %d",
+          get_int(&a, SO_RCVBUF));
+
+    make_dgram(big, 7, 65527);
+    rv = send_to(&b, big, 65527, PORT_A);
+    CHECK(rv == 65527, "largest datagram returned %zd", rv);
+    memset(big, 0, sizeof(big));
+    rv = udp_proto->recvfrom(&a, big, sizeof(big), 0, NULL, NULL);
+    CHECK(rv == 65527 && big[65526] == (uint8_t)(7 * 31 + 65526),
+          "largest datagram came back as %zd", rv);
+
+    rv = send_to(&b, big, 65528, PORT_A);
+    CHECK(rv == -1 && errno == EMSGSIZE, "oversized datagram returned %zd",
+          rv);
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+/* Benchmark */
+
+#define BENCH_DGRAMS    200000
+#define BENCH_BATCH     32
+
+static void bench(void) {
+    net_socket_t a, b;
+    struct sockaddr_in to = addr_of(PORT_A);
+    struct mmsghdr smsgs[BENCH_BATCH], rmsgs[BENCH_BATCH];
+    struct iovec siov, riov[BENCH_BATCH];
+    uint8_t data[64], rbuf[BENCH_BATCH][64];
+    double t, single, batched;
+    int i, j;
+
+    if(sock_open(&a, PORT_A) || sock_open(&b, PORT_B)) {
+        printf("socket setup failed\n");
+        return;
+    }
+
+    make_dgram(data, 1, sizeof(data));
+
+    t = now();
+
+    for(i = 0; i < BENCH_DGRAMS; i++) {
+        send_to(&b, data, sizeof(data), PORT_A);
+        udp_proto->recvfrom(&a, rbuf[0], sizeof(rbuf[0]), 0, NULL, NULL);
+    }
+
+    single = (now() - t) / BENCH_DGRAMS;
+
+    memset(smsgs, 0, sizeof(smsgs));
+    memset(rmsgs, 0, sizeof(rmsgs));
+    siov.iov_base = data;
+    siov.iov_len = sizeof(data);
+
+    for(j = 0; j < BENCH_BATCH; j++) {
+        smsgs[j].msg_hdr.msg_iov = &siov;
+        smsgs[j].msg_hdr.msg_iovlen = 1;
+        smsgs[j].msg_hdr.msg_name = &to;
+        smsgs[j].msg_hdr.msg_namelen = sizeof(to);
+        riov[j].iov_base = rbuf[j];
+        riov[j].iov_len = sizeof(rbuf[j]);
+        rmsgs[j].msg_hdr.msg_iov = &riov[j];
+        rmsgs[j].msg_hdr.msg_iovlen = 1;
+    }
+
+    t = now();
+
+    for(i = 0; i < BENCH_DGRAMS; i += BENCH_BATCH) {
+        udp_proto->sendmmsg(&b, smsgs, BENCH_BATCH, 0);
+        udp_proto->recvmmsg(&a, rmsgs, BENCH_BATCH, MSG_WAITFORONE, NULL);
+    }
+
+    batched = (now() - t) / BENCH_DGRAMS;
+
+    printf("%d datagrams of %d bytes, over the loopback:\n", BENCH_DGRAMS,
+           (int)sizeof(data));
+    printf("  sendto() + recvfrom():      %8.3f us/datagram\n", single * 1e6);
+    printf("  sendmmsg() + recvmmsg(%d):  %8.3f us/datagram\n", BENCH_BATCH,
+           batched * 1e6);
+    printf("  drops: %d\n", get_int(&a, SO_RCVDROPS));
+
+    sock_close(&a);
+    sock_close(&b);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-b]\n"
+            "  -b  run the benchmark instead of the tests\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int c, do_bench = 0;
+
+    while((c = getopt(argc, argv, "b")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    net_udp_init();
+
+    if(do_bench) {
+        bench();
+        return 0;
+    }
+
+    test_basic();
+    test_drops();
+    test_wrap();
+    test_resize();
+    test_recvmmsg();
+    test_wait();
+    test_sendmmsg();
+    test_sizes();
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
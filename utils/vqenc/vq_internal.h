@@ -11,6 +11,18 @@ static void inline get_color(fcolor_t *c, uint8 *pixels) {
     c->b = pixels[3];
 }
 
+/* the components of a quad, in the order distances are summed in */
+static void inline get_components(float *out, const fquad_t *q) {
+    int i;
+
+    for(i = 0; i < 4; i++) {
+        *out++ = q->p[i].a;
+        *out++ = q->p[i].r;
+        *out++ = q->p[i].g;
+        *out++ = q->p[i].b;
+    }
+}
+
 static void inline sum_colors(fcolor_t *out, fcolor_t *in) {
     out->a += in->a;
     out->r += in->r;
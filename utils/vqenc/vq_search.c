@@ -0,0 +1,290 @@
+/* KallistiOS ##version##
+
+   vq_search.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Finding the closest codebook entry to each quad is where vqenc spends
+   nearly all of its time. The original search computed delta_e() for every
+   entry, with a sqrt each time. This one keeps its exact results:
+
+   - Each distance is accumulated the same way delta_e() does it: the
+     squares are rounded to float and summed in double, in the same order.
+     So the totals are bit for bit identical.
+   - sqrt is monotonic, so an entry whose squared total is not below the
+     current best's can never win. sqrt is only needed to settle the few
+     candidates that are below it.
+   - Distances are computed for blocks of VQ_SEARCH_BLOCK entries at a time
+     with SSE2 or AVX. A block is dropped halfway through if none of its
+     partial totals is below the best so far.
+   - Whole maps are split across worker threads. Only the search runs in
+     parallel, so the statistics are still gathered in quad order.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "vq_internal.h"
+#include "vq_search.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#if defined(__GNUC__)
+#define HAVE_AVX 1
+#endif
+#endif
+
+/* don't bother with threads for maps with less work than this */
+#define THREAD_MIN_WORK (1 << 16)
+#define MAX_THREADS 64
+
+/* Compute the squared distances from q to the block of entries starting at
+   base into t. Returns a mask of the entries whose distance is below limit;
+   the others may not have been written. */
+typedef int (*totals_fn)(const vq_search_t *s, const float *q, int base,
+                         double limit, double *t);
+
+static double total_c(const vq_search_t *s, const float *q, int k) {
+    int c;
+    double total = 0.0;
+
+    for(c = 0; c < VQ_QUAD_COMPONENTS; c++) {
+        float d = s->comp[c][k] - q[c];
+        total += (d * d);
+    }
+
+    return total;
+}
+
+#if !HAVE_SSE2
+static int totals_c(const vq_search_t *s, const float *q, int base,
+                    double limit, double *t) {
+    int e, mask = 0;
+
+    for(e = 0; e < VQ_SEARCH_BLOCK; e++) {
+        t[e] = total_c(s, q, base + e);
+
+        if(t[e] < limit)
+            mask |= 1 << e;
+    }
+
+    return mask;
+}
+#endif
+
+#if HAVE_SSE2
+static int totals_sse2(const vq_search_t *s, const float *q, int base,
+                       double limit, double *t) {
+    __m128d acc[4], lim = _mm_set1_pd(limit);
+    int c, h, mask;
+
+    for(h = 0; h < 4; h++)
+        acc[h] = _mm_setzero_pd();
+
+    for(c = 0; c < VQ_QUAD_COMPONENTS; c++) {
+        __m128 qc = _mm_set1_ps(q[c]);
+
+        for(h = 0; h < 2; h++) {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(&s->comp[c][base + h * 4]), qc);
+            d = _mm_mul_ps(d, d);
+            acc[h * 2] = _mm_add_pd(acc[h * 2], _mm_cvtps_pd(d));
+            acc[h * 2 + 1] = _mm_add_pd(acc[h * 2 + 1], _mm_cvtps_pd(_mm_movehl_ps(d, d)));
+        }
+
+        /* the totals only grow, so give up early on hopeless blocks */
+        if(c == VQ_QUAD_COMPONENTS / 2 - 1) {
+            mask = 0;
+
+            for(h = 0; h < 4; h++)
+                mask |= _mm_movemask_pd(_mm_cmplt_pd(acc[h], lim)) << (h * 2);
+
+            if(!mask)
+                return 0;
+        }
+    }
+
+    mask = 0;
+
+    for(h = 0; h < 4; h++) {
+        _mm_storeu_pd(t + h * 2, acc[h]);
+        mask |= _mm_movemask_pd(_mm_cmplt_pd(acc[h], lim)) << (h * 2);
+    }
+
+    return mask;
+}
+#endif
+
+#if HAVE_AVX
+__attribute__((target("avx")))
+static int totals_avx(const vq_search_t *s, const float *q, int base,
+                      double limit, double *t) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d lim = _mm256_set1_pd(limit);
+    int c, mask;
+
+    for(c = 0; c < VQ_QUAD_COMPONENTS; c++) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(&s->comp[c][base]),
+                                 _mm256_set1_ps(q[c]));
+        d = _mm256_mul_ps(d, d);
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(d)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)));
+
+        if(c == VQ_QUAD_COMPONENTS / 2 - 1) {
+            mask = _mm256_movemask_pd(_mm256_cmp_pd(acc0, lim, _CMP_LT_OQ)) |
+                   _mm256_movemask_pd(_mm256_cmp_pd(acc1, lim, _CMP_LT_OQ)) << 4;
+
+            if(!mask)
+                return 0;
+        }
+    }
+
+    _mm256_storeu_pd(t, acc0);
+    _mm256_storeu_pd(t + 4, acc1);
+    return _mm256_movemask_pd(_mm256_cmp_pd(acc0, lim, _CMP_LT_OQ)) |
+           _mm256_movemask_pd(_mm256_cmp_pd(acc1, lim, _CMP_LT_OQ)) << 4;
+}
+#endif
+
+static totals_fn totals;
+
+static totals_fn select_totals(void) {
+#if HAVE_AVX
+    if(__builtin_cpu_supports("avx"))
+        return totals_avx;
+#endif
+#if HAVE_SSE2
+    return totals_sse2;
+#else
+    return totals_c;
+#endif
+}
+
+void vq_search_init(vq_search_t *s, const context_t *cb) {
+    int i, c;
+    float q[VQ_QUAD_COMPONENTS];
+
+    if(totals == NULL)
+        totals = select_totals();
+
+    memset(s, 0, sizeof(*s));
+    s->in_use = cb->in_use;
+
+    for(i = 0; i < cb->in_use; i++) {
+        get_components(q, &cb->codes[i].value);
+
+        for(c = 0; c < VQ_QUAD_COMPONENTS; c++)
+            s->comp[c][i] = q[c];
+    }
+}
+
+int vq_search_find(const vq_search_t *s, const fquad_t *quad, double *dist) {
+    int base, e, code, close_entry;
+    double close_total, close_dist, t[VQ_SEARCH_BLOCK];
+    float q[VQ_QUAD_COMPONENTS];
+
+    get_components(q, quad);
+
+    close_entry = 0;
+    close_total = total_c(s, q, 0);
+    close_dist = sqrt(close_total);
+
+    for(base = 0; base < s->in_use; base += VQ_SEARCH_BLOCK) {
+        int mask = totals(s, q, base, close_total, t);
+
+        for(e = 0; mask; e++, mask >>= 1) {
+            if(!(mask & 1))
+                continue;
+
+            code = base + e;
+
+            /* the best may have improved since the mask was made */
+            if(code >= s->in_use || !(t[e] < close_total))
+                continue;
+
+            /* totals that differ can still have the same sqrt, and then
+               the earlier entry stays */
+            if(sqrt(t[e]) < close_dist) {
+                close_entry = code;
+                close_total = t[e];
+                close_dist = sqrt(t[e]);
+
+                if(close_dist < 0.0001) {
+                    /* close enough */
+                    goto out;
+                }
+            }
+        }
+    }
+
+out:
+    if(dist)
+        *dist = close_dist;
+
+    return close_entry;
+}
+
+typedef struct map_job_t {
+    const vq_search_t *s;
+    const fquad_t *quads;
+    int *idx;
+    double *dist;
+    int start, end;
+} map_job_t;
+
+static void *map_slice(void *arg) {
+    map_job_t *job = (map_job_t *)arg;
+    int i;
+
+    for(i = job->start; i < job->end; i++)
+        job->idx[i] = vq_search_find(job->s, &job->quads[i], &job->dist[i]);
+
+    return NULL;
+}
+
+void vq_search_map(const vq_search_t *s, const fquad_t *quads, int nquads,
+                   int *idx, double *dist, int threads) {
+    map_job_t jobs[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    int started[MAX_THREADS];
+    long work;
+    int i;
+
+    if(threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    work = (long)nquads * s->in_use;
+
+    if(threads > work / THREAD_MIN_WORK)
+        threads = (int)(work / THREAD_MIN_WORK);
+
+    if(threads > MAX_THREADS)
+        threads = MAX_THREADS;
+
+    if(threads < 1)
+        threads = 1;
+
+    for(i = 0; i < threads; i++) {
+        jobs[i].s = s;
+        jobs[i].quads = quads;
+        jobs[i].idx = idx;
+        jobs[i].dist = dist;
+        jobs[i].start = (int)((long)nquads * i / threads);
+        jobs[i].end = (int)((long)nquads * (i + 1) / threads);
+    }
+
+    /* the calling thread does the first slice, and any slice whose thread
+       could not be created */
+    for(i = 1; i < threads; i++)
+        started[i] = !pthread_create(&tids[i], NULL, map_slice, &jobs[i]);
+
+    map_slice(&jobs[0]);
+
+    for(i = 1; i < threads; i++) {
+        if(started[i])
+            pthread_join(tids[i], NULL);
+        else
+            map_slice(&jobs[i]);
+    }
+}
@@ -0,0 +1,40 @@
+/* KallistiOS ##version##
+
+   vq_search.h
+   Copyright (C) 2026 KallistiOS Contributors
+
+   Nearest codebook entry search for vqenc.
+*/
+
+#ifndef __VQ_SEARCH_H
+#define __VQ_SEARCH_H
+
+#include "vq_types.h"
+
+/* number of floats in a quad */
+#define VQ_QUAD_COMPONENTS 16
+
+/* entries are searched in blocks of this many */
+#define VQ_SEARCH_BLOCK 8
+
+/* The codebook, transposed so that each row holds one component of every
+   entry. Rows are in the order delta_e() sums the components in, so that
+   the distances come out bit for bit the same. */
+typedef struct vq_search_t {
+    int in_use;
+    float comp[VQ_QUAD_COMPONENTS][256 + VQ_SEARCH_BLOCK];
+} vq_search_t;
+
+/* take a snapshot of the codebook values for searching */
+void vq_search_init(vq_search_t *s, const context_t *cb);
+
+/* returns the same entry as a linear scan with delta_e() would, and stores
+   its distance to the quad in dist if not NULL */
+int vq_search_find(const vq_search_t *s, const fquad_t *q, double *dist);
+
+/* vq_search_find() for every quad of a map, split across threads; a thread
+   count of 0 uses every online CPU */
+void vq_search_map(const vq_search_t *s, const fquad_t *quads, int nquads,
+                   int *idx, double *dist, int threads);
+
+#endif  /* __VQ_SEARCH_H */
@@ -9,6 +9,8 @@
 
    This code is based on the work of Jonas Norberg, you can find more info at
    http://www.acc.umu.se/~bedev/software/vq/
+
+   Copyright (C) 2026 KallistiOS Contributors
 */
 
 #include <stdio.h>
@@ -22,6 +24,7 @@
 #include "get_image.h"
 #include "vq_internal.h"
 #include "vq_types.h"
+#include "vq_search.h"
 
 /* For outputting KMG files */
 #include "kmg.h"
@@ -33,6 +36,10 @@ static int use_debug = 0;
 static int use_hq = 0;
 static int use_kmg = 0;
 static int use_alpha = 0;
+static int use_threads = 0;
+
+/* the codebook values, as seen by the search */
+static vq_search_t search;
 
 #define PACK1555(a, r, g, b) ( (a ? 0x8000 : 0) | ((r>>3)<<10) | ((g>>3)<<5) | ((b >>3)))
 #define PACK4444(a, r, g, b) ( ((a>>4) << 12) | ((r>>4)<<8) | ((g>>4)<<4) | ((b>>4)) )
@@ -60,16 +67,16 @@ static void reset_codebook(context_t *cb) {
 
 static double quad_length(fquad_t *q) {
     int i;
-    float total;
+    float c[VQ_QUAD_COMPONENTS], total;
 
+    /* Summed from a flat copy rather than straight from the quad. The
+       unrolled form gave different results with GCC 12 at -O2 than without
+       the vectorizer; this one gives the same in both. */
+    get_components(c, q);
     total = 0.0;
 
-    for(i = 0; i < 4; i++) {
-        total += (q->p[i].a * q->p[i].a);
-        total += (q->p[i].r * q->p[i].r);
-        total += (q->p[i].g * q->p[i].g);
-        total += (q->p[i].b * q->p[i].b);
-    }
+    for(i = 0; i < VQ_QUAD_COMPONENTS; i++)
+        total += (c[i] * c[i]);
 
     return sqrt(total);
 }
@@ -88,72 +95,45 @@ static int quads_in_map(int res) {
     return (across * across) >> 2;
 }
 
-static double delta_e(fquad_t *a, fquad_t *b) {
-    int i;
-    fquad_t sub;
-    double total;
-
-    total = 0.0;
-    sub_quad(&sub, a, b);
-
-    for(i = 0; i < 4; i++) {
-        total += (sub.p[i].a * sub.p[i].a);
-        total += (sub.p[i].r * sub.p[i].r);
-        total += (sub.p[i].g * sub.p[i].g);
-        total += (sub.p[i].b * sub.p[i].b);
-    }
-
-    return sqrt(total);
-}
-
-/* returns the closest (most similar) codebook entry to the given quad */
-static int find(context_t *cb, fquad_t *q) {
-    int code, close_entry;
-    double close_dist;
-
-    close_entry = 0;
-    close_dist = delta_e(&cb->codes[0].value, q);
-
-    for(code = 1; code < cb->in_use; code++) {
-
-        /* hope not to get sued for this variable's name */
-        double d;
-
-        d = delta_e(&cb->codes[code].value, q);
-
-        if(d < close_dist) {
-            close_entry = code;
-            close_dist = d;
-
-            if(d < 0.0001) {
-                /* close enough */
-                return close_entry;
-            }
-        }
-
-    }
-
-    return close_entry;
+/* returns the closest (most similar) codebook entry to the given quad;
+   the distance between them is stored in dist if not NULL. The search uses
+   the codebook snapshot taken by vq_search_init(). */
+static int find(fquad_t *q, double *dist) {
+    return vq_search_find(&search, q, dist);
 }
 
 static void place(context_t *cb, fquad_t *quads, int nquads) {
-    int i, idx;
+    int i, idx, *nearest;
     code_t *e;
-    double dist;
+    double dist, *dists;
     fquad_t *that;
 
     that = quads;
 
+    /* search the whole map at once, so it can be done in parallel; the
+       statistics below are still gathered in order */
+    nearest = (int *)malloc(sizeof(int) * nquads);
+    dists = (double *)malloc(sizeof(double) * nquads);
+
+    if(nearest != NULL && dists != NULL)
+        vq_search_map(&search, quads, nquads, nearest, dists, use_threads);
+
     for(i = 0; i < nquads; i++) {
         /* find averages of all codebook entries */
-        idx = find(cb, that);
+        if(nearest != NULL && dists != NULL) {
+            idx = nearest[i];
+            dist = dists[i];
+        }
+        else {
+            idx = find(that, &dist);
+        }
+
         e = &cb->codes[idx];
 
         add_quad(&e->pos_sum, that);
         e->pos_count++;
 
         /* see if we have something better in hand */
-        dist = delta_e(&e->value, that);
 
         if(dist > e->max_dist) {
             e->max_dist = dist;
@@ -162,6 +142,9 @@ static void place(context_t *cb, fquad_t *quads, int nquads) {
 
         that++;
     }
+
+    free(nearest);
+    free(dists);
 }
 
 static void clean_codebook(context_t *cb) {
@@ -345,7 +328,7 @@ static int write_linear(FILE *out, context_t *cb, mipmap_t *m, int res) {
     nquads = quads_in_map(res);
 
     for(i = 0; i < nquads; i++) {
-        uint8 c = find(cb, &m->map[res][i]);
+        uint8 c = find(&m->map[res][i], NULL);
 
         if(fputc(c, out) == EOF)
             return -1;
@@ -367,7 +350,7 @@ static int write_twiddled(FILE *out, context_t *cb, mipmap_t *m, int res) {
     map = m->map[res];
 
     for(i = 0; i < nquads; i++) {
-        uint8 c = find(cb, &map[*twididx++]);
+        uint8 c = find(&map[*twididx++], NULL);
 
         if(fputc(c, out) == EOF)
             return -1;
@@ -438,6 +421,8 @@ static int save(const char *filename, context_t *cb, mipmap_t *m, image_t *img)
         }
     }
 
+    vq_search_init(&search, cb);
+
     if(save_codebook(fp, cb) < 0) {
         fprintf(stderr, "FATAL: failed writing codebook to %s\n", filename);
         goto loser;
@@ -490,6 +475,7 @@ static void banner(const char *progname) {
     printf("\t-k, --kmg\twrite a KMG for output\n");
     printf("\t-a, --alpha\tuse alpha channel (and output ARGB4444)\n");
     printf("\t-b, --amask\tuse 1-bit alpha mask (and output ARGB1555)\n");
+    printf("\t-j<n>, --threads=<n>\tsearch with n threads (default: one per CPU)\n");
 }
 
 static int mipmap_index(int s) {
@@ -666,6 +652,7 @@ static void place_quads(context_t *cb, mipmap_t *m) {
      */
 
     reset_codebook(cb);
+    vq_search_init(&search, cb);
 
     for(j = 0; j < (use_hq ? 3 : 1); j++) {
         for(i = 0; i < MAX_MIPMAP; i++) {
@@ -784,6 +771,17 @@ static int encode(const char *infile) {
     return ok;
 }
 
+static int parse_threads(const char *arg) {
+    char *end;
+    long n = strtol(arg, &end, 10);
+
+    if(end == arg || *end != '\0' || n < 1 || n > 64)
+        return -EINVAL;
+
+    use_threads = (int)n;
+    return 0;
+}
+
 static int process_long_options(char *arg) {
     if(! strcmp(arg, "mipmap"))
         use_mipmap = 1;
@@ -801,6 +799,8 @@ static int process_long_options(char *arg) {
         use_alpha = 1;
     else if(! strcmp(arg, "amask"))
         use_alpha = 2;
+    else if(! strncmp(arg, "threads=", 8))
+        return parse_threads(arg + 8);
     else
         return -EINVAL;
 
@@ -845,6 +845,9 @@ static int process_option(char *arg) {
             use_alpha = 2;
             return 0;
 
+        case 'j':
+            return parse_threads(arg + 1);
+
         case '-':
             return process_long_options(arg + 1);
     }
@@ -0,0 +1,598 @@
+/* KallistiOS ##version##
+
+   xformtest.c
+   Copyright (C) 2026 KallistiOS Contributors
+
+   PC-based test and benchmark for the PVR transform pipeline, whose code in
+   kernel/arch/dreamcast/hardware/pvr/pvr_xform.c is built as-is on the host,
+   with the C transform in place of FTRV and a memory buffer as the target.
+
+   Besides a few targeted tests, random meshes are drawn as triangles and as
+   strips, indexed or not, with each culling mode. The strips written by the
+   pipeline are split back into triangles, and compared to a reference that
+   transforms, clips and culls every input triangle on its own, in double
+   precision.
+
+   The benchmark (-b) draws a large grid as strips, mostly in view, and
+   reports the time per input vertex.
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <dc/pvr/pvr_xform.h>
+
+#define NEAR        1.0
+#define MAX_TRIS    4096
+#define MAX_OUT     (MAX_TRIS * 6)
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+            return; \
+        } \
+    } while(0)
+
+typedef struct tri {
+    double x[3], y[3], z[3], u[3];
+    uint32_t argb[3];
+} tri_t;
+
+static pvr_vertex_t out[MAX_OUT];
+static tri_t got[MAX_TRIS * 2], want[MAX_TRIS * 2];
+static matrix_t proj;
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double frand(double lo, double hi) {
+    return lo + (hi - lo) * rand() / (double)RAND_MAX;
+}
+
+/* Perspective projection looking down -z from the origin, onto a 640x480
+   screen, with w = -z. */
+static void setup_proj(void) {
+    memset(proj, 0, sizeof(proj));
+    proj[0][0] = 240.0f;
+    proj[1][1] = -240.0f;
+    proj[2][0] = -320.0f;
+    proj[2][1] = -240.0f;
+    proj[2][3] = -1.0f;
+}
+
+static pvr_vertex_t make_vtx(float x, float y, float z) {
+    pvr_vertex_t v = {
+        .x = x, .y = y, .z = z,
+        .u = (float)frand(0.0, 1.0),
+        .v = (float)frand(0.0, 1.0),
+        .argb = (uint32_t)rand() << 1 ^ (uint32_t)rand(),
+        .oargb = 0
+    };
+
+    return v;
+}
+
+static double tri_area(const tri_t *t) {
+    return (t->x[1] - t->x[0]) * (t->y[2] - t->y[0]) -
+           (t->x[2] - t->x[0]) * (t->y[1] - t->y[0]);
+}
+
+/* Split the strips of the output into triangles, skipping degenerate ones. */
+static size_t split_strips(const pvr_vertex_t *v, size_t count, tri_t *tris) {
+    size_t i, k = 0, n = 0, j;
+    const pvr_vertex_t *p[3];
+    tri_t *t;
+
+    for(i = 0; i < count; i++, k++) {
+        if(k >= 2) {
+            p[0] = &v[i - ((k & 1) ? 1 : 2)];
+            p[1] = &v[i - ((k & 1) ? 2 : 1)];
+            p[2] = &v[i];
+            t = &tris[n];
+
+            for(j = 0; j < 3; j++) {
+                t->x[j] = p[j]->x;
+                t->y[j] = p[j]->y;
+                t->z[j] = p[j]->z;
+                t->u[j] = p[j]->u;
+                t->argb[j] = p[j]->argb;
+            }
+
+            if(fabs(tri_area(t)) > 1e-3)
+                n++;
+        }
+
+        if(v[i].flags == PVR_CMD_VERTEX_EOL)
+            k = -1;
+    }
+
+    return n;
+}
+
+typedef struct rvtx {
+    double x, y, w, u;
+    double c[4];
+} rvtx_t;
+
+static void ref_transform(const pvr_vertex_t *v, rvtx_t *r) {
+    int i;
+
+    r->x = proj[0][0] * v->x + proj[1][0] * v->y + proj[2][0] * v->z +
+           proj[3][0];
+    r->y = proj[0][1] * v->x + proj[1][1] * v->y + proj[2][1] * v->z +
+           proj[3][1];
+    r->w = proj[0][3] * v->x + proj[1][3] * v->y + proj[2][3] * v->z +
+           proj[3][3];
+    r->u = v->u;
+
+    for(i = 0; i < 4; i++)
+        r->c[i] = (v->argb >> (i * 8)) & 0xff;
+}
+
+static void ref_emit(const rvtx_t *a, const rvtx_t *b, const rvtx_t *c,
+                     tri_t *t) {
+    const rvtx_t *p[3] = { a, b, c };
+    int i, j;
+
+    for(i = 0; i < 3; i++) {
+        t->x[i] = p[i]->x / p[i]->w;
+        t->y[i] = p[i]->y / p[i]->w;
+        t->z[i] = 1.0 / p[i]->w;
+        t->u[i] = p[i]->u;
+        t->argb[i] = 0;
+
+        for(j = 0; j < 4; j++)
+            t->argb[i] |= (uint32_t)floor(p[i]->c[j] + 0.5) << (j * 8);
+    }
+}
+
+static int ref_outcode(const rvtx_t *r, const float *vp) {
+    double sx, sy;
+    int code = 0;
+
+    if(r->w < NEAR)
+        return 1;
+
+    if(!vp)
+        return 0;
+
+    sx = r->x / r->w;
+    sy = r->y / r->w;
+
+    if(sx < vp[0])
+        code |= 2;
+    else if(sx > vp[2])
+        code |= 4;
+
+    if(sy < vp[1])
+        code |= 8;
+    else if(sy > vp[3])
+        code |= 16;
+
+    return code;
+}
+
+/* Reference for one triangle, in its actual orientation. Returns the number
+   of triangles produced. */
+static size_t ref_tri(const pvr_vertex_t *v[3], pvr_xform_cull_t cull,
+                      const float *vp, tri_t *tris) {
+    rvtx_t r[3], c[4];
+    int code[3], n = 0, i, j;
+    double f;
+    tri_t t;
+
+    for(i = 0; i < 3; i++) {
+        ref_transform(v[i], &r[i]);
+        code[i] = ref_outcode(&r[i], vp);
+    }
+
+    if(code[0] & code[1] & code[2])
+        return 0;
+
+    for(i = 0; i < 3; i++) {
+        const rvtx_t *a = &r[i], *b = &r[(i + 1) % 3];
+
+        if(a->w >= NEAR)
+            c[n++] = *a;
+
+        if((a->w < NEAR) != (b->w < NEAR)) {
+            f = (a->w - NEAR) / (a->w - b->w);
+            c[n].x = a->x + (b->x - a->x) * f;
+            c[n].y = a->y + (b->y - a->y) * f;
+            c[n].w = NEAR;
+            c[n].u = a->u + (b->u - a->u) * f;
+
+            for(j = 0; j < 4; j++)
+                c[n].c[j] = a->c[j] + (b->c[j] - a->c[j]) * f;
+
+            n++;
+        }
+    }
+
+    ref_emit(&c[0], &c[1], n == 4 ? &c[3] : &c[2], &t);
+
+    if((cull == PVR_XFORM_CULL_CW && tri_area(&t) >= 0.0) ||
+       (cull == PVR_XFORM_CULL_CCW && tri_area(&t) <= 0.0))
+        return 0;
+
+    tris[0] = t;
+
+    if(n == 4) {
+        ref_emit(&c[1], &c[2], &c[3], &tris[1]);
+        return 2;
+    }
+
+    return 1;
+}
+
+static int tri_match(const tri_t *a, const tri_t *b) {
+    int i, j, rot;
+
+    /* Same vertices in the same cyclic order */
+    for(rot = 0; rot < 3; rot++) {
+        for(i = 0; i < 3; i++) {
+            j = (i + rot) % 3;
+
+            if(fabs(a->x[i] - b->x[j]) > 0.01 ||
+               fabs(a->y[i] - b->y[j]) > 0.01 ||
+               fabs(a->z[i] - b->z[j]) > 1e-5 * fabs(b->z[j]) + 1e-7 ||
+               fabs(a->u[i] - b->u[j]) > 1e-4)
+                break;
+
+            if(abs((int)(a->argb[i] & 0xff) - (int)(b->argb[j] & 0xff)) > 1 ||
+               abs((int)(a->argb[i] >> 24) - (int)(b->argb[j] >> 24)) > 1)
+                break;
+        }
+
+        if(i == 3)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Check that both lists hold the same triangles, in any order. */
+static int same_tris(tri_t *a, size_t na, tri_t *b, size_t nb) {
+    size_t i, j;
+    tri_t tmp;
+
+    if(na != nb) {
+        fprintf(stderr, "%zu triangles instead of %zu\n", na, nb);
+        return 0;
+    }
+
+    for(i = 0; i < na; i++) {
+        for(j = i; j < nb; j++) {
+            if(tri_match(&a[i], &b[j]))
+                break;
+        }
+
+        if(j == nb) {
+            fprintf(stderr, "triangle %zu (%.1f,%.1f %.1f,%.1f %.1f,%.1f) "
+                    "not expected\n", i, a[i].x[0], a[i].y[0], a[i].x[1],
+                    a[i].y[1], a[i].x[2], a[i].y[2]);
+            return 0;
+        }
+
+        tmp = b[i];
+        b[i] = b[j];
+        b[j] = tmp;
+    }
+
+    return 1;
+}
+
+static pvr_xform_t *make_xform(pvr_xform_cull_t cull, size_t out_size) {
+    pvr_xform_t *xf = pvr_xform_create();
+
+    pvr_xform_set_matrix(xf, &proj);
+    pvr_xform_set_near(xf, NEAR);
+    pvr_xform_set_cull(xf, cull);
+    pvr_xform_target_buffer(xf, out, out_size);
+
+    return xf;
+}
+
+/* Draw random geometry and compare with the reference. */
+static void test_random(pvr_xform_prim_t prim, int indexed,
+                        pvr_xform_cull_t cull, int viewport) {
+    static pvr_vertex_t vtx[256];
+    static uint16_t idx[MAX_TRIS];
+    static const float vp[4] = { 0.0f, 0.0f, 640.0f, 480.0f };
+    const pvr_vertex_t *tv[3];
+    size_t i, n, nvtx = 64, count, ngot, nwant = 0;
+    pvr_xform_t *xf = make_xform(cull, MAX_OUT);
+    int rv;
+
+    if(viewport)
+        pvr_xform_set_viewport(xf, vp[0], vp[1], vp[2], vp[3]);
+
+    for(i = 0; i < nvtx; i++)
+        vtx[i] = make_vtx(frand(-15.0, 15.0), frand(-12.0, 12.0),
+                          frand(-20.0, 3.0));
+
+    count = prim == PVR_XFORM_STRIP ? 300 : 600;
+
+    if(indexed) {
+        /* Triangles with a repeated vertex aren't exactly degenerate once
+           clipped, so avoid them */
+        for(i = 0; i < count; i++) {
+            do {
+                idx[i] = rand() % nvtx;
+            } while((i >= 1 && idx[i] == idx[i - 1]) ||
+                    (i >= 2 && idx[i] == idx[i - 2]));
+        }
+
+        rv = pvr_xform_draw_indexed(xf, prim, vtx, nvtx, idx, count);
+    }
+    else {
+        count = nvtx;
+        rv = pvr_xform_draw(xf, prim, vtx, count);
+    }
+
+    CHECK(rv >= 0 && (size_t)rv == pvr_xform_buffer_used(xf),
+          "draw returned %d", rv);
+
+    for(i = 0; i + 2 < count; i += prim == PVR_XFORM_STRIP ? 1 : 3) {
+        for(n = 0; n < 3; n++)
+            tv[n] = &vtx[indexed ? idx[i + n] : i + n];
+
+        if(prim == PVR_XFORM_STRIP && (i & 1)) {
+            const pvr_vertex_t *tmp = tv[0];
+            tv[0] = tv[1];
+            tv[1] = tmp;
+        }
+
+        nwant += ref_tri(tv, cull, viewport ? vp : NULL, &want[nwant]);
+    }
+
+    /* The reference doesn't drop degenerate triangles by itself */
+    for(i = n = 0; i < nwant; i++) {
+        if(fabs(tri_area(&want[i])) > 1e-3)
+            want[n++] = want[i];
+    }
+
+    nwant = n;
+    ngot = split_strips(out, rv, got);
+
+    CHECK(out[rv - 1].flags == PVR_CMD_VERTEX_EOL, "strip not terminated");
+    CHECK(same_tris(got, ngot, want, nwant),
+          "prim %d, indexed %d, cull %d, viewport %d", prim, indexed, cull,
+          viewport);
+
+    pvr_xform_destroy(xf);
+}
+
+/* A strip entirely in view goes out unchanged. */
+static void test_strip_passthrough(void) {
+    pvr_vertex_t vtx[16];
+    pvr_xform_t *xf = make_xform(PVR_XFORM_CULL_NONE, MAX_OUT);
+    pvr_xform_stats_t st;
+    int i, rv;
+
+    for(i = 0; i < 16; i++)
+        vtx[i] = make_vtx(i * 0.5f - 4.0f, (i & 1) ? -1.0f : 1.0f, -10.0f);
+
+    rv = pvr_xform_draw(xf, PVR_XFORM_STRIP, vtx, 16);
+    pvr_xform_get_stats(xf, &st);
+
+    CHECK(rv == 16, "%d vertices instead of 16", rv);
+    CHECK(st.strips_out == 1 && st.triangles_in == 14 && st.vertices_in == 16,
+          "stats: %u strips, %u triangles", st.strips_out, st.triangles_in);
+
+    for(i = 0; i < 16; i++) {
+        CHECK(out[i].flags == (i == 15 ? PVR_CMD_VERTEX_EOL : PVR_CMD_VERTEX),
+              "flags of vertex %d", i);
+        CHECK(fabsf(out[i].z - 0.1f) < 1e-6f, "depth of vertex %d", i);
+        CHECK(out[i].u == vtx[i].u && out[i].argb == vtx[i].argb,
+              "attributes of vertex %d", i);
+    }
+
+    pvr_xform_destroy(xf);
+}
+
+/* Culling a triangle in the middle of a strip splits it, and the second
+   part starts on the right parity. */
+static void test_strip_split(void) {
+    pvr_vertex_t vtx[8];
+    pvr_xform_t *xf = make_xform(PVR_XFORM_CULL_CW, MAX_OUT);
+    pvr_xform_stats_t st;
+    int i, rv;
+
+    for(i = 0; i < 8; i++)
+        vtx[i] = make_vtx(i * 1.0f - 4.0f, (i & 1) ? -1.0f : 1.0f, -10.0f);
+
+    /* Fold the third triangle over, so that it faces the other way */
+    vtx[4].y = -3.0f;
+
+    rv = pvr_xform_draw(xf, PVR_XFORM_STRIP, vtx, 8);
+    pvr_xform_get_stats(xf, &st);
+
+    CHECK(st.culled == 3 && st.strips_out == 2,
+          "%u culled, %u strips", st.culled, st.strips_out);
+    CHECK(rv == 8 && out[3].flags == PVR_CMD_VERTEX_EOL,
+          "%d vertices instead of 8", rv);
+
+    /* The last triangle is odd, so its strip starts with a degenerate one */
+    CHECK(out[4].x == out[5].x && out[4].y == out[5].y &&
+          out[4].argb == vtx[5].argb && out[6].argb == vtx[6].argb,
+          "second strip doesn't start on an odd triangle");
+
+    pvr_xform_destroy(xf);
+}
+
+static void test_clip(void) {
+    pvr_vertex_t vtx[3];
+    pvr_xform_t *xf = make_xform(PVR_XFORM_CULL_NONE, MAX_OUT);
+    pvr_xform_stats_t st;
+    int rv, i;
+
+    /* One vertex behind: a quad */
+    vtx[0] = make_vtx(-1.0f, -1.0f, -5.0f);
+    vtx[1] = make_vtx(1.0f, -1.0f, -5.0f);
+    vtx[2] = make_vtx(0.0f, 1.0f, 5.0f);
+
+    rv = pvr_xform_draw(xf, PVR_XFORM_TRIANGLES, vtx, 3);
+    CHECK(rv == 4, "%d vertices instead of 4", rv);
+
+    for(i = 0; i < 4; i++)
+        CHECK(out[i].z <= 1.0f / NEAR + 1e-6f, "vertex %d past near", i);
+
+    /* Two behind: a triangle */
+    vtx[0].z = vtx[1].z = 5.0f;
+    vtx[2].z = -5.0f;
+    pvr_xform_target_buffer(xf, out, MAX_OUT);
+
+    rv = pvr_xform_draw(xf, PVR_XFORM_TRIANGLES, vtx, 3);
+    CHECK(rv == 3, "%d vertices instead of 3", rv);
+
+    /* All behind: nothing */
+    vtx[2].z = 5.0f;
+    rv = pvr_xform_draw(xf, PVR_XFORM_TRIANGLES, vtx, 3);
+    CHECK(rv == 0, "%d vertices instead of 0", rv);
+
+    pvr_xform_get_stats(xf, &st);
+    CHECK(st.clipped == 2 && st.rejected == 1,
+          "%u clipped, %u rejected", st.clipped, st.rejected);
+
+    pvr_xform_destroy(xf);
+}
+
+static void test_overflow(void) {
+    pvr_vertex_t vtx[6];
+    pvr_xform_t *xf = make_xform(PVR_XFORM_CULL_NONE, 5);
+    pvr_xform_stats_t st;
+    uint16_t idx[3] = { 0, 1, 7 };
+    int i, rv;
+
+    for(i = 0; i < 6; i++)
+        vtx[i] = make_vtx(i * 0.5f - 1.0f, (i % 3) * 0.5f, -10.0f);
+
+    /* Two triangles fit, but not the second one */
+    rv = pvr_xform_draw(xf, PVR_XFORM_TRIANGLES, vtx, 6);
+    pvr_xform_get_stats(xf, &st);
+
+    CHECK(rv == 3 && pvr_xform_buffer_used(xf) == 3,
+          "%d vertices instead of 3", rv);
+    CHECK(st.dropped == 3 && st.strips_out == 1,
+          "%u dropped, %u strips", st.dropped, st.strips_out);
+    CHECK(out[2].flags == PVR_CMD_VERTEX_EOL, "last strip not terminated");
+
+    errno = 0;
+    rv = pvr_xform_draw_indexed(xf, PVR_XFORM_TRIANGLES, vtx, 6, idx, 3);
+    CHECK(rv == -1 && errno == EINVAL, "bad index accepted");
+
+    pvr_xform_destroy(xf);
+}
+
+static void bench(double seconds) {
+    enum { W = 64, H = 32 };
+    static pvr_vertex_t vtx[W * 2 * H];
+    static pvr_vertex_t buf[W * 2 * H * 2];
+    pvr_xform_t *xf = make_xform(PVR_XFORM_CULL_CCW, W * 2 * H * 2);
+    size_t frames = 0;
+    double start, elapsed;
+    int x, y, total;
+
+    /* A grid of H strips, slightly tilted, with its top behind the viewer */
+    for(y = 0; y < H; y++) {
+        for(x = 0; x < W; x++) {
+            vtx[(y * W + x) * 2] = make_vtx(x * 0.5f - 16.0f, y * 0.5f - 8.0f,
+                                            -4.0f - y * 0.5f);
+            vtx[(y * W + x) * 2 + 1] = make_vtx(x * 0.5f - 16.0f,
+                                                y * 0.5f - 7.5f,
+                                                -4.25f - y * 0.5f);
+        }
+    }
+
+    start = now();
+
+    do {
+        pvr_xform_target_buffer(xf, buf, W * 2 * H * 2);
+
+        for(y = 0, total = 0; y < H; y++)
+            total += pvr_xform_draw(xf, PVR_XFORM_STRIP, &vtx[y * W * 2],
+                                    W * 2);
+
+        frames++;
+        elapsed = now() - start;
+    } while(elapsed < seconds);
+
+    printf("%d strips of %d vertices, %d vertices out: %.1f ns per input "
+           "vertex\n", H, W * 2, total, elapsed * 1e9 / (frames * W * 2 * H));
+
+    pvr_xform_destroy(xf);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-b] [-t seconds] [-r seed]\n\n"
+            "  -b  run the benchmark instead of the tests\n"
+            "  -t  duration of the benchmark (default 1)\n"
+            "  -r  seed of the random tests (default 1)\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    int c, do_bench = 0, i, cull;
+
+    srand(1);
+    setup_proj();
+
+    while((c = getopt(argc, argv, "bt:r:")) != -1) {
+        switch(c) {
+            case 'b':
+                do_bench = 1;
+                break;
+            case 't':
+                seconds = strtod(optarg, NULL);
+                break;
+            case 'r':
+                srand(strtoul(optarg, NULL, 0));
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if(do_bench) {
+        bench(seconds);
+        return 0;
+    }
+
+    test_strip_passthrough();
+    test_strip_split();
+    test_clip();
+    test_overflow();
+
+    for(i = 0; i < 20; i++) {
+        for(cull = PVR_XFORM_CULL_NONE; cull <= PVR_XFORM_CULL_CCW; cull++) {
+            test_random(PVR_XFORM_TRIANGLES, 0, cull, i & 1);
+            test_random(PVR_XFORM_TRIANGLES, 1, cull, i & 1);
+            test_random(PVR_XFORM_STRIP, 0, cull, i & 1);
+            test_random(PVR_XFORM_STRIP, 1, cull, i & 1);
+        }
+    }
+
+    if(failures) {
+        printf("%d test(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}